@@ -23,6 +23,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/MemoryAllocationLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/EmuThunkLib.h>
+#include <Library/PcdLib.h>
 
 //
 // Pointer to the CPU Architectural Protocol instance
@@ -196,11 +197,20 @@ Returns:
   // If TimerPeriod is 0, then the timer thread should be canceled
   // If the TimerPeriod is valid, then create and/or adjust the period of the timer thread
   //
+  // In tickless mode, the period is rounded up to whole milliseconds, so that a
+  // period below half a millisecond does not cancel the timer thread, and so
+  // that a DXE core that programs the period from its next timer event is not
+  // woken up too early.
+  //
   if (  (TimerPeriod == 0)
      || (  (TimerPeriod > TIMER_MINIMUM_VALUE)
         && (TimerPeriod < TIMER_MAXIMUM_VALUE)))
   {
-    mTimerPeriodMs = DivU64x32 (TimerPeriod + 5000, 10000);
+    if (FeaturePcdGet (PcdDxeTicklessTimerEnable)) {
+      mTimerPeriodMs = DivU64x32 (TimerPeriod + 9999, 10000);
+    } else {
+      mTimerPeriodMs = DivU64x32 (TimerPeriod + 5000, 10000);
+    }
 
     gEmuThunk->SetTimer (mTimerPeriodMs, TimerCallback);
   }
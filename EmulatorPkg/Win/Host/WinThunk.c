@@ -231,6 +231,11 @@ HANDLE  mNtMainThreadHandle;
 //
 UINT32  mNtLastTick;
 
+//
+// The period of the timer interrupt in ms
+//
+UINT32  mNtTimerPeriod;
+
 //
 // Critical section used to update varibles shared between the main thread and
 // the timer interrupt thread.
@@ -309,9 +314,9 @@ MMTimerThread (
     mNtLastTick = CurrentTick;
 
     //
-    //  If delay was more then 1 second, ignore it (probably debugging case)
+    //  If delay was more then 1 second over the period, ignore it (probably debugging case)
     //
-    if (Delta < 1000) {
+    if (Delta < mNtTimerPeriod + 1000) {
       //
       // Only invoke the callback function if a Non-NULL handler has been
       // registered. Assume all other handlers are legal.
@@ -370,14 +375,18 @@ SecSetTimer (
     LeaveCriticalSection (&mNtCriticalSection);
 
     //
-    //  Get the starting tick location if we are just starting the timer thread
+    //  Get the starting tick location if we are just starting the timer thread.
+    //  If only the period changes, the next tick still reports the time since
+    //  the last tick.
     //
-    mNtLastTick = GetTickCount ();
-
     if (mMMTimerThreadID) {
       timeKillEvent (mMMTimerThreadID);
+    } else {
+      mNtLastTick = GetTickCount ();
     }
 
+    mNtTimerPeriod = (UINT32)TimerPeriod;
+
     SetThreadPriority (
       GetCurrentThread (),
       THREAD_PRIORITY_HIGHEST
@@ -66,6 +66,51 @@ GetVariableStatisticsData (
   return Status;
 }
 
+/**
+  This function get and print the runtime variable cache synchronization statistics
+  from SMM variable driver.
+
+  @param[in, out] SmmCommunicateHeader A pointer to a communication buffer large enough
+                                       for the statistics.
+
+**/
+VOID
+PrintRuntimeCacheStatistics (
+  IN OUT  EFI_MM_COMMUNICATE_HEADER  *SmmCommunicateHeader
+  )
+{
+  EFI_STATUS                                             Status;
+  UINTN                                                  CommSize;
+  SMM_VARIABLE_COMMUNICATE_HEADER                        *SmmVariableFunctionHeader;
+  SMM_VARIABLE_COMMUNICATE_GET_RUNTIME_CACHE_STATISTICS  *RuntimeCacheStatistics;
+
+  CommSize = SMM_COMMUNICATE_HEADER_SIZE + SMM_VARIABLE_COMMUNICATE_HEADER_SIZE + sizeof (SMM_VARIABLE_COMMUNICATE_GET_RUNTIME_CACHE_STATISTICS);
+  CopyGuid (&SmmCommunicateHeader->HeaderGuid, &gEfiSmmVariableProtocolGuid);
+  SmmCommunicateHeader->MessageLength = CommSize - OFFSET_OF (EFI_MM_COMMUNICATE_HEADER, Data);
+
+  SmmVariableFunctionHeader               = (SMM_VARIABLE_COMMUNICATE_HEADER *)&SmmCommunicateHeader->Data[0];
+  SmmVariableFunctionHeader->Function     = SMM_VARIABLE_FUNCTION_GET_RUNTIME_CACHE_STATISTICS;
+  SmmVariableFunctionHeader->ReturnStatus = EFI_UNSUPPORTED;
+
+  Status = mMmCommunication2->Communicate (
+                                mMmCommunication2,
+                                SmmCommunicateHeader,
+                                SmmCommunicateHeader,
+                                &CommSize
+                                );
+  if (EFI_ERROR (Status) || EFI_ERROR (SmmVariableFunctionHeader->ReturnStatus)) {
+    return;
+  }
+
+  RuntimeCacheStatistics = (SMM_VARIABLE_COMMUNICATE_GET_RUNTIME_CACHE_STATISTICS *)SmmVariableFunctionHeader->Data;
+  Print (L"SMM Driver Runtime Cache Synchronization:\n");
+  Print (
+    L"Changed %ld bytes, copied %ld bytes\n",
+    RuntimeCacheStatistics->BytesChanged,
+    RuntimeCacheStatistics->BytesSynced
+    );
+}
+
 /**
 
   This function get and print the variable statistics data from SMM variable driver.
@@ -193,6 +238,9 @@ PrintInfoFromSmm (
     }
   } while (TRUE);
 
+  ZeroMem (CommBuffer, RealCommSize);
+  PrintRuntimeCacheStatistics (CommBuffer);
+
   return Status;
 }
 
@@ -601,6 +601,32 @@ AhciBuildCommandFis (
   CmdFis->AhciCFisDevHead = (UINT8)(AtaCommandBlock->AtaDeviceHead | 0xE0);
 }
 
+/**
+  Check whether SATA device reports it is ready for operation.
+
+  @param[in] PciIo    Pointer to AHCI controller PciIo.
+  @param[in] Port     SATA port index on which to check.
+
+  @return The PxTFD.BSY, PxTFD.DRQ and PxTFD.ERR bits of the port, which are all
+          zero when the device is ready.
+**/
+UINT32
+AhciCheckDeviceReady (
+  IN EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN UINT8                Port
+  )
+{
+  UINT32  Offset;
+
+  Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_SERR;
+  if (AhciReadReg (PciIo, Offset) != 0) {
+    AhciWriteReg (PciIo, Offset, AhciReadReg (PciIo, Offset));
+  }
+
+  Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_TFD;
+  return AhciReadReg (PciIo, Offset) & EFI_AHCI_PORT_TFD_MASK;
+}
+
 /**
   Wait until SATA device reports it is ready for operation.
 
@@ -618,7 +644,6 @@ AhciWaitDeviceReady (
 {
   UINT32  PhyDetectDelay;
   UINT32  Data;
-  UINT32  Offset;
 
   //
   // According to SATA1.0a spec section 5.2, we need to wait for PxTFD.BSY and PxTFD.DRQ
@@ -626,14 +651,7 @@ AhciWaitDeviceReady (
   //
   PhyDetectDelay = 16 * 1000;
   do {
-    Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_SERR;
-    if (AhciReadReg (PciIo, Offset) != 0) {
-      AhciWriteReg (PciIo, Offset, AhciReadReg (PciIo, Offset));
-    }
-
-    Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_TFD;
-
-    Data = AhciReadReg (PciIo, Offset) & EFI_AHCI_PORT_TFD_MASK;
+    Data = AhciCheckDeviceReady (PciIo, Port);
     if (Data == 0) {
       break;
     }
@@ -2785,362 +2803,1869 @@ AhciPuisEnable (
 }
 
 /**
-  Initialize ATA host controller at AHCI mode.
+  Set the command list base address of a port. The port must not be running.
 
-  The function is designed to initialize ATA host controller.
+  @param[in]  PciIo             The PCI IO protocol instance.
+  @param[in]  Port              The number of port.
+  @param[in]  CmdListPciAddr    The PCI bus master address of the command list.
 
-  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+**/
+VOID
+AhciSetCommandListBase (
+  IN EFI_PCI_IO_PROTOCOL   *PciIo,
+  IN UINT8                 Port,
+  IN EFI_PHYSICAL_ADDRESS  CmdListPciAddr
+  )
+{
+  DATA_64  Data64;
+  UINT32   Offset;
+
+  Data64.Uint64 = CmdListPciAddr;
+  Offset        = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CLB;
+  AhciWriteReg (PciIo, Offset, Data64.Uint32.Lower32);
+  Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CLBU;
+  AhciWriteReg (PciIo, Offset, Data64.Uint32.Upper32);
+}
+
+/**
+  Allocate the command lists, command tables and data buffers which the ports
+  use while they are initialized: one page per port.
+
+  @param[in]  PciIo             The PCI IO protocol instance.
+  @param[in]  Capability        The HBA capabilities.
+  @param[in]  Pages             The number of pages, one per port.
+  @param[out] Buffer            The allocated pages.
+  @param[out] PciAddr           The PCI bus master address of the pages.
+  @param[out] Map               The mapping of the pages.
+
+  @retval EFI_SUCCESS           The pages are allocated.
+  @retval EFI_OUT_OF_RESOURCES  The pages could not be allocated.
+  @retval EFI_DEVICE_ERROR      The pages are not addressable by the HBA.
 
 **/
 EFI_STATUS
-EFIAPI
-AhciModeInitialization (
-  IN  ATA_ATAPI_PASS_THRU_INSTANCE  *Instance
+AhciPortInitAllocateBuffers (
+  IN  EFI_PCI_IO_PROTOCOL   *PciIo,
+  IN  UINT32                Capability,
+  IN  UINTN                 Pages,
+  OUT VOID                  **Buffer,
+  OUT EFI_PHYSICAL_ADDRESS  *PciAddr,
+  OUT VOID                  **Map
   )
 {
-  EFI_STATUS                        Status;
-  EFI_PCI_IO_PROTOCOL               *PciIo;
-  EFI_IDE_CONTROLLER_INIT_PROTOCOL  *IdeInit;
-  UINT32                            Capability;
-  UINT8                             MaxPortNumber;
-  UINT32                            PortImplementBitMap;
-
-  EFI_AHCI_REGISTERS  *AhciRegisters;
+  EFI_STATUS  Status;
+  UINTN       Bytes;
 
-  UINT8                    Port;
-  DATA_64                  Data64;
-  UINT32                   Offset;
-  UINT32                   Data;
-  EFI_IDENTIFY_DATA        Buffer;
-  EFI_ATA_DEVICE_TYPE      DeviceType;
-  EFI_ATA_COLLECTIVE_MODE  *SupportedModes;
-  EFI_ATA_TRANSFER_MODE    TransferMode;
-  UINT32                   PhyDetectDelay;
-  UINT32                   Value;
+  STATIC_ASSERT (sizeof (AHCI_PORT_INIT_BUFFER) <= EFI_PAGE_SIZE, "AHCI_PORT_INIT_BUFFER must fit in a page");
 
-  if (Instance == NULL) {
-    return EFI_INVALID_PARAMETER;
+  Status = PciIo->AllocateBuffer (
+                    PciIo,
+                    AllocateAnyPages,
+                    EfiBootServicesData,
+                    Pages,
+                    Buffer,
+                    0
+                    );
+  if (EFI_ERROR (Status)) {
+    return EFI_OUT_OF_RESOURCES;
   }
 
-  PciIo   = Instance->PciIo;
-  IdeInit = Instance->IdeControllerInit;
+  ZeroMem (*Buffer, EFI_PAGES_TO_SIZE (Pages));
 
-  Status = AhciReset (PciIo, EFI_AHCI_BUS_RESET_TIMEOUT);
+  Bytes  = EFI_PAGES_TO_SIZE (Pages);
+  Status = PciIo->Map (
+                    PciIo,
+                    EfiPciIoOperationBusMasterCommonBuffer,
+                    *Buffer,
+                    &Bytes,
+                    PciAddr,
+                    Map
+                    );
+  if (EFI_ERROR (Status) || (Bytes != EFI_PAGES_TO_SIZE (Pages))) {
+    if (!EFI_ERROR (Status)) {
+      PciIo->Unmap (PciIo, *Map);
+    }
 
-  if (EFI_ERROR (Status)) {
+    PciIo->FreeBuffer (PciIo, Pages, *Buffer);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (((Capability & EFI_AHCI_CAP_S64A) == 0) && (*PciAddr + Bytes > 0x100000000ULL)) {
+    //
+    // The AHCI HBA doesn't support 64bit addressing, so should not get a >4G pci bus master address.
+    //
+    PciIo->Unmap (PciIo, *Map);
+    PciIo->FreeBuffer (PciIo, Pages, *Buffer);
     return EFI_DEVICE_ERROR;
   }
 
-  //
-  // Collect AHCI controller information
-  //
-  Capability = AhciReadReg (PciIo, EFI_AHCI_CAPABILITY_OFFSET);
+  return EFI_SUCCESS;
+}
 
-  //
-  // Make sure that GHC.AE bit is set before accessing any AHCI registers.
-  //
-  Value = AhciReadReg (PciIo, EFI_AHCI_GHC_OFFSET);
+/**
+  Stop the command a port issued while it is initialized, and give the port
+  back its shared command list.
 
-  if ((Value & EFI_AHCI_GHC_ENABLE) == 0) {
-    AhciOrReg (PciIo, EFI_AHCI_GHC_OFFSET, EFI_AHCI_GHC_ENABLE);
-  }
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  Port              The number of port.
 
-  //
-  // Enable 64-bit DMA support in the PCI layer if this controller
-  // supports it.
-  //
-  if ((Capability & EFI_AHCI_CAP_S64A) != 0) {
-    Status = PciIo->Attributes (
-                      PciIo,
-                      EfiPciIoAttributeOperationEnable,
-                      EFI_PCI_IO_ATTRIBUTE_DUAL_ADDRESS_CYCLE,
-                      NULL
-                      );
-    if (EFI_ERROR (Status)) {
-      DEBUG ((
-        DEBUG_WARN,
-        "AhciModeInitialization: failed to enable 64-bit DMA on 64-bit capable controller (%r)\n",
-        Status
-        ));
-    }
+**/
+VOID
+AhciPortInitFinishCommand (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN UINT8                         Port
+  )
+{
+  AhciStopCommand (Instance->PciIo, Port, ATA_ATAPI_TIMEOUT);
+  AhciDisableFisReceive (Instance->PciIo, Port, ATA_ATAPI_TIMEOUT);
+  AhciSetCommandListBase (Instance->PciIo, Port, (UINTN)Instance->AhciRegisters.AhciCmdListPciAddr);
+}
+
+/**
+  Issue the command of a port which is initialized, from the command list of
+  the port, without waiting for it to complete.
+
+  @param[in]       Instance     A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]       Port         The number of port.
+  @param[in, out]  PortInit     The initialization context of the port, which
+                                holds the command block of the command.
+  @param[in]       State        The state of the port while the command runs.
+  @param[in]       DataLength   The number of bytes the command reads into the
+                                data buffer of the port.
+  @param[in]       Timeout      The timeout value of the command, uses 100ns as a unit.
+
+**/
+VOID
+AhciPortInitIssueCommand (
+  IN     ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN     UINT8                         Port,
+  IN OUT AHCI_PORT_INIT                *PortInit,
+  IN     AHCI_PORT_INIT_STATE          State,
+  IN     UINT32                        DataLength,
+  IN     UINT64                        Timeout
+  )
+{
+  EFI_STATUS                  Status;
+  EFI_PCI_IO_PROTOCOL         *PciIo;
+  EFI_AHCI_NCQ_COMMAND_TABLE  *CommandTable;
+  EFI_AHCI_COMMAND_LIST       *CommandList;
+  DATA_64                     Data64;
+  UINT32                      Offset;
+
+  PciIo        = Instance->PciIo;
+  CommandTable = &PortInit->Buffer->CommandTable;
+  ZeroMem (CommandTable, sizeof (EFI_AHCI_NCQ_COMMAND_TABLE));
+  AhciBuildCommandFis (&CommandTable->CommandFis, &PortInit->AtaCommandBlock);
+  if (DataLength != 0) {
+    ASSERT (DataLength <= sizeof (PortInit->Buffer->Data));
+    Data64.Uint64                          = PortInit->BufferPciAddr + OFFSET_OF (AHCI_PORT_INIT_BUFFER, Data);
+    CommandTable->PrdtTable[0].AhciPrdtDba  = Data64.Uint32.Lower32;
+    CommandTable->PrdtTable[0].AhciPrdtDbau = Data64.Uint32.Upper32;
+    CommandTable->PrdtTable[0].AhciPrdtDbc  = DataLength - 1;
+    CommandTable->PrdtTable[0].AhciPrdtIoc  = 1;
   }
 
-  //
-  // Get the number of command slots per port supported by this HBA.
-  //
-  MaxPortNumber = (UINT8)((Capability & 0x1F) + 1);
+  CommandList = &PortInit->Buffer->CmdList[0];
+  ZeroMem (CommandList, sizeof (EFI_AHCI_COMMAND_LIST));
+  Data64.Uint64             = PortInit->BufferPciAddr + OFFSET_OF (AHCI_PORT_INIT_BUFFER, CommandTable);
+  CommandList->AhciCmdCfl   = EFI_AHCI_FIS_REGISTER_H2D_LENGTH / 4;
+  CommandList->AhciCmdPrdtl = (DataLength != 0) ? 1 : 0;
+  CommandList->AhciCmdCtba  = Data64.Uint32.Lower32;
+  CommandList->AhciCmdCtbau = Data64.Uint32.Upper32;
 
-  //
-  // Get the bit map of those ports exposed by this HBA.
-  // It indicates which ports that the HBA supports are available for software to use.
-  //
-  PortImplementBitMap = AhciReadReg (PciIo, EFI_AHCI_PI_OFFSET);
+  Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CMD;
+  AhciAndReg (PciIo, Offset, (UINT32) ~(EFI_AHCI_PORT_CMD_DLAE | EFI_AHCI_PORT_CMD_ATAPI));
 
-  AhciRegisters = &Instance->AhciRegisters;
-  Status        = AhciCreateTransferDescriptor (PciIo, AhciRegisters);
+  DEBUG ((DEBUG_VERBOSE, "Starting command for initialization of port %d:\n", Port));
+  AhciPrintCommandBlock (&PortInit->AtaCommandBlock, DEBUG_VERBOSE);
 
+  AhciSetCommandListBase (PciIo, Port, PortInit->BufferPciAddr);
+  Status = AhciStartCommand (PciIo, Port, 0, ATA_ATAPI_TIMEOUT);
   if (EFI_ERROR (Status)) {
-    return EFI_OUT_OF_RESOURCES;
+    AhciPortInitFinishCommand (Instance, Port);
+    PortInit->State = AhciPortInitStateDone;
+    return;
   }
 
-  for (Port = 0; Port < EFI_AHCI_MAX_PORTS; Port++) {
-    if ((PortImplementBitMap & (((UINT32)BIT0) << Port)) != 0) {
-      //
-      // According to AHCI spec, MaxPortNumber should be equal or greater than the number of implemented ports.
-      //
-      if ((MaxPortNumber--) == 0) {
-        //
-        // Should never be here.
-        //
-        ASSERT (FALSE);
-        return EFI_SUCCESS;
-      }
+  PortInit->State      = State;
+  PortInit->DataLength = DataLength;
+  PortInit->Timeout    = (UINT32)DivU64x32 (Timeout, 10000);
+}
 
-      IdeInit->NotifyPhase (IdeInit, EfiIdeBeforeChannelEnumeration, Port);
+/**
+  Check the command of a port which is initialized. A command which fails is
+  retried after the port is recovered.
 
-      //
-      // Initialize FIS Base Address Register and Command List Base Address Register for use.
-      //
-      Data64.Uint64 = (UINTN)(AhciRegisters->AhciRFisPciAddr) + sizeof (EFI_AHCI_RECEIVED_FIS) * Port;
-      Offset        = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_FB;
-      AhciWriteReg (PciIo, Offset, Data64.Uint32.Lower32);
-      Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_FBU;
-      AhciWriteReg (PciIo, Offset, Data64.Uint32.Upper32);
-
-      Data64.Uint64 = (UINTN)(AhciRegisters->AhciCmdListPciAddr);
-      Offset        = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CLB;
-      AhciWriteReg (PciIo, Offset, Data64.Uint32.Lower32);
-      Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CLBU;
-      AhciWriteReg (PciIo, Offset, Data64.Uint32.Upper32);
+  @param[in]       Instance     A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]       Port         The number of port.
+  @param[in, out]  PortInit     The initialization context of the port.
 
-      Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CMD;
-      Data   = AhciReadReg (PciIo, Offset);
-      if ((Data & EFI_AHCI_PORT_CMD_CPD) != 0) {
-        AhciOrReg (PciIo, Offset, EFI_AHCI_PORT_CMD_POD);
-      }
+  @retval EFI_NOT_READY     The command is still running.
+  @retval EFI_SUCCESS       The command executes successfully.
+  @retval EFI_DEVICE_ERROR  The command abort with error occurs.
+  @retval EFI_TIMEOUT       The command is time out.
 
-      if ((Capability & EFI_AHCI_CAP_SSS) != 0) {
-        AhciOrReg (PciIo, Offset, EFI_AHCI_PORT_CMD_SUD);
-      }
+**/
+EFI_STATUS
+AhciPortInitCheckCommand (
+  IN     ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN     UINT8                         Port,
+  IN OUT AHCI_PORT_INIT                *PortInit
+  )
+{
+  EFI_STATUS           Status;
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  UINT32               Offset;
+  UINT32               PortInterrupt;
+  UINT32               PortTfd;
+  UINT32               Timeout;
+
+  PciIo         = Instance->PciIo;
+  Offset        = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_IS;
+  PortInterrupt = AhciReadReg (PciIo, Offset);
+  Offset        = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_TFD;
+  PortTfd       = AhciReadReg (PciIo, Offset);
+  Offset        = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CI;
 
-      //
-      // Disable aggressive power management.
-      //
-      Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_SCTL;
-      AhciOrReg (PciIo, Offset, EFI_AHCI_PORT_SCTL_IPM_INIT);
-      //
-      // Disable the reporting of the corresponding interrupt to system software.
-      //
-      Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_IE;
-      AhciAndReg (PciIo, Offset, 0);
+  if ((PortInterrupt & EFI_AHCI_PORT_IS_ERROR_MASK) != 0) {
+    DEBUG ((DEBUG_ERROR, "AHCI: Error interrupt reported PxIS: %X\n", PortInterrupt));
+    Status = EFI_DEVICE_ERROR;
+  } else if (((AhciReadReg (PciIo, Offset) & BIT0) == 0) && ((PortTfd & EFI_AHCI_PORT_TFD_BSY) == 0)) {
+    Status = ((PortTfd & EFI_AHCI_PORT_TFD_ERR) != 0) ? EFI_DEVICE_ERROR : EFI_SUCCESS;
+  } else if (--PortInit->Timeout == 0) {
+    Status = EFI_TIMEOUT;
+  } else {
+    return EFI_NOT_READY;
+  }
 
+  if ((Status == EFI_DEVICE_ERROR) && (PortInit->Retry < AHCI_COMMAND_RETRIES)) {
+    DEBUG ((DEBUG_ERROR, "Initialization command of port %d failed at retry %d\n", Port, PortInit->Retry));
+    PortInit->Retry++;
+    if (!EFI_ERROR (AhciRecoverPortError (PciIo, Port))) {
       //
-      // Now inform the IDE Controller Init Module.
+      // Keep the timeout of the first attempt.
       //
-      IdeInit->NotifyPhase (IdeInit, EfiIdeBusBeforeDevicePresenceDetection, Port);
+      Timeout = PortInit->Timeout;
+      AhciPortInitFinishCommand (Instance, Port);
+      AhciPortInitIssueCommand (Instance, Port, PortInit, PortInit->State, PortInit->DataLength, 0);
+      PortInit->Timeout = Timeout;
+      return (PortInit->State == AhciPortInitStateDone) ? EFI_DEVICE_ERROR : EFI_NOT_READY;
+    }
+  }
 
-      //
-      // Enable FIS Receive DMA engine for the first D2H FIS.
-      //
-      Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CMD;
-      AhciOrReg (PciIo, Offset, EFI_AHCI_PORT_CMD_FRE);
+  AhciPortInitFinishCommand (Instance, Port);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed to execute command for initialization of port %d - %r:\n", Port, Status));
+    AhciPrintCommandBlock (&PortInit->AtaCommandBlock, DEBUG_ERROR);
+  }
 
-      //
-      // Wait for the Phy to detect the presence of a device.
-      //
-      PhyDetectDelay = EFI_AHCI_BUS_PHY_DETECT_TIMEOUT;
-      Offset         = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_SSTS;
-      do {
-        Data = AhciReadReg (PciIo, Offset) & EFI_AHCI_PORT_SSTS_DET_MASK;
-        if ((Data == EFI_AHCI_PORT_SSTS_DET_PCE) || (Data == EFI_AHCI_PORT_SSTS_DET)) {
-          break;
-        }
+  return Status;
+}
 
-        MicroSecondDelay (1000);
-        PhyDetectDelay--;
-      } while (PhyDetectDelay > 0);
+/**
+  Issue the IDENTIFY DEVICE or IDENTIFY PACKET DEVICE command of a port which
+  is initialized.
 
-      if (PhyDetectDelay == 0) {
-        //
-        // No device detected at this port.
-        // Clear PxCMD.SUD for those ports at which there are no device present.
-        //
-        Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CMD;
-        AhciAndReg (PciIo, Offset, (UINT32) ~(EFI_AHCI_PORT_CMD_SUD));
-        continue;
-      }
+  @param[in]       Instance     A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]       Port         The number of port.
+  @param[in, out]  PortInit     The initialization context of the port.
 
-      Status = AhciWaitDeviceReady (PciIo, Port);
-      if (EFI_ERROR (Status)) {
-        continue;
-      }
+**/
+VOID
+AhciPortInitIdentify (
+  IN     ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN     UINT8                         Port,
+  IN OUT AHCI_PORT_INIT                *PortInit
+  )
+{
+  ZeroMem (&PortInit->AtaCommandBlock, sizeof (EFI_ATA_COMMAND_BLOCK));
+  ZeroMem (&PortInit->Buffer->Data, sizeof (EFI_IDENTIFY_DATA));
 
-      //
-      // When the first D2H register FIS is received, the content of PxSIG register is updated.
-      //
-      Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_SIG;
-      Status = AhciWaitMmioSet (
-                 PciIo,
-                 Offset,
-                 0x0000FFFF,
-                 0x00000101,
-                 EFI_TIMER_PERIOD_SECONDS (16)
-                 );
-      if (EFI_ERROR (Status)) {
-        continue;
-      }
+  if (PortInit->DeviceType == EfiIdeCdrom) {
+    PortInit->AtaCommandBlock.AtaCommand = ATA_CMD_IDENTIFY_DEVICE;
+  } else {
+    PortInit->AtaCommandBlock.AtaCommand = ATA_CMD_IDENTIFY_DRIVE;
+  }
 
-      Data = AhciReadReg (PciIo, Offset);
-      if ((Data & EFI_AHCI_ATAPI_SIG_MASK) == EFI_AHCI_ATAPI_DEVICE_SIG) {
-        Status = AhciIdentifyPacket (PciIo, AhciRegisters, Port, 0, &Buffer);
+  PortInit->AtaCommandBlock.AtaSectorCount = 1;
 
-        if (EFI_ERROR (Status)) {
-          continue;
-        }
+  PortInit->Retry = 0;
+  AhciPortInitIssueCommand (Instance, Port, PortInit, AhciPortInitStateIdentify, sizeof (EFI_IDENTIFY_DATA), ATA_ATAPI_TIMEOUT);
+}
 
-        DeviceType = EfiIdeCdrom;
-      } else if ((Data & EFI_AHCI_ATAPI_SIG_MASK) == EFI_AHCI_ATA_DEVICE_SIG) {
-        Status = AhciIdentify (PciIo, AhciRegisters, Port, 0, &Buffer);
+/**
+  Issue the command which spins up the disk of a port which is initialized,
+  because its IDENTIFY DEVICE data is incomplete or its PUIS feature is enabled.
 
-        if (EFI_ERROR (Status)) {
-          REPORT_STATUS_CODE (EFI_PROGRESS_CODE, (EFI_PERIPHERAL_FIXED_MEDIA | EFI_P_EC_NOT_DETECTED));
-          continue;
-        }
+  @param[in]       Instance     A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]       Port         The number of port.
+  @param[in, out]  PortInit     The initialization context of the port.
 
-        DEBUG ((
-          DEBUG_INFO,
-          "IDENTIFY DEVICE: [0] = %016x, [2] = %016x, [83] = %016x, [86] = %016x\n",
-          Buffer.AtaData.config,
-          Buffer.AtaData.specific_config,
-          Buffer.AtaData.command_set_supported_83,
-          Buffer.AtaData.command_set_feature_enb_86
-          ));
-        if ((Buffer.AtaData.config & BIT2) != 0) {
-          //
-          // SpinUp disk if device reported incomplete IDENTIFY DEVICE.
-          //
-          Status = AhciSpinUpDisk (
-                     PciIo,
-                     AhciRegisters,
-                     Port,
-                     0,
-                     &Buffer
-                     );
-          if (EFI_ERROR (Status)) {
-            DEBUG ((DEBUG_ERROR, "Spin up standby device failed - %r\n", Status));
-            continue;
-          }
-        }
+**/
+VOID
+AhciPortInitSpinUp (
+  IN     ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN     UINT8                         Port,
+  IN OUT AHCI_PORT_INIT                *PortInit
+  )
+{
+  UINT32  DataLength;
 
-        DeviceType = EfiIdeHarddisk;
-      } else {
-        continue;
-      }
+  ZeroMem (&PortInit->AtaCommandBlock, sizeof (EFI_ATA_COMMAND_BLOCK));
 
-      DEBUG ((
-        DEBUG_INFO,
-        "port [%d] port multitplier [%d] has a [%a]\n",
-        Port,
-        0,
-        DeviceType == EfiIdeCdrom ? "cdrom" : "harddisk"
-        ));
+  if (PortInit->Buffer->Data.AtaData.specific_config == ATA_SPINUP_CFG_REQUIRED_IDD_INCOMPLETE) {
+    //
+    // Use SET_FEATURE subcommand to spin up the device.
+    //
+    PortInit->AtaCommandBlock.AtaCommand  = ATA_CMD_SET_FEATURES;
+    PortInit->AtaCommandBlock.AtaFeatures = ATA_SUB_CMD_PUIS_SET_DEVICE_SPINUP;
+    DataLength                            = 0;
+  } else {
+    ASSERT (PortInit->Buffer->Data.AtaData.specific_config == ATA_SPINUP_CFG_NOT_REQUIRED_IDD_INCOMPLETE);
 
-      //
-      // If the device is a hard disk, then try to enable S.M.A.R.T feature
-      //
-      if ((DeviceType == EfiIdeHarddisk) && PcdGetBool (PcdAtaSmartEnable)) {
-        AhciAtaSmartSupport (
-          PciIo,
-          AhciRegisters,
-          Port,
-          0,
-          &Buffer,
-          NULL
-          );
-      }
+    //
+    // Use READ_SECTORS to spin up the device if SpinUp SET FEATURE subcommand is not supported:
+    // perform READ SECTORS PIO Data-In command to Read LBA 0.
+    //
+    PortInit->AtaCommandBlock.AtaCommand     = ATA_CMD_READ_SECTORS;
+    PortInit->AtaCommandBlock.AtaSectorCount = 0x1;
+    DataLength                               = 0x200;
+  }
 
-      //
-      // Submit identify data to IDE controller init driver
-      //
-      IdeInit->SubmitData (IdeInit, Port, 0, &Buffer);
+  PortInit->Retry = 0;
+  AhciPortInitIssueCommand (Instance, Port, PortInit, AhciPortInitStateSpinUp, DataLength, ATA_SPINUP_TIMEOUT);
+}
 
-      //
-      // Now start to config ide device parameter and transfer mode.
-      //
-      Status = IdeInit->CalculateMode (
-                          IdeInit,
-                          Port,
-                          0,
-                          &SupportedModes
-                          );
-      if (EFI_ERROR (Status)) {
-        DEBUG ((DEBUG_ERROR, "Calculate Mode Fail, Status = %r\n", Status));
-        continue;
+/**
+  Configure the device of a port which is identified: set its transfer mode
+  and features, and add it into the device list.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  Port              The number of port.
+  @param[in]  DeviceType        The type of the device.
+  @param[in]  Buffer            The IDENTIFY data of the device.
+
+**/
+VOID
+AhciPortInitConfigure (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN UINT8                         Port,
+  IN EFI_ATA_DEVICE_TYPE           DeviceType,
+  IN EFI_IDENTIFY_DATA             *Buffer
+  )
+{
+  EFI_STATUS                        Status;
+  EFI_PCI_IO_PROTOCOL               *PciIo;
+  EFI_IDE_CONTROLLER_INIT_PROTOCOL  *IdeInit;
+  EFI_AHCI_REGISTERS                *AhciRegisters;
+  EFI_ATA_COLLECTIVE_MODE           *SupportedModes;
+  EFI_ATA_TRANSFER_MODE             TransferMode;
+
+  PciIo         = Instance->PciIo;
+  IdeInit       = Instance->IdeControllerInit;
+  AhciRegisters = &Instance->AhciRegisters;
+
+  DEBUG ((
+    DEBUG_INFO,
+    "port [%d] port multitplier [%d] has a [%a]\n",
+    Port,
+    0,
+    DeviceType == EfiIdeCdrom ? "cdrom" : "harddisk"
+    ));
+
+  //
+  // If the device is a hard disk, then try to enable S.M.A.R.T feature
+  //
+  if ((DeviceType == EfiIdeHarddisk) && PcdGetBool (PcdAtaSmartEnable)) {
+    AhciAtaSmartSupport (
+      PciIo,
+      AhciRegisters,
+      Port,
+      0,
+      Buffer,
+      NULL
+      );
+  }
+
+  //
+  // Submit identify data to IDE controller init driver
+  //
+  IdeInit->SubmitData (IdeInit, Port, 0, Buffer);
+
+  //
+  // Now start to config ide device parameter and transfer mode.
+  //
+  Status = IdeInit->CalculateMode (
+                      IdeInit,
+                      Port,
+                      0,
+                      &SupportedModes
+                      );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Calculate Mode Fail, Status = %r\n", Status));
+    return;
+  }
+
+  //
+  // Set best supported PIO mode on this IDE device
+  //
+  if (SupportedModes->PioMode.Mode <= EfiAtaPioMode2) {
+    TransferMode.ModeCategory = EFI_ATA_MODE_DEFAULT_PIO;
+  } else {
+    TransferMode.ModeCategory = EFI_ATA_MODE_FLOW_PIO;
+  }
+
+  TransferMode.ModeNumber = (UINT8)(SupportedModes->PioMode.Mode);
+
+  //
+  // Set supported DMA mode on this IDE device. Note that UDMA & MDMA can't
+  // be set together. Only one DMA mode can be set to a device. If setting
+  // DMA mode operation fails, we can continue moving on because we only use
+  // PIO mode at boot time. DMA modes are used by certain kind of OS booting
+  //
+  if (SupportedModes->UdmaMode.Valid) {
+    TransferMode.ModeCategory = EFI_ATA_MODE_UDMA;
+    TransferMode.ModeNumber   = (UINT8)(SupportedModes->UdmaMode.Mode);
+  } else if (SupportedModes->MultiWordDmaMode.Valid) {
+    TransferMode.ModeCategory = EFI_ATA_MODE_MDMA;
+    TransferMode.ModeNumber   = (UINT8)SupportedModes->MultiWordDmaMode.Mode;
+  }
+
+  Status = AhciDeviceSetFeature (PciIo, AhciRegisters, Port, 0, 0x03, (UINT32)(*(UINT8 *)&TransferMode), ATA_ATAPI_TIMEOUT);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Set transfer Mode Fail, Status = %r\n", Status));
+    return;
+  }
+
+  //
+  // Found a ATA or ATAPI device, add it into the device list.
+  //
+  CreateNewDeviceInfo (Instance, Port, 0xFFFF, DeviceType, Buffer);
+  if (DeviceType == EfiIdeHarddisk) {
+    REPORT_STATUS_CODE (EFI_PROGRESS_CODE, (EFI_PERIPHERAL_FIXED_MEDIA | EFI_P_PC_ENABLE));
+    AhciEnableDevSlp (
+      PciIo,
+      AhciRegisters,
+      Port,
+      0,
+      Buffer
+      );
+    AhciNcqCreatePort (Instance, Port, Buffer);
+  }
+
+  //
+  // Enable/disable PUIS according to policy setting if PUIS is capable (Word[83].BIT5 is set).
+  //
+  if ((Buffer->AtaData.command_set_supported_83 & BIT5) != 0) {
+    Status = AhciPuisEnable (
+               PciIo,
+               AhciRegisters,
+               Port,
+               0
+               );
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "PUIS enable/disable failed, Status = %r\n", Status));
+    }
+  }
+}
+
+/**
+  Start the initialization of a port: set up its registers and enable the
+  detection of its device.
+
+  @param[in]       Instance     A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]       Port         The number of port.
+  @param[in]       Capability   The HBA capabilities.
+  @param[in, out]  PortInit     The initialization context of the port.
+
+**/
+VOID
+AhciPortInitStart (
+  IN     ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN     UINT8                         Port,
+  IN     UINT32                        Capability,
+  IN OUT AHCI_PORT_INIT                *PortInit
+  )
+{
+  EFI_PCI_IO_PROTOCOL               *PciIo;
+  EFI_IDE_CONTROLLER_INIT_PROTOCOL  *IdeInit;
+  EFI_AHCI_REGISTERS                *AhciRegisters;
+  DATA_64                           Data64;
+  UINT32                            Offset;
+  UINT32                            Data;
+
+  PciIo         = Instance->PciIo;
+  IdeInit       = Instance->IdeControllerInit;
+  AhciRegisters = &Instance->AhciRegisters;
+
+  IdeInit->NotifyPhase (IdeInit, EfiIdeBeforeChannelEnumeration, Port);
+
+  //
+  // Initialize FIS Base Address Register and Command List Base Address Register for use.
+  //
+  Data64.Uint64 = (UINTN)(AhciRegisters->AhciRFisPciAddr) + sizeof (EFI_AHCI_RECEIVED_FIS) * Port;
+  Offset        = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_FB;
+  AhciWriteReg (PciIo, Offset, Data64.Uint32.Lower32);
+  Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_FBU;
+  AhciWriteReg (PciIo, Offset, Data64.Uint32.Upper32);
+
+  AhciSetCommandListBase (PciIo, Port, (UINTN)AhciRegisters->AhciCmdListPciAddr);
+
+  Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CMD;
+  Data   = AhciReadReg (PciIo, Offset);
+  if ((Data & EFI_AHCI_PORT_CMD_CPD) != 0) {
+    AhciOrReg (PciIo, Offset, EFI_AHCI_PORT_CMD_POD);
+  }
+
+  if ((Capability & EFI_AHCI_CAP_SSS) != 0) {
+    AhciOrReg (PciIo, Offset, EFI_AHCI_PORT_CMD_SUD);
+  }
+
+  //
+  // Disable aggressive power management.
+  //
+  Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_SCTL;
+  AhciOrReg (PciIo, Offset, EFI_AHCI_PORT_SCTL_IPM_INIT);
+  //
+  // Disable the reporting of the corresponding interrupt to system software.
+  //
+  Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_IE;
+  AhciAndReg (PciIo, Offset, 0);
+
+  //
+  // Now inform the IDE Controller Init Module.
+  //
+  IdeInit->NotifyPhase (IdeInit, EfiIdeBusBeforeDevicePresenceDetection, Port);
+
+  //
+  // Enable FIS Receive DMA engine for the first D2H FIS.
+  //
+  Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CMD;
+  AhciOrReg (PciIo, Offset, EFI_AHCI_PORT_CMD_FRE);
+
+  //
+  // Wait for the Phy to detect the presence of a device.
+  //
+  PortInit->State   = AhciPortInitStatePhyDetect;
+  PortInit->Timeout = EFI_AHCI_BUS_PHY_DETECT_TIMEOUT;
+}
+
+/**
+  Move the initialization of a port on. It is called every millisecond until
+  the port reaches the AhciPortInitStateDone state, and never waits itself for
+  the device, so that all the ports are initialized at the same time.
+
+  @param[in]       Instance     A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]       Port         The number of port.
+  @param[in, out]  PortInit     The initialization context of the port.
+
+**/
+VOID
+AhciPortInitStep (
+  IN     ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN     UINT8                         Port,
+  IN OUT AHCI_PORT_INIT                *PortInit
+  )
+{
+  EFI_STATUS           Status;
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  EFI_IDENTIFY_DATA    *Buffer;
+  UINT32               Offset;
+  UINT32               Data;
+
+  PciIo  = Instance->PciIo;
+  Buffer = &PortInit->Buffer->Data;
+
+  switch (PortInit->State) {
+    case AhciPortInitStatePhyDetect:
+      Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_SSTS;
+      Data   = AhciReadReg (PciIo, Offset) & EFI_AHCI_PORT_SSTS_DET_MASK;
+      if ((Data == EFI_AHCI_PORT_SSTS_DET_PCE) || (Data == EFI_AHCI_PORT_SSTS_DET)) {
+        //
+        // According to SATA1.0a spec section 5.2, we need to wait for PxTFD.BSY and PxTFD.DRQ
+        // and PxTFD.ERR to be zero. The maximum wait time is 16s which is defined at ATA spec.
+        //
+        PortInit->State   = AhciPortInitStateWaitReady;
+        PortInit->Timeout = 16 * 1000;
+      } else if (--PortInit->Timeout == 0) {
+        //
+        // No device detected at this port.
+        // Clear PxCMD.SUD for those ports at which there are no device present.
+        //
+        Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CMD;
+        AhciAndReg (PciIo, Offset, (UINT32) ~(EFI_AHCI_PORT_CMD_SUD));
+        PortInit->State = AhciPortInitStateDone;
       }
 
-      //
-      // Set best supported PIO mode on this IDE device
-      //
-      if (SupportedModes->PioMode.Mode <= EfiAtaPioMode2) {
-        TransferMode.ModeCategory = EFI_ATA_MODE_DEFAULT_PIO;
+      break;
+
+    case AhciPortInitStateWaitReady:
+      Data = AhciCheckDeviceReady (PciIo, Port);
+      if (Data == 0) {
+        //
+        // When the first D2H register FIS is received, the content of PxSIG register is updated.
+        //
+        PortInit->State   = AhciPortInitStateWaitSignature;
+        PortInit->Timeout = 16 * 1000;
+      } else if (--PortInit->Timeout == 0) {
+        DEBUG ((DEBUG_ERROR, "Port %d Device not ready (TFD=0x%X)\n", Port, Data));
+        PortInit->State = AhciPortInitStateDone;
+      }
+
+      break;
+
+    case AhciPortInitStateWaitSignature:
+      Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_SIG;
+      Data   = AhciReadReg (PciIo, Offset);
+      if ((Data & 0x0000FFFF) != 0x00000101) {
+        if (--PortInit->Timeout == 0) {
+          PortInit->State = AhciPortInitStateDone;
+        }
+
+        break;
+      }
+
+      if ((Data & EFI_AHCI_ATAPI_SIG_MASK) == EFI_AHCI_ATAPI_DEVICE_SIG) {
+        PortInit->DeviceType = EfiIdeCdrom;
+      } else if ((Data & EFI_AHCI_ATAPI_SIG_MASK) == EFI_AHCI_ATA_DEVICE_SIG) {
+        PortInit->DeviceType = EfiIdeHarddisk;
       } else {
-        TransferMode.ModeCategory = EFI_ATA_MODE_FLOW_PIO;
+        PortInit->State = AhciPortInitStateDone;
+        break;
       }
 
-      TransferMode.ModeNumber = (UINT8)(SupportedModes->PioMode.Mode);
+      AhciPortInitIdentify (Instance, Port, PortInit);
+      break;
 
-      //
-      // Set supported DMA mode on this IDE device. Note that UDMA & MDMA can't
-      // be set together. Only one DMA mode can be set to a device. If setting
-      // DMA mode operation fails, we can continue moving on because we only use
-      // PIO mode at boot time. DMA modes are used by certain kind of OS booting
-      //
-      if (SupportedModes->UdmaMode.Valid) {
-        TransferMode.ModeCategory = EFI_ATA_MODE_UDMA;
-        TransferMode.ModeNumber   = (UINT8)(SupportedModes->UdmaMode.Mode);
-      } else if (SupportedModes->MultiWordDmaMode.Valid) {
-        TransferMode.ModeCategory = EFI_ATA_MODE_MDMA;
-        TransferMode.ModeNumber   = (UINT8)SupportedModes->MultiWordDmaMode.Mode;
+    case AhciPortInitStateSpinUp:
+      Status = AhciPortInitCheckCommand (Instance, Port, PortInit);
+      if (Status == EFI_NOT_READY) {
+        break;
       }
 
-      Status = AhciDeviceSetFeature (PciIo, AhciRegisters, Port, 0, 0x03, (UINT32)(*(UINT8 *)&TransferMode), ATA_ATAPI_TIMEOUT);
+      DEBUG ((
+        DEBUG_INFO,
+        "Spin up device at port [%d] PortMultiplier [%d] with command 0x%x - %r!\n",
+        Port,
+        0,
+        PortInit->AtaCommandBlock.AtaCommand,
+        Status
+        ));
       if (EFI_ERROR (Status)) {
-        DEBUG ((DEBUG_ERROR, "Set transfer Mode Fail, Status = %r\n", Status));
-        continue;
+        DEBUG ((DEBUG_ERROR, "Spin up standby device failed - %r\n", Status));
+        PortInit->State = AhciPortInitStateDone;
+        break;
       }
 
       //
-      // Found a ATA or ATAPI device, add it into the device list.
+      // Read the complete IDENTIFY DEVICE data.
       //
-      CreateNewDeviceInfo (Instance, Port, 0xFFFF, DeviceType, &Buffer);
-      if (DeviceType == EfiIdeHarddisk) {
-        REPORT_STATUS_CODE (EFI_PROGRESS_CODE, (EFI_PERIPHERAL_FIXED_MEDIA | EFI_P_PC_ENABLE));
-        AhciEnableDevSlp (
-          PciIo,
-          AhciRegisters,
-          Port,
-          0,
-          &Buffer
-          );
+      AhciPortInitIdentify (Instance, Port, PortInit);
+      break;
+
+    case AhciPortInitStateIdentify:
+      Status = AhciPortInitCheckCommand (Instance, Port, PortInit);
+      if (Status == EFI_NOT_READY) {
+        break;
       }
 
-      //
-      // Enable/disable PUIS according to policy setting if PUIS is capable (Word[83].BIT5 is set).
-      //
-      if ((Buffer.AtaData.command_set_supported_83 & BIT5) != 0) {
-        Status = AhciPuisEnable (
-                   PciIo,
-                   AhciRegisters,
-                   Port,
-                   0
-                   );
-        if (EFI_ERROR (Status)) {
-          DEBUG ((DEBUG_ERROR, "PUIS enable/disable failed, Status = %r\n", Status));
-          continue;
+      PortInit->State = AhciPortInitStateDone;
+      if (EFI_ERROR (Status)) {
+        if (PortInit->SpunUp) {
+          DEBUG ((
+            DEBUG_ERROR,
+            "Read IDD failed for device at port [%d] PortMultiplier [%d] - %r!\n",
+            Port,
+            0,
+            Status
+            ));
+        } else if (PortInit->DeviceType == EfiIdeHarddisk) {
+          REPORT_STATUS_CODE (EFI_PROGRESS_CODE, (EFI_PERIPHERAL_FIXED_MEDIA | EFI_P_EC_NOT_DETECTED));
+        }
+
+        break;
+      }
+
+      if (PortInit->DeviceType == EfiIdeHarddisk) {
+        DEBUG ((
+          DEBUG_INFO,
+          "IDENTIFY DEVICE: [0] = %016x, [2] = %016x, [83] = %016x, [86] = %016x\n",
+          Buffer->AtaData.config,
+          Buffer->AtaData.specific_config,
+          Buffer->AtaData.command_set_supported_83,
+          Buffer->AtaData.command_set_feature_enb_86
+          ));
+        if ((Buffer->AtaData.config & BIT2) != 0) {
+          if (PortInit->SpunUp) {
+            DEBUG ((DEBUG_ERROR, "Spin up standby device failed - %r\n", EFI_DEVICE_ERROR));
+            break;
+          }
+
+          //
+          // SpinUp disk if device reported incomplete IDENTIFY DEVICE.
+          //
+          PortInit->SpunUp = TRUE;
+          AhciPortInitSpinUp (Instance, Port, PortInit);
+          break;
         }
       }
+
+      AhciPortInitConfigure (Instance, Port, PortInit->DeviceType, Buffer);
+      break;
+
+    default:
+      break;
+  }
+}
+
+/**
+  Initialize a port and the device attached to it, waiting for each step of
+  the initialization before the next one.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  Port              The number of port.
+  @param[in]  Capability        The HBA capabilities.
+
+**/
+VOID
+AhciModeInitializePort (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN UINT8                         Port,
+  IN UINT32                        Capability
+  )
+{
+  EFI_STATUS           Status;
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  EFI_AHCI_REGISTERS   *AhciRegisters;
+  AHCI_PORT_INIT       PortInit;
+  UINT32               Offset;
+  UINT32               Data;
+  UINT32               PhyDetectDelay;
+  EFI_IDENTIFY_DATA    Buffer;
+  EFI_ATA_DEVICE_TYPE  DeviceType;
+
+  PciIo         = Instance->PciIo;
+  AhciRegisters = &Instance->AhciRegisters;
+
+  ZeroMem (&PortInit, sizeof (PortInit));
+  AhciPortInitStart (Instance, Port, Capability, &PortInit);
+
+  //
+  // Wait for the Phy to detect the presence of a device.
+  //
+  PhyDetectDelay = EFI_AHCI_BUS_PHY_DETECT_TIMEOUT;
+  Offset         = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_SSTS;
+  do {
+    Data = AhciReadReg (PciIo, Offset) & EFI_AHCI_PORT_SSTS_DET_MASK;
+    if ((Data == EFI_AHCI_PORT_SSTS_DET_PCE) || (Data == EFI_AHCI_PORT_SSTS_DET)) {
+      break;
     }
+
+    MicroSecondDelay (1000);
+    PhyDetectDelay--;
+  } while (PhyDetectDelay > 0);
+
+  if (PhyDetectDelay == 0) {
+    //
+    // No device detected at this port.
+    // Clear PxCMD.SUD for those ports at which there are no device present.
+    //
+    Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CMD;
+    AhciAndReg (PciIo, Offset, (UINT32) ~(EFI_AHCI_PORT_CMD_SUD));
+    return;
   }
 
-  return EFI_SUCCESS;
+  Status = AhciWaitDeviceReady (PciIo, Port);
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+
+  //
+  // When the first D2H register FIS is received, the content of PxSIG register is updated.
+  //
+  Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_SIG;
+  Status = AhciWaitMmioSet (
+             PciIo,
+             Offset,
+             0x0000FFFF,
+             0x00000101,
+             EFI_TIMER_PERIOD_SECONDS (16)
+             );
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+
+  Data = AhciReadReg (PciIo, Offset);
+  if ((Data & EFI_AHCI_ATAPI_SIG_MASK) == EFI_AHCI_ATAPI_DEVICE_SIG) {
+    Status = AhciIdentifyPacket (PciIo, AhciRegisters, Port, 0, &Buffer);
+
+    if (EFI_ERROR (Status)) {
+      return;
+    }
+
+    DeviceType = EfiIdeCdrom;
+  } else if ((Data & EFI_AHCI_ATAPI_SIG_MASK) == EFI_AHCI_ATA_DEVICE_SIG) {
+    Status = AhciIdentify (PciIo, AhciRegisters, Port, 0, &Buffer);
+
+    if (EFI_ERROR (Status)) {
+      REPORT_STATUS_CODE (EFI_PROGRESS_CODE, (EFI_PERIPHERAL_FIXED_MEDIA | EFI_P_EC_NOT_DETECTED));
+      return;
+    }
+
+    DEBUG ((
+      DEBUG_INFO,
+      "IDENTIFY DEVICE: [0] = %016x, [2] = %016x, [83] = %016x, [86] = %016x\n",
+      Buffer.AtaData.config,
+      Buffer.AtaData.specific_config,
+      Buffer.AtaData.command_set_supported_83,
+      Buffer.AtaData.command_set_feature_enb_86
+      ));
+    if ((Buffer.AtaData.config & BIT2) != 0) {
+      //
+      // SpinUp disk if device reported incomplete IDENTIFY DEVICE.
+      //
+      Status = AhciSpinUpDisk (
+                 PciIo,
+                 AhciRegisters,
+                 Port,
+                 0,
+                 &Buffer
+                 );
+      if (EFI_ERROR (Status)) {
+        DEBUG ((DEBUG_ERROR, "Spin up standby device failed - %r\n", Status));
+        return;
+      }
+    }
+
+    DeviceType = EfiIdeHarddisk;
+  } else {
+    return;
+  }
+
+  AhciPortInitConfigure (Instance, Port, DeviceType, &Buffer);
+}
+
+/**
+  Initialize ATA host controller at AHCI mode.
+
+  The function is designed to initialize ATA host controller. When
+  PcdAtaAhciParallelPortInitEnable is TRUE, the ports are initialized at the
+  same time, so that it takes as long as the slowest port. Otherwise they are
+  initialized one after another.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+
+**/
+EFI_STATUS
+EFIAPI
+AhciModeInitialization (
+  IN  ATA_ATAPI_PASS_THRU_INSTANCE  *Instance
+  )
+{
+  EFI_STATUS           Status;
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  UINT32               Capability;
+  UINT8                MaxPortNumber;
+  UINT32               PortImplementBitMap;
+
+  EFI_AHCI_REGISTERS  *AhciRegisters;
+
+  UINT8                 Port;
+  UINT32                Value;
+  AHCI_PORT_INIT        PortInit[EFI_AHCI_MAX_PORTS];
+  UINT32                PendingPorts;
+  UINTN                 InitPages;
+  VOID                  *InitBuffer;
+  EFI_PHYSICAL_ADDRESS  InitBufferPciAddr;
+  VOID                  *InitBufferMap;
+
+  if (Instance == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  PciIo = Instance->PciIo;
+
+  Status = AhciReset (PciIo, EFI_AHCI_BUS_RESET_TIMEOUT);
+
+  if (EFI_ERROR (Status)) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  //
+  // Collect AHCI controller information
+  //
+  Capability = AhciReadReg (PciIo, EFI_AHCI_CAPABILITY_OFFSET);
+
+  //
+  // Make sure that GHC.AE bit is set before accessing any AHCI registers.
+  //
+  Value = AhciReadReg (PciIo, EFI_AHCI_GHC_OFFSET);
+
+  if ((Value & EFI_AHCI_GHC_ENABLE) == 0) {
+    AhciOrReg (PciIo, EFI_AHCI_GHC_OFFSET, EFI_AHCI_GHC_ENABLE);
+  }
+
+  //
+  // Enable 64-bit DMA support in the PCI layer if this controller
+  // supports it.
+  //
+  if ((Capability & EFI_AHCI_CAP_S64A) != 0) {
+    Status = PciIo->Attributes (
+                      PciIo,
+                      EfiPciIoAttributeOperationEnable,
+                      EFI_PCI_IO_ATTRIBUTE_DUAL_ADDRESS_CYCLE,
+                      NULL
+                      );
+    if (EFI_ERROR (Status)) {
+      DEBUG ((
+        DEBUG_WARN,
+        "AhciModeInitialization: failed to enable 64-bit DMA on 64-bit capable controller (%r)\n",
+        Status
+        ));
+    }
+  }
+
+  //
+  // Get the number of command slots per port supported by this HBA.
+  //
+  MaxPortNumber = (UINT8)((Capability & 0x1F) + 1);
+
+  //
+  // Get the bit map of those ports exposed by this HBA.
+  // It indicates which ports that the HBA supports are available for software to use.
+  //
+  PortImplementBitMap = AhciReadReg (PciIo, EFI_AHCI_PI_OFFSET);
+
+  AhciRegisters = &Instance->AhciRegisters;
+  Status        = AhciCreateTransferDescriptor (PciIo, AhciRegisters);
+
+  if (EFI_ERROR (Status)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (!FeaturePcdGet (PcdAtaAhciParallelPortInitEnable)) {
+    for (Port = 0; Port < EFI_AHCI_MAX_PORTS; Port++) {
+      if ((PortImplementBitMap & (((UINT32)BIT0) << Port)) != 0) {
+        //
+        // According to AHCI spec, MaxPortNumber should be equal or greater than the number of implemented ports.
+        //
+        if ((MaxPortNumber--) == 0) {
+          //
+          // Should never be here.
+          //
+          ASSERT (FALSE);
+          return EFI_SUCCESS;
+        }
+
+        AhciModeInitializePort (Instance, Port, Capability);
+      }
+    }
+
+    return EFI_SUCCESS;
+  }
+
+  //
+  // No port is implemented, so there is no port to initialize.
+  //
+  if (PortImplementBitMap == 0) {
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Each port issues its IDENTIFY and spin-up commands from its own page, so
+  // that the commands of the ports run at the same time.
+  //
+  InitPages = (UINTN)(HighBitSet32 (PortImplementBitMap) + 1);
+  Status    = AhciPortInitAllocateBuffers (PciIo, Capability, InitPages, &InitBuffer, &InitBufferPciAddr, &InitBufferMap);
+  if (EFI_ERROR (Status)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  ZeroMem (PortInit, sizeof (PortInit));
+  PendingPorts = 0;
+  for (Port = 0; Port < EFI_AHCI_MAX_PORTS; Port++) {
+    if ((PortImplementBitMap & (((UINT32)BIT0) << Port)) != 0) {
+      //
+      // According to AHCI spec, MaxPortNumber should be equal or greater than the number of implemented ports.
+      //
+      if ((MaxPortNumber--) == 0) {
+        //
+        // Should never be here.
+        //
+        ASSERT (FALSE);
+        break;
+      }
+
+      PortInit[Port].Buffer        = (AHCI_PORT_INIT_BUFFER *)((UINTN)InitBuffer + EFI_PAGES_TO_SIZE (Port));
+      PortInit[Port].BufferPciAddr = InitBufferPciAddr + EFI_PAGES_TO_SIZE (Port);
+      AhciPortInitStart (Instance, Port, Capability, &PortInit[Port]);
+      PendingPorts |= ((UINT32)BIT0) << Port;
+    }
+  }
+
+  //
+  // Move all the ports on every millisecond, until they are all done.
+  //
+  while (PendingPorts != 0) {
+    for (Port = 0; Port < EFI_AHCI_MAX_PORTS; Port++) {
+      if ((PendingPorts & (((UINT32)BIT0) << Port)) == 0) {
+        continue;
+      }
+
+      AhciPortInitStep (Instance, Port, &PortInit[Port]);
+      if (PortInit[Port].State == AhciPortInitStateDone) {
+        PendingPorts &= ~(((UINT32)BIT0) << Port);
+      }
+    }
+
+    if (PendingPorts != 0) {
+      MicroSecondDelay (1000);
+    }
+  }
+
+  PciIo->Unmap (PciIo, InitBufferMap);
+  PciIo->FreeBuffer (PciIo, InitPages, InitBuffer);
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Allocate the native command queuing resources of a port, if both the AHCI
+  HBA and the device attached to the port support it.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  Port              The number of port.
+  @param[in]  IdentifyData      The IDENTIFY DEVICE data of the device.
+
+  @retval EFI_SUCCESS           The port uses native command queuing.
+  @retval EFI_UNSUPPORTED       The HBA or the device does not support native
+                                command queuing.
+  @retval EFI_OUT_OF_RESOURCES  The resources could not be allocated.
+  @retval EFI_DEVICE_ERROR      The resources are not addressable by the HBA.
+
+**/
+EFI_STATUS
+EFIAPI
+AhciNcqCreatePort (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN UINT8                         Port,
+  IN EFI_IDENTIFY_DATA             *IdentifyData
+  )
+{
+  EFI_STATUS            Status;
+  EFI_PCI_IO_PROTOCOL   *PciIo;
+  AHCI_NCQ_PORT         *NcqPort;
+  UINT32                Capability;
+  UINT16                SataCapabilities;
+  VOID                  *Buffer;
+  UINTN                 Bytes;
+  UINTN                 CmdListSize;
+  EFI_PHYSICAL_ADDRESS  PciAddr;
+
+  if (!FeaturePcdGet (PcdAtaAhciNcqEnable)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  PciIo      = Instance->PciIo;
+  Capability = AhciReadReg (PciIo, EFI_AHCI_CAPABILITY_OFFSET);
+  if ((Capability & EFI_AHCI_CAP_SNCQ) == 0) {
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Word 76 of the IDENTIFY DEVICE data reports native command queuing support
+  // in bit 8. It is not implemented if it is 0x0000 or 0xFFFF.
+  //
+  SataCapabilities = IdentifyData->AtaData.serial_ata_capabilities;
+  if ((SataCapabilities == 0xFFFF) || ((SataCapabilities & BIT8) == 0)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  NcqPort = AllocateZeroPool (sizeof (AHCI_NCQ_PORT));
+  if (NcqPort == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // Use as many command slots as both the HBA and the device (word 75) support.
+  //
+  NcqPort->Depth = (UINT8)MIN (
+                            ((Capability & 0x1F00) >> 8) + 1,
+                            (IdentifyData->AtaData.queue_depth & 0x1F) + 1
+                            );
+
+  //
+  // The command list is 1KB aligned and the command tables after it are 128
+  // bytes aligned.
+  //
+  CmdListSize    = EFI_AHCI_MAX_COMMAND_SLOTS * sizeof (EFI_AHCI_COMMAND_LIST);
+  NcqPort->Pages = EFI_SIZE_TO_PAGES (CmdListSize + NcqPort->Depth * sizeof (EFI_AHCI_NCQ_COMMAND_TABLE));
+  Status         = PciIo->AllocateBuffer (
+                            PciIo,
+                            AllocateAnyPages,
+                            EfiBootServicesData,
+                            NcqPort->Pages,
+                            &Buffer,
+                            0
+                            );
+  if (EFI_ERROR (Status)) {
+    FreePool (NcqPort);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  ZeroMem (Buffer, EFI_PAGES_TO_SIZE (NcqPort->Pages));
+
+  Bytes  = EFI_PAGES_TO_SIZE (NcqPort->Pages);
+  Status = PciIo->Map (
+                    PciIo,
+                    EfiPciIoOperationBusMasterCommonBuffer,
+                    Buffer,
+                    &Bytes,
+                    &PciAddr,
+                    &NcqPort->Map
+                    );
+  if (EFI_ERROR (Status) || (Bytes != EFI_PAGES_TO_SIZE (NcqPort->Pages))) {
+    if (!EFI_ERROR (Status)) {
+      PciIo->Unmap (PciIo, NcqPort->Map);
+    }
+
+    PciIo->FreeBuffer (PciIo, NcqPort->Pages, Buffer);
+    FreePool (NcqPort);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (((Capability & EFI_AHCI_CAP_S64A) == 0) && (PciAddr + Bytes > 0x100000000ULL)) {
+    //
+    // The AHCI HBA doesn't support 64bit addressing, so should not get a >4G pci bus master address.
+    //
+    PciIo->Unmap (PciIo, NcqPort->Map);
+    PciIo->FreeBuffer (PciIo, NcqPort->Pages, Buffer);
+    FreePool (NcqPort);
+    return EFI_DEVICE_ERROR;
+  }
+
+  NcqPort->CmdList             = Buffer;
+  NcqPort->CmdListPciAddr      = PciAddr;
+  NcqPort->CommandTable        = (EFI_AHCI_NCQ_COMMAND_TABLE *)((UINTN)Buffer + CmdListSize);
+  NcqPort->CommandTablePciAddr = PciAddr + CmdListSize;
+  InitializeListHead (&NcqPort->SubmissionQueue);
+
+  Instance->NcqPort[Port] = NcqPort;
+
+  DEBUG ((DEBUG_INFO, "AHCI: port [%d] uses native command queuing, queue depth %d\n", Port, NcqPort->Depth));
+  return EFI_SUCCESS;
+}
+
+/**
+  Complete a queued command: unmap its data buffer, update its status block,
+  signal its event and free its task.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  Port              The number of port.
+  @param[in]  Task              The task of the command.
+  @param[in]  IsError           Whether the command failed.
+  @param[in]  IsSigEvent        Whether to signal the event of the task.
+
+**/
+VOID
+AhciNcqCompleteTask (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN UINT8                         Port,
+  IN ATA_NONBLOCK_TASK             *Task,
+  IN BOOLEAN                       IsError,
+  IN BOOLEAN                       IsSigEvent
+  )
+{
+  if (Task->Map != NULL) {
+    Instance->PciIo->Unmap (Instance->PciIo, Task->Map);
+    Task->Map = NULL;
+  }
+
+  AhciDumpPortStatus (Instance->PciIo, &Instance->AhciRegisters, Port, Task->Packet->Asb);
+  if (IsError) {
+    Task->Packet->Asb->AtaStatus |= BIT0;
+  }
+
+  if (IsSigEvent && (Task->Event != NULL)) {
+    gBS->SignalEvent (Task->Event);
+  }
+
+  FreePool (Task);
+}
+
+/**
+  Complete all the issued commands of a port as failed.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  NcqPort           The native command queuing state of the port.
+  @param[in]  Port              The number of port.
+  @param[in]  IsSigEvent        Whether to signal the events of the tasks.
+
+**/
+VOID
+AhciNcqAbortSlots (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN AHCI_NCQ_PORT                 *NcqPort,
+  IN UINT8                         Port,
+  IN BOOLEAN                       IsSigEvent
+  )
+{
+  UINT8  Slot;
+
+  while (NcqPort->ActiveSlots != 0) {
+    Slot                  = (UINT8)LowBitSet32 (NcqPort->ActiveSlots);
+    NcqPort->ActiveSlots &= ~(((UINT32)BIT0) << Slot);
+    AhciNcqCompleteTask (Instance, Port, NcqPort->SlotTask[Slot], TRUE, IsSigEvent);
+    NcqPort->SlotTask[Slot] = NULL;
+  }
+}
+
+/**
+  Switch a port to the native command queuing command list and start it.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  NcqPort           The native command queuing state of the port.
+  @param[in]  Port              The number of port.
+
+  @retval EFI_SUCCESS           The port is started.
+  @retval Others                The port could not be stopped to switch its command list.
+
+**/
+EFI_STATUS
+AhciNcqStartPort (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN AHCI_NCQ_PORT                 *NcqPort,
+  IN UINT8                         Port
+  )
+{
+  EFI_STATUS           Status;
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  UINT32               Capability;
+  UINT32               PortStatus;
+  UINT32               StartCmd;
+  UINT32               PortTfd;
+  UINT32               Offset;
+
+  PciIo = Instance->PciIo;
+
+  Status = AhciStopCommand (PciIo, Port, ATA_ATAPI_TIMEOUT);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  AhciSetCommandListBase (PciIo, Port, NcqPort->CmdListPciAddr);
+  AhciClearPortStatus (PciIo, Port);
+  AhciEnableFisReceive (PciIo, Port, ATA_ATAPI_TIMEOUT);
+
+  //
+  // Start the port the same way as AhciStartCommand(), without issuing a command.
+  //
+  Offset     = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CMD;
+  PortStatus = AhciReadReg (PciIo, Offset);
+
+  StartCmd = 0;
+  if ((PortStatus & EFI_AHCI_PORT_CMD_ALPE) != 0) {
+    StartCmd  = PortStatus & ~EFI_AHCI_PORT_CMD_ICC_MASK;
+    StartCmd |= EFI_AHCI_PORT_CMD_ACTIVE;
+  }
+
+  Offset  = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_TFD;
+  PortTfd = AhciReadReg (PciIo, Offset);
+
+  Capability = AhciReadReg (PciIo, EFI_AHCI_CAPABILITY_OFFSET);
+  if (((PortTfd & (EFI_AHCI_PORT_TFD_BSY | EFI_AHCI_PORT_TFD_DRQ)) != 0) && ((Capability & BIT24) != 0)) {
+    Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CMD;
+    AhciOrReg (PciIo, Offset, EFI_AHCI_PORT_CMD_CLO);
+    AhciWaitMmioSet (PciIo, Offset, EFI_AHCI_PORT_CMD_CLO, 0, ATA_ATAPI_TIMEOUT);
+  }
+
+  Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CMD;
+  AhciOrReg (PciIo, Offset, EFI_AHCI_PORT_CMD_ST | StartCmd);
+
+  NcqPort->Started = TRUE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Stop a port and switch it back to the command list shared by all ports.
+  Stopping the port clears PxCI and PxSACT.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  NcqPort           The native command queuing state of the port.
+  @param[in]  Port              The number of port.
+
+**/
+VOID
+AhciNcqStopPort (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN AHCI_NCQ_PORT                 *NcqPort,
+  IN UINT8                         Port
+  )
+{
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+
+  PciIo = Instance->PciIo;
+
+  AhciStopCommand (PciIo, Port, ATA_ATAPI_TIMEOUT);
+  AhciDisableFisReceive (PciIo, Port, ATA_ATAPI_TIMEOUT);
+  AhciSetCommandListBase (PciIo, Port, (UINTN)Instance->AhciRegisters.AhciCmdListPciAddr);
+
+  NcqPort->Started = FALSE;
+}
+
+/**
+  Recover a port from a failed or timed out queued command.
+
+  The issued commands whose PxSACT and PxCI bits are already cleared finished
+  before the error and are completed successfully. All the other issued
+  commands of the port are completed as failed: on an error, the device aborts
+  all its queued commands. If the device is still busy the port is reset,
+  otherwise the NCQ Command Error log is read to take the device out of its
+  error state.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  NcqPort           The native command queuing state of the port.
+  @param[in]  Port              The number of port.
+
+**/
+VOID
+AhciNcqRecoverPort (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN AHCI_NCQ_PORT                 *NcqPort,
+  IN UINT8                         Port
+  )
+{
+  EFI_STATUS           Status;
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  UINT32               Offset;
+  UINT32               PortTfd;
+  UINT32               Pending;
+  UINT32               Slots;
+  UINT8                Slot;
+  UINT8                Log[512];
+
+  PciIo = Instance->PciIo;
+
+  //
+  // Stopping the port clears PxSACT and PxCI: read them before.
+  //
+  Offset   = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_SACT;
+  Pending  = AhciReadReg (PciIo, Offset);
+  Offset   = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CI;
+  Pending |= AhciReadReg (PciIo, Offset);
+
+  Slots = NcqPort->ActiveSlots & ~Pending;
+  while (Slots != 0) {
+    Slot                  = (UINT8)LowBitSet32 (Slots);
+    Slots                &= ~(((UINT32)BIT0) << Slot);
+    NcqPort->ActiveSlots &= ~(((UINT32)BIT0) << Slot);
+    AhciNcqCompleteTask (Instance, Port, NcqPort->SlotTask[Slot], FALSE, TRUE);
+    NcqPort->SlotTask[Slot] = NULL;
+  }
+
+  AhciNcqStopPort (Instance, NcqPort, Port);
+  AhciNcqAbortSlots (Instance, NcqPort, Port, TRUE);
+
+  Offset  = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_TFD;
+  PortTfd = AhciReadReg (PciIo, Offset);
+  AhciClearPortStatus (PciIo, Port);
+
+  if ((PortTfd & (EFI_AHCI_PORT_TFD_BSY | EFI_AHCI_PORT_TFD_DRQ)) != 0) {
+    Status = AhciResetPort (PciIo, Port);
+  } else if ((PortTfd & EFI_AHCI_PORT_TFD_ERR) != 0) {
+    Status = AhciReadLogExt (PciIo, &Instance->AhciRegisters, Port, 0, Log, ATA_LOG_NCQ_COMMAND_ERROR, 0);
+    if (!EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "AHCI: port [%d] queued command with tag %d failed, status %x error %x\n", Port, Log[0] & 0x1F, Log[2], Log[3]));
+    } else {
+      Status = AhciResetPort (PciIo, Port);
+    }
+  } else {
+    Status = EFI_SUCCESS;
+  }
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "AHCI: failed to recover port [%d] from a queued command error - %r\n", Port, Status));
+  }
+}
+
+/**
+  Issue a queued command in a free command slot of a port.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  NcqPort           The native command queuing state of the port.
+  @param[in]  Port              The number of port.
+  @param[in]  Slot              The free command slot.
+  @param[in]  Task              The task of the command.
+
+  @retval EFI_SUCCESS           The command is issued.
+  @retval EFI_BAD_BUFFER_SIZE   The data buffer could not be mapped, or needs
+                                more PRDT entries than a command table holds.
+
+**/
+EFI_STATUS
+AhciNcqIssueTask (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN AHCI_NCQ_PORT                 *NcqPort,
+  IN UINT8                         Port,
+  IN UINT8                         Slot,
+  IN ATA_NONBLOCK_TASK             *Task
+  )
+{
+  EFI_STATUS                        Status;
+  EFI_PCI_IO_PROTOCOL               *PciIo;
+  EFI_ATA_PASS_THRU_COMMAND_PACKET  *Packet;
+  EFI_AHCI_NCQ_COMMAND_TABLE        *CommandTable;
+  EFI_AHCI_COMMAND_LIST             *CommandList;
+  EFI_PCI_IO_PROTOCOL_OPERATION     Flag;
+  BOOLEAN                           Read;
+  VOID                              *Buffer;
+  UINT32                            DataCount;
+  UINTN                             MapLength;
+  EFI_PHYSICAL_ADDRESS              PhyAddr;
+  UINT32                            PrdtNumber;
+  UINT32                            PrdtIndex;
+  UINT32                            RemainedData;
+  DATA_64                           Data64;
+  UINT32                            Offset;
+
+  PciIo  = Instance->PciIo;
+  Packet = Task->Packet;
+  Read   = (BOOLEAN)(Packet->InTransferLength != 0);
+  if (Read) {
+    Buffer    = Packet->InDataBuffer;
+    DataCount = Packet->InTransferLength;
+    Flag      = EfiPciIoOperationBusMasterWrite;
+  } else {
+    Buffer    = Packet->OutDataBuffer;
+    DataCount = Packet->OutTransferLength;
+    Flag      = EfiPciIoOperationBusMasterRead;
+  }
+
+  PrdtNumber = (UINT32)DivU64x32 ((UINT64)DataCount + EFI_AHCI_MAX_DATA_PER_PRDT - 1, EFI_AHCI_MAX_DATA_PER_PRDT);
+  if (PrdtNumber > AHCI_NCQ_MAX_PRDT) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  MapLength = DataCount;
+  Status    = PciIo->Map (PciIo, Flag, Buffer, &MapLength, &PhyAddr, &Task->Map);
+  if (EFI_ERROR (Status) || (MapLength != DataCount)) {
+    if (!EFI_ERROR (Status)) {
+      PciIo->Unmap (PciIo, Task->Map);
+    }
+
+    Task->Map = NULL;
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  CommandTable = &NcqPort->CommandTable[Slot];
+  ZeroMem (CommandTable, sizeof (EFI_AHCI_NCQ_COMMAND_TABLE));
+
+  //
+  // The sector count of a READ/WRITE FPDMA QUEUED command is in the feature
+  // register, and its tag, the command slot, in bits 7:3 of the sector count.
+  // Bit 7 of the device register is the FUA bit rather than an obsolete bit.
+  //
+  AhciBuildCommandFis (&CommandTable->CommandFis, Packet->Acb);
+  CommandTable->CommandFis.AhciCFisSecCount = (UINT8)(Slot << 3);
+  CommandTable->CommandFis.AhciCFisDevHead  = (UINT8)((Packet->Acb->AtaDeviceHead & BIT7) | BIT6);
+
+  RemainedData = DataCount;
+  for (PrdtIndex = 0; PrdtIndex < PrdtNumber; PrdtIndex++) {
+    CommandTable->PrdtTable[PrdtIndex].AhciPrdtDbc  = MIN (RemainedData, EFI_AHCI_MAX_DATA_PER_PRDT) - 1;
+    Data64.Uint64                                   = PhyAddr + (UINT64)PrdtIndex * EFI_AHCI_MAX_DATA_PER_PRDT;
+    CommandTable->PrdtTable[PrdtIndex].AhciPrdtDba  = Data64.Uint32.Lower32;
+    CommandTable->PrdtTable[PrdtIndex].AhciPrdtDbau = Data64.Uint32.Upper32;
+    RemainedData                                   -= MIN (RemainedData, EFI_AHCI_MAX_DATA_PER_PRDT);
+  }
+
+  if (PrdtNumber > 0) {
+    CommandTable->PrdtTable[PrdtNumber - 1].AhciPrdtIoc = 1;
+  }
+
+  CommandList = &NcqPort->CmdList[Slot];
+  ZeroMem (CommandList, sizeof (EFI_AHCI_COMMAND_LIST));
+  Data64.Uint64             = NcqPort->CommandTablePciAddr + Slot * sizeof (EFI_AHCI_NCQ_COMMAND_TABLE);
+  CommandList->AhciCmdCfl   = EFI_AHCI_FIS_REGISTER_H2D_LENGTH / 4;
+  CommandList->AhciCmdW     = Read ? 0 : 1;
+  CommandList->AhciCmdPrdtl = PrdtNumber;
+  CommandList->AhciCmdCtba  = Data64.Uint32.Lower32;
+  CommandList->AhciCmdCtbau = Data64.Uint32.Upper32;
+
+  DEBUG ((DEBUG_VERBOSE, "Issuing queued command in slot %d of port %d:\n", Slot, Port));
+  AhciPrintCommandBlock (Packet->Acb, DEBUG_VERBOSE);
+
+  //
+  // PxSACT must be set before PxCI. Both ignore the bits written with 0.
+  //
+  Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_SACT;
+  AhciWriteReg (PciIo, Offset, ((UINT32)BIT0) << Slot);
+  Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CI;
+  AhciWriteReg (PciIo, Offset, ((UINT32)BIT0) << Slot);
+
+  Task->Slot                   = Slot;
+  Task->IsStart                = TRUE;
+  NcqPort->SlotTask[Slot]      = Task;
+  NcqPort->SlotIssueTime[Slot] = GetPerformanceCounter ();
+  NcqPort->ActiveSlots   |= ((UINT32)BIT0) << Slot;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Get the elapsed time since a performance counter value.
+
+  @param[in]  StartTime         The performance counter value to count from.
+
+  @return The elapsed time in nanoseconds.
+
+**/
+STATIC
+UINT64
+AhciNcqGetElapsedTime (
+  IN UINT64  StartTime
+  )
+{
+  UINT64  CurrentTime;
+  UINT64  CounterStart;
+  UINT64  CounterEnd;
+
+  CurrentTime = GetPerformanceCounter ();
+  GetPerformanceCounterProperties (&CounterStart, &CounterEnd);
+
+  //
+  // The performance counter may count down, and may wrap around.
+  //
+  if (CounterStart > CounterEnd) {
+    if (CurrentTime <= StartTime) {
+      return GetTimeInNanoSecond (StartTime - CurrentTime);
+    }
+
+    return GetTimeInNanoSecond ((StartTime - CounterEnd) + (CounterStart - CurrentTime));
+  }
+
+  if (CurrentTime >= StartTime) {
+    return GetTimeInNanoSecond (CurrentTime - StartTime);
+  }
+
+  return GetTimeInNanoSecond ((CounterEnd - StartTime) + (CurrentTime - CounterStart));
+}
+
+/**
+  Complete the finished queued commands of a port, issue its waiting ones,
+  and give the port back to the commands which are not queued when it is idle.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  Port              The number of port.
+
+**/
+VOID
+AhciNcqProcessPort (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN UINT8                         Port
+  )
+{
+  EFI_STATUS           Status;
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  AHCI_NCQ_PORT        *NcqPort;
+  ATA_NONBLOCK_TASK    *Task;
+  UINT32               Offset;
+  UINT32               PortInterrupt;
+  UINT32               Pending;
+  UINT32               Slots;
+  UINT32               FreeSlots;
+  UINT8                Slot;
+  BOOLEAN              TimedOut;
+  BOOLEAN              CanIssue;
+
+  PciIo   = Instance->PciIo;
+  NcqPort = Instance->NcqPort[Port];
+
+  if (NcqPort->ActiveSlots != 0) {
+    Offset        = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_IS;
+    PortInterrupt = AhciReadReg (PciIo, Offset);
+    if ((PortInterrupt & EFI_AHCI_PORT_IS_ERROR_MASK) != 0) {
+      DEBUG ((DEBUG_ERROR, "AHCI: Error interrupt reported PxIS: %X on queued commands\n", PortInterrupt));
+      AhciNcqRecoverPort (Instance, NcqPort, Port);
+    } else {
+      //
+      // A command is completed when its PxCI bit and its PxSACT bit are cleared.
+      //
+      Offset   = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_SACT;
+      Pending  = AhciReadReg (PciIo, Offset);
+      Offset   = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CI;
+      Pending |= AhciReadReg (PciIo, Offset);
+
+      TimedOut = FALSE;
+      Slots    = NcqPort->ActiveSlots;
+      while (Slots != 0) {
+        Slot   = (UINT8)LowBitSet32 (Slots);
+        Slots &= ~(((UINT32)BIT0) << Slot);
+        Task   = NcqPort->SlotTask[Slot];
+        if ((Pending & (((UINT32)BIT0) << Slot)) == 0) {
+          NcqPort->ActiveSlots   &= ~(((UINT32)BIT0) << Slot);
+          NcqPort->SlotTask[Slot] = NULL;
+          AhciNcqCompleteTask (Instance, Port, Task, FALSE, TRUE);
+        } else if (!Task->InfiniteWait &&
+                   (AhciNcqGetElapsedTime (NcqPort->SlotIssueTime[Slot]) > MultU64x32 (Task->Packet->Timeout, 100)))
+        {
+          //
+          // The timeout of the packet is in 100ns units, and counts from the
+          // issue of the command, however often the port is polled.
+          //
+          TimedOut = TRUE;
+        }
+      }
+
+      if (TimedOut) {
+        DEBUG ((DEBUG_ERROR, "AHCI: queued command timed out on port [%d], PxSACT|PxCI: %X\n", Port, Pending));
+        AhciNcqRecoverPort (Instance, NcqPort, Port);
+      }
+    }
+  }
+
+  //
+  // A command which is not queued, at the head of the non-blocking task list,
+  // waits for the queued commands of its port to complete: do not issue more.
+  //
+  CanIssue = TRUE;
+  if (!IsListEmpty (&Instance->NonBlockingTaskList)) {
+    Task     = ATA_NON_BLOCK_TASK_FROM_ENTRY (GetFirstNode (&Instance->NonBlockingTaskList));
+    CanIssue = (BOOLEAN)(Task->Port != Port);
+  }
+
+  while (CanIssue && !IsListEmpty (&NcqPort->SubmissionQueue)) {
+    FreeSlots = ~NcqPort->ActiveSlots & (UINT32)(LShiftU64 (1, NcqPort->Depth) - 1);
+    if (FreeSlots == 0) {
+      break;
+    }
+
+    Task = ATA_NON_BLOCK_TASK_FROM_ENTRY (GetFirstNode (&NcqPort->SubmissionQueue));
+    RemoveEntryList (&Task->Link);
+
+    Status = EFI_SUCCESS;
+    if (!NcqPort->Started) {
+      Status = AhciNcqStartPort (Instance, NcqPort, Port);
+    }
+
+    if (!EFI_ERROR (Status)) {
+      Status = AhciNcqIssueTask (Instance, NcqPort, Port, (UINT8)LowBitSet32 (FreeSlots), Task);
+    }
+
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "AHCI: failed to issue a queued command on port [%d] - %r\n", Port, Status));
+      AhciNcqCompleteTask (Instance, Port, Task, TRUE, TRUE);
+    }
+  }
+
+  if (NcqPort->Started && (NcqPort->ActiveSlots == 0) &&
+      (!CanIssue || IsListEmpty (&NcqPort->SubmissionQueue)))
+  {
+    AhciNcqStopPort (Instance, NcqPort, Port);
+  }
+}
+
+/**
+  Complete the finished queued commands and issue the waiting ones, on all the
+  ports which use native command queuing.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+
+**/
+VOID
+EFIAPI
+AhciNcqTransferRoutine (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance
+  )
+{
+  UINT8  Port;
+
+  for (Port = 0; Port < EFI_AHCI_MAX_PORTS; Port++) {
+    if (Instance->NcqPort[Port] != NULL) {
+      AhciNcqProcessPort (Instance, Port);
+    }
+  }
+}
+
+/**
+  Check whether a port is running queued commands. The commands which are not
+  queued must wait until it is not.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  Port              The number of port.
+
+  @retval TRUE                  The port is running queued commands.
+  @retval FALSE                 The port is not running queued commands.
+
+**/
+BOOLEAN
+EFIAPI
+AhciNcqIsPortBusy (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN UINT16                        Port
+  )
+{
+  return (BOOLEAN)((Port < EFI_AHCI_MAX_PORTS) &&
+                   (Instance->NcqPort[Port] != NULL) &&
+                   Instance->NcqPort[Port]->Started);
+}
+
+/**
+  Wait until all the queued commands of a port are completed.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  Port              The number of port.
+
+**/
+VOID
+EFIAPI
+AhciNcqFlushPort (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN UINT16                        Port
+  )
+{
+  AHCI_NCQ_PORT  *NcqPort;
+  EFI_TPL        OldTpl;
+
+  if ((Port >= EFI_AHCI_MAX_PORTS) || (Instance->NcqPort[Port] == NULL)) {
+    return;
+  }
+
+  NcqPort = Instance->NcqPort[Port];
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  while (NcqPort->Started || !IsListEmpty (&NcqPort->SubmissionQueue)) {
+    AsyncNonBlockingTransferRoutine (NULL, Instance);
+    //
+    // Stall for 100us.
+    //
+    MicroSecondDelay (100);
+  }
+
+  gBS->RestoreTPL (OldTpl);
+}
+
+/**
+  Send a READ/WRITE FPDMA QUEUED command to the device attached to a port.
+
+  In non-blocking mode, the task is put in the submission queue of the port and
+  issued as soon as a command slot is free; its event is signaled when the
+  command is completed. In blocking mode, the function returns when the command
+  is completed.
+
+  @param[in]       Instance     A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]       Port         The number of port.
+  @param[in, out]  Packet       The ATA pass thru command packet of the command.
+  @param[in]       Task         Optional. Pointer to the ATA_NONBLOCK_TASK
+                                used by non-blocking mode.
+
+  @retval EFI_SUCCESS           The command was completed, or queued in non-blocking mode.
+  @retval EFI_UNSUPPORTED       The port does not use native command queuing.
+  @retval EFI_INVALID_PARAMETER The packet does not describe a single data transfer.
+  @retval EFI_OUT_OF_RESOURCES  The task could not be allocated.
+  @retval EFI_DEVICE_ERROR      The command failed or timed out.
+
+**/
+EFI_STATUS
+EFIAPI
+AhciNcqTransfer (
+  IN     ATA_ATAPI_PASS_THRU_INSTANCE      *Instance,
+  IN     UINT8                             Port,
+  IN OUT EFI_ATA_PASS_THRU_COMMAND_PACKET  *Packet,
+  IN     ATA_NONBLOCK_TASK                 *Task OPTIONAL
+  )
+{
+  AHCI_NCQ_PORT  *NcqPort;
+  EFI_TPL        OldTpl;
+
+  if ((Port >= EFI_AHCI_MAX_PORTS) || (Instance->NcqPort[Port] == NULL)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if ((Packet->InTransferLength == 0) == (Packet->OutTransferLength == 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  NcqPort = Instance->NcqPort[Port];
+
+  if (Task != NULL) {
+    OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+    InsertTailList (&NcqPort->SubmissionQueue, &Task->Link);
+    //
+    // Issue the command right away if a command slot is free.
+    //
+    AhciNcqProcessPort (Instance, Port);
+    gBS->RestoreTPL (OldTpl);
+    return EFI_SUCCESS;
+  }
+
+  Task = AllocateZeroPool (sizeof (ATA_NONBLOCK_TASK));
+  if (Task == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Task->Signature      = ATA_NONBLOCKING_TASK_SIGNATURE;
+  Task->Port           = Port;
+  Task->PortMultiplier = 0xFFFF;
+  Task->Packet         = Packet;
+  Task->InfiniteWait   = (BOOLEAN)(Packet->Timeout == 0);
+
+  //
+  // The task is freed when the command is completed, and the status of the
+  // command is then in the status block of the packet.
+  //
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  InsertTailList (&NcqPort->SubmissionQueue, &Task->Link);
+  gBS->RestoreTPL (OldTpl);
+
+  AhciNcqFlushPort (Instance, Port);
+
+  if ((Packet->Asb->AtaStatus & BIT0) != 0) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Abort the queued commands of a port and free its native command queuing
+  resources.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  Port              The number of port.
+
+**/
+VOID
+EFIAPI
+AhciNcqDestroyPort (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN UINT8                         Port
+  )
+{
+  AHCI_NCQ_PORT      *NcqPort;
+  ATA_NONBLOCK_TASK  *Task;
+  EFI_TPL            OldTpl;
+
+  NcqPort = Instance->NcqPort[Port];
+  if (NcqPort == NULL) {
+    return;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  if (NcqPort->Started) {
+    AhciNcqStopPort (Instance, NcqPort, Port);
+  }
+
+  AhciNcqAbortSlots (Instance, NcqPort, Port, FALSE);
+  while (!IsListEmpty (&NcqPort->SubmissionQueue)) {
+    Task = ATA_NON_BLOCK_TASK_FROM_ENTRY (GetFirstNode (&NcqPort->SubmissionQueue));
+    RemoveEntryList (&Task->Link);
+    FreePool (Task);
+  }
+
+  Instance->NcqPort[Port] = NULL;
+  gBS->RestoreTPL (OldTpl);
+
+  Instance->PciIo->Unmap (Instance->PciIo, NcqPort->Map);
+  Instance->PciIo->FreeBuffer (Instance->PciIo, NcqPort->Pages, NcqPort->CmdList);
+  FreePool (NcqPort);
 }
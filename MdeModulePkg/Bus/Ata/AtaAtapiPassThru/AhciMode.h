@@ -14,6 +14,7 @@
 #define EFI_AHCI_CAPABILITY_OFFSET  0x0000
 #define   EFI_AHCI_CAP_SAM          BIT18
 #define   EFI_AHCI_CAP_SSS          BIT27
+#define   EFI_AHCI_CAP_SNCQ         BIT30
 #define   EFI_AHCI_CAP_S64A         BIT31
 #define EFI_AHCI_GHC_OFFSET         0x0004
 #define   EFI_AHCI_GHC_RESET        BIT0
@@ -22,7 +23,8 @@
 #define EFI_AHCI_IS_OFFSET          0x0008
 #define EFI_AHCI_PI_OFFSET          0x000C
 
-#define EFI_AHCI_MAX_PORTS  32
+#define EFI_AHCI_MAX_PORTS          32
+#define EFI_AHCI_MAX_COMMAND_SLOTS  32
 
 #define AHCI_CAPABILITY2_OFFSET  0x0024
 #define   AHCI_CAP2_SDS          BIT3
@@ -62,6 +64,12 @@ typedef union {
 //
 #define EFI_AHCI_MAX_DATA_PER_PRDT  0x400000
 
+//
+// The command tables used by native command queuing have room for the largest
+// transfer allowed by the ATA pass thru protocol: 0x10000 sectors of 4KB.
+//
+#define AHCI_NCQ_MAX_PRDT  64
+
 #define EFI_AHCI_FIS_REGISTER_H2D           0x27         // Register FIS - Host to Device
 #define   EFI_AHCI_FIS_REGISTER_H2D_LENGTH  20
 #define EFI_AHCI_FIS_REGISTER_D2H           0x34         // Register FIS - Device to Host
@@ -285,6 +293,26 @@ typedef struct {
   EFI_AHCI_COMMAND_PRDT     PrdtTable[65535];     // The scatter/gather list for data transfer
 } EFI_AHCI_COMMAND_TABLE;
 
+//
+// Command table of a command slot used by native command queuing
+//
+typedef struct {
+  EFI_AHCI_COMMAND_FIS      CommandFis;
+  EFI_AHCI_ATAPI_COMMAND    AtapiCmd;
+  UINT8                     Reserved[0x30];
+  EFI_AHCI_COMMAND_PRDT     PrdtTable[AHCI_NCQ_MAX_PRDT];
+} EFI_AHCI_NCQ_COMMAND_TABLE;
+
+//
+// Command list, command table and data buffer of the commands which a port
+// issues while it is initialized. It takes one page.
+//
+typedef struct {
+  EFI_AHCI_COMMAND_LIST         CmdList[EFI_AHCI_MAX_COMMAND_SLOTS];
+  EFI_AHCI_NCQ_COMMAND_TABLE    CommandTable;
+  EFI_IDENTIFY_DATA             Data;
+} AHCI_PORT_INIT_BUFFER;
+
 //
 // Received FIS structure
 //
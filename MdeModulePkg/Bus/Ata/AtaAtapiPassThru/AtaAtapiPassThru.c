@@ -286,6 +286,14 @@ AtaPassThruPassThruExecute (
         PortMultiplierPort = 0;
       }
 
+      //
+      // A blocking command which is not queued waits for the queued commands
+      // of the port to complete.
+      //
+      if ((Task == NULL) && (Protocol != EFI_ATA_PASS_THRU_PROTOCOL_FPDMA)) {
+        AhciNcqFlushPort (Instance, Port);
+      }
+
       switch (Protocol) {
         case EFI_ATA_PASS_THRU_PROTOCOL_ATA_NON_DATA:
           Status = AhciNonDataTransfer (
@@ -369,6 +377,14 @@ AtaPassThruPassThruExecute (
                      Task
                      );
           break;
+        case EFI_ATA_PASS_THRU_PROTOCOL_FPDMA:
+          Status = AhciNcqTransfer (
+                     Instance,
+                     (UINT8)Port,
+                     Packet,
+                     Task
+                     );
+          break;
         default:
           return EFI_UNSUPPORTED;
       }
@@ -406,6 +422,14 @@ AsyncNonBlockingTransferRoutine (
 
   Instance    = (ATA_ATAPI_PASS_THRU_INSTANCE *)Context;
   EntryHeader = &Instance->NonBlockingTaskList;
+
+  //
+  // Complete and issue the queued commands of the ports using native command
+  // queuing. They are kept in per port submission queues rather than in the
+  // list below.
+  //
+  AhciNcqTransferRoutine (Instance);
+
   //
   // Get the Tasks from the Tasks List and execute it, until there is
   // no task in the list or the device is busy with task (EFI_NOT_READY).
@@ -418,6 +442,13 @@ AsyncNonBlockingTransferRoutine (
       return;
     }
 
+    //
+    // The task waits until the queued commands of its port are completed.
+    //
+    if (AhciNcqIsPortBusy (Instance, Task->Port)) {
+      break;
+    }
+
     Status = AtaPassThruPassThruExecute (
                Task->Port,
                Task->PortMultiplier,
@@ -879,6 +910,7 @@ AtaAtapiPassThruStop (
   EFI_ATA_PASS_THRU_PROTOCOL    *AtaPassThru;
   EFI_PCI_IO_PROTOCOL           *PciIo;
   EFI_AHCI_REGISTERS            *AhciRegisters;
+  UINT8                         Port;
 
   DEBUG ((DEBUG_INFO, "==AtaAtapiPassThru Stop== Controller = %x\n", Controller));
 
@@ -929,6 +961,17 @@ AtaAtapiPassThruStop (
   }
 
   DestroyAsynTaskList (Instance, FALSE);
+
+  //
+  // Abort the queued native commands while the controller can still be
+  // accessed, before its PCI attributes are disabled below.
+  //
+  if (Instance->Mode == EfiAtaAhciMode) {
+    for (Port = 0; Port < EFI_AHCI_MAX_PORTS; Port++) {
+      AhciNcqDestroyPort (Instance, Port);
+    }
+  }
+
   //
   // Free allocated resource
   //
@@ -1296,6 +1339,7 @@ AtaPassThruPassThru (
   ATA_NONBLOCK_TASK             *Task;
   EFI_TPL                       OldTpl;
   UINT32                        BlockSize;
+  EFI_STATUS                    Status;
 
   Instance = ATA_PASS_THRU_PRIVATE_DATA_FROM_THIS (This);
 
@@ -1400,6 +1444,23 @@ AtaPassThruPassThru (
       Task->InfiniteWait = FALSE;
     }
 
+    //
+    // Queued commands go to the submission queue of their port. They are
+    // only supported in AHCI mode.
+    //
+    if (Packet->Protocol == EFI_ATA_PASS_THRU_PROTOCOL_FPDMA) {
+      Status = EFI_UNSUPPORTED;
+      if (Instance->Mode == EfiAtaAhciMode) {
+        Status = AhciNcqTransfer (Instance, (UINT8)Port, Packet, Task);
+      }
+
+      if (EFI_ERROR (Status)) {
+        FreePool (Task);
+      }
+
+      return Status;
+    }
+
     OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
     InsertTailList (&Instance->NonBlockingTaskList, &Task->Link);
     gBS->RestoreTPL (OldTpl);
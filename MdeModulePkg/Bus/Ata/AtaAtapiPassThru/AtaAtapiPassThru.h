@@ -77,6 +77,73 @@ typedef struct {
   EFI_IDENTIFY_DATA      *IdentifyData;
 } EFI_ATA_DEVICE_INFO;
 
+//
+// Native command queuing resources and state of an AHCI port
+//
+typedef struct {
+  //
+  // The command list and the command tables of the queued commands. The port
+  // uses this command list instead of the one shared by all ports while it
+  // has queued commands.
+  //
+  EFI_AHCI_COMMAND_LIST         *CmdList;
+  EFI_AHCI_NCQ_COMMAND_TABLE    *CommandTable;
+  EFI_PHYSICAL_ADDRESS          CmdListPciAddr;
+  EFI_PHYSICAL_ADDRESS          CommandTablePciAddr;
+  VOID                          *Map;
+  UINTN                         Pages;
+
+  //
+  // The number of command slots used, the lower of the HBA and device queue depths.
+  //
+  UINT8                         Depth;
+  //
+  // TRUE when the port runs with the command list above.
+  //
+  BOOLEAN                       Started;
+  //
+  // The command slots of the commands issued and not completed yet, and their tasks.
+  //
+  UINT32                        ActiveSlots;
+  ATA_NONBLOCK_TASK             *SlotTask[EFI_AHCI_MAX_COMMAND_SLOTS];
+  //
+  // The performance counter values when the commands were issued, for their timeouts.
+  //
+  UINT64                        SlotIssueTime[EFI_AHCI_MAX_COMMAND_SLOTS];
+  //
+  // The tasks waiting for a free command slot.
+  //
+  LIST_ENTRY                    SubmissionQueue;
+} AHCI_NCQ_PORT;
+
+//
+// States of a port during the initialization of the AHCI HBA. All the ports
+// go through them at the same time.
+//
+typedef enum {
+  AhciPortInitStatePhyDetect,         // Waiting for the Phy to detect a device
+  AhciPortInitStateWaitReady,         // Waiting for PxTFD.BSY, DRQ and ERR to be cleared
+  AhciPortInitStateWaitSignature,     // Waiting for the first D2H register FIS
+  AhciPortInitStateIdentify,          // IDENTIFY (PACKET) DEVICE in progress
+  AhciPortInitStateSpinUp,            // Spin-up command in progress
+  AhciPortInitStateDone
+} AHCI_PORT_INIT_STATE;
+
+typedef struct {
+  AHCI_PORT_INIT_STATE     State;
+  //
+  // Milliseconds left before the current state times out.
+  //
+  UINT32                   Timeout;
+  UINT8                    Retry;
+  BOOLEAN                  SpunUp;
+  EFI_ATA_DEVICE_TYPE      DeviceType;
+  EFI_ATA_COMMAND_BLOCK    AtaCommandBlock;
+  UINT32                   DataLength;
+  AHCI_PORT_INIT_BUFFER    *Buffer;
+  EFI_PHYSICAL_ADDRESS     BufferPciAddr;
+} AHCI_PORT_INIT;
+
 typedef struct {
   UINT32                              Signature;
 
@@ -119,6 +186,12 @@ typedef struct {
   //
   EFI_EVENT                           TimerEvent;
   LIST_ENTRY                          NonBlockingTaskList;
+
+  //
+  // For native command queuing, indexed by AHCI port. NULL for the ports which
+  // do not use it.
+  //
+  AHCI_NCQ_PORT                       *NcqPort[EFI_AHCI_MAX_PORTS];
 } ATA_ATAPI_PASS_THRU_INSTANCE;
 
 //
@@ -139,6 +212,7 @@ struct _ATA_NONBLOCK_TASK {
   VOID                                *TableMap;       // Pointer to PRD table map.
   EFI_ATA_DMA_PRD                     *MapBaseAddress; //  Pointer to range Base address for Map.
   UINTN                               PageCount;       //  The page numbers used by PCIO freebuffer.
+  UINT8                               Slot;            //  The command slot used by native command queuing.
 };
 
 //
@@ -1150,6 +1224,119 @@ AhciDmaTransfer (
   IN     ATA_NONBLOCK_TASK             *Task
   );
 
+/**
+  Allocate the native command queuing resources of a port, if both the AHCI
+  HBA and the device attached to the port support it.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  Port              The number of port.
+  @param[in]  IdentifyData      The IDENTIFY DEVICE data of the device.
+
+  @retval EFI_SUCCESS           The port uses native command queuing.
+  @retval EFI_UNSUPPORTED       The HBA or the device does not support native
+                                command queuing.
+  @retval EFI_OUT_OF_RESOURCES  The resources could not be allocated.
+  @retval EFI_DEVICE_ERROR      The resources are not addressable by the HBA.
+
+**/
+EFI_STATUS
+EFIAPI
+AhciNcqCreatePort (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN UINT8                         Port,
+  IN EFI_IDENTIFY_DATA             *IdentifyData
+  );
+
+/**
+  Abort the queued commands of a port and free its native command queuing
+  resources.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  Port              The number of port.
+
+**/
+VOID
+EFIAPI
+AhciNcqDestroyPort (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN UINT8                         Port
+  );
+
+/**
+  Send a READ/WRITE FPDMA QUEUED command to the device attached to a port.
+
+  In non-blocking mode, the task is put in the submission queue of the port and
+  issued as soon as a command slot is free; its event is signaled when the
+  command is completed. In blocking mode, the function returns when the command
+  is completed.
+
+  @param[in]       Instance     A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]       Port         The number of port.
+  @param[in, out]  Packet       The ATA pass thru command packet of the command.
+  @param[in]       Task         Optional. Pointer to the ATA_NONBLOCK_TASK
+                                used by non-blocking mode.
+
+  @retval EFI_SUCCESS           The command was completed, or queued in non-blocking mode.
+  @retval EFI_UNSUPPORTED       The port does not use native command queuing.
+  @retval EFI_INVALID_PARAMETER The packet does not describe a single data transfer.
+  @retval EFI_OUT_OF_RESOURCES  The task could not be allocated.
+  @retval EFI_DEVICE_ERROR      The command failed or timed out.
+
+**/
+EFI_STATUS
+EFIAPI
+AhciNcqTransfer (
+  IN     ATA_ATAPI_PASS_THRU_INSTANCE      *Instance,
+  IN     UINT8                             Port,
+  IN OUT EFI_ATA_PASS_THRU_COMMAND_PACKET  *Packet,
+  IN     ATA_NONBLOCK_TASK                 *Task OPTIONAL
+  );
+
+/**
+  Complete the finished queued commands and issue the waiting ones, on all the
+  ports which use native command queuing.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+
+**/
+VOID
+EFIAPI
+AhciNcqTransferRoutine (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance
+  );
+
+/**
+  Check whether a port is running queued commands. The commands which are not
+  queued must wait until it is not.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  Port              The number of port.
+
+  @retval TRUE                  The port is running queued commands.
+  @retval FALSE                 The port is not running queued commands.
+
+**/
+BOOLEAN
+EFIAPI
+AhciNcqIsPortBusy (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN UINT16                        Port
+  );
+
+/**
+  Wait until all the queued commands of a port are completed.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  Port              The number of port.
+
+**/
+VOID
+EFIAPI
+AhciNcqFlushPort (
+  IN ATA_ATAPI_PASS_THRU_INSTANCE  *Instance,
+  IN UINT16                        Port
+  );
+
 /**
   Start a PIO data transfer on specific port.
 
@@ -115,6 +115,7 @@ typedef struct {
 
   BOOLEAN                                  UdmaValid;
   BOOLEAN                                  Lba48Bit;
+  BOOLEAN                                  NcqValid;
 
   //
   // Cached data for ATA identify data
@@ -319,6 +319,16 @@ IdentifyAtaDevice (
     }
   }
 
+  //
+  // Check whether the WORD 76 (Serial ATA capabilities) reports native command queuing support
+  //
+  if (AtaDevice->UdmaValid &&
+      (IdentifyData->serial_ata_capabilities != 0xFFFF) &&
+      ((IdentifyData->serial_ata_capabilities & BIT8) != 0))
+  {
+    AtaDevice->NcqValid = TRUE;
+  }
+
   Capacity = GetAtapi6Capacity (AtaDevice);
   if (Capacity > MAX_28BIT_ADDRESSING_CAPACITY) {
     //
@@ -469,8 +479,10 @@ TransferAtaDevice (
   IN EFI_EVENT                             Event OPTIONAL
   )
 {
+  EFI_STATUS                        Status;
   EFI_ATA_COMMAND_BLOCK             *Acb;
   EFI_ATA_PASS_THRU_COMMAND_PACKET  *Packet;
+  BOOLEAN                           Queued;
 
   //
   // Ensure AtaDevice->UdmaValid, AtaDevice->Lba48Bit and IsWrite are valid boolean values
@@ -478,6 +490,13 @@ TransferAtaDevice (
   ASSERT ((UINTN)AtaDevice->UdmaValid < 2);
   ASSERT ((UINTN)AtaDevice->Lba48Bit < 2);
   ASSERT ((UINTN)IsWrite < 2);
+
+  //
+  // Non-blocking transfers use native command queuing when the device supports
+  // it, so that the device can work on several of them at the same time.
+  //
+  Queued = (BOOLEAN)((Event != NULL) && AtaDevice->NcqValid);
+
   //
   // Prepare for ATA command block.
   //
@@ -488,7 +507,21 @@ TransferAtaDevice (
   Acb->AtaCylinderHigh = (UINT8)RShiftU64 (StartLba, 16);
   Acb->AtaDeviceHead   = (UINT8)(BIT7 | BIT6 | BIT5 | (AtaDevice->PortMultiplierPort == 0xFFFF ? 0 : (AtaDevice->PortMultiplierPort << 4)));
   Acb->AtaSectorCount  = (UINT8)TransferLength;
-  if (AtaDevice->Lba48Bit) {
+  if (Queued) {
+    //
+    // READ/WRITE FPDMA QUEUED always use 48-bit LBA, and take the sector count
+    // in the feature register. The ATA host controller puts the tag of the
+    // command in the sector count register.
+    //
+    Acb->AtaCommand         = IsWrite ? ATA_CMD_WRITE_FPDMA_QUEUED : ATA_CMD_READ_FPDMA_QUEUED;
+    Acb->AtaFeatures        = (UINT8)TransferLength;
+    Acb->AtaFeaturesExp     = (UINT8)(TransferLength >> 8);
+    Acb->AtaSectorCount     = 0;
+    Acb->AtaDeviceHead      = BIT6;
+    Acb->AtaSectorNumberExp = (UINT8)RShiftU64 (StartLba, 24);
+    Acb->AtaCylinderLowExp  = (UINT8)RShiftU64 (StartLba, 32);
+    Acb->AtaCylinderHighExp = (UINT8)RShiftU64 (StartLba, 40);
+  } else if (AtaDevice->Lba48Bit) {
     Acb->AtaSectorNumberExp = (UINT8)RShiftU64 (StartLba, 24);
     Acb->AtaCylinderLowExp  = (UINT8)RShiftU64 (StartLba, 32);
     Acb->AtaCylinderHighExp = (UINT8)RShiftU64 (StartLba, 40);
@@ -514,8 +547,13 @@ TransferAtaDevice (
     Packet->InTransferLength = TransferLength;
   }
 
-  Packet->Protocol = mAtaPassThruCmdProtocols[AtaDevice->UdmaValid][IsWrite];
-  Packet->Length   = EFI_ATA_PASS_THRU_LENGTH_SECTOR_COUNT;
+  if (Queued) {
+    Packet->Protocol = EFI_ATA_PASS_THRU_PROTOCOL_FPDMA;
+  } else {
+    Packet->Protocol = mAtaPassThruCmdProtocols[AtaDevice->UdmaValid][IsWrite];
+  }
+
+  Packet->Length = EFI_ATA_PASS_THRU_LENGTH_SECTOR_COUNT;
   //
   // |------------------------|-----------------|------------------------|-----------------|
   // | ATA PIO Transfer Mode  |  Transfer Rate  | ATA DMA Transfer Mode  |  Transfer Rate  |
@@ -549,7 +587,22 @@ TransferAtaDevice (
     Packet->Timeout = EFI_TIMER_PERIOD_SECONDS (DivU64x32 (MultU64x32 (TransferLength, AtaDevice->BlockMedia.BlockSize), 3300000) + 31);
   }
 
-  return AtaDevicePassThru (AtaDevice, TaskPacket, Event);
+  Status = AtaDevicePassThru (AtaDevice, TaskPacket, Event);
+  if (Queued && (Status == EFI_UNSUPPORTED)) {
+    //
+    // The ATA host controller does not support native command queuing. Release
+    // the blocks of the packet and fall back to the DMA commands from now on.
+    //
+    AtaDevice->NcqValid = FALSE;
+    FreeAlignedBuffer (Packet->Asb, sizeof (EFI_ATA_STATUS_BLOCK));
+    if (Packet->Acb != NULL) {
+      FreePool (Packet->Acb);
+    }
+
+    return TransferAtaDevice (AtaDevice, TaskPacket, Buffer, StartLba, TransferLength, IsWrite, Event);
+  }
+
+  return Status;
 }
 
 /**
@@ -806,7 +859,11 @@ AccessAtaDevice (
   if ((Token != NULL) && (Token->Event != NULL)) {
     OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
 
-    if (!IsListEmpty (&AtaDevice->AtaSubTaskList)) {
+    //
+    // Without native command queuing the device runs one command at a time:
+    // queue the request until the previous one is done.
+    //
+    if (!AtaDevice->NcqValid && !IsListEmpty (&AtaDevice->AtaSubTaskList)) {
       AtaTask = AllocateZeroPool (sizeof (ATA_BUS_ASYN_TASK));
       if (AtaTask == NULL) {
         gBS->RestoreTPL (OldTpl);
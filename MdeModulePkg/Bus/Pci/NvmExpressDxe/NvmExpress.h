@@ -40,6 +40,7 @@
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiDriverEntryPoint.h>
 #include <Library/ReportStatusCodeLib.h>
+#include <Library/TimerLib.h>
 
 typedef struct _NVME_CONTROLLER_PRIVATE_DATA  NVME_CONTROLLER_PRIVATE_DATA;
 typedef struct _NVME_DEVICE_PRIVATE_DATA      NVME_DEVICE_PRIVATE_DATA;
@@ -63,16 +64,41 @@ extern EFI_DRIVER_SUPPORTED_EFI_VERSION_PROTOCOL  gNvmExpressDriverSupportedEfiV
 #define NVME_CCQ_SIZE  1                                // Number of I/O completion queue entries, which is 0-based
 
 //
-// Number of asynchronous I/O submission queue entries, which is 0-based.
-// The asynchronous I/O submission queue size is 4kB in total.
+// Maximum number of asynchronous I/O submission queue entries, which is 0-based.
+// The queue is sized from CAP.MQES, and is at most 16kB in total.
 //
-#define NVME_ASYNC_CSQ_SIZE  63
+#define NVME_ASYNC_CSQ_SIZE  255
 //
-// Number of asynchronous I/O completion queue entries, which is 0-based.
-// The asynchronous I/O completion queue size is 4kB in total.
+// Maximum number of asynchronous I/O completion queue entries, which is 0-based.
+// The queue is sized from CAP.MQES, and is at most 4kB in total.
 //
 #define NVME_ASYNC_CCQ_SIZE  255
 
+//
+// Number of pages of the asynchronous I/O submission & completion queues.
+//
+#define NVME_ASYNC_CSQ_PAGES  EFI_SIZE_TO_PAGES ((NVME_ASYNC_CSQ_SIZE + 1) * sizeof (NVME_SQ))
+#define NVME_ASYNC_CCQ_PAGES  EFI_SIZE_TO_PAGES ((NVME_ASYNC_CCQ_SIZE + 1) * sizeof (NVME_CQ))
+
+//
+// Number of pages of the buffer the queues are carved out of: one page for each
+// of the admin and synchronous I/O queues, then the asynchronous I/O queues.
+//
+#define NVME_QUEUE_BUFFER_PAGES  (4 + NVME_ASYNC_CSQ_PAGES + NVME_ASYNC_CCQ_PAGES)
+
+//
+// Number of pages of the pool the PRP lists are taken from, which is carved out
+// of the queue buffer after the queues. It is at most 64, the number of bits of
+// the bitmap of the pool. A PRP list which does not fit in the pool is allocated
+// and mapped for its command.
+//
+#define NVME_PRP_LIST_POOL_PAGES  64
+
+//
+// Number of pages of the buffer the queues and the PRP list pool are carved out of.
+//
+#define NVME_BUFFER_PAGES  (NVME_QUEUE_BUFFER_PAGES + NVME_PRP_LIST_POOL_PAGES)
+
 #define NVME_MAX_QUEUES  3                              // Number of queues supported by the driver
 
 #define NVME_CONTROLLER_ID  0
@@ -87,6 +113,16 @@ extern EFI_DRIVER_SUPPORTED_EFI_VERSION_PROTOCOL  gNvmExpressDriverSupportedEfiV
 //
 #define NVME_HC_ASYNC_TIMER  EFI_TIMER_PERIOD_MILLISECONDS (1)
 
+//
+// Counters of the cost of setting up the commands sent through PassThru.
+//
+typedef struct {
+  UINT64    Commands;           // Number of commands submitted
+  UINT64    PrpLists;           // Number of commands with a PRP list
+  UINT64    PrpListPoolMisses;  // Number of PRP lists allocated and mapped for their command
+  UINT64    SetupTime;          // Time in ns spent setting up the commands, counted in DEBUG builds
+} NVME_PASS_THRU_STATISTICS;
+
 //
 // Unique signature for private data structure.
 //
@@ -116,17 +152,26 @@ struct _NVME_CONTROLLER_PRIVATE_DATA {
   NVME_ADMIN_CONTROLLER_DATA            *ControllerData;
 
   //
-  // 6 x 4kB aligned buffers will be carved out of this buffer.
+  // NVME_BUFFER_PAGES x 4kB aligned buffers will be carved out of this buffer.
   // 1st 4kB boundary is the start of the admin submission queue.
   // 2nd 4kB boundary is the start of the admin completion queue.
   // 3rd 4kB boundary is the start of I/O submission queue #1.
   // 4th 4kB boundary is the start of I/O completion queue #1.
-  // 5th 4kB boundary is the start of I/O submission queue #2.
-  // 6th 4kB boundary is the start of I/O completion queue #2.
+  // 5th 4kB boundary is the start of I/O submission queue #2, which spans
+  // NVME_ASYNC_CSQ_PAGES pages, followed by I/O completion queue #2.
+  // The last NVME_PRP_LIST_POOL_PAGES pages are the PRP list pool.
   //
   UINT8          *Buffer;
   UINT8          *BufferPciAddr;
 
+  //
+  // PRP list pool. Bit N of PrpListPoolBitmap is set when the Nth page of the
+  // pool is in use.
+  //
+  UINT8          *PrpListPool;
+  UINT8          *PrpListPoolPciAddr;
+  UINT64         PrpListPoolBitmap;
+
   //
   // Pointers to 4kB aligned submission & completion queues.
   //
@@ -155,6 +200,8 @@ struct _NVME_CONTROLLER_PRIVATE_DATA {
   //
   NVME_CAP       Cap;
 
+  NVME_PASS_THRU_STATISTICS    Statistics;
+
   VOID           *Mapping;
 
   //
@@ -721,6 +768,85 @@ NvmeDumpStatus (
   IN NVME_CQ  *Cq
   );
 
+/**
+  Reset the NVM Express controller after a command timed out, and abort the
+  outstanding asynchronous PassThru requests.
+
+  @param[in] Private        The pointer to the NVME_CONTROLLER_PRIVATE_DATA
+                            data structure.
+
+  @retval EFI_SUCCESS       The controller was reset and the asynchronous
+                            PassThru requests were aborted.
+  @retval Others            The controller could not be reset.
+
+**/
+EFI_STATUS
+NvmeRecoverFromTimeout (
+  IN NVME_CONTROLLER_PRIVATE_DATA  *Private
+  );
+
+/**
+  Aborts the asynchronous PassThru requests.
+
+  @param[in] Private        The pointer to the NVME_CONTROLLER_PRIVATE_DATA
+                            data structure.
+
+  @retval EFI_SUCCESS       The asynchronous PassThru requests have been aborted.
+  @return EFI_DEVICE_ERROR  Fail to abort all the asynchronous PassThru requests.
+
+**/
+EFI_STATUS
+AbortAsyncPassThruTasks (
+  IN NVME_CONTROLLER_PRIVATE_DATA  *Private
+  );
+
+/**
+  Free the PRP lists of a command.
+
+  @param[in] Private        The pointer to the NVME_CONTROLLER_PRIVATE_DATA
+                            data structure.
+  @param[in] PrpListHost    The host base address of the PRP lists.
+  @param[in] PrpListNo      The number of PRP lists.
+  @param[in] Mapping        The mapping value returned from PciIo.Map(), or
+                            NULL if the PRP lists were taken from the PRP list
+                            pool.
+
+**/
+VOID
+NvmeFreePrpList (
+  IN NVME_CONTROLLER_PRIVATE_DATA  *Private,
+  IN VOID                          *PrpListHost,
+  IN UINTN                         PrpListNo,
+  IN VOID                          *Mapping
+  );
+
+/**
+  Dump the counters of the cost of setting up the commands sent through PassThru.
+
+  @param[in] Private        The pointer to the NVME_CONTROLLER_PRIVATE_DATA
+                            data structure.
+
+**/
+VOID
+NvmeDumpPassThruStatistics (
+  IN NVME_CONTROLLER_PRIVATE_DATA  *Private
+  );
+
+/**
+  Call back function when the timer event is signaled.
+
+  @param[in]  Event     The Event this notify function registered to.
+  @param[in]  Context   Pointer to the context data registered to the
+                        Event.
+
+**/
+VOID
+EFIAPI
+ProcessAsyncTaskList (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  );
+
 /**
   Register the shutdown notification through the ResetNotification protocol.
 
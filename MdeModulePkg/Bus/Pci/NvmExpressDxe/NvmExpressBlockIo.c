@@ -195,6 +195,21 @@ NvmeRead (
     MaxTransferBlocks = 1024;
   }
 
+  if (Blocks > MaxTransferBlocks) {
+    //
+    // Keep all the commands of the transfer in flight at once on the
+    // asynchronous I/O queue, instead of waiting for each of them to complete
+    // before issuing the next one. Fall back to issuing them one at a time if
+    // they cannot be queued.
+    //
+    Status = NvmeQueuedReadWrite (Device, Buffer, Lba, Blocks, FALSE);
+    if (Status != EFI_OUT_OF_RESOURCES) {
+      return Status;
+    }
+
+    Status = EFI_SUCCESS;
+  }
+
   while (Blocks > 0) {
     if (Blocks > MaxTransferBlocks) {
       Status = ReadSectors (Device, (UINT64)(UINTN)Buffer, Lba, MaxTransferBlocks);
@@ -281,6 +296,21 @@ NvmeWrite (
     MaxTransferBlocks = 1024;
   }
 
+  if (Blocks > MaxTransferBlocks) {
+    //
+    // Keep all the commands of the transfer in flight at once on the
+    // asynchronous I/O queue, instead of waiting for each of them to complete
+    // before issuing the next one. Fall back to issuing them one at a time if
+    // they cannot be queued.
+    //
+    Status = NvmeQueuedReadWrite (Device, Buffer, Lba, Blocks, TRUE);
+    if (Status != EFI_OUT_OF_RESOURCES) {
+      return Status;
+    }
+
+    Status = EFI_SUCCESS;
+  }
+
   while (Blocks > 0) {
     if (Blocks > MaxTransferBlocks) {
       Status = WriteSectors (Device, (UINT64)(UINTN)Buffer, Lba, MaxTransferBlocks);
@@ -813,6 +843,16 @@ NvmeAsyncRead (
     }
   }
 
+  //
+  // Submit the subtasks now rather than at the next tick of the asynchronous
+  // I/O timer.
+  //
+  if (!EFI_ERROR (Status)) {
+    OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+    ProcessAsyncTaskList (Private->TimerEvent, Private);
+    gBS->RestoreTPL (OldTpl);
+  }
+
   DEBUG ((
     DEBUG_BLKIO,
     "%a: Lba = 0x%08Lx, Original = 0x%08Lx, "
@@ -941,6 +981,16 @@ NvmeAsyncWrite (
     }
   }
 
+  //
+  // Submit the subtasks now rather than at the next tick of the asynchronous
+  // I/O timer.
+  //
+  if (!EFI_ERROR (Status)) {
+    OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+    ProcessAsyncTaskList (Private->TimerEvent, Private);
+    gBS->RestoreTPL (OldTpl);
+  }
+
   DEBUG ((
     DEBUG_BLKIO,
     "%a: Lba = 0x%08Lx, Original = 0x%08Lx, "
@@ -956,6 +1006,152 @@ NvmeAsyncWrite (
   return Status;
 }
 
+/**
+  Read or write some blocks of the device with all the commands of the transfer
+  in flight at once on the asynchronous I/O queue, and wait for them to complete.
+
+  @param  Device                The pointer to the NVME_DEVICE_PRIVATE_DATA data
+                                structure.
+  @param  Buffer                The buffer of the data.
+  @param  Lba                   The start block number.
+  @param  Blocks                Total block number to be transferred.
+  @param  IsWrite               TRUE to write the blocks to the device, FALSE
+                                to read them from the device.
+
+  @retval EFI_SUCCESS           The blocks are transferred.
+  @retval EFI_OUT_OF_RESOURCES  No command was issued for the lack of resources.
+  @retval EFI_TIMEOUT           The commands did not complete in time, and the
+                                controller was reset.
+  @retval EFI_DEVICE_ERROR      The commands did not complete in time, and the
+                                controller could not be reset.
+  @retval Others                Fail to transfer all the blocks.
+
+**/
+EFI_STATUS
+NvmeQueuedReadWrite (
+  IN NVME_DEVICE_PRIVATE_DATA  *Device,
+  IN VOID                      *Buffer,
+  IN UINT64                    Lba,
+  IN UINTN                     Blocks,
+  IN BOOLEAN                   IsWrite
+  )
+{
+  EFI_STATUS                    Status;
+  NVME_CONTROLLER_PRIVATE_DATA  *Private;
+  EFI_BLOCK_IO2_TOKEN           Token;
+  EFI_EVENT                     TimerEvent;
+  UINT32                        MaxTransferBlocks;
+  UINTN                         Commands;
+  BOOLEAN                       TimedOut;
+  EFI_STATUS                    RecoveryStatus;
+  EFI_TPL                       OldTpl;
+
+  Private = Device->Controller;
+
+  if (Private->ControllerData->Mdts != 0) {
+    MaxTransferBlocks = (1 << (Private->ControllerData->Mdts)) * (1 << (Private->Cap.Mpsmin + 12)) / Device->Media.BlockSize;
+  } else {
+    MaxTransferBlocks = 1024;
+  }
+
+  Commands = (Blocks + MaxTransferBlocks - 1) / MaxTransferBlocks;
+
+  Status = gBS->CreateEvent (0, TPL_CALLBACK, NULL, NULL, &Token.Event);
+  if (EFI_ERROR (Status)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = gBS->CreateEvent (EVT_TIMER, TPL_CALLBACK, NULL, NULL, &TimerEvent);
+  if (EFI_ERROR (Status)) {
+    gBS->CloseEvent (Token.Event);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // Give the transfer as long as it would take with one command at a time.
+  //
+  Status = gBS->SetTimer (
+                  TimerEvent,
+                  TimerRelative,
+                  MultU64x64 (NVME_GENERIC_TIMEOUT, Commands)
+                  );
+  if (EFI_ERROR (Status)) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  Token.TransactionStatus = EFI_SUCCESS;
+  if (IsWrite) {
+    Status = NvmeAsyncWrite (Device, Buffer, Lba, Blocks, &Token);
+  } else {
+    Status = NvmeAsyncRead (Device, Buffer, Lba, Blocks, &Token);
+  }
+
+  if (EFI_ERROR (Status)) {
+    //
+    // No subtask is in flight.
+    //
+    goto EXIT;
+  }
+
+  //
+  // Process the completions without waiting for the ticks of the asynchronous
+  // I/O timer, so that the queue is refilled as soon as commands complete.
+  //
+  TimedOut       = FALSE;
+  RecoveryStatus = EFI_SUCCESS;
+  while (gBS->CheckEvent (Token.Event) == EFI_NOT_READY) {
+    if (!TimedOut && !EFI_ERROR (gBS->CheckEvent (TimerEvent))) {
+      DEBUG ((DEBUG_ERROR, "%a: Timeout occurs for the queued NVMe commands.\n", __FUNCTION__));
+      TimedOut = TRUE;
+      //
+      // Resetting the controller aborts the subtasks, which signals the token.
+      //
+      RecoveryStatus = NvmeRecoverFromTimeout (Private);
+      if (EFI_ERROR (RecoveryStatus)) {
+        //
+        // The controller could not be reset, so the subtasks are still queued
+        // and no completion will ever come for them. Abort them here, which
+        // also signals the token, rather than wait for it forever.
+        //
+        DEBUG ((DEBUG_ERROR, "%a: Fail to reset the controller - %r\n", __FUNCTION__, RecoveryStatus));
+        Token.TransactionStatus = EFI_DEVICE_ERROR;
+        AbortAsyncPassThruTasks (Private);
+        continue;
+      }
+    }
+
+    OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+    ProcessAsyncTaskList (Private->TimerEvent, Private);
+    gBS->RestoreTPL (OldTpl);
+  }
+
+  if (EFI_ERROR (RecoveryStatus)) {
+    Status = EFI_DEVICE_ERROR;
+  } else if (TimedOut) {
+    Status = EFI_TIMEOUT;
+  } else {
+    Status = Token.TransactionStatus;
+  }
+
+EXIT:
+  gBS->CloseEvent (TimerEvent);
+  gBS->CloseEvent (Token.Event);
+
+  DEBUG ((
+    DEBUG_BLKIO,
+    "%a: Lba = 0x%08Lx, Blocks = 0x%08Lx, Commands = 0x%x, IsWrite = %d, Status = %r\n",
+    __FUNCTION__,
+    Lba,
+    (UINT64)Blocks,
+    Commands,
+    IsWrite,
+    Status
+    ));
+
+  return Status;
+}
+
 /**
   Reset the Block Device.
 
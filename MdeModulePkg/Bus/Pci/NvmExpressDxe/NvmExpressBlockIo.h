@@ -408,4 +408,32 @@ NvmeStorageSecuritySendData (
   IN VOID                                   *PayloadBuffer
   );
 
+/**
+  Read or write some blocks of the device with all the commands of the transfer
+  in flight at once on the asynchronous I/O queue, and wait for them to complete.
+
+  @param  Device                The pointer to the NVME_DEVICE_PRIVATE_DATA data
+                                structure.
+  @param  Buffer                The buffer of the data.
+  @param  Lba                   The start block number.
+  @param  Blocks                Total block number to be transferred.
+  @param  IsWrite               TRUE to write the blocks to the device, FALSE
+                                to read them from the device.
+
+  @retval EFI_SUCCESS           The blocks are transferred.
+  @retval EFI_OUT_OF_RESOURCES  No command was issued for the lack of resources.
+  @retval EFI_TIMEOUT           The commands did not complete in time, and the
+                                controller was reset.
+  @retval Others                Fail to transfer all the blocks.
+
+**/
+EFI_STATUS
+NvmeQueuedReadWrite (
+  IN NVME_DEVICE_PRIVATE_DATA  *Device,
+  IN VOID                      *Buffer,
+  IN UINT64                    Lba,
+  IN UINTN                     Blocks,
+  IN BOOLEAN                   IsWrite
+  );
+
 #endif
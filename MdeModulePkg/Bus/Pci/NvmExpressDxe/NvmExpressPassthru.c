@@ -195,30 +195,209 @@ NvmeDumpStatus (
   }
 }
 
+/**
+  Get the time elapsed since a value of the performance counter.
+
+  @param[in]     Start               The value of the performance counter.
+
+  @return The time elapsed since Start, in nanoseconds.
+
+**/
+UINT64
+NvmeGetElapsedTime (
+  IN UINT64  Start
+  )
+{
+  UINT64  End;
+  UINT64  CounterStart;
+  UINT64  CounterEnd;
+
+  End = GetPerformanceCounter ();
+  GetPerformanceCounterProperties (&CounterStart, &CounterEnd);
+
+  if (CounterStart > CounterEnd) {
+    //
+    // The performance counter counts down.
+    //
+    if (End <= Start) {
+      return GetTimeInNanoSecond (Start - End);
+    }
+
+    return GetTimeInNanoSecond ((Start - CounterEnd) + (CounterStart - End));
+  }
+
+  if (End >= Start) {
+    return GetTimeInNanoSecond (End - Start);
+  }
+
+  return GetTimeInNanoSecond ((CounterEnd - Start) + (End - CounterStart));
+}
+
+/**
+  Dump the counters of the cost of setting up the commands sent through PassThru.
+
+  @param[in] Private        The pointer to the NVME_CONTROLLER_PRIVATE_DATA
+                            data structure.
+
+**/
+VOID
+NvmeDumpPassThruStatistics (
+  IN NVME_CONTROLLER_PRIVATE_DATA  *Private
+  )
+{
+  NVME_PASS_THRU_STATISTICS  *Statistics;
+
+  Statistics = &Private->Statistics;
+  DEBUG ((
+    DEBUG_INFO,
+    "NvmExpressPassThru: %Ld commands, %Ld with a PRP list, %Ld PRP lists out of the pool, %Ld ns of setup per command\n",
+    Statistics->Commands,
+    Statistics->PrpLists,
+    Statistics->PrpListPoolMisses,
+    (Statistics->Commands == 0) ? 0 : DivU64x64Remainder (Statistics->SetupTime, Statistics->Commands, NULL)
+    ));
+}
+
+/**
+  Return the bits of PrpListPoolBitmap of a number of pages at the start of the
+  PRP list pool.
+
+  @param[in]     Pages               The number of pages, up to NVME_PRP_LIST_POOL_PAGES.
+
+  @return The bits of the pages.
+
+**/
+STATIC
+UINT64
+NvmePrpListPoolMask (
+  IN UINTN  Pages
+  )
+{
+  //
+  // LShiftU64 () cannot shift by the 64 bits of a pool that takes all of them.
+  //
+  if (Pages >= 64) {
+    return MAX_UINT64;
+  }
+
+  return LShiftU64 (1, Pages) - 1;
+}
+
+/**
+  Take pages for PRP lists from the PRP list pool.
+
+  @param[in]     Private             The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in]     Pages               The number of pages.
+  @param[out]    HostAddress         The host base address of the pages.
+  @param[out]    PciAddress          The PCI base address of the pages.
+
+  @retval TRUE                       The pages are taken from the pool.
+  @retval FALSE                      The pool has no such free pages.
+
+**/
+BOOLEAN
+NvmeAllocatePrpListPoolPages (
+  IN  NVME_CONTROLLER_PRIVATE_DATA  *Private,
+  IN  UINTN                         Pages,
+  OUT VOID                          **HostAddress,
+  OUT EFI_PHYSICAL_ADDRESS          *PciAddress
+  )
+{
+  UINT64   Mask;
+  UINTN    Index;
+  BOOLEAN  Found;
+  EFI_TPL  OldTpl;
+
+  if ((Pages == 0) || (Pages > NVME_PRP_LIST_POOL_PAGES)) {
+    return FALSE;
+  }
+
+  Mask   = NvmePrpListPoolMask (Pages);
+  Found  = FALSE;
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  for (Index = 0; Index + Pages <= NVME_PRP_LIST_POOL_PAGES; Index++) {
+    if ((Private->PrpListPoolBitmap & LShiftU64 (Mask, Index)) == 0) {
+      Private->PrpListPoolBitmap |= LShiftU64 (Mask, Index);
+      Found                       = TRUE;
+      break;
+    }
+  }
+
+  gBS->RestoreTPL (OldTpl);
+
+  if (!Found) {
+    return FALSE;
+  }
+
+  *HostAddress = Private->PrpListPool + EFI_PAGES_TO_SIZE (Index);
+  *PciAddress  = (EFI_PHYSICAL_ADDRESS)(UINTN)(Private->PrpListPoolPciAddr + EFI_PAGES_TO_SIZE (Index));
+  return TRUE;
+}
+
+/**
+  Free the PRP lists of a command.
+
+  @param[in] Private        The pointer to the NVME_CONTROLLER_PRIVATE_DATA
+                            data structure.
+  @param[in] PrpListHost    The host base address of the PRP lists.
+  @param[in] PrpListNo      The number of PRP lists.
+  @param[in] Mapping        The mapping value returned from PciIo.Map(), or
+                            NULL if the PRP lists were taken from the PRP list
+                            pool.
+
+**/
+VOID
+NvmeFreePrpList (
+  IN NVME_CONTROLLER_PRIVATE_DATA  *Private,
+  IN VOID                          *PrpListHost,
+  IN UINTN                         PrpListNo,
+  IN VOID                          *Mapping
+  )
+{
+  UINTN    Index;
+  EFI_TPL  OldTpl;
+
+  if (Mapping == NULL) {
+    Index = EFI_SIZE_TO_PAGES ((UINTN)((UINT8 *)PrpListHost - Private->PrpListPool));
+    ASSERT (Index + PrpListNo <= NVME_PRP_LIST_POOL_PAGES);
+
+    OldTpl                      = gBS->RaiseTPL (TPL_NOTIFY);
+    Private->PrpListPoolBitmap &= ~LShiftU64 (NvmePrpListPoolMask (PrpListNo), Index);
+    gBS->RestoreTPL (OldTpl);
+    return;
+  }
+
+  Private->PciIo->Unmap (Private->PciIo, Mapping);
+  Private->PciIo->FreeBuffer (Private->PciIo, PrpListNo, PrpListHost);
+}
+
 /**
   Create PRP lists for data transfer which is larger than 2 memory pages.
   Note here we calcuate the number of required PRP lists and allocate them at one time.
+  They are taken from the PRP list pool when it has room for them.
 
-  @param[in]     PciIo               A pointer to the EFI_PCI_IO_PROTOCOL instance.
+  @param[in]     Private             The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
   @param[in]     PhysicalAddr        The physical base address of data buffer.
   @param[in]     Pages               The number of pages to be transfered.
   @param[out]    PrpListHost         The host base address of PRP lists.
   @param[in,out] PrpListNo           The number of PRP List.
-  @param[out]    Mapping             The mapping value returned from PciIo.Map().
+  @param[out]    Mapping             The mapping value returned from PciIo.Map(), or NULL
+                                     if the PRP lists are taken from the PRP list pool.
 
   @retval The pointer to the first PRP List of the PRP lists.
 
 **/
 VOID *
 NvmeCreatePrpList (
-  IN     EFI_PCI_IO_PROTOCOL   *PciIo,
-  IN     EFI_PHYSICAL_ADDRESS  PhysicalAddr,
-  IN     UINTN                 Pages,
-  OUT VOID                     **PrpListHost,
-  IN OUT UINTN                 *PrpListNo,
-  OUT VOID                     **Mapping
+  IN     NVME_CONTROLLER_PRIVATE_DATA  *Private,
+  IN     EFI_PHYSICAL_ADDRESS          PhysicalAddr,
+  IN     UINTN                         Pages,
+  OUT VOID                             **PrpListHost,
+  IN OUT UINTN                         *PrpListNo,
+  OUT VOID                             **Mapping
   )
 {
+  EFI_PCI_IO_PROTOCOL   *PciIo;
   UINTN                 PrpEntryNo;
   UINT64                PrpListBase;
   UINTN                 PrpListIndex;
@@ -228,6 +407,9 @@ NvmeCreatePrpList (
   UINTN                 Bytes;
   EFI_STATUS            Status;
 
+  PciIo    = Private->PciIo;
+  *Mapping = NULL;
+
   //
   // The number of Prp Entry in a memory page.
   //
@@ -247,32 +429,37 @@ NvmeCreatePrpList (
     Remainder = PrpEntryNo - 1;
   }
 
-  Status = PciIo->AllocateBuffer (
-                    PciIo,
-                    AllocateAnyPages,
-                    EfiBootServicesData,
-                    *PrpListNo,
-                    PrpListHost,
-                    0
-                    );
+  Private->Statistics.PrpLists++;
+  Bytes = EFI_PAGES_TO_SIZE (*PrpListNo);
+  if (!NvmeAllocatePrpListPoolPages (Private, *PrpListNo, PrpListHost, &PrpListPhyAddr)) {
+    Private->Statistics.PrpListPoolMisses++;
 
-  if (EFI_ERROR (Status)) {
-    return NULL;
-  }
+    Status = PciIo->AllocateBuffer (
+                      PciIo,
+                      AllocateAnyPages,
+                      EfiBootServicesData,
+                      *PrpListNo,
+                      PrpListHost,
+                      0
+                      );
 
-  Bytes  = EFI_PAGES_TO_SIZE (*PrpListNo);
-  Status = PciIo->Map (
-                    PciIo,
-                    EfiPciIoOperationBusMasterCommonBuffer,
-                    *PrpListHost,
-                    &Bytes,
-                    &PrpListPhyAddr,
-                    Mapping
-                    );
+    if (EFI_ERROR (Status)) {
+      return NULL;
+    }
 
-  if (EFI_ERROR (Status) || (Bytes != EFI_PAGES_TO_SIZE (*PrpListNo))) {
-    DEBUG ((DEBUG_ERROR, "NvmeCreatePrpList: create PrpList failure!\n"));
-    goto EXIT;
+    Status = PciIo->Map (
+                      PciIo,
+                      EfiPciIoOperationBusMasterCommonBuffer,
+                      *PrpListHost,
+                      &Bytes,
+                      &PrpListPhyAddr,
+                      Mapping
+                      );
+
+    if (EFI_ERROR (Status) || (Bytes != EFI_PAGES_TO_SIZE (*PrpListNo))) {
+      DEBUG ((DEBUG_ERROR, "NvmeCreatePrpList: create PrpList failure!\n"));
+      goto EXIT;
+    }
   }
 
   //
@@ -384,16 +571,13 @@ AbortAsyncPassThruTasks (
       PciIo->Unmap (PciIo, AsyncRequest->MapMeta);
     }
 
-    if (AsyncRequest->MapPrpList != NULL) {
-      PciIo->Unmap (PciIo, AsyncRequest->MapPrpList);
-    }
-
     if (AsyncRequest->PrpListHost != NULL) {
-      PciIo->FreeBuffer (
-               PciIo,
-               AsyncRequest->PrpListNo,
-               AsyncRequest->PrpListHost
-               );
+      NvmeFreePrpList (
+        Private,
+        AsyncRequest->PrpListHost,
+        AsyncRequest->PrpListNo,
+        AsyncRequest->MapPrpList
+        );
     }
 
     RemoveEntryList (Link);
@@ -414,6 +598,52 @@ AbortAsyncPassThruTasks (
   return Status;
 }
 
+/**
+  Reset the NVM Express controller after a command timed out, and abort the
+  outstanding asynchronous PassThru requests.
+
+  @param[in] Private        The pointer to the NVME_CONTROLLER_PRIVATE_DATA
+                            data structure.
+
+  @retval EFI_SUCCESS       The controller was reset and the asynchronous
+                            PassThru requests were aborted.
+  @retval Others            The controller could not be reset.
+
+**/
+EFI_STATUS
+NvmeRecoverFromTimeout (
+  IN NVME_CONTROLLER_PRIVATE_DATA  *Private
+  )
+{
+  EFI_STATUS  Status;
+
+  //
+  // Disable the timer to trigger the process of async transfers temporarily.
+  //
+  Status = gBS->SetTimer (Private->TimerEvent, TimerCancel, 0);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Reset the NVMe controller.
+  //
+  Status = NvmeControllerInit (Private);
+  if (EFI_ERROR (Status)) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  Status = AbortAsyncPassThruTasks (Private);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Re-enable the timer to trigger the process of async transfers.
+  //
+  return gBS->SetTimer (Private->TimerEvent, TimerPeriodic, NVME_HC_ASYNC_TIMER);
+}
+
 /**
   Sends an NVM Express Command Packet to an NVM Express controller or namespace. This function supports
   both blocking I/O and non-blocking I/O. The blocking I/O functionality is required, and the non-blocking
@@ -481,6 +711,7 @@ NvmExpressPassThru (
   UINT32                         Data;
   NVME_PASS_THRU_ASYNC_REQ       *AsyncRequest;
   EFI_TPL                        OldTpl;
+  UINT64                         SetupStart;
 
   //
   // check the data fields in Packet parameter.
@@ -544,6 +775,11 @@ NvmExpressPassThru (
     }
   }
 
+  SetupStart = 0;
+  DEBUG_CODE_BEGIN ();
+  SetupStart = GetPerformanceCounter ();
+  DEBUG_CODE_END ();
+
   PciIo       = Private->PciIo;
   MapData     = NULL;
   MapMeta     = NULL;
@@ -680,7 +916,7 @@ NvmExpressPassThru (
     // Create PrpList for remaining data buffer.
     //
     PhyAddr = (Sq->Prp[0] + EFI_PAGE_SIZE) & ~(EFI_PAGE_SIZE - 1);
-    Prp     = NvmeCreatePrpList (PciIo, PhyAddr, EFI_SIZE_TO_PAGES (Offset + Bytes) - 1, &PrpListHost, &PrpListNo, &MapPrpList);
+    Prp     = NvmeCreatePrpList (Private, PhyAddr, EFI_SIZE_TO_PAGES (Offset + Bytes) - 1, &PrpListHost, &PrpListNo, &MapPrpList);
     if (Prp == NULL) {
       Status = EFI_OUT_OF_RESOURCES;
       goto EXIT;
@@ -747,6 +983,11 @@ NvmExpressPassThru (
     goto EXIT;
   }
 
+  Private->Statistics.Commands++;
+  DEBUG_CODE_BEGIN ();
+  Private->Statistics.SetupTime += NvmeGetElapsedTime (SetupStart);
+  DEBUG_CODE_END ();
+
   //
   // For non-blocking requests, return directly if the command is placed
   // in the submission queue.
@@ -830,34 +1071,12 @@ NvmExpressPassThru (
     //
     DEBUG ((DEBUG_ERROR, "NvmExpressPassThru: Timeout occurs for an NVMe command.\n"));
 
-    //
-    // Disable the timer to trigger the process of async transfers temporarily.
-    //
-    Status = gBS->SetTimer (Private->TimerEvent, TimerCancel, 0);
-    if (EFI_ERROR (Status)) {
-      goto EXIT;
-    }
-
-    //
-    // Reset the NVMe controller.
-    //
-    Status = NvmeControllerInit (Private);
+    Status = NvmeRecoverFromTimeout (Private);
     if (!EFI_ERROR (Status)) {
-      Status = AbortAsyncPassThruTasks (Private);
-      if (!EFI_ERROR (Status)) {
-        //
-        // Re-enable the timer to trigger the process of async transfers.
-        //
-        Status = gBS->SetTimer (Private->TimerEvent, TimerPeriodic, NVME_HC_ASYNC_TIMER);
-        if (!EFI_ERROR (Status)) {
-          //
-          // Return EFI_TIMEOUT to indicate a timeout occurs for NVMe PassThru command.
-          //
-          Status = EFI_TIMEOUT;
-        }
-      }
-    } else {
-      Status = EFI_DEVICE_ERROR;
+      //
+      // Return EFI_TIMEOUT to indicate a timeout occurs for NVMe PassThru command.
+      //
+      Status = EFI_TIMEOUT;
     }
 
     goto EXIT;
@@ -905,15 +1124,8 @@ EXIT:
              );
   }
 
-  if (MapPrpList != NULL) {
-    PciIo->Unmap (
-             PciIo,
-             MapPrpList
-             );
-  }
-
   if (Prp != NULL) {
-    PciIo->FreeBuffer (PciIo, PrpListNo, PrpListHost);
+    NvmeFreePrpList (Private, PrpListHost, PrpListNo, MapPrpList);
   }
 
   if (TimerEvent != NULL) {
@@ -65,6 +65,12 @@ typedef struct _USB_DEV_CONTEXT    USB_DEV_CONTEXT;
 // The unit is 100us, takes 1ms as interval.
 //
 #define XHC_ASYNC_TIMER_INTERVAL  EFI_TIMER_PERIOD_MILLISECONDS(1)
+//
+// A halted XHC posts no event. While the event ring stays empty, a synchronous
+// transfer checks the XHC for halt and system error every so many passes of
+// its 1us polling loop, that is about every 1ms.
+//
+#define XHC_HALT_CHECK_INTERVAL  (1000)
 
 //
 // XHC raises TPL to TPL_NOTIFY to serialize all its operations
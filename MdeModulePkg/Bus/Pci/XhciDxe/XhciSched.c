@@ -1272,6 +1272,13 @@ EXIT:
 /**
   Execute the transfer by polling the URB. This is a synchronous operation.
 
+  The completion of the URB is reported by the interrupter of the xHC in the
+  event ring in memory, so the result of the URB, which reads the XHCI
+  registers, is only checked when the event ring has new events. A halted xHC
+  posts no event, so the xHC is also checked for halt and system error every
+  XHC_HALT_CHECK_INTERVAL passes, and the transfer fails as soon as it is
+  found halted.
+
   @param  Xhc                    The XHCI Instance.
   @param  CmdTransfer            The executed URB is for cmd transfer or not.
   @param  Urb                    The URB to execute.
@@ -1297,11 +1304,13 @@ XhcExecTransfer (
   BOOLEAN     Finished;
   EFI_EVENT   TimeoutEvent;
   BOOLEAN     IndefiniteTimeout;
+  UINTN       Pass;
 
   Status            = EFI_SUCCESS;
   Finished          = FALSE;
   TimeoutEvent      = NULL;
   IndefiniteTimeout = FALSE;
+  Pass              = 0;
 
   if (CmdTransfer) {
     SlotId = 0;
@@ -1347,9 +1356,21 @@ RINGDOORBELL:
   XhcRingDoorBell (Xhc, SlotId, Dci);
 
   do {
-    Finished = XhcCheckUrbResult (Xhc, Urb);
-    if (Finished) {
-      break;
+    if (Urb->Finished || XhcHasNewEvent (Xhc, &Xhc->EventRing)) {
+      Finished = XhcCheckUrbResult (Xhc, Urb);
+      if (Finished) {
+        break;
+      }
+    } else if ((++Pass % XHC_HALT_CHECK_INTERVAL) == 0) {
+      if (XhcIsHalt (Xhc) || XhcIsSysError (Xhc)) {
+        //
+        // XhcCheckUrbResult() reports the halt as EFI_USB_ERR_SYSTEM. No event
+        // will complete the URB, so end the transfer with a device error.
+        //
+        XhcCheckUrbResult (Xhc, Urb);
+        Finished = TRUE;
+        break;
+      }
     }
 
     gBS->Stall (XHC_1_MICROSECOND);
@@ -1631,11 +1652,23 @@ XhcMonitorAsyncRequests (
   UINT8              SlotId;
   EFI_STATUS         Status;
   EFI_TPL            OldTpl;
+  BOOLEAN            NewEvent;
+  BOOLEAN            Halted;
 
   OldTpl = gBS->RaiseTPL (XHC_TPL);
 
   Xhc = (USB_XHCI_INSTANCE *)Context;
 
+  //
+  // XhcCheckUrbResult() handles the events of all the async interrupt URBs at
+  // once. Once the event ring has no new event, only the URBs which are already
+  // finished need to be reported. A halted xHC posts no event, so the halt and
+  // system error status is still read once per tick, and every URB is then
+  // checked so that XhcCheckUrbResult() reports the error on it.
+  //
+  NewEvent = XhcHasNewEvent (Xhc, &Xhc->EventRing);
+  Halted   = (BOOLEAN)(!NewEvent && (XhcIsHalt (Xhc) || XhcIsSysError (Xhc)));
+
   BASE_LIST_FOR_EACH_SAFE (Entry, Next, &Xhc->AsyncIntTransfers) {
     Urb = EFI_LIST_CONTAINER (Entry, URB, UrbList);
 
@@ -1651,7 +1684,10 @@ XhcMonitorAsyncRequests (
     // Check the result of URB execution. If it is still
     // active, check the next one.
     //
-    XhcCheckUrbResult (Xhc, Urb);
+    if (NewEvent || Halted) {
+      XhcCheckUrbResult (Xhc, Urb);
+      NewEvent = XhcHasNewEvent (Xhc, &Xhc->EventRing);
+    }
 
     if (!Urb->Finished) {
       continue;
@@ -2028,6 +2064,37 @@ XhcSyncTrsRing (
   return EFI_SUCCESS;
 }
 
+/**
+  Check whether the interrupter of the event ring wrote events which are not
+  handled yet. It only reads the event ring in memory, not the XHCI registers.
+
+  @param  Xhc           The XHCI Instance.
+  @param  EvtRing       The event ring to check.
+
+  @return Whether the event ring has events which are not handled yet.
+
+**/
+BOOLEAN
+EFIAPI
+XhcHasNewEvent (
+  IN  USB_XHCI_INSTANCE  *Xhc,
+  IN  EVENT_RING         *EvtRing
+  )
+{
+  ASSERT (EvtRing != NULL);
+
+  //
+  // The events between the dequeue and enqueue pointers are synchronized but
+  // not handled yet. The xHC writes a new event at the enqueue pointer with
+  // the cycle bit of the enqueue pointer.
+  //
+  if (EvtRing->EventRingDequeue != EvtRing->EventRingEnqueue) {
+    return TRUE;
+  }
+
+  return (BOOLEAN)(EvtRing->EventRingEnqueue->CycleBit == EvtRing->EventRingCCS);
+}
+
 /**
   Check if there is a new generated event.
 
@@ -1262,6 +1262,23 @@ XhcSyncEventRing (
   EVENT_RING            *EvtRing
   );
 
+/**
+  Check whether the interrupter of the event ring wrote events which are not
+  handled yet. It only reads the event ring in memory, not the XHCI registers.
+
+  @param  Xhc           The XHCI Instance.
+  @param  EvtRing       The event ring to check.
+
+  @return Whether the event ring has events which are not handled yet.
+
+**/
+BOOLEAN
+EFIAPI
+XhcHasNewEvent (
+  IN  USB_XHCI_INSTANCE  *Xhc,
+  IN  EVENT_RING         *EvtRing
+  );
+
 /**
   Check if there is a new generated event.
 
@@ -19,6 +19,15 @@ BOOLEAN  *mDepexEvaluationStack        = NULL;
 BOOLEAN  *mDepexEvaluationStackEnd     = NULL;
 BOOLEAN  *mDepexEvaluationStackPointer = NULL;
 
+//
+// Dependency expression evaluation statistics, reported through the performance counters.
+//
+// mDepexEvaluateCount - Number of dependency expressions evaluated
+// mDepexSkipCount     - Number of evaluations skipped because no protocol they push changed
+//
+UINT64  mDepexEvaluateCount = 0;
+UINT64  mDepexSkipCount     = 0;
+
 //
 // Worker functions
 //
@@ -141,6 +150,145 @@ PopBool (
   return EFI_SUCCESS;
 }
 
+/**
+  Walk the protocols a dependency expression pushes.
+
+  @param  DriverEntry           DriverEntry element whose Depex to walk.
+  @param  Protocols             If not NULL, receives the protocol entries of
+                                the pushed protocols.
+
+  @return The number of protocols the Depex pushes, or MAX_UINTN if the
+          protocol entry of one of them cannot be created.
+
+**/
+STATIC
+UINTN
+CoreWalkDepexProtocols (
+  IN  EFI_CORE_DRIVER_ENTRY  *DriverEntry,
+  OUT VOID                   **Protocols  OPTIONAL
+  )
+{
+  UINT8     *Iterator;
+  UINT8     *End;
+  UINTN     Count;
+  EFI_GUID  ProtocolGuid;
+
+  Count    = 0;
+  Iterator = DriverEntry->Depex;
+  End      = Iterator + DriverEntry->DepexSize;
+  while ((Iterator < End) && (*Iterator != EFI_DEP_END)) {
+    switch (*Iterator) {
+      case EFI_DEP_BEFORE:
+      case EFI_DEP_AFTER:
+      case EFI_DEP_PUSH:
+      case EFI_DEP_REPLACE_TRUE:
+        if ((UINTN)(End - Iterator) <= sizeof (EFI_GUID)) {
+          return Count;
+        }
+
+        //
+        // A PUSH that has been replaced by TRUE cannot change any more.
+        //
+        if (*Iterator == EFI_DEP_PUSH) {
+          if (Protocols != NULL) {
+            CopyMem (&ProtocolGuid, Iterator + 1, sizeof (EFI_GUID));
+            Protocols[Count] = CoreGetProtocolEntry (&ProtocolGuid);
+            if (Protocols[Count] == NULL) {
+              return MAX_UINTN;
+            }
+          }
+
+          Count++;
+        }
+
+        Iterator += sizeof (EFI_GUID);
+        break;
+
+      default:
+        break;
+    }
+
+    Iterator++;
+  }
+
+  return Count;
+}
+
+/**
+  Record the protocol entries of the protocols a dependency expression
+  pushes, so that the expression is only evaluated again once one of them
+  has been installed or uninstalled.
+
+  @param  DriverEntry           DriverEntry element to update.
+
+**/
+STATIC
+VOID
+CoreIndexDepexProtocols (
+  IN  EFI_CORE_DRIVER_ENTRY  *DriverEntry
+  )
+{
+  UINTN  Count;
+
+  if (DriverEntry->DepexProtocols != NULL) {
+    FreePool (DriverEntry->DepexProtocols);
+  }
+
+  DriverEntry->DepexProtocols     = NULL;
+  DriverEntry->DepexProtocolCount = 0;
+  DriverEntry->DepexEvaluated     = FALSE;
+
+  Count = CoreWalkDepexProtocols (DriverEntry, NULL);
+  if (Count == 0) {
+    return;
+  }
+
+  DriverEntry->DepexProtocols = AllocatePool (Count * sizeof (VOID *));
+  if (DriverEntry->DepexProtocols == NULL) {
+    return;
+  }
+
+  if (CoreWalkDepexProtocols (DriverEntry, DriverEntry->DepexProtocols) != Count) {
+    FreePool (DriverEntry->DepexProtocols);
+    DriverEntry->DepexProtocols = NULL;
+    return;
+  }
+
+  DriverEntry->DepexProtocolCount = Count;
+}
+
+/**
+  Check if the last evaluation of a dependency expression still holds,
+  because none of the protocols it pushes has been installed or uninstalled
+  since then.
+
+  @param  DriverEntry           DriverEntry element to check.
+
+  @retval TRUE                  The Depex would evaluate to FALSE again.
+  @retval FALSE                 The Depex must be evaluated.
+
+**/
+STATIC
+BOOLEAN
+CoreIsDepexUnchanged (
+  IN  EFI_CORE_DRIVER_ENTRY  *DriverEntry
+  )
+{
+  UINTN  Index;
+
+  if (!DriverEntry->DepexEvaluated || (DriverEntry->DepexProtocols == NULL)) {
+    return FALSE;
+  }
+
+  for (Index = 0; Index < DriverEntry->DepexProtocolCount; Index++) {
+    if (CoreGetProtocolUpdateKey (DriverEntry->DepexProtocols[Index]) > DriverEntry->DepexUpdateKey) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
 /**
   Preprocess dependency expression and update DriverEntry to reflect the
   state of  Before, After, and SOR dependencies. If DriverEntry->Before
@@ -177,6 +325,12 @@ CorePreProcessDepex (
     CopyMem (&DriverEntry->BeforeAfterGuid, Iterator + 1, sizeof (EFI_GUID));
   }
 
+  if (FeaturePcdGet (PcdDxeDepexCacheEnable) && DriverEntry->Dependent &&
+      !DriverEntry->Before && !DriverEntry->After)
+  {
+    CoreIndexDepexProtocols (DriverEntry);
+  }
+
   return EFI_SUCCESS;
 }
 
@@ -233,6 +387,23 @@ CoreIsSchedulable (
     return TRUE;
   }
 
+  if (FeaturePcdGet (PcdDxeDepexCacheEnable)) {
+    if (CoreIsDepexUnchanged (DriverEntry)) {
+      DEBUG ((DEBUG_DISPATCH, "  RESULT = FALSE (No pushed protocol changed)\n"));
+      mDepexSkipCount++;
+      return FALSE;
+    }
+
+    //
+    // Take the key before evaluating, so that a protocol installed while the
+    // Depex is evaluated causes another evaluation.
+    //
+    DriverEntry->DepexEvaluated = TRUE;
+    DriverEntry->DepexUpdateKey = CoreGetProtocolUpdateKey (NULL);
+  }
+
+  mDepexEvaluateCount++;
+
   //
   // Clean out memory leaks in Depex Boolean stack. Leaks are only caused by
   // incorrectly formed DEPEX expressions
@@ -431,3 +602,17 @@ CoreIsSchedulable (
 Done:
   return FALSE;
 }
+
+/**
+  Report the dependency expression evaluation statistics through the
+  performance counters.
+
+**/
+VOID
+CoreReportDepexCounters (
+  VOID
+  )
+{
+  CoreLogPerformanceCounter ("DepexEval", mDepexEvaluateCount);
+  CoreLogPerformanceCounter ("DepexSkip", mDepexSkipCount);
+}
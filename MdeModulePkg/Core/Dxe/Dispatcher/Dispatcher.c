@@ -381,6 +381,40 @@ CoreTrust (
   return EFI_NOT_FOUND;
 }
 
+/**
+  Start loading the next drivers on the mScheduledQueue on the APs, so that
+  they are ready by the time the driver that is about to be started returns.
+
+**/
+STATIC
+VOID
+CoreLoadScheduledDriversAhead (
+  VOID
+  )
+{
+  EFI_STATUS             Status;
+  LIST_ENTRY             *Link;
+  EFI_CORE_DRIVER_ENTRY  *DriverEntry;
+  UINTN                  Count;
+
+  if (!FeaturePcdGet (PcdDxeParallelImageLoadEnable)) {
+    return;
+  }
+
+  Count = 0;
+  for (Link = mScheduledQueue.ForwardLink; Link != &mScheduledQueue; Link = Link->ForwardLink) {
+    DriverEntry = CR (Link, EFI_CORE_DRIVER_ENTRY, ScheduledLink, EFI_CORE_DRIVER_ENTRY_SIGNATURE);
+    if ((DriverEntry->ImageHandle != NULL) || DriverEntry->IsFvImage) {
+      continue;
+    }
+
+    Status = CoreLoadImageAhead (DriverEntry->FvFileDevicePath);
+    if ((Status == EFI_OUT_OF_RESOURCES) || (++Count == IMAGE_LOAD_AHEAD_DEPTH)) {
+      break;
+    }
+  }
+}
+
 /**
   This is the main Dispatcher for DXE and it exits when there are no more
   drivers to run. Drain the mScheduledQueue and load and start a PE
@@ -515,6 +549,8 @@ CoreDispatcher (
           );
         ASSERT (DriverEntry->ImageHandle != NULL);
 
+        CoreLoadScheduledDriversAhead ();
+
         Status = CoreStartImage (DriverEntry->ImageHandle, NULL, NULL);
 
         REPORT_STATUS_CODE_WITH_EXTENDED_DATA (
@@ -571,6 +607,8 @@ CoreDispatcher (
   //
   CoreCloseEvent (DxeDispatchEvent);
 
+  CoreReleaseImageLoadAhead (NULL);
+
   gDispatcherRunning = FALSE;
 
   PERF_FUNCTION_END ();
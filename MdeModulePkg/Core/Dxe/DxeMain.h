@@ -45,6 +45,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Protocol/HiiPackageList.h>
 #include <Protocol/SmmBase2.h>
 #include <Protocol/PeCoffImageEmulator.h>
+#include <Protocol/MpService.h>
 #include <Guid/MemoryTypeInformation.h>
 #include <Guid/FirmwareFileSystem2.h>
 #include <Guid/FirmwareFileSystem3.h>
@@ -59,6 +60,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Guid/EventExitBootServiceFailed.h>
 #include <Guid/LoadModuleAtFixedAddress.h>
 #include <Guid/IdleLoopEvent.h>
+#include <Guid/HobDirectory.h>
 #include <Guid/VectorHandoffTable.h>
 #include <Ppi/VectorHandoffInfo.h>
 #include <Guid/MemoryProfile.h>
@@ -69,6 +71,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/BaseLib.h>
 #include <Library/HobLib.h>
 #include <Library/PerformanceLib.h>
+#include <Library/PrintLib.h>
 #include <Library/UefiDecompressLib.h>
 #include <Library/ExtractGuidedSectionLib.h>
 #include <Library/CacheMaintenanceLib.h>
@@ -84,6 +87,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/DxeServicesLib.h>
 #include <Library/DebugAgentLib.h>
 #include <Library/CpuExceptionHandlerLib.h>
+#include <Library/TimerLib.h>
 
 //
 // attributes for reserved memory before it is promoted to system memory
@@ -107,6 +111,17 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 ///
 #define EFI_DEP_REPLACE_TRUE  0xff
 
+///
+/// The number of scheduled DXE drivers that can be loaded on the APs at once
+///
+#define IMAGE_LOAD_AHEAD_DEPTH  4
+
+///
+/// The time in microseconds an AP is given to load a DXE driver image. The BSP
+/// loads the image itself if the AP has not finished by then.
+///
+#define IMAGE_LOAD_AHEAD_TIMEOUT  1000000
+
 ///
 /// Define the initial size of the dependency expression evaluation stack
 ///
@@ -160,13 +175,52 @@ typedef struct {
 
   EFI_HANDLE                       ImageHandle;
   BOOLEAN                          IsFvImage;
+
+  VOID                             **DepexProtocols;     // Protocol entries the Depex pushes
+  UINTN                            DepexProtocolCount;
+  BOOLEAN                          DepexEvaluated;
+  UINT64                           DepexUpdateKey;       // Protocol update key of the last evaluation
 } EFI_CORE_DRIVER_ENTRY;
 
+//
+// The data structure of a node of an address index. See Library/AddressIndex.c.
+//
+typedef struct _ADDRESS_INDEX_NODE ADDRESS_INDEX_NODE;
+struct _ADDRESS_INDEX_NODE {
+  ADDRESS_INDEX_NODE    *Left;
+  ADDRESS_INDEX_NODE    *Right;
+  UINT64                Key;      // Start address of the range of the node
+  UINT32                Priority;
+};
+
+/**
+  Recompute the data the entry of a node keeps about its subtree from the
+  children of the node.
+
+  @param  Node                   The root of the subtree.
+
+**/
+typedef
+VOID
+(*ADDRESS_INDEX_UPDATE)(
+  IN ADDRESS_INDEX_NODE  *Node
+  );
+
+//
+// The data structure of an address index
+//
+typedef struct {
+  ADDRESS_INDEX_NODE      *Root;
+  UINT32                  Seed;     // State of the generator of the priorities
+  ADDRESS_INDEX_UPDATE    Update;   // Optional
+} ADDRESS_INDEX;
+
 //
 // The data structure of GCD memory map entry
 //
 #define EFI_GCD_MAP_SIGNATURE  SIGNATURE_32('g','c','d','m')
-typedef struct {
+typedef struct _EFI_GCD_MAP_ENTRY EFI_GCD_MAP_ENTRY;
+struct _EFI_GCD_MAP_ENTRY {
   UINTN                   Signature;
   LIST_ENTRY              Link;
   EFI_PHYSICAL_ADDRESS    BaseAddress;
@@ -177,7 +231,12 @@ typedef struct {
   EFI_GCD_IO_TYPE         GcdIoType;
   EFI_HANDLE              ImageHandle;
   EFI_HANDLE              DeviceHandle;
-} EFI_GCD_MAP_ENTRY;
+
+  ///
+  /// Node of the address index, used when PcdDxeGcdMapIndexEnable is TRUE
+  ///
+  ADDRESS_INDEX_NODE      IndexNode;
+};
 
 #define LOADED_IMAGE_PRIVATE_DATA_SIGNATURE  SIGNATURE_32('l','d','r','i')
 
@@ -1067,6 +1126,39 @@ CoreGetHandleDatabaseKey (
   VOID
   );
 
+/**
+  Get the protocol database entry of a protocol, and create it if the
+  protocol has not been seen yet. The entry can be passed to
+  CoreGetProtocolUpdateKey() later to find out if an interface of the
+  protocol has been installed or uninstalled since.
+
+  @param  Protocol               The ID of the protocol.
+
+  @return An opaque pointer to the protocol entry, or NULL if there is not
+          enough memory to create it.
+
+**/
+VOID *
+CoreGetProtocolEntry (
+  IN EFI_GUID  *Protocol
+  );
+
+/**
+  Get the protocol update key of a protocol, or of the whole protocol database.
+
+  @param  ProtocolEntry          A protocol entry returned by CoreGetProtocolEntry(),
+                                 or NULL for the whole protocol database.
+
+  @return The value of the protocol update key when an interface of the protocol
+          was last installed or uninstalled, or the current value of the protocol
+          update key if ProtocolEntry is NULL.
+
+**/
+UINT64
+CoreGetProtocolUpdateKey (
+  IN VOID  *ProtocolEntry OPTIONAL
+  );
+
 /**
   Go connect any handles that were created or modified while a image executed.
 
@@ -2353,6 +2445,21 @@ CloseSectionStream (
   IN  BOOLEAN  FreeStreamBuffer
   );
 
+/**
+  Get the number of bytes held by the encapsulated streams of a section
+  stream, that is the sections that have been decompressed or extracted from
+  it so far.
+
+  @param  SectionStreamHandle    The section stream.
+
+  @return The number of bytes held by the encapsulated streams.
+
+**/
+UINTN
+GetSectionStreamCacheSize (
+  IN UINTN  SectionStreamHandle
+  );
+
 /**
   Creates and initializes the DebugImageInfo Table.  Also creates the configuration
   table and registers it into the system table.
@@ -2515,6 +2622,67 @@ CoreReleaseLock (
   IN EFI_LOCK  *Lock
   );
 
+/**
+  Add a node to an address index.
+
+  @param  Index                  The address index.
+  @param  Node                   The node, embedded in the entry of the range.
+  @param  Key                    The start address of the range.
+
+**/
+VOID
+CoreAddressIndexInsert (
+  IN OUT ADDRESS_INDEX       *Index,
+  IN     ADDRESS_INDEX_NODE  *Node,
+  IN     UINT64              Key
+  );
+
+/**
+  Remove a node from an address index.
+
+  @param  Index                  The address index.
+  @param  Node                   The node, embedded in the entry of the range.
+
+**/
+VOID
+CoreAddressIndexRemove (
+  IN OUT ADDRESS_INDEX       *Index,
+  IN     ADDRESS_INDEX_NODE  *Node
+  );
+
+/**
+  Find the node of an address index with the highest start address at or
+  below an address. The range of that node is the only one that can contain
+  the address.
+
+  @param  Index                  The address index.
+  @param  Address                The address to look up.
+
+  @return The node, or NULL if all the nodes start above Address.
+
+**/
+ADDRESS_INDEX_NODE *
+CoreAddressIndexFind (
+  IN ADDRESS_INDEX  *Index,
+  IN UINT64         Address
+  );
+
+/**
+  Find the node of an address index with the lowest start address above an
+  address.
+
+  @param  Index                  The address index.
+  @param  Address                The address to look up.
+
+  @return The node, or NULL if no node starts above Address.
+
+**/
+ADDRESS_INDEX_NODE *
+CoreAddressIndexNext (
+  IN ADDRESS_INDEX  *Index,
+  IN UINT64         Address
+  );
+
 /**
   Read data from Firmware Block by FVB protocol Read.
   The data may cross the multi block ranges.
@@ -2698,6 +2866,110 @@ CoreInitializeMemoryProtection (
   VOID
   );
 
+/**
+  Initialize the DXE core performance counters. The counters are
+  reported at ReadyToBoot.
+**/
+VOID
+CoreInitializePerformanceCounters (
+  VOID
+  );
+
+/**
+  Log a DXE core performance counter.
+
+  The counter is logged as a performance event record whose string is
+  "Name=Value", so it shows up in the FPDT next to the timing records.
+
+  @param  Name                   The name of the counter.
+  @param  Value                  The value of the counter.
+
+**/
+VOID
+CoreLogPerformanceCounter (
+  IN CONST CHAR8  *Name,
+  IN UINT64       Value
+  );
+
+/**
+  Report the handle validation statistics through the performance counters.
+
+**/
+VOID
+CoreReportHandleValidationCounters (
+  VOID
+  );
+
+/**
+  Report the timer statistics through the performance counters.
+
+**/
+VOID
+CoreReportTimerCounters (
+  VOID
+  );
+
+/**
+  Report the statistics of the images loaded on the APs through the
+  performance counters.
+
+**/
+VOID
+CoreReportImageLoadAheadCounters (
+  VOID
+  );
+
+/**
+  Report the dependency expression evaluation statistics through the
+  performance counters.
+
+**/
+VOID
+CoreReportDepexCounters (
+  VOID
+  );
+
+/**
+  Report the section cache statistics through the performance counters.
+
+**/
+VOID
+CoreReportFvSectionCacheCounters (
+  VOID
+  );
+
+/**
+  Start loading a DXE driver image on an AP. The file of the image is read
+  and the pages of the image are allocated on the BSP, then the image is
+  copied into the pages and relocated on an AP.
+
+  @param  FilePath               The device path of the image file.
+
+  @retval EFI_SUCCESS            An AP is loading the image.
+  @retval EFI_ALREADY_STARTED    The image is already being loaded on an AP.
+  @retval EFI_OUT_OF_RESOURCES   No AP is available to load the image.
+  @retval EFI_UNSUPPORTED        The image cannot be loaded on an AP.
+  @retval EFI_NOT_FOUND          The image file was not found.
+
+**/
+EFI_STATUS
+CoreLoadImageAhead (
+  IN EFI_DEVICE_PATH_PROTOCOL  *FilePath
+  );
+
+/**
+  Release the images that were loaded on the APs but not used.
+
+  @param  Source                 If not NULL, only release the image loaded from
+                                 this file buffer. The caller owns the buffer.
+                                 If NULL, release all images.
+
+**/
+VOID
+CoreReleaseImageLoadAhead (
+  IN VOID  *Source  OPTIONAL
+  );
+
 /**
   Install MemoryAttributesTable on memory allocation.
 
@@ -348,6 +348,16 @@ DxeMain (
   Status = CoreInstallConfigurationTable (&gEfiHobListGuid, HobStart);
   ASSERT_EFI_ERROR (Status);
 
+  //
+  // Install the HOB directory built by DxeIpl into the EFI System Tables's Configuration
+  // Table, so that the DXE drivers can find the GUID HOBs without walking the HOB list.
+  //
+  GuidHob = GetFirstGuidHob (&gEdkiiHobDirectoryGuid);
+  if (GuidHob != NULL) {
+    Status = CoreInstallConfigurationTable (&gEdkiiHobDirectoryGuid, GET_GUID_HOB_DATA (GuidHob));
+    ASSERT_EFI_ERROR (Status);
+  }
+
   //
   // Install Memory Type Information Table into the EFI System Tables's Configuration Table
   //
@@ -454,6 +464,7 @@ DxeMain (
 
   CoreInitializeMemoryAttributesTable ();
   CoreInitializeMemoryProtection ();
+  CoreInitializePerformanceCounters ();
 
   //
   // Get persisted vector hand-off info from GUIDeed HOB again due to HobStart may be updated,
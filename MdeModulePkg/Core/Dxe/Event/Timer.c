@@ -1,6 +1,22 @@
 /** @file
   Core Timer Services
 
+  Timer events are kept in mEfiTimerList in ascending order of trigger time.
+  When PcdDxeTimerWheelEnable is TRUE they are kept in a hashed timer wheel
+  instead: each slot of the wheel covers 2^TIMER_WHEEL_SHIFT units of 100ns
+  and holds the timers whose trigger time falls in that slot in any revolution
+  of the wheel, in ascending order of trigger time. Arming a timer then only
+  scans the timers of one slot.
+
+  When PcdDxeTicklessTimerEnable is TRUE, the timer interrupt is reprogrammed
+  after each check of the timers so that it fires when the earliest timer is
+  due, plus PcdDxeTimerCoalescingWindow so that timers that are due shortly
+  after it expire on the same interrupt. The period never drops below the
+  period the timer driver was started with, and never exceeds
+  TICKLESS_TIMER_MAX_PERIOD. This requires a timer driver that reports the
+  time that really elapsed since the previous interrupt to CoreTimerTick,
+  even when its period was changed in between.
+
 Copyright (c) 2006 - 2013, Intel Corporation. All rights reserved.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
@@ -9,6 +25,14 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include "DxeMain.h"
 #include "Event.h"
 
+#define TIMER_WHEEL_SIZE   256
+#define TIMER_WHEEL_SHIFT  13
+
+//
+// The longest timer interrupt period in tickless mode, in 100ns units
+//
+#define TICKLESS_TIMER_MAX_PERIOD  10000000
+
 //
 // Internal data
 //
@@ -20,6 +44,43 @@ EFI_EVENT   mEfiCheckTimerEvent = NULL;
 EFI_LOCK  mEfiSystemTimeLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_HIGH_LEVEL);
 UINT64    mEfiSystemTime     = 0;
 
+//
+// mEfiTimerWheel            - The slots of the timer wheel
+// mEfiTimerWheelCursor      - The first slot, in units of slots since time 0, that may
+//                             still hold expired timers
+// mEfiTimerWheelNextTrigger - A trigger time at or before the earliest trigger time of
+//                             the timers in the wheel
+//
+LIST_ENTRY  mEfiTimerWheel[TIMER_WHEEL_SIZE];
+UINT64      mEfiTimerWheelCursor      = 0;
+UINT64      mEfiTimerWheelNextTrigger = MAX_UINT64;
+
+//
+// mEfiTimerInsertCount   - Number of timers armed
+// mEfiTimerInsertProbes  - Number of queued timers compared while arming timers
+// mEfiTimerExpireCount   - Number of timers signaled on expiry
+// mEfiTimerLatenessTotal - Sum of the delays between trigger time and signal of expired timers
+// mEfiTimerLatenessMax   - Largest delay between trigger time and signal of an expired timer
+//
+UINT64  mEfiTimerInsertCount   = 0;
+UINT64  mEfiTimerInsertProbes  = 0;
+UINT64  mEfiTimerExpireCount   = 0;
+UINT64  mEfiTimerLatenessTotal = 0;
+UINT64  mEfiTimerLatenessMax   = 0;
+
+//
+// mEfiTimerBasePeriod       - The timer interrupt period the timer driver was started with
+// mEfiTimerProgrammedPeriod - The timer interrupt period last programmed in tickless mode
+// mEfiTimerNextInterrupt    - The system time of the next timer interrupt in tickless mode
+// mEfiTimerTickCount        - Number of timer interrupts
+// mEfiTimerProgramCount     - Number of times the timer interrupt period was reprogrammed
+//
+UINT64  mEfiTimerBasePeriod       = 0;
+UINT64  mEfiTimerProgrammedPeriod = 0;
+UINT64  mEfiTimerNextInterrupt    = 0;
+UINT64  mEfiTimerTickCount        = 0;
+UINT64  mEfiTimerProgramCount     = 0;
+
 //
 // Timer functions
 //
@@ -37,6 +98,8 @@ CoreInsertEventTimer (
   )
 {
   UINT64      TriggerTime;
+  UINT64      Slot;
+  LIST_ENTRY  *List;
   LIST_ENTRY  *Link;
   IEVENT      *Event2;
 
@@ -47,10 +110,27 @@ CoreInsertEventTimer (
   //
   TriggerTime = Event->Timer.TriggerTime;
 
+  //
+  // With the timer wheel, only the timers of the slot of the trigger time
+  // need to be kept in order. A trigger time that wrapped around goes to the
+  // slot of the cursor, so that it expires on the next check.
+  //
+  List = &mEfiTimerList;
+  if (FeaturePcdGet (PcdDxeTimerWheelEnable)) {
+    Slot = MAX (RShiftU64 (TriggerTime, TIMER_WHEEL_SHIFT), mEfiTimerWheelCursor);
+    List = &mEfiTimerWheel[(UINTN)Slot & (TIMER_WHEEL_SIZE - 1)];
+    if (TriggerTime < mEfiTimerWheelNextTrigger) {
+      mEfiTimerWheelNextTrigger = TriggerTime;
+    }
+  }
+
+  mEfiTimerInsertCount++;
+
   //
   // Insert the timer into the timer database in assending sorted order
   //
-  for (Link = mEfiTimerList.ForwardLink; Link != &mEfiTimerList; Link = Link->ForwardLink) {
+  for (Link = List->ForwardLink; Link != List; Link = Link->ForwardLink) {
+    mEfiTimerInsertProbes++;
     Event2 = CR (Link, IEVENT, Timer.Link, EVENT_SIGNATURE);
 
     if (Event2->Timer.TriggerTime > TriggerTime) {
@@ -61,6 +141,144 @@ CoreInsertEventTimer (
   InsertTailList (Link, &Event->Timer.Link);
 }
 
+/**
+  Signals an expired timer and sets it again if it is periodic.
+
+  @param  Event                  The expired timer event. It has been removed
+                                 from the timer database.
+  @param  SystemTime             The current system time
+
+**/
+VOID
+CoreExpireEventTimer (
+  IN IEVENT  *Event,
+  IN UINT64  SystemTime
+  )
+{
+  UINT64  Lateness;
+
+  ASSERT_LOCKED (&mEfiTimerLock);
+
+  Lateness                = SystemTime - Event->Timer.TriggerTime;
+  mEfiTimerLatenessTotal += Lateness;
+  if (Lateness > mEfiTimerLatenessMax) {
+    mEfiTimerLatenessMax = Lateness;
+  }
+
+  mEfiTimerExpireCount++;
+
+  //
+  // Signal it
+  //
+  CoreSignalEvent (Event);
+
+  //
+  // If this is a periodic timer, set it
+  //
+  if (Event->Timer.Period != 0) {
+    //
+    // Compute the timers new trigger time
+    //
+    Event->Timer.TriggerTime = Event->Timer.TriggerTime + Event->Timer.Period;
+
+    //
+    // If that's before now, then reset the timer to start from now
+    //
+    if (Event->Timer.TriggerTime <= SystemTime) {
+      Event->Timer.TriggerTime = SystemTime;
+      CoreSignalEvent (mEfiCheckTimerEvent);
+    }
+
+    //
+    // Add the timer
+    //
+    CoreInsertEventTimer (Event);
+  }
+}
+
+/**
+  Checks the timer wheel against the current system time.
+  Signals any expired event timer in ascending order of trigger time. If the
+  wheel turned more than once since the previous check, the timers that are
+  late by more than a turn are signaled with the other timers of their slot.
+
+  @param  SystemTime             The current system time
+
+**/
+VOID
+CoreCheckTimerWheel (
+  IN UINT64  SystemTime
+  )
+{
+  UINT64      Now;
+  UINTN       Index;
+  LIST_ENTRY  *Slot;
+  IEVENT      *Event;
+
+  ASSERT_LOCKED (&mEfiTimerLock);
+
+  //
+  // Visit the slots from the cursor up to the slot of the current system time.
+  // A slot also holds the timers of later revolutions of the wheel, which sort
+  // after the timers of the slot being visited. No timer is due before
+  // mEfiTimerWheelNextTrigger, so the slots before it are skipped.
+  //
+  Now = RShiftU64 (SystemTime, TIMER_WHEEL_SHIFT);
+  if ((mEfiTimerWheelNextTrigger <= SystemTime) &&
+      (RShiftU64 (mEfiTimerWheelNextTrigger, TIMER_WHEEL_SHIFT) > mEfiTimerWheelCursor))
+  {
+    mEfiTimerWheelCursor = RShiftU64 (mEfiTimerWheelNextTrigger, TIMER_WHEEL_SHIFT);
+  }
+
+  //
+  // Visit at most one turn of the wheel, however long ago the previous check
+  // was. Each slot is then visited once, and the timers of the revolutions
+  // before the cursor sort first in their slot, so they all expire.
+  //
+  if (Now - mEfiTimerWheelCursor >= TIMER_WHEEL_SIZE) {
+    mEfiTimerWheelCursor = Now - (TIMER_WHEEL_SIZE - 1);
+  }
+
+  while (mEfiTimerWheelNextTrigger <= SystemTime) {
+    Slot = &mEfiTimerWheel[(UINTN)mEfiTimerWheelCursor & (TIMER_WHEEL_SIZE - 1)];
+    while (!IsListEmpty (Slot)) {
+      Event = CR (Slot->ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
+      if ((Event->Timer.TriggerTime > SystemTime) ||
+          (RShiftU64 (Event->Timer.TriggerTime, TIMER_WHEEL_SHIFT) > mEfiTimerWheelCursor))
+      {
+        break;
+      }
+
+      RemoveEntryList (&Event->Timer.Link);
+      Event->Timer.Link.ForwardLink = NULL;
+
+      CoreExpireEventTimer (Event, SystemTime);
+    }
+
+    if (mEfiTimerWheelCursor == Now) {
+      break;
+    }
+
+    mEfiTimerWheelCursor++;
+  }
+
+  mEfiTimerWheelCursor = Now;
+
+  //
+  // Each slot is sorted, so the earliest trigger time is at the head of a slot
+  //
+  mEfiTimerWheelNextTrigger = MAX_UINT64;
+  for (Index = 0; Index < TIMER_WHEEL_SIZE; Index++) {
+    Slot = &mEfiTimerWheel[Index];
+    if (!IsListEmpty (Slot)) {
+      Event = CR (Slot->ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
+      if (Event->Timer.TriggerTime < mEfiTimerWheelNextTrigger) {
+        mEfiTimerWheelNextTrigger = Event->Timer.TriggerTime;
+      }
+    }
+  }
+}
+
 /**
   Returns the current system time.
 
@@ -81,6 +299,107 @@ CoreCurrentSystemTime (
   return SystemTime;
 }
 
+/**
+  Returns the trigger time of the earliest timer in the timer database.
+
+  @return The earliest trigger time, or MAX_UINT64 if no timer is set. With
+          the timer wheel, the result may be earlier than the earliest trigger
+          time.
+
+**/
+UINT64
+CoreEarliestTimerTrigger (
+  VOID
+  )
+{
+  IEVENT  *Event;
+
+  ASSERT_LOCKED (&mEfiTimerLock);
+
+  if (FeaturePcdGet (PcdDxeTimerWheelEnable)) {
+    return mEfiTimerWheelNextTrigger;
+  }
+
+  if (IsListEmpty (&mEfiTimerList)) {
+    return MAX_UINT64;
+  }
+
+  Event = CR (mEfiTimerList.ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
+  return Event->Timer.TriggerTime;
+}
+
+/**
+  In tickless mode, programs the timer interrupt to fire when the earliest
+  timer is due.
+
+  @param  SystemTime             The current system time
+  @param  OnlyIfEarlier          If TRUE, the timer interrupt is only programmed
+                                 if it would fire earlier than it does now.
+
+**/
+VOID
+CoreProgramTimerInterrupt (
+  IN UINT64   SystemTime,
+  IN BOOLEAN  OnlyIfEarlier
+  )
+{
+  EFI_STATUS  Status;
+  UINT64      Deadline;
+  UINT64      Period;
+  UINT64      CurrentPeriod;
+
+  ASSERT_LOCKED (&mEfiTimerLock);
+
+  if (!FeaturePcdGet (PcdDxeTicklessTimerEnable) || (gTimer == NULL)) {
+    return;
+  }
+
+  //
+  // The timer driver may have been stopped, for example by ExitBootServices(),
+  // and must then stay stopped
+  //
+  Status = gTimer->GetTimerPeriod (gTimer, &CurrentPeriod);
+  if (EFI_ERROR (Status) || (CurrentPeriod == 0)) {
+    return;
+  }
+
+  if (mEfiTimerBasePeriod == 0) {
+    mEfiTimerBasePeriod       = CurrentPeriod;
+    mEfiTimerProgrammedPeriod = CurrentPeriod;
+    mEfiTimerNextInterrupt    = SystemTime + CurrentPeriod;
+  }
+
+  //
+  // Delay the interrupt by the coalescing window, so that the timers that
+  // are due within the window expire together
+  //
+  Deadline = CoreEarliestTimerTrigger ();
+  if (Deadline > MAX_UINT64 - PcdGet32 (PcdDxeTimerCoalescingWindow)) {
+    Deadline = MAX_UINT64;
+  } else {
+    Deadline += PcdGet32 (PcdDxeTimerCoalescingWindow);
+  }
+
+  Period = (Deadline > SystemTime) ? (Deadline - SystemTime) : 0;
+  Period = MAX (Period, mEfiTimerBasePeriod);
+  Period = MIN (Period, MAX (TICKLESS_TIMER_MAX_PERIOD, mEfiTimerBasePeriod));
+
+  if (SystemTime + Period == mEfiTimerNextInterrupt) {
+    return;
+  }
+
+  if (OnlyIfEarlier && (SystemTime + Period > mEfiTimerNextInterrupt)) {
+    return;
+  }
+
+  Status = gTimer->SetTimerPeriod (gTimer, Period);
+  if (!EFI_ERROR (Status)) {
+    mEfiTimerProgrammedPeriod = Period;
+    mEfiTimerNextInterrupt    = SystemTime + Period;
+    mEfiTimerProgramCount++;
+  }
+}
+
 /**
   Checks the sorted timer list against the current system time.
   Signals any expired event timer.
@@ -105,6 +424,13 @@ CoreCheckTimers (
   CoreAcquireLock (&mEfiTimerLock);
   SystemTime = CoreCurrentSystemTime ();
 
+  if (FeaturePcdGet (PcdDxeTimerWheelEnable)) {
+    CoreCheckTimerWheel (SystemTime);
+    CoreProgramTimerInterrupt (SystemTime, FALSE);
+    CoreReleaseLock (&mEfiTimerLock);
+    return;
+  }
+
   while (!IsListEmpty (&mEfiTimerList)) {
     Event = CR (mEfiTimerList.ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
 
@@ -122,35 +448,11 @@ CoreCheckTimers (
     RemoveEntryList (&Event->Timer.Link);
     Event->Timer.Link.ForwardLink = NULL;
 
-    //
-    // Signal it
-    //
-    CoreSignalEvent (Event);
-
-    //
-    // If this is a periodic timer, set it
-    //
-    if (Event->Timer.Period != 0) {
-      //
-      // Compute the timers new trigger time
-      //
-      Event->Timer.TriggerTime = Event->Timer.TriggerTime + Event->Timer.Period;
-
-      //
-      // If that's before now, then reset the timer to start from now
-      //
-      if (Event->Timer.TriggerTime <= SystemTime) {
-        Event->Timer.TriggerTime = SystemTime;
-        CoreSignalEvent (mEfiCheckTimerEvent);
-      }
-
-      //
-      // Add the timer
-      //
-      CoreInsertEventTimer (Event);
-    }
+    CoreExpireEventTimer (Event, SystemTime);
   }
 
+  CoreProgramTimerInterrupt (SystemTime, FALSE);
+
   CoreReleaseLock (&mEfiTimerLock);
 }
 
@@ -164,6 +466,11 @@ CoreInitializeTimer (
   )
 {
   EFI_STATUS  Status;
+  UINTN       Index;
+
+  for (Index = 0; Index < TIMER_WHEEL_SIZE; Index++) {
+    InitializeListHead (&mEfiTimerWheel[Index]);
+  }
 
   Status = CoreCreateEventInternal (
              EVT_NOTIFY_SIGNAL,
@@ -200,12 +507,21 @@ CoreTimerTick (
   // Update the system time
   //
   mEfiSystemTime += Duration;
+  mEfiTimerTickCount++;
 
   //
   // If the head of the list is expired, fire the timer event
-  // to process it
+  // to process it. In tickless mode, the timer event also programs
+  // the next interrupt.
   //
-  if (!IsListEmpty (&mEfiTimerList)) {
+  if (FeaturePcdGet (PcdDxeTicklessTimerEnable)) {
+    mEfiTimerNextInterrupt = mEfiSystemTime + mEfiTimerProgrammedPeriod;
+    CoreSignalEvent (mEfiCheckTimerEvent);
+  } else if (FeaturePcdGet (PcdDxeTimerWheelEnable)) {
+    if (mEfiTimerWheelNextTrigger <= mEfiSystemTime) {
+      CoreSignalEvent (mEfiCheckTimerEvent);
+    }
+  } else if (!IsListEmpty (&mEfiTimerList)) {
     Event = CR (mEfiTimerList.ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
 
     if (Event->Timer.TriggerTime <= mEfiSystemTime) {
@@ -240,6 +556,7 @@ CoreSetTimer (
   )
 {
   IEVENT  *Event;
+  UINT64  SystemTime;
 
   Event = UserEvent;
 
@@ -271,14 +588,20 @@ CoreSetTimer (
   if (Type != TimerCancel) {
     if (Type == TimerPeriodic) {
       if (TriggerTime == 0) {
-        gTimer->GetTimerPeriod (gTimer, &TriggerTime);
+        if (mEfiTimerBasePeriod != 0) {
+          TriggerTime = mEfiTimerBasePeriod;
+        } else {
+          gTimer->GetTimerPeriod (gTimer, &TriggerTime);
+        }
       }
 
       Event->Timer.Period = TriggerTime;
     }
 
-    Event->Timer.TriggerTime = CoreCurrentSystemTime () + TriggerTime;
+    SystemTime               = CoreCurrentSystemTime ();
+    Event->Timer.TriggerTime = SystemTime + TriggerTime;
     CoreInsertEventTimer (Event);
+    CoreProgramTimerInterrupt (SystemTime, TRUE);
 
     if (TriggerTime == 0) {
       CoreSignalEvent (mEfiCheckTimerEvent);
@@ -289,3 +612,21 @@ CoreSetTimer (
 
   return EFI_SUCCESS;
 }
+
+/**
+  Report the timer statistics through the performance counters.
+
+**/
+VOID
+CoreReportTimerCounters (
+  VOID
+  )
+{
+  CoreLogPerformanceCounter ("TmrInsert", mEfiTimerInsertCount);
+  CoreLogPerformanceCounter ("TmrInsProbe", mEfiTimerInsertProbes);
+  CoreLogPerformanceCounter ("TmrExpire", mEfiTimerExpireCount);
+  CoreLogPerformanceCounter ("TmrLateTotal", mEfiTimerLatenessTotal);
+  CoreLogPerformanceCounter ("TmrLateMax", mEfiTimerLatenessMax);
+  CoreLogPerformanceCounter ("TmrTick", mEfiTimerTickCount);
+  CoreLogPerformanceCounter ("TmrProgram", mEfiTimerProgramCount);
+}
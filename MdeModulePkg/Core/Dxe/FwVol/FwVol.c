@@ -266,6 +266,7 @@ FreeFvDeviceResource (
       //
       // Close stream and free resources from SEP
       //
+      FvSectionCacheRemove (FfsFileEntry);
       CloseSectionStream (FfsFileEntry->StreamHandle, FALSE);
     }
 
@@ -720,5 +721,6 @@ FwVolDriverInit (
                           NULL,
                           &gEfiFwVolBlockNotifyReg
                           );
+  FvSectionCacheInitialize ();
   return EFI_SUCCESS;
 }
@@ -20,6 +20,8 @@ typedef struct {
   EFI_FFS_FILE_HEADER    *FfsHeader;
   UINTN                  StreamHandle;
   BOOLEAN                FileCached;
+  LIST_ENTRY             CacheLink;     // mFvSectionCacheList
+  UINTN                  CacheSize;
 } FFS_FILE_LIST_ENTRY;
 
 typedef struct {
@@ -384,4 +386,41 @@ IsValidFfsFile (
   IN EFI_FFS_FILE_HEADER  *FfsHeader
   );
 
+/**
+  Account for a read of a section of a file, and close the section streams
+  of the least recently used files if the cache has grown too large.
+
+  @param  FfsEntry              The file whose section was read. Its section
+                                stream is open.
+  @param  Hit                   TRUE if the section stream of the file was
+                                already open before the read.
+
+**/
+VOID
+FvSectionCacheUpdate (
+  IN FFS_FILE_LIST_ENTRY  *FfsEntry,
+  IN BOOLEAN              Hit
+  );
+
+/**
+  Remove a file from the cache before its entry is freed. The caller closes
+  the section stream of the file.
+
+  @param  FfsEntry              The file to remove.
+
+**/
+VOID
+FvSectionCacheRemove (
+  IN FFS_FILE_LIST_ENTRY  *FfsEntry
+  );
+
+/**
+  Register the eviction of the section cache at ReadyToBoot.
+
+**/
+VOID
+FvSectionCacheInitialize (
+  VOID
+  );
+
 #endif
@@ -446,6 +446,7 @@ FvReadFileSection (
   UINTN                   FileSize;
   UINT8                   *FileBuffer;
   FFS_FILE_LIST_ENTRY     *FfsEntry;
+  BOOLEAN                 CacheHit;
 
   if ((NameGuid == NULL) || (Buffer == NULL)) {
     return EFI_INVALID_PARAMETER;
@@ -491,6 +492,7 @@ FvReadFileSection (
   //
   // Use FfsEntry to cache Section Extraction Protocol Information
   //
+  CacheHit = (BOOLEAN)(FfsEntry->StreamHandle != 0);
   if (FfsEntry->StreamHandle == 0) {
     Status = OpenSectionStream (
                FileSize,
@@ -516,6 +518,8 @@ FvReadFileSection (
              FvDevice->IsFfs3Fv
              );
 
+  FvSectionCacheUpdate (FfsEntry, CacheHit);
+
   if (!EFI_ERROR (Status)) {
     //
     // Inherit the authentication status.
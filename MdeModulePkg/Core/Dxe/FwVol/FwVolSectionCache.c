@@ -0,0 +1,201 @@
+/** @file
+  Bounded cache of the section streams of FV files.
+
+  FvReadFileSection() keeps the section stream of a file open after a read,
+  so that the sections the section extraction has decompressed or extracted
+  for it are found again when another section of the same file is read. When
+  PcdDxeFvSectionCacheEnable is TRUE, the files with an open section stream
+  are kept in least recently used order, and the streams of the least recently
+  used files are closed once the memory held by their encapsulated streams
+  exceeds PcdDxeFvSectionCacheSize. All cached streams are closed at
+  ReadyToBoot, so that the boot services memory they hold is released before
+  the OS loader runs.
+
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "DxeMain.h"
+#include "FwVolDriver.h"
+
+//
+// mFvSectionCacheList  - The files with an open section stream, least recently used first
+// mFvSectionCacheSize  - The memory held by the encapsulated streams of the cached files
+//
+LIST_ENTRY  mFvSectionCacheList = INITIALIZE_LIST_HEAD_VARIABLE (mFvSectionCacheList);
+UINTN       mFvSectionCacheSize = 0;
+
+//
+// Section cache statistics, reported through the performance counters.
+//
+// mFvSectionCacheHit       - Number of reads that found the section stream of the file open
+// mFvSectionCacheMiss      - Number of reads that had to open the section stream of the file
+// mFvSectionCacheEvict     - Number of section streams closed to stay within the cache size
+// mFvSectionCachePeakSize  - The highest value of mFvSectionCacheSize
+//
+UINT64  mFvSectionCacheHit      = 0;
+UINT64  mFvSectionCacheMiss     = 0;
+UINT64  mFvSectionCacheEvict    = 0;
+UINT64  mFvSectionCachePeakSize = 0;
+
+/**
+  Close the section stream of a cached file and remove it from the cache.
+
+  @param  FfsEntry              The cached file.
+
+**/
+STATIC
+VOID
+FvSectionCacheClose (
+  IN FFS_FILE_LIST_ENTRY  *FfsEntry
+  )
+{
+  RemoveEntryList (&FfsEntry->CacheLink);
+  mFvSectionCacheSize -= FfsEntry->CacheSize;
+
+  CloseSectionStream (FfsEntry->StreamHandle, FALSE);
+  FfsEntry->StreamHandle = 0;
+  FfsEntry->CacheSize    = 0;
+}
+
+/**
+  Account for a read of a section of a file, and close the section streams
+  of the least recently used files if the cache has grown too large.
+
+  @param  FfsEntry              The file whose section was read. Its section
+                                stream is open.
+  @param  Hit                   TRUE if the section stream of the file was
+                                already open before the read.
+
+**/
+VOID
+FvSectionCacheUpdate (
+  IN FFS_FILE_LIST_ENTRY  *FfsEntry,
+  IN BOOLEAN              Hit
+  )
+{
+  FFS_FILE_LIST_ENTRY  *Lru;
+
+  if (!FeaturePcdGet (PcdDxeFvSectionCacheEnable)) {
+    return;
+  }
+
+  ASSERT (FfsEntry->StreamHandle != 0);
+
+  if (Hit) {
+    mFvSectionCacheHit++;
+    RemoveEntryList (&FfsEntry->CacheLink);
+  } else {
+    mFvSectionCacheMiss++;
+    FfsEntry->CacheSize = 0;
+  }
+
+  InsertTailList (&mFvSectionCacheList, &FfsEntry->CacheLink);
+
+  //
+  // The read may have decompressed or extracted more encapsulated sections.
+  //
+  mFvSectionCacheSize -= FfsEntry->CacheSize;
+  FfsEntry->CacheSize  = GetSectionStreamCacheSize (FfsEntry->StreamHandle);
+  mFvSectionCacheSize += FfsEntry->CacheSize;
+  if (mFvSectionCacheSize > mFvSectionCachePeakSize) {
+    mFvSectionCachePeakSize = mFvSectionCacheSize;
+  }
+
+  while (mFvSectionCacheSize > PcdGet32 (PcdDxeFvSectionCacheSize)) {
+    Lru = BASE_CR (GetFirstNode (&mFvSectionCacheList), FFS_FILE_LIST_ENTRY, CacheLink);
+    if (Lru == FfsEntry) {
+      break;
+    }
+
+    FvSectionCacheClose (Lru);
+    mFvSectionCacheEvict++;
+  }
+}
+
+/**
+  Remove a file from the cache before its entry is freed. The caller closes
+  the section stream of the file.
+
+  @param  FfsEntry              The file to remove.
+
+**/
+VOID
+FvSectionCacheRemove (
+  IN FFS_FILE_LIST_ENTRY  *FfsEntry
+  )
+{
+  if (!FeaturePcdGet (PcdDxeFvSectionCacheEnable) || (FfsEntry->StreamHandle == 0)) {
+    return;
+  }
+
+  RemoveEntryList (&FfsEntry->CacheLink);
+  mFvSectionCacheSize -= FfsEntry->CacheSize;
+  FfsEntry->CacheSize  = 0;
+}
+
+/**
+  Close the section streams of all cached files at ReadyToBoot.
+
+  @param  Event                 The ReadyToBoot event.
+  @param  Context               Not used.
+
+**/
+STATIC
+VOID
+EFIAPI
+FvSectionCacheOnReadyToBoot (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  while (!IsListEmpty (&mFvSectionCacheList)) {
+    FvSectionCacheClose (BASE_CR (GetFirstNode (&mFvSectionCacheList), FFS_FILE_LIST_ENTRY, CacheLink));
+  }
+}
+
+/**
+  Register the eviction of the section cache at ReadyToBoot.
+
+**/
+VOID
+FvSectionCacheInitialize (
+  VOID
+  )
+{
+  EFI_STATUS  Status;
+  EFI_EVENT   ReadyToBootEvent;
+
+  if (!FeaturePcdGet (PcdDxeFvSectionCacheEnable)) {
+    return;
+  }
+
+  Status = CoreCreateEventInternal (
+             EVT_NOTIFY_SIGNAL,
+             TPL_CALLBACK,
+             FvSectionCacheOnReadyToBoot,
+             NULL,
+             &gEfiEventReadyToBootGuid,
+             &ReadyToBootEvent
+             );
+  ASSERT_EFI_ERROR (Status);
+}
+
+/**
+  Report the section cache statistics through the performance counters.
+
+**/
+VOID
+CoreReportFvSectionCacheCounters (
+  VOID
+  )
+{
+  if (!FeaturePcdGet (PcdDxeFvSectionCacheEnable)) {
+    return;
+  }
+
+  CoreLogPerformanceCounter ("FvSecHit", mFvSectionCacheHit);
+  CoreLogPerformanceCounter ("FvSecMiss", mFvSectionCacheMiss);
+  CoreLogPerformanceCounter ("FvSecEvict", mFvSectionCacheEvict);
+  CoreLogPerformanceCounter ("FvSecPeakSize", mFvSectionCachePeakSize);
+}
@@ -413,6 +413,7 @@ CoreAllocateGcdMapEntry (
 /**
   Internal function.  Inserts a new descriptor into a sorted list
 
+  @param  Map                    The GCD map that holds Entry
   @param  Link                   The linked list to insert the range BaseAddress
                                  and Length into
   @param  Entry                  A pointer to the entry that is inserted
@@ -426,6 +427,7 @@ CoreAllocateGcdMapEntry (
 **/
 EFI_STATUS
 CoreInsertGcdMapEntry (
+  IN LIST_ENTRY            *Map,
   IN LIST_ENTRY            *Link,
   IN EFI_GCD_MAP_ENTRY     *Entry,
   IN EFI_PHYSICAL_ADDRESS  BaseAddress,
@@ -439,10 +441,13 @@ CoreInsertGcdMapEntry (
   if (BaseAddress > Entry->BaseAddress) {
     ASSERT (BottomEntry->Signature == 0);
 
+    CoreGcdMapIndexRemove (Map, Entry);
     CopyMem (BottomEntry, Entry, sizeof (EFI_GCD_MAP_ENTRY));
     Entry->BaseAddress      = BaseAddress;
     BottomEntry->EndAddress = BaseAddress - 1;
     InsertTailList (Link, &BottomEntry->Link);
+    CoreGcdMapIndexInsert (Map, BottomEntry);
+    CoreGcdMapIndexInsert (Map, Entry);
   }
 
   if ((BaseAddress + Length - 1) < Entry->EndAddress) {
@@ -452,6 +457,7 @@ CoreInsertGcdMapEntry (
     TopEntry->BaseAddress = BaseAddress + Length;
     Entry->EndAddress     = BaseAddress + Length - 1;
     InsertHeadList (Link, &TopEntry->Link);
+    CoreGcdMapIndexInsert (Map, TopEntry);
   }
 
   return EFI_SUCCESS;
@@ -523,10 +529,13 @@ CoreMergeGcdMapEntry (
     return EFI_UNSUPPORTED;
   }
 
+  CoreGcdMapIndexRemove (Map, AdjacentEntry);
   if (Forward) {
     Entry->EndAddress = AdjacentEntry->EndAddress;
   } else {
+    CoreGcdMapIndexRemove (Map, Entry);
     Entry->BaseAddress = AdjacentEntry->BaseAddress;
+    CoreGcdMapIndexInsert (Map, Entry);
   }
 
   RemoveEntryList (AdjacentLink);
@@ -603,12 +612,29 @@ CoreSearchGcdMapEntry (
 {
   LIST_ENTRY         *Link;
   EFI_GCD_MAP_ENTRY  *Entry;
+  EFI_GCD_MAP_ENTRY  *EndEntry;
 
   ASSERT (Length != 0);
 
   *StartLink = NULL;
   *EndLink   = NULL;
 
+  if (FeaturePcdGet (PcdDxeGcdMapIndexEnable)) {
+    //
+    // The range ends in the entry that contains its last byte, which must not
+    // be below the entry that contains its first byte
+    //
+    Entry    = CoreGcdMapIndexFind (Map, BaseAddress);
+    EndEntry = CoreGcdMapIndexFind (Map, BaseAddress + Length - 1);
+    if ((Entry == NULL) || (EndEntry == NULL) || (EndEntry->BaseAddress < Entry->BaseAddress)) {
+      return EFI_NOT_FOUND;
+    }
+
+    *StartLink = &Entry->Link;
+    *EndLink   = &EndEntry->Link;
+    return EFI_SUCCESS;
+  }
+
   Link = Map->ForwardLink;
   while (Link != Map) {
     Entry = CR (Link, EFI_GCD_MAP_ENTRY, Link, EFI_GCD_MAP_SIGNATURE);
@@ -931,7 +957,7 @@ CoreConvertSpace (
   Link = StartLink;
   while (Link != EndLink->ForwardLink) {
     Entry = CR (Link, EFI_GCD_MAP_ENTRY, Link, EFI_GCD_MAP_SIGNATURE);
-    CoreInsertGcdMapEntry (Link, Entry, BaseAddress, Length, TopEntry, BottomEntry);
+    CoreInsertGcdMapEntry (Map, Link, Entry, BaseAddress, Length, TopEntry, BottomEntry);
     switch (Operation) {
       //
       // Add operations
@@ -1319,7 +1345,7 @@ CoreAllocateSpace (
   Link = StartLink;
   while (Link != EndLink->ForwardLink) {
     Entry = CR (Link, EFI_GCD_MAP_ENTRY, Link, EFI_GCD_MAP_SIGNATURE);
-    CoreInsertGcdMapEntry (Link, Entry, *BaseAddress, Length, TopEntry, BottomEntry);
+    CoreInsertGcdMapEntry (Map, Link, Entry, *BaseAddress, Length, TopEntry, BottomEntry);
     Entry->ImageHandle  = ImageHandle;
     Entry->DeviceHandle = DeviceHandle;
     Link                = Link->ForwardLink;
@@ -2544,6 +2570,7 @@ CoreInitializeGcdServices (
   Entry->EndAddress = LShiftU64 (1, SizeOfMemorySpace) - 1;
 
   InsertHeadList (&mGcdMemorySpaceMap, &Entry->Link);
+  CoreGcdMapIndexInsert (&mGcdMemorySpaceMap, Entry);
 
   CoreDumpGcdMemorySpaceMap (TRUE);
 
@@ -2556,6 +2583,7 @@ CoreInitializeGcdServices (
   Entry->EndAddress = LShiftU64 (1, SizeOfIoSpace) - 1;
 
   InsertHeadList (&mGcdIoSpaceMap, &Entry->Link);
+  CoreGcdMapIndexInsert (&mGcdIoSpaceMap, Entry);
 
   CoreDumpGcdIoSpaceMap (TRUE);
 
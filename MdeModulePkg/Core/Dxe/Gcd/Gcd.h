@@ -37,4 +37,50 @@ typedef struct {
   BOOLEAN    Memory;
 } GCD_ATTRIBUTE_CONVERSION_ENTRY;
 
+extern LIST_ENTRY  mGcdMemorySpaceMap;
+extern LIST_ENTRY  mGcdIoSpaceMap;
+
+/**
+  Add an entry that has just been inserted into a GCD map to the index of
+  that map.
+
+  @param  Map                    The GCD map that holds Entry.
+  @param  Entry                  The GCD map entry.
+
+**/
+VOID
+CoreGcdMapIndexInsert (
+  IN LIST_ENTRY         *Map,
+  IN EFI_GCD_MAP_ENTRY  *Entry
+  );
+
+/**
+  Remove an entry that is being removed from a GCD map, or whose base address
+  is about to change, from the index of that map.
+
+  @param  Map                    The GCD map that holds Entry.
+  @param  Entry                  The GCD map entry.
+
+**/
+VOID
+CoreGcdMapIndexRemove (
+  IN LIST_ENTRY         *Map,
+  IN EFI_GCD_MAP_ENTRY  *Entry
+  );
+
+/**
+  Find the GCD map entry that contains an address through the index.
+
+  @param  Map                    The GCD map to search.
+  @param  Address                The address to look up.
+
+  @return The GCD map entry, or NULL if no entry contains Address.
+
+**/
+EFI_GCD_MAP_ENTRY *
+CoreGcdMapIndexFind (
+  IN LIST_ENTRY            *Map,
+  IN EFI_PHYSICAL_ADDRESS  Address
+  );
+
 #endif
@@ -0,0 +1,118 @@
+/** @file
+  Address index of the GCD memory and I/O space maps.
+
+  The entries of a GCD map cover its whole address space without gaps or
+  overlaps, so the entry that contains an address is the one with the highest
+  base address at or below it. When PcdDxeGcdMapIndexEnable is TRUE, every
+  entry of a GCD map is also a node of an address index ordered by the base
+  address, which turns that lookup into a walk from the root to a leaf.
+
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "DxeMain.h"
+#include "Gcd.h"
+
+//
+// mGcdMemorySpaceMapIndex - The address index of the GCD memory space map
+// mGcdIoSpaceMapIndex     - The address index of the GCD I/O space map
+//
+ADDRESS_INDEX  mGcdMemorySpaceMapIndex = { NULL, 0x6C8E9CF5, NULL };
+ADDRESS_INDEX  mGcdIoSpaceMapIndex     = { NULL, 0x1B873593, NULL };
+
+/**
+  Get the address index of a GCD map.
+
+  @param  Map                    The GCD map.
+
+  @return The address index of Map.
+
+**/
+STATIC
+ADDRESS_INDEX *
+GcdMapIndex (
+  IN LIST_ENTRY  *Map
+  )
+{
+  if (Map == &mGcdMemorySpaceMap) {
+    return &mGcdMemorySpaceMapIndex;
+  }
+
+  ASSERT (Map == &mGcdIoSpaceMap);
+  return &mGcdIoSpaceMapIndex;
+}
+
+/**
+  Add an entry that has just been inserted into a GCD map to the index of
+  that map.
+
+  @param  Map                    The GCD map that holds Entry.
+  @param  Entry                  The GCD map entry.
+
+**/
+VOID
+CoreGcdMapIndexInsert (
+  IN LIST_ENTRY         *Map,
+  IN EFI_GCD_MAP_ENTRY  *Entry
+  )
+{
+  if (!FeaturePcdGet (PcdDxeGcdMapIndexEnable)) {
+    return;
+  }
+
+  CoreAddressIndexInsert (GcdMapIndex (Map), &Entry->IndexNode, Entry->BaseAddress);
+}
+
+/**
+  Remove an entry that is being removed from a GCD map, or whose base address
+  is about to change, from the index of that map.
+
+  @param  Map                    The GCD map that holds Entry.
+  @param  Entry                  The GCD map entry.
+
+**/
+VOID
+CoreGcdMapIndexRemove (
+  IN LIST_ENTRY         *Map,
+  IN EFI_GCD_MAP_ENTRY  *Entry
+  )
+{
+  if (!FeaturePcdGet (PcdDxeGcdMapIndexEnable)) {
+    return;
+  }
+
+  ASSERT (Entry->IndexNode.Key == Entry->BaseAddress);
+  CoreAddressIndexRemove (GcdMapIndex (Map), &Entry->IndexNode);
+}
+
+/**
+  Find the GCD map entry that contains an address through the index.
+
+  @param  Map                    The GCD map to search.
+  @param  Address                The address to look up.
+
+  @return The GCD map entry, or NULL if no entry contains Address.
+
+**/
+EFI_GCD_MAP_ENTRY *
+CoreGcdMapIndexFind (
+  IN LIST_ENTRY            *Map,
+  IN EFI_PHYSICAL_ADDRESS  Address
+  )
+{
+  ADDRESS_INDEX_NODE  *Node;
+  EFI_GCD_MAP_ENTRY   *Entry;
+
+  Node = CoreAddressIndexFind (GcdMapIndex (Map), Address);
+  if (Node == NULL) {
+    return NULL;
+  }
+
+  Entry = CR (Node, EFI_GCD_MAP_ENTRY, IndexNode, EFI_GCD_MAP_SIGNATURE);
+  if (Entry->EndAddress < Address) {
+    return NULL;
+  }
+
+  return Entry;
+}
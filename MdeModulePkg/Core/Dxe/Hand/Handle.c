@@ -11,14 +11,40 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 //
 // mProtocolDatabase     - A list of all protocols in the system.  (simple list for now)
+// mProtocolHashTable    - GUID-keyed hash index of the entries in mProtocolDatabase
+// mHandleHashTable      - Pointer-keyed hash index of the handles in gHandleList
+// mInterfaceHashTable   - Hash index of the protocol interfaces keyed by handle and protocol entry
 // gHandleList           - A list of all the handles in the system
 // gProtocolDatabaseLock - Lock to protect the mProtocolDatabase
 // gHandleDatabaseKey    -  The Key to show that the handle has been created/modified
+// gProtocolUpdateKey    -  The Key to show that a protocol interface has been added/removed
 //
 LIST_ENTRY  mProtocolDatabase     = INITIALIZE_LIST_HEAD_VARIABLE (mProtocolDatabase);
-LIST_ENTRY  gHandleList           = INITIALIZE_LIST_HEAD_VARIABLE (gHandleList);
-EFI_LOCK    gProtocolDatabaseLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_NOTIFY);
-UINT64      gHandleDatabaseKey    = 0;
+LIST_ENTRY  mProtocolHashTable[PROTOCOL_HASH_BUCKETS];
+BOOLEAN     mProtocolHashTableInitialized = FALSE;
+LIST_ENTRY  mHandleHashTable[HANDLE_HASH_BUCKETS];
+BOOLEAN     mHandleHashTableInitialized = FALSE;
+LIST_ENTRY  mInterfaceHashTableInitial[INTERFACE_HASH_BUCKETS];
+LIST_ENTRY  *mInterfaceHashTable  = NULL;
+UINTN       mInterfaceHashBuckets = 0;
+UINTN       mInterfaceCount       = 0;
+LIST_ENTRY  gHandleList                   = INITIALIZE_LIST_HEAD_VARIABLE (gHandleList);
+EFI_LOCK    gProtocolDatabaseLock         = EFI_INITIALIZE_LOCK_VARIABLE (TPL_NOTIFY);
+UINT64      gHandleDatabaseKey            = 0;
+UINT64      gProtocolUpdateKey            = 0;
+
+//
+// Handle validation statistics, reported through the performance counters.
+//
+// mHandleCount             - Number of handles in gHandleList
+// mHandleValidateCount     - Number of CoreValidateHandle() calls
+// mHandleValidateProbes    - Number of handles compared by CoreValidateHandle()
+// mHandleValidateListCost  - Number of handles a walk of gHandleList would have compared
+//
+UINTN   mHandleCount            = 0;
+UINT64  mHandleValidateCount    = 0;
+UINT64  mHandleValidateProbes   = 0;
+UINT64  mHandleValidateListCost = 0;
 
 /**
   Acquire lock on gProtocolDatabaseLock.
@@ -44,6 +70,208 @@ CoreReleaseProtocolLock (
   CoreReleaseLock (&gProtocolDatabaseLock);
 }
 
+/**
+  Return the bucket of mHandleHashTable that holds a handle.
+
+  The handle value is only used as a number, it is never dereferenced, so
+  arbitrary values passed in by callers can be looked up safely.
+
+  @param  UserHandle             The handle to look up
+
+  @return The hash bucket list head.
+
+**/
+LIST_ENTRY *
+CoreGetHandleHashBucket (
+  IN  EFI_HANDLE  UserHandle
+  )
+{
+  UINTN  Address;
+  UINTN  Index;
+
+  if (!mHandleHashTableInitialized) {
+    for (Index = 0; Index < HANDLE_HASH_BUCKETS; Index++) {
+      InitializeListHead (&mHandleHashTable[Index]);
+    }
+
+    mHandleHashTableInitialized = TRUE;
+  }
+
+  //
+  // Handles are pool allocations, so the low bits carry no information.
+  //
+  Address = (UINTN)UserHandle >> 3;
+  Index   = (Address ^ (Address >> 8) ^ (Address >> 16)) & (HANDLE_HASH_BUCKETS - 1);
+
+  return &mHandleHashTable[Index];
+}
+
+/**
+  Add a newly created handle to the handle hash table so that
+  CoreValidateHandle() can find it.
+  The gProtocolDatabaseLock must be owned
+
+  @param  Handle                 The handle to add
+
+**/
+VOID
+CoreInsertHandleHash (
+  IN IHANDLE  *Handle
+  )
+{
+  ASSERT_LOCKED (&gProtocolDatabaseLock);
+
+  InsertTailList (CoreGetHandleHashBucket (Handle), &Handle->HashLink);
+  mHandleCount++;
+}
+
+/**
+  Remove a handle that is about to be freed from the handle hash table.
+  The gProtocolDatabaseLock must be owned
+
+  @param  Handle                 The handle to remove
+
+**/
+VOID
+CoreRemoveHandleHash (
+  IN IHANDLE  *Handle
+  )
+{
+  ASSERT_LOCKED (&gProtocolDatabaseLock);
+
+  RemoveEntryList (&Handle->HashLink);
+  mHandleCount--;
+}
+
+/**
+  Return the bucket of mInterfaceHashTable that holds the interfaces of a
+  protocol on a handle.
+
+  @param  Handle                 The handle
+  @param  ProtEntry              The protocol entry
+
+  @return The hash bucket list head.
+
+**/
+STATIC
+LIST_ENTRY *
+CoreGetInterfaceHashBucket (
+  IN IHANDLE         *Handle,
+  IN PROTOCOL_ENTRY  *ProtEntry
+  )
+{
+  UINTN   Index;
+  UINT32  Hash;
+
+  if (mInterfaceHashTable == NULL) {
+    for (Index = 0; Index < INTERFACE_HASH_BUCKETS; Index++) {
+      InitializeListHead (&mInterfaceHashTableInitial[Index]);
+    }
+
+    mInterfaceHashTable   = mInterfaceHashTableInitial;
+    mInterfaceHashBuckets = INTERFACE_HASH_BUCKETS;
+  }
+
+  //
+  // Handles and protocol entries are pool allocations, so the low bits carry
+  // no information. The multiplication spreads the protocols of a handle over
+  // the buckets.
+  //
+  Hash  = (UINT32)((UINTN)Handle >> 3);
+  Hash ^= (UINT32)((UINTN)ProtEntry >> 3) * 0x9E3779B1;
+  Hash ^= Hash >> 16;
+
+  return &mInterfaceHashTable[Hash & (mInterfaceHashBuckets - 1)];
+}
+
+/**
+  Double the buckets of mInterfaceHashTable. If there is not enough memory,
+  the index keeps working with the buckets it has.
+
+**/
+STATIC
+VOID
+CoreGrowInterfaceHash (
+  VOID
+  )
+{
+  LIST_ENTRY          *OldTable;
+  LIST_ENTRY          *NewTable;
+  UINTN               OldBuckets;
+  UINTN               Index;
+  PROTOCOL_INTERFACE  *Prot;
+
+  NewTable = AllocatePool (mInterfaceHashBuckets * 2 * sizeof (LIST_ENTRY));
+  if (NewTable == NULL) {
+    return;
+  }
+
+  OldTable              = mInterfaceHashTable;
+  OldBuckets            = mInterfaceHashBuckets;
+  mInterfaceHashTable   = NewTable;
+  mInterfaceHashBuckets = OldBuckets * 2;
+  for (Index = 0; Index < mInterfaceHashBuckets; Index++) {
+    InitializeListHead (&NewTable[Index]);
+  }
+
+  for (Index = 0; Index < OldBuckets; Index++) {
+    while (!IsListEmpty (&OldTable[Index])) {
+      Prot = CR (OldTable[Index].ForwardLink, PROTOCOL_INTERFACE, HashLink, PROTOCOL_INTERFACE_SIGNATURE);
+      RemoveEntryList (&Prot->HashLink);
+      InsertTailList (CoreGetInterfaceHashBucket (Prot->Handle, Prot->Protocol), &Prot->HashLink);
+    }
+  }
+
+  if (OldTable != mInterfaceHashTableInitial) {
+    CoreFreePool (OldTable);
+  }
+}
+
+/**
+  Add a protocol interface that is installed on a handle to the interface
+  hash index, so that CoreGetProtocolInterface() can find it.
+  The gProtocolDatabaseLock must be owned
+
+  @param  Prot                   The protocol interface to add
+
+**/
+VOID
+CoreInsertInterfaceHash (
+  IN PROTOCOL_INTERFACE  *Prot
+  )
+{
+  ASSERT_LOCKED (&gProtocolDatabaseLock);
+
+  //
+  // Keep two interfaces per bucket on average at most.
+  //
+  if ((mInterfaceHashTable != NULL) && (mInterfaceCount >= mInterfaceHashBuckets * 2)) {
+    CoreGrowInterfaceHash ();
+  }
+
+  InsertHeadList (CoreGetInterfaceHashBucket (Prot->Handle, Prot->Protocol), &Prot->HashLink);
+  mInterfaceCount++;
+}
+
+/**
+  Remove a protocol interface that is uninstalled from the interface hash
+  index.
+  The gProtocolDatabaseLock must be owned
+
+  @param  Prot                   The protocol interface to remove
+
+**/
+VOID
+CoreRemoveInterfaceHash (
+  IN PROTOCOL_INTERFACE  *Prot
+  )
+{
+  ASSERT_LOCKED (&gProtocolDatabaseLock);
+
+  RemoveEntryList (&Prot->HashLink);
+  mInterfaceCount--;
+}
+
 /**
   Check whether a handle is a valid EFI_HANDLE
   The gProtocolDatabaseLock must be owned
@@ -60,6 +288,7 @@ CoreValidateHandle (
   )
 {
   IHANDLE     *Handle;
+  LIST_ENTRY  *Bucket;
   LIST_ENTRY  *Link;
 
   if (UserHandle == NULL) {
@@ -68,8 +297,17 @@ CoreValidateHandle (
 
   ASSERT_LOCKED (&gProtocolDatabaseLock);
 
-  for (Link = gHandleList.BackLink; Link != &gHandleList; Link = Link->BackLink) {
-    Handle = CR (Link, IHANDLE, AllHandles, EFI_HANDLE_SIGNATURE);
+  mHandleValidateCount++;
+  mHandleValidateListCost += mHandleCount;
+
+  //
+  // Only the handles that hash to the same bucket are compared. As with the
+  // walk of gHandleList, UserHandle is never dereferenced before it is found.
+  //
+  Bucket = CoreGetHandleHashBucket (UserHandle);
+  for (Link = Bucket->ForwardLink; Link != Bucket; Link = Link->ForwardLink) {
+    mHandleValidateProbes++;
+    Handle = CR (Link, IHANDLE, HashLink, EFI_HANDLE_SIGNATURE);
     if (Handle == (IHANDLE *)UserHandle) {
       return EFI_SUCCESS;
     }
@@ -78,6 +316,49 @@ CoreValidateHandle (
   return EFI_INVALID_PARAMETER;
 }
 
+/**
+  Report the handle validation statistics through the performance counters.
+
+**/
+VOID
+CoreReportHandleValidationCounters (
+  VOID
+  )
+{
+  CoreLogPerformanceCounter ("HndValidate", mHandleValidateCount);
+  CoreLogPerformanceCounter ("HndValProbe", mHandleValidateProbes);
+  CoreLogPerformanceCounter ("HndValListCost", mHandleValidateListCost);
+}
+
+/**
+  Compute the bucket index of a protocol GUID in mProtocolHashTable.
+
+  @param  Protocol               The ID of the protocol
+
+  @return Index of the hash bucket that holds the protocol entry.
+
+**/
+UINTN
+CoreProtocolHashIndex (
+  IN EFI_GUID  *Protocol
+  )
+{
+  UINT32  Hash;
+
+  //
+  // GUIDs are already well distributed, so folding the four 32-bit words
+  // together is enough to spread them over the buckets.
+  //
+  Hash  = ReadUnaligned32 ((UINT32 *)Protocol);
+  Hash ^= ReadUnaligned32 ((UINT32 *)Protocol + 1);
+  Hash ^= ReadUnaligned32 ((UINT32 *)Protocol + 2);
+  Hash ^= ReadUnaligned32 ((UINT32 *)Protocol + 3);
+  Hash ^= Hash >> 16;
+  Hash ^= Hash >> 8;
+
+  return (UINTN)(Hash & (PROTOCOL_HASH_BUCKETS - 1));
+}
+
 /**
   Finds the protocol entry for the requested protocol.
   The gProtocolDatabaseLock must be owned
@@ -94,22 +375,30 @@ CoreFindProtocolEntry (
   IN BOOLEAN   Create
   )
 {
+  LIST_ENTRY      *Bucket;
   LIST_ENTRY      *Link;
   PROTOCOL_ENTRY  *Item;
   PROTOCOL_ENTRY  *ProtEntry;
+  UINTN           Index;
 
   ASSERT_LOCKED (&gProtocolDatabaseLock);
 
+  if (!mProtocolHashTableInitialized) {
+    for (Index = 0; Index < PROTOCOL_HASH_BUCKETS; Index++) {
+      InitializeListHead (&mProtocolHashTable[Index]);
+    }
+
+    mProtocolHashTableInitialized = TRUE;
+  }
+
   //
-  // Search the database for the matching GUID
+  // Search the hash bucket of the database for the matching GUID
   //
 
   ProtEntry = NULL;
-  for (Link = mProtocolDatabase.ForwardLink;
-       Link != &mProtocolDatabase;
-       Link = Link->ForwardLink)
-  {
-    Item = CR (Link, PROTOCOL_ENTRY, AllEntries, PROTOCOL_ENTRY_SIGNATURE);
+  Bucket    = &mProtocolHashTable[CoreProtocolHashIndex (Protocol)];
+  for (Link = Bucket->ForwardLink; Link != Bucket; Link = Link->ForwardLink) {
+    Item = CR (Link, PROTOCOL_ENTRY, HashLink, PROTOCOL_ENTRY_SIGNATURE);
     if (CompareGuid (&Item->ProtocolID, Protocol)) {
       //
       // This is the protocol entry
@@ -135,11 +424,13 @@ CoreFindProtocolEntry (
       CopyGuid ((VOID *)&ProtEntry->ProtocolID, Protocol);
       InitializeListHead (&ProtEntry->Protocols);
       InitializeListHead (&ProtEntry->Notify);
+      ProtEntry->UpdateKey = 0;
 
       //
-      // Add it to protocol database
+      // Add it to protocol database and to its hash bucket
       //
       InsertTailList (&mProtocolDatabase, &ProtEntry->AllEntries);
+      InsertTailList (Bucket, &ProtEntry->HashLink);
     }
   }
 
@@ -167,6 +458,7 @@ CoreFindProtocolInterface (
 {
   PROTOCOL_INTERFACE  *Prot;
   PROTOCOL_ENTRY      *ProtEntry;
+  LIST_ENTRY          *Bucket;
   LIST_ENTRY          *Link;
 
   ASSERT_LOCKED (&gProtocolDatabaseLock);
@@ -179,14 +471,15 @@ CoreFindProtocolInterface (
   ProtEntry = CoreFindProtocolEntry (Protocol, FALSE);
   if (ProtEntry != NULL) {
     //
-    // Look at each protocol interface for any matches
+    // Look at each protocol interface of the hash bucket for any matches
     //
-    for (Link = Handle->Protocols.ForwardLink; Link != &Handle->Protocols; Link = Link->ForwardLink) {
+    Bucket = CoreGetInterfaceHashBucket (Handle, ProtEntry);
+    for (Link = Bucket->ForwardLink; Link != Bucket; Link = Link->ForwardLink) {
       //
       // If this protocol interface matches, remove it
       //
-      Prot = CR (Link, PROTOCOL_INTERFACE, Link, PROTOCOL_INTERFACE_SIGNATURE);
-      if ((Prot->Interface == Interface) && (Prot->Protocol == ProtEntry)) {
+      Prot = CR (Link, PROTOCOL_INTERFACE, HashLink, PROTOCOL_INTERFACE_SIGNATURE);
+      if ((Prot->Handle == Handle) && (Prot->Protocol == ProtEntry) && (Prot->Interface == Interface)) {
         break;
       }
 
@@ -409,6 +702,7 @@ CoreInstallProtocolInterfaceNotify (
     // in the system
     //
     InsertTailList (&gHandleList, &Handle->AllHandles);
+    CoreInsertHandleHash (Handle);
   } else {
     Status = CoreValidateHandle (Handle);
     if (EFI_ERROR (Status)) {
@@ -441,12 +735,15 @@ CoreInstallProtocolInterfaceNotify (
   // protocol list for this handle
   //
   InsertHeadList (&Handle->Protocols, &Prot->Link);
+  CoreInsertInterfaceHash (Prot);
 
   //
   // Add this protocol interface to the tail of the
   // protocol entry
   //
   InsertTailList (&ProtEntry->Protocols, &Prot->ByProtocol);
+  gProtocolUpdateKey++;
+  ProtEntry->UpdateKey = gProtocolUpdateKey;
 
   //
   // Notify the notification list for this protocol
@@ -756,6 +1053,7 @@ CoreUninstallProtocolInterface (
     // Remove the protocol interface from the handle
     //
     RemoveEntryList (&Prot->Link);
+    CoreRemoveInterfaceHash (Prot);
 
     //
     // Free the memory
@@ -771,6 +1069,7 @@ CoreUninstallProtocolInterface (
   if (IsListEmpty (&Handle->Protocols)) {
     Handle->Signature = 0;
     RemoveEntryList (&Handle->AllHandles);
+    CoreRemoveHandleHash (Handle);
     CoreFreePool (Handle);
   }
 
@@ -878,6 +1177,7 @@ CoreGetProtocolInterface (
   PROTOCOL_ENTRY      *ProtEntry;
   PROTOCOL_INTERFACE  *Prot;
   IHANDLE             *Handle;
+  LIST_ENTRY          *Bucket;
   LIST_ENTRY          *Link;
 
   Status = CoreValidateHandle (UserHandle);
@@ -888,12 +1188,23 @@ CoreGetProtocolInterface (
   Handle = (IHANDLE *)UserHandle;
 
   //
-  // Look at each protocol interface for a match
+  // Resolve the protocol entry once through the hash index. If the protocol
+  // is not in the database, then no handle can support it.
   //
-  for (Link = Handle->Protocols.ForwardLink; Link != &Handle->Protocols; Link = Link->ForwardLink) {
-    Prot      = CR (Link, PROTOCOL_INTERFACE, Link, PROTOCOL_INTERFACE_SIGNATURE);
-    ProtEntry = Prot->Protocol;
-    if (CompareGuid (&ProtEntry->ProtocolID, Protocol)) {
+  ProtEntry = CoreFindProtocolEntry (Protocol, FALSE);
+  if (ProtEntry == NULL) {
+    return NULL;
+  }
+
+  //
+  // Only the interfaces that hash to the same bucket as the handle and the
+  // protocol entry are compared. Protocol entries are unique per GUID, so
+  // comparing the entry pointers is sufficient.
+  //
+  Bucket = CoreGetInterfaceHashBucket (Handle, ProtEntry);
+  for (Link = Bucket->ForwardLink; Link != Bucket; Link = Link->ForwardLink) {
+    Prot = CR (Link, PROTOCOL_INTERFACE, HashLink, PROTOCOL_INTERFACE_SIGNATURE);
+    if ((Prot->Handle == Handle) && (Prot->Protocol == ProtEntry)) {
       return Prot;
     }
   }
@@ -1504,6 +1815,63 @@ CoreGetHandleDatabaseKey (
   return gHandleDatabaseKey;
 }
 
+/**
+  Get the protocol database entry of a protocol, and create it if the
+  protocol has not been seen yet. The entry can be passed to
+  CoreGetProtocolUpdateKey() later to find out if an interface of the
+  protocol has been installed or uninstalled since.
+
+  @param  Protocol               The ID of the protocol.
+
+  @return An opaque pointer to the protocol entry, or NULL if there is not
+          enough memory to create it.
+
+**/
+VOID *
+CoreGetProtocolEntry (
+  IN EFI_GUID  *Protocol
+  )
+{
+  PROTOCOL_ENTRY  *ProtEntry;
+
+  CoreAcquireProtocolLock ();
+  ProtEntry = CoreFindProtocolEntry (Protocol, TRUE);
+  CoreReleaseProtocolLock ();
+
+  return ProtEntry;
+}
+
+/**
+  Get the protocol update key of a protocol, or of the whole protocol database.
+
+  @param  ProtocolEntry          A protocol entry returned by CoreGetProtocolEntry(),
+                                 or NULL for the whole protocol database.
+
+  @return The value of the protocol update key when an interface of the protocol
+          was last installed or uninstalled, or the current value of the protocol
+          update key if ProtocolEntry is NULL.
+
+**/
+UINT64
+CoreGetProtocolUpdateKey (
+  IN VOID  *ProtocolEntry OPTIONAL
+  )
+{
+  UINT64  Key;
+
+  CoreAcquireProtocolLock ();
+  if (ProtocolEntry == NULL) {
+    Key = gProtocolUpdateKey;
+  } else {
+    ASSERT (((PROTOCOL_ENTRY *)ProtocolEntry)->Signature == PROTOCOL_ENTRY_SIGNATURE);
+    Key = ((PROTOCOL_ENTRY *)ProtocolEntry)->UpdateKey;
+  }
+
+  CoreReleaseProtocolLock ();
+
+  return Key;
+}
+
 /**
   Go connect any handles that were created or modified while a image executed.
 
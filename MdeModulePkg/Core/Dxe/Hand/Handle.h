@@ -23,12 +23,33 @@ typedef struct {
   UINTN         LocateRequest;
   /// The Handle Database Key value when this handle was last created or modified
   UINT64        Key;
+  /// Link on the mHandleHashTable bucket used by CoreValidateHandle()
+  LIST_ENTRY    HashLink;
 } IHANDLE;
 
+///
+/// Number of buckets in the pointer-keyed handle hash table used to validate
+/// handles. Must be a power of 2.
+///
+#define HANDLE_HASH_BUCKETS  256
+
+///
+/// Number of buckets the hash index of the protocol interfaces starts with.
+/// The index doubles its buckets as more interfaces are installed. Must be a
+/// power of 2.
+///
+#define INTERFACE_HASH_BUCKETS  256
+
 #define ASSERT_IS_HANDLE(a)  ASSERT((a)->Signature == EFI_HANDLE_SIGNATURE)
 
 #define PROTOCOL_ENTRY_SIGNATURE  SIGNATURE_32('p','r','t','e')
 
+///
+/// Number of buckets in the GUID-keyed protocol entry hash index.
+/// Must be a power of 2.
+///
+#define PROTOCOL_HASH_BUCKETS  64
+
 ///
 /// PROTOCOL_ENTRY - each different protocol has 1 entry in the protocol
 /// database.  Each handler that supports this protocol is listed, along
@@ -38,12 +59,16 @@ typedef struct {
   UINTN         Signature;
   /// Link Entry inserted to mProtocolDatabase
   LIST_ENTRY    AllEntries;
+  /// Link Entry inserted to the mProtocolHashTable bucket for ProtocolID
+  LIST_ENTRY    HashLink;
   /// ID of the protocol
   EFI_GUID      ProtocolID;
   /// All protocol interfaces
   LIST_ENTRY    Protocols;
   /// Registerd notification handlers
   LIST_ENTRY    Notify;
+  /// The Protocol Update Key value when an interface was last added to or removed from Protocols
+  UINT64        UpdateKey;
 } PROTOCOL_ENTRY;
 
 #define PROTOCOL_INTERFACE_SIGNATURE  SIGNATURE_32('p','i','f','c')
@@ -62,6 +87,8 @@ typedef struct {
   LIST_ENTRY        ByProtocol;
   /// The protocol ID
   PROTOCOL_ENTRY    *Protocol;
+  /// Link on the mInterfaceHashTable bucket for Handle and Protocol
+  LIST_ENTRY        HashLink;
   /// The interface value
   VOID              *Interface;
   /// OPEN_PROTOCOL_DATA list
@@ -98,6 +125,19 @@ typedef struct {
   LIST_ENTRY        *Position;
 } PROTOCOL_NOTIFY;
 
+/**
+  Compute the bucket index of a protocol GUID in mProtocolHashTable.
+
+  @param  Protocol               The ID of the protocol
+
+  @return Index of the hash bucket that holds the protocol entry.
+
+**/
+UINTN
+CoreProtocolHashIndex (
+  IN EFI_GUID  *Protocol
+  );
+
 /**
   Finds the protocol entry for the requested protocol.
   The gProtocolDatabaseLock must be owned
@@ -227,6 +267,72 @@ CoreReleaseProtocolLock (
   VOID
   );
 
+/**
+  Add a newly created handle to the handle hash table so that
+  CoreValidateHandle() can find it.
+  The gProtocolDatabaseLock must be owned
+
+  @param  Handle                 The handle to add
+
+**/
+VOID
+CoreInsertHandleHash (
+  IN IHANDLE  *Handle
+  );
+
+/**
+  Remove a handle that is about to be freed from the handle hash table.
+  The gProtocolDatabaseLock must be owned
+
+  @param  Handle                 The handle to remove
+
+**/
+VOID
+CoreRemoveHandleHash (
+  IN IHANDLE  *Handle
+  );
+
+/**
+  Add a protocol interface that is installed on a handle to the interface
+  hash index, so that CoreGetProtocolInterface() can find it.
+  The gProtocolDatabaseLock must be owned
+
+  @param  Prot                   The protocol interface to add
+
+**/
+VOID
+CoreInsertInterfaceHash (
+  IN PROTOCOL_INTERFACE  *Prot
+  );
+
+/**
+  Remove a protocol interface that is uninstalled from the interface hash
+  index.
+  The gProtocolDatabaseLock must be owned
+
+  @param  Prot                   The protocol interface to remove
+
+**/
+VOID
+CoreRemoveInterfaceHash (
+  IN PROTOCOL_INTERFACE  *Prot
+  );
+
+/**
+  Locate a certain GUID protocol interface in a Handle's protocols.
+
+  @param  UserHandle             The handle to obtain the protocol interface on
+  @param  Protocol               The GUID of the protocol
+
+  @return The requested protocol interface for the handle
+
+**/
+PROTOCOL_INTERFACE  *
+CoreGetProtocolInterface (
+  IN  EFI_HANDLE  UserHandle,
+  IN  EFI_GUID    *Protocol
+  );
+
 /**
   Check whether a handle is a valid EFI_HANDLE
   The gProtocolDatabaseLock must be owned
@@ -248,5 +354,6 @@ CoreValidateHandle (
 extern EFI_LOCK    gProtocolDatabaseLock;
 extern LIST_ENTRY  gHandleList;
 extern UINT64      gHandleDatabaseKey;
+extern UINT64      gProtocolUpdateKey;
 
 #endif
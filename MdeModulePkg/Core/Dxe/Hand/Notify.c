@@ -76,6 +76,8 @@ CoreRemoveInterfaceFromProtocol (
     // Remove the protocol interface entry
     //
     RemoveEntryList (&Prot->ByProtocol);
+    gProtocolUpdateKey++;
+    ProtEntry->UpdateKey = gProtocolUpdateKey;
   }
 
   return Prot;
@@ -582,6 +582,7 @@ CoreLoadPeImage (
 {
   EFI_STATUS  Status;
   BOOLEAN     DstBufAlocated;
+  BOOLEAN     Loaded;
   UINTN       Size;
 
   ZeroMem (&Image->ImageContext, sizeof (Image->ImageContext));
@@ -633,6 +634,20 @@ CoreLoadPeImage (
       return EFI_UNSUPPORTED;
   }
 
+  //
+  // If an AP has already loaded and relocated the image while the previous
+  // driver was running, use that copy. If the AP failed, load the image into
+  // the pages allocated for it here.
+  //
+  if ((DstBuffer == 0) && CoreTakeImageLoadAhead (Pe32Handle, Image, &Loaded)) {
+    DstBufAlocated = TRUE;
+    if (Loaded) {
+      goto Relocate;
+    }
+
+    goto Load;
+  }
+
   //
   // Allocate memory of the correct memory type aligned on the required image boundary
   //
@@ -736,6 +751,7 @@ CoreLoadPeImage (
       ~((UINTN)Image->ImageContext.SectionAlignment - 1);
   }
 
+Load:
   //
   // Load the image from the file into the allocated memory
   //
@@ -759,8 +775,10 @@ CoreLoadPeImage (
     }
   }
 
+Relocate:
   //
-  // Relocate the image in memory
+  // Relocate the image in memory. The fixups of an image relocated on an AP
+  // are already applied, so this only does the extra actions of the loader.
   //
   Status = PeCoffLoaderRelocateImage (&Image->ImageContext);
   if (EFI_ERROR (Status)) {
@@ -1240,14 +1258,18 @@ CoreLoadImageCommon (
     }
 
     //
-    // Get the source file buffer by its device path.
+    // Get the source file buffer by its device path, unless the dispatcher
+    // has already read it to load the image on an AP.
     //
-    FHand.Source = GetFileBufferByFilePath (
-                     BootPolicy,
-                     FilePath,
-                     &FHand.SourceSize,
-                     &AuthenticationStatus
-                     );
+    if (BootPolicy || !CoreGetImageLoadAheadSource (FilePath, &FHand.Source, &FHand.SourceSize, &AuthenticationStatus)) {
+      FHand.Source = GetFileBufferByFilePath (
+                       BootPolicy,
+                       FilePath,
+                       &FHand.SourceSize,
+                       &AuthenticationStatus
+                       );
+    }
+
     if (FHand.Source == NULL) {
       Status = EFI_NOT_FOUND;
     } else {
@@ -1460,6 +1482,7 @@ Done:
   // If we allocated the Source buffer, free it
   //
   if (FHand.FreeBuffer) {
+    CoreReleaseImageLoadAhead (FHand.Source);
     CoreFreePool (FHand.Source);
   }
 
@@ -20,4 +20,92 @@ typedef struct {
   UINTN      SourceSize;
 } IMAGE_FILE_HANDLE;
 
+///
+/// A DXE driver image that is being loaded on an AP
+///
+typedef struct {
+  UINTN                           ProcessorNumber;
+  EFI_EVENT                       ApEvent;
+  BOOLEAN                         ApBusy;
+  BOOLEAN                         InUse;
+  BOOLEAN                         SourceTaken;
+  EFI_DEVICE_PATH_PROTOCOL        *FilePath;
+  IMAGE_FILE_HANDLE               FHand;
+  UINT32                          AuthenticationStatus;
+  PE_COFF_LOADER_IMAGE_CONTEXT    ImageContext;
+  EFI_PHYSICAL_ADDRESS            ImageBasePage;
+  UINTN                           NumberOfPages;
+  volatile BOOLEAN                Done;
+  EFI_STATUS                      Status;
+  UINT64                          ApStart;
+  UINT64                          ApEnd;
+} IMAGE_LOAD_AHEAD;
+
+/**
+  Read image file (specified by UserHandle) into user specified buffer with specified offset
+  and length.
+
+  @param  UserHandle             Image file handle
+  @param  Offset                 Offset to the source file
+  @param  ReadSize               For input, pointer of size to read; For output,
+                                 pointer of size actually read.
+  @param  Buffer                 Buffer to write into
+
+  @retval EFI_SUCCESS            Successfully read the specified part of file
+                                 into buffer.
+
+**/
+EFI_STATUS
+EFIAPI
+CoreReadImageFile (
+  IN     VOID   *UserHandle,
+  IN     UINTN  Offset,
+  IN OUT UINTN  *ReadSize,
+  OUT    VOID   *Buffer
+  );
+
+/**
+  Get the file buffer of an image that is being loaded on an AP. The caller
+  owns the buffer from then on.
+
+  @param  FilePath               The device path of the image file.
+  @param  Source                 Returns the file buffer.
+  @param  SourceSize             Returns the size of the file buffer.
+  @param  AuthenticationStatus   Returns the authentication status of the file.
+
+  @retval TRUE                   The image is being loaded on an AP.
+  @retval FALSE                  The image is not being loaded on an AP.
+
+**/
+BOOLEAN
+CoreGetImageLoadAheadSource (
+  IN  EFI_DEVICE_PATH_PROTOCOL  *FilePath,
+  OUT VOID                      **Source,
+  OUT UINTN                     *SourceSize,
+  OUT UINT32                    *AuthenticationStatus
+  );
+
+/**
+  Pick up the pages of an image that an AP has loaded from a file buffer.
+
+  @param  Pe32Handle             The handle of the image file.
+  @param  Image                  The image being loaded. On return, its image
+                                 context and pages describe the pages the AP
+                                 has loaded the image into.
+  @param  Loaded                 Returns TRUE if the AP has copied and relocated
+                                 the image, and FALSE if the AP failed or timed
+                                 out and the image must be loaded into the pages
+                                 on the BSP.
+
+  @retval TRUE                   The image was being loaded on an AP.
+  @retval FALSE                  The image was not being loaded on an AP.
+
+**/
+BOOLEAN
+CoreTakeImageLoadAhead (
+  IN     IMAGE_FILE_HANDLE          *Pe32Handle,
+  IN OUT LOADED_IMAGE_PRIVATE_DATA  *Image,
+  OUT    BOOLEAN                    *Loaded
+  );
+
 #endif
@@ -0,0 +1,602 @@
+/** @file
+  Load the next scheduled DXE drivers on the APs.
+
+  While the BSP runs the entry point of a DXE driver, the drivers that follow
+  it on the scheduled queue can already be copied into memory and relocated.
+  When PcdDxeParallelImageLoadEnable is TRUE, the dispatcher reads the files
+  of the next few scheduled drivers and allocates their pages on the BSP, and
+  hands the copy and the relocation of each of them to an AP through the MP
+  services protocol. When the dispatcher later loads such a driver, the
+  security checks are done on the same file buffer as usual, and the loader
+  picks up the image the AP has prepared instead of loading it again.
+
+  The APs only copy the sections of the images and apply their base
+  relocation fixups, which needs no boot service, no library with global
+  state and no debug output. The extra actions of the PE/COFF loader, such as
+  reporting the image to a debugger, still run on the BSP when the dispatcher
+  picks the image up. If an AP fails or does not finish in time, the BSP loads
+  the image itself. The order in which the images are verified, their
+  protocols are installed and their entry points are called does not change.
+
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "DxeMain.h"
+#include "Image.h"
+
+//
+// mImageLoadAheadMp          - The MP services protocol, once it is installed
+// mImageLoadAhead            - The images being loaded on the APs
+// mImageLoadAheadSlotCount   - The number of entries of mImageLoadAhead that have an AP
+// mImageLoadAheadCount       - The number of images loaded on the APs
+// mImageLoadAheadUsed        - The number of images loaded on the APs that were used
+// mImageLoadAheadApTicks     - The time the APs spent loading images
+// mImageLoadAheadWaitTicks   - The time the BSP waited for an AP to finish
+//
+EFI_MP_SERVICES_PROTOCOL  *mImageLoadAheadMp = NULL;
+IMAGE_LOAD_AHEAD          mImageLoadAhead[IMAGE_LOAD_AHEAD_DEPTH];
+UINTN                     mImageLoadAheadSlotCount = 0;
+UINT64                    mImageLoadAheadCount     = 0;
+UINT64                    mImageLoadAheadUsed      = 0;
+UINT64                    mImageLoadAheadApTicks   = 0;
+UINT64                    mImageLoadAheadWaitTicks = 0;
+
+/**
+  Get the number of ticks elapsed between two values of the performance
+  counter.
+
+  @param  Start                  The value of the counter at the start.
+  @param  End                    The value of the counter at the end.
+
+  @return The number of elapsed ticks.
+
+**/
+STATIC
+UINT64
+ImageLoadAheadElapsed (
+  IN UINT64  Start,
+  IN UINT64  End
+  )
+{
+  UINT64  CounterStart;
+  UINT64  CounterEnd;
+
+  GetPerformanceCounterProperties (&CounterStart, &CounterEnd);
+  if (CounterStart > CounterEnd) {
+    return Start - End;
+  }
+
+  return End - Start;
+}
+
+/**
+  Copy an image into the pages allocated for it and apply its relocation
+  fixups. This runs on an AP, so it must not use any boot service and must
+  not print anything: PeCoffLoaderApplyRelocations() leaves the extra actions
+  of PeCoffLoaderRelocateImage() to the BSP.
+
+  @param  Buffer                 The IMAGE_LOAD_AHEAD entry of the image.
+
+**/
+STATIC
+VOID
+EFIAPI
+CoreImageLoadAheadProcedure (
+  IN OUT VOID  *Buffer
+  )
+{
+  IMAGE_LOAD_AHEAD  *Entry;
+
+  Entry          = (IMAGE_LOAD_AHEAD *)Buffer;
+  Entry->ApStart = GetPerformanceCounter ();
+
+  Entry->Status = PeCoffLoaderLoadImage (&Entry->ImageContext);
+  if (!EFI_ERROR (Entry->Status)) {
+    Entry->Status = PeCoffLoaderApplyRelocations (&Entry->ImageContext);
+  }
+
+  Entry->ApEnd = GetPerformanceCounter ();
+
+  MemoryFence ();
+  Entry->Done = TRUE;
+}
+
+/**
+  Assign an enabled AP to each entry of mImageLoadAhead, the first time the
+  MP services protocol is found.
+
+  @retval EFI_SUCCESS            At least one AP can load images.
+  @retval EFI_NOT_READY          The MP services protocol is not installed yet.
+  @retval EFI_UNSUPPORTED        There is no AP to load images on.
+
+**/
+STATIC
+EFI_STATUS
+CoreInitializeImageLoadAhead (
+  VOID
+  )
+{
+  EFI_STATUS                 Status;
+  EFI_MP_SERVICES_PROTOCOL   *Mp;
+  EFI_PROCESSOR_INFORMATION  ProcessorInfo;
+  UINTN                      NumberOfProcessors;
+  UINTN                      NumberOfEnabledProcessors;
+  UINTN                      Index;
+  IMAGE_LOAD_AHEAD           *Entry;
+
+  if (mImageLoadAheadMp != NULL) {
+    return (mImageLoadAheadSlotCount != 0) ? EFI_SUCCESS : EFI_UNSUPPORTED;
+  }
+
+  Status = CoreLocateProtocol (&gEfiMpServiceProtocolGuid, NULL, (VOID **)&Mp);
+  if (EFI_ERROR (Status)) {
+    return EFI_NOT_READY;
+  }
+
+  mImageLoadAheadMp = Mp;
+
+  Status = Mp->GetNumberOfProcessors (Mp, &NumberOfProcessors, &NumberOfEnabledProcessors);
+  if (EFI_ERROR (Status)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  for (Index = 0; Index < NumberOfProcessors && mImageLoadAheadSlotCount < IMAGE_LOAD_AHEAD_DEPTH; Index++) {
+    Status = Mp->GetProcessorInfo (Mp, Index, &ProcessorInfo);
+    if (EFI_ERROR (Status) ||
+        ((ProcessorInfo.StatusFlag & PROCESSOR_AS_BSP_BIT) != 0) ||
+        ((ProcessorInfo.StatusFlag & PROCESSOR_ENABLED_BIT) == 0))
+    {
+      continue;
+    }
+
+    Entry = &mImageLoadAhead[mImageLoadAheadSlotCount];
+    ZeroMem (Entry, sizeof (IMAGE_LOAD_AHEAD));
+    Status = CoreCreateEvent (0, TPL_CALLBACK, NULL, NULL, &Entry->ApEvent);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    Entry->ProcessorNumber = Index;
+    mImageLoadAheadSlotCount++;
+  }
+
+  DEBUG ((DEBUG_INFO, "DxeCore: loading images ahead on %d APs\n", mImageLoadAheadSlotCount));
+
+  return (mImageLoadAheadSlotCount != 0) ? EFI_SUCCESS : EFI_UNSUPPORTED;
+}
+
+/**
+  Find the entry of mImageLoadAhead that holds an image.
+
+  @param  FilePath               If not NULL, the device path of the image file.
+  @param  Source                 If not NULL, the file buffer of the image.
+
+  @return The entry of the image, or NULL if the image is not being loaded
+          on an AP.
+
+**/
+STATIC
+IMAGE_LOAD_AHEAD *
+CoreFindImageLoadAhead (
+  IN CONST EFI_DEVICE_PATH_PROTOCOL  *FilePath  OPTIONAL,
+  IN CONST VOID                      *Source    OPTIONAL
+  )
+{
+  UINTN             Index;
+  UINTN             Size;
+  IMAGE_LOAD_AHEAD  *Entry;
+
+  for (Index = 0; Index < mImageLoadAheadSlotCount; Index++) {
+    Entry = &mImageLoadAhead[Index];
+    if (!Entry->InUse) {
+      continue;
+    }
+
+    if (Source != NULL) {
+      if (Entry->FHand.Source == Source) {
+        return Entry;
+      }
+
+      continue;
+    }
+
+    Size = GetDevicePathSize (FilePath);
+    if ((Size == GetDevicePathSize (Entry->FilePath)) &&
+        (CompareMem (FilePath, Entry->FilePath, Size) == 0))
+    {
+      return Entry;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Wait for the AP that loads an image to finish, or for the MP services
+  protocol to stop it after IMAGE_LOAD_AHEAD_TIMEOUT microseconds.
+
+  @param  Entry                  The entry of the image.
+
+  @retval TRUE                   The AP has finished. Entry->Status is the
+                                 status of its work.
+  @retval FALSE                  The AP was stopped before it finished.
+
+**/
+STATIC
+BOOLEAN
+CoreWaitImageLoadAhead (
+  IN IMAGE_LOAD_AHEAD  *Entry
+  )
+{
+  UINT64  Start;
+
+  Start = GetPerformanceCounter ();
+  while (!Entry->Done && Entry->ApBusy) {
+    //
+    // The MP services protocol signals the event when the procedure returns
+    // or when it resets the AP on the timeout.
+    //
+    if (!EFI_ERROR (CoreCheckEvent (Entry->ApEvent))) {
+      Entry->ApBusy = FALSE;
+    }
+
+    CpuPause ();
+  }
+
+  MemoryFence ();
+  if (!Entry->Done) {
+    DEBUG ((DEBUG_WARN, "DxeCore: AP %u timed out loading an image ahead\n", (UINT32)Entry->ProcessorNumber));
+    return FALSE;
+  }
+
+  mImageLoadAheadWaitTicks += ImageLoadAheadElapsed (Start, GetPerformanceCounter ());
+  return TRUE;
+}
+
+/**
+  Free an entry of mImageLoadAhead.
+
+  @param  Entry                  The entry to free.
+  @param  FreeImage              TRUE to free the pages of the image.
+
+**/
+STATIC
+VOID
+CoreFreeImageLoadAhead (
+  IN IMAGE_LOAD_AHEAD  *Entry,
+  IN BOOLEAN           FreeImage
+  )
+{
+  CoreWaitImageLoadAhead (Entry);
+
+  if (FreeImage) {
+    CoreFreePages (Entry->ImageBasePage, Entry->NumberOfPages);
+  }
+
+  if (!Entry->SourceTaken) {
+    CoreFreePool (Entry->FHand.Source);
+  }
+
+  CoreFreePool (Entry->FilePath);
+  Entry->FilePath = NULL;
+  Entry->InUse    = FALSE;
+}
+
+/**
+  Start loading a DXE driver image on an AP. The file of the image is read
+  and the pages of the image are allocated on the BSP, then the image is
+  copied into the pages and relocated on an AP.
+
+  @param  FilePath               The device path of the image file.
+
+  @retval EFI_SUCCESS            An AP is loading the image.
+  @retval EFI_ALREADY_STARTED    The image is already being loaded on an AP.
+  @retval EFI_OUT_OF_RESOURCES   No AP is available to load the image.
+  @retval EFI_UNSUPPORTED        The image cannot be loaded on an AP.
+  @retval EFI_NOT_FOUND          The image file was not found.
+
+**/
+EFI_STATUS
+CoreLoadImageAhead (
+  IN EFI_DEVICE_PATH_PROTOCOL  *FilePath
+  )
+{
+  EFI_STATUS            Status;
+  UINTN                 Index;
+  IMAGE_LOAD_AHEAD      *Entry;
+  EFI_PHYSICAL_ADDRESS  Address;
+  UINTN                 Size;
+
+  Status = CoreInitializeImageLoadAhead ();
+  if (EFI_ERROR (Status)) {
+    return (Status == EFI_NOT_READY) ? EFI_OUT_OF_RESOURCES : Status;
+  }
+
+  if (CoreFindImageLoadAhead (FilePath, NULL) != NULL) {
+    return EFI_ALREADY_STARTED;
+  }
+
+  //
+  // Find an AP that is neither loading an image nor still marked busy by
+  // the MP services protocol.
+  //
+  Entry = NULL;
+  for (Index = 0; Index < mImageLoadAheadSlotCount; Index++) {
+    if (mImageLoadAhead[Index].InUse) {
+      continue;
+    }
+
+    if (mImageLoadAhead[Index].ApBusy) {
+      if (EFI_ERROR (CoreCheckEvent (mImageLoadAhead[Index].ApEvent))) {
+        continue;
+      }
+
+      mImageLoadAhead[Index].ApBusy = FALSE;
+    }
+
+    Entry = &mImageLoadAhead[Index];
+    break;
+  }
+
+  if (Entry == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  ZeroMem (&Entry->FHand, sizeof (IMAGE_FILE_HANDLE));
+  Entry->FHand.Signature = IMAGE_FILE_HANDLE_SIGNATURE;
+  Entry->FHand.Source    = GetFileBufferByFilePath (
+                             FALSE,
+                             FilePath,
+                             &Entry->FHand.SourceSize,
+                             &Entry->AuthenticationStatus
+                             );
+  if (Entry->FHand.Source == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  ZeroMem (&Entry->ImageContext, sizeof (Entry->ImageContext));
+  Entry->ImageContext.Handle    = &Entry->FHand;
+  Entry->ImageContext.ImageRead = (PE_COFF_LOADER_READ_FILE)CoreReadImageFile;
+
+  //
+  // Only native boot service drivers that can be loaded at any address are
+  // loaded ahead. Runtime drivers need their fixup data allocated between the
+  // load and the relocation, and the other images are left to the usual path.
+  //
+  Status = PeCoffLoaderGetImageInfo (&Entry->ImageContext);
+  if (EFI_ERROR (Status) ||
+      !EFI_IMAGE_MACHINE_TYPE_SUPPORTED (Entry->ImageContext.Machine) ||
+      (Entry->ImageContext.ImageType != EFI_IMAGE_SUBSYSTEM_EFI_BOOT_SERVICE_DRIVER) ||
+      Entry->ImageContext.RelocationsStripped ||
+      Entry->ImageContext.IsTeImage ||
+      (PcdGet64 (PcdLoadModuleAtFixAddressEnable) != 0))
+  {
+    CoreFreePool (Entry->FHand.Source);
+    return EFI_UNSUPPORTED;
+  }
+
+  Entry->ImageContext.ImageCodeMemoryType = EfiBootServicesCode;
+  Entry->ImageContext.ImageDataMemoryType = EfiBootServicesData;
+
+  //
+  // Allocate the pages the same way CoreLoadPeImage() does.
+  //
+  if (Entry->ImageContext.SectionAlignment > EFI_PAGE_SIZE) {
+    Size = (UINTN)Entry->ImageContext.ImageSize + Entry->ImageContext.SectionAlignment;
+  } else {
+    Size = (UINTN)Entry->ImageContext.ImageSize;
+  }
+
+  Entry->NumberOfPages = EFI_SIZE_TO_PAGES (Size);
+
+  Status  = EFI_OUT_OF_RESOURCES;
+  Address = Entry->ImageContext.ImageAddress;
+  if (Address >= 0x100000) {
+    Status = CoreAllocatePages (AllocateAddress, EfiBootServicesCode, Entry->NumberOfPages, &Address);
+  }
+
+  if (EFI_ERROR (Status)) {
+    Status = CoreAllocatePages (AllocateAnyPages, EfiBootServicesCode, Entry->NumberOfPages, &Address);
+  }
+
+  if (EFI_ERROR (Status)) {
+    CoreFreePool (Entry->FHand.Source);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Entry->ImageBasePage             = Address;
+  Entry->ImageContext.ImageAddress = Address;
+  Entry->ImageContext.ImageAddress =
+    (Entry->ImageContext.ImageAddress + Entry->ImageContext.SectionAlignment - 1) &
+    ~((UINTN)Entry->ImageContext.SectionAlignment - 1);
+
+  Entry->FilePath    = DuplicateDevicePath (FilePath);
+  Entry->SourceTaken = FALSE;
+  Entry->Done        = FALSE;
+  Entry->Status      = EFI_NOT_READY;
+  Entry->ApStart     = 0;
+  Entry->ApEnd       = 0;
+  if (Entry->FilePath == NULL) {
+    CoreFreePages (Entry->ImageBasePage, Entry->NumberOfPages);
+    CoreFreePool (Entry->FHand.Source);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = mImageLoadAheadMp->StartupThisAP (
+                                mImageLoadAheadMp,
+                                CoreImageLoadAheadProcedure,
+                                Entry->ProcessorNumber,
+                                Entry->ApEvent,
+                                IMAGE_LOAD_AHEAD_TIMEOUT,
+                                Entry,
+                                NULL
+                                );
+  if (EFI_ERROR (Status)) {
+    CoreFreePages (Entry->ImageBasePage, Entry->NumberOfPages);
+    CoreFreePool (Entry->FHand.Source);
+    CoreFreePool (Entry->FilePath);
+    Entry->FilePath = NULL;
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Entry->ApBusy = TRUE;
+  Entry->InUse  = TRUE;
+  mImageLoadAheadCount++;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Get the file buffer of an image that is being loaded on an AP. The caller
+  owns the buffer from then on.
+
+  @param  FilePath               The device path of the image file.
+  @param  Source                 Returns the file buffer.
+  @param  SourceSize             Returns the size of the file buffer.
+  @param  AuthenticationStatus   Returns the authentication status of the file.
+
+  @retval TRUE                   The image is being loaded on an AP.
+  @retval FALSE                  The image is not being loaded on an AP.
+
+**/
+BOOLEAN
+CoreGetImageLoadAheadSource (
+  IN  EFI_DEVICE_PATH_PROTOCOL  *FilePath,
+  OUT VOID                      **Source,
+  OUT UINTN                     *SourceSize,
+  OUT UINT32                    *AuthenticationStatus
+  )
+{
+  IMAGE_LOAD_AHEAD  *Entry;
+
+  if (!FeaturePcdGet (PcdDxeParallelImageLoadEnable) || (FilePath == NULL)) {
+    return FALSE;
+  }
+
+  Entry = CoreFindImageLoadAhead (FilePath, NULL);
+  if ((Entry == NULL) || Entry->SourceTaken) {
+    return FALSE;
+  }
+
+  Entry->SourceTaken    = TRUE;
+  *Source               = Entry->FHand.Source;
+  *SourceSize           = Entry->FHand.SourceSize;
+  *AuthenticationStatus = Entry->AuthenticationStatus;
+
+  return TRUE;
+}
+
+/**
+  Pick up the pages of an image that an AP has loaded from a file buffer.
+
+  @param  Pe32Handle             The handle of the image file.
+  @param  Image                  The image being loaded. On return, its image
+                                 context and pages describe the pages the AP
+                                 has loaded the image into.
+  @param  Loaded                 Returns TRUE if the AP has copied and relocated
+                                 the image, and FALSE if the AP failed or timed
+                                 out and the image must be loaded into the pages
+                                 on the BSP.
+
+  @retval TRUE                   The image was being loaded on an AP.
+  @retval FALSE                  The image was not being loaded on an AP.
+
+**/
+BOOLEAN
+CoreTakeImageLoadAhead (
+  IN     IMAGE_FILE_HANDLE          *Pe32Handle,
+  IN OUT LOADED_IMAGE_PRIVATE_DATA  *Image,
+  OUT    BOOLEAN                    *Loaded
+  )
+{
+  IMAGE_LOAD_AHEAD  *Entry;
+
+  if (!FeaturePcdGet (PcdDxeParallelImageLoadEnable)) {
+    return FALSE;
+  }
+
+  Entry = CoreFindImageLoadAhead (NULL, Pe32Handle->Source);
+  if ((Entry == NULL) || (Image->PeCoffEmu != NULL) ||
+      (Image->ImageContext.ImageType != Entry->ImageContext.ImageType))
+  {
+    return FALSE;
+  }
+
+  *Loaded = CoreWaitImageLoadAhead (Entry) && !EFI_ERROR (Entry->Status);
+  if (*Loaded) {
+    CopyMem (&Image->ImageContext, &Entry->ImageContext, sizeof (Image->ImageContext));
+    Image->ImageContext.Handle = Pe32Handle;
+
+    mImageLoadAheadUsed++;
+    mImageLoadAheadApTicks += ImageLoadAheadElapsed (Entry->ApStart, Entry->ApEnd);
+  } else {
+    //
+    // The AP is not using the pages any more, load the image into them again
+    // on the BSP from the context of the file.
+    //
+    Image->ImageContext.ImageAddress = Entry->ImageContext.ImageAddress;
+  }
+
+  Image->ImageBasePage = Entry->ImageBasePage;
+  Image->NumberOfPages = Entry->NumberOfPages;
+
+  CoreFreeImageLoadAhead (Entry, FALSE);
+  return TRUE;
+}
+
+/**
+  Release the images that were loaded on the APs but not used.
+
+  @param  Source                 If not NULL, only release the image loaded from
+                                 this file buffer. The caller owns the buffer.
+                                 If NULL, release all images.
+
+**/
+VOID
+CoreReleaseImageLoadAhead (
+  IN VOID  *Source  OPTIONAL
+  )
+{
+  UINTN  Index;
+
+  if (!FeaturePcdGet (PcdDxeParallelImageLoadEnable)) {
+    return;
+  }
+
+  for (Index = 0; Index < mImageLoadAheadSlotCount; Index++) {
+    if (mImageLoadAhead[Index].InUse &&
+        ((Source == NULL) || (mImageLoadAhead[Index].FHand.Source == Source)))
+    {
+      CoreFreeImageLoadAhead (&mImageLoadAhead[Index], TRUE);
+    }
+  }
+}
+
+/**
+  Report the statistics of the images loaded on the APs through the
+  performance counters. The time saved is the time the APs spent on the
+  images that were used, minus the time the BSP had to wait for them.
+
+**/
+VOID
+CoreReportImageLoadAheadCounters (
+  VOID
+  )
+{
+  UINT64  ApTime;
+  UINT64  WaitTime;
+
+  if (!FeaturePcdGet (PcdDxeParallelImageLoadEnable)) {
+    return;
+  }
+
+  ApTime   = DivU64x32 (GetTimeInNanoSecond (mImageLoadAheadApTicks), 1000);
+  WaitTime = DivU64x32 (GetTimeInNanoSecond (mImageLoadAheadWaitTicks), 1000);
+
+  CoreLogPerformanceCounter ("ImgAhead", mImageLoadAheadCount);
+  CoreLogPerformanceCounter ("ImgAheadUsed", mImageLoadAheadUsed);
+  CoreLogPerformanceCounter ("ImgAheadApUs", ApTime);
+  CoreLogPerformanceCounter ("ImgAheadWaitUs", WaitTime);
+  CoreLogPerformanceCounter ("ImgAheadSavedUs", (ApTime > WaitTime) ? ApTime - WaitTime : 0);
+}
@@ -0,0 +1,236 @@
+/** @file
+  Address index of the DXE Core maps.
+
+  An address index is a treap of nodes embedded in the entries of a map of
+  non-overlapping ranges, ordered by the start address of each range. It is
+  shared by the memory map and the GCD memory and I/O space maps, which only
+  differ in the data each node keeps about its subtree: the owner of an index
+  can give a function that recomputes that data from the children of a node.
+
+  The index is intrusive: no memory is allocated to maintain it, so updating
+  it can never fail and it can be updated with gMemoryLock held.
+
+  An entry is removed from its index before its start address changes, and
+  added back afterwards, so an index never holds two entries with the same
+  start address.
+
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "DxeMain.h"
+
+/**
+  Recompute the data a node keeps about its subtree, if the index has any.
+
+  @param  Index                  The address index.
+  @param  Node                   The root of the subtree.
+
+**/
+STATIC
+VOID
+AddressIndexUpdate (
+  IN ADDRESS_INDEX       *Index,
+  IN ADDRESS_INDEX_NODE  *Node
+  )
+{
+  if (Index->Update != NULL) {
+    Index->Update (Node);
+  }
+}
+
+/**
+  Split a subtree into the nodes below Key and the nodes at or above Key.
+
+  @param  Index                  The address index.
+  @param  Node                   The root of the subtree to split.
+  @param  Key                    The address to split at.
+  @param  Lower                  Returns the subtree of nodes that start below Key.
+  @param  Upper                  Returns the subtree of nodes that start at or above Key.
+
+**/
+STATIC
+VOID
+AddressIndexSplit (
+  IN  ADDRESS_INDEX       *Index,
+  IN  ADDRESS_INDEX_NODE  *Node,
+  IN  UINT64              Key,
+  OUT ADDRESS_INDEX_NODE  **Lower,
+  OUT ADDRESS_INDEX_NODE  **Upper
+  )
+{
+  if (Node == NULL) {
+    *Lower = NULL;
+    *Upper = NULL;
+    return;
+  }
+
+  if (Node->Key < Key) {
+    AddressIndexSplit (Index, Node->Right, Key, &Node->Right, Upper);
+    *Lower = Node;
+  } else {
+    AddressIndexSplit (Index, Node->Left, Key, Lower, &Node->Left);
+    *Upper = Node;
+  }
+
+  AddressIndexUpdate (Index, Node);
+}
+
+/**
+  Merge two subtrees. All nodes of Lower must be below all nodes of Upper.
+
+  @param  Index                  The address index.
+  @param  Lower                  The subtree with the lower addresses.
+  @param  Upper                  The subtree with the higher addresses.
+
+  @return The root of the merged subtree.
+
+**/
+STATIC
+ADDRESS_INDEX_NODE *
+AddressIndexMerge (
+  IN ADDRESS_INDEX       *Index,
+  IN ADDRESS_INDEX_NODE  *Lower,
+  IN ADDRESS_INDEX_NODE  *Upper
+  )
+{
+  if (Lower == NULL) {
+    return Upper;
+  }
+
+  if (Upper == NULL) {
+    return Lower;
+  }
+
+  if (Lower->Priority > Upper->Priority) {
+    Lower->Right = AddressIndexMerge (Index, Lower->Right, Upper);
+    AddressIndexUpdate (Index, Lower);
+    return Lower;
+  }
+
+  Upper->Left = AddressIndexMerge (Index, Lower, Upper->Left);
+  AddressIndexUpdate (Index, Upper);
+  return Upper;
+}
+
+/**
+  Add a node to an address index.
+
+  @param  Index                  The address index.
+  @param  Node                   The node, embedded in the entry of the range.
+  @param  Key                    The start address of the range.
+
+**/
+VOID
+CoreAddressIndexInsert (
+  IN OUT ADDRESS_INDEX       *Index,
+  IN     ADDRESS_INDEX_NODE  *Node,
+  IN     UINT64              Key
+  )
+{
+  ADDRESS_INDEX_NODE  *Lower;
+  ADDRESS_INDEX_NODE  *Upper;
+
+  Index->Seed    = Index->Seed * 1103515245 + 12345;
+  Node->Priority = Index->Seed;
+  Node->Key      = Key;
+  Node->Left     = NULL;
+  Node->Right    = NULL;
+  AddressIndexUpdate (Index, Node);
+
+  AddressIndexSplit (Index, Index->Root, Key, &Lower, &Upper);
+  Index->Root = AddressIndexMerge (Index, AddressIndexMerge (Index, Lower, Node), Upper);
+}
+
+/**
+  Remove a node from an address index.
+
+  @param  Index                  The address index.
+  @param  Node                   The node, embedded in the entry of the range.
+
+**/
+VOID
+CoreAddressIndexRemove (
+  IN OUT ADDRESS_INDEX       *Index,
+  IN     ADDRESS_INDEX_NODE  *Node
+  )
+{
+  ADDRESS_INDEX_NODE  *Lower;
+  ADDRESS_INDEX_NODE  *Middle;
+  ADDRESS_INDEX_NODE  *Upper;
+
+  AddressIndexSplit (Index, Index->Root, Node->Key, &Lower, &Middle);
+  AddressIndexSplit (Index, Middle, Node->Key + 1, &Middle, &Upper);
+  ASSERT (Middle == Node);
+
+  Index->Root = AddressIndexMerge (Index, Lower, Upper);
+  Node->Left  = NULL;
+  Node->Right = NULL;
+}
+
+/**
+  Find the node of an address index with the highest start address at or
+  below an address. The range of that node is the only one that can contain
+  the address.
+
+  @param  Index                  The address index.
+  @param  Address                The address to look up.
+
+  @return The node, or NULL if all the nodes start above Address.
+
+**/
+ADDRESS_INDEX_NODE *
+CoreAddressIndexFind (
+  IN ADDRESS_INDEX  *Index,
+  IN UINT64         Address
+  )
+{
+  ADDRESS_INDEX_NODE  *Node;
+  ADDRESS_INDEX_NODE  *Found;
+
+  Found = NULL;
+  Node  = Index->Root;
+  while (Node != NULL) {
+    if (Node->Key <= Address) {
+      Found = Node;
+      Node  = Node->Right;
+    } else {
+      Node = Node->Left;
+    }
+  }
+
+  return Found;
+}
+
+/**
+  Find the node of an address index with the lowest start address above an
+  address.
+
+  @param  Index                  The address index.
+  @param  Address                The address to look up.
+
+  @return The node, or NULL if no node starts above Address.
+
+**/
+ADDRESS_INDEX_NODE *
+CoreAddressIndexNext (
+  IN ADDRESS_INDEX  *Index,
+  IN UINT64         Address
+  )
+{
+  ADDRESS_INDEX_NODE  *Node;
+  ADDRESS_INDEX_NODE  *Found;
+
+  Found = NULL;
+  Node  = Index->Root;
+  while (Node != NULL) {
+    if (Node->Key > Address) {
+      Found = Node;
+      Node  = Node->Left;
+    } else {
+      Node = Node->Right;
+    }
+  }
+
+  return Found;
+}
@@ -30,7 +30,8 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 //
 
 #define MEMORY_MAP_SIGNATURE  SIGNATURE_32('m','m','a','p')
-typedef struct {
+typedef struct _MEMORY_MAP MEMORY_MAP;
+struct _MEMORY_MAP {
   UINTN              Signature;
   LIST_ENTRY         Link;
   BOOLEAN            FromPages;
@@ -41,7 +42,14 @@ typedef struct {
 
   UINT64             VirtualStart;
   UINT64             Attribute;
-} MEMORY_MAP;
+
+  ///
+  /// Node of the address index, used when PcdDxeMemoryMapIndexEnable is TRUE
+  ///
+  ADDRESS_INDEX_NODE    IndexNode;
+  /// Size of the largest EfiConventionalMemory entry in this subtree
+  UINT64                MaxFreeBytes;
+};
 
 //
 // Internal prototypes
@@ -162,6 +170,105 @@ CoreInternalAllocatePages (
   IN BOOLEAN                   NeedGuard
   );
 
+/**
+  Internal function. Computes where a consecutive free page range could end in
+  a memory map entry.
+
+  @param  Entry                  The memory map entry
+  @param  MaxAddress             The address that the range must be below
+  @param  MinAddress             The address that the range must be above
+  @param  NumberOfBytes          Number of bytes needed
+  @param  Alignment              Bits to align with
+  @param  NeedGuard              Flag to indicate Guard page is needed or not
+
+  @return The address of the last byte of the range, or 0 if the entry cannot
+          hold the range.
+
+**/
+UINT64
+CoreFindFreePagesInEntry (
+  IN MEMORY_MAP  *Entry,
+  IN UINT64      MaxAddress,
+  IN UINT64      MinAddress,
+  IN UINT64      NumberOfBytes,
+  IN UINTN       Alignment,
+  IN BOOLEAN     NeedGuard
+  );
+
+/**
+  Add an entry that has just been inserted into gMemoryMap to the index.
+  The gMemoryLock must be owned.
+
+  @param  Entry                  The memory map entry.
+
+**/
+VOID
+CoreMemoryMapIndexInsert (
+  IN MEMORY_MAP  *Entry
+  );
+
+/**
+  Remove an entry that is being removed from gMemoryMap from the index.
+  The gMemoryLock must be owned.
+
+  @param  Entry                  The memory map entry.
+
+**/
+VOID
+CoreMemoryMapIndexRemove (
+  IN MEMORY_MAP  *Entry
+  );
+
+/**
+  Find the memory map entry that contains an address.
+  The gMemoryLock must be owned.
+
+  @param  Address                The address to look up.
+
+  @return The memory map entry, or NULL if no entry contains Address.
+
+**/
+MEMORY_MAP *
+CoreMemoryMapIndexFind (
+  IN UINT64  Address
+  );
+
+/**
+  Find the memory map entry with the lowest start address above an address.
+  The gMemoryLock must be owned.
+
+  @param  Address                The address to look up.
+
+  @return The memory map entry, or NULL if no entry starts above Address.
+
+**/
+MEMORY_MAP *
+CoreMemoryMapIndexNext (
+  IN UINT64  Address
+  );
+
+/**
+  Find the highest free range below MaxAddress through the index.
+  The gMemoryLock must be owned.
+
+  @param  MaxAddress             The address that the range must be below.
+  @param  MinAddress             The address that the range must be above.
+  @param  NumberOfBytes          Number of bytes needed.
+  @param  Alignment              Bits to align with.
+  @param  NeedGuard              Flag to indicate Guard page is needed or not.
+
+  @return The address of the last byte of the range, or 0 if no range was found.
+
+**/
+UINT64
+CoreMemoryMapIndexFindFree (
+  IN UINT64   MaxAddress,
+  IN UINT64   MinAddress,
+  IN UINT64   NumberOfBytes,
+  IN UINTN    Alignment,
+  IN BOOLEAN  NeedGuard
+  );
+
 //
 // Internal Global data
 //
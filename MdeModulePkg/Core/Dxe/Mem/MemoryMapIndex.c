@@ -0,0 +1,241 @@
+/** @file
+  Address index of the memory map.
+
+  When PcdDxeMemoryMapIndexEnable is TRUE, every MEMORY_MAP entry on gMemoryMap
+  is also a node of an address index ordered by the Start address. Each entry
+  records the size of the largest EfiConventionalMemory entry in its subtree,
+  so that the top-down search for free pages can skip subtrees that cannot
+  satisfy the request.
+
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "DxeMain.h"
+#include "Imem.h"
+
+/**
+  Get the memory map entry of a node of the index.
+
+  @param  Node                   The node, or NULL.
+
+  @return The memory map entry, or NULL if Node is NULL.
+
+**/
+STATIC
+MEMORY_MAP *
+MemoryMapIndexEntry (
+  IN ADDRESS_INDEX_NODE  *Node
+  )
+{
+  if (Node == NULL) {
+    return NULL;
+  }
+
+  return CR (Node, MEMORY_MAP, IndexNode, MEMORY_MAP_SIGNATURE);
+}
+
+/**
+  Recompute the largest free entry size of a subtree from its children.
+
+  @param  Node                   The root of the subtree.
+
+**/
+STATIC
+VOID
+MemoryMapIndexUpdate (
+  IN ADDRESS_INDEX_NODE  *Node
+  )
+{
+  MEMORY_MAP  *Entry;
+  UINT64      MaxFreeBytes;
+
+  Entry        = MemoryMapIndexEntry (Node);
+  MaxFreeBytes = 0;
+  if (Entry->Type == EfiConventionalMemory) {
+    MaxFreeBytes = Entry->End - Entry->Start + 1;
+  }
+
+  if ((Node->Left != NULL) && (MemoryMapIndexEntry (Node->Left)->MaxFreeBytes > MaxFreeBytes)) {
+    MaxFreeBytes = MemoryMapIndexEntry (Node->Left)->MaxFreeBytes;
+  }
+
+  if ((Node->Right != NULL) && (MemoryMapIndexEntry (Node->Right)->MaxFreeBytes > MaxFreeBytes)) {
+    MaxFreeBytes = MemoryMapIndexEntry (Node->Right)->MaxFreeBytes;
+  }
+
+  Entry->MaxFreeBytes = MaxFreeBytes;
+}
+
+//
+// mMemoryMapIndex - The index of gMemoryMap
+//
+ADDRESS_INDEX  mMemoryMapIndex = { NULL, 0x2545F491, MemoryMapIndexUpdate };
+
+/**
+  Add an entry that has just been inserted into gMemoryMap to the index.
+  The gMemoryLock must be owned.
+
+  @param  Entry                  The memory map entry.
+
+**/
+VOID
+CoreMemoryMapIndexInsert (
+  IN MEMORY_MAP  *Entry
+  )
+{
+  if (!FeaturePcdGet (PcdDxeMemoryMapIndexEnable)) {
+    return;
+  }
+
+  ASSERT_LOCKED (&gMemoryLock);
+
+  CoreAddressIndexInsert (&mMemoryMapIndex, &Entry->IndexNode, Entry->Start);
+}
+
+/**
+  Remove an entry that is being removed from gMemoryMap from the index.
+  The gMemoryLock must be owned.
+
+  @param  Entry                  The memory map entry.
+
+**/
+VOID
+CoreMemoryMapIndexRemove (
+  IN MEMORY_MAP  *Entry
+  )
+{
+  if (!FeaturePcdGet (PcdDxeMemoryMapIndexEnable)) {
+    return;
+  }
+
+  ASSERT_LOCKED (&gMemoryLock);
+
+  ASSERT (Entry->IndexNode.Key == Entry->Start);
+  CoreAddressIndexRemove (&mMemoryMapIndex, &Entry->IndexNode);
+}
+
+/**
+  Find the memory map entry that contains an address.
+  The gMemoryLock must be owned.
+
+  @param  Address                The address to look up.
+
+  @return The memory map entry, or NULL if no entry contains Address.
+
+**/
+MEMORY_MAP *
+CoreMemoryMapIndexFind (
+  IN UINT64  Address
+  )
+{
+  MEMORY_MAP  *Entry;
+
+  ASSERT_LOCKED (&gMemoryLock);
+
+  Entry = MemoryMapIndexEntry (CoreAddressIndexFind (&mMemoryMapIndex, Address));
+  if ((Entry != NULL) && (Entry->End >= Address)) {
+    return Entry;
+  }
+
+  return NULL;
+}
+
+/**
+  Find the memory map entry with the lowest start address above an address.
+  The gMemoryLock must be owned.
+
+  @param  Address                The address to look up.
+
+  @return The memory map entry, or NULL if no entry starts above Address.
+
+**/
+MEMORY_MAP *
+CoreMemoryMapIndexNext (
+  IN UINT64  Address
+  )
+{
+  ASSERT_LOCKED (&gMemoryLock);
+
+  return MemoryMapIndexEntry (CoreAddressIndexNext (&mMemoryMapIndex, Address));
+}
+
+/**
+  Search a subtree from the highest address down for the first free entry that
+  can hold the requested range.
+
+  @param  Node                   The root of the subtree, or NULL.
+  @param  MaxAddress             The address that the range must be below.
+  @param  MinAddress             The address that the range must be above.
+  @param  NumberOfBytes          Number of bytes needed.
+  @param  Alignment              Bits to align with.
+  @param  NeedGuard              Flag to indicate Guard page is needed or not.
+
+  @return The end of the highest range found, or 0 if no range was found.
+
+**/
+STATIC
+UINT64
+MemoryMapIndexFindFree (
+  IN ADDRESS_INDEX_NODE  *Node,
+  IN UINT64              MaxAddress,
+  IN UINT64              MinAddress,
+  IN UINT64              NumberOfBytes,
+  IN UINTN               Alignment,
+  IN BOOLEAN             NeedGuard
+  )
+{
+  MEMORY_MAP  *Entry;
+  UINT64      DescEnd;
+
+  Entry = MemoryMapIndexEntry (Node);
+  if ((Entry == NULL) || (Entry->MaxFreeBytes < NumberOfBytes)) {
+    return 0;
+  }
+
+  //
+  // Node and its right subtree can only be used if Node starts below
+  // MaxAddress. The entries do not overlap, so the first match in
+  // descending address order is the highest one.
+  //
+  if (Entry->Start < MaxAddress) {
+    DescEnd = MemoryMapIndexFindFree (Node->Right, MaxAddress, MinAddress, NumberOfBytes, Alignment, NeedGuard);
+    if (DescEnd != 0) {
+      return DescEnd;
+    }
+
+    DescEnd = CoreFindFreePagesInEntry (Entry, MaxAddress, MinAddress, NumberOfBytes, Alignment, NeedGuard);
+    if (DescEnd != 0) {
+      return DescEnd;
+    }
+  }
+
+  return MemoryMapIndexFindFree (Node->Left, MaxAddress, MinAddress, NumberOfBytes, Alignment, NeedGuard);
+}
+
+/**
+  Find the highest free range below MaxAddress through the index.
+  The gMemoryLock must be owned.
+
+  @param  MaxAddress             The address that the range must be below.
+  @param  MinAddress             The address that the range must be above.
+  @param  NumberOfBytes          Number of bytes needed.
+  @param  Alignment              Bits to align with.
+  @param  NeedGuard              Flag to indicate Guard page is needed or not.
+
+  @return The address of the last byte of the range, or 0 if no range was found.
+
+**/
+UINT64
+CoreMemoryMapIndexFindFree (
+  IN UINT64   MaxAddress,
+  IN UINT64   MinAddress,
+  IN UINT64   NumberOfBytes,
+  IN UINTN    Alignment,
+  IN BOOLEAN  NeedGuard
+  )
+{
+  ASSERT_LOCKED (&gMemoryLock);
+
+  return MemoryMapIndexFindFree (mMemoryMapIndex.Root, MaxAddress, MinAddress, NumberOfBytes, Alignment, NeedGuard);
+}
@@ -207,26 +207,46 @@ CoreAddRange (
   // and the same Attribute
   //
 
-  Link = gMemoryMap.ForwardLink;
-  while (Link != &gMemoryMap) {
-    Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-    Link  = Link->ForwardLink;
-
-    if (Entry->Type != Type) {
-      continue;
-    }
-
-    if (Entry->Attribute != Attribute) {
-      continue;
-    }
-
-    if (Entry->End + 1 == Start) {
+  if (FeaturePcdGet (PcdDxeMemoryMapIndexEnable)) {
+    //
+    // The range is not in the map, so only the entries holding the bytes
+    // just below and just above the range can adjoin it
+    //
+    Entry = (Start == 0) ? NULL : CoreMemoryMapIndexFind (Start - 1);
+    if ((Entry != NULL) && (Entry->Type == Type) && (Entry->Attribute == Attribute)) {
       Start = Entry->Start;
+      CoreMemoryMapIndexRemove (Entry);
       RemoveMemoryMapEntry (Entry);
-    } else if (Entry->Start == End + 1) {
+    }
+
+    Entry = (End == MAX_UINT64) ? NULL : CoreMemoryMapIndexFind (End + 1);
+    if ((Entry != NULL) && (Entry->Type == Type) && (Entry->Attribute == Attribute)) {
       End = Entry->End;
+      CoreMemoryMapIndexRemove (Entry);
       RemoveMemoryMapEntry (Entry);
     }
+  } else {
+    Link = gMemoryMap.ForwardLink;
+    while (Link != &gMemoryMap) {
+      Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
+      Link  = Link->ForwardLink;
+
+      if (Entry->Type != Type) {
+        continue;
+      }
+
+      if (Entry->Attribute != Attribute) {
+        continue;
+      }
+
+      if (Entry->End + 1 == Start) {
+        Start = Entry->Start;
+        RemoveMemoryMapEntry (Entry);
+      } else if (Entry->Start == End + 1) {
+        End = Entry->End;
+        RemoveMemoryMapEntry (Entry);
+      }
+    }
   }
 
   //
@@ -241,6 +261,7 @@ CoreAddRange (
   mMapStack[mMapDepth].VirtualStart = 0;
   mMapStack[mMapDepth].Attribute    = Attribute;
   InsertTailList (&gMemoryMap, &mMapStack[mMapDepth].Link);
+  CoreMemoryMapIndexInsert (&mMapStack[mMapDepth]);
 
   mMapDepth += 1;
   ASSERT (mMapDepth < MAX_MAP_DEPTH);
@@ -347,6 +368,7 @@ CoreFreeMemoryMapStack (
       //
       // Move this entry to general memory
       //
+      CoreMemoryMapIndexRemove (&mMapStack[mMapDepth]);
       RemoveEntryList (&mMapStack[mMapDepth].Link);
       mMapStack[mMapDepth].Link.ForwardLink = NULL;
 
@@ -356,14 +378,28 @@ CoreFreeMemoryMapStack (
       //
       // Find insertion location
       //
-      for (Link2 = gMemoryMap.ForwardLink; Link2 != &gMemoryMap; Link2 = Link2->ForwardLink) {
-        Entry2 = CR (Link2, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-        if (Entry2->FromPages && (Entry2->Start > Entry->Start)) {
-          break;
+      if (FeaturePcdGet (PcdDxeMemoryMapIndexEnable)) {
+        //
+        // The entries from pages are kept sorted on gMemoryMap, so the
+        // insertion location is the next entry from pages by address
+        //
+        Entry2 = CoreMemoryMapIndexNext (Entry->Start);
+        while ((Entry2 != NULL) && !Entry2->FromPages) {
+          Entry2 = CoreMemoryMapIndexNext (Entry2->Start);
+        }
+
+        Link2 = (Entry2 == NULL) ? &gMemoryMap : &Entry2->Link;
+      } else {
+        for (Link2 = gMemoryMap.ForwardLink; Link2 != &gMemoryMap; Link2 = Link2->ForwardLink) {
+          Entry2 = CR (Link2, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
+          if (Entry2->FromPages && (Entry2->Start > Entry->Start)) {
+            break;
+          }
         }
       }
 
       InsertTailList (Link2, &Entry->Link);
+      CoreMemoryMapIndexInsert (Entry);
     } else {
       //
       // This item of mMapStack[mMapDepth] has already been dequeued from gMemoryMap list,
@@ -762,11 +798,16 @@ CoreConvertPagesEx (
     //
     // Find the entry that the covers the range
     //
-    for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-      Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
+    if (FeaturePcdGet (PcdDxeMemoryMapIndexEnable)) {
+      Entry = CoreMemoryMapIndexFind (Start);
+      Link  = (Entry == NULL) ? &gMemoryMap : &Entry->Link;
+    } else {
+      for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
+        Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
 
-      if ((Entry->Start <= Start) && (Entry->End > Start)) {
-        break;
+        if ((Entry->Start <= Start) && (Entry->End > Start)) {
+          break;
+        }
       }
     }
 
@@ -849,8 +890,10 @@ CoreConvertPagesEx (
     }
 
     //
-    // Pull range out of descriptor
+    // Pull range out of descriptor. The entry leaves the address index while
+    // its range changes.
     //
+    CoreMemoryMapIndexRemove (Entry);
     if (Entry->Start == Start) {
       //
       // Clip start
@@ -882,6 +925,7 @@ CoreConvertPagesEx (
 
       Entry->End = Start - 1;
       ASSERT (Entry->Start < Entry->End);
+      CoreMemoryMapIndexInsert (Entry);
 
       Entry = &mMapStack[mMapDepth];
       InsertTailList (&gMemoryMap, &Entry->Link);
@@ -908,6 +952,8 @@ CoreConvertPagesEx (
     if (Entry->Start == Entry->End + 1) {
       RemoveMemoryMapEntry (Entry);
       Entry = NULL;
+    } else {
+      CoreMemoryMapIndexInsert (Entry);
     }
 
     //
@@ -1006,6 +1052,94 @@ CoreUpdateMemoryAttributes (
   CoreReleaseMemoryLock ();
 }
 
+/**
+  Internal function. Computes where a consecutive free page range could end in
+  a memory map entry.
+
+  @param  Entry                  The memory map entry
+  @param  MaxAddress             The address that the range must be below
+  @param  MinAddress             The address that the range must be above
+  @param  NumberOfBytes          Number of bytes needed
+  @param  Alignment              Bits to align with
+  @param  NeedGuard              Flag to indicate Guard page is needed or not
+
+  @return The address of the last byte of the range, or 0 if the entry cannot
+          hold the range.
+
+**/
+UINT64
+CoreFindFreePagesInEntry (
+  IN MEMORY_MAP  *Entry,
+  IN UINT64      MaxAddress,
+  IN UINT64      MinAddress,
+  IN UINT64      NumberOfBytes,
+  IN UINTN       Alignment,
+  IN BOOLEAN     NeedGuard
+  )
+{
+  UINT64  DescStart;
+  UINT64  DescEnd;
+  UINT64  DescNumberOfBytes;
+
+  //
+  // If it's not a free entry, don't bother with it
+  //
+  if (Entry->Type != EfiConventionalMemory) {
+    return 0;
+  }
+
+  DescStart = Entry->Start;
+  DescEnd   = Entry->End;
+
+  //
+  // If desc is past max allowed address or below min allowed address, skip it
+  //
+  if ((DescStart >= MaxAddress) || (DescEnd < MinAddress)) {
+    return 0;
+  }
+
+  //
+  // If desc ends past max allowed address, clip the end
+  //
+  if (DescEnd >= MaxAddress) {
+    DescEnd = MaxAddress;
+  }
+
+  DescEnd = ((DescEnd + 1) & (~(Alignment - 1))) - 1;
+
+  // Skip if DescEnd is less than DescStart after alignment clipping
+  if (DescEnd < DescStart) {
+    return 0;
+  }
+
+  //
+  // Compute the number of bytes we can used from this
+  // descriptor, and see it's enough to satisfy the request
+  //
+  DescNumberOfBytes = DescEnd - DescStart + 1;
+
+  if (DescNumberOfBytes < NumberOfBytes) {
+    return 0;
+  }
+
+  //
+  // If the start of the allocated range is below the min address allowed, skip it
+  //
+  if ((DescEnd - NumberOfBytes + 1) < MinAddress) {
+    return 0;
+  }
+
+  if (NeedGuard) {
+    DescEnd = AdjustMemoryS (
+                DescEnd + 1 - DescNumberOfBytes,
+                DescNumberOfBytes,
+                NumberOfBytes
+                );
+  }
+
+  return DescEnd;
+}
+
 /**
   Internal function. Finds a consecutive free page range below
   the requested address.
@@ -1067,70 +1201,77 @@ CoreFindFreePagesI (
   NumberOfBytes = LShiftU64 (NumberOfPages, EFI_PAGE_SHIFT);
   Target        = 0;
 
-  for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-    Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-
-    //
-    // If it's not a free entry, don't bother with it
-    //
-    if (Entry->Type != EfiConventionalMemory) {
-      continue;
-    }
-
-    DescStart = Entry->Start;
-    DescEnd   = Entry->End;
-
+  if (FeaturePcdGet (PcdDxeMemoryMapIndexEnable)) {
     //
-    // If desc is past max allowed address or below min allowed address, skip it
+    // The index returns the highest range directly
     //
-    if ((DescStart >= MaxAddress) || (DescEnd < MinAddress)) {
-      continue;
-    }
-
-    //
-    // If desc ends past max allowed address, clip the end
-    //
-    if (DescEnd >= MaxAddress) {
-      DescEnd = MaxAddress;
-    }
+    Target = CoreMemoryMapIndexFindFree (MaxAddress, MinAddress, NumberOfBytes, Alignment, NeedGuard);
+  } else {
+    for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
+      Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
 
-    DescEnd = ((DescEnd + 1) & (~(Alignment - 1))) - 1;
+      //
+      // If it's not a free entry, don't bother with it
+      //
+      if (Entry->Type != EfiConventionalMemory) {
+        continue;
+      }
 
-    // Skip if DescEnd is less than DescStart after alignment clipping
-    if (DescEnd < DescStart) {
-      continue;
-    }
+      DescStart = Entry->Start;
+      DescEnd   = Entry->End;
 
-    //
-    // Compute the number of bytes we can used from this
-    // descriptor, and see it's enough to satisfy the request
-    //
-    DescNumberOfBytes = DescEnd - DescStart + 1;
+      //
+      // If desc is past max allowed address or below min allowed address, skip it
+      //
+      if ((DescStart >= MaxAddress) || (DescEnd < MinAddress)) {
+        continue;
+      }
 
-    if (DescNumberOfBytes >= NumberOfBytes) {
       //
-      // If the start of the allocated range is below the min address allowed, skip it
+      // If desc ends past max allowed address, clip the end
       //
-      if ((DescEnd - NumberOfBytes + 1) < MinAddress) {
+      if (DescEnd >= MaxAddress) {
+        DescEnd = MaxAddress;
+      }
+
+      DescEnd = ((DescEnd + 1) & (~(Alignment - 1))) - 1;
+
+      // Skip if DescEnd is less than DescStart after alignment clipping
+      if (DescEnd < DescStart) {
         continue;
       }
 
       //
-      // If this is the best match so far remember it
+      // Compute the number of bytes we can used from this
+      // descriptor, and see it's enough to satisfy the request
       //
-      if (DescEnd > Target) {
-        if (NeedGuard) {
-          DescEnd = AdjustMemoryS (
-                      DescEnd + 1 - DescNumberOfBytes,
-                      DescNumberOfBytes,
-                      NumberOfBytes
-                      );
-          if (DescEnd == 0) {
-            continue;
-          }
+      DescNumberOfBytes = DescEnd - DescStart + 1;
+
+      if (DescNumberOfBytes >= NumberOfBytes) {
+        //
+        // If the start of the allocated range is below the min address allowed, skip it
+        //
+        if ((DescEnd - NumberOfBytes + 1) < MinAddress) {
+          continue;
         }
 
-        Target = DescEnd;
+        //
+        // If this is the best match so far remember it
+        //
+        if (DescEnd > Target) {
+          if (NeedGuard) {
+            DescEnd = AdjustMemoryS (
+                        DescEnd + 1 - DescNumberOfBytes,
+                        DescNumberOfBytes,
+                        NumberOfBytes
+                        );
+            if (DescEnd == 0) {
+              continue;
+            }
+          }
+
+          Target = DescEnd;
+        }
       }
     }
   }
@@ -1540,10 +1681,15 @@ CoreInternalFreePages (
   //
   IsGuarded = FALSE;
   Entry     = NULL;
-  for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-    Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-    if ((Entry->Start <= Memory) && (Entry->End > Memory)) {
-      break;
+  if (FeaturePcdGet (PcdDxeMemoryMapIndexEnable)) {
+    Entry = CoreMemoryMapIndexFind (Memory);
+    Link  = (Entry == NULL) ? &gMemoryMap : &Entry->Link;
+  } else {
+    for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
+      Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
+      if ((Entry->Start <= Memory) && (Entry->End > Memory)) {
+        break;
+      }
     }
   }
 
@@ -21,6 +21,7 @@ typedef struct {
 
 #define POOL_HEAD_SIGNATURE      SIGNATURE_32('p','h','d','0')
 #define POOLPAGE_HEAD_SIGNATURE  SIGNATURE_32('p','h','d','1')
+#define POOLSLAB_HEAD_SIGNATURE  SIGNATURE_32('p','h','d','2')
 typedef struct {
   UINT32             Signature;
   UINT32             Reserved;
@@ -59,6 +60,26 @@ STATIC CONST UINT16  mPoolSizeTable[] = {
 
 #define MAX_POOL_SIZE  (MAX_ADDRESS - POOL_OVERHEAD)
 
+//
+// When PcdDxePoolSlabAllocatorEnable is TRUE, every pool page (or runtime
+// granule) only holds blocks of a single size class. The page starts with a
+// POOL_SLAB header that tracks the free blocks in a bitmap, so a page can be
+// returned as soon as its last block is freed.
+//
+#define POOL_SLAB_SIGNATURE   SIGNATURE_32('p','s','l','b')
+#define POOL_SLAB_MAX_BLOCKS  (RUNTIME_PAGE_ALLOCATION_GRANULARITY / 128)
+
+typedef struct {
+  UINT32        Signature;
+  UINT32        Index;
+  LIST_ENTRY    Link;
+  UINT32        BlockCount;
+  UINT32        FreeCount;
+  UINT64        FreeMap[(POOL_SLAB_MAX_BLOCKS + 63) / 64];
+} POOL_SLAB;
+
+#define SIZE_OF_POOL_SLAB  ALIGN_VALUE (sizeof (POOL_SLAB), 16)
+
 //
 // Globals
 //
@@ -70,6 +91,7 @@ typedef struct {
   EFI_MEMORY_TYPE    MemoryType;
   LIST_ENTRY         FreeList[MAX_POOL_LIST];
   LIST_ENTRY         Link;
+  LIST_ENTRY         SlabList[MAX_POOL_LIST];
 } POOL;
 
 //
@@ -125,6 +147,7 @@ CoreInitializePool (
     mPoolHead[Type].MemoryType = (EFI_MEMORY_TYPE)Type;
     for (Index = 0; Index < MAX_POOL_LIST; Index++) {
       InitializeListHead (&mPoolHead[Type].FreeList[Index]);
+      InitializeListHead (&mPoolHead[Type].SlabList[Index]);
     }
   }
 }
@@ -173,6 +196,7 @@ LookupPoolHead (
     Pool->MemoryType = MemoryType;
     for (Index = 0; Index < MAX_POOL_LIST; Index++) {
       InitializeListHead (&Pool->FreeList[Index]);
+      InitializeListHead (&Pool->SlabList[Index]);
     }
 
     InsertHeadList (&mPoolHeadList, &Pool->Link);
@@ -336,6 +360,82 @@ CoreAllocatePoolPagesI (
   return Buffer;
 }
 
+/**
+  Internal function.  Allocates a block of a size class from the slabs of a
+  pool, getting a new slab page when all the slabs of that size class are full.
+
+  @param  Pool                   The pool head of the memory type
+  @param  Index                  The size class of the block
+  @param  Granularity            The size and alignment of a slab
+
+  @return The allocated block, or NULL
+
+**/
+STATIC
+POOL_HEAD *
+CoreAllocatePoolSlabBlock (
+  IN POOL   *Pool,
+  IN UINTN  Index,
+  IN UINTN  Granularity
+  )
+{
+  POOL_SLAB  *Slab;
+  UINTN      Block;
+  UINTN      Word;
+
+  if (IsListEmpty (&Pool->SlabList[Index])) {
+    Slab = CoreAllocatePoolPagesI (
+             Pool->MemoryType,
+             EFI_SIZE_TO_PAGES (Granularity),
+             Granularity,
+             FALSE
+             );
+    if (Slab == NULL) {
+      return NULL;
+    }
+
+    Slab->Signature  = POOL_SLAB_SIGNATURE;
+    Slab->Index      = (UINT32)Index;
+    Slab->BlockCount = (UINT32)MIN ((Granularity - SIZE_OF_POOL_SLAB) / LIST_TO_SIZE (Index), POOL_SLAB_MAX_BLOCKS);
+    Slab->FreeCount  = Slab->BlockCount;
+    ASSERT (Slab->BlockCount > 0);
+
+    ZeroMem (Slab->FreeMap, sizeof (Slab->FreeMap));
+    for (Block = 0; Block < Slab->BlockCount; Block++) {
+      Slab->FreeMap[Block / 64] |= LShiftU64 (1, Block % 64);
+    }
+
+    InsertHeadList (&Pool->SlabList[Index], &Slab->Link);
+  }
+
+  //
+  // Take the lowest free block of the first slab that has one
+  //
+  Slab = CR (Pool->SlabList[Index].ForwardLink, POOL_SLAB, Link, POOL_SLAB_SIGNATURE);
+  for (Word = 0; (Word < ARRAY_SIZE (Slab->FreeMap)) && (Slab->FreeMap[Word] == 0); Word++) {
+  }
+
+  ASSERT (Word < ARRAY_SIZE (Slab->FreeMap));
+  if (Word == ARRAY_SIZE (Slab->FreeMap)) {
+    return NULL;
+  }
+
+  Block                 = (UINTN)LowBitSet64 (Slab->FreeMap[Word]);
+  Slab->FreeMap[Word]  &= ~LShiftU64 (1, Block);
+  Block                += Word * 64;
+  Slab->FreeCount--;
+
+  //
+  // Full slabs are not kept on the list, so that the next allocation does
+  // not have to skip them
+  //
+  if (Slab->FreeCount == 0) {
+    RemoveEntryList (&Slab->Link);
+  }
+
+  return (POOL_HEAD *)((UINT8 *)Slab + SIZE_OF_POOL_SLAB + Block * LIST_TO_SIZE (Index));
+}
+
 /**
   Internal function to allocate pool of a particular type.
   Caller must have the memory lock held
@@ -367,6 +467,7 @@ CoreAllocatePoolI (
   UINTN      Granularity;
   BOOLEAN    HasPoolTail;
   BOOLEAN    PageAsPool;
+  BOOLEAN    FromSlab;
 
   ASSERT_LOCKED (&mPoolMemoryLock);
 
@@ -402,7 +503,8 @@ CoreAllocatePoolI (
     return NULL;
   }
 
-  Head = NULL;
+  Head     = NULL;
+  FromSlab = FALSE;
 
   //
   // If allocation is over max size, just allocate pages for the request
@@ -423,6 +525,16 @@ CoreAllocatePoolI (
     goto Done;
   }
 
+  //
+  // In slab mode, serve the allocation from a page that only holds blocks of
+  // this size class
+  //
+  if (FeaturePcdGet (PcdDxePoolSlabAllocatorEnable)) {
+    Head     = CoreAllocatePoolSlabBlock (Pool, Index, Granularity);
+    FromSlab = TRUE;
+    goto Done;
+  }
+
   //
   // If there's no free pool in the proper list size, go get some more pages
   //
@@ -505,7 +617,14 @@ Done:
     //
     // If we have a pool buffer, fill in the header & tail info
     //
-    Head->Signature = (PageAsPool) ? POOLPAGE_HEAD_SIGNATURE : POOL_HEAD_SIGNATURE;
+    if (PageAsPool) {
+      Head->Signature = POOLPAGE_HEAD_SIGNATURE;
+    } else if (FromSlab) {
+      Head->Signature = POOLSLAB_HEAD_SIGNATURE;
+    } else {
+      Head->Signature = POOL_HEAD_SIGNATURE;
+    }
+
     Head->Size      = Size;
     Head->Type      = (EFI_MEMORY_TYPE)PoolType;
     Buffer          = Head->Data;
@@ -665,6 +784,61 @@ CoreFreePoolPagesWithGuard (
   }
 }
 
+/**
+  Internal function.  Returns a block to its slab, and the slab page to free
+  memory once all of its blocks are free.
+
+  An empty slab is kept as long as it is the only slab of its size class, so
+  that a size class that is allocated and freed in a loop does not allocate
+  and free a page on every iteration. Slabs of OS/OEM specific memory types
+  are always returned, as their pool head is freed with the last allocation.
+
+  @param  Pool                   The pool head of the memory type
+  @param  Head                   The block to free
+  @param  Granularity            The size and alignment of a slab
+
+**/
+STATIC
+VOID
+CoreFreePoolSlabBlock (
+  IN POOL       *Pool,
+  IN POOL_HEAD  *Head,
+  IN UINTN      Granularity
+  )
+{
+  POOL_SLAB  *Slab;
+  UINTN      Block;
+  UINT64     Mask;
+
+  Slab = (POOL_SLAB *)((UINTN)Head & ~(Granularity - 1));
+  ASSERT (Slab->Signature == POOL_SLAB_SIGNATURE);
+
+  Block = ((UINTN)Head - (UINTN)Slab - SIZE_OF_POOL_SLAB) / LIST_TO_SIZE (Slab->Index);
+  Mask  = LShiftU64 (1, Block % 64);
+  ASSERT (Block < Slab->BlockCount);
+  ASSERT ((Slab->FreeMap[Block / 64] & Mask) == 0);
+
+  Slab->FreeMap[Block / 64] |= Mask;
+  if (Slab->FreeCount == 0) {
+    InsertHeadList (&Pool->SlabList[Slab->Index], &Slab->Link);
+  }
+
+  Slab->FreeCount++;
+
+  if ((Slab->FreeCount == Slab->BlockCount) &&
+      (((UINT32)Pool->MemoryType >= MEMORY_TYPE_OEM_RESERVED_MIN) ||
+       (Slab->Link.ForwardLink != Slab->Link.BackLink)))
+  {
+    RemoveEntryList (&Slab->Link);
+    Slab->Signature = 0;
+    CoreFreePoolPagesI (
+      Pool->MemoryType,
+      (EFI_PHYSICAL_ADDRESS)(UINTN)Slab,
+      EFI_SIZE_TO_PAGES (Granularity)
+      );
+  }
+}
+
 /**
   Internal function to free a pool entry.
   Caller must have the memory lock held
@@ -696,6 +870,7 @@ CoreFreePoolI (
   BOOLEAN    IsGuarded;
   BOOLEAN    HasPoolTail;
   BOOLEAN    PageAsPool;
+  BOOLEAN    FromSlab;
 
   ASSERT (Buffer != NULL);
   //
@@ -705,11 +880,13 @@ CoreFreePoolI (
   ASSERT (Head != NULL);
 
   if ((Head->Signature != POOL_HEAD_SIGNATURE) &&
-      (Head->Signature != POOLPAGE_HEAD_SIGNATURE))
+      (Head->Signature != POOLPAGE_HEAD_SIGNATURE) &&
+      (Head->Signature != POOLSLAB_HEAD_SIGNATURE))
   {
     ASSERT (
       Head->Signature == POOL_HEAD_SIGNATURE ||
-      Head->Signature == POOLPAGE_HEAD_SIGNATURE
+      Head->Signature == POOLPAGE_HEAD_SIGNATURE ||
+      Head->Signature == POOLSLAB_HEAD_SIGNATURE
       );
     return EFI_INVALID_PARAMETER;
   }
@@ -719,6 +896,7 @@ CoreFreePoolI (
   HasPoolTail = !(IsGuarded &&
                   ((PcdGet8 (PcdHeapGuardPropertyMask) & BIT7) == 0));
   PageAsPool = (Head->Signature == POOLPAGE_HEAD_SIGNATURE);
+  FromSlab   = (Head->Signature == POOLSLAB_HEAD_SIGNATURE);
 
   if (HasPoolTail) {
     Tail = HEAD_TO_TAIL (Head);
@@ -796,6 +974,11 @@ CoreFreePoolI (
         NoPages
         );
     }
+  } else if (FromSlab) {
+    //
+    // Give the block back to its slab
+    //
+    CoreFreePoolSlabBlock (Pool, Head, Granularity);
   } else {
     //
     // Put the pool entry onto the free pool list
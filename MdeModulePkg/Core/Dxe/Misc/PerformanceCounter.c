@@ -0,0 +1,95 @@
+/** @file
+  DXE core performance counters.
+
+  The DXE core keeps a few counters about its internal data structures, for
+  example how many handles were compared while validating handles. They are
+  logged as performance event records at ReadyToBoot so that they can be
+  read from the FPDT together with the timing records.
+
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "DxeMain.h"
+
+#include <Guid/ExtendedFirmwarePerformance.h>
+
+/**
+  Log a DXE core performance counter.
+
+  The counter is logged as a performance event record whose string is
+  "Name=Value", so it shows up in the FPDT next to the timing records.
+
+  @param  Name                   The name of the counter.
+  @param  Value                  The value of the counter.
+
+**/
+VOID
+CoreLogPerformanceCounter (
+  IN CONST CHAR8  *Name,
+  IN UINT64       Value
+  )
+{
+  CHAR8  String[FPDT_STRING_EVENT_RECORD_NAME_LENGTH];
+
+  DEBUG ((DEBUG_INFO, "DxeCore counter %a = %Ld\n", Name, Value));
+
+  if (LogPerformanceMeasurementEnabled (PERF_GENERAL_TYPE)) {
+    AsciiSPrint (String, sizeof (String), "%a=%Ld", Name, Value);
+    LogPerformanceMeasurement (&gEfiCallerIdGuid, NULL, String, 0, PERF_EVENT_ID);
+  }
+}
+
+/**
+  Report all DXE core performance counters on the first ReadyToBoot.
+
+  @param  Event                  The ReadyToBoot event.
+  @param  Context                Not used.
+
+**/
+VOID
+EFIAPI
+CoreReportPerformanceCountersOnReadyToBoot (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  CoreReportHandleValidationCounters ();
+  CoreReportTimerCounters ();
+  CoreReportImageLoadAheadCounters ();
+  CoreReportDepexCounters ();
+  CoreReportFvSectionCacheCounters ();
+
+  //
+  // The counters are only reported once, even if ReadyToBoot is signaled
+  // again when a boot option returns.
+  //
+  CoreCloseEvent (Event);
+}
+
+/**
+  Initialize the DXE core performance counters. The counters are
+  reported at ReadyToBoot.
+**/
+VOID
+CoreInitializePerformanceCounters (
+  VOID
+  )
+{
+  EFI_STATUS  Status;
+  EFI_EVENT   ReadyToBootEvent;
+
+  if (!PerformanceMeasurementEnabled ()) {
+    return;
+  }
+
+  Status = CoreCreateEventInternal (
+             EVT_NOTIFY_SIGNAL,
+             TPL_CALLBACK,
+             CoreReportPerformanceCountersOnReadyToBoot,
+             NULL,
+             &gEfiEventReadyToBootGuid,
+             &ReadyToBootEvent
+             );
+  ASSERT_EFI_ERROR (Status);
+}
@@ -1456,6 +1456,71 @@ CloseSectionStream (
   return Status;
 }
 
+/**
+  Worker function. Get the number of bytes held by the encapsulated streams
+  of a section stream node, recursively.
+
+  @param  StreamNode             The section stream node.
+
+  @return The number of bytes held by the encapsulated streams.
+
+**/
+STATIC
+UINTN
+GetStreamNodeCacheSize (
+  IN CORE_SECTION_STREAM_NODE  *StreamNode
+  )
+{
+  LIST_ENTRY                *Link;
+  CORE_SECTION_CHILD_NODE   *ChildNode;
+  CORE_SECTION_STREAM_NODE  *ChildStreamNode;
+  UINTN                     Size;
+
+  Size = 0;
+  for (Link = GetFirstNode (&StreamNode->Children);
+       !IsNull (&StreamNode->Children, Link);
+       Link = GetNextNode (&StreamNode->Children, Link))
+  {
+    ChildNode = CHILD_SECTION_NODE_FROM_LINK (Link);
+    if (ChildNode->EncapsulatedStreamHandle != NULL_STREAM_HANDLE) {
+      ChildStreamNode = (CORE_SECTION_STREAM_NODE *)ChildNode->EncapsulatedStreamHandle;
+      Size           += ChildStreamNode->StreamLength + GetStreamNodeCacheSize (ChildStreamNode);
+    }
+  }
+
+  return Size;
+}
+
+/**
+  Get the number of bytes held by the encapsulated streams of a section
+  stream, that is the sections that have been decompressed or extracted from
+  it so far.
+
+  @param  SectionStreamHandle    The section stream.
+
+  @return The number of bytes held by the encapsulated streams.
+
+**/
+UINTN
+GetSectionStreamCacheSize (
+  IN UINTN  SectionStreamHandle
+  )
+{
+  CORE_SECTION_STREAM_NODE  *StreamNode;
+  EFI_TPL                   OldTpl;
+  UINTN                     Size;
+
+  OldTpl = CoreRaiseTpl (TPL_NOTIFY);
+
+  Size = 0;
+  if (!EFI_ERROR (FindStreamNode (SectionStreamHandle, &StreamNode))) {
+    Size = GetStreamNodeCacheSize (StreamNode);
+  }
+
+  CoreRestoreTpl (OldTpl);
+  return Size;
+}
+
 /**
   The ExtractSection() function processes the input section and
   allocates a buffer from the pool in which it returns the section
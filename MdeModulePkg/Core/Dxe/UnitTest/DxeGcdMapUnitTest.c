@@ -0,0 +1,1009 @@
+/** @file
+  This is a host-based unit test and benchmark for the address index of the
+  GCD memory and I/O space maps of the DXE Core (PcdDxeGcdMapIndexEnable).
+
+  Memory and I/O space is added, removed, allocated, freed, and given new
+  capabilities and attributes at random through the GCD services. After each
+  step, CoreSearchGcdMapEntry () is compared with a copy of the linear walk of
+  the GCD map it had before the index, on both maps, and the shape of each
+  index is checked against its map.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <time.h>
+#include <cmocka.h>
+
+#include <Library/UnitTestLib.h>
+#include <Library/DxeCoreEntryPoint.h>
+
+#include "../DxeMain.h"
+#include "../Gcd/Gcd.h"
+
+#define UNIT_TEST_NAME     "DXE Core GCD Map Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// The width of the address spaces, and the part of them the stress test
+// works in
+//
+#define TEST_MEMORY_SPACE_BITS  36
+#define TEST_IO_SPACE_BITS      16
+#define TEST_MEMORY_WINDOW      SIZE_64MB
+#define TEST_IO_WINDOW          SIZE_32KB
+
+//
+// The number of random operations, and the number of searches compared after
+// each of them
+//
+#define STRESS_ITERATIONS  20000
+#define STRESS_SEARCHES    8
+
+//
+// The number of entries the benchmark adds to the GCD memory space map, where
+// it adds them, and the number of searches it times
+//
+#define BENCHMARK_ENTRIES   16384
+#define BENCHMARK_BASE      SIZE_4GB
+#define BENCHMARK_SEARCHES  2000
+
+typedef struct {
+  BOOLEAN                 Io;
+  EFI_PHYSICAL_ADDRESS    BaseAddress;
+  UINT64                  Length;
+} TEST_ALLOCATION;
+
+//
+// mTestHandles     - The image and device handles given to the allocations
+// mAllocations     - The live allocations of the stress test
+// mAllocationCount - The number of entries of mAllocations
+// mRandomSeed      - State of the random generator
+//
+UINTN            mTestHandles[4];
+TEST_ALLOCATION  mAllocations[1024];
+UINTN            mAllocationCount;
+UINT32           mRandomSeed = 0x7654321;
+
+extern EFI_GCD_MAP_ENTRY  mGcdMemorySpaceMapEntryTemplate;
+extern EFI_GCD_MAP_ENTRY  mGcdIoSpaceMapEntryTemplate;
+extern ADDRESS_INDEX      mGcdMemorySpaceMapIndex;
+extern ADDRESS_INDEX      mGcdIoSpaceMapIndex;
+
+/**
+  Search a segment of memory space in GCD map. The result is a range of GCD entry list.
+
+  @param  BaseAddress            The start address of the segment.
+  @param  Length                 The length of the segment.
+  @param  StartLink              The first GCD entry involves this segment of
+                                 memory space.
+  @param  EndLink                The first GCD entry involves this segment of
+                                 memory space.
+  @param  Map                    Points to the start entry to search.
+
+  @retval EFI_SUCCESS            Successfully found the entry.
+  @retval EFI_NOT_FOUND          Not found.
+
+**/
+EFI_STATUS
+CoreSearchGcdMapEntry (
+  IN  EFI_PHYSICAL_ADDRESS  BaseAddress,
+  IN  UINT64                Length,
+  OUT LIST_ENTRY            **StartLink,
+  OUT LIST_ENTRY            **EndLink,
+  IN  LIST_ENTRY            *Map
+  );
+
+/**
+  Count the amount of GCD map entries.
+
+  @param  Map                    Points to the start entry to do the count loop.
+
+  @return The count.
+
+**/
+UINTN
+CoreCountGcdMapEntry (
+  IN LIST_ENTRY  *Map
+  );
+
+/**
+  Acquire memory lock on mGcdIoSpaceLock.
+
+**/
+VOID
+CoreAcquireGcdIoLock (
+  VOID
+  );
+
+/**
+  Release memory lock on mGcdIoSpaceLock.
+
+**/
+VOID
+CoreReleaseGcdIoLock (
+  VOID
+  );
+
+EFI_HANDLE             gDxeCoreImageHandle = &mTestHandles[0];
+EFI_CPU_ARCH_PROTOCOL  *gCpu               = NULL;
+VOID                   *gHobList           = NULL;
+BOOLEAN                mOnGuarding         = FALSE;
+
+EFI_MEMORY_TYPE_INFORMATION  gMemoryTypeInformation[EfiMaxMemoryType + 1];
+
+/// === STUBS ======================================================================================
+
+/**
+  Acquire a lock. The tests run on a single thread at a single TPL.
+
+  @param  Lock               The lock to acquire
+
+**/
+VOID
+CoreAcquireLock (
+  IN EFI_LOCK  *Lock
+  )
+{
+  ASSERT (Lock->Lock == EfiLockReleased);
+  Lock->Lock = EfiLockAcquired;
+}
+
+/**
+  Release a lock.
+
+  @param  Lock               The lock to release
+
+**/
+VOID
+CoreReleaseLock (
+  IN EFI_LOCK  *Lock
+  )
+{
+  ASSERT (Lock->Lock == EfiLockAcquired);
+  Lock->Lock = EfiLockReleased;
+}
+
+/**
+  The memory map is not part of the tests.
+
+  @param  Type                   The type of memory to add
+  @param  Start                  The starting address in the memory range Must be
+                                 page aligned
+  @param  NumberOfPages          The number of pages in the range
+  @param  Attribute              Attributes of the memory to add
+
+**/
+VOID
+CoreAddMemoryDescriptor (
+  IN EFI_MEMORY_TYPE       Type,
+  IN EFI_PHYSICAL_ADDRESS  Start,
+  IN UINT64                NumberOfPages,
+  IN UINT64                Attribute
+  )
+{
+}
+
+/**
+  The memory map is not part of the tests.
+
+  @param  Start                  The start address of the range.
+  @param  NumberOfPages          The number of pages of the range.
+  @param  NewAttributes          The new attributes of the range.
+
+**/
+VOID
+CoreUpdateMemoryAttributes (
+  IN EFI_PHYSICAL_ADDRESS  Start,
+  IN UINT64                NumberOfPages,
+  IN UINT64                NewAttributes
+  )
+{
+}
+
+/**
+  The pool is not part of the tests.
+
+**/
+VOID
+CoreInitializePool (
+  VOID
+  )
+{
+}
+
+/**
+  Frees the GCD map entries, which are allocated from the host.
+
+  @param  Buffer                 The allocated pool entry to free
+
+  @retval EFI_SUCCESS            Pool successfully freed.
+
+**/
+EFI_STATUS
+EFIAPI
+CoreFreePool (
+  IN VOID  *Buffer
+  )
+{
+  FreePool (Buffer);
+  return EFI_SUCCESS;
+}
+
+/**
+  There is no HOB list in the tests.
+
+  @param  Type          The HOB type to return.
+
+  @return NULL.
+
+**/
+VOID *
+EFIAPI
+GetFirstHob (
+  IN UINT16  Type
+  )
+{
+  return NULL;
+}
+
+/**
+  There is no HOB list in the tests.
+
+  @param  Type          The HOB type to return.
+  @param  HobStart      The starting HOB pointer to search from.
+
+  @return NULL.
+
+**/
+VOID *
+EFIAPI
+GetNextHob (
+  IN UINT16      Type,
+  IN CONST VOID  *HobStart
+  )
+{
+  return NULL;
+}
+
+/**
+  There is no HOB list in the tests.
+
+  @param  Guid          The GUID to match with in the HOB list.
+
+  @return NULL.
+
+**/
+VOID *
+EFIAPI
+GetFirstGuidHob (
+  IN CONST EFI_GUID  *Guid
+  )
+{
+  return NULL;
+}
+
+/// === HELPERS ====================================================================================
+
+/**
+  Return a pseudo-random number. The sequence is the same on every run.
+
+  @return The next number of the sequence.
+
+**/
+STATIC
+UINT32
+TestRandom (
+  VOID
+  )
+{
+  mRandomSeed ^= mRandomSeed << 13;
+  mRandomSeed ^= mRandomSeed >> 17;
+  mRandomSeed ^= mRandomSeed << 5;
+  return mRandomSeed;
+}
+
+/**
+  Search a segment of memory space in GCD map. The result is a range of GCD entry list.
+
+  This is the linear walk of the GCD map that CoreSearchGcdMapEntry () did
+  before the index, kept as the reference of the tests.
+
+  @param  BaseAddress            The start address of the segment.
+  @param  Length                 The length of the segment.
+  @param  StartLink              The first GCD entry involves this segment of
+                                 memory space.
+  @param  EndLink                The first GCD entry involves this segment of
+                                 memory space.
+  @param  Map                    Points to the start entry to search.
+
+  @retval EFI_SUCCESS            Successfully found the entry.
+  @retval EFI_NOT_FOUND          Not found.
+
+**/
+STATIC
+EFI_STATUS
+LinearSearchGcdMapEntry (
+  IN  EFI_PHYSICAL_ADDRESS  BaseAddress,
+  IN  UINT64                Length,
+  OUT LIST_ENTRY            **StartLink,
+  OUT LIST_ENTRY            **EndLink,
+  IN  LIST_ENTRY            *Map
+  )
+{
+  LIST_ENTRY         *Link;
+  EFI_GCD_MAP_ENTRY  *Entry;
+
+  ASSERT (Length != 0);
+
+  *StartLink = NULL;
+  *EndLink   = NULL;
+
+  Link = Map->ForwardLink;
+  while (Link != Map) {
+    Entry = CR (Link, EFI_GCD_MAP_ENTRY, Link, EFI_GCD_MAP_SIGNATURE);
+    if ((BaseAddress >= Entry->BaseAddress) && (BaseAddress <= Entry->EndAddress)) {
+      *StartLink = Link;
+    }
+
+    if (*StartLink != NULL) {
+      if (((BaseAddress + Length - 1) >= Entry->BaseAddress) &&
+          ((BaseAddress + Length - 1) <= Entry->EndAddress))
+      {
+        *EndLink = Link;
+        return EFI_SUCCESS;
+      }
+    }
+
+    Link = Link->ForwardLink;
+  }
+
+  return EFI_NOT_FOUND;
+}
+
+/**
+  Check a subtree of the index of a GCD map: the nodes are the entries of the
+  map in the same order, and the priorities form a heap.
+
+  @param  Node                   The root of the subtree.
+  @param  Map                    The GCD map.
+  @param  Link                   The link of the entry before the subtree, and
+                                 returns the link of its last entry.
+
+  @retval TRUE                   The subtree is valid.
+  @retval FALSE                  The subtree is not valid.
+
+**/
+STATIC
+BOOLEAN
+CheckIndexNode (
+  IN     ADDRESS_INDEX_NODE  *Node,
+  IN     LIST_ENTRY          *Map,
+  IN OUT LIST_ENTRY          **Link
+  )
+{
+  EFI_GCD_MAP_ENTRY  *Entry;
+
+  if (Node == NULL) {
+    return TRUE;
+  }
+
+  if ((Node->Left != NULL) && (Node->Left->Priority > Node->Priority)) {
+    return FALSE;
+  }
+
+  if ((Node->Right != NULL) && (Node->Right->Priority > Node->Priority)) {
+    return FALSE;
+  }
+
+  if (!CheckIndexNode (Node->Left, Map, Link)) {
+    return FALSE;
+  }
+
+  *Link = (*Link)->ForwardLink;
+  if (*Link == Map) {
+    return FALSE;
+  }
+
+  Entry = BASE_CR (Node, EFI_GCD_MAP_ENTRY, IndexNode);
+  if ((&Entry->Link != *Link) || (Entry->Signature != EFI_GCD_MAP_SIGNATURE) || (Node->Key != Entry->BaseAddress)) {
+    return FALSE;
+  }
+
+  return CheckIndexNode (Node->Right, Map, Link);
+}
+
+/**
+  Check that the index of a GCD map holds exactly the entries of the map, and
+  that its shape is valid.
+
+  @param  Index                  The index of the GCD map.
+  @param  Map                    The GCD map.
+
+  @retval TRUE                   The index is valid.
+  @retval FALSE                  The index is not valid.
+
+**/
+STATIC
+BOOLEAN
+CheckIndex (
+  IN ADDRESS_INDEX  *Index,
+  IN LIST_ENTRY     *Map
+  )
+{
+  LIST_ENTRY  *Link;
+
+  Link = Map;
+  if (!CheckIndexNode (Index->Root, Map, &Link)) {
+    return FALSE;
+  }
+
+  return (BOOLEAN)(Link->ForwardLink == Map);
+}
+
+/**
+  Compare CoreSearchGcdMapEntry () with the linear walk of a GCD map for
+  random ranges, most of them in the part of the map the tests change.
+
+  @param  Map                    The GCD map.
+  @param  Window                 The size of the part of the map the tests change.
+  @param  SpaceBits              The width of the address space of the map.
+  @param  Searches               The number of searches to compare.
+
+  @retval TRUE                   The searches gave the same results.
+  @retval FALSE                  A search gave a different result.
+
+**/
+STATIC
+BOOLEAN
+CompareSearches (
+  IN LIST_ENTRY  *Map,
+  IN UINT64      Window,
+  IN UINTN       SpaceBits,
+  IN UINTN       Searches
+  )
+{
+  EFI_PHYSICAL_ADDRESS  BaseAddress;
+  UINT64                Length;
+  LIST_ENTRY            *StartLink;
+  LIST_ENTRY            *EndLink;
+  LIST_ENTRY            *ExpectedStartLink;
+  LIST_ENTRY            *ExpectedEndLink;
+  EFI_STATUS            Status;
+  EFI_STATUS            ExpectedStatus;
+  UINTN                 Index;
+
+  for (Index = 0; Index < Searches; Index++) {
+    switch (TestRandom () % 8) {
+      case 0:
+        //
+        // Anywhere in the address space, or past its end
+        //
+        BaseAddress  = LShiftU64 (TestRandom (), 32);
+        BaseAddress |= TestRandom ();
+        BaseAddress &= LShiftU64 (2, SpaceBits) - 1;
+        break;
+      case 1:
+        BaseAddress = LShiftU64 (1, SpaceBits) - 1 - TestRandom () % Window;
+        break;
+      default:
+        BaseAddress = TestRandom () % Window;
+        break;
+    }
+
+    //
+    // Some of the ranges are longer than the address space, or wrap around
+    // the end of the addresses
+    //
+    Length = 1 + TestRandom () % (Window / 64);
+    switch (TestRandom () % 16) {
+      case 0:
+        Length = LShiftU64 (1, SpaceBits);
+        break;
+      case 1:
+        Length = MAX_UINT64 - Length;
+        break;
+      default:
+        break;
+    }
+
+    if (Map == &mGcdMemorySpaceMap) {
+      CoreAcquireGcdMemoryLock ();
+    } else {
+      CoreAcquireGcdIoLock ();
+    }
+
+    ExpectedStatus = LinearSearchGcdMapEntry (BaseAddress, Length, &ExpectedStartLink, &ExpectedEndLink, Map);
+    Status         = CoreSearchGcdMapEntry (BaseAddress, Length, &StartLink, &EndLink, Map);
+
+    if (Map == &mGcdMemorySpaceMap) {
+      CoreReleaseGcdMemoryLock ();
+    } else {
+      CoreReleaseGcdIoLock ();
+    }
+
+    //
+    // The links the linear walk returns with EFI_NOT_FOUND are not used
+    //
+    if ((Status != ExpectedStatus) ||
+        (!EFI_ERROR (Status) && ((StartLink != ExpectedStartLink) || (EndLink != ExpectedEndLink))))
+    {
+      UT_LOG_ERROR (
+        "Search Base=%Lx Length=%Lx returned %r instead of %r, or different entries\n",
+        BaseAddress,
+        Length,
+        Status,
+        ExpectedStatus
+        );
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/**
+  Get a random range of the part of a GCD map the stress test changes.
+
+  @param  Io                     TRUE for the I/O space map, FALSE for the memory space map.
+  @param  BaseAddress            Returns the base address of the range.
+  @param  Length                 Returns the length of the range.
+
+**/
+STATIC
+VOID
+RandomRange (
+  IN  BOOLEAN               Io,
+  OUT EFI_PHYSICAL_ADDRESS  *BaseAddress,
+  OUT UINT64                *Length
+  )
+{
+  UINT64  Granularity;
+  UINT64  Window;
+
+  Granularity = Io ? 1 : EFI_PAGE_SIZE;
+  Window      = Io ? TEST_IO_WINDOW : TEST_MEMORY_WINDOW;
+
+  *BaseAddress = (TestRandom () % (Window / Granularity)) * Granularity;
+  *Length      = (1 + TestRandom () % 64) * Granularity;
+  if ((TestRandom () % 8) == 0) {
+    *Length *= 16;
+  }
+}
+
+/**
+  Record an allocation of the stress test.
+
+  @param  Io                     TRUE for the I/O space map, FALSE for the memory space map.
+  @param  BaseAddress            The base address of the allocation.
+  @param  Length                 The length of the allocation.
+
+**/
+STATIC
+VOID
+RecordAllocation (
+  IN BOOLEAN               Io,
+  IN EFI_PHYSICAL_ADDRESS  BaseAddress,
+  IN UINT64                Length
+  )
+{
+  if (mAllocationCount < ARRAY_SIZE (mAllocations)) {
+    mAllocations[mAllocationCount].Io          = Io;
+    mAllocations[mAllocationCount].BaseAddress = BaseAddress;
+    mAllocations[mAllocationCount].Length      = Length;
+    mAllocationCount++;
+  }
+}
+
+/**
+  Free one of the allocations of the stress test at random.
+
+  @retval TRUE                   The allocation was freed.
+  @retval FALSE                  The allocation could not be freed.
+
+**/
+STATIC
+BOOLEAN
+FreeRandomAllocation (
+  VOID
+  )
+{
+  TEST_ALLOCATION  *Allocation;
+  EFI_STATUS       Status;
+
+  if (mAllocationCount == 0) {
+    return TRUE;
+  }
+
+  Allocation = &mAllocations[TestRandom () % mAllocationCount];
+  if (Allocation->Io) {
+    Status = CoreFreeIoSpace (Allocation->BaseAddress, Allocation->Length);
+  } else {
+    Status = CoreFreeMemorySpace (Allocation->BaseAddress, Allocation->Length);
+  }
+
+  if (EFI_ERROR (Status)) {
+    UT_LOG_ERROR ("Free Base=%Lx Length=%Lx returned %r\n", Allocation->BaseAddress, Allocation->Length, Status);
+    return FALSE;
+  }
+
+  *Allocation = mAllocations[--mAllocationCount];
+  return TRUE;
+}
+
+/**
+  Change the GCD memory space map at random.
+
+**/
+STATIC
+VOID
+ChangeMemorySpace (
+  VOID
+  )
+{
+  STATIC CONST EFI_GCD_MEMORY_TYPE  Types[] = {
+    EfiGcdMemoryTypeReserved,
+    EfiGcdMemoryTypeSystemMemory,
+    EfiGcdMemoryTypeMemoryMappedIo,
+    EfiGcdMemoryTypePersistent
+  };
+  STATIC CONST UINT64               Capabilities[] = {
+    0,
+    EFI_MEMORY_UC | EFI_MEMORY_WB,
+    EFI_MEMORY_UC | EFI_MEMORY_RUNTIME
+  };
+  EFI_PHYSICAL_ADDRESS              BaseAddress;
+  UINT64                            Length;
+  EFI_GCD_ALLOCATE_TYPE             AllocateType;
+  EFI_GCD_MEMORY_TYPE               Type;
+  UINT64                            Capability;
+  EFI_HANDLE                        ImageHandle;
+  EFI_HANDLE                        DeviceHandle;
+
+  RandomRange (FALSE, &BaseAddress, &Length);
+  switch (TestRandom () % 6) {
+    case 0:
+    case 1:
+      Type       = Types[TestRandom () % ARRAY_SIZE (Types)];
+      Capability = Capabilities[TestRandom () % ARRAY_SIZE (Capabilities)];
+      CoreAddMemorySpace (Type, BaseAddress, Length, Capability);
+      break;
+    case 2:
+      CoreRemoveMemorySpace (BaseAddress, Length);
+      break;
+    case 3:
+      AllocateType = (EFI_GCD_ALLOCATE_TYPE)(TestRandom () % EfiGcdMaxAllocateType);
+      Type         = Types[TestRandom () % ARRAY_SIZE (Types)];
+      ImageHandle  = &mTestHandles[TestRandom () % ARRAY_SIZE (mTestHandles)];
+      DeviceHandle = &mTestHandles[TestRandom () % ARRAY_SIZE (mTestHandles)];
+      if (AllocateType == EfiGcdAllocateMaxAddressSearchBottomUp) {
+        BaseAddress = TEST_MEMORY_WINDOW - 1;
+      } else if (AllocateType == EfiGcdAllocateMaxAddressSearchTopDown) {
+        BaseAddress = TEST_MEMORY_WINDOW / 2 - 1;
+      }
+
+      if (!EFI_ERROR (CoreAllocateMemorySpace (AllocateType, Type, EFI_PAGE_SHIFT, Length, &BaseAddress, ImageHandle, DeviceHandle))) {
+        RecordAllocation (FALSE, BaseAddress, Length);
+      }
+
+      break;
+    case 4:
+      Capability = Capabilities[TestRandom () % ARRAY_SIZE (Capabilities)];
+      CoreSetMemorySpaceCapabilities (BaseAddress, Length, Capability);
+      break;
+    default:
+      //
+      // EFI_MEMORY_RUNTIME is not a CPU attribute, so gCpu is not needed
+      //
+      CoreSetMemorySpaceAttributes (BaseAddress, Length, ((TestRandom () % 2) == 0) ? EFI_MEMORY_RUNTIME : 0);
+      break;
+  }
+}
+
+/**
+  Change the GCD I/O space map at random.
+
+**/
+STATIC
+VOID
+ChangeIoSpace (
+  VOID
+  )
+{
+  EFI_PHYSICAL_ADDRESS   BaseAddress;
+  UINT64                 Length;
+  EFI_GCD_ALLOCATE_TYPE  AllocateType;
+  EFI_GCD_IO_TYPE        Type;
+  EFI_HANDLE             ImageHandle;
+
+  RandomRange (TRUE, &BaseAddress, &Length);
+  Type = ((TestRandom () % 2) == 0) ? EfiGcdIoTypeReserved : EfiGcdIoTypeIo;
+  switch (TestRandom () % 4) {
+    case 0:
+    case 1:
+      CoreAddIoSpace (Type, BaseAddress, Length);
+      break;
+    case 2:
+      CoreRemoveIoSpace (BaseAddress, Length);
+      break;
+    default:
+      AllocateType = (EFI_GCD_ALLOCATE_TYPE)(TestRandom () % EfiGcdMaxAllocateType);
+      ImageHandle  = &mTestHandles[TestRandom () % ARRAY_SIZE (mTestHandles)];
+      if ((AllocateType == EfiGcdAllocateMaxAddressSearchBottomUp) || (AllocateType == EfiGcdAllocateMaxAddressSearchTopDown)) {
+        BaseAddress = TEST_IO_WINDOW - 1;
+      }
+
+      if (!EFI_ERROR (CoreAllocateIoSpace (AllocateType, Type, 0, Length, &BaseAddress, ImageHandle, NULL))) {
+        RecordAllocation (TRUE, BaseAddress, Length);
+      }
+
+      break;
+  }
+}
+
+/**
+  Create the GCD maps the way CoreInitializeGcdServices () does, each with a
+  single nonexistent entry that covers its address space.
+
+  @param[in]  Context  Unit test case context
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+GcdMapSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_GCD_MAP_ENTRY  *Entry;
+
+  if (!IsListEmpty (&mGcdMemorySpaceMap)) {
+    return UNIT_TEST_PASSED;
+  }
+
+  Entry = AllocateCopyPool (sizeof (EFI_GCD_MAP_ENTRY), &mGcdMemorySpaceMapEntryTemplate);
+  UT_ASSERT_NOT_NULL (Entry);
+  Entry->EndAddress = LShiftU64 (1, TEST_MEMORY_SPACE_BITS) - 1;
+  InsertHeadList (&mGcdMemorySpaceMap, &Entry->Link);
+  CoreGcdMapIndexInsert (&mGcdMemorySpaceMap, Entry);
+
+  Entry = AllocateCopyPool (sizeof (EFI_GCD_MAP_ENTRY), &mGcdIoSpaceMapEntryTemplate);
+  UT_ASSERT_NOT_NULL (Entry);
+  Entry->EndAddress = LShiftU64 (1, TEST_IO_SPACE_BITS) - 1;
+  InsertHeadList (&mGcdIoSpaceMap, &Entry->Link);
+  CoreGcdMapIndexInsert (&mGcdIoSpaceMap, Entry);
+
+  UT_ASSERT_TRUE (CheckIndex (&mGcdMemorySpaceMapIndex, &mGcdMemorySpaceMap));
+  UT_ASSERT_TRUE (CheckIndex (&mGcdIoSpaceMapIndex, &mGcdIoSpaceMap));
+  return UNIT_TEST_PASSED;
+}
+
+/// === TEST CASES =================================================================================
+
+/**
+  Change the GCD maps at random, and compare CoreSearchGcdMapEntry () with the
+  linear walks of the maps after each step.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+IndexMatchesLinearSearch (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN  Iteration;
+
+  for (Iteration = 0; Iteration < STRESS_ITERATIONS; Iteration++) {
+    switch (TestRandom () % 8) {
+      case 0:
+        UT_ASSERT_TRUE (FreeRandomAllocation ());
+        break;
+      case 1:
+      case 2:
+        ChangeIoSpace ();
+        break;
+      default:
+        ChangeMemorySpace ();
+        break;
+    }
+
+    UT_ASSERT_TRUE (CompareSearches (&mGcdMemorySpaceMap, TEST_MEMORY_WINDOW, TEST_MEMORY_SPACE_BITS, STRESS_SEARCHES));
+    UT_ASSERT_TRUE (CompareSearches (&mGcdIoSpaceMap, TEST_IO_WINDOW, TEST_IO_SPACE_BITS, STRESS_SEARCHES));
+    if ((Iteration % 64) == 0) {
+      UT_ASSERT_TRUE (CheckIndex (&mGcdMemorySpaceMapIndex, &mGcdMemorySpaceMap));
+      UT_ASSERT_TRUE (CheckIndex (&mGcdIoSpaceMapIndex, &mGcdIoSpaceMap));
+    }
+  }
+
+  while (mAllocationCount > 0) {
+    UT_ASSERT_TRUE (FreeRandomAllocation ());
+  }
+
+  UT_ASSERT_TRUE (CheckIndex (&mGcdMemorySpaceMapIndex, &mGcdMemorySpaceMap));
+  UT_ASSERT_TRUE (CheckIndex (&mGcdIoSpaceMapIndex, &mGcdIoSpaceMap));
+  UT_ASSERT_TRUE (CompareSearches (&mGcdMemorySpaceMap, TEST_MEMORY_WINDOW, TEST_MEMORY_SPACE_BITS, STRESS_SEARCHES * 16));
+  UT_ASSERT_TRUE (CompareSearches (&mGcdIoSpaceMap, TEST_IO_WINDOW, TEST_IO_SPACE_BITS, STRESS_SEARCHES * 16));
+  UT_LOG_INFO (
+    "%Lu memory space entries, %Lu I/O space entries\n",
+    (UINT64)CoreCountGcdMapEntry (&mGcdMemorySpaceMap),
+    (UINT64)CoreCountGcdMapEntry (&mGcdIoSpaceMap)
+    );
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Fragment the GCD memory space map into thousands of entries, and report the
+  time of the searches for pages at the top of the fragmented range, through
+  CoreSearchGcdMapEntry () and through the linear walk of the map.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+SearchBenchmark (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_GCD_MEMORY_TYPE   Type;
+  EFI_PHYSICAL_ADDRESS  BaseAddress;
+  LIST_ENTRY            *StartLink;
+  LIST_ENTRY            *EndLink;
+  LIST_ENTRY            *ExpectedStartLink;
+  LIST_ENTRY            *ExpectedEndLink;
+  UINTN                 Index;
+  clock_t               Start;
+  clock_t               IndexTicks;
+  clock_t               LinearTicks;
+
+  //
+  // Adjacent entries of different types are not merged
+  //
+  for (Index = 0; Index < BENCHMARK_ENTRIES; Index++) {
+    Type = ((Index % 2) == 0) ? EfiGcdMemoryTypeReserved : EfiGcdMemoryTypeMemoryMappedIo;
+    UT_ASSERT_NOT_EFI_ERROR (CoreAddMemorySpace (Type, BENCHMARK_BASE + EFI_PAGES_TO_SIZE (Index), EFI_PAGE_SIZE, 0));
+  }
+
+  UT_ASSERT_TRUE (CheckIndex (&mGcdMemorySpaceMapIndex, &mGcdMemorySpaceMap));
+
+  CoreAcquireGcdMemoryLock ();
+  Start = clock ();
+  for (Index = 0; Index < BENCHMARK_SEARCHES; Index++) {
+    BaseAddress = BENCHMARK_BASE + EFI_PAGES_TO_SIZE (BENCHMARK_ENTRIES - 1 - Index % 64);
+    if (EFI_ERROR (CoreSearchGcdMapEntry (BaseAddress, EFI_PAGE_SIZE, &StartLink, &EndLink, &mGcdMemorySpaceMap))) {
+      break;
+    }
+  }
+
+  IndexTicks = clock () - Start;
+
+  Start = clock ();
+  for (Index = 0; Index < BENCHMARK_SEARCHES; Index++) {
+    BaseAddress = BENCHMARK_BASE + EFI_PAGES_TO_SIZE (BENCHMARK_ENTRIES - 1 - Index % 64);
+    if (EFI_ERROR (LinearSearchGcdMapEntry (BaseAddress, EFI_PAGE_SIZE, &ExpectedStartLink, &ExpectedEndLink, &mGcdMemorySpaceMap))) {
+      break;
+    }
+  }
+
+  LinearTicks = clock () - Start;
+  CoreReleaseGcdMemoryLock ();
+
+  UT_ASSERT_EQUAL (Index, BENCHMARK_SEARCHES);
+  UT_ASSERT_EQUAL ((UINTN)StartLink, (UINTN)ExpectedStartLink);
+  UT_ASSERT_EQUAL ((UINTN)EndLink, (UINTN)ExpectedEndLink);
+  UT_LOG_INFO (
+    "%Lu searches among %Lu entries: %Lu ms through the index, %Lu ms through the list\n",
+    (UINT64)BENCHMARK_SEARCHES,
+    (UINT64)CoreCountGcdMapEntry (&mGcdMemorySpaceMap),
+    (UINT64)IndexTicks * 1000 / CLOCKS_PER_SEC,
+    (UINT64)LinearTicks * 1000 / CLOCKS_PER_SEC
+    );
+
+  UT_ASSERT_TRUE (CompareSearches (&mGcdMemorySpaceMap, TEST_MEMORY_WINDOW, TEST_MEMORY_SPACE_BITS, STRESS_SEARCHES * 16));
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Main entry point to this unit test application.
+
+  Sets up and runs the test suites.
+**/
+VOID
+EFIAPI
+UnitTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      GcdMapTests;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  //
+  // Start setting up the test framework for running the tests.
+  //
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  //
+  // Add all test suites and tests.
+  //
+  Status = CreateUnitTestSuite (
+             &GcdMapTests,
+             Framework,
+             "DXE Core GCD Map Index Tests",
+             "DxeCore.GcdMap",
+             NULL,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for GcdMapTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (
+    GcdMapTests,
+    "Searches of the index should match the linear walks of the GCD maps",
+    "Stress",
+    IndexMatchesLinearSearch,
+    GcdMapSetup,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    GcdMapTests,
+    "Time the search of a fragmented GCD memory space map",
+    "Benchmark",
+    SearchBenchmark,
+    GcdMapSetup,
+    NULL,
+    NULL
+    );
+
+  //
+  // Execute the tests.
+  //
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return;
+}
+
+///
+/// Avoid ECC error for function name that starts with lower case letter
+///
+#define Main  main
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+
+  @param[in] Argc  Number of arguments
+  @param[in] Argv  Array of pointers to arguments
+
+  @retval 0      Success
+  @retval other  Error
+**/
+INT32
+Main (
+  IN INT32  Argc,
+  IN CHAR8  *Argv[]
+  )
+{
+  UnitTestMain ();
+  return 0;
+}
@@ -0,0 +1,1200 @@
+/** @file
+  This is a host-based unit test and benchmark for the address index of the
+  memory map of the DXE Core (PcdDxeMemoryMapIndexEnable).
+
+  A buffer taken from the host is added to the memory map, and random pages
+  are allocated and freed through CoreInternalAllocatePages () and
+  CoreInternalFreePages (). After each step, the searches of the index are
+  compared with the linear walks of gMemoryMap they replace: the search for
+  free pages with a copy of the original loop of CoreFindFreePagesI (), with
+  and without NeedGuard, and the lookup of an address with a walk of the list.
+  The shape of the index is checked against gMemoryMap as well.
+
+  The heap guard is modeled by a set of guard pages that changes at random, so
+  that AdjustMemoryS () gives the same answers it gives in a guarded build.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <time.h>
+#include <cmocka.h>
+
+#include <Library/UnitTestLib.h>
+
+#include "../DxeMain.h"
+#include "../Mem/Imem.h"
+#include "../Mem/HeapGuard.h"
+
+#define UNIT_TEST_NAME     "DXE Core Memory Map Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// The number of pages taken from the host, and the number of chunks they are
+// added to the memory map in
+//
+#define TEST_MEMORY_PAGES  16384
+#define TEST_CHUNK_PAGES   256
+
+//
+// The number of random allocations and frees, and the number of searches
+// compared after each of them
+//
+#define STRESS_ITERATIONS  20000
+#define STRESS_SEARCHES    8
+
+//
+// The number of searches timed by the benchmark
+//
+#define BENCHMARK_SEARCHES  20000
+#define BENCHMARK_PAGES     128
+
+typedef struct {
+  EFI_PHYSICAL_ADDRESS    Memory;
+  UINTN                   NumberOfPages;
+} TEST_ALLOCATION;
+
+//
+// mTestMemory      - The buffer taken from the host
+// mTestMemoryEnd   - The last byte of mTestMemory
+// mGuardPage       - The pages of mTestMemory that are modeled as guard pages
+// mAllocations     - The live allocations of the stress test
+// mAllocationCount - The number of entries of mAllocations
+// mRandomSeed      - State of the random generator
+//
+EFI_PHYSICAL_ADDRESS  mTestMemory;
+EFI_PHYSICAL_ADDRESS  mTestMemoryEnd;
+BOOLEAN               mGuardPage[TEST_MEMORY_PAGES];
+TEST_ALLOCATION       mAllocations[4096];
+UINTN                 mAllocationCount;
+UINT32                mRandomSeed = 0x1234567;
+
+extern ADDRESS_INDEX  mMemoryMapIndex;
+
+/**
+  Internal function. Finds a consecutive free page range below
+  the requested address.
+
+  @param  MaxAddress             The address that the range must be below
+  @param  MinAddress             The address that the range must be above
+  @param  NumberOfPages          Number of pages needed
+  @param  NewType                The type of memory the range is going to be
+                                 turned into
+  @param  Alignment              Bits to align with
+  @param  NeedGuard              Flag to indicate Guard page is needed or not
+
+  @return The base address of the range, or 0 if the range was not found
+
+**/
+UINT64
+CoreFindFreePagesI (
+  IN UINT64           MaxAddress,
+  IN UINT64           MinAddress,
+  IN UINT64           NumberOfPages,
+  IN EFI_MEMORY_TYPE  NewType,
+  IN UINTN            Alignment,
+  IN BOOLEAN          NeedGuard
+  );
+
+/**
+  Frees previous allocated pages.
+
+  @param  Memory                 Base address of memory being freed
+  @param  NumberOfPages          The number of pages to free
+  @param  MemoryType             Pointer to memory type
+
+  @retval EFI_NOT_FOUND          Could not find the entry that covers the range
+  @retval EFI_INVALID_PARAMETER  Address not aligned
+  @return EFI_SUCCESS         -Pages successfully freed.
+
+**/
+EFI_STATUS
+EFIAPI
+CoreInternalFreePages (
+  IN EFI_PHYSICAL_ADDRESS  Memory,
+  IN UINTN                 NumberOfPages,
+  OUT EFI_MEMORY_TYPE      *MemoryType OPTIONAL
+  );
+
+EFI_HANDLE                                 gDxeCoreImageHandle = NULL;
+EFI_LOAD_FIXED_ADDRESS_CONFIGURATION_TABLE  gLoadModuleAtFixAddressConfigurationTable;
+LIST_ENTRY                                 mGcdMemorySpaceMap = INITIALIZE_LIST_HEAD_VARIABLE (mGcdMemorySpaceMap);
+BOOLEAN                                    mOnGuarding        = FALSE;
+
+/// === STUBS ======================================================================================
+
+/**
+  Acquire a lock. The tests run on a single thread at a single TPL.
+
+  @param  Lock               The lock to acquire
+
+**/
+VOID
+CoreAcquireLock (
+  IN EFI_LOCK  *Lock
+  )
+{
+  ASSERT (Lock->Lock == EfiLockReleased);
+  Lock->Lock = EfiLockAcquired;
+}
+
+/**
+  Release a lock.
+
+  @param  Lock               The lock to release
+
+**/
+VOID
+CoreReleaseLock (
+  IN EFI_LOCK  *Lock
+  )
+{
+  ASSERT (Lock->Lock == EfiLockAcquired);
+  Lock->Lock = EfiLockReleased;
+}
+
+/**
+  The GCD memory space map is empty in the tests.
+
+**/
+VOID
+CoreAcquireGcdMemoryLock (
+  VOID
+  )
+{
+}
+
+/**
+  The GCD memory space map is empty in the tests.
+
+**/
+VOID
+CoreReleaseGcdMemoryLock (
+  VOID
+  )
+{
+}
+
+/**
+  The GCD memory space map is empty in the tests.
+
+  @param  BaseAddress            Start address of the segment
+  @param  Descriptor             Descriptor of the segment
+
+  @return EFI_NOT_FOUND.
+
+**/
+EFI_STATUS
+EFIAPI
+CoreGetMemorySpaceDescriptor (
+  IN  EFI_PHYSICAL_ADDRESS             BaseAddress,
+  OUT EFI_GCD_MEMORY_SPACE_DESCRIPTOR  *Descriptor
+  )
+{
+  return EFI_NOT_FOUND;
+}
+
+/**
+  No event is signaled by the tests.
+
+  @param  EventGroup             The list to signal
+
+**/
+VOID
+CoreNotifySignalList (
+  IN EFI_GUID  *EventGroup
+  )
+{
+}
+
+/**
+  The heap guard is not enabled by the tests.
+
+  @param[in]  GuardType   Specify the sub-type(s) of Heap Guard.
+
+  @return FALSE.
+
+**/
+BOOLEAN
+IsHeapGuardEnabled (
+  UINT8  GuardType
+  )
+{
+  return FALSE;
+}
+
+/**
+  The heap guard is not enabled by the tests.
+
+  @param[in]  MemoryType      Memory type to check.
+  @param[in]  AllocateType    Allocation type to check.
+
+  @return FALSE.
+
+**/
+BOOLEAN
+IsPageTypeToGuard (
+  IN EFI_MEMORY_TYPE    MemoryType,
+  IN EFI_ALLOCATE_TYPE  AllocateType
+  )
+{
+  return FALSE;
+}
+
+/**
+  The heap guard is not enabled by the tests.
+
+  @param[in]  Address     The address to check for.
+
+  @return FALSE.
+
+**/
+BOOLEAN
+EFIAPI
+IsMemoryGuarded (
+  IN EFI_PHYSICAL_ADDRESS  Address
+  )
+{
+  return FALSE;
+}
+
+/**
+  Not used by the tests: pages are not allocated with NeedGuard.
+
+  @param[in]  Start           Start address of memory to allocate or free.
+  @param[in]  NumberOfPages   Memory size in pages.
+  @param[in]  NewType         The type of memory the pages being converted to.
+
+  @return EFI_UNSUPPORTED.
+
+**/
+EFI_STATUS
+CoreConvertPagesWithGuard (
+  IN UINT64           Start,
+  IN UINTN            NumberOfPages,
+  IN EFI_MEMORY_TYPE  NewType
+  )
+{
+  ASSERT (FALSE);
+  return EFI_UNSUPPORTED;
+}
+
+/**
+  Not used by the tests: pages are not allocated with NeedGuard.
+
+  @param[in]  Memory          Base address of memory to set guard for.
+  @param[in]  NumberOfPages   Memory size in pages.
+
+**/
+VOID
+SetGuardForMemory (
+  IN EFI_PHYSICAL_ADDRESS  Memory,
+  IN UINTN                 NumberOfPages
+  )
+{
+  ASSERT (FALSE);
+}
+
+/**
+  The freed memory guard is not enabled by the tests.
+
+  @param[out]  StartAddress   Start address of promoted memory.
+  @param[out]  EndAddress     End address of promoted memory.
+
+  @return FALSE.
+
+**/
+BOOLEAN
+PromoteGuardedFreePages (
+  OUT EFI_PHYSICAL_ADDRESS  *StartAddress,
+  OUT EFI_PHYSICAL_ADDRESS  *EndAddress
+  )
+{
+  return FALSE;
+}
+
+/**
+  The freed memory guard is not enabled by the tests.
+
+  @param[in]  BaseAddress     Base address of just freed pages.
+  @param[in]  Pages           Number of freed pages.
+
+**/
+VOID
+EFIAPI
+GuardFreedPagesChecked (
+  IN  EFI_PHYSICAL_ADDRESS  BaseAddress,
+  IN  UINTN                 Pages
+  )
+{
+}
+
+/**
+  The heap guard is not enabled by the tests.
+
+**/
+VOID
+EFIAPI
+DumpGuardedMemoryBitmap (
+  VOID
+  )
+{
+}
+
+/**
+  The memory map is not returned by the tests.
+
+  @param[in,out]  MemoryMap              A pointer to the buffer of the memory map.
+  @param[in,out]  MemoryMapSize          A pointer to the size of the memory map.
+  @param[in]      DescriptorSize         Size of an individual descriptor.
+
+**/
+VOID
+MergeMemoryMap (
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN OUT UINTN                  *MemoryMapSize,
+  IN UINTN                      DescriptorSize
+  )
+{
+}
+
+/**
+  Check the set of pages of the test that are modeled as guard pages.
+
+  @param[in]  Address     The address to check for.
+
+  @return TRUE if the page at Address is modeled as a guard page.
+
+**/
+STATIC
+BOOLEAN
+IsTestGuardPage (
+  IN EFI_PHYSICAL_ADDRESS  Address
+  )
+{
+  if ((Address < mTestMemory) || (Address > mTestMemoryEnd)) {
+    return FALSE;
+  }
+
+  return mGuardPage[(Address - mTestMemory) >> EFI_PAGE_SHIFT];
+}
+
+/**
+  Adjust address of free memory according to existing and/or required Guard.
+  This is the logic of the heap guard, with the guard pages of the test.
+
+  @param[in]  Start           Start address of free memory block.
+  @param[in]  Size            Size of free memory block.
+  @param[in]  SizeRequested   Size of memory to allocate.
+
+  @return The end address of memory block found.
+  @return 0 if no enough space for the required size of memory and its Guard.
+**/
+UINT64
+AdjustMemoryS (
+  IN UINT64  Start,
+  IN UINT64  Size,
+  IN UINT64  SizeRequested
+  )
+{
+  UINT64  Target;
+
+  if ((PcdGet8 (PcdHeapGuardPropertyMask) & BIT7) == 0) {
+    SizeRequested = ALIGN_VALUE (SizeRequested, 8);
+  }
+
+  Target = Start + Size - SizeRequested;
+  ASSERT (Target >= Start);
+  if (Target == 0) {
+    return 0;
+  }
+
+  if (!IsTestGuardPage (Start + Size)) {
+    Target -= EFI_PAGES_TO_SIZE (1);
+  }
+
+  if (Target < Start) {
+    return 0;
+  }
+
+  if (Target == Start) {
+    if (!IsTestGuardPage (Target - EFI_PAGES_TO_SIZE (1))) {
+      return 0;
+    }
+  }
+
+  return Target + SizeRequested - 1;
+}
+
+/**
+  The host pages are not protected.
+
+  @param[in]  OldType     Memory type of the memory range
+  @param[in]  NewType     New memory type of the memory range
+  @param[in]  Memory      Base address of the memory range
+  @param[in]  Length      Length of the memory range
+
+  @return EFI_SUCCESS.
+
+**/
+EFI_STATUS
+EFIAPI
+ApplyMemoryProtectionPolicy (
+  IN  EFI_MEMORY_TYPE       OldType,
+  IN  EFI_MEMORY_TYPE       NewType,
+  IN  EFI_PHYSICAL_ADDRESS  Memory,
+  IN  UINT64                Length
+  )
+{
+  return EFI_SUCCESS;
+}
+
+/**
+  The memory profile is not recorded by the tests.
+
+  @param CallerAddress  Address of caller who call Allocate or Free.
+  @param Action         This Allocate or Free action.
+  @param MemoryType     Memory type.
+  @param Size           Buffer size.
+  @param Buffer         Buffer address.
+  @param ActionString   String for memory profile action.
+
+  @return EFI_SUCCESS.
+
+**/
+EFI_STATUS
+EFIAPI
+CoreUpdateProfile (
+  IN EFI_PHYSICAL_ADDRESS   CallerAddress,
+  IN MEMORY_PROFILE_ACTION  Action,
+  IN EFI_MEMORY_TYPE        MemoryType,
+  IN UINTN                  Size,
+  IN VOID                   *Buffer,
+  IN CHAR8                  *ActionString OPTIONAL
+  )
+{
+  return EFI_SUCCESS;
+}
+
+/**
+  The memory attributes table is not installed by the tests.
+
+  @param MemoryType  Memory type of the allocation.
+
+**/
+VOID
+InstallMemoryAttributesTableOnMemoryAllocation (
+  IN EFI_MEMORY_TYPE  MemoryType
+  )
+{
+}
+
+/// === HELPERS ====================================================================================
+
+/**
+  Get the next number of the random generator of the tests.
+
+  @return A random number.
+
+**/
+STATIC
+UINT32
+TestRandom (
+  VOID
+  )
+{
+  mRandomSeed ^= mRandomSeed << 13;
+  mRandomSeed ^= mRandomSeed >> 17;
+  mRandomSeed ^= mRandomSeed << 5;
+  return mRandomSeed;
+}
+
+/**
+  The search for free pages of CoreFindFreePagesI () as it was before the
+  index, a walk of all the entries of gMemoryMap.
+
+  @param  MaxAddress             The address that the range must be below
+  @param  MinAddress             The address that the range must be above
+  @param  NumberOfPages          Number of pages needed
+  @param  Alignment              Bits to align with
+  @param  NeedGuard              Flag to indicate Guard page is needed or not
+
+  @return The base address of the range, or 0 if the range was not found
+
+**/
+STATIC
+UINT64
+LinearFindFreePages (
+  IN UINT64   MaxAddress,
+  IN UINT64   MinAddress,
+  IN UINT64   NumberOfPages,
+  IN UINTN    Alignment,
+  IN BOOLEAN  NeedGuard
+  )
+{
+  UINT64      NumberOfBytes;
+  UINT64      Target;
+  UINT64      DescStart;
+  UINT64      DescEnd;
+  UINT64      DescNumberOfBytes;
+  LIST_ENTRY  *Link;
+  MEMORY_MAP  *Entry;
+
+  if ((MaxAddress < EFI_PAGE_MASK) || (NumberOfPages == 0)) {
+    return 0;
+  }
+
+  if ((MaxAddress & EFI_PAGE_MASK) != EFI_PAGE_MASK) {
+    MaxAddress -= (EFI_PAGE_MASK + 1);
+    MaxAddress &= ~(UINT64)EFI_PAGE_MASK;
+    MaxAddress |= EFI_PAGE_MASK;
+  }
+
+  NumberOfBytes = LShiftU64 (NumberOfPages, EFI_PAGE_SHIFT);
+  Target        = 0;
+
+  for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
+    Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
+
+    if (Entry->Type != EfiConventionalMemory) {
+      continue;
+    }
+
+    DescStart = Entry->Start;
+    DescEnd   = Entry->End;
+
+    if ((DescStart >= MaxAddress) || (DescEnd < MinAddress)) {
+      continue;
+    }
+
+    if (DescEnd >= MaxAddress) {
+      DescEnd = MaxAddress;
+    }
+
+    DescEnd = ((DescEnd + 1) & (~(Alignment - 1))) - 1;
+
+    if (DescEnd < DescStart) {
+      continue;
+    }
+
+    DescNumberOfBytes = DescEnd - DescStart + 1;
+
+    if (DescNumberOfBytes >= NumberOfBytes) {
+      if ((DescEnd - NumberOfBytes + 1) < MinAddress) {
+        continue;
+      }
+
+      if (DescEnd > Target) {
+        if (NeedGuard) {
+          DescEnd = AdjustMemoryS (
+                      DescEnd + 1 - DescNumberOfBytes,
+                      DescNumberOfBytes,
+                      NumberOfBytes
+                      );
+          if (DescEnd == 0) {
+            continue;
+          }
+        }
+
+        Target = DescEnd;
+      }
+    }
+  }
+
+  Target -= NumberOfBytes - 1;
+
+  if ((Target & EFI_PAGE_MASK) != 0) {
+    return 0;
+  }
+
+  return Target;
+}
+
+/**
+  Find the entry of gMemoryMap that contains an address by walking the list.
+
+  @param  Address                The address to look up.
+
+  @return The memory map entry, or NULL if no entry contains Address.
+
+**/
+STATIC
+MEMORY_MAP *
+LinearFind (
+  IN UINT64  Address
+  )
+{
+  LIST_ENTRY  *Link;
+  MEMORY_MAP  *Entry;
+
+  for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
+    Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
+    if ((Entry->Start <= Address) && (Entry->End >= Address)) {
+      return Entry;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Check a subtree of the index: the entries are in address order, the
+  priorities form a heap, and the largest free size of each subtree is right.
+
+  @param  Node                   The root of the subtree.
+  @param  Previous               The entry before the subtree in address order.
+  @param  Count                  Incremented by the number of nodes.
+  @param  MaxFreeBytes           Returns the largest free size of the subtree.
+
+  @retval TRUE                   The subtree is valid.
+  @retval FALSE                  The subtree is not valid.
+
+**/
+STATIC
+BOOLEAN
+CheckIndexNode (
+  IN     ADDRESS_INDEX_NODE  *Node,
+  IN OUT MEMORY_MAP          **Previous,
+  IN OUT UINTN               *Count,
+  OUT    UINT64              *MaxFreeBytes
+  )
+{
+  MEMORY_MAP  *Entry;
+  UINT64      LeftBytes;
+  UINT64      RightBytes;
+
+  *MaxFreeBytes = 0;
+  if (Node == NULL) {
+    return TRUE;
+  }
+
+  Entry = BASE_CR (Node, MEMORY_MAP, IndexNode);
+
+  if ((Node->Left != NULL) && (Node->Left->Priority > Node->Priority)) {
+    return FALSE;
+  }
+
+  if ((Node->Right != NULL) && (Node->Right->Priority > Node->Priority)) {
+    return FALSE;
+  }
+
+  if (!CheckIndexNode (Node->Left, Previous, Count, &LeftBytes)) {
+    return FALSE;
+  }
+
+  if ((Entry->Signature != MEMORY_MAP_SIGNATURE) || (Entry->Start > Entry->End) || (Node->Key != Entry->Start)) {
+    return FALSE;
+  }
+
+  if ((*Previous != NULL) && ((*Previous)->End >= Entry->Start)) {
+    return FALSE;
+  }
+
+  *Previous = Entry;
+  (*Count)++;
+
+  if (!CheckIndexNode (Node->Right, Previous, Count, &RightBytes)) {
+    return FALSE;
+  }
+
+  *MaxFreeBytes = MAX (LeftBytes, RightBytes);
+  if (Entry->Type == EfiConventionalMemory) {
+    *MaxFreeBytes = MAX (*MaxFreeBytes, Entry->End - Entry->Start + 1);
+  }
+
+  return (BOOLEAN)(Entry->MaxFreeBytes == *MaxFreeBytes);
+}
+
+/**
+  Check that the index holds exactly the entries of gMemoryMap, and that its
+  shape is valid.
+
+  @retval TRUE                   The index is valid.
+  @retval FALSE                  The index is not valid.
+
+**/
+STATIC
+BOOLEAN
+CheckIndex (
+  VOID
+  )
+{
+  LIST_ENTRY  *Link;
+  MEMORY_MAP  *Entry;
+  MEMORY_MAP  *Previous;
+  UINTN       IndexCount;
+  UINTN       ListCount;
+  UINT64      MaxFreeBytes;
+  BOOLEAN     Valid;
+
+  CoreAcquireMemoryLock ();
+
+  Previous   = NULL;
+  IndexCount = 0;
+  Valid      = CheckIndexNode (mMemoryMapIndex.Root, &Previous, &IndexCount, &MaxFreeBytes);
+
+  ListCount = 0;
+  for (Link = gMemoryMap.ForwardLink; Valid && (Link != &gMemoryMap); Link = Link->ForwardLink) {
+    Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
+    Valid = (BOOLEAN)(CoreMemoryMapIndexFind (Entry->Start) == Entry);
+    ListCount++;
+  }
+
+  CoreReleaseMemoryLock ();
+
+  return (BOOLEAN)(Valid && (IndexCount == ListCount));
+}
+
+/**
+  Compare random searches of the index with the linear walks of gMemoryMap.
+
+  @param  Searches               The number of searches to compare.
+
+  @retval TRUE                   All the searches match.
+  @retval FALSE                  A search does not match.
+
+**/
+STATIC
+BOOLEAN
+CompareSearches (
+  IN UINTN  Searches
+  )
+{
+  STATIC CONST UINTN    Alignments[] = { EFI_PAGE_SIZE, SIZE_64KB, SIZE_2MB };
+  STATIC CONST UINT32   PageLimits[] = { 4, 64, 1024 };
+  UINT64                MaxAddress;
+  UINT64                MinAddress;
+  UINT64                NumberOfPages;
+  UINTN                 Alignment;
+  BOOLEAN               NeedGuard;
+  EFI_PHYSICAL_ADDRESS  Address;
+  UINT64                Expected;
+  UINT64                Found;
+  UINTN                 Index;
+
+  for (Index = 0; Index < Searches; Index++) {
+    if ((TestRandom () % 8) == 0) {
+      MaxAddress = MAX_ALLOC_ADDRESS;
+    } else {
+      MaxAddress = mTestMemory + TestRandom () % (mTestMemoryEnd - mTestMemory + 1 + EFI_PAGE_SIZE);
+    }
+
+    MinAddress = 0;
+    if ((TestRandom () % 2) == 0) {
+      MinAddress = mTestMemory + TestRandom () % (mTestMemoryEnd - mTestMemory + 1);
+      MinAddress = MIN (MinAddress, MaxAddress) & ~(UINT64)EFI_PAGE_MASK;
+    }
+
+    NumberOfPages = PageLimits[TestRandom () % ARRAY_SIZE (PageLimits)];
+    NumberOfPages = 1 + TestRandom () % NumberOfPages;
+    Alignment     = Alignments[TestRandom () % ARRAY_SIZE (Alignments)];
+    NeedGuard     = (BOOLEAN)(TestRandom () % 2);
+
+    CoreAcquireMemoryLock ();
+    Expected = LinearFindFreePages (MaxAddress, MinAddress, NumberOfPages, Alignment, NeedGuard);
+    Found    = CoreFindFreePagesI (MaxAddress, MinAddress, NumberOfPages, EfiBootServicesData, Alignment, NeedGuard);
+    CoreReleaseMemoryLock ();
+    if (Found != Expected) {
+      UT_LOG_ERROR (
+        "Search Max=%Lx Min=%Lx Pages=%Lx Alignment=%Lx NeedGuard=%d found %Lx instead of %Lx\n",
+        MaxAddress,
+        MinAddress,
+        NumberOfPages,
+        (UINT64)Alignment,
+        NeedGuard,
+        Found,
+        Expected
+        );
+      return FALSE;
+    }
+
+    Address = mTestMemory + TestRandom () % (mTestMemoryEnd - mTestMemory + 1);
+    CoreAcquireMemoryLock ();
+    Found    = (UINTN)CoreMemoryMapIndexFind (Address);
+    Expected = (UINTN)LinearFind (Address);
+    CoreReleaseMemoryLock ();
+    if (Found != Expected) {
+      UT_LOG_ERROR ("Lookup of %Lx does not match the memory map\n", Address);
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/**
+  Change the pages that are modeled as guard pages.
+
+**/
+STATIC
+VOID
+ShuffleGuardPages (
+  VOID
+  )
+{
+  UINTN  Index;
+  UINTN  Page;
+
+  for (Index = 0; Index < 64; Index++) {
+    Page             = TestRandom () % TEST_MEMORY_PAGES;
+    mGuardPage[Page] = (BOOLEAN)((TestRandom () % 4) == 0);
+  }
+}
+
+/**
+  Allocate pages at random for the stress test, and record them.
+
+**/
+STATIC
+VOID
+AllocateRandomPages (
+  VOID
+  )
+{
+  STATIC CONST EFI_MEMORY_TYPE  Types[] = {
+    EfiBootServicesData,
+    EfiBootServicesCode,
+    EfiLoaderData,
+    EfiRuntimeServicesData,
+    EfiACPIReclaimMemory
+  };
+  EFI_ALLOCATE_TYPE             Type;
+  EFI_PHYSICAL_ADDRESS          Memory;
+  UINTN                         NumberOfPages;
+  EFI_STATUS                    Status;
+
+  NumberOfPages = ((TestRandom () % 8) == 0) ? 512 : 16;
+  NumberOfPages = 1 + TestRandom () % NumberOfPages;
+  Memory        = 0;
+  switch (TestRandom () % 4) {
+    case 0:
+      Type   = AllocateMaxAddress;
+      Memory = mTestMemory + TestRandom () % (mTestMemoryEnd - mTestMemory + 1);
+      break;
+    case 1:
+      Type   = AllocateAddress;
+      Memory = mTestMemory + EFI_PAGES_TO_SIZE (TestRandom () % TEST_MEMORY_PAGES);
+      break;
+    default:
+      Type = AllocateAnyPages;
+      break;
+  }
+
+  Status = CoreInternalAllocatePages (Type, Types[TestRandom () % ARRAY_SIZE (Types)], NumberOfPages, &Memory, FALSE);
+  if (!EFI_ERROR (Status)) {
+    mAllocations[mAllocationCount].Memory        = Memory;
+    mAllocations[mAllocationCount].NumberOfPages = NumberOfPages;
+    mAllocationCount++;
+  }
+}
+
+/**
+  Free one of the pages of the stress test at random.
+
+  @retval TRUE                   The pages were freed.
+  @retval FALSE                  The pages could not be freed.
+
+**/
+STATIC
+BOOLEAN
+FreeRandomPages (
+  VOID
+  )
+{
+  UINTN  Index;
+
+  if (mAllocationCount == 0) {
+    return TRUE;
+  }
+
+  Index = TestRandom () % mAllocationCount;
+  if (EFI_ERROR (CoreInternalFreePages (mAllocations[Index].Memory, mAllocations[Index].NumberOfPages, NULL))) {
+    return FALSE;
+  }
+
+  mAllocations[Index] = mAllocations[--mAllocationCount];
+  return TRUE;
+}
+
+/**
+  Take the memory of the tests from the host and add it to the memory map.
+  The chunks are added out of order, and some of them are not free memory.
+
+  @param[in]  Context  Unit test case context
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+MemoryMapSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN            Chunks;
+  UINTN            Index;
+  UINTN            Chunk;
+  EFI_MEMORY_TYPE  Type;
+
+  if (mTestMemory != 0) {
+    return UNIT_TEST_PASSED;
+  }
+
+  mTestMemory = (EFI_PHYSICAL_ADDRESS)(UINTN)AllocateAlignedPages (TEST_MEMORY_PAGES, SIZE_2MB);
+  UT_ASSERT_NOT_EQUAL (mTestMemory, 0);
+  mTestMemoryEnd = mTestMemory + EFI_PAGES_TO_SIZE (TEST_MEMORY_PAGES) - 1;
+
+  Chunks = TEST_MEMORY_PAGES / TEST_CHUNK_PAGES;
+  for (Index = 0; Index < Chunks; Index++) {
+    Chunk = (Index * 37) % Chunks;
+    if ((Chunk % 7) == 3) {
+      Type = EfiReservedMemoryType;
+    } else if ((Chunk % 11) == 5) {
+      Type = EfiMemoryMappedIO;
+    } else {
+      Type = EfiConventionalMemory;
+    }
+
+    CoreAddMemoryDescriptor (Type, mTestMemory + EFI_PAGES_TO_SIZE (Chunk * TEST_CHUNK_PAGES), TEST_CHUNK_PAGES, 0);
+  }
+
+  UT_ASSERT_TRUE (CheckIndex ());
+  return UNIT_TEST_PASSED;
+}
+
+/// === TEST CASES =================================================================================
+
+/**
+  Allocate and free pages at random, and compare the searches of the index
+  with the linear walks of gMemoryMap after each step.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+IndexMatchesLinearSearch (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN  Iteration;
+
+  UT_ASSERT_TRUE (CompareSearches (STRESS_SEARCHES));
+
+  for (Iteration = 0; Iteration < STRESS_ITERATIONS; Iteration++) {
+    ShuffleGuardPages ();
+    if ((mAllocationCount < ARRAY_SIZE (mAllocations)) && ((TestRandom () % 16) < 9)) {
+      AllocateRandomPages ();
+    } else {
+      UT_ASSERT_TRUE (FreeRandomPages ());
+    }
+
+    UT_ASSERT_TRUE (CompareSearches (STRESS_SEARCHES));
+    if ((Iteration % 64) == 0) {
+      UT_ASSERT_TRUE (CheckIndex ());
+    }
+  }
+
+  UT_ASSERT_TRUE (CheckIndex ());
+
+  while (mAllocationCount > 0) {
+    UT_ASSERT_TRUE (FreeRandomPages ());
+  }
+
+  UT_ASSERT_TRUE (CheckIndex ());
+  UT_ASSERT_TRUE (CompareSearches (STRESS_SEARCHES * 16));
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Fragment the memory map into thousands of entries, and report the time of a
+  search for a range that only fits at the bottom of the memory, through the
+  index and through the linear walk of gMemoryMap.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+SearchBenchmark (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_PHYSICAL_ADDRESS  Memory;
+  EFI_PHYSICAL_ADDRESS  Bottom;
+  UINTN                 Entries;
+  UINTN                 Index;
+  UINT64                Expected;
+  UINT64                Found;
+  clock_t               Start;
+  clock_t               IndexTicks;
+  clock_t               LinearTicks;
+
+  //
+  // Keep a free range at the bottom, and allocate the rest one page at a time
+  // with alternating types, freeing every fourth page
+  //
+  Bottom = mTestMemory;
+  UT_ASSERT_NOT_EFI_ERROR (CoreInternalAllocatePages (AllocateAddress, EfiBootServicesData, BENCHMARK_PAGES, &Bottom, FALSE));
+  for (Index = 0; ; Index++) {
+    Memory = 0;
+    if (EFI_ERROR (CoreInternalAllocatePages (AllocateAnyPages, (Index % 2 == 0) ? EfiBootServicesData : EfiLoaderData, 1, &Memory, FALSE))) {
+      break;
+    }
+
+    if ((Index % 4) == 0) {
+      UT_ASSERT_NOT_EFI_ERROR (CoreInternalFreePages (Memory, 1, NULL));
+    }
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (CoreInternalFreePages (Bottom, BENCHMARK_PAGES, NULL));
+
+  Entries = 0;
+  for (Memory = mTestMemory; Memory < mTestMemoryEnd; Memory += EFI_PAGE_SIZE) {
+    CoreAcquireMemoryLock ();
+    if (CoreMemoryMapIndexFind (Memory) != CoreMemoryMapIndexFind (Memory - 1)) {
+      Entries++;
+    }
+
+    CoreReleaseMemoryLock ();
+  }
+
+  CoreAcquireMemoryLock ();
+  Expected = LinearFindFreePages (MAX_ALLOC_ADDRESS, 0, BENCHMARK_PAGES, EFI_PAGE_SIZE, FALSE);
+  UT_ASSERT_EQUAL (Expected, mTestMemory);
+
+  Start = clock ();
+  for (Index = 0; Index < BENCHMARK_SEARCHES; Index++) {
+    Found = CoreFindFreePagesI (MAX_ALLOC_ADDRESS, 0, BENCHMARK_PAGES, EfiBootServicesData, EFI_PAGE_SIZE, FALSE);
+    if (Found != Expected) {
+      break;
+    }
+  }
+
+  IndexTicks = clock () - Start;
+
+  Start = clock ();
+  for (Index = 0; Index < BENCHMARK_SEARCHES; Index++) {
+    Found = LinearFindFreePages (MAX_ALLOC_ADDRESS, 0, BENCHMARK_PAGES, EFI_PAGE_SIZE, FALSE);
+    if (Found != Expected) {
+      break;
+    }
+  }
+
+  LinearTicks = clock () - Start;
+  CoreReleaseMemoryLock ();
+
+  UT_ASSERT_EQUAL (Found, Expected);
+  UT_LOG_INFO (
+    "%Lu searches among about %Lu entries: %Lu ms through the index, %Lu ms through the list\n",
+    (UINT64)BENCHMARK_SEARCHES,
+    (UINT64)Entries,
+    (UINT64)IndexTicks * 1000 / CLOCKS_PER_SEC,
+    (UINT64)LinearTicks * 1000 / CLOCKS_PER_SEC
+    );
+
+  UT_ASSERT_TRUE (CheckIndex ());
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Main entry point to this unit test application.
+
+  Sets up and runs the test suites.
+**/
+VOID
+EFIAPI
+UnitTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      MemoryMapTests;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  //
+  // Start setting up the test framework for running the tests.
+  //
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  //
+  // Add all test suites and tests.
+  //
+  Status = CreateUnitTestSuite (
+             &MemoryMapTests,
+             Framework,
+             "DXE Core Memory Map Index Tests",
+             "DxeCore.MemoryMap",
+             NULL,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for MemoryMapTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (
+    MemoryMapTests,
+    "Searches of the index should match the linear walks of the memory map",
+    "Stress",
+    IndexMatchesLinearSearch,
+    MemoryMapSetup,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    MemoryMapTests,
+    "Time the search for free pages in a fragmented memory map",
+    "Benchmark",
+    SearchBenchmark,
+    MemoryMapSetup,
+    NULL,
+    NULL
+    );
+
+  //
+  // Execute the tests.
+  //
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return;
+}
+
+///
+/// Avoid ECC error for function name that starts with lower case letter
+///
+#define Main  main
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+
+  @param[in] Argc  Number of arguments
+  @param[in] Argv  Array of pointers to arguments
+
+  @retval 0      Success
+  @retval other  Error
+**/
+INT32
+Main (
+  IN INT32  Argc,
+  IN CHAR8  *Argv[]
+  )
+{
+  UnitTestMain ();
+  return 0;
+}
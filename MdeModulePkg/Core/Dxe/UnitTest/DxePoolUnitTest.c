@@ -0,0 +1,993 @@
+/** @file
+  This is a host-based unit test and benchmark for the pool allocator of the
+  DXE Core.
+
+  An allocation trace is replayed through CoreInternalAllocatePool () and
+  CoreInternalFreePool (). The pages are taken from the host, so the test can
+  report the throughput of the replay and the pool pages it leaves behind, and
+  check that no allocation overlaps another one.
+
+  The trace is a synthetic boot trace, unless the path of a serial log of a
+  DEBUG build with DEBUG_POOL messages enabled is given on the command line.
+  The "AllocatePoolI:" and "FreePool:" lines of that log are replayed then.
+
+  The test is built once in the default mode and once in slab mode
+  (PcdDxePoolSlabAllocatorEnable), so the numbers of both modes can be
+  compared.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <time.h>
+#include <cmocka.h>
+
+#include <Library/UnitTestLib.h>
+
+#include "../DxeMain.h"
+#include "../Mem/Imem.h"
+#include "../Mem/HeapGuard.h"
+
+#define UNIT_TEST_NAME     "DXE Core Pool Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// The number of allocations and frees of the synthetic boot trace
+//
+#define SYNTHETIC_TRACE_LENGTH  100000
+
+//
+// The pattern written to each allocation is derived from its trace ID.
+//
+#define TRACE_PATTERN(Id)  ((UINT8)((Id) * 131 + 7))
+
+//
+// The number of size classes of the pool, the entries of mPoolSizeTable
+//
+#define POOL_SIZE_CLASSES  12
+
+typedef struct {
+  EFI_MEMORY_TYPE    Type;
+  UINT32             Id;
+  UINTN              Size;
+  BOOLEAN            Free;
+} POOL_TRACE_RECORD;
+
+//
+// mTrace          - The trace that is replayed
+// mTraceLength    - The number of records of mTrace
+// mTraceIds       - The number of allocations of mTrace
+// mBuffer         - The buffer of each allocation while it is live
+// mTraceFile      - The serial log given on the command line, or NULL
+// mPagesHeld      - The pages the pool currently holds
+// mPagesPeak      - The largest value of mPagesHeld
+//
+POOL_TRACE_RECORD  *mTrace;
+UINTN              mTraceLength;
+UINTN              mTraceIds;
+VOID               **mBuffer;
+CHAR8              *mTraceFile;
+UINTN              mPagesHeld;
+UINTN              mPagesPeak;
+
+EFI_LOCK  gMemoryLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_NOTIFY);
+BOOLEAN   mOnGuarding = FALSE;
+
+/// === STUBS ======================================================================================
+
+/**
+  Acquire a lock. The tests run on a single thread at a single TPL.
+
+  @param  Lock               The lock to acquire
+
+**/
+VOID
+CoreAcquireLock (
+  IN EFI_LOCK  *Lock
+  )
+{
+  ASSERT (Lock->Lock == EfiLockReleased);
+  Lock->Lock = EfiLockAcquired;
+}
+
+/**
+  Acquire a lock, or fail if it is already owned.
+
+  @param  Lock               The lock to acquire
+
+  @retval EFI_SUCCESS        Lock Acquired
+  @retval EFI_ACCESS_DENIED  Failed to acquire the lock
+
+**/
+EFI_STATUS
+CoreAcquireLockOrFail (
+  IN EFI_LOCK  *Lock
+  )
+{
+  if (Lock->Lock == EfiLockAcquired) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  Lock->Lock = EfiLockAcquired;
+  return EFI_SUCCESS;
+}
+
+/**
+  Release a lock.
+
+  @param  Lock               The lock to release
+
+**/
+VOID
+CoreReleaseLock (
+  IN EFI_LOCK  *Lock
+  )
+{
+  ASSERT (Lock->Lock == EfiLockAcquired);
+  Lock->Lock = EfiLockReleased;
+}
+
+/**
+  Enter critical section by gaining lock on gMemoryLock.
+
+**/
+VOID
+CoreAcquireMemoryLock (
+  VOID
+  )
+{
+  CoreAcquireLock (&gMemoryLock);
+}
+
+/**
+  Exit critical section by releasing lock on gMemoryLock.
+
+**/
+VOID
+CoreReleaseMemoryLock (
+  VOID
+  )
+{
+  CoreReleaseLock (&gMemoryLock);
+}
+
+/**
+  Take the pool pages from the host, and account them.
+
+  @param  PoolType               The type of memory for the new pool pages
+  @param  NumberOfPages          No of pages to allocate
+  @param  Alignment              Bits to align.
+  @param  NeedGuard              Flag to indicate Guard page is needed or not
+
+  @return The allocated memory, or NULL
+
+**/
+VOID *
+CoreAllocatePoolPages (
+  IN EFI_MEMORY_TYPE  PoolType,
+  IN UINTN            NumberOfPages,
+  IN UINTN            Alignment,
+  IN BOOLEAN          NeedGuard
+  )
+{
+  VOID  *Buffer;
+
+  ASSERT (!NeedGuard);
+  Buffer = AllocateAlignedPages (NumberOfPages, Alignment);
+  if (Buffer != NULL) {
+    mPagesHeld += NumberOfPages;
+    mPagesPeak  = MAX (mPagesPeak, mPagesHeld);
+  }
+
+  return Buffer;
+}
+
+/**
+  Give the pool pages back to the host.
+
+  @param  Memory                 The base address to free
+  @param  NumberOfPages          The number of pages to free
+
+**/
+VOID
+CoreFreePoolPages (
+  IN EFI_PHYSICAL_ADDRESS  Memory,
+  IN UINTN                 NumberOfPages
+  )
+{
+  ASSERT (mPagesHeld >= NumberOfPages);
+  mPagesHeld -= NumberOfPages;
+  FreeAlignedPages ((VOID *)(UINTN)Memory, NumberOfPages);
+}
+
+/**
+  The heap guard is not enabled by the tests.
+
+  @param[in]  GuardType   Specify the sub-type(s) of Heap Guard.
+
+  @return FALSE.
+
+**/
+BOOLEAN
+IsHeapGuardEnabled (
+  UINT8  GuardType
+  )
+{
+  return FALSE;
+}
+
+/**
+  The heap guard is not enabled by the tests.
+
+  @param[in]  MemoryType      Pool type to check.
+
+  @return FALSE.
+
+**/
+BOOLEAN
+IsPoolTypeToGuard (
+  IN EFI_MEMORY_TYPE  MemoryType
+  )
+{
+  return FALSE;
+}
+
+/**
+  The heap guard is not enabled by the tests.
+
+  @param[in]  Address     The address to check for.
+
+  @return FALSE.
+
+**/
+BOOLEAN
+EFIAPI
+IsMemoryGuarded (
+  IN EFI_PHYSICAL_ADDRESS  Address
+  )
+{
+  return FALSE;
+}
+
+/**
+  Not used by the tests: the heap guard is not enabled.
+
+  @param[in]  Memory          Base address of memory to set guard for.
+  @param[in]  NumberOfPages   Memory size in pages.
+
+**/
+VOID
+SetGuardForMemory (
+  IN EFI_PHYSICAL_ADDRESS  Memory,
+  IN UINTN                 NumberOfPages
+  )
+{
+  ASSERT (FALSE);
+}
+
+/**
+  Not used by the tests: the heap guard is not enabled.
+
+  @param[in]  Memory          Base address of memory to unset guard for.
+  @param[in]  NumberOfPages   Memory size in pages.
+
+**/
+VOID
+UnsetGuardForMemory (
+  IN EFI_PHYSICAL_ADDRESS  Memory,
+  IN UINTN                 NumberOfPages
+  )
+{
+  ASSERT (FALSE);
+}
+
+/**
+  Not used by the tests: the heap guard is not enabled.
+
+  @param[in,out]  Memory          Base address of memory to free.
+  @param[in,out]  NumberOfPages   Size of memory to free.
+
+**/
+VOID
+AdjustMemoryF (
+  IN OUT EFI_PHYSICAL_ADDRESS  *Memory,
+  IN OUT UINTN                 *NumberOfPages
+  )
+{
+  ASSERT (FALSE);
+}
+
+/**
+  Not used by the tests: the heap guard is not enabled.
+
+  @param[in]    Memory    Base address of memory allocated.
+  @param[in]    NoPages   Number of pages actually allocated.
+  @param[in]    Size      Size of memory requested.
+
+  @return Memory.
+
+**/
+VOID *
+AdjustPoolHeadA (
+  IN EFI_PHYSICAL_ADDRESS  Memory,
+  IN UINTN                 NoPages,
+  IN UINTN                 Size
+  )
+{
+  ASSERT (FALSE);
+  return (VOID *)(UINTN)Memory;
+}
+
+/**
+  Not used by the tests: the heap guard is not enabled.
+
+  @param[in]    Memory    Base address of memory to free.
+
+  @return Memory.
+
+**/
+VOID *
+AdjustPoolHeadF (
+  IN EFI_PHYSICAL_ADDRESS  Memory
+  )
+{
+  ASSERT (FALSE);
+  return (VOID *)(UINTN)Memory;
+}
+
+/**
+  The freed memory guard is not enabled by the tests.
+
+  @param[in]  BaseAddress     Base address of just freed pages.
+  @param[in]  Pages           Number of freed pages.
+
+**/
+VOID
+EFIAPI
+GuardFreedPagesChecked (
+  IN  EFI_PHYSICAL_ADDRESS  BaseAddress,
+  IN  UINTN                 Pages
+  )
+{
+}
+
+/**
+  The host pages are not protected.
+
+  @param[in]  OldType     Memory type of the memory range
+  @param[in]  NewType     New memory type of the memory range
+  @param[in]  Memory      Base address of the memory range
+  @param[in]  Length      Length of the memory range
+
+  @return EFI_SUCCESS.
+
+**/
+EFI_STATUS
+EFIAPI
+ApplyMemoryProtectionPolicy (
+  IN  EFI_MEMORY_TYPE       OldType,
+  IN  EFI_MEMORY_TYPE       NewType,
+  IN  EFI_PHYSICAL_ADDRESS  Memory,
+  IN  UINT64                Length
+  )
+{
+  return EFI_SUCCESS;
+}
+
+/**
+  The memory profile is not recorded by the tests.
+
+  @param CallerAddress  Address of caller who call Allocate or Free.
+  @param Action         This Allocate or Free action.
+  @param MemoryType     Memory type.
+  @param Size           Buffer size.
+  @param Buffer         Buffer address.
+  @param ActionString   String for memory profile action.
+
+  @return EFI_SUCCESS.
+
+**/
+EFI_STATUS
+EFIAPI
+CoreUpdateProfile (
+  IN EFI_PHYSICAL_ADDRESS   CallerAddress,
+  IN MEMORY_PROFILE_ACTION  Action,
+  IN EFI_MEMORY_TYPE        MemoryType,
+  IN UINTN                  Size,
+  IN VOID                   *Buffer,
+  IN CHAR8                  *ActionString OPTIONAL
+  )
+{
+  return EFI_SUCCESS;
+}
+
+/**
+  The memory attributes table is not installed by the tests.
+
+  @param MemoryType  Memory type of the allocation.
+
+**/
+VOID
+InstallMemoryAttributesTableOnMemoryAllocation (
+  IN EFI_MEMORY_TYPE  MemoryType
+  )
+{
+}
+
+/// === HELPERS ====================================================================================
+
+/**
+  Append a record to the trace.
+
+  @param  Type                   The memory type of the allocation
+  @param  Id                     The ID of the allocation
+  @param  Size                   The size of the allocation
+  @param  Free                   TRUE for a free, FALSE for an allocation
+
+**/
+STATIC
+VOID
+AppendTraceRecord (
+  IN EFI_MEMORY_TYPE  Type,
+  IN UINTN            Id,
+  IN UINTN            Size,
+  IN BOOLEAN          Free
+  )
+{
+  mTrace[mTraceLength].Type = Type;
+  mTrace[mTraceLength].Id   = (UINT32)Id;
+  mTrace[mTraceLength].Size = Size;
+  mTrace[mTraceLength].Free = Free;
+  mTraceLength++;
+}
+
+/**
+  Make a synthetic boot trace. Most allocations are small boot services data,
+  like device paths and strings. One in eight of them is never freed, and the
+  others are freed in random order, with about two thousand of them live at a
+  time. Some are runtime or ACPI data, and a few are larger than a page.
+
+**/
+STATIC
+VOID
+MakeSyntheticTrace (
+  VOID
+  )
+{
+  UINT32           Seed;
+  UINT32           *Live;
+  UINTN            LiveCount;
+  UINTN            Pick;
+  UINTN            Size;
+  EFI_MEMORY_TYPE  Type;
+
+  mTrace = AllocatePool (SYNTHETIC_TRACE_LENGTH * sizeof (POOL_TRACE_RECORD));
+  Live   = AllocatePool (SYNTHETIC_TRACE_LENGTH * sizeof (UINT32));
+  ASSERT (mTrace != NULL && Live != NULL);
+
+  Seed         = 0x2545F491;
+  LiveCount    = 0;
+  mTraceLength = 0;
+  mTraceIds    = 0;
+  while (mTraceLength < SYNTHETIC_TRACE_LENGTH) {
+    Seed = Seed * 1103515245 + 12345;
+    if (((Seed >> 8) % 4096) < LiveCount) {
+      //
+      // Free one of the short lived allocations
+      //
+      Pick = (Seed >> 12) % LiveCount;
+      AppendTraceRecord (mTrace[Live[Pick]].Type, mTrace[Live[Pick]].Id, mTrace[Live[Pick]].Size, TRUE);
+      Live[Pick] = Live[--LiveCount];
+      continue;
+    }
+
+    Pick = (Seed >> 16) % 100;
+    if (Pick < 50) {
+      Size = 8 + (Seed >> 24) % 120;
+    } else if (Pick < 80) {
+      Size = 128 + (Seed >> 20) % 512;
+    } else if (Pick < 98) {
+      Size = 640 + (Seed >> 18) % 3456;
+    } else {
+      Size = 4096 + (Seed >> 14) % 16384;
+    }
+
+    Seed = Seed * 1103515245 + 12345;
+    Pick = (Seed >> 16) % 100;
+    if (Pick < 85) {
+      Type = EfiBootServicesData;
+    } else if (Pick < 95) {
+      Type = EfiRuntimeServicesData;
+    } else {
+      Type = EfiACPIReclaimMemory;
+    }
+
+    if (((Seed >> 8) % 8) != 0) {
+      Live[LiveCount++] = (UINT32)mTraceLength;
+    }
+
+    AppendTraceRecord (Type, mTraceIds++, Size, FALSE);
+  }
+
+  FreePool (Live);
+}
+
+/**
+  Read the trace from the "AllocatePoolI:" and "FreePool:" lines of a serial
+  log. The addresses of the log are only used to match each free with its
+  allocation.
+
+  @param  FileName               The path of the serial log
+
+  @retval TRUE                   The trace was read.
+  @retval FALSE                  The file could not be read.
+
+**/
+STATIC
+BOOLEAN
+ReadTraceFile (
+  IN CHAR8  *FileName
+  )
+{
+  FILE    *File;
+  CHAR8   Line[256];
+  CHAR8   *Message;
+  UINTN   Capacity;
+  UINTN   LiveCount;
+  UINTN   Index;
+  UINT32  Type;
+  UINT64  Address;
+  UINT64  Size;
+  UINT64  *LiveAddress;
+  UINT32  *LiveRecord;
+
+  File = fopen (FileName, "r");
+  if (File == NULL) {
+    return FALSE;
+  }
+
+  Capacity     = 4096;
+  mTrace       = AllocatePool (Capacity * sizeof (POOL_TRACE_RECORD));
+  LiveAddress  = AllocatePool (Capacity * sizeof (UINT64));
+  LiveRecord   = AllocatePool (Capacity * sizeof (UINT32));
+  LiveCount    = 0;
+  mTraceLength = 0;
+  mTraceIds    = 0;
+  while (fgets (Line, sizeof (Line), File) != NULL) {
+    if (mTraceLength == Capacity) {
+      mTrace      = ReallocatePool (Capacity * sizeof (POOL_TRACE_RECORD), 2 * Capacity * sizeof (POOL_TRACE_RECORD), mTrace);
+      LiveAddress = ReallocatePool (Capacity * sizeof (UINT64), 2 * Capacity * sizeof (UINT64), LiveAddress);
+      LiveRecord  = ReallocatePool (Capacity * sizeof (UINT32), 2 * Capacity * sizeof (UINT32), LiveRecord);
+      Capacity   *= 2;
+    }
+
+    Message = strstr (Line, "AllocatePoolI: ");
+    if ((Message != NULL) &&
+        (sscanf (Message, "AllocatePoolI: Type %x, Addr %llx (len %llx)", &Type, &Address, &Size) == 3))
+    {
+      LiveAddress[LiveCount] = Address;
+      LiveRecord[LiveCount]  = (UINT32)mTraceLength;
+      LiveCount++;
+      AppendTraceRecord ((EFI_MEMORY_TYPE)Type, mTraceIds++, (UINTN)Size, FALSE);
+      continue;
+    }
+
+    Message = strstr (Line, "FreePool: ");
+    if ((Message != NULL) &&
+        (sscanf (Message, "FreePool: %llx (len %llx)", &Address, &Size) == 2))
+    {
+      //
+      // Most frees are of recent allocations, so search from the end.
+      //
+      for (Index = LiveCount; Index > 0; Index--) {
+        if (LiveAddress[Index - 1] == Address) {
+          break;
+        }
+      }
+
+      if (Index > 0) {
+        AppendTraceRecord (mTrace[LiveRecord[Index - 1]].Type, mTrace[LiveRecord[Index - 1]].Id, (UINTN)Size, TRUE);
+        LiveCount--;
+        LiveAddress[Index - 1] = LiveAddress[LiveCount];
+        LiveRecord[Index - 1]  = LiveRecord[LiveCount];
+      }
+    }
+  }
+
+  fclose (File);
+  FreePool (LiveAddress);
+  FreePool (LiveRecord);
+  return TRUE;
+}
+
+/**
+  Replay the trace from First up to Last, excluding Last.
+
+  @param  First                  The first record to replay
+  @param  Last                   The end of the records to replay
+  @param  Check                  Whether to fill each allocation with its
+                                 pattern and check the pattern when it is freed
+
+  @retval TRUE                   The replay succeeded.
+  @retval FALSE                  An allocation failed, or a pattern was
+                                 overwritten.
+
+**/
+STATIC
+BOOLEAN
+ReplayTrace (
+  IN UINTN    First,
+  IN UINTN    Last,
+  IN BOOLEAN  Check
+  )
+{
+  POOL_TRACE_RECORD  *Record;
+  UINT8              *Buffer;
+  UINTN              Index;
+  UINTN              Byte;
+
+  for (Index = First; Index < Last; Index++) {
+    Record = &mTrace[Index];
+    if (!Record->Free) {
+      if (EFI_ERROR (CoreInternalAllocatePool (Record->Type, Record->Size, &mBuffer[Record->Id]))) {
+        return FALSE;
+      }
+
+      if (Check) {
+        SetMem (mBuffer[Record->Id], Record->Size, TRACE_PATTERN (Record->Id));
+      }
+
+      continue;
+    }
+
+    Buffer = mBuffer[Record->Id];
+    if (Buffer == NULL) {
+      continue;
+    }
+
+    if (Check) {
+      for (Byte = 0; Byte < Record->Size; Byte++) {
+        if (Buffer[Byte] != TRACE_PATTERN (Record->Id)) {
+          return FALSE;
+        }
+      }
+    }
+
+    if (EFI_ERROR (CoreInternalFreePool (Buffer, NULL))) {
+      return FALSE;
+    }
+
+    mBuffer[Record->Id] = NULL;
+  }
+
+  return TRUE;
+}
+
+/**
+  Free the allocations the trace leaves live, checking their patterns.
+
+  @retval TRUE                   All allocations were freed.
+  @retval FALSE                  A pattern was overwritten, or a free failed.
+
+**/
+STATIC
+BOOLEAN
+FreeLiveAllocations (
+  VOID
+  )
+{
+  UINTN  Index;
+  UINTN  Byte;
+
+  for (Index = 0; Index < mTraceLength; Index++) {
+    if (mTrace[Index].Free || (mBuffer[mTrace[Index].Id] == NULL)) {
+      continue;
+    }
+
+    for (Byte = 0; Byte < mTrace[Index].Size; Byte++) {
+      if (((UINT8 *)mBuffer[mTrace[Index].Id])[Byte] != TRACE_PATTERN (mTrace[Index].Id)) {
+        return FALSE;
+      }
+    }
+
+    if (EFI_ERROR (CoreInternalFreePool (mBuffer[mTrace[Index].Id], NULL))) {
+      return FALSE;
+    }
+
+    mBuffer[mTrace[Index].Id] = NULL;
+  }
+
+  return TRUE;
+}
+
+/**
+  The largest number of pages the pool may keep once all of its allocations
+  are freed: in slab mode, one empty slab of each size class of each memory
+  type.
+
+  @return The number of pages.
+
+**/
+STATIC
+UINTN
+KeptPagesLimit (
+  VOID
+  )
+{
+  if (!FeaturePcdGet (PcdDxePoolSlabAllocatorEnable)) {
+    return 0;
+  }
+
+  return EfiMaxMemoryType * POOL_SIZE_CLASSES * EFI_SIZE_TO_PAGES (RUNTIME_PAGE_ALLOCATION_GRANULARITY);
+}
+
+/// === TEST CASES =================================================================================
+
+/**
+  Get the trace, and initialize the pool.
+
+  @param[in]  Context  Unit test case context
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+PoolSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  if (mTrace == NULL) {
+    if ((mTraceFile == NULL) || !ReadTraceFile (mTraceFile)) {
+      MakeSyntheticTrace ();
+    }
+
+    mBuffer = AllocateZeroPool (MAX (mTraceIds, 1) * sizeof (VOID *));
+    UT_ASSERT_NOT_NULL (mBuffer);
+
+    CoreInitializePool ();
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Replay the trace and report its throughput and the pool pages it leaves
+  behind.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+ReplayTheTrace (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  clock_t  Start;
+  clock_t  Ticks;
+  UINTN    PagesBefore;
+  UINTN    LiveBytes;
+  UINTN    Index;
+
+  PagesBefore = mPagesHeld;
+  mPagesPeak  = mPagesHeld;
+  Start       = clock ();
+  UT_ASSERT_TRUE (ReplayTrace (0, mTraceLength, FALSE));
+  Ticks = clock () - Start;
+
+  LiveBytes = 0;
+  for (Index = 0; Index < mTraceLength; Index++) {
+    if (!mTrace[Index].Free && (mBuffer[mTrace[Index].Id] != NULL)) {
+      LiveBytes += mTrace[Index].Size;
+    }
+  }
+
+  UT_LOG_INFO (
+    "%a mode: %Lu operations in %Lu ms, %Lu pool pages at the peak, %Lu pages for %Lu live bytes at the end\n",
+    FeaturePcdGet (PcdDxePoolSlabAllocatorEnable) ? "Slab" : "List",
+    (UINT64)mTraceLength,
+    (UINT64)Ticks * 1000 / CLOCKS_PER_SEC,
+    (UINT64)mPagesPeak,
+    (UINT64)mPagesHeld,
+    (UINT64)LiveBytes
+    );
+  UT_ASSERT_TRUE (mPagesHeld >= PagesBefore);
+
+  for (Index = 0; Index < mTraceLength; Index++) {
+    if (!mTrace[Index].Free && (mBuffer[mTrace[Index].Id] != NULL)) {
+      UT_ASSERT_NOT_EFI_ERROR (CoreInternalFreePool (mBuffer[mTrace[Index].Id], NULL));
+      mBuffer[mTrace[Index].Id] = NULL;
+    }
+  }
+
+  UT_ASSERT_TRUE (mPagesHeld <= KeptPagesLimit ());
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Replay the trace with each allocation filled with its own pattern, and check
+  that no allocation overwrites another one, and that the pool gives its pages
+  back once everything is freed.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+AllocationsDoNotOverlap (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UT_ASSERT_TRUE (ReplayTrace (0, mTraceLength, TRUE));
+  UT_ASSERT_TRUE (FreeLiveAllocations ());
+  UT_ASSERT_TRUE (mPagesHeld <= KeptPagesLimit ());
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Fill several pages with blocks of each size class, free every other block,
+  and allocate them again, so that the free blocks are found at all positions
+  of the pages.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FreedBlocksAreReused (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC CONST UINTN  Sizes[] = { 24, 100, 200, 500, 1000, 1600, 2600, 4000 };
+  VOID                *Blocks[256];
+  UINTN               Count;
+  UINTN               Index;
+  UINTN               PagesFull;
+  UINTN               SizeIndex;
+
+  for (SizeIndex = 0; SizeIndex < ARRAY_SIZE (Sizes); SizeIndex++) {
+    Count = MIN (ARRAY_SIZE (Blocks), 3 * EFI_PAGE_SIZE / Sizes[SizeIndex] + 1);
+    for (Index = 0; Index < Count; Index++) {
+      UT_ASSERT_NOT_EFI_ERROR (CoreInternalAllocatePool (EfiBootServicesData, Sizes[SizeIndex], &Blocks[Index]));
+      SetMem (Blocks[Index], Sizes[SizeIndex], TRACE_PATTERN (Index));
+    }
+
+    PagesFull = mPagesHeld;
+    for (Index = 0; Index < Count; Index += 2) {
+      UT_ASSERT_NOT_EFI_ERROR (CoreInternalFreePool (Blocks[Index], NULL));
+    }
+
+    for (Index = 0; Index < Count; Index += 2) {
+      UT_ASSERT_NOT_EFI_ERROR (CoreInternalAllocatePool (EfiBootServicesData, Sizes[SizeIndex], &Blocks[Index]));
+      SetMem (Blocks[Index], Sizes[SizeIndex], TRACE_PATTERN (Index));
+    }
+
+    UT_ASSERT_EQUAL (mPagesHeld, PagesFull);
+
+    for (Index = 0; Index < Count; Index++) {
+      UT_ASSERT_EQUAL (((UINT8 *)Blocks[Index])[0], TRACE_PATTERN (Index));
+      UT_ASSERT_EQUAL (((UINT8 *)Blocks[Index])[Sizes[SizeIndex] - 1], TRACE_PATTERN (Index));
+      UT_ASSERT_NOT_EFI_ERROR (CoreInternalFreePool (Blocks[Index], NULL));
+    }
+
+    UT_ASSERT_TRUE (mPagesHeld <= KeptPagesLimit ());
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Main entry point to this unit test application.
+
+  Sets up and runs the test suites.
+**/
+VOID
+EFIAPI
+UnitTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      PoolTests;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  //
+  // Start setting up the test framework for running the tests.
+  //
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  //
+  // Add all test suites and tests.
+  //
+  Status = CreateUnitTestSuite (
+             &PoolTests,
+             Framework,
+             "DXE Core Pool Tests",
+             "DxeCore.Pool",
+             NULL,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for PoolTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (
+    PoolTests,
+    "Replay the allocation trace and report throughput and pool pages",
+    "Replay",
+    ReplayTheTrace,
+    PoolSetup,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    PoolTests,
+    "Allocations of the trace should not overlap",
+    "NoOverlap",
+    AllocationsDoNotOverlap,
+    PoolSetup,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    PoolTests,
+    "Freed blocks should be reused before new pages are taken",
+    "Reuse",
+    FreedBlocksAreReused,
+    PoolSetup,
+    NULL,
+    NULL
+    );
+
+  //
+  // Execute the tests.
+  //
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return;
+}
+
+///
+/// Avoid ECC error for function name that starts with lower case letter
+///
+#define Main  main
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+
+  @param[in] Argc  Number of arguments
+  @param[in] Argv  Array of pointers to arguments. Argv[1] is the optional
+                   path of a serial log to read the trace from.
+
+  @retval 0      Success
+  @retval other  Error
+**/
+INT32
+Main (
+  IN INT32  Argc,
+  IN CHAR8  *Argv[]
+  )
+{
+  if (Argc > 1) {
+    mTraceFile = Argv[1];
+  }
+
+  UnitTestMain ();
+  return 0;
+}
@@ -0,0 +1,782 @@
+/** @file
+  This is a host-based unit test for the hash indexes of the protocol
+  database of the DXE Core.
+
+  Every lookup through the indexes is checked against the walk of the whole
+  protocol database or of the protocols of a handle. The number of GUIDs
+  compared and the time of the lookups are logged.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <time.h>
+#include <cmocka.h>
+
+#include <Library/UnitTestLib.h>
+
+#include "../DxeMain.h"
+#include "../Hand/Handle.h"
+
+#define UNIT_TEST_NAME     "DXE Core Protocol Database Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// The number of protocol GUIDs of the tests. There are more GUIDs than hash
+// buckets, so the buckets hold several protocol entries.
+//
+#define TEST_PROTOCOL_COUNT  (PROTOCOL_HASH_BUCKETS * 4 + 5)
+
+//
+// The benchmark installs as many protocols on each handle as there are
+// handles, for each of these counts, and times this many lookups.
+//
+#define BENCHMARK_MAX_COUNT  256
+#define BENCHMARK_LOOKUPS    (1 << 20)
+
+//
+// The protocol database of Handle.c.
+//
+extern LIST_ENTRY  mProtocolDatabase;
+extern LIST_ENTRY  mProtocolHashTable[PROTOCOL_HASH_BUCKETS];
+
+//
+// mGuid        - The protocol GUIDs of the tests, the last one is never installed
+// mInterface   - The interfaces installed for the protocols
+// mHandle      - The handles the protocols are installed on
+// mNotifyCount - The number of CoreNotifyProtocolEntry () calls
+//
+EFI_GUID    mGuid[TEST_PROTOCOL_COUNT + 1];
+UINT32      mInterface[TEST_PROTOCOL_COUNT];
+EFI_HANDLE  mHandle[TEST_PROTOCOL_COUNT];
+UINTN       mNotifyCount;
+
+EFI_HANDLE  gDxeCoreImageHandle = NULL;
+
+/// === STUBS ======================================================================================
+
+/**
+  Acquire a lock. The tests run on a single thread at a single TPL.
+
+  @param  Lock               The lock to acquire
+
+**/
+VOID
+CoreAcquireLock (
+  IN EFI_LOCK  *Lock
+  )
+{
+  ASSERT (Lock->Lock == EfiLockReleased);
+  Lock->Lock = EfiLockAcquired;
+}
+
+/**
+  Release a lock.
+
+  @param  Lock               The lock to release
+
+**/
+VOID
+CoreReleaseLock (
+  IN EFI_LOCK  *Lock
+  )
+{
+  ASSERT (Lock->Lock == EfiLockAcquired);
+  Lock->Lock = EfiLockReleased;
+}
+
+/**
+  The tests run at a single TPL.
+
+  @param  NewTpl  New task priority level
+
+  @return TPL_APPLICATION.
+
+**/
+EFI_TPL
+EFIAPI
+CoreRaiseTpl (
+  IN EFI_TPL  NewTpl
+  )
+{
+  return TPL_APPLICATION;
+}
+
+/**
+  The tests run at a single TPL.
+
+  @param  NewTpl  New, lower, task priority
+
+**/
+VOID
+EFIAPI
+CoreRestoreTpl (
+  IN EFI_TPL  NewTpl
+  )
+{
+}
+
+/**
+  Not used by the tests: no protocol is registered for notification.
+
+  @param  ProtEntry              Protocol entry
+
+**/
+VOID
+CoreNotifyProtocolEntry (
+  IN PROTOCOL_ENTRY  *ProtEntry
+  )
+{
+  mNotifyCount++;
+}
+
+/**
+  Removes Protocol from the protocol list (but not the handle list). The tests
+  do not register for protocol notifications, so none has to be backed up.
+
+  @param  Handle                 The handle to remove protocol on.
+  @param  Protocol               GUID of the protocol to be moved
+  @param  Interface              The interface of the protocol
+
+  @return Protocol Entry
+
+**/
+PROTOCOL_INTERFACE *
+CoreRemoveInterfaceFromProtocol (
+  IN IHANDLE   *Handle,
+  IN EFI_GUID  *Protocol,
+  IN VOID      *Interface
+  )
+{
+  PROTOCOL_INTERFACE  *Prot;
+
+  Prot = CoreFindProtocolInterface (Handle, Protocol, Interface);
+  if (Prot != NULL) {
+    RemoveEntryList (&Prot->ByProtocol);
+    gProtocolUpdateKey++;
+    Prot->Protocol->UpdateKey = gProtocolUpdateKey;
+  }
+
+  return Prot;
+}
+
+/**
+  Not used by the tests: no driver is connected.
+
+  @param  ControllerHandle      The handle of the controller to which driver(s)
+                                are to be connected.
+  @param  DriverImageHandle     A pointer to an ordered list handles that support
+                                the EFI_DRIVER_BINDING_PROTOCOL.
+  @param  RemainingDevicePath   A pointer to the device path that specifies a
+                                child of the controller specified by
+                                ControllerHandle.
+  @param  Recursive             Whether the function would be called recursively
+                                or not.
+
+  @retval EFI_NOT_FOUND         Always.
+
+**/
+EFI_STATUS
+EFIAPI
+CoreConnectController (
+  IN  EFI_HANDLE                ControllerHandle,
+  IN  EFI_HANDLE                *DriverImageHandle    OPTIONAL,
+  IN  EFI_DEVICE_PATH_PROTOCOL  *RemainingDevicePath  OPTIONAL,
+  IN  BOOLEAN                   Recursive
+  )
+{
+  return EFI_NOT_FOUND;
+}
+
+/**
+  Not used by the tests: no driver is connected.
+
+  @param  ControllerHandle   ControllerHandle The handle of the controller from
+                             which driver(s)  are to be disconnected.
+  @param  DriverImageHandle  DriverImageHandle The driver to disconnect from
+                             ControllerHandle.
+  @param  ChildHandle        ChildHandle The handle of the child to destroy.
+
+  @retval EFI_SUCCESS        Always.
+
+**/
+EFI_STATUS
+EFIAPI
+CoreDisconnectController (
+  IN  EFI_HANDLE  ControllerHandle,
+  IN  EFI_HANDLE  DriverImageHandle  OPTIONAL,
+  IN  EFI_HANDLE  ChildHandle        OPTIONAL
+  )
+{
+  return EFI_SUCCESS;
+}
+
+/**
+  Not used by the tests: no device path is installed.
+
+  @param  Protocol               The protocol to search for.
+  @param  DevicePath             On input, a pointer to a pointer to the device
+                                 path. On output, the device path pointer is
+                                 modified to point to the remaining part of the
+                                 devicepath.
+  @param  Device                 A pointer to the returned device handle.
+
+  @retval EFI_NOT_FOUND          Always.
+
+**/
+EFI_STATUS
+EFIAPI
+CoreLocateDevicePath (
+  IN EFI_GUID                      *Protocol,
+  IN OUT EFI_DEVICE_PATH_PROTOCOL  **DevicePath,
+  OUT EFI_HANDLE                   *Device
+  )
+{
+  return EFI_NOT_FOUND;
+}
+
+/**
+  Not used by the tests: no device path is installed.
+
+  @param  Node      A pointer to a device path node data structure.
+
+  @retval TRUE      Always.
+
+**/
+BOOLEAN
+EFIAPI
+IsDevicePathEnd (
+  IN CONST VOID  *Node
+  )
+{
+  return TRUE;
+}
+
+/**
+  Frees pool.
+
+  @param  Buffer                 The allocated pool entry to free
+
+  @retval EFI_SUCCESS            Pool successfully freed.
+
+**/
+EFI_STATUS
+EFIAPI
+CoreFreePool (
+  IN VOID  *Buffer
+  )
+{
+  FreePool (Buffer);
+  return EFI_SUCCESS;
+}
+
+/**
+  Not used by the tests: the performance counters are not logged.
+
+  @param  Name          The name of the counter.
+  @param  Value         The value of the counter.
+
+**/
+VOID
+CoreLogPerformanceCounter (
+  IN CONST CHAR8  *Name,
+  IN UINT64       Value
+  )
+{
+}
+
+/// === HELPERS ====================================================================================
+
+/**
+  Find the protocol entry of a GUID by the walk of the whole protocol database.
+
+  @param  Protocol               The ID of the protocol
+  @param  Compares               Incremented by the number of GUIDs compared.
+
+  @return The protocol entry, or NULL if the database has none for the GUID.
+
+**/
+STATIC
+PROTOCOL_ENTRY *
+WalkProtocolDatabase (
+  IN     EFI_GUID  *Protocol,
+  IN OUT UINTN     *Compares
+  )
+{
+  LIST_ENTRY      *Link;
+  PROTOCOL_ENTRY  *Item;
+
+  for (Link = mProtocolDatabase.ForwardLink; Link != &mProtocolDatabase; Link = Link->ForwardLink) {
+    (*Compares)++;
+    Item = CR (Link, PROTOCOL_ENTRY, AllEntries, PROTOCOL_ENTRY_SIGNATURE);
+    if (CompareGuid (&Item->ProtocolID, Protocol)) {
+      return Item;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Count the GUIDs a lookup through the hash index compares.
+
+  @param  Protocol               The ID of the protocol
+  @param  Compares               Incremented by the number of GUIDs compared.
+
+**/
+STATIC
+VOID
+CountHashCompares (
+  IN     EFI_GUID  *Protocol,
+  IN OUT UINTN     *Compares
+  )
+{
+  LIST_ENTRY      *Bucket;
+  LIST_ENTRY      *Link;
+  PROTOCOL_ENTRY  *Item;
+
+  Bucket = &mProtocolHashTable[CoreProtocolHashIndex (Protocol)];
+  for (Link = Bucket->ForwardLink; Link != Bucket; Link = Link->ForwardLink) {
+    (*Compares)++;
+    Item = CR (Link, PROTOCOL_ENTRY, HashLink, PROTOCOL_ENTRY_SIGNATURE);
+    if (CompareGuid (&Item->ProtocolID, Protocol)) {
+      return;
+    }
+  }
+}
+
+/**
+  Find the interface of a protocol on a handle by the walk of the protocols
+  of the handle, like CoreGetProtocolInterface() did before the interface
+  hash index.
+
+  @param  UserHandle             The handle to obtain the protocol interface on
+  @param  Protocol               The GUID of the protocol
+
+  @return The protocol interface, or NULL if the handle has none for the GUID.
+
+**/
+STATIC
+PROTOCOL_INTERFACE *
+WalkHandleProtocols (
+  IN EFI_HANDLE  UserHandle,
+  IN EFI_GUID    *Protocol
+  )
+{
+  PROTOCOL_ENTRY      *ProtEntry;
+  PROTOCOL_INTERFACE  *Prot;
+  IHANDLE             *Handle;
+  LIST_ENTRY          *Link;
+
+  if (EFI_ERROR (CoreValidateHandle (UserHandle))) {
+    return NULL;
+  }
+
+  ProtEntry = CoreFindProtocolEntry (Protocol, FALSE);
+  if (ProtEntry == NULL) {
+    return NULL;
+  }
+
+  Handle = (IHANDLE *)UserHandle;
+  for (Link = Handle->Protocols.ForwardLink; Link != &Handle->Protocols; Link = Link->ForwardLink) {
+    Prot = CR (Link, PROTOCOL_INTERFACE, Link, PROTOCOL_INTERFACE_SIGNATURE);
+    if (Prot->Protocol == ProtEntry) {
+      return Prot;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Return the time between two clock () readings in nanoseconds per lookup.
+
+  @param  Start                  The clock () before the lookups.
+  @param  End                    The clock () after the lookups.
+
+  @return The time of a lookup in nanoseconds.
+
+**/
+STATIC
+UINT64
+NanosecondsPerLookup (
+  IN clock_t  Start,
+  IN clock_t  End
+  )
+{
+  return (UINT64)(End - Start) * 1000000000 / CLOCKS_PER_SEC / BENCHMARK_LOOKUPS;
+}
+
+/// === TEST CASES =================================================================================
+
+/**
+  Make the protocol GUIDs of the tests, and forget the handles of the
+  previous test.
+
+  @param[in]  Context  Unit test case context
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+ProtocolSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINT32  Seed;
+  UINTN   Index;
+  UINTN   Word;
+
+  //
+  // The GUIDs are random like the GUIDs of real protocols.
+  //
+  Seed = 0x1234ABCD;
+  for (Index = 0; Index <= TEST_PROTOCOL_COUNT; Index++) {
+    for (Word = 0; Word < sizeof (EFI_GUID) / sizeof (UINT32); Word++) {
+      Seed                            = Seed * 1103515245 + 12345;
+      ((UINT32 *)&mGuid[Index])[Word] = (Seed >> 16) | (Seed << 16);
+    }
+  }
+
+  ZeroMem (mHandle, sizeof (mHandle));
+  mNotifyCount = 0;
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Install each protocol on its own handle, and check that each lookup through
+  the hash index finds what the walk of the protocol database finds.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+LookupsMatchTheWalkOfTheDatabase (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS      Status;
+  PROTOCOL_ENTRY  *ProtEntry;
+  VOID            *Interface;
+  UINTN           Index;
+  UINTN           WalkCompares;
+  UINTN           HashCompares;
+
+  for (Index = 0; Index < TEST_PROTOCOL_COUNT; Index++) {
+    Status = CoreInstallProtocolInterface (&mHandle[Index], &mGuid[Index], EFI_NATIVE_INTERFACE, &mInterface[Index]);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+  }
+
+  UT_ASSERT_EQUAL (mNotifyCount, TEST_PROTOCOL_COUNT);
+
+  WalkCompares = 0;
+  HashCompares = 0;
+  CoreAcquireProtocolLock ();
+  for (Index = 0; Index <= TEST_PROTOCOL_COUNT; Index++) {
+    ProtEntry = CoreFindProtocolEntry (&mGuid[Index], FALSE);
+    if (ProtEntry != WalkProtocolDatabase (&mGuid[Index], &WalkCompares)) {
+      CoreReleaseProtocolLock ();
+      UT_ASSERT_TRUE (FALSE);
+    }
+
+    CountHashCompares (&mGuid[Index], &HashCompares);
+  }
+
+  CoreReleaseProtocolLock ();
+
+  UT_LOG_INFO (
+    "%Lu lookups compared %Lu GUIDs through the index, %Lu by the walk of the database\n",
+    (UINT64)(TEST_PROTOCOL_COUNT + 1),
+    (UINT64)HashCompares,
+    (UINT64)WalkCompares
+    );
+  UT_ASSERT_TRUE (HashCompares * 8 < WalkCompares);
+
+  for (Index = 0; Index < TEST_PROTOCOL_COUNT; Index++) {
+    Status = CoreHandleProtocol (mHandle[Index], &mGuid[Index], &Interface);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    UT_ASSERT_TRUE (Interface == &mInterface[Index]);
+
+    Status = CoreHandleProtocol (mHandle[Index], &mGuid[(Index + 1) % TEST_PROTOCOL_COUNT], &Interface);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_UNSUPPORTED);
+
+    Status = CoreHandleProtocol (mHandle[Index], &mGuid[TEST_PROTOCOL_COUNT], &Interface);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_UNSUPPORTED);
+  }
+
+  for (Index = 0; Index < TEST_PROTOCOL_COUNT; Index++) {
+    Status = CoreUninstallProtocolInterface (mHandle[Index], &mGuid[Index], &mInterface[Index]);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Install all protocols on one handle, uninstall half of them, and check that
+  only the others are found, while their protocol entries are kept.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+InterfacesAreFoundByTheirEntry (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS  Status;
+  EFI_HANDLE  Handle;
+  VOID        *Interface;
+  UINTN       Index;
+  UINTN       Compares;
+
+  Handle = NULL;
+  for (Index = 0; Index < TEST_PROTOCOL_COUNT; Index++) {
+    Status = CoreInstallProtocolInterface (&Handle, &mGuid[Index], EFI_NATIVE_INTERFACE, &mInterface[Index]);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+  }
+
+  for (Index = 0; Index < TEST_PROTOCOL_COUNT; Index += 2) {
+    Status = CoreUninstallProtocolInterface (Handle, &mGuid[Index], &mInterface[Index]);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+  }
+
+  for (Index = 0; Index < TEST_PROTOCOL_COUNT; Index++) {
+    Status = CoreHandleProtocol (Handle, &mGuid[Index], &Interface);
+    if ((Index % 2) == 0) {
+      UT_ASSERT_STATUS_EQUAL (Status, EFI_UNSUPPORTED);
+    } else {
+      UT_ASSERT_NOT_EFI_ERROR (Status);
+      UT_ASSERT_TRUE (Interface == &mInterface[Index]);
+    }
+  }
+
+  //
+  // Each GUID still has exactly one protocol entry, in the database and in the
+  // index.
+  //
+  Compares = 0;
+  CoreAcquireProtocolLock ();
+  for (Index = 0; Index < TEST_PROTOCOL_COUNT; Index++) {
+    if (CoreFindProtocolEntry (&mGuid[Index], FALSE) != WalkProtocolDatabase (&mGuid[Index], &Compares)) {
+      CoreReleaseProtocolLock ();
+      UT_ASSERT_TRUE (FALSE);
+    }
+  }
+
+  CoreReleaseProtocolLock ();
+
+  Compares = 0;
+  WalkProtocolDatabase (&mGuid[TEST_PROTOCOL_COUNT], &Compares);
+  UT_ASSERT_EQUAL (Compares, TEST_PROTOCOL_COUNT);
+
+  for (Index = 1; Index < TEST_PROTOCOL_COUNT; Index += 2) {
+    Status = CoreUninstallProtocolInterface (Handle, &mGuid[Index], &mInterface[Index]);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Time the lookups of CoreGetProtocolInterface() through the interface hash
+  index and by the walk of the protocols of a handle, as the number of
+  handles and of protocols on each handle grows.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+InterfaceLookupsAreFasterThanTheWalk (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS          Status;
+  PROTOCOL_INTERFACE  *Prot;
+  UINTN               Count;
+  UINTN               HandleIndex;
+  UINTN               GuidIndex;
+  UINTN               Index;
+  clock_t             Start;
+  UINT64              HashTime;
+  UINT64              WalkTime;
+
+  HashTime = 0;
+  WalkTime = 0;
+  for (Count = 4; Count <= BENCHMARK_MAX_COUNT; Count *= 4) {
+    ZeroMem (mHandle, sizeof (mHandle));
+    for (HandleIndex = 0; HandleIndex < Count; HandleIndex++) {
+      for (GuidIndex = 0; GuidIndex < Count; GuidIndex++) {
+        Status = CoreInstallProtocolInterface (&mHandle[HandleIndex], &mGuid[GuidIndex], EFI_NATIVE_INTERFACE, &mInterface[GuidIndex]);
+        UT_ASSERT_NOT_EFI_ERROR (Status);
+      }
+    }
+
+    //
+    // Both lookups find the same interfaces.
+    //
+    CoreAcquireProtocolLock ();
+    for (HandleIndex = 0; HandleIndex < Count; HandleIndex++) {
+      for (GuidIndex = 0; GuidIndex <= Count; GuidIndex++) {
+        Prot = CoreGetProtocolInterface (mHandle[HandleIndex], &mGuid[GuidIndex]);
+        if ((Prot != WalkHandleProtocols (mHandle[HandleIndex], &mGuid[GuidIndex])) ||
+            ((Prot == NULL) != (GuidIndex == Count)))
+        {
+          CoreReleaseProtocolLock ();
+          UT_ASSERT_TRUE (FALSE);
+        }
+      }
+    }
+
+    Start = clock ();
+    for (Index = 0; Index < BENCHMARK_LOOKUPS; Index++) {
+      CoreGetProtocolInterface (mHandle[Index % Count], &mGuid[(Index / Count) % Count]);
+    }
+
+    HashTime = NanosecondsPerLookup (Start, clock ());
+
+    Start = clock ();
+    for (Index = 0; Index < BENCHMARK_LOOKUPS; Index++) {
+      WalkHandleProtocols (mHandle[Index % Count], &mGuid[(Index / Count) % Count]);
+    }
+
+    WalkTime = NanosecondsPerLookup (Start, clock ());
+    CoreReleaseProtocolLock ();
+
+    UT_LOG_INFO (
+      "%Lu handles with %Lu protocols each: %Lu ns per lookup through the index, %Lu ns by the walk of the handle\n",
+      (UINT64)Count,
+      (UINT64)Count,
+      HashTime,
+      WalkTime
+      );
+
+    for (HandleIndex = 0; HandleIndex < Count; HandleIndex++) {
+      for (GuidIndex = 0; GuidIndex < Count; GuidIndex++) {
+        Status = CoreUninstallProtocolInterface (mHandle[HandleIndex], &mGuid[GuidIndex], &mInterface[GuidIndex]);
+        UT_ASSERT_NOT_EFI_ERROR (Status);
+      }
+    }
+  }
+
+  //
+  // With hundreds of protocols on a handle the walk has to be slower.
+  //
+  UT_ASSERT_TRUE (HashTime < WalkTime);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Main entry point to this unit test application.
+
+  Sets up and runs the test suites.
+**/
+VOID
+EFIAPI
+UnitTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      ProtocolTests;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  //
+  // Start setting up the test framework for running the tests.
+  //
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  //
+  // Add all test suites and tests.
+  //
+  Status = CreateUnitTestSuite (
+             &ProtocolTests,
+             Framework,
+             "DXE Core Protocol Database Tests",
+             "DxeCore.Protocol",
+             NULL,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for ProtocolTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (
+    ProtocolTests,
+    "Lookups through the index should find what the walk of the database finds",
+    "MatchesWalk",
+    LookupsMatchTheWalkOfTheDatabase,
+    ProtocolSetup,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    ProtocolTests,
+    "Interfaces should be found by their protocol entry",
+    "Interfaces",
+    InterfacesAreFoundByTheirEntry,
+    ProtocolSetup,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    ProtocolTests,
+    "Interface lookups through the index should be faster than the walk of the handle",
+    "LookupTime",
+    InterfaceLookupsAreFasterThanTheWalk,
+    ProtocolSetup,
+    NULL,
+    NULL
+    );
+
+  //
+  // Execute the tests.
+  //
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return;
+}
+
+///
+/// Avoid ECC error for function name that starts with lower case letter
+///
+#define Main  main
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+
+  @param[in] Argc  Number of arguments
+  @param[in] Argv  Array of pointers to arguments
+
+  @retval 0      Success
+  @retval other  Error
+**/
+INT32
+Main (
+  IN INT32  Argc,
+  IN CHAR8  *Argv[]
+  )
+{
+  UnitTestMain ();
+  return 0;
+}
@@ -27,6 +27,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Guid/MemoryTypeInformation.h>
 #include <Guid/MemoryAllocationHob.h>
 #include <Guid/FirmwareFileSystem2.h>
+#include <Guid/HobDirectory.h>
 
 #include <Library/DebugLib.h>
 #include <Library/PeimEntryPoint.h>
@@ -46,6 +47,14 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #define STACK_SIZE      0x20000
 #define BSP_STORE_SIZE  0x4000
 
+//
+// A GUID HOB of the HOB list, sorted to build the HOB directory.
+//
+typedef struct {
+  EFI_GUID    Name;
+  UINT32      Offset;
+} HOB_DIRECTORY_SORT_ENTRY;
+
 //
 // This PPI is installed to indicate the end of the PEI usage of memory
 //
@@ -228,6 +228,166 @@ ValidateMemoryTypeInfoVariable (
   return TRUE;
 }
 
+/**
+  Compare two GUID HOBs by GUID, then by offset in the HOB list.
+
+  @param[in] Buffer1  The first HOB_DIRECTORY_SORT_ENTRY.
+  @param[in] Buffer2  The second HOB_DIRECTORY_SORT_ENTRY.
+
+  @retval <0  Buffer1 goes before Buffer2.
+  @retval 0   Buffer1 and Buffer2 are the same GUID HOB.
+  @retval >0  Buffer1 goes after Buffer2.
+
+**/
+INTN
+EFIAPI
+CompareHobDirectorySortEntry (
+  IN CONST VOID  *Buffer1,
+  IN CONST VOID  *Buffer2
+  )
+{
+  CONST HOB_DIRECTORY_SORT_ENTRY  *Entry1;
+  CONST HOB_DIRECTORY_SORT_ENTRY  *Entry2;
+  INTN                            Result;
+
+  Entry1 = Buffer1;
+  Entry2 = Buffer2;
+
+  Result = CompareMem (&Entry1->Name, &Entry2->Name, sizeof (EFI_GUID));
+  if (Result != 0) {
+    return Result;
+  }
+
+  if (Entry1->Offset == Entry2->Offset) {
+    return 0;
+  }
+
+  return (Entry1->Offset < Entry2->Offset) ? -1 : 1;
+}
+
+/**
+  Build the HOB directory of the GUID HOBs of the HOB list.
+
+  The directory is built as the last GUID HOB of the HOB list, and describes the
+  GUID HOBs before it. It is not built if there is no GUID HOB. If the GUID HOBs
+  do not all fit in a HOB, the directory only describes the part of the HOB list
+  with the first of them, and the others are found by walking the HOB list.
+
+**/
+VOID
+BuildHobDirectory (
+  VOID
+  )
+{
+  EFI_PEI_HOB_POINTERS       HobList;
+  EFI_PEI_HOB_POINTERS       Hob;
+  UINTN                      Count;
+  UINTN                      MaxCount;
+  UINTN                      EntryCount;
+  UINTN                      Index;
+  UINTN                      Pages;
+  UINTN                      DirectorySize;
+  UINT32                     Length;
+  HOB_DIRECTORY_SORT_ENTRY   *SortBuffer;
+  HOB_DIRECTORY_SORT_ENTRY   SortEntry;
+  EDKII_HOB_DIRECTORY        *Directory;
+  EDKII_HOB_DIRECTORY_ENTRY  *Entry;
+  UINT32                     *Offset;
+
+  HobList.Raw = GetHobList ();
+
+  Count = 0;
+  for (Hob.Raw = HobList.Raw; (Hob.Raw = GetNextHob (EFI_HOB_TYPE_GUID_EXTENSION, Hob.Raw)) != NULL; Hob.Raw = GET_NEXT_HOB (Hob)) {
+    Count++;
+  }
+
+  if (Count == 0) {
+    return;
+  }
+
+  Pages      = EFI_SIZE_TO_PAGES (Count * sizeof (HOB_DIRECTORY_SORT_ENTRY));
+  SortBuffer = AllocatePages (Pages);
+  if (SortBuffer == NULL) {
+    return;
+  }
+
+  //
+  // Allocating the sort buffer only adds a memory allocation HOB, so the GUID
+  // HOBs are the same as the ones counted.
+  //
+  Index = 0;
+  for (Hob.Raw = HobList.Raw; (Hob.Raw = GetNextHob (EFI_HOB_TYPE_GUID_EXTENSION, Hob.Raw)) != NULL; Hob.Raw = GET_NEXT_HOB (Hob)) {
+    CopyGuid (&SortBuffer[Index].Name, &Hob.Guid->Name);
+    SortBuffer[Index].Offset = (UINT32)(Hob.Raw - HobList.Raw);
+    Index++;
+  }
+
+  //
+  // The directory HOB holds at most MaxCount GUID HOBs, as many GUIDs as GUID
+  // HOBs. Beyond that, it describes the HOB list up to the first GUID HOB left
+  // out, which the sort buffer still has in the order of the HOB list.
+  //
+  MaxCount = (0xFFF8 - sizeof (EFI_HOB_GUID_TYPE) - sizeof (EDKII_HOB_DIRECTORY)) /
+             (sizeof (EDKII_HOB_DIRECTORY_ENTRY) + sizeof (UINT32));
+  Length = 0;
+  if (Count > MaxCount) {
+    DEBUG ((
+      DEBUG_WARN,
+      "DxeIpl: the HOB directory holds the first %lu of %lu GUID HOBs, up to offset 0x%x\n",
+      (UINT64)MaxCount,
+      (UINT64)Count,
+      SortBuffer[MaxCount].Offset
+      ));
+    Length = SortBuffer[MaxCount].Offset;
+    Count  = MaxCount;
+  }
+
+  QuickSort (SortBuffer, Count, sizeof (HOB_DIRECTORY_SORT_ENTRY), CompareHobDirectorySortEntry, &SortEntry);
+
+  EntryCount = 1;
+  for (Index = 1; Index < Count; Index++) {
+    if (!CompareGuid (&SortBuffer[Index].Name, &SortBuffer[Index - 1].Name)) {
+      EntryCount++;
+    }
+  }
+
+  DirectorySize = sizeof (EDKII_HOB_DIRECTORY) + EntryCount * sizeof (EDKII_HOB_DIRECTORY_ENTRY) + Count * sizeof (UINT32);
+  ASSERT (DirectorySize <= 0xFFF8 - sizeof (EFI_HOB_GUID_TYPE));
+
+  Directory = BuildGuidHob (&gEdkiiHobDirectoryGuid, DirectorySize);
+  if (Directory != NULL) {
+    if (Length == 0) {
+      Length = (UINT32)((UINT8 *)Directory - sizeof (EFI_HOB_GUID_TYPE) - HobList.Raw);
+    }
+
+    Directory->Length      = Length;
+    Directory->EntryCount  = (UINT32)EntryCount;
+    Directory->OffsetCount = (UINT32)Count;
+    Directory->Reserved    = 0;
+    Entry                  = (EDKII_HOB_DIRECTORY_ENTRY *)(Directory + 1);
+    Offset                 = (UINT32 *)(Entry + EntryCount);
+
+    for (Index = 0; Index < Count; Index++) {
+      if ((Index == 0) || !CompareGuid (&SortBuffer[Index].Name, &SortBuffer[Index - 1].Name)) {
+        if (Index != 0) {
+          Entry++;
+        }
+
+        CopyGuid (&Entry->Name, &SortBuffer[Index].Name);
+        Entry->OffsetIndex = (UINT32)Index;
+        Entry->OffsetCount = 0;
+      }
+
+      Entry->OffsetCount++;
+      Offset[Index] = SortBuffer[Index].Offset;
+    }
+
+    DEBUG ((DEBUG_INFO, "DxeIpl: HOB directory of %u GUIDs for %u GUID HOBs\n", Directory->EntryCount, Directory->OffsetCount));
+  }
+
+  FreePages (SortBuffer, Pages);
+}
+
 /**
    Main entry point to last PEIM.
 
@@ -436,6 +596,14 @@ DxeLoadCore (
     DxeCoreEntryPoint
     );
 
+  //
+  // Build the HOB directory of the GUID HOBs for DXE, after the last GUID HOB
+  // of DxeIpl.
+  //
+  if (FeaturePcdGet (PcdDxeIplBuildHobDirectory)) {
+    BuildHobDirectory ();
+  }
+
   //
   // Report Status Code EFI_SW_PEI_PC_HANDOFF_TO_NEXT
   //
@@ -250,6 +250,10 @@ FileHandleToVolume (
   If SearchType is EFI_FV_FILETYPE_ALL, the first FFS file will return without check its file type.
   If SearchType is PEI_CORE_INTERNAL_FFS_FILE_DISPATCH_TYPE,
   the first PEIM, or COMBINED PEIM or FV file type FFS file will return.
+  If SearchType is PEI_CORE_INTERNAL_FFS_FILE_ANY_TYPE, the first FFS file,
+  including pad files, will return.
+
+  The FFS headers are read from the FV.
 
   @param FvHandle        Pointer to the FV header of the volume to search
   @param FileName        File name
@@ -263,7 +267,7 @@ FileHandleToVolume (
 
 **/
 EFI_STATUS
-FindFileEx (
+FindFileInFv (
   IN  CONST EFI_PEI_FV_HANDLE    FvHandle,
   IN  CONST EFI_GUID             *FileName    OPTIONAL,
   IN        EFI_FV_FILETYPE      SearchType,
@@ -422,6 +426,9 @@ FindFileEx (
         {
           *FileHeader = FfsFileHeader;
           return EFI_SUCCESS;
+        } else if (SearchType == PEI_CORE_INTERNAL_FFS_FILE_ANY_TYPE) {
+          *FileHeader = FfsFileHeader;
+          return EFI_SUCCESS;
         }
 
         FileOffset   += FileOccupiedSize;
@@ -455,6 +462,209 @@ FindFileEx (
   return EFI_NOT_FOUND;
 }
 
+/**
+  Build the file directory of a FV, so that its files can be searched without
+  reading their FFS headers again.
+
+  The directory holds the files FindFileInFv() finds with
+  PEI_CORE_INTERNAL_FFS_FILE_ANY_TYPE, in the same order: every search of
+  FindFileInFv() is a filter of them.
+
+  The files are counted first so that the directory is allocated once: PEI
+  memory is never freed. If the directory cannot be allocated, this is recorded
+  so that the searches in the FV use FindFileInFv() without trying again.
+
+  @param CoreFvHandle    Pointer to the PEI_CORE_FV_HANDLE of the FV.
+**/
+VOID
+BuildFvFileDirectory (
+  IN OUT PEI_CORE_FV_HANDLE  *CoreFvHandle
+  )
+{
+  PEI_CORE_FV_FILE_ENTRY  *FileDirectory;
+  UINTN                   FileCount;
+  UINTN                   MaxFileCount;
+  EFI_PEI_FILE_HANDLE     FileHandle;
+  EFI_FFS_FILE_HEADER     *FfsFileHeader;
+
+  PERF_INMODULE_BEGIN ("FvFileDirectory");
+
+  MaxFileCount = 0;
+  FileHandle   = NULL;
+  while (!EFI_ERROR (FindFileInFv (CoreFvHandle->FvHandle, NULL, PEI_CORE_INTERNAL_FFS_FILE_ANY_TYPE, &FileHandle, NULL))) {
+    MaxFileCount++;
+  }
+
+  FileDirectory = NULL;
+  if (MaxFileCount != 0) {
+    FileDirectory = AllocatePool (sizeof (PEI_CORE_FV_FILE_ENTRY) * MaxFileCount);
+    if (FileDirectory == NULL) {
+      CoreFvHandle->FileDirectoryFailed = TRUE;
+      PERF_INMODULE_END ("FvFileDirectory");
+      return;
+    }
+  }
+
+  FileCount  = 0;
+  FileHandle = NULL;
+  while ((FileCount < MaxFileCount) &&
+         !EFI_ERROR (FindFileInFv (CoreFvHandle->FvHandle, NULL, PEI_CORE_INTERNAL_FFS_FILE_ANY_TYPE, &FileHandle, NULL)))
+  {
+    FfsFileHeader = (EFI_FFS_FILE_HEADER *)FileHandle;
+    CopyGuid (&FileDirectory[FileCount].Name, &FfsFileHeader->Name);
+    FileDirectory[FileCount].Offset = (UINT32)((UINTN)FfsFileHeader - (UINTN)CoreFvHandle->FvHandle);
+    FileDirectory[FileCount].Type   = FfsFileHeader->Type;
+    FileCount++;
+  }
+
+  CoreFvHandle->FileDirectory      = FileDirectory;
+  CoreFvHandle->FileCount          = FileCount;
+  CoreFvHandle->FileDirectoryValid = TRUE;
+
+  PERF_INMODULE_END ("FvFileDirectory");
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a(): Found 0x%x FFS files in FV at 0x%p\n",
+    __FUNCTION__,
+    FileCount,
+    CoreFvHandle->FvHandle
+    ));
+}
+
+/**
+  Given the input file pointer, search for the first matching file in the
+  file directory of a FV, with the same rules as FindFileInFv().
+
+  @param CoreFvHandle    Pointer to the PEI_CORE_FV_HANDLE of the FV, with a valid
+                         file directory.
+  @param FileName        File name
+  @param SearchType      Filter to find only files of this type.
+                         Type EFI_FV_FILETYPE_ALL causes no filtering to be done.
+  @param FileHandle      This parameter must point to a valid FFS volume.
+  @param AprioriFile     Pointer to AprioriFile image in this FV if has
+
+  @return EFI_NOT_FOUND  No files matching the search criteria were found
+  @retval EFI_SUCCESS    Success to search given file
+
+**/
+EFI_STATUS
+FindFileInFvFileDirectory (
+  IN        PEI_CORE_FV_HANDLE   *CoreFvHandle,
+  IN  CONST EFI_GUID             *FileName    OPTIONAL,
+  IN        EFI_FV_FILETYPE      SearchType,
+  IN OUT    EFI_PEI_FILE_HANDLE  *FileHandle,
+  IN OUT    EFI_PEI_FILE_HANDLE  *AprioriFile  OPTIONAL
+  )
+{
+  PEI_CORE_FV_FILE_ENTRY  *Entry;
+  UINTN                   Index;
+  UINTN                   Low;
+  UINTN                   High;
+  UINTN                   Middle;
+  UINTN                   FileOffset;
+  BOOLEAN                 Found;
+
+  //
+  // If FileHandle is not specified (NULL) or FileName is not NULL,
+  // start with the first file in the firmware volume.  Otherwise,
+  // start from the first file after FileHandle.
+  //
+  Index = 0;
+  if ((*FileHandle != NULL) && (FileName == NULL)) {
+    FileOffset = (UINTN)*FileHandle - (UINTN)CoreFvHandle->FvHandle;
+    Low        = 0;
+    High       = CoreFvHandle->FileCount;
+    while (Low < High) {
+      Middle = (Low + High) / 2;
+      if (CoreFvHandle->FileDirectory[Middle].Offset > FileOffset) {
+        High = Middle;
+      } else {
+        Low = Middle + 1;
+      }
+    }
+
+    Index = Low;
+  }
+
+  for ( ; Index < CoreFvHandle->FileCount; Index++) {
+    Entry = &CoreFvHandle->FileDirectory[Index];
+    Found = FALSE;
+    if (FileName != NULL) {
+      Found = CompareGuid (&Entry->Name, FileName);
+    } else if (SearchType == PEI_CORE_INTERNAL_FFS_FILE_DISPATCH_TYPE) {
+      if ((Entry->Type == EFI_FV_FILETYPE_PEIM) ||
+          (Entry->Type == EFI_FV_FILETYPE_COMBINED_PEIM_DRIVER) ||
+          (Entry->Type == EFI_FV_FILETYPE_FIRMWARE_VOLUME_IMAGE))
+      {
+        Found = TRUE;
+      } else if (AprioriFile != NULL) {
+        if ((Entry->Type == EFI_FV_FILETYPE_FREEFORM) &&
+            CompareGuid (&Entry->Name, &gPeiAprioriFileNameGuid))
+        {
+          *AprioriFile = (EFI_PEI_FILE_HANDLE)((UINT8 *)CoreFvHandle->FvHandle + Entry->Offset);
+        }
+      }
+    } else {
+      Found = (BOOLEAN)(((SearchType == Entry->Type) || (SearchType == EFI_FV_FILETYPE_ALL)) &&
+                        (Entry->Type != EFI_FV_FILETYPE_FFS_PAD));
+    }
+
+    if (Found) {
+      *FileHandle = (EFI_PEI_FILE_HANDLE)((UINT8 *)CoreFvHandle->FvHandle + Entry->Offset);
+      return EFI_SUCCESS;
+    }
+  }
+
+  *FileHandle = NULL;
+  return EFI_NOT_FOUND;
+}
+
+/**
+  Given the input file pointer, search for the first matching file in the
+  FFS volume as defined by SearchType. The search starts from FileHeader inside
+  the Firmware Volume defined by FwVolHeader.
+  If SearchType is EFI_FV_FILETYPE_ALL, the first FFS file will return without check its file type.
+  If SearchType is PEI_CORE_INTERNAL_FFS_FILE_DISPATCH_TYPE,
+  the first PEIM, or COMBINED PEIM or FV file type FFS file will return.
+
+  The FVs known to the PEI Core are searched in their file directory, built the
+  first time they are searched.
+
+  @param FvHandle        Pointer to the FV header of the volume to search
+  @param FileName        File name
+  @param SearchType      Filter to find only files of this type.
+                         Type EFI_FV_FILETYPE_ALL causes no filtering to be done.
+  @param FileHandle      This parameter must point to a valid FFS volume.
+  @param AprioriFile     Pointer to AprioriFile image in this FV if has
+
+  @return EFI_NOT_FOUND  No files matching the search criteria were found
+  @retval EFI_SUCCESS    Success to search given file
+
+**/
+EFI_STATUS
+FindFileEx (
+  IN  CONST EFI_PEI_FV_HANDLE    FvHandle,
+  IN  CONST EFI_GUID             *FileName    OPTIONAL,
+  IN        EFI_FV_FILETYPE      SearchType,
+  IN OUT    EFI_PEI_FILE_HANDLE  *FileHandle,
+  IN OUT    EFI_PEI_FILE_HANDLE  *AprioriFile  OPTIONAL
+  )
+{
+  PEI_CORE_FV_HANDLE  *CoreFvHandle;
+
+  CoreFvHandle = FvHandleToCoreHandle (FvHandle);
+  if ((CoreFvHandle != NULL) && !CoreFvHandle->FileDirectoryValid && !CoreFvHandle->FileDirectoryFailed) {
+    BuildFvFileDirectory (CoreFvHandle);
+  }
+
+  if ((CoreFvHandle == NULL) || !CoreFvHandle->FileDirectoryValid) {
+    return FindFileInFv (FvHandle, FileName, SearchType, FileHandle, AprioriFile);
+  }
+
+  return FindFileInFvFileDirectory (CoreFvHandle, FileName, SearchType, FileHandle, AprioriFile);
+}
+
 /**
   Initialize PeiCore FV List.
 
@@ -0,0 +1,261 @@
+/** @file
+  Free memory range list of the PEI Core.
+
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "FreeRange.h"
+
+/**
+  Find the first free range above an address.
+
+  @param[in] List       The free range list.
+  @param[in] Address    The address.
+
+  @return The index of the first free range whose base is above Address, or the
+          number of free ranges if there is no such free range.
+
+**/
+STATIC
+UINTN
+FindFreeRangeAbove (
+  IN CONST PEI_FREE_RANGE_LIST  *List,
+  IN EFI_PHYSICAL_ADDRESS       Address
+  )
+{
+  UINTN  Low;
+  UINTN  High;
+  UINTN  Middle;
+
+  Low  = 0;
+  High = List->Count;
+  while (Low < High) {
+    Middle = (Low + High) / 2;
+    if (List->Ranges[Middle].Base > Address) {
+      High = Middle;
+    } else {
+      Low = Middle + 1;
+    }
+  }
+
+  return Low;
+}
+
+/**
+  Remove an entry of the free range list.
+
+  @param[in, out] List      The free range list.
+  @param[in]      Index     The index of the entry to remove.
+
+**/
+STATIC
+VOID
+RemoveFreeRangeEntry (
+  IN OUT PEI_FREE_RANGE_LIST  *List,
+  IN     UINTN                Index
+  )
+{
+  ASSERT (Index < List->Count);
+
+  CopyMem (
+    &List->Ranges[Index],
+    &List->Ranges[Index + 1],
+    (List->Count - Index - 1) * sizeof (PEI_FREE_RANGE)
+    );
+  List->Count--;
+}
+
+/**
+  Insert an entry in the free range list.
+
+  @param[in, out] List      The free range list.
+  @param[in]      Index     The index of the new entry.
+  @param[in]      Base      The base address of the free range.
+  @param[in]      Length    The length in bytes of the free range.
+
+  @retval EFI_SUCCESS           The entry was inserted.
+  @retval EFI_OUT_OF_RESOURCES  The list is full.
+
+**/
+STATIC
+EFI_STATUS
+InsertFreeRangeEntry (
+  IN OUT PEI_FREE_RANGE_LIST   *List,
+  IN     UINTN                 Index,
+  IN     EFI_PHYSICAL_ADDRESS  Base,
+  IN     UINT64                Length
+  )
+{
+  ASSERT (Index <= List->Count);
+
+  if (List->Count >= List->MaxCount) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  CopyMem (
+    &List->Ranges[Index + 1],
+    &List->Ranges[Index],
+    (List->Count - Index) * sizeof (PEI_FREE_RANGE)
+    );
+  List->Ranges[Index].Base   = Base;
+  List->Ranges[Index].Length = Length;
+  List->Count++;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Add a range of free memory to the free range list, merging it with the
+  adjacent free ranges.
+
+  @param[in, out] List          The free range list.
+  @param[in]      Base          The base address of the free memory.
+  @param[in]      Length        The length in bytes of the free memory.
+
+  @retval EFI_SUCCESS           The range was added.
+  @retval EFI_INVALID_PARAMETER Length is 0, or the range overlaps a free range.
+  @retval EFI_OUT_OF_RESOURCES  The range needs a new entry and the list is full.
+
+**/
+EFI_STATUS
+PeiFreeRangeAdd (
+  IN OUT PEI_FREE_RANGE_LIST   *List,
+  IN     EFI_PHYSICAL_ADDRESS  Base,
+  IN     UINT64                Length
+  )
+{
+  UINTN           Index;
+  PEI_FREE_RANGE  *Previous;
+  PEI_FREE_RANGE  *Next;
+  BOOLEAN         MergePrevious;
+  BOOLEAN         MergeNext;
+
+  if (Length == 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Index    = FindFreeRangeAbove (List, Base);
+  Previous = (Index > 0) ? &List->Ranges[Index - 1] : NULL;
+  Next     = (Index < List->Count) ? &List->Ranges[Index] : NULL;
+
+  if (((Previous != NULL) && (Previous->Base + Previous->Length > Base)) ||
+      ((Next != NULL) && (Base + Length > Next->Base)))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  MergePrevious = (BOOLEAN)((Previous != NULL) && (Previous->Base + Previous->Length == Base));
+  MergeNext     = (BOOLEAN)((Next != NULL) && (Base + Length == Next->Base));
+
+  if (MergePrevious && MergeNext) {
+    Previous->Length += Length + Next->Length;
+    RemoveFreeRangeEntry (List, Index);
+  } else if (MergePrevious) {
+    Previous->Length += Length;
+  } else if (MergeNext) {
+    Next->Base    = Base;
+    Next->Length += Length;
+  } else {
+    return InsertFreeRangeEntry (List, Index, Base, Length);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Allocate memory from the free range list.
+
+  Like the allocations from the PHIT, the memory is allocated top down: from
+  the top of the highest free range that can hold it.
+
+  @param[in, out] List          The free range list.
+  @param[in]      Length        The length in bytes of the memory to allocate.
+  @param[in]      Granularity   The alignment of the base address of the memory.
+  @param[out]     Base          The base address of the allocated memory.
+
+  @retval EFI_SUCCESS           The memory was allocated.
+  @retval EFI_NOT_FOUND         No free range can hold the memory.
+
+**/
+EFI_STATUS
+PeiFreeRangeAllocate (
+  IN OUT PEI_FREE_RANGE_LIST   *List,
+  IN     UINT64                Length,
+  IN     UINTN                 Granularity,
+  OUT    EFI_PHYSICAL_ADDRESS  *Base
+  )
+{
+  UINTN                 Index;
+  PEI_FREE_RANGE        *Range;
+  EFI_PHYSICAL_ADDRESS  Start;
+  EFI_PHYSICAL_ADDRESS  End;
+
+  for (Index = List->Count; Index > 0; Index--) {
+    Range = &List->Ranges[Index - 1];
+    if (Range->Length < Length) {
+      continue;
+    }
+
+    End   = Range->Base + Range->Length;
+    Start = (End - Length) & ~((EFI_PHYSICAL_ADDRESS)Granularity - 1);
+    if (Start < Range->Base) {
+      continue;
+    }
+
+    if ((Start > Range->Base) && (Start + Length < End)) {
+      //
+      // The allocation splits the free range in two. Skip the free range if
+      // there is no room for the free memory above the allocation.
+      //
+      if (EFI_ERROR (InsertFreeRangeEntry (List, Index, Start + Length, End - (Start + Length)))) {
+        continue;
+      }
+
+      Range->Length = Start - Range->Base;
+    } else if (Start > Range->Base) {
+      Range->Length = Start - Range->Base;
+    } else if (Start + Length < End) {
+      Range->Base   = Start + Length;
+      Range->Length = End - Range->Base;
+    } else {
+      RemoveFreeRangeEntry (List, Index - 1);
+    }
+
+    *Base = Start;
+    return EFI_SUCCESS;
+  }
+
+  return EFI_NOT_FOUND;
+}
+
+/**
+  Remove the free range that starts at an address from the free range list.
+
+  @param[in, out] List          The free range list.
+  @param[in]      Base          The base address of the free range.
+  @param[out]     Length        The length in bytes of the removed free range.
+
+  @retval EFI_SUCCESS           The free range was removed.
+  @retval EFI_NOT_FOUND         No free range starts at Base.
+
+**/
+EFI_STATUS
+PeiFreeRangeRemove (
+  IN OUT PEI_FREE_RANGE_LIST   *List,
+  IN     EFI_PHYSICAL_ADDRESS  Base,
+  OUT    UINT64                *Length
+  )
+{
+  UINTN  Index;
+
+  Index = FindFreeRangeAbove (List, Base);
+  if ((Index == 0) || (List->Ranges[Index - 1].Base != Base)) {
+    return EFI_NOT_FOUND;
+  }
+
+  *Length = List->Ranges[Index - 1].Length;
+  RemoveFreeRangeEntry (List, Index - 1);
+
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,103 @@
+/** @file
+  Definition of the free memory range list of the PEI Core.
+
+  The PEI Core keeps the pages freed in permanent memory in a list of free
+  ranges, sorted by address, instead of in memory allocation HOBs of type
+  EfiConventionalMemory, so that they can be found and merged without walking
+  the HOB list.
+
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _PEI_FREE_RANGE_H_
+#define _PEI_FREE_RANGE_H_
+
+#include <PiPei.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+
+///
+/// A range of free memory.
+///
+typedef struct {
+  EFI_PHYSICAL_ADDRESS    Base;
+  UINT64                  Length;
+} PEI_FREE_RANGE;
+
+///
+/// The free memory ranges. They are sorted by Base, and do not overlap or
+/// touch each other: adjacent ranges are merged when they are added.
+///
+typedef struct {
+  UINTN             Count;
+  UINTN             MaxCount;
+  ///
+  /// MaxCount number of entries.
+  ///
+  PEI_FREE_RANGE    *Ranges;
+} PEI_FREE_RANGE_LIST;
+
+/**
+  Add a range of free memory to the free range list, merging it with the
+  adjacent free ranges.
+
+  @param[in, out] List          The free range list.
+  @param[in]      Base          The base address of the free memory.
+  @param[in]      Length        The length in bytes of the free memory.
+
+  @retval EFI_SUCCESS           The range was added.
+  @retval EFI_INVALID_PARAMETER Length is 0, or the range overlaps a free range.
+  @retval EFI_OUT_OF_RESOURCES  The range needs a new entry and the list is full.
+
+**/
+EFI_STATUS
+PeiFreeRangeAdd (
+  IN OUT PEI_FREE_RANGE_LIST   *List,
+  IN     EFI_PHYSICAL_ADDRESS  Base,
+  IN     UINT64                Length
+  );
+
+/**
+  Allocate memory from the free range list.
+
+  Like the allocations from the PHIT, the memory is allocated top down: from
+  the top of the highest free range that can hold it.
+
+  @param[in, out] List          The free range list.
+  @param[in]      Length        The length in bytes of the memory to allocate.
+  @param[in]      Granularity   The alignment of the base address of the memory.
+  @param[out]     Base          The base address of the allocated memory.
+
+  @retval EFI_SUCCESS           The memory was allocated.
+  @retval EFI_NOT_FOUND         No free range can hold the memory.
+
+**/
+EFI_STATUS
+PeiFreeRangeAllocate (
+  IN OUT PEI_FREE_RANGE_LIST   *List,
+  IN     UINT64                Length,
+  IN     UINTN                 Granularity,
+  OUT    EFI_PHYSICAL_ADDRESS  *Base
+  );
+
+/**
+  Remove the free range that starts at an address from the free range list.
+
+  @param[in, out] List          The free range list.
+  @param[in]      Base          The base address of the free range.
+  @param[out]     Length        The length in bytes of the removed free range.
+
+  @retval EFI_SUCCESS           The free range was removed.
+  @retval EFI_NOT_FOUND         No free range starts at Base.
+
+**/
+EFI_STATUS
+PeiFreeRangeRemove (
+  IN OUT PEI_FREE_RANGE_LIST   *List,
+  IN     EFI_PHYSICAL_ADDRESS  Base,
+  OUT    UINT64                *Length
+  );
+
+#endif
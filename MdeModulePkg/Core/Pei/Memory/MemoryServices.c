@@ -8,6 +8,89 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 #include "PeiMain.h"
 
+/**
+  Build the memory allocation HOBs of type EfiConventionalMemory for the free
+  memory ranges at the end of PEI, and keep the pages freed after it in such
+  HOBs.
+
+  @param PeiServices      An indirect pointer to the EFI_PEI_SERVICES table published by the PEI Foundation.
+  @param NotifyDescriptor Address of the notification descriptor data structure.
+  @param Ppi              Address of the PPI that was installed.
+
+  @return EFI_SUCCESS     Always success.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+FreeRangeEndOfPeiNotify (
+  IN EFI_PEI_SERVICES           **PeiServices,
+  IN EFI_PEI_NOTIFY_DESCRIPTOR  *NotifyDescriptor,
+  IN VOID                       *Ppi
+  );
+
+STATIC EFI_PEI_NOTIFY_DESCRIPTOR  mFreeRangeNotifyList = {
+  (EFI_PEI_PPI_DESCRIPTOR_NOTIFY_CALLBACK | EFI_PEI_PPI_DESCRIPTOR_TERMINATE_LIST),
+  &gEfiEndOfPeiSignalPpiGuid,
+  FreeRangeEndOfPeiNotify
+};
+
+/**
+  Initialize the free memory range list once the permanent memory is installed,
+  and move the pages freed before, which are in memory allocation HOBs of type
+  EfiConventionalMemory, to it.
+
+  @param PrivateData     Points to PeiCore's private instance data.
+
+**/
+STATIC
+VOID
+InitializeFreeRanges (
+  IN PEI_CORE_INSTANCE  *PrivateData
+  )
+{
+  EFI_STATUS                 Status;
+  EFI_PHYSICAL_ADDRESS       Memory;
+  EFI_PEI_HOB_POINTERS       Hob;
+  EFI_HOB_MEMORY_ALLOCATION  *MemoryAllocationHob;
+
+  Status = PeiAllocatePages (
+             (CONST EFI_PEI_SERVICES **)&PrivateData->Ps,
+             EfiBootServicesData,
+             FREE_RANGE_LIST_PAGES,
+             &Memory
+             );
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+
+  PrivateData->FreeRanges.Count    = 0;
+  PrivateData->FreeRanges.MaxCount = EFI_PAGES_TO_SIZE (FREE_RANGE_LIST_PAGES) / sizeof (PEI_FREE_RANGE);
+  PrivateData->FreeRanges.Ranges   = (PEI_FREE_RANGE *)(UINTN)Memory;
+
+  Hob.Raw = GetFirstHob (EFI_HOB_TYPE_MEMORY_ALLOCATION);
+  while (Hob.Raw != NULL) {
+    MemoryAllocationHob = (EFI_HOB_MEMORY_ALLOCATION *)Hob.Raw;
+    if ((MemoryAllocationHob->AllocDescriptor.MemoryType == EfiConventionalMemory) &&
+        !EFI_ERROR (
+           PeiFreeRangeAdd (
+             &PrivateData->FreeRanges,
+             MemoryAllocationHob->AllocDescriptor.MemoryBaseAddress,
+             MemoryAllocationHob->AllocDescriptor.MemoryLength
+             )
+           ))
+    {
+      MemoryAllocationHob->Header.HobType = EFI_HOB_TYPE_UNUSED;
+    }
+
+    Hob.Raw = GET_NEXT_HOB (Hob);
+    Hob.Raw = GetNextHob (EFI_HOB_TYPE_MEMORY_ALLOCATION, Hob.Raw);
+  }
+
+  Status = PeiServicesNotifyPpi (&mFreeRangeNotifyList);
+  ASSERT_EFI_ERROR (Status);
+}
+
 /**
 
   Initialize the memory services.
@@ -47,6 +130,12 @@ InitializeMemoryServices (
     // Set Ps to point to ServiceTableShadow in Cache
     //
     PrivateData->Ps = &(PrivateData->ServiceTableShadow);
+  } else if (PrivateData->PeiMemoryInstalled && (PrivateData->FreeRanges.Ranges == NULL)) {
+    //
+    // The PEI Core runs in permanent memory, keep the pages freed from now on
+    // in the free memory range list.
+    //
+    InitializeFreeRanges (PrivateData);
   }
 
   return;
@@ -357,6 +446,32 @@ InternalBuildMemoryAllocationHob (
   }
 }
 
+/**
+  Keep free memory pages in the free memory range list, or in a memory allocation
+  HOB of type EfiConventionalMemory if the list is not used or is full.
+
+  @param[in] PrivateData        Pointer to PeiCore's private data structure.
+  @param[in] BaseAddress        The 64 bit physical address of the memory.
+  @param[in] Length             The length of the memory in bytes.
+
+**/
+STATIC
+VOID
+AddFreeMemory (
+  IN PEI_CORE_INSTANCE     *PrivateData,
+  IN EFI_PHYSICAL_ADDRESS  BaseAddress,
+  IN UINT64                Length
+  )
+{
+  if ((PrivateData->FreeRanges.Ranges != NULL) &&
+      !EFI_ERROR (PeiFreeRangeAdd (&PrivateData->FreeRanges, BaseAddress, Length)))
+  {
+    return;
+  }
+
+  InternalBuildMemoryAllocationHob (BaseAddress, Length, EfiConventionalMemory);
+}
+
 /**
   Update or split memory allocation HOB for memory pages allocate and free.
 
@@ -666,10 +781,10 @@ PeiAllocatePages (
     // Create a memory allocation HOB to cover
     // the pages that we will lose to rounding
     //
-    InternalBuildMemoryAllocationHob (
+    AddFreeMemory (
+      PrivateData,
       *(FreeMemoryTop),
-      Padding & ~(UINTN)EFI_PAGE_MASK,
-      EfiConventionalMemory
+      Padding & ~(UINTN)EFI_PAGE_MASK
       );
   }
 
@@ -682,6 +797,22 @@ PeiAllocatePages (
   //
   Pages = ALIGN_VALUE (Pages, EFI_SIZE_TO_PAGES (Granularity));
   if (RemainingPages < Pages) {
+    //
+    // Try to find free memory in the free memory range list.
+    //
+    if (PrivateData->FreeRanges.Ranges != NULL) {
+      Status = PeiFreeRangeAllocate (
+                 &PrivateData->FreeRanges,
+                 LShiftU64 (Pages, EFI_PAGE_SHIFT),
+                 Granularity,
+                 Memory
+                 );
+      if (!EFI_ERROR (Status)) {
+        InternalBuildMemoryAllocationHob (*Memory, LShiftU64 (Pages, EFI_PAGE_SHIFT), MemoryType);
+        return Status;
+      }
+    }
+
     //
     // Try to find free memory by searching memory allocation HOBs.
     //
@@ -784,6 +915,89 @@ FreeMemoryAllocationHob (
   }
 }
 
+/**
+  Free memory pages in permanent memory, with the free memory range list.
+
+  The pages are given back to the PHIT if they are at its free memory top, with
+  the free memory range right above them, and are added to the free memory range
+  list otherwise.
+
+  @param[in] PrivateData        Pointer to PeiCore's private data structure.
+  @param[in] Memory             The base physical address of the pages to be freed.
+  @param[in] Bytes              The length of the pages to be freed in bytes.
+
+**/
+STATIC
+VOID
+FreeMemoryRange (
+  IN PEI_CORE_INSTANCE     *PrivateData,
+  IN EFI_PHYSICAL_ADDRESS  Memory,
+  IN UINT64                Bytes
+  )
+{
+  EFI_PHYSICAL_ADDRESS  *FreeMemoryTop;
+  UINT64                Length;
+
+  FreeMemoryTop = &(PrivateData->HobList.HandoffInformationTable->EfiFreeMemoryTop);
+  if (Memory == *FreeMemoryTop) {
+    //
+    // The free memory ranges are merged, so only one can start at the new top.
+    //
+    *FreeMemoryTop += Bytes;
+    if (!EFI_ERROR (PeiFreeRangeRemove (&PrivateData->FreeRanges, *FreeMemoryTop, &Length))) {
+      *FreeMemoryTop += Length;
+    }
+  } else {
+    AddFreeMemory (PrivateData, Memory, Bytes);
+  }
+}
+
+/**
+  Build the memory allocation HOBs of type EfiConventionalMemory for the free
+  memory ranges at the end of PEI, and keep the pages freed after it in such
+  HOBs.
+
+  @param PeiServices      An indirect pointer to the EFI_PEI_SERVICES table published by the PEI Foundation.
+  @param NotifyDescriptor Address of the notification descriptor data structure.
+  @param Ppi              Address of the PPI that was installed.
+
+  @return EFI_SUCCESS     Always success.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+FreeRangeEndOfPeiNotify (
+  IN EFI_PEI_SERVICES           **PeiServices,
+  IN EFI_PEI_NOTIFY_DESCRIPTOR  *NotifyDescriptor,
+  IN VOID                       *Ppi
+  )
+{
+  PEI_CORE_INSTANCE  *PrivateData;
+  PEI_FREE_RANGE     *Ranges;
+  UINTN              Index;
+
+  PrivateData = PEI_CORE_INSTANCE_FROM_PS_THIS (PeiServices);
+  Ranges      = PrivateData->FreeRanges.Ranges;
+  if (Ranges == NULL) {
+    return EFI_SUCCESS;
+  }
+
+  for (Index = 0; Index < PrivateData->FreeRanges.Count; Index++) {
+    InternalBuildMemoryAllocationHob (Ranges[Index].Base, Ranges[Index].Length, EfiConventionalMemory);
+  }
+
+  ZeroMem (&PrivateData->FreeRanges, sizeof (PrivateData->FreeRanges));
+
+  PeiFreePages (
+    (CONST EFI_PEI_SERVICES **)PeiServices,
+    (EFI_PHYSICAL_ADDRESS)(UINTN)Ranges,
+    FREE_RANGE_LIST_PAGES
+    );
+
+  return EFI_SUCCESS;
+}
+
 /**
   Frees memory pages.
 
@@ -850,7 +1064,13 @@ PeiFreePages (
 
   if (MemoryAllocationHob != NULL) {
     UpdateOrSplitMemoryAllocationHob (MemoryAllocationHob, Memory, Bytes, EfiConventionalMemory);
-    FreeMemoryAllocationHob (PrivateData, MemoryAllocationHob);
+    if (PrivateData->FreeRanges.Ranges != NULL) {
+      MemoryAllocationHob->Header.HobType = EFI_HOB_TYPE_UNUSED;
+      FreeMemoryRange (PrivateData, Memory, Bytes);
+    } else {
+      FreeMemoryAllocationHob (PrivateData, MemoryAllocationHob);
+    }
+
     return EFI_SUCCESS;
   } else {
     return EFI_NOT_FOUND;
@@ -26,6 +26,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Ppi/TemporaryRamDone.h>
 #include <Ppi/SecHobData.h>
 #include <Ppi/PeiCoreFvLocation.h>
+#include <Ppi/EndOfPeiPhase.h>
 #include <Library/DebugLib.h>
 #include <Library/PeiCoreEntryPoint.h>
 #include <Library/BaseLib.h>
@@ -46,12 +47,20 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Guid/AprioriFileName.h>
 #include <Guid/MigratedFvInfo.h>
 
+#include "Memory/FreeRange.h"
+
 ///
 /// It is an FFS type extension used for PeiFindFileEx. It indicates current
 /// FFS searching is for all PEIMs can be dispatched by PeiCore.
 ///
 #define PEI_CORE_INTERNAL_FFS_FILE_DISPATCH_TYPE  0xff
 
+///
+/// It is an FFS type extension used for PeiFindFileEx. It indicates current
+/// FFS searching is for all files, including the pad files.
+///
+#define PEI_CORE_INTERNAL_FFS_FILE_ANY_TYPE  0xfe
+
 ///
 /// Pei Core private data structures
 ///
@@ -76,6 +85,10 @@ typedef struct {
   /// MaxCount number of entries.
   ///
   PEI_PPI_LIST_POINTERS    *PpiPtrs;
+  ///
+  /// MaxCount number of entries, the GUID hash of each entry of PpiPtrs.
+  ///
+  UINT8                    *Hash;
 } PEI_PPI_LIST;
 
 typedef struct {
@@ -85,6 +98,10 @@ typedef struct {
   /// MaxCount number of entries.
   ///
   PEI_PPI_LIST_POINTERS    *NotifyPtrs;
+  ///
+  /// MaxCount number of entries, the GUID hash of each entry of NotifyPtrs.
+  ///
+  UINT8                    *Hash;
 } PEI_CALLBACK_NOTIFY_LIST;
 
 typedef struct {
@@ -95,12 +112,21 @@ typedef struct {
   /// MaxCount number of entries.
   ///
   PEI_PPI_LIST_POINTERS    *NotifyPtrs;
+  ///
+  /// MaxCount number of entries, the GUID hash of each entry of NotifyPtrs.
+  ///
+  UINT8                    *Hash;
 } PEI_DISPATCH_NOTIFY_LIST;
 
 ///
 /// PPI database structure which contains three links:
 /// PpiList, CallbackNotifyList and DispatchNotifyList.
 ///
+/// Each list keeps a one byte hash of the GUID of its entries next to the
+/// pointers, so that the lists can be searched without reading the descriptor
+/// and GUID of every entry. The hash only depends on the GUID value, so it is
+/// not affected by the migration of the descriptors to permanent memory.
+///
 typedef struct {
   ///
   /// PPI List.
@@ -131,6 +157,16 @@ typedef struct {
 //
 #define FV_GROWTH_STEP  8
 
+///
+/// An entry of the file directory of a FV. The offset is relative to the
+/// FV header, so the entry stays valid when the FV is migrated.
+///
+typedef struct {
+  EFI_GUID           Name;
+  UINT32             Offset;
+  EFI_FV_FILETYPE    Type;
+} PEI_CORE_FV_FILE_ENTRY;
+
 typedef struct {
   EFI_FIRMWARE_VOLUME_HEADER     *FvHeader;
   EFI_PEI_FIRMWARE_VOLUME_PPI    *FvPpi;
@@ -146,6 +182,16 @@ typedef struct {
   EFI_PEI_FILE_HANDLE            *FvFileHandles;
   BOOLEAN                        ScanFv;
   UINT32                         AuthenticationStatus;
+  //
+  // The files of the FV in the order of the FV.
+  // Pointer to the buffer with the FileCount number of Entries, valid when
+  // FileDirectoryValid is TRUE. FileDirectoryFailed is TRUE when the directory
+  // could not be built, and the files are then searched in the FV itself.
+  //
+  BOOLEAN                        FileDirectoryValid;
+  BOOLEAN                        FileDirectoryFailed;
+  UINTN                          FileCount;
+  PEI_CORE_FV_FILE_ENTRY         *FileDirectory;
 } PEI_CORE_FV_HANDLE;
 
 typedef struct {
@@ -166,6 +212,11 @@ typedef struct {
   UINTN                        SectionIndex;
 } CACHE_SECTION_DATA;
 
+///
+/// Number of pages of the free memory range list
+///
+#define FREE_RANGE_LIST_PAGES  1
+
 #define HOLE_MAX_NUMBER  0x3
 typedef struct {
   EFI_PHYSICAL_ADDRESS    Base;
@@ -307,6 +358,13 @@ struct _PEI_CORE_INSTANCE {
   // Those Memory Range will be migrated into physical memory.
   //
   HOLE_MEMORY_DATA                  HoleData[HOLE_MAX_NUMBER];
+
+  //
+  // The pages freed in permanent memory. Ranges is NULL before the permanent
+  // memory is installed and after the end of PEI, when the freed pages are
+  // kept in memory allocation HOBs of type EfiConventionalMemory instead.
+  //
+  PEI_FREE_RANGE_LIST               FreeRanges;
 };
 
 ///
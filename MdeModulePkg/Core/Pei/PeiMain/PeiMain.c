@@ -219,14 +219,26 @@ PeiCore (
           OldCoreData->PpiData.PpiList.PpiPtrs = (PEI_PPI_LIST_POINTERS *)((UINT8 *)OldCoreData->PpiData.PpiList.PpiPtrs + OldCoreData->HeapOffset);
         }
 
+        if (OldCoreData->PpiData.PpiList.Hash != NULL) {
+          OldCoreData->PpiData.PpiList.Hash = (UINT8 *)OldCoreData->PpiData.PpiList.Hash + OldCoreData->HeapOffset;
+        }
+
         if (OldCoreData->PpiData.CallbackNotifyList.NotifyPtrs != NULL) {
           OldCoreData->PpiData.CallbackNotifyList.NotifyPtrs = (PEI_PPI_LIST_POINTERS *)((UINT8 *)OldCoreData->PpiData.CallbackNotifyList.NotifyPtrs + OldCoreData->HeapOffset);
         }
 
+        if (OldCoreData->PpiData.CallbackNotifyList.Hash != NULL) {
+          OldCoreData->PpiData.CallbackNotifyList.Hash = (UINT8 *)OldCoreData->PpiData.CallbackNotifyList.Hash + OldCoreData->HeapOffset;
+        }
+
         if (OldCoreData->PpiData.DispatchNotifyList.NotifyPtrs != NULL) {
           OldCoreData->PpiData.DispatchNotifyList.NotifyPtrs = (PEI_PPI_LIST_POINTERS *)((UINT8 *)OldCoreData->PpiData.DispatchNotifyList.NotifyPtrs + OldCoreData->HeapOffset);
         }
 
+        if (OldCoreData->PpiData.DispatchNotifyList.Hash != NULL) {
+          OldCoreData->PpiData.DispatchNotifyList.Hash = (UINT8 *)OldCoreData->PpiData.DispatchNotifyList.Hash + OldCoreData->HeapOffset;
+        }
+
         OldCoreData->Fv = (PEI_CORE_FV_HANDLE *)((UINT8 *)OldCoreData->Fv + OldCoreData->HeapOffset);
         for (Index = 0; Index < OldCoreData->FvCount; Index++) {
           if (OldCoreData->Fv[Index].PeimState != NULL) {
@@ -236,6 +248,10 @@ PeiCore (
           if (OldCoreData->Fv[Index].FvFileHandles != NULL) {
             OldCoreData->Fv[Index].FvFileHandles = (EFI_PEI_FILE_HANDLE *)((UINT8 *)OldCoreData->Fv[Index].FvFileHandles + OldCoreData->HeapOffset);
           }
+
+          if (OldCoreData->Fv[Index].FileDirectory != NULL) {
+            OldCoreData->Fv[Index].FileDirectory = (PEI_CORE_FV_FILE_ENTRY *)((UINT8 *)OldCoreData->Fv[Index].FileDirectory + OldCoreData->HeapOffset);
+          }
         }
 
         OldCoreData->TempFileGuid    = (EFI_GUID *)((UINT8 *)OldCoreData->TempFileGuid + OldCoreData->HeapOffset);
@@ -254,14 +270,26 @@ PeiCore (
           OldCoreData->PpiData.PpiList.PpiPtrs = (PEI_PPI_LIST_POINTERS *)((UINT8 *)OldCoreData->PpiData.PpiList.PpiPtrs - OldCoreData->HeapOffset);
         }
 
+        if (OldCoreData->PpiData.PpiList.Hash != NULL) {
+          OldCoreData->PpiData.PpiList.Hash = (UINT8 *)OldCoreData->PpiData.PpiList.Hash - OldCoreData->HeapOffset;
+        }
+
         if (OldCoreData->PpiData.CallbackNotifyList.NotifyPtrs != NULL) {
           OldCoreData->PpiData.CallbackNotifyList.NotifyPtrs = (PEI_PPI_LIST_POINTERS *)((UINT8 *)OldCoreData->PpiData.CallbackNotifyList.NotifyPtrs - OldCoreData->HeapOffset);
         }
 
+        if (OldCoreData->PpiData.CallbackNotifyList.Hash != NULL) {
+          OldCoreData->PpiData.CallbackNotifyList.Hash = (UINT8 *)OldCoreData->PpiData.CallbackNotifyList.Hash - OldCoreData->HeapOffset;
+        }
+
         if (OldCoreData->PpiData.DispatchNotifyList.NotifyPtrs != NULL) {
           OldCoreData->PpiData.DispatchNotifyList.NotifyPtrs = (PEI_PPI_LIST_POINTERS *)((UINT8 *)OldCoreData->PpiData.DispatchNotifyList.NotifyPtrs - OldCoreData->HeapOffset);
         }
 
+        if (OldCoreData->PpiData.DispatchNotifyList.Hash != NULL) {
+          OldCoreData->PpiData.DispatchNotifyList.Hash = (UINT8 *)OldCoreData->PpiData.DispatchNotifyList.Hash - OldCoreData->HeapOffset;
+        }
+
         OldCoreData->Fv = (PEI_CORE_FV_HANDLE *)((UINT8 *)OldCoreData->Fv - OldCoreData->HeapOffset);
         for (Index = 0; Index < OldCoreData->FvCount; Index++) {
           if (OldCoreData->Fv[Index].PeimState != NULL) {
@@ -271,6 +299,10 @@ PeiCore (
           if (OldCoreData->Fv[Index].FvFileHandles != NULL) {
             OldCoreData->Fv[Index].FvFileHandles = (EFI_PEI_FILE_HANDLE *)((UINT8 *)OldCoreData->Fv[Index].FvFileHandles - OldCoreData->HeapOffset);
           }
+
+          if (OldCoreData->Fv[Index].FileDirectory != NULL) {
+            OldCoreData->Fv[Index].FileDirectory = (PEI_CORE_FV_FILE_ENTRY *)((UINT8 *)OldCoreData->Fv[Index].FileDirectory - OldCoreData->HeapOffset);
+          }
         }
 
         OldCoreData->TempFileGuid    = (EFI_GUID *)((UINT8 *)OldCoreData->TempFileGuid - OldCoreData->HeapOffset);
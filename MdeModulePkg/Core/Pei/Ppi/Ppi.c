@@ -163,7 +163,12 @@ ConvertPpiPointers (
   IN PEI_CORE_INSTANCE           *PrivateData
   )
 {
-  UINT8  Index;
+  UINTN  Index;
+
+  //
+  // The GUID hashes of the lists do not need to be converted, as the GUIDs
+  // keep their values when they are migrated.
+  //
 
   //
   // Convert normal PPIs.
@@ -427,6 +432,63 @@ DumpPpiList (
   DEBUG_CODE_END ();
 }
 
+/**
+  Compute the one byte hash of a GUID kept in the PPI database.
+
+  @param Guid           Pointer to the GUID.
+
+  @return The hash of the GUID.
+
+**/
+STATIC
+UINT8
+PpiGuidHash (
+  IN CONST EFI_GUID  *Guid
+  )
+{
+  UINT32  Value;
+
+  Value  = ((UINT32 *)Guid)[0] ^ ((UINT32 *)Guid)[1] ^ ((UINT32 *)Guid)[2] ^ ((UINT32 *)Guid)[3];
+  Value ^= Value >> 16;
+  return (UINT8)(Value ^ (Value >> 8));
+}
+
+/**
+  Grow the pointer and hash arrays of a list of the PPI database.
+
+  @param Ptrs           On input, the pointer array of the list.
+                        On output, the grown pointer array.
+  @param Hash           On input, the hash array of the list.
+                        On output, the grown hash array.
+  @param MaxCount       On input, the number of entries of the arrays.
+                        On output, the number of entries of the grown arrays.
+  @param GrowthStep     The number of entries to grow the arrays by.
+
+**/
+STATIC
+VOID
+GrowPpiList (
+  IN OUT PEI_PPI_LIST_POINTERS  **Ptrs,
+  IN OUT UINT8                  **Hash,
+  IN OUT UINTN                  *MaxCount,
+  IN     UINTN                  GrowthStep
+  )
+{
+  VOID  *TempPtr;
+
+  TempPtr = AllocateZeroPool (sizeof (PEI_PPI_LIST_POINTERS) * (*MaxCount + GrowthStep));
+  ASSERT (TempPtr != NULL);
+  CopyMem (TempPtr, *Ptrs, sizeof (PEI_PPI_LIST_POINTERS) * *MaxCount);
+  *Ptrs = TempPtr;
+
+  TempPtr = AllocateZeroPool (*MaxCount + GrowthStep);
+  ASSERT (TempPtr != NULL);
+  CopyMem (TempPtr, *Hash, *MaxCount);
+  *Hash = TempPtr;
+
+  *MaxCount = *MaxCount + GrowthStep;
+}
+
 /**
 
   This function installs an interface in the PEI PPI database by GUID.
@@ -456,7 +518,6 @@ InternalPeiInstallPpi (
   PEI_PPI_LIST       *PpiListPointer;
   UINTN              Index;
   UINTN              LastCount;
-  VOID               *TempPtr;
 
   if (PpiList == NULL) {
     return EFI_INVALID_PARAMETER;
@@ -490,21 +551,17 @@ InternalPeiInstallPpi (
       //
       // Run out of room, grow the buffer.
       //
-      TempPtr = AllocateZeroPool (
-                  sizeof (PEI_PPI_LIST_POINTERS) * (PpiListPointer->MaxCount + PPI_GROWTH_STEP)
-                  );
-      ASSERT (TempPtr != NULL);
-      CopyMem (
-        TempPtr,
-        PpiListPointer->PpiPtrs,
-        sizeof (PEI_PPI_LIST_POINTERS) * PpiListPointer->MaxCount
+      GrowPpiList (
+        &PpiListPointer->PpiPtrs,
+        &PpiListPointer->Hash,
+        &PpiListPointer->MaxCount,
+        PPI_GROWTH_STEP
         );
-      PpiListPointer->PpiPtrs  = TempPtr;
-      PpiListPointer->MaxCount = PpiListPointer->MaxCount + PPI_GROWTH_STEP;
     }
 
     DEBUG ((DEBUG_INFO, "Install PPI: %g\n", PpiList->Guid));
     PpiListPointer->PpiPtrs[Index].Ppi = (EFI_PEI_PPI_DESCRIPTOR *)PpiList;
+    PpiListPointer->Hash[Index]        = PpiGuidHash (PpiList->Guid);
     Index++;
     PpiListPointer->CurrentCount++;
 
@@ -625,6 +682,7 @@ PeiReInstallPpi (
   //
   DEBUG ((DEBUG_INFO, "Reinstall PPI: %g\n", NewPpi->Guid));
   PrivateData->PpiData.PpiList.PpiPtrs[Index].Ppi = (EFI_PEI_PPI_DESCRIPTOR *)NewPpi;
+  PrivateData->PpiData.PpiList.Hash[Index]        = PpiGuidHash (NewPpi->Guid);
 
   //
   // Process any callback level notifies for the newly installed PPI.
@@ -669,15 +727,24 @@ PeiLocatePpi (
 {
   PEI_CORE_INSTANCE       *PrivateData;
   UINTN                   Index;
+  UINT8                   Hash;
   EFI_GUID                *CheckGuid;
   EFI_PEI_PPI_DESCRIPTOR  *TempPtr;
 
   PrivateData = PEI_CORE_INSTANCE_FROM_PS_THIS (PeiServices);
+  Hash        = PpiGuidHash (Guid);
 
   //
   // Search the data base for the matching instance of the GUIDed PPI.
   //
   for (Index = 0; Index < PrivateData->PpiData.PpiList.CurrentCount; Index++) {
+    //
+    // Skip the PPIs with a different GUID hash without reading their descriptor.
+    //
+    if (PrivateData->PpiData.PpiList.Hash[Index] != Hash) {
+      continue;
+    }
+
     TempPtr   = PrivateData->PpiData.PpiList.PpiPtrs[Index].Ppi;
     CheckGuid = TempPtr->Guid;
 
@@ -741,7 +808,6 @@ InternalPeiNotifyPpi (
   PEI_DISPATCH_NOTIFY_LIST  *DispatchNotifyListPointer;
   UINTN                     DispatchNotifyIndex;
   UINTN                     LastDispatchNotifyCount;
-  VOID                      *TempPtr;
 
   if (NotifyList == NULL) {
     return EFI_INVALID_PARAMETER;
@@ -779,20 +845,16 @@ InternalPeiNotifyPpi (
         //
         // Run out of room, grow the buffer.
         //
-        TempPtr = AllocateZeroPool (
-                    sizeof (PEI_PPI_LIST_POINTERS) * (CallbackNotifyListPointer->MaxCount + CALLBACK_NOTIFY_GROWTH_STEP)
-                    );
-        ASSERT (TempPtr != NULL);
-        CopyMem (
-          TempPtr,
-          CallbackNotifyListPointer->NotifyPtrs,
-          sizeof (PEI_PPI_LIST_POINTERS) * CallbackNotifyListPointer->MaxCount
+        GrowPpiList (
+          &CallbackNotifyListPointer->NotifyPtrs,
+          &CallbackNotifyListPointer->Hash,
+          &CallbackNotifyListPointer->MaxCount,
+          CALLBACK_NOTIFY_GROWTH_STEP
           );
-        CallbackNotifyListPointer->NotifyPtrs = TempPtr;
-        CallbackNotifyListPointer->MaxCount   = CallbackNotifyListPointer->MaxCount + CALLBACK_NOTIFY_GROWTH_STEP;
       }
 
       CallbackNotifyListPointer->NotifyPtrs[CallbackNotifyIndex].Notify = (EFI_PEI_NOTIFY_DESCRIPTOR *)NotifyList;
+      CallbackNotifyListPointer->Hash[CallbackNotifyIndex]              = PpiGuidHash (NotifyList->Guid);
       CallbackNotifyIndex++;
       CallbackNotifyListPointer->CurrentCount++;
     } else {
@@ -800,20 +862,16 @@ InternalPeiNotifyPpi (
         //
         // Run out of room, grow the buffer.
         //
-        TempPtr = AllocateZeroPool (
-                    sizeof (PEI_PPI_LIST_POINTERS) * (DispatchNotifyListPointer->MaxCount + DISPATCH_NOTIFY_GROWTH_STEP)
-                    );
-        ASSERT (TempPtr != NULL);
-        CopyMem (
-          TempPtr,
-          DispatchNotifyListPointer->NotifyPtrs,
-          sizeof (PEI_PPI_LIST_POINTERS) * DispatchNotifyListPointer->MaxCount
+        GrowPpiList (
+          &DispatchNotifyListPointer->NotifyPtrs,
+          &DispatchNotifyListPointer->Hash,
+          &DispatchNotifyListPointer->MaxCount,
+          DISPATCH_NOTIFY_GROWTH_STEP
           );
-        DispatchNotifyListPointer->NotifyPtrs = TempPtr;
-        DispatchNotifyListPointer->MaxCount   = DispatchNotifyListPointer->MaxCount + DISPATCH_NOTIFY_GROWTH_STEP;
       }
 
       DispatchNotifyListPointer->NotifyPtrs[DispatchNotifyIndex].Notify = (EFI_PEI_NOTIFY_DESCRIPTOR *)NotifyList;
+      DispatchNotifyListPointer->Hash[DispatchNotifyIndex]              = PpiGuidHash (NotifyList->Guid);
       DispatchNotifyIndex++;
       DispatchNotifyListPointer->CurrentCount++;
     }
@@ -968,20 +1026,37 @@ ProcessNotify (
 {
   INTN                       Index1;
   INTN                       Index2;
+  UINT8                      Hash;
   EFI_GUID                   *SearchGuid;
   EFI_GUID                   *CheckGuid;
   EFI_PEI_NOTIFY_DESCRIPTOR  *NotifyDescriptor;
 
   for (Index1 = NotifyStartIndex; Index1 < NotifyStopIndex; Index1++) {
+    //
+    // The lists may be grown by the notification functions, so always access
+    // them through PrivateData.
+    //
     if (NotifyType == EFI_PEI_PPI_DESCRIPTOR_NOTIFY_CALLBACK) {
-      NotifyDescriptor = PrivateData->PpiData.CallbackNotifyList.NotifyPtrs[Index1].Notify;
+      Hash = PrivateData->PpiData.CallbackNotifyList.Hash[Index1];
     } else {
-      NotifyDescriptor = PrivateData->PpiData.DispatchNotifyList.NotifyPtrs[Index1].Notify;
+      Hash = PrivateData->PpiData.DispatchNotifyList.Hash[Index1];
     }
 
-    CheckGuid = NotifyDescriptor->Guid;
-
     for (Index2 = InstallStartIndex; Index2 < InstallStopIndex; Index2++) {
+      //
+      // Only read the descriptors of the PPIs with the GUID hash of the notify.
+      //
+      if (PrivateData->PpiData.PpiList.Hash[Index2] != Hash) {
+        continue;
+      }
+
+      if (NotifyType == EFI_PEI_PPI_DESCRIPTOR_NOTIFY_CALLBACK) {
+        NotifyDescriptor = PrivateData->PpiData.CallbackNotifyList.NotifyPtrs[Index1].Notify;
+      } else {
+        NotifyDescriptor = PrivateData->PpiData.DispatchNotifyList.NotifyPtrs[Index1].Notify;
+      }
+
+      CheckGuid  = NotifyDescriptor->Guid;
       SearchGuid = PrivateData->PpiData.PpiList.PpiPtrs[Index2].Ppi->Guid;
       //
       // Don't use CompareGuid function here for performance reasons.
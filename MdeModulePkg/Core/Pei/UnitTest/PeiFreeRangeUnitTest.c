@@ -0,0 +1,519 @@
+/** @file
+  This is a host-based unit test for the free memory range list of the PEI Core.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <Library/UnitTestLib.h>
+
+#include "../Memory/FreeRange.h"
+
+#define UNIT_TEST_NAME     "PEI Core Free Range Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// The base address of the memory the tests free and allocate.
+//
+#define TEST_MEMORY_BASE  0x80000000ULL
+
+//
+// Number of pages of the memory the random test frees and allocates, and
+// number of operations it does.
+//
+#define TEST_RANDOM_PAGES       512
+#define TEST_RANDOM_OPERATIONS  20000
+
+#define TEST_MAX_RANGES  (TEST_RANDOM_PAGES / 2 + 1)
+
+PEI_FREE_RANGE       mRanges[TEST_MAX_RANGES];
+PEI_FREE_RANGE_LIST  mList;
+
+//
+// TRUE for the free pages of the random test.
+//
+BOOLEAN  mFreePage[TEST_RANDOM_PAGES];
+UINT32   mSeed;
+
+/**
+  Return the address of a test page.
+
+  @param[in] Page   The index of the page.
+
+  @return The address of the page.
+
+**/
+EFI_PHYSICAL_ADDRESS
+PageAddress (
+  IN UINTN  Page
+  )
+{
+  return TEST_MEMORY_BASE + EFI_PAGES_TO_SIZE (Page);
+}
+
+/**
+  Return a pseudo-random number.
+
+  @return A pseudo-random number.
+
+**/
+UINT32
+TestRandom (
+  VOID
+  )
+{
+  mSeed = mSeed * 1103515245 + 12345;
+  return (mSeed >> 16) & 0x7FFF;
+}
+
+/**
+  Empty the free range list before a test.
+
+  @param[in] Context  The maximum number of free ranges of the list, or NULL for
+                      TEST_MAX_RANGES.
+
+  @retval UNIT_TEST_PASSED  The list is empty.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+ListSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  ZeroMem (mRanges, sizeof (mRanges));
+  ZeroMem (mFreePage, sizeof (mFreePage));
+  mList.Count    = 0;
+  mList.MaxCount = (Context == NULL) ? TEST_MAX_RANGES : (UINTN)Context;
+  mList.Ranges   = mRanges;
+  mSeed          = 1;
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Check a free range of the list.
+
+  @param[in] Index      The index of the free range.
+  @param[in] FirstPage  The expected first page of the free range.
+  @param[in] Pages      The expected number of pages of the free range.
+
+  @retval TRUE   The free range is the expected one.
+  @retval FALSE  The free range is not the expected one.
+
+**/
+BOOLEAN
+IsRange (
+  IN UINTN  Index,
+  IN UINTN  FirstPage,
+  IN UINTN  Pages
+  )
+{
+  return (BOOLEAN)((Index < mList.Count) &&
+                   (mList.Ranges[Index].Base == PageAddress (FirstPage)) &&
+                   (mList.Ranges[Index].Length == EFI_PAGES_TO_SIZE (Pages)));
+}
+
+/**
+  Adding free ranges should merge the adjacent ones and reject the overlapping ones.
+
+  @param[in] Context  Unused.
+
+  @retval UNIT_TEST_PASSED  The test passed.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+AddMergesAdjacentRanges (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UT_ASSERT_NOT_EFI_ERROR (PeiFreeRangeAdd (&mList, PageAddress (10), EFI_PAGES_TO_SIZE (2)));
+  UT_ASSERT_NOT_EFI_ERROR (PeiFreeRangeAdd (&mList, PageAddress (20), EFI_PAGES_TO_SIZE (2)));
+  UT_ASSERT_NOT_EFI_ERROR (PeiFreeRangeAdd (&mList, PageAddress (0), EFI_PAGES_TO_SIZE (1)));
+  UT_ASSERT_EQUAL (mList.Count, 3);
+  UT_ASSERT_TRUE (IsRange (0, 0, 1));
+  UT_ASSERT_TRUE (IsRange (1, 10, 2));
+  UT_ASSERT_TRUE (IsRange (2, 20, 2));
+
+  //
+  // Merge with the previous range, with the next range, then with both.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (PeiFreeRangeAdd (&mList, PageAddress (12), EFI_PAGES_TO_SIZE (3)));
+  UT_ASSERT_NOT_EFI_ERROR (PeiFreeRangeAdd (&mList, PageAddress (18), EFI_PAGES_TO_SIZE (2)));
+  UT_ASSERT_EQUAL (mList.Count, 3);
+  UT_ASSERT_TRUE (IsRange (1, 10, 5));
+  UT_ASSERT_TRUE (IsRange (2, 18, 4));
+
+  UT_ASSERT_NOT_EFI_ERROR (PeiFreeRangeAdd (&mList, PageAddress (15), EFI_PAGES_TO_SIZE (3)));
+  UT_ASSERT_EQUAL (mList.Count, 2);
+  UT_ASSERT_TRUE (IsRange (0, 0, 1));
+  UT_ASSERT_TRUE (IsRange (1, 10, 12));
+
+  //
+  // Overlapping and empty ranges are rejected.
+  //
+  UT_ASSERT_STATUS_EQUAL (PeiFreeRangeAdd (&mList, PageAddress (21), EFI_PAGES_TO_SIZE (2)), EFI_INVALID_PARAMETER);
+  UT_ASSERT_STATUS_EQUAL (PeiFreeRangeAdd (&mList, PageAddress (9), EFI_PAGES_TO_SIZE (2)), EFI_INVALID_PARAMETER);
+  UT_ASSERT_STATUS_EQUAL (PeiFreeRangeAdd (&mList, PageAddress (12), EFI_PAGES_TO_SIZE (1)), EFI_INVALID_PARAMETER);
+  UT_ASSERT_STATUS_EQUAL (PeiFreeRangeAdd (&mList, PageAddress (5), 0), EFI_INVALID_PARAMETER);
+  UT_ASSERT_EQUAL (mList.Count, 2);
+  UT_ASSERT_TRUE (IsRange (1, 10, 12));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Allocations should come from the top of the highest free range that can hold them.
+
+  @param[in] Context  Unused.
+
+  @retval UNIT_TEST_PASSED  The test passed.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+AllocateIsTopDown (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_PHYSICAL_ADDRESS  Base;
+  UINT64                Length;
+
+  UT_ASSERT_NOT_EFI_ERROR (PeiFreeRangeAdd (&mList, PageAddress (0), EFI_PAGES_TO_SIZE (8)));
+  UT_ASSERT_NOT_EFI_ERROR (PeiFreeRangeAdd (&mList, PageAddress (16), EFI_PAGES_TO_SIZE (3)));
+  UT_ASSERT_NOT_EFI_ERROR (PeiFreeRangeAdd (&mList, PageAddress (32), EFI_PAGES_TO_SIZE (1)));
+
+  //
+  // The highest free range is used when it is big enough.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (PeiFreeRangeAllocate (&mList, EFI_PAGES_TO_SIZE (1), EFI_PAGE_SIZE, &Base));
+  UT_ASSERT_EQUAL (Base, PageAddress (32));
+  UT_ASSERT_EQUAL (mList.Count, 2);
+
+  UT_ASSERT_NOT_EFI_ERROR (PeiFreeRangeAllocate (&mList, EFI_PAGES_TO_SIZE (2), EFI_PAGE_SIZE, &Base));
+  UT_ASSERT_EQUAL (Base, PageAddress (17));
+  UT_ASSERT_TRUE (IsRange (1, 16, 1));
+
+  //
+  // An aligned allocation splits the free range around it.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (PeiFreeRangeAllocate (&mList, EFI_PAGES_TO_SIZE (2), EFI_PAGES_TO_SIZE (4), &Base));
+  UT_ASSERT_EQUAL (Base, PageAddress (4));
+  UT_ASSERT_EQUAL (mList.Count, 3);
+  UT_ASSERT_TRUE (IsRange (0, 0, 4));
+  UT_ASSERT_TRUE (IsRange (1, 6, 2));
+  UT_ASSERT_TRUE (IsRange (2, 16, 1));
+
+  //
+  // A free range big enough but without an aligned address is skipped.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (PeiFreeRangeAllocate (&mList, EFI_PAGES_TO_SIZE (2), EFI_PAGES_TO_SIZE (4), &Base));
+  UT_ASSERT_EQUAL (Base, PageAddress (0));
+  UT_ASSERT_EQUAL (mList.Count, 3);
+  UT_ASSERT_TRUE (IsRange (0, 2, 2));
+  UT_ASSERT_TRUE (IsRange (1, 6, 2));
+
+  //
+  // The allocation fails when no free range can hold it.
+  //
+  UT_ASSERT_STATUS_EQUAL (PeiFreeRangeAllocate (&mList, EFI_PAGES_TO_SIZE (3), EFI_PAGE_SIZE, &Base), EFI_NOT_FOUND);
+  UT_ASSERT_EQUAL (mList.Count, 3);
+
+  //
+  // Removing a free range by its base.
+  //
+  UT_ASSERT_STATUS_EQUAL (PeiFreeRangeRemove (&mList, PageAddress (7), &Length), EFI_NOT_FOUND);
+  UT_ASSERT_NOT_EFI_ERROR (PeiFreeRangeRemove (&mList, PageAddress (6), &Length));
+  UT_ASSERT_EQUAL (Length, EFI_PAGES_TO_SIZE (2));
+  UT_ASSERT_EQUAL (mList.Count, 2);
+  UT_ASSERT_TRUE (IsRange (0, 2, 2));
+  UT_ASSERT_TRUE (IsRange (1, 16, 1));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A full list should still merge adjacent ranges, and allocate without splitting.
+
+  @param[in] Context  The maximum number of free ranges of the list.
+
+  @retval UNIT_TEST_PASSED  The test passed.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FullListDoesNotGrow (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_PHYSICAL_ADDRESS  Base;
+
+  UT_ASSERT_NOT_EFI_ERROR (PeiFreeRangeAdd (&mList, PageAddress (0), EFI_PAGES_TO_SIZE (7)));
+  UT_ASSERT_NOT_EFI_ERROR (PeiFreeRangeAdd (&mList, PageAddress (16), EFI_PAGES_TO_SIZE (2)));
+  UT_ASSERT_EQUAL (mList.Count, mList.MaxCount);
+
+  UT_ASSERT_STATUS_EQUAL (PeiFreeRangeAdd (&mList, PageAddress (10), EFI_PAGES_TO_SIZE (1)), EFI_OUT_OF_RESOURCES);
+  UT_ASSERT_NOT_EFI_ERROR (PeiFreeRangeAdd (&mList, PageAddress (18), EFI_PAGES_TO_SIZE (2)));
+  UT_ASSERT_EQUAL (mList.Count, 2);
+  UT_ASSERT_TRUE (IsRange (1, 16, 4));
+
+  //
+  // The aligned allocation would split the highest free range, so it comes
+  // from the top of the next one.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (PeiFreeRangeAllocate (&mList, EFI_PAGES_TO_SIZE (1), EFI_PAGES_TO_SIZE (2), &Base));
+  UT_ASSERT_EQUAL (Base, PageAddress (6));
+  UT_ASSERT_EQUAL (mList.Count, 2);
+  UT_ASSERT_TRUE (IsRange (0, 0, 6));
+  UT_ASSERT_TRUE (IsRange (1, 16, 4));
+
+  UT_ASSERT_NOT_EFI_ERROR (PeiFreeRangeAllocate (&mList, EFI_PAGES_TO_SIZE (2), EFI_PAGES_TO_SIZE (4), &Base));
+  UT_ASSERT_EQUAL (Base, PageAddress (16));
+  UT_ASSERT_TRUE (IsRange (1, 18, 2));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Check that the free range list matches the free pages of the random test.
+
+  @retval UNIT_TEST_PASSED  The list matches the free pages.
+
+**/
+UNIT_TEST_STATUS
+CheckListMatchesPages (
+  VOID
+  )
+{
+  UINTN  Index;
+  UINTN  Page;
+  UINTN  RangeIndex;
+
+  RangeIndex = 0;
+  Page       = 0;
+  while (Page < TEST_RANDOM_PAGES) {
+    if (!mFreePage[Page]) {
+      Page++;
+      continue;
+    }
+
+    UT_ASSERT_TRUE (RangeIndex < mList.Count);
+    UT_ASSERT_EQUAL (mList.Ranges[RangeIndex].Base, PageAddress (Page));
+    for (Index = Page; (Index < TEST_RANDOM_PAGES) && mFreePage[Index]; Index++) {
+    }
+
+    UT_ASSERT_EQUAL (mList.Ranges[RangeIndex].Length, EFI_PAGES_TO_SIZE (Index - Page));
+    RangeIndex++;
+    Page = Index;
+  }
+
+  UT_ASSERT_EQUAL (mList.Count, RangeIndex);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Random frees and allocations should keep the list matching the free pages.
+
+  @param[in] Context  Unused.
+
+  @retval UNIT_TEST_PASSED  The test passed.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+RandomOperationsMatchPages (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN                 Operation;
+  UINTN                 Page;
+  UINTN                 Pages;
+  UINTN                 Index;
+  UINTN                 Granularity;
+  UINTN                 Expected;
+  UINTN                 Candidate;
+  BOOLEAN               Fits;
+  EFI_STATUS            Status;
+  EFI_PHYSICAL_ADDRESS  Base;
+  UNIT_TEST_STATUS      TestStatus;
+
+  for (Operation = 0; Operation < TEST_RANDOM_OPERATIONS; Operation++) {
+    Pages = 1 + TestRandom () % 8;
+    if ((TestRandom () % 2) == 0) {
+      //
+      // Free the allocated pages from a random page, like PeiFreePages () does.
+      //
+      Page = TestRandom () % TEST_RANDOM_PAGES;
+      for (Index = 0; (Index < Pages) && (Page + Index < TEST_RANDOM_PAGES) && !mFreePage[Page + Index]; Index++) {
+      }
+
+      if (Index == 0) {
+        UT_ASSERT_STATUS_EQUAL (PeiFreeRangeAdd (&mList, PageAddress (Page), EFI_PAGES_TO_SIZE (1)), EFI_INVALID_PARAMETER);
+        continue;
+      }
+
+      UT_ASSERT_NOT_EFI_ERROR (PeiFreeRangeAdd (&mList, PageAddress (Page), EFI_PAGES_TO_SIZE (Index)));
+      SetMem (&mFreePage[Page], Index, TRUE);
+    } else {
+      //
+      // Allocate the pages, and check they are the highest aligned free pages
+      // of the highest free range that can hold them.
+      //
+      Granularity = ((TestRandom () % 4) == 0) ? 4 : 1;
+      Expected    = TEST_RANDOM_PAGES;
+      for (Candidate = TEST_RANDOM_PAGES - Pages + 1; Candidate > 0 && Expected == TEST_RANDOM_PAGES; Candidate--) {
+        if (((Candidate - 1) % Granularity) != 0) {
+          continue;
+        }
+
+        Fits = TRUE;
+        for (Index = 0; Index < Pages; Index++) {
+          if (!mFreePage[Candidate - 1 + Index]) {
+            Fits = FALSE;
+            break;
+          }
+        }
+
+        if (Fits) {
+          Expected = Candidate - 1;
+        }
+      }
+
+      Status = PeiFreeRangeAllocate (&mList, EFI_PAGES_TO_SIZE (Pages), EFI_PAGES_TO_SIZE (Granularity), &Base);
+      if (Expected == TEST_RANDOM_PAGES) {
+        UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+      } else {
+        UT_ASSERT_NOT_EFI_ERROR (Status);
+        UT_ASSERT_EQUAL (Base, PageAddress (Expected));
+        SetMem (&mFreePage[Expected], Pages, FALSE);
+      }
+    }
+
+    TestStatus = CheckListMatchesPages ();
+    if (TestStatus != UNIT_TEST_PASSED) {
+      return TestStatus;
+    }
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for the
+  free memory range list of the PEI Core and run the unit tests.
+
+**/
+VOID
+EFIAPI
+UnitTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      FreeRangeTests;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (
+             &FreeRangeTests,
+             Framework,
+             "PEI Core Free Range Tests",
+             "PeiCore.FreeRange",
+             NULL,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for FreeRangeTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (
+    FreeRangeTests,
+    "Adding free ranges should merge the adjacent ones and reject the overlapping ones",
+    "Add",
+    AddMergesAdjacentRanges,
+    ListSetup,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    FreeRangeTests,
+    "Allocations should come from the top of the highest free range that can hold them",
+    "Allocate",
+    AllocateIsTopDown,
+    ListSetup,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    FreeRangeTests,
+    "A full list should still merge adjacent ranges, and allocate without splitting",
+    "Full",
+    FullListDoesNotGrow,
+    ListSetup,
+    NULL,
+    (UNIT_TEST_CONTEXT)(UINTN)2
+    );
+  AddTestCase (
+    FreeRangeTests,
+    "Random frees and allocations should keep the list matching the free pages",
+    "Random",
+    RandomOperationsMatchPages,
+    ListSetup,
+    NULL,
+    NULL
+    );
+
+  //
+  // Execute the tests.
+  //
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return;
+}
+
+///
+/// Avoid ECC error for function name that starts with lower case letter
+///
+#define Main  main
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+
+  @param[in] Argc  Number of arguments
+  @param[in] Argv  Array of pointers to arguments
+
+  @retval 0      Success
+  @retval other  Error
+**/
+INT32
+Main (
+  IN INT32  Argc,
+  IN CHAR8  *Argv[]
+  )
+{
+  UnitTestMain ();
+  return 0;
+}
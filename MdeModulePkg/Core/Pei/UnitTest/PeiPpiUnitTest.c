@@ -0,0 +1,532 @@
+/** @file
+  This is a host-based unit test for the GUID hash of the PPI database of the
+  PEI Core.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <Library/UnitTestLib.h>
+
+#include "../PeiMain.h"
+
+#define UNIT_TEST_NAME     "PEI Core PPI Database Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// The number of PPIs the tests install, and of their GUIDs. PPI Index has the
+// GUID Index % TEST_GUID_COUNT, so the first GUIDs have two PPIs. There are more
+// GUIDs than one byte hashes, so some GUIDs share their hash. The last GUID
+// has no PPI.
+//
+#define TEST_PPI_COUNT   (PPI_GROWTH_STEP * 5)
+#define TEST_GUID_COUNT  (PPI_GROWTH_STEP * 4 + 7)
+
+//
+// The PPIs installed before the temporary RAM is migrated.
+//
+#define TEST_PPI_COUNT_BEFORE_MIGRATION  (PPI_GROWTH_STEP * 2 + 3)
+
+//
+// The PPI descriptors, their GUIDs and their interfaces, in the temporary RAM
+// and once migrated to the permanent memory.
+//
+typedef struct {
+  EFI_PEI_PPI_DESCRIPTOR       Descriptor[TEST_PPI_COUNT];
+  EFI_GUID                     Guid[TEST_GUID_COUNT + 1];
+  UINT32                       Interface[TEST_PPI_COUNT];
+  EFI_PEI_NOTIFY_DESCRIPTOR    Notify;
+} TEST_RAM;
+
+TEST_RAM              mTempRam;
+TEST_RAM              mPermRam;
+PEI_CORE_INSTANCE     mPrivateData;
+EFI_SEC_PEI_HAND_OFF  mSecCoreData;
+
+//
+// The calls of the notification function.
+//
+UINTN  mNotifyCount;
+VOID   *mNotifyPpi;
+
+/**
+  Return the PEI Services Table of the test PEI Core instance.
+
+  @return The PEI Services Table pointer.
+
+**/
+CONST EFI_PEI_SERVICES **
+EFIAPI
+GetPeiServicesTablePointer (
+  VOID
+  )
+{
+  return (CONST EFI_PEI_SERVICES **)&mPrivateData.Ps;
+}
+
+/**
+  Not used by the tests: the PPI list from SEC is not processed.
+
+  @param PeiServices    An indirect pointer to the EFI_PEI_SERVICES table.
+  @param SecHobList     Pointer to a list of HOBs.
+
+  @retval EFI_UNSUPPORTED   Always.
+
+**/
+EFI_STATUS
+PeiInstallSecHobData (
+  IN CONST EFI_PEI_SERVICES  **PeiServices,
+  IN EFI_HOB_GENERIC_HEADER  *SecHobList
+  )
+{
+  return EFI_UNSUPPORTED;
+}
+
+/**
+  Not used by the tests: the PEI Core is not migrated.
+
+  @param FileHandle     The handle to the PE/COFF file.
+  @param Pe32Data       Returns the PE/COFF image.
+
+  @retval EFI_UNSUPPORTED   Always.
+
+**/
+EFI_STATUS
+PeiGetPe32Data (
+  IN     EFI_PEI_FILE_HANDLE  FileHandle,
+  OUT    VOID                 **Pe32Data
+  )
+{
+  return EFI_UNSUPPORTED;
+}
+
+/**
+  Not used by the tests: the PEI Core is not migrated.
+
+  @param Pe32Data       The PE/COFF image.
+  @param EntryPoint     Returns the entry point of the image.
+
+  @retval RETURN_UNSUPPORTED  Always.
+
+**/
+RETURN_STATUS
+EFIAPI
+PeCoffLoaderGetEntryPoint (
+  IN  VOID  *Pe32Data,
+  OUT VOID  **EntryPoint
+  )
+{
+  return RETURN_UNSUPPORTED;
+}
+
+/**
+  Not used by the tests: the PEI Core is not migrated.
+
+  @param SecCoreData    The SEC to PEI handoff data.
+  @param PpiList        The PPIs installed by SEC.
+
+**/
+VOID
+EFIAPI
+_ModuleEntryPoint (
+  IN CONST  EFI_SEC_PEI_HAND_OFF    *SecCoreData,
+  IN CONST  EFI_PEI_PPI_DESCRIPTOR  *PpiList
+  )
+{
+}
+
+/**
+  Record the calls of the test notification.
+
+  @param PeiServices        Indirect reference to the PEI Services Table.
+  @param NotifyDescriptor   Address of the notification descriptor data structure.
+  @param Ppi                Address of the PPI that was installed.
+
+  @retval EFI_SUCCESS       Always.
+
+**/
+EFI_STATUS
+EFIAPI
+TestNotify (
+  IN EFI_PEI_SERVICES           **PeiServices,
+  IN EFI_PEI_NOTIFY_DESCRIPTOR  *NotifyDescriptor,
+  IN VOID                       *Ppi
+  )
+{
+  mNotifyCount++;
+  mNotifyPpi = Ppi;
+  return EFI_SUCCESS;
+}
+
+/**
+  Build PPI descriptors of a test RAM.
+
+  @param[in] Ram    The test RAM.
+  @param[in] Start  The first PPI descriptor to build.
+  @param[in] Stop   The PPI descriptor after the last one to build.
+
+**/
+VOID
+BuildPpiDescriptors (
+  IN TEST_RAM  *Ram,
+  IN UINTN     Start,
+  IN UINTN     Stop
+  )
+{
+  UINTN  Index;
+
+  for (Index = Start; Index < Stop; Index++) {
+    Ram->Interface[Index]        = (UINT32)Index;
+    Ram->Descriptor[Index].Flags = EFI_PEI_PPI_DESCRIPTOR_PPI | EFI_PEI_PPI_DESCRIPTOR_TERMINATE_LIST;
+    Ram->Descriptor[Index].Guid  = &Ram->Guid[Index % TEST_GUID_COUNT];
+    Ram->Descriptor[Index].Ppi   = &Ram->Interface[Index];
+  }
+}
+
+/**
+  Empty the PPI database, and build the PPI descriptors in the temporary RAM.
+
+  @param[in] Context  Unused.
+
+  @retval UNIT_TEST_PASSED  The PPI database is empty.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+PpiDatabaseSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN  Index;
+
+  ZeroMem (&mPrivateData, sizeof (mPrivateData));
+  ZeroMem (&mSecCoreData, sizeof (mSecCoreData));
+  ZeroMem (&mTempRam, sizeof (mTempRam));
+  ZeroMem (&mPermRam, sizeof (mPermRam));
+  mPrivateData.Signature = PEI_CORE_HANDLE_SIGNATURE;
+  mNotifyCount           = 0;
+  mNotifyPpi             = NULL;
+
+  for (Index = 0; Index <= TEST_GUID_COUNT; Index++) {
+    mTempRam.Guid[Index].Data1    = (UINT32)(Index * 0x9E3779B1);
+    mTempRam.Guid[Index].Data2    = (UINT16)Index;
+    mTempRam.Guid[Index].Data3    = 0x4A5B;
+    mTempRam.Guid[Index].Data4[7] = (UINT8)(Index * 7);
+  }
+
+  BuildPpiDescriptors (&mTempRam, 0, TEST_PPI_COUNT);
+
+  //
+  // Notify on the GUID of the last PPI, installed after the migration. Its GUID
+  // also has a PPI installed before.
+  //
+  mTempRam.Notify.Flags  = EFI_PEI_PPI_DESCRIPTOR_NOTIFY_CALLBACK | EFI_PEI_PPI_DESCRIPTOR_TERMINATE_LIST;
+  mTempRam.Notify.Guid   = &mTempRam.Guid[(TEST_PPI_COUNT - 1) % TEST_GUID_COUNT];
+  mTempRam.Notify.Notify = TestNotify;
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Install PPIs of the test RAM, one at a time.
+
+  @param[in] Ram    The test RAM with the PPI descriptors.
+  @param[in] Start  The first PPI to install.
+  @param[in] Stop   The PPI after the last PPI to install.
+
+  @retval UNIT_TEST_PASSED  The PPIs are installed.
+
+**/
+UNIT_TEST_STATUS
+InstallPpis (
+  IN TEST_RAM  *Ram,
+  IN UINTN     Start,
+  IN UINTN     Stop
+  )
+{
+  UINTN  Index;
+
+  for (Index = Start; Index < Stop; Index++) {
+    UT_ASSERT_NOT_EFI_ERROR (PeiInstallPpi (GetPeiServicesTablePointer (), &Ram->Descriptor[Index]));
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Locate every instance of every test GUID, and check it is the PPI of the test
+  RAM installed for it.
+
+  @param[in] Ram        The test RAM with the PPI descriptors.
+  @param[in] PpiCount   The number of PPIs installed.
+
+  @retval UNIT_TEST_PASSED  PeiLocatePpi () finds the installed PPIs.
+
+**/
+UNIT_TEST_STATUS
+CheckLocatePpis (
+  IN TEST_RAM  *Ram,
+  IN UINTN     PpiCount
+  )
+{
+  UINTN                   GuidIndex;
+  UINTN                   Instance;
+  UINTN                   Index;
+  EFI_STATUS              Status;
+  EFI_PEI_PPI_DESCRIPTOR  *Descriptor;
+  VOID                    *Ppi;
+
+  for (GuidIndex = 0; GuidIndex <= TEST_GUID_COUNT; GuidIndex++) {
+    for (Instance = 0; ; Instance++) {
+      Index  = GuidIndex + Instance * TEST_GUID_COUNT;
+      Status = PeiLocatePpi (GetPeiServicesTablePointer (), &Ram->Guid[GuidIndex], Instance, &Descriptor, &Ppi);
+      if ((GuidIndex == TEST_GUID_COUNT) || (Index >= PpiCount)) {
+        UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+        break;
+      }
+
+      UT_ASSERT_NOT_EFI_ERROR (Status);
+      UT_ASSERT_EQUAL ((UINTN)Descriptor, (UINTN)&Ram->Descriptor[Index]);
+      UT_ASSERT_EQUAL ((UINTN)Ppi, (UINTN)&Ram->Interface[Index]);
+    }
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Move an array of the PPI database to new memory, as the heap is migrated,
+  and fill the old one with garbage.
+
+  @param[in, out] Array  The array to move.
+  @param[in]      Size   The size of the array in bytes.
+
+**/
+VOID
+MigrateArray (
+  IN OUT VOID  **Array,
+  IN     UINTN   Size
+  )
+{
+  VOID  *NewArray;
+
+  NewArray = AllocateCopyPool (Size, *Array);
+  ASSERT (NewArray != NULL);
+  SetMem (*Array, Size, 0xA5);
+  FreePool (*Array);
+  *Array = NewArray;
+}
+
+/**
+  The PPIs should be found after the PPI list grows.
+
+  @param[in] Context  Unused.
+
+  @retval UNIT_TEST_PASSED  The test passed.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+LocateAfterGrowth (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UNIT_TEST_STATUS  TestStatus;
+  UINTN             Count;
+
+  for (Count = 0; Count < TEST_PPI_COUNT; Count += PPI_GROWTH_STEP / 2 + 1) {
+    TestStatus = InstallPpis (&mTempRam, Count, MIN (Count + PPI_GROWTH_STEP / 2 + 1, TEST_PPI_COUNT));
+    if (TestStatus != UNIT_TEST_PASSED) {
+      return TestStatus;
+    }
+
+    TestStatus = CheckLocatePpis (&mTempRam, MIN (Count + PPI_GROWTH_STEP / 2 + 1, TEST_PPI_COUNT));
+    if (TestStatus != UNIT_TEST_PASSED) {
+      return TestStatus;
+    }
+  }
+
+  UT_ASSERT_TRUE (mPrivateData.PpiData.PpiList.MaxCount >= TEST_PPI_COUNT);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The PPIs should be found after the heap and the temporary RAM are migrated,
+  and after the PPI list grows again, and the notifications should still be
+  dispatched.
+
+  @param[in] Context  Unused.
+
+  @retval UNIT_TEST_PASSED  The test passed.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+LocateAfterMigration (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UNIT_TEST_STATUS  TestStatus;
+  PEI_PPI_DATABASE  *PpiData;
+
+  PpiData = &mPrivateData.PpiData;
+
+  TestStatus = InstallPpis (&mTempRam, 0, TEST_PPI_COUNT_BEFORE_MIGRATION);
+  if (TestStatus != UNIT_TEST_PASSED) {
+    return TestStatus;
+  }
+
+  //
+  // The notification is dispatched for the PPI already installed with its GUID.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (PeiNotifyPpi (GetPeiServicesTablePointer (), &mTempRam.Notify));
+  UT_ASSERT_EQUAL (mNotifyCount, 1);
+  UT_ASSERT_EQUAL ((UINTN)mNotifyPpi, (UINTN)&mTempRam.Interface[(TEST_PPI_COUNT - 1) % TEST_GUID_COUNT]);
+
+  //
+  // Migrate the heap, with the arrays of the PPI database, the way PeiCore ()
+  // does, then the temporary RAM, with the descriptors.
+  //
+  MigrateArray ((VOID **)&PpiData->PpiList.PpiPtrs, sizeof (PEI_PPI_LIST_POINTERS) * PpiData->PpiList.MaxCount);
+  MigrateArray ((VOID **)&PpiData->PpiList.Hash, PpiData->PpiList.MaxCount);
+  MigrateArray ((VOID **)&PpiData->CallbackNotifyList.NotifyPtrs, sizeof (PEI_PPI_LIST_POINTERS) * PpiData->CallbackNotifyList.MaxCount);
+  MigrateArray ((VOID **)&PpiData->CallbackNotifyList.Hash, PpiData->CallbackNotifyList.MaxCount);
+
+  CopyMem (&mPermRam, &mTempRam, sizeof (TEST_RAM));
+  mSecCoreData.PeiTemporaryRamBase = &mTempRam;
+  mSecCoreData.PeiTemporaryRamSize = sizeof (TEST_RAM);
+  if ((UINTN)&mPermRam >= (UINTN)&mTempRam) {
+    mPrivateData.HeapOffset         = (UINTN)&mPermRam - (UINTN)&mTempRam;
+    mPrivateData.HeapOffsetPositive = TRUE;
+  } else {
+    mPrivateData.HeapOffset         = (UINTN)&mTempRam - (UINTN)&mPermRam;
+    mPrivateData.HeapOffsetPositive = FALSE;
+  }
+
+  ConvertPpiPointers (&mSecCoreData, &mPrivateData);
+  SetMem (&mTempRam, sizeof (TEST_RAM), 0xA5);
+
+  TestStatus = CheckLocatePpis (&mPermRam, TEST_PPI_COUNT_BEFORE_MIGRATION);
+  if (TestStatus != UNIT_TEST_PASSED) {
+    return TestStatus;
+  }
+
+  //
+  // Grow the PPI list after the migration, with PPIs in the permanent memory.
+  //
+  BuildPpiDescriptors (&mPermRam, TEST_PPI_COUNT_BEFORE_MIGRATION, TEST_PPI_COUNT);
+  TestStatus = InstallPpis (&mPermRam, TEST_PPI_COUNT_BEFORE_MIGRATION, TEST_PPI_COUNT);
+  if (TestStatus != UNIT_TEST_PASSED) {
+    return TestStatus;
+  }
+
+  TestStatus = CheckLocatePpis (&mPermRam, TEST_PPI_COUNT);
+  if (TestStatus != UNIT_TEST_PASSED) {
+    return TestStatus;
+  }
+
+  UT_ASSERT_EQUAL (mNotifyCount, 2);
+  UT_ASSERT_EQUAL ((UINTN)mNotifyPpi, (UINTN)&mPermRam.Interface[TEST_PPI_COUNT - 1]);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for the PPI
+  database of the PEI Core, and run them.
+
+**/
+VOID
+UnitTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      PpiTests;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (
+             &PpiTests,
+             Framework,
+             "PEI Core PPI Database Tests",
+             "PeiCore.Ppi",
+             NULL,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for PpiTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (
+    PpiTests,
+    "The PPIs should be found after the PPI list grows",
+    "Grow",
+    LocateAfterGrowth,
+    PpiDatabaseSetup,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    PpiTests,
+    "The PPIs should be found and notified after the heap migrates and the PPI list grows",
+    "Migrate",
+    LocateAfterMigration,
+    PpiDatabaseSetup,
+    NULL,
+    NULL
+    );
+
+  //
+  // Execute the tests.
+  //
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return;
+}
+
+///
+/// Avoid ECC error for function name that starts with lower case letter
+///
+#define Main  main
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+
+  @param[in] Argc  Number of arguments
+  @param[in] Argv  Array of pointers to arguments
+
+  @retval 0      Success
+  @retval other  Error
+**/
+INT32
+Main (
+  IN INT32  Argc,
+  IN CHAR8  *Argv[]
+  )
+{
+  UnitTestMain ();
+  return 0;
+}
@@ -0,0 +1,75 @@
+/** @file
+  The PEI variable index is a GUIDed HOB the PEI variable driver builds to look
+  variables of the non-volatile variable store up by a hash of their GUID and
+  name, instead of walking the store in flash for every GetVariable ().
+
+  The index only holds offsets, so it stays valid when the HOB list is moved to
+  permanent memory, and later phases can reuse it as long as the variable store
+  it describes was not written since.
+
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef __PEI_VARIABLE_INDEX_H__
+#define __PEI_VARIABLE_INDEX_H__
+
+#define EDKII_PEI_VARIABLE_INDEX_GUID \
+  { 0x4d9a3c62, 0x7f1e, 0x4b05, { 0x9e, 0x3d, 0x21, 0xc8, 0x5a, 0x6f, 0x10, 0xb7 } }
+
+extern EFI_GUID  gEdkiiPeiVariableIndexGuid;
+
+///
+/// Number of hash buckets of the PEI variable index. It is a power of 2.
+///
+#define PEI_VARIABLE_INDEX_BUCKET_COUNT  64
+
+typedef struct {
+  ///
+  /// Offset of the variable header from the start pointer of the store.
+  ///
+  UINT32    Offset;
+  ///
+  /// FNV-1a hash of the bytes of the GUID of the variable followed by the bytes
+  /// of its name, without the null terminator.
+  ///
+  UINT32    Hash;
+  ///
+  /// Number of the next entry of the same bucket plus 1, or 0 at the end of the chain.
+  ///
+  UINT32    Next;
+} PEI_VARIABLE_INDEX_ENTRY;
+
+typedef struct {
+  ///
+  /// Address of the header of the indexed variable store.
+  ///
+  EFI_PHYSICAL_ADDRESS        StoreBase;
+  ///
+  /// Size of the indexed variable store.
+  ///
+  UINT32                      StoreSize;
+  BOOLEAN                     AuthFormat;
+  ///
+  /// TRUE if the store holds a visible variable whose name cannot be hashed.
+  /// The store must then be walked.
+  ///
+  BOOLEAN                     Unusable;
+  ///
+  /// Offset from the start pointer of the store of the first variable header
+  /// that is not in the index. The variables from there on must be walked.
+  ///
+  UINT32                      IndexedEnd;
+  UINT32                      EntryCount;
+  UINT32                      EntryCapacity;
+  ///
+  /// First and last entry of each bucket plus 1, or 0 if the bucket is empty.
+  /// The entries of a bucket are chained in the order of the store, and
+  /// Entry[] holds all entries in the order of the store.
+  ///
+  UINT32                      Head[PEI_VARIABLE_INDEX_BUCKET_COUNT];
+  UINT32                      Tail[PEI_VARIABLE_INDEX_BUCKET_COUNT];
+  PEI_VARIABLE_INDEX_ENTRY    Entry[1];
+} EDKII_PEI_VARIABLE_INDEX;
+
+#endif
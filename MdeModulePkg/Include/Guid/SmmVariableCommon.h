@@ -77,6 +77,14 @@ typedef struct {
 // The payload for this function is SMM_VARIABLE_COMMUNICATE_GET_RUNTIME_CACHE_INFO
 //
 #define SMM_VARIABLE_FUNCTION_GET_RUNTIME_CACHE_INFO  14
+//
+// The payload for this function is SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH.
+//
+#define SMM_VARIABLE_FUNCTION_SET_VARIABLE_BATCH  15
+//
+// The payload for this function is SMM_VARIABLE_COMMUNICATE_GET_RUNTIME_CACHE_STATISTICS.
+//
+#define SMM_VARIABLE_FUNCTION_GET_RUNTIME_CACHE_STATISTICS  16
 
 ///
 /// Size of SMM communicate header, without including the payload.
@@ -138,8 +146,23 @@ typedef struct {
   VARIABLE_STORE_HEADER    *RuntimeHobCache;
   VARIABLE_STORE_HEADER    *RuntimeNvCache;
   VARIABLE_STORE_HEADER    *RuntimeVolatileCache;
+  UINT32                   *RewriteCount;
 } SMM_VARIABLE_COMMUNICATE_RUNTIME_VARIABLE_CACHE_CONTEXT;
 
+///
+/// This structure is used to communicate with SMI handler by SetVariable for a batch
+/// of variables. It is followed by Count SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY,
+/// each starting at a UINTN aligned offset.
+///
+typedef struct {
+  UINTN    Count;
+} SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH;
+
+typedef struct {
+  EFI_STATUS                                  Status;     // Return status of this variable
+  SMM_VARIABLE_COMMUNICATE_ACCESS_VARIABLE    Variable;
+} SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY;
+
 typedef struct {
   UINTN      TotalHobStorageSize;
   UINTN      TotalNvStorageSize;
@@ -147,4 +170,9 @@ typedef struct {
   BOOLEAN    AuthenticatedVariableUsage;
 } SMM_VARIABLE_COMMUNICATE_GET_RUNTIME_CACHE_INFO;
 
+typedef struct {
+  UINT64    BytesChanged;                 // Bytes of the variable stores updated
+  UINT64    BytesSynced;                  // Bytes copied to the runtime variable caches
+} SMM_VARIABLE_COMMUNICATE_GET_RUNTIME_CACHE_STATISTICS;
+
 #endif // _SMM_VARIABLE_COMMON_H_
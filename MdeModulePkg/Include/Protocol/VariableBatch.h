@@ -0,0 +1,78 @@
+/** @file
+  Variable Batch Protocol is related to EDK II-specific implementation of variables
+  and intended for use as a means to set a number of variables at once, with the
+  non-volatile variables of the batch written to the flash in one update.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef __VARIABLE_BATCH_H__
+#define __VARIABLE_BATCH_H__
+
+#define EDKII_VARIABLE_BATCH_PROTOCOL_GUID \
+  { \
+    0xb757ba2e, 0x22b1, 0x46b4, { 0xb5, 0x52, 0x24, 0xab, 0xea, 0x9e, 0xa5, 0x8e } \
+  }
+
+#define EDKII_VARIABLE_BATCH_PROTOCOL_REVISION  0x00000001
+
+typedef struct _EDKII_VARIABLE_BATCH_PROTOCOL EDKII_VARIABLE_BATCH_PROTOCOL;
+
+///
+/// A variable to set in a batch, with the same parameters as SetVariable ().
+///
+typedef struct {
+  CHAR16        *VariableName;
+  EFI_GUID      *VendorGuid;
+  UINT32        Attributes;
+  UINTN         DataSize;
+  VOID          *Data;
+  ///
+  /// The status SetVariable () would have returned for this variable.
+  ///
+  EFI_STATUS    Status;
+} EDKII_VARIABLE_BATCH_ENTRY;
+
+/**
+  Set a number of variables at once.
+
+  The variables are set in the order of the entries, as if SetVariable () was
+  called for each of them, and the result of each is returned in its Status.
+  A failing entry does not stop the following ones from being set. The
+  non-volatile variables of the batch are written to the flash in one update
+  when it fits in the spare area of the Fault Tolerant Write, so that either
+  all or none of them are found after a reset. Otherwise they are written one
+  by one.
+
+  @param[in]      This          The EDKII_VARIABLE_BATCH_PROTOCOL instance.
+  @param[in]      Count         The number of entries in Entries.
+  @param[in, out] Entries       The variables to set. On return, the Status of each
+                                entry is updated.
+
+  @retval EFI_SUCCESS           The batch was processed. The result of each entry is
+                                returned in its Status.
+  @retval EFI_INVALID_PARAMETER Entries is NULL and Count is not 0.
+  @retval Others                The batch could not be processed. The Status of the
+                                entries that were not processed is the error.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_VARIABLE_BATCH_SET_VARIABLES)(
+  IN     EDKII_VARIABLE_BATCH_PROTOCOL  *This,
+  IN     UINTN                          Count,
+  IN OUT EDKII_VARIABLE_BATCH_ENTRY     *Entries
+  );
+
+///
+/// Variable Batch Protocol sets a number of variables at once, with a single
+/// update of the non-volatile variable store.
+///
+struct _EDKII_VARIABLE_BATCH_PROTOCOL {
+  UINT64                                Revision;
+  EDKII_VARIABLE_BATCH_SET_VARIABLES    SetVariables;
+};
+
+extern EFI_GUID  gEdkiiVariableBatchProtocolGuid;
+
+#endif
@@ -193,6 +193,7 @@ FtwWriteRecord (
   EFI_FTW_DEVICE                   *FtwDevice;
   EFI_FAULT_TOLERANT_WRITE_HEADER  *Header;
   EFI_FAULT_TOLERANT_WRITE_RECORD  *Record;
+  EFI_FAULT_TOLERANT_WRITE_RECORD  *NextRecord;
   UINTN                            Offset;
   UINTN                            NumberOfWriteBlocks;
 
@@ -261,6 +262,32 @@ FtwWriteRecord (
 
   Record->DestinationComplete = FTW_VALID_STATE;
 
+  //
+  // The following records which were journaled with this one have their
+  // content in the spare block too, so they are also flushed to the target.
+  //
+  while (!IsLastRecordOfWrites (Header, Record)) {
+    NextRecord = (EFI_FAULT_TOLERANT_WRITE_RECORD *)((UINT8 *)Record + FTW_RECORD_SIZE (Header->PrivateDataSize));
+    if ((NextRecord->SpareComplete != FTW_VALID_STATE) || (NextRecord->DestinationComplete == FTW_VALID_STATE)) {
+      break;
+    }
+
+    Record = NextRecord;
+    Offset = (UINT8 *)Record - FtwDevice->FtwWorkSpace;
+    Status = FtwUpdateFvState (
+               FtwDevice->FtwFvBlock,
+               FtwDevice->WorkBlockSize,
+               FtwDevice->FtwWorkSpaceLba,
+               FtwDevice->FtwWorkSpaceBase + Offset,
+               DEST_COMPLETED
+               );
+    if (EFI_ERROR (Status)) {
+      return EFI_ABORTED;
+    }
+
+    Record->DestinationComplete = FTW_VALID_STATE;
+  }
+
   //
   // If this is the last Write in these write sequence,
   // set the complete flag of write header.
@@ -283,12 +310,271 @@ FtwWriteRecord (
   return EFI_SUCCESS;
 }
 
+/**
+  Flush the journaled writes to their target blocks.
+
+  The new content of the target blocks is written to the spare block once for
+  all the journaled records, which are then set SPARE_COMPLETED in order, and
+  the spare block is flushed to the target blocks. A failure before the first
+  record is set SPARE_COMPLETED leaves all the journaled writes undone, and
+  FtwRestart () completes all of them after it.
+
+  @param FtwDevice       The private data of FTW driver.
+
+  @retval EFI_SUCCESS          The journaled writes were flushed, or there was
+                               no journaled write.
+  @retval EFI_ABORTED          The function could not complete successfully.
+  @retval EFI_OUT_OF_RESOURCES Cannot allocate enough memory resource.
+
+**/
+EFI_STATUS
+FtwFlushJournal (
+  IN EFI_FTW_DEVICE  *FtwDevice
+  )
+{
+  EFI_STATUS                       Status;
+  FTW_JOURNAL                      *Journal;
+  EFI_FAULT_TOLERANT_WRITE_HEADER  *Header;
+  EFI_FAULT_TOLERANT_WRITE_RECORD  *Record;
+  UINTN                            MyLength;
+  UINTN                            MyOffset;
+  UINTN                            MyBufferSize;
+  UINTN                            SpareBufferSize;
+  UINT8                            *SpareBuffer;
+  UINTN                            Index;
+  UINT8                            *Ptr;
+
+  Journal = &FtwDevice->Journal;
+  if (Journal->RecordCount == 0) {
+    return EFI_SUCCESS;
+  }
+
+  Header = FtwDevice->FtwLastWriteHeader;
+  Record = (EFI_FAULT_TOLERANT_WRITE_RECORD *)(FtwDevice->FtwWorkSpace + Journal->RecordOffset);
+
+  //
+  // Try to keep the content of spare block
+  // Save spare block into a spare backup memory buffer (Sparebuffer)
+  //
+  SpareBufferSize = FtwDevice->SpareAreaLength;
+  SpareBuffer     = AllocatePool (SpareBufferSize);
+  if (SpareBuffer == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+
+  Ptr = SpareBuffer;
+  for (Index = 0; Index < FtwDevice->NumberOfSpareBlock; Index += 1) {
+    MyLength = FtwDevice->SpareBlockSize;
+    Status   = FtwDevice->FtwBackupFvb->Read (
+                                          FtwDevice->FtwBackupFvb,
+                                          FtwDevice->FtwSpareLba + Index,
+                                          0,
+                                          &MyLength,
+                                          Ptr
+                                          );
+    if (EFI_ERROR (Status)) {
+      Status = EFI_ABORTED;
+      goto Done;
+    }
+
+    Ptr += MyLength;
+  }
+
+  //
+  // Write the memory buffer to spare block
+  // Do not assume Spare Block and Target Block have same block size
+  //
+  Status = FtwEraseSpareBlock (FtwDevice);
+  if (EFI_ERROR (Status)) {
+    Status = EFI_ABORTED;
+    goto Done;
+  }
+
+  Ptr          = Journal->Buffer;
+  MyBufferSize = Journal->NumberOfWriteBlocks * Journal->BlockSize;
+  for (Index = 0; MyBufferSize > 0; Index += 1) {
+    if (MyBufferSize > FtwDevice->SpareBlockSize) {
+      MyLength = FtwDevice->SpareBlockSize;
+    } else {
+      MyLength = MyBufferSize;
+    }
+
+    Status = FtwDevice->FtwBackupFvb->Write (
+                                        FtwDevice->FtwBackupFvb,
+                                        FtwDevice->FtwSpareLba + Index,
+                                        0,
+                                        &MyLength,
+                                        Ptr
+                                        );
+    if (EFI_ERROR (Status)) {
+      Status = EFI_ABORTED;
+      goto Done;
+    }
+
+    Ptr          += MyLength;
+    MyBufferSize -= MyLength;
+  }
+
+  //
+  // Set the SpareComplete in the FTW records, in order, so that a restart
+  // always finds the first journaled record SPARE_COMPLETED.
+  //
+  FtwDevice->FtwLastWriteRecord = Record;
+  for (Index = 0; Index < Journal->RecordCount; Index += 1) {
+    MyOffset = (UINT8 *)Record - FtwDevice->FtwWorkSpace;
+    Status   = FtwUpdateFvState (
+                 FtwDevice->FtwFvBlock,
+                 FtwDevice->WorkBlockSize,
+                 FtwDevice->FtwWorkSpaceLba,
+                 FtwDevice->FtwWorkSpaceBase + MyOffset,
+                 SPARE_COMPLETED
+                 );
+    if (EFI_ERROR (Status)) {
+      Status = EFI_ABORTED;
+      goto Done;
+    }
+
+    Record->SpareComplete = FTW_VALID_STATE;
+    Record                = (EFI_FAULT_TOLERANT_WRITE_RECORD *)((UINT8 *)Record + FTW_RECORD_SIZE (Header->PrivateDataSize));
+  }
+
+  //
+  //  Since the content has already backuped in spare block, the write is
+  //  guaranteed to be completed with fault tolerant manner.
+  //
+  Status = FtwWriteRecord (&FtwDevice->FtwInstance, Journal->Fvb, Journal->BlockSize);
+  if (EFI_ERROR (Status)) {
+    Status = EFI_ABORTED;
+    goto Done;
+  }
+
+  //
+  // Restore spare backup buffer into spare block , if no failure happened during FtwWrite.
+  //
+  Status = FtwEraseSpareBlock (FtwDevice);
+  if (EFI_ERROR (Status)) {
+    Status = EFI_ABORTED;
+    goto Done;
+  }
+
+  Ptr = SpareBuffer;
+  for (Index = 0; Index < FtwDevice->NumberOfSpareBlock; Index += 1) {
+    MyLength = FtwDevice->SpareBlockSize;
+    Status   = FtwDevice->FtwBackupFvb->Write (
+                                          FtwDevice->FtwBackupFvb,
+                                          FtwDevice->FtwSpareLba + Index,
+                                          0,
+                                          &MyLength,
+                                          Ptr
+                                          );
+    if (EFI_ERROR (Status)) {
+      Status = EFI_ABORTED;
+      goto Done;
+    }
+
+    Ptr += MyLength;
+  }
+
+  //
+  // All success.
+  //
+  Status = EFI_SUCCESS;
+
+Done:
+  if (SpareBuffer != NULL) {
+    FreePool (SpareBuffer);
+  }
+
+  FreePool (Journal->Buffer);
+  ZeroMem (Journal, sizeof (FTW_JOURNAL));
+  return Status;
+}
+
+/**
+  Get the FVB protocol and the geometry of the target blocks of a write, and
+  check that they fit within the spare block.
+
+  @param FtwDevice            The private data of FTW driver.
+  @param FvBlockHandle        The handle of FVB protocol of the target block.
+  @param Offset               The offset within the target block of the data.
+  @param Length               The number of bytes to write to the target block.
+  @param Fvb                  Returns the FVB protocol of the target block.
+  @param FvbPhysicalAddress   Returns the physical address of the FVB.
+  @param BlockSize            Returns the block size of the FVB.
+  @param NumberOfWriteBlocks  Returns the number of blocks the write covers.
+
+  @retval EFI_SUCCESS          The target blocks fit within the spare block.
+  @retval EFI_NOT_FOUND        Cannot find FVB protocol by handle.
+  @retval EFI_ABORTED          Cannot get the address or block size of the FVB.
+  @retval EFI_BAD_BUFFER_SIZE  The target blocks can't fit within the spare block.
+
+**/
+STATIC
+EFI_STATUS
+FtwGetWriteTarget (
+  IN  EFI_FTW_DEVICE                      *FtwDevice,
+  IN  EFI_HANDLE                          FvBlockHandle,
+  IN  UINTN                               Offset,
+  IN  UINTN                               Length,
+  OUT EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  **Fvb,
+  OUT EFI_PHYSICAL_ADDRESS                *FvbPhysicalAddress,
+  OUT UINTN                               *BlockSize,
+  OUT UINTN                               *NumberOfWriteBlocks
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       NumberOfBlocks;
+
+  //
+  // Get the FVB protocol by handle
+  //
+  Status = FtwGetFvbByHandle (FvBlockHandle, Fvb);
+  if (EFI_ERROR (Status)) {
+    return EFI_NOT_FOUND;
+  }
+
+  Status = (*Fvb)->GetPhysicalAddress (*Fvb, FvbPhysicalAddress);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Ftw: Write(), Get FVB physical address - %r\n", Status));
+    return EFI_ABORTED;
+  }
+
+  //
+  // Now, one FVB has one type of BlockSize.
+  //
+  Status = (*Fvb)->GetBlockSize (*Fvb, 0, BlockSize, &NumberOfBlocks);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Ftw: Write(), Get block size - %r\n", Status));
+    return EFI_ABORTED;
+  }
+
+  *NumberOfWriteBlocks = FTW_BLOCKS (Offset + Length, *BlockSize);
+  DEBUG ((DEBUG_INFO, "Ftw: Write(), BlockSize - 0x%x, NumberOfWriteBlock - 0x%x\n", *BlockSize, *NumberOfWriteBlocks));
+
+  //
+  // Check if the input data can fit within the spare block.
+  //
+  if (*NumberOfWriteBlocks * *BlockSize > FtwDevice->SpareAreaLength) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  return EFI_SUCCESS;
+}
+
 /**
   Starts a target block update. This function will record data about write
   in fault tolerant storage and will complete the write in a recoverable
   manner, ensuring at all times that either the original contents or
   the modified contents are available.
 
+  When PcdFtwJournalWriteEnable is TRUE, the writes of a write header that
+  target the same blocks are journaled: they are recorded in the work space
+  and gathered in memory, and are flushed to the target blocks with one spare
+  block update when the last write of the header is done, or when a write to
+  other blocks comes. Until then, the target blocks keep their original
+  content. The journaled writes are either all completed or all aborted.
+
   @param This            The pointer to this protocol instance.
   @param Lba             The logical block address of the target block.
   @param Offset          The offset within the target block to place the data.
@@ -325,21 +611,49 @@ FtwWrite (
   EFI_FAULT_TOLERANT_WRITE_HEADER     *Header;
   EFI_FAULT_TOLERANT_WRITE_RECORD     *Record;
   EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *Fvb;
+  FTW_JOURNAL                         *Journal;
+  BOOLEAN                             Journaled;
   UINTN                               MyLength;
   UINTN                               MyOffset;
-  UINTN                               MyBufferSize;
-  UINT8                               *MyBuffer;
-  UINTN                               SpareBufferSize;
-  UINT8                               *SpareBuffer;
   UINTN                               Index;
   UINT8                               *Ptr;
   EFI_PHYSICAL_ADDRESS                FvbPhysicalAddress;
   UINTN                               BlockSize;
-  UINTN                               NumberOfBlocks;
   UINTN                               NumberOfWriteBlocks;
-  UINTN                               WriteLength;
 
   FtwDevice = FTW_CONTEXT_FROM_THIS (This);
+  Journal   = &FtwDevice->Journal;
+  Fvb       = NULL;
+  Journaled = FALSE;
+
+  if (FeaturePcdGet (PcdFtwJournalWriteEnable)) {
+    //
+    // The target blocks are needed before the work space is refreshed, to
+    // know whether this write can join the journaled writes.
+    //
+    Status = FtwGetWriteTarget (FtwDevice, FvBlockHandle, Offset, Length, &Fvb, &FvbPhysicalAddress, &BlockSize, &NumberOfWriteBlocks);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    //
+    // The updates of working block and boot block have their own way to flush
+    // the spare block, so they are never journaled.
+    //
+    Journaled = (BOOLEAN)(!IsWorkingBlock (FtwDevice, Fvb, Lba) && !IsBootBlock (FtwDevice, Fvb));
+
+    //
+    // Flush the journaled writes first if this write can not join them.
+    //
+    if ((Journal->RecordCount != 0) &&
+        (!Journaled || (Journal->Fvb != Fvb) || (Journal->Lba != Lba) || (Journal->NumberOfWriteBlocks != NumberOfWriteBlocks)))
+    {
+      Status = FtwFlushJournal (FtwDevice);
+      if (EFI_ERROR (Status)) {
+        return EFI_ABORTED;
+      }
+    }
+  }
 
   Status = WorkSpaceRefresh (FtwDevice);
   if (EFI_ERROR (Status)) {
@@ -370,6 +684,11 @@ FtwWrite (
     }
   }
 
+  //
+  // The last write record is the first journaled one, skip the journaled records.
+  //
+  Record = (EFI_FAULT_TOLERANT_WRITE_RECORD *)((UINT8 *)Record + Journal->RecordCount * FTW_RECORD_SIZE (Header->PrivateDataSize));
+
   //
   // If Record is out of the range of Header, return access denied.
   //
@@ -392,38 +711,11 @@ FtwWrite (
     return EFI_NOT_READY;
   }
 
-  //
-  // Get the FVB protocol by handle
-  //
-  Status = FtwGetFvbByHandle (FvBlockHandle, &Fvb);
-  if (EFI_ERROR (Status)) {
-    return EFI_NOT_FOUND;
-  }
-
-  Status = Fvb->GetPhysicalAddress (Fvb, &FvbPhysicalAddress);
-  if (EFI_ERROR (Status)) {
-    DEBUG ((DEBUG_ERROR, "Ftw: Write(), Get FVB physical address - %r\n", Status));
-    return EFI_ABORTED;
-  }
-
-  //
-  // Now, one FVB has one type of BlockSize.
-  //
-  Status = Fvb->GetBlockSize (Fvb, 0, &BlockSize, &NumberOfBlocks);
-  if (EFI_ERROR (Status)) {
-    DEBUG ((DEBUG_ERROR, "Ftw: Write(), Get block size - %r\n", Status));
-    return EFI_ABORTED;
-  }
-
-  NumberOfWriteBlocks = FTW_BLOCKS (Offset + Length, BlockSize);
-  DEBUG ((DEBUG_INFO, "Ftw: Write(), BlockSize - 0x%x, NumberOfWriteBlock - 0x%x\n", BlockSize, NumberOfWriteBlocks));
-  WriteLength = NumberOfWriteBlocks * BlockSize;
-
-  //
-  // Check if the input data can fit within the spare block.
-  //
-  if (WriteLength > FtwDevice->SpareAreaLength) {
-    return EFI_BAD_BUFFER_SIZE;
+  if (Fvb == NULL) {
+    Status = FtwGetWriteTarget (FtwDevice, FvBlockHandle, Offset, Length, &Fvb, &FvbPhysicalAddress, &BlockSize, &NumberOfWriteBlocks);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
   }
 
   //
@@ -466,167 +758,61 @@ FtwWrite (
   //
   // Record has written to working block, then do the data.
   //
-  //
-  // Allocate a memory buffer
-  //
-  MyBufferSize = WriteLength;
-  MyBuffer     = AllocatePool (MyBufferSize);
-  if (MyBuffer == NULL) {
-    return EFI_OUT_OF_RESOURCES;
-  }
-
-  //
-  // Read all original data from target block to memory buffer
-  //
-  Ptr = MyBuffer;
-  for (Index = 0; Index < NumberOfWriteBlocks; Index += 1) {
-    MyLength = BlockSize;
-    Status   = Fvb->Read (Fvb, Lba + Index, 0, &MyLength, Ptr);
-    if (EFI_ERROR (Status)) {
-      FreePool (MyBuffer);
-      return EFI_ABORTED;
-    }
-
-    Ptr += MyLength;
-  }
-
-  //
-  // Overwrite the updating range data with
-  // the input buffer content
-  //
-  CopyMem (MyBuffer + Offset, Buffer, Length);
-
-  //
-  // Try to keep the content of spare block
-  // Save spare block into a spare backup memory buffer (Sparebuffer)
-  //
-  SpareBufferSize = FtwDevice->SpareAreaLength;
-  SpareBuffer     = AllocatePool (SpareBufferSize);
-  if (SpareBuffer == NULL) {
-    FreePool (MyBuffer);
-    return EFI_OUT_OF_RESOURCES;
-  }
-
-  Ptr = SpareBuffer;
-  for (Index = 0; Index < FtwDevice->NumberOfSpareBlock; Index += 1) {
-    MyLength = FtwDevice->SpareBlockSize;
-    Status   = FtwDevice->FtwBackupFvb->Read (
-                                          FtwDevice->FtwBackupFvb,
-                                          FtwDevice->FtwSpareLba + Index,
-                                          0,
-                                          &MyLength,
-                                          Ptr
-                                          );
-    if (EFI_ERROR (Status)) {
-      FreePool (MyBuffer);
-      FreePool (SpareBuffer);
-      return EFI_ABORTED;
+  if (Journal->RecordCount == 0) {
+    //
+    // Allocate a memory buffer
+    //
+    Journal->Buffer = AllocatePool (NumberOfWriteBlocks * BlockSize);
+    if (Journal->Buffer == NULL) {
+      return EFI_OUT_OF_RESOURCES;
     }
 
-    Ptr += MyLength;
-  }
-
-  //
-  // Write the memory buffer to spare block
-  // Do not assume Spare Block and Target Block have same block size
-  //
-  Status = FtwEraseSpareBlock (FtwDevice);
-  if (EFI_ERROR (Status)) {
-    FreePool (MyBuffer);
-    FreePool (SpareBuffer);
-    return EFI_ABORTED;
-  }
+    //
+    // Read all original data from target block to memory buffer
+    //
+    Ptr = Journal->Buffer;
+    for (Index = 0; Index < NumberOfWriteBlocks; Index += 1) {
+      MyLength = BlockSize;
+      Status   = Fvb->Read (Fvb, Lba + Index, 0, &MyLength, Ptr);
+      if (EFI_ERROR (Status)) {
+        FreePool (Journal->Buffer);
+        Journal->Buffer = NULL;
+        return EFI_ABORTED;
+      }
 
-  Ptr = MyBuffer;
-  for (Index = 0; MyBufferSize > 0; Index += 1) {
-    if (MyBufferSize > FtwDevice->SpareBlockSize) {
-      MyLength = FtwDevice->SpareBlockSize;
-    } else {
-      MyLength = MyBufferSize;
+      Ptr += MyLength;
     }
 
-    Status = FtwDevice->FtwBackupFvb->Write (
-                                        FtwDevice->FtwBackupFvb,
-                                        FtwDevice->FtwSpareLba + Index,
-                                        0,
-                                        &MyLength,
-                                        Ptr
-                                        );
-    if (EFI_ERROR (Status)) {
-      FreePool (MyBuffer);
-      FreePool (SpareBuffer);
-      return EFI_ABORTED;
-    }
-
-    Ptr          += MyLength;
-    MyBufferSize -= MyLength;
+    Journal->Fvb                 = Fvb;
+    Journal->Lba                 = Lba;
+    Journal->BlockSize           = BlockSize;
+    Journal->NumberOfWriteBlocks = NumberOfWriteBlocks;
+    Journal->RecordOffset        = MyOffset;
   }
 
   //
-  // Free MyBuffer
-  //
-  FreePool (MyBuffer);
-
-  //
-  // Set the SpareComplete in the FTW record,
+  // Overwrite the updating range data with
+  // the input buffer content
   //
-  MyOffset = (UINT8 *)Record - FtwDevice->FtwWorkSpace;
-  Status   = FtwUpdateFvState (
-               FtwDevice->FtwFvBlock,
-               FtwDevice->WorkBlockSize,
-               FtwDevice->FtwWorkSpaceLba,
-               FtwDevice->FtwWorkSpaceBase + MyOffset,
-               SPARE_COMPLETED
-               );
-  if (EFI_ERROR (Status)) {
-    FreePool (SpareBuffer);
-    return EFI_ABORTED;
+  CopyMem (Journal->Buffer + Offset, Buffer, Length);
+  Journal->RecordCount++;
+
+  if (Journaled && !IsLastRecordOfWrites (Header, Record)) {
+    DEBUG (
+      (DEBUG_INFO,
+       "Ftw: Write() journaled, (Lba:Offset)=(%lx:0x%x), Length: 0x%x\n",
+       Lba,
+       Offset,
+       Length)
+      );
+    return EFI_SUCCESS;
   }
 
-  Record->SpareComplete = FTW_VALID_STATE;
-
-  //
-  //  Since the content has already backuped in spare block, the write is
-  //  guaranteed to be completed with fault tolerant manner.
-  //
-  Status = FtwWriteRecord (This, Fvb, BlockSize);
+  Status = FtwFlushJournal (FtwDevice);
   if (EFI_ERROR (Status)) {
-    FreePool (SpareBuffer);
-    return EFI_ABORTED;
+    return Status;
   }
 
-  //
-  // Restore spare backup buffer into spare block , if no failure happened during FtwWrite.
-  //
-  Status = FtwEraseSpareBlock (FtwDevice);
-  if (EFI_ERROR (Status)) {
-    FreePool (SpareBuffer);
-    return EFI_ABORTED;
-  }
-
-  Ptr = SpareBuffer;
-  for (Index = 0; Index < FtwDevice->NumberOfSpareBlock; Index += 1) {
-    MyLength = FtwDevice->SpareBlockSize;
-    Status   = FtwDevice->FtwBackupFvb->Write (
-                                          FtwDevice->FtwBackupFvb,
-                                          FtwDevice->FtwSpareLba + Index,
-                                          0,
-                                          &MyLength,
-                                          Ptr
-                                          );
-    if (EFI_ERROR (Status)) {
-      FreePool (SpareBuffer);
-      return EFI_ABORTED;
-    }
-
-    Ptr += MyLength;
-  }
-
-  //
-  // All success.
-  //
-  FreePool (SpareBuffer);
-
   DEBUG (
     (DEBUG_INFO,
      "Ftw: Write() success, (Lba:Offset)=(%lx:0x%x), Length: 0x%x\n",
@@ -669,6 +855,14 @@ FtwRestart (
 
   FtwDevice = FTW_CONTEXT_FROM_THIS (This);
 
+  //
+  // Complete the journaled writes before looking for the interrupted one.
+  //
+  Status = FtwFlushJournal (FtwDevice);
+  if (EFI_ERROR (Status)) {
+    return EFI_ABORTED;
+  }
+
   Status = WorkSpaceRefresh (FtwDevice);
   if (EFI_ERROR (Status)) {
     return EFI_ABORTED;
@@ -757,6 +951,14 @@ FtwAbort (
 
   FtwDevice = FTW_CONTEXT_FROM_THIS (This);
 
+  //
+  // Drop the journaled writes, their records are left not SPARE_COMPLETED.
+  //
+  if (FtwDevice->Journal.RecordCount != 0) {
+    FreePool (FtwDevice->Journal.Buffer);
+    ZeroMem (&FtwDevice->Journal, sizeof (FTW_JOURNAL));
+  }
+
   Status = WorkSpaceRefresh (FtwDevice);
   if (EFI_ERROR (Status)) {
     return EFI_ABORTED;
@@ -838,6 +1040,14 @@ FtwGetLastWrite (
 
   FtwDevice = FTW_CONTEXT_FROM_THIS (This);
 
+  //
+  // The journaled writes are reported as completed ones.
+  //
+  Status = FtwFlushJournal (FtwDevice);
+  if (EFI_ERROR (Status)) {
+    return EFI_ABORTED;
+  }
+
   Status = WorkSpaceRefresh (FtwDevice);
   if (EFI_ERROR (Status)) {
     return EFI_ABORTED;
@@ -49,6 +49,20 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 #define FTW_DEVICE_SIGNATURE  SIGNATURE_32 ('F', 'T', 'W', 'D')
 
+//
+// Writes of a write header that are gathered in memory, to be flushed to their
+// target blocks with one spare block update.
+//
+typedef struct {
+  EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL    *Fvb;                 // FVB of the target blocks
+  EFI_LBA                               Lba;                  // Start LBA of the target blocks
+  UINTN                                 BlockSize;            // Block size in bytes of the target blocks
+  UINTN                                 NumberOfWriteBlocks;  // Number of the target blocks
+  UINT8                                 *Buffer;              // New content of the target blocks
+  UINTN                                 RecordOffset;         // Offset of the first journaled record in work space
+  UINTN                                 RecordCount;          // Number of the journaled records
+} FTW_JOURNAL;
+
 //
 // EFI Fault tolerant protocol private data structure
 //
@@ -78,6 +92,7 @@ typedef struct {
   EFI_LBA                                    FtwWorkSpaceLbaInSpare;  // Start LBA of working space in spare block.
   UINTN                                      FtwWorkSpaceBaseInSpare; // Offset into the FtwWorkSpaceLbaInSpare block.
   UINT8                                      *FtwWorkSpace;           // Point to Work Space in memory buffer
+  FTW_JOURNAL                                Journal;                 // Writes not yet flushed to the target blocks
   //
   // Following a buffer of FtwWorkSpace[FTW_WORK_SPACE_SIZE],
   // Allocated with EFI_FTW_DEVICE.
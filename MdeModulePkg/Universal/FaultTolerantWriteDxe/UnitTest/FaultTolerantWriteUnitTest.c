@@ -0,0 +1,907 @@
+/** @file
+  This is a host-based unit test for the journaled writes of Fault Tolerant Write.
+
+  The FTW core runs on an emulated flash, which counts the blocks it erases and
+  can be powered off after a number of write or erase operations, to measure the
+  erases per logical write and to check the crash recovery of journaled writes.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <Library/UnitTestLib.h>
+
+#include "../FaultTolerantWrite.h"
+
+#define UNIT_TEST_NAME     "Fault Tolerant Write Journal Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// Layout of the emulated flash, in blocks of TEST_BLOCK_SIZE bytes:
+// the target blocks of the writes start at LBA 0, the working block is
+// TEST_WORK_LBA and the spare block is TEST_SPARE_LBA.
+//
+#define TEST_BLOCK_SIZE   SIZE_4KB
+#define TEST_BLOCK_COUNT  16
+#define TEST_WORK_LBA     12
+#define TEST_SPARE_LBA    14
+
+//
+// Number of writes to the same block the tests do, and the size of each.
+//
+#define TEST_WRITE_COUNT   8
+#define TEST_WRITE_LENGTH  0x100
+
+//
+// Operation count of the emulated flash that never powers it off.
+//
+#define TEST_POWER_ALWAYS_ON  MAX_UINTN
+
+/// === TEST DATA ==================================================================================
+
+//
+// mFlash          - Content of the emulated flash
+// mEraseCount     - Number of blocks the emulated flash erased
+// mOperationsLeft - Number of write or erase operations before the power is lost
+// mFtwDevice      - The FTW device running on the emulated flash
+//
+UINT8           *mFlash         = NULL;
+UINTN           mEraseCount     = 0;
+UINTN           mOperationsLeft = TEST_POWER_ALWAYS_ON;
+EFI_FTW_DEVICE  *mFtwDevice     = NULL;
+
+/// === EMULATED FLASH =============================================================================
+
+/**
+  Consume one write or erase operation of the emulated flash.
+
+  @retval TRUE   The flash is powered and does the operation.
+  @retval FALSE  The power is lost, the operation and all the following ones fail.
+**/
+STATIC
+BOOLEAN
+ConsumeOperation (
+  VOID
+  )
+{
+  if (mOperationsLeft == TEST_POWER_ALWAYS_ON) {
+    return TRUE;
+  }
+
+  if (mOperationsLeft == 0) {
+    return FALSE;
+  }
+
+  mOperationsLeft--;
+  return TRUE;
+}
+
+/**
+  Get the attributes of the emulated flash.
+
+  @param[in]  This        The FVB protocol instance.
+  @param[out] Attributes  The attributes of the flash.
+
+  @retval EFI_SUCCESS  The attributes were returned.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+TestFvbGetAttributes (
+  IN CONST EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  OUT EFI_FVB_ATTRIBUTES_2                     *Attributes
+  )
+{
+  *Attributes = EFI_FVB2_READ_STATUS | EFI_FVB2_WRITE_STATUS | EFI_FVB2_ERASE_POLARITY;
+  return EFI_SUCCESS;
+}
+
+/**
+  Get the physical address of the emulated flash.
+
+  @param[in]  This     The FVB protocol instance.
+  @param[out] Address  The address of the flash.
+
+  @retval EFI_SUCCESS  The address was returned.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+TestFvbGetPhysicalAddress (
+  IN CONST EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  OUT EFI_PHYSICAL_ADDRESS                     *Address
+  )
+{
+  *Address = (EFI_PHYSICAL_ADDRESS)(UINTN)mFlash;
+  return EFI_SUCCESS;
+}
+
+/**
+  Get the block size of the emulated flash.
+
+  @param[in]  This            The FVB protocol instance.
+  @param[in]  Lba             The block the size is requested of.
+  @param[out] BlockSize       The size of the block.
+  @param[out] NumberOfBlocks  The number of blocks of this size from Lba on.
+
+  @retval EFI_SUCCESS            The size was returned.
+  @retval EFI_INVALID_PARAMETER  Lba is out of the flash.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+TestFvbGetBlockSize (
+  IN CONST EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  IN EFI_LBA                                   Lba,
+  OUT UINTN                                    *BlockSize,
+  OUT UINTN                                    *NumberOfBlocks
+  )
+{
+  if (Lba >= TEST_BLOCK_COUNT) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  *BlockSize      = TEST_BLOCK_SIZE;
+  *NumberOfBlocks = TEST_BLOCK_COUNT - (UINTN)Lba;
+  return EFI_SUCCESS;
+}
+
+/**
+  Read the emulated flash.
+
+  @param[in]      This      The FVB protocol instance.
+  @param[in]      Lba       The block to read.
+  @param[in]      Offset    The offset in the block to read from.
+  @param[in, out] NumBytes  The number of bytes to read.
+  @param[out]     Buffer    The buffer for the data.
+
+  @retval EFI_SUCCESS            The data was read.
+  @retval EFI_INVALID_PARAMETER  The range is out of the flash.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+TestFvbRead (
+  IN CONST EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  IN EFI_LBA                                   Lba,
+  IN UINTN                                     Offset,
+  IN OUT UINTN                                 *NumBytes,
+  OUT UINT8                                    *Buffer
+  )
+{
+  if ((Lba >= TEST_BLOCK_COUNT) || (Offset + *NumBytes > TEST_BLOCK_SIZE)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  CopyMem (Buffer, mFlash + (UINTN)Lba * TEST_BLOCK_SIZE + Offset, *NumBytes);
+  return EFI_SUCCESS;
+}
+
+/**
+  Write the emulated flash, which like NOR flash only clears bits.
+
+  @param[in]      This      The FVB protocol instance.
+  @param[in]      Lba       The block to write.
+  @param[in]      Offset    The offset in the block to write to.
+  @param[in, out] NumBytes  The number of bytes to write.
+  @param[in]      Buffer    The data to write.
+
+  @retval EFI_SUCCESS            The data was written.
+  @retval EFI_INVALID_PARAMETER  The range is out of the flash.
+  @retval EFI_DEVICE_ERROR       The power is lost.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+TestFvbWrite (
+  IN CONST EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  IN EFI_LBA                                   Lba,
+  IN UINTN                                     Offset,
+  IN OUT UINTN                                 *NumBytes,
+  IN UINT8                                     *Buffer
+  )
+{
+  UINT8  *Ptr;
+  UINTN  Index;
+
+  if ((Lba >= TEST_BLOCK_COUNT) || (Offset + *NumBytes > TEST_BLOCK_SIZE)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (!ConsumeOperation ()) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  Ptr = mFlash + (UINTN)Lba * TEST_BLOCK_SIZE + Offset;
+  for (Index = 0; Index < *NumBytes; Index++) {
+    Ptr[Index] &= Buffer[Index];
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Erase blocks of the emulated flash.
+
+  @param[in] This  The FVB protocol instance.
+  @param[in] ...   Pairs of start LBA and number of blocks, terminated by
+                   EFI_LBA_LIST_TERMINATOR.
+
+  @retval EFI_SUCCESS            The blocks were erased.
+  @retval EFI_INVALID_PARAMETER  A range is out of the flash.
+  @retval EFI_DEVICE_ERROR       The power is lost.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+TestFvbEraseBlocks (
+  IN CONST EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  *This,
+  ...
+  )
+{
+  VA_LIST  Args;
+  EFI_LBA  Lba;
+  UINTN    NumberOfBlocks;
+
+  if (!ConsumeOperation ()) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  VA_START (Args, This);
+  for (Lba = VA_ARG (Args, EFI_LBA); Lba != EFI_LBA_LIST_TERMINATOR; Lba = VA_ARG (Args, EFI_LBA)) {
+    NumberOfBlocks = VA_ARG (Args, UINTN);
+    if (Lba + NumberOfBlocks > TEST_BLOCK_COUNT) {
+      VA_END (Args);
+      return EFI_INVALID_PARAMETER;
+    }
+
+    SetMem (mFlash + (UINTN)Lba * TEST_BLOCK_SIZE, NumberOfBlocks * TEST_BLOCK_SIZE, FTW_ERASED_BYTE);
+    mEraseCount += NumberOfBlocks;
+  }
+
+  VA_END (Args);
+  return EFI_SUCCESS;
+}
+
+EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  mFvb = {
+  TestFvbGetAttributes,
+  NULL,
+  TestFvbGetPhysicalAddress,
+  TestFvbGetBlockSize,
+  TestFvbRead,
+  TestFvbWrite,
+  TestFvbEraseBlocks,
+  NULL
+};
+
+/// === STUBS ======================================================================================
+
+/**
+  Stub of the FVB lookup by handle, the emulated flash is the only FVB.
+
+  @param[in]  FvBlockHandle  The handle of the FVB.
+  @param[out] FvBlock        The FVB protocol.
+
+  @retval EFI_SUCCESS  The emulated flash is returned.
+**/
+EFI_STATUS
+FtwGetFvbByHandle (
+  IN EFI_HANDLE                           FvBlockHandle,
+  OUT EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL  **FvBlock
+  )
+{
+  *FvBlock = &mFvb;
+  return EFI_SUCCESS;
+}
+
+/**
+  Stub of the FVB handle enumeration, the emulated flash is the only FVB.
+
+  @param[out] NumberHandles  The number of FVB handles.
+  @param[out] Buffer         The FVB handles.
+
+  @retval EFI_SUCCESS           The handle of the emulated flash is returned.
+  @retval EFI_OUT_OF_RESOURCES  The handle buffer can not be allocated.
+**/
+EFI_STATUS
+GetFvbCountAndBuffer (
+  OUT UINTN       *NumberHandles,
+  OUT EFI_HANDLE  **Buffer
+  )
+{
+  *Buffer = AllocatePool (sizeof (EFI_HANDLE));
+  if (*Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  (*Buffer)[0]   = (EFI_HANDLE)&mFvb;
+  *NumberHandles = 1;
+  return EFI_SUCCESS;
+}
+
+/**
+  Stub of the Swap Address Range protocol lookup, there is no boot block.
+
+  @param[out] SarProtocol  The Swap Address Range protocol.
+
+  @retval EFI_NOT_FOUND  There is no Swap Address Range protocol.
+**/
+EFI_STATUS
+FtwGetSarProtocol (
+  OUT VOID  **SarProtocol
+  )
+{
+  return EFI_NOT_FOUND;
+}
+
+/**
+  Stub of the CRC32 calculation of FTW.
+
+  @param[in] Buffer  The data.
+  @param[in] Length  The size of the data.
+
+  @return The CRC32 of the data.
+**/
+UINT32
+FtwCalculateCrc32 (
+  IN  VOID   *Buffer,
+  IN  UINTN  Length
+  )
+{
+  return CalculateCrc32 (Buffer, Length);
+}
+
+/**
+  Stub of VariableFlashInfoLib, the working block of the emulated flash.
+
+  @param[out] BaseAddress  The address of the working block.
+  @param[out] Length       The size of the working block.
+
+  @retval EFI_SUCCESS  The working block is returned.
+**/
+EFI_STATUS
+EFIAPI
+GetVariableFlashFtwWorkingInfo (
+  OUT EFI_PHYSICAL_ADDRESS  *BaseAddress,
+  OUT UINT64                *Length
+  )
+{
+  *BaseAddress = (EFI_PHYSICAL_ADDRESS)(UINTN)(mFlash + TEST_WORK_LBA * TEST_BLOCK_SIZE);
+  *Length      = TEST_BLOCK_SIZE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Stub of VariableFlashInfoLib, the spare block of the emulated flash.
+
+  @param[out] BaseAddress  The address of the spare block.
+  @param[out] Length       The size of the spare block.
+
+  @retval EFI_SUCCESS  The spare block is returned.
+**/
+EFI_STATUS
+EFIAPI
+GetVariableFlashFtwSpareInfo (
+  OUT EFI_PHYSICAL_ADDRESS  *BaseAddress,
+  OUT UINT64                *Length
+  )
+{
+  *BaseAddress = (EFI_PHYSICAL_ADDRESS)(UINTN)(mFlash + TEST_SPARE_LBA * TEST_BLOCK_SIZE);
+  *Length      = TEST_BLOCK_SIZE;
+  return EFI_SUCCESS;
+}
+
+/// === HELPERS ====================================================================================
+
+/**
+  Start the FTW device on the emulated flash, as after a reset.
+
+  @retval EFI_SUCCESS  The FTW device is started.
+  @retval other        The FTW device could not be started.
+**/
+STATIC
+EFI_STATUS
+PowerOn (
+  VOID
+  )
+{
+  EFI_STATUS  Status;
+
+  mOperationsLeft = TEST_POWER_ALWAYS_ON;
+
+  Status = InitFtwDevice (&mFtwDevice);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return InitFtwProtocol (mFtwDevice);
+}
+
+/**
+  Stop the FTW device, dropping what it keeps in memory.
+**/
+STATIC
+VOID
+PowerOff (
+  VOID
+  )
+{
+  if (mFtwDevice != NULL) {
+    if (mFtwDevice->Journal.Buffer != NULL) {
+      FreePool (mFtwDevice->Journal.Buffer);
+    }
+
+    FreePool (mFtwDevice);
+    mFtwDevice = NULL;
+  }
+}
+
+/**
+  Fill the data of a test write.
+
+  @param[out] Data   Buffer of TEST_WRITE_LENGTH bytes for the data.
+  @param[in]  Index  The number of the write.
+**/
+STATIC
+VOID
+MakeWriteData (
+  OUT UINT8  *Data,
+  IN  UINTN  Index
+  )
+{
+  SetMem (Data, TEST_WRITE_LENGTH, (UINT8)(0x10 + Index));
+}
+
+/**
+  Write TEST_WRITE_COUNT ranges of the same block through FTW.
+
+  @param[in]  Lba           The target block.
+  @param[in]  WritesPerCall The number of writes allocated at once, which is
+                            TEST_WRITE_COUNT for one write header, or 1 for a
+                            write header per write.
+  @param[out] Expected      Buffer of TEST_BLOCK_SIZE bytes that receives the
+                            content of the block once all the writes are done.
+                            Optional.
+
+  @retval EFI_SUCCESS  All the writes were done.
+  @retval other        A write failed.
+**/
+STATIC
+EFI_STATUS
+WriteRanges (
+  IN  EFI_LBA  Lba,
+  IN  UINTN    WritesPerCall,
+  OUT UINT8    *Expected  OPTIONAL
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Index;
+  UINT8       Data[TEST_WRITE_LENGTH];
+
+  if (Expected != NULL) {
+    CopyMem (Expected, mFlash + (UINTN)Lba * TEST_BLOCK_SIZE, TEST_BLOCK_SIZE);
+  }
+
+  for (Index = 0; Index < TEST_WRITE_COUNT; Index++) {
+    if ((Index % WritesPerCall) == 0) {
+      Status = mFtwDevice->FtwInstance.Allocate (&mFtwDevice->FtwInstance, &gEfiCallerIdGuid, 0, WritesPerCall);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+    }
+
+    MakeWriteData (Data, Index);
+    if (Expected != NULL) {
+      CopyMem (Expected + Index * 2 * TEST_WRITE_LENGTH, Data, TEST_WRITE_LENGTH);
+    }
+
+    Status = mFtwDevice->FtwInstance.Write (
+                                       &mFtwDevice->FtwInstance,
+                                       Lba,
+                                       Index * 2 * TEST_WRITE_LENGTH,
+                                       TEST_WRITE_LENGTH,
+                                       NULL,
+                                       (EFI_HANDLE)&mFvb,
+                                       Data
+                                       );
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/// === TEST CASES =================================================================================
+
+/**
+  Set up an erased emulated flash with the FTW device started on it.
+
+  @param[in] Context  Unused.
+
+  @retval UNIT_TEST_PASSED                      The flash and FTW are ready.
+  @retval UNIT_TEST_ERROR_PREREQUISITE_NOT_MET  FTW could not be started.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+FlashSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN  Index;
+
+  //
+  // FTW requires the working block and the spare block to be block aligned.
+  //
+  mFlash = AllocateAlignedPages (EFI_SIZE_TO_PAGES (TEST_BLOCK_COUNT * TEST_BLOCK_SIZE), TEST_BLOCK_SIZE);
+  if (mFlash == NULL) {
+    return UNIT_TEST_ERROR_PREREQUISITE_NOT_MET;
+  }
+
+  SetMem (mFlash, TEST_BLOCK_COUNT * TEST_BLOCK_SIZE, FTW_ERASED_BYTE);
+
+  //
+  // Give the target blocks some original content.
+  //
+  for (Index = 0; Index < TEST_WORK_LBA * TEST_BLOCK_SIZE; Index++) {
+    mFlash[Index] = (UINT8)(Index * 7);
+  }
+
+  if (EFI_ERROR (PowerOn ())) {
+    return UNIT_TEST_ERROR_PREREQUISITE_NOT_MET;
+  }
+
+  mEraseCount = 0;
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Stop FTW and free the emulated flash.
+
+  @param[in] Context  Unused.
+**/
+STATIC
+VOID
+EFIAPI
+FlashCleanup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  PowerOff ();
+  if (mFlash != NULL) {
+    FreeAlignedPages (mFlash, EFI_SIZE_TO_PAGES (TEST_BLOCK_COUNT * TEST_BLOCK_SIZE));
+    mFlash = NULL;
+  }
+}
+
+/**
+  Benchmark the erases per logical write, with the writes to the same block
+  in one write header against a write header per write.
+
+  @param[in] Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The journaled writes erased less.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+JournaledWritesEraseLess (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       *Expected;
+  UINTN       SingleErases;
+  UINTN       JournaledErases;
+
+  Expected = AllocatePool (TEST_BLOCK_SIZE);
+  UT_ASSERT_NOT_NULL (Expected);
+
+  //
+  // A write header per write, every write updates the spare block.
+  //
+  mEraseCount = 0;
+  Status      = WriteRanges (0, 1, Expected);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_MEM_EQUAL (mFlash, Expected, TEST_BLOCK_SIZE);
+  SingleErases = mEraseCount;
+
+  //
+  // One write header for all the writes, which are journaled.
+  //
+  mEraseCount = 0;
+  Status      = WriteRanges (1, TEST_WRITE_COUNT, Expected);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_MEM_EQUAL (mFlash + TEST_BLOCK_SIZE, Expected, TEST_BLOCK_SIZE);
+  JournaledErases = mEraseCount;
+
+  UT_LOG_INFO (
+    "Erases per logical write: %d.%02d with a write header per write, %d.%02d journaled\n",
+    SingleErases / TEST_WRITE_COUNT,
+    (SingleErases * 100 / TEST_WRITE_COUNT) % 100,
+    JournaledErases / TEST_WRITE_COUNT,
+    (JournaledErases * 100 / TEST_WRITE_COUNT) % 100
+    );
+
+  //
+  // The journaled writes update the spare block and the target block once.
+  //
+  if (FeaturePcdGet (PcdFtwJournalWriteEnable)) {
+    UT_ASSERT_TRUE (JournaledErases * 4 <= SingleErases);
+  }
+
+  FreePool (Expected);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Check that the journaled writes are flushed when a write to other blocks comes,
+  and are not visible in the target block before.
+
+  @param[in] Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The writes reached their blocks.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+WriteToOtherBlocksFlushesTheJournal (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       *Original;
+  UINT8       Data[TEST_WRITE_LENGTH];
+  UINTN       Index;
+
+  Original = AllocateCopyPool (2 * TEST_BLOCK_SIZE, mFlash);
+  UT_ASSERT_NOT_NULL (Original);
+
+  Status = mFtwDevice->FtwInstance.Allocate (&mFtwDevice->FtwInstance, &gEfiCallerIdGuid, 0, 4);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  for (Index = 0; Index < 4; Index++) {
+    MakeWriteData (Data, Index);
+    Status = mFtwDevice->FtwInstance.Write (
+                                       &mFtwDevice->FtwInstance,
+                                       Index / 2,
+                                       Index * TEST_WRITE_LENGTH,
+                                       TEST_WRITE_LENGTH,
+                                       NULL,
+                                       (EFI_HANDLE)&mFvb,
+                                       Data
+                                       );
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+
+    if (FeaturePcdGet (PcdFtwJournalWriteEnable) && (Index == 0)) {
+      //
+      // The first write is journaled, the block keeps its original content.
+      //
+      UT_ASSERT_MEM_EQUAL (mFlash, Original, TEST_BLOCK_SIZE);
+    }
+  }
+
+  for (Index = 0; Index < 4; Index++) {
+    MakeWriteData (Data, Index);
+    CopyMem (Original + (Index / 2) * TEST_BLOCK_SIZE + Index * TEST_WRITE_LENGTH, Data, TEST_WRITE_LENGTH);
+  }
+
+  UT_ASSERT_MEM_EQUAL (mFlash, Original, 2 * TEST_BLOCK_SIZE);
+
+  //
+  // All the writes of the header are completed.
+  //
+  Status = mFtwDevice->FtwInstance.Abort (&mFtwDevice->FtwInstance);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+  FreePool (Original);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Lose the power after every number of flash operations of journaled writes,
+  and check that the writes are either all completed or all undone after FTW
+  is started again, and that FTW keeps working.
+
+  @param[in] Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The writes were all or nothing.
+  @retval UNIT_TEST_SKIPPED            The writes are not journaled.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  Otherwise.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+PowerLossKeepsJournaledWritesAtomic (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       *Original;
+  UINT8       *Expected;
+  UINT8       *Baseline;
+  UINTN       Operations;
+  UINTN       Completed;
+  UINTN       Undone;
+
+  if (!FeaturePcdGet (PcdFtwJournalWriteEnable)) {
+    return UNIT_TEST_SKIPPED;
+  }
+
+  Original = AllocateCopyPool (TEST_BLOCK_SIZE, mFlash);
+  Expected = AllocatePool (TEST_BLOCK_SIZE);
+  Baseline = AllocateCopyPool (TEST_BLOCK_COUNT * TEST_BLOCK_SIZE, mFlash);
+  UT_ASSERT_NOT_NULL (Original);
+  UT_ASSERT_NOT_NULL (Expected);
+  UT_ASSERT_NOT_NULL (Baseline);
+
+  Completed = 0;
+  Undone    = 0;
+  for (Operations = 0; ; Operations++) {
+    //
+    // Start again from the same flash content, and lose the power after
+    // Operations flash operations.
+    //
+    PowerOff ();
+    CopyMem (mFlash, Baseline, TEST_BLOCK_COUNT * TEST_BLOCK_SIZE);
+    Status = PowerOn ();
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+
+    mOperationsLeft = Operations;
+    Status          = WriteRanges (0, TEST_WRITE_COUNT, Expected);
+    if (!EFI_ERROR (Status)) {
+      UT_ASSERT_MEM_EQUAL (mFlash, Expected, TEST_BLOCK_SIZE);
+      break;
+    }
+
+    //
+    // Reset, the recovery completes or undoes all the writes.
+    //
+    PowerOff ();
+    Status = PowerOn ();
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+
+    if (CompareMem (mFlash, Expected, TEST_BLOCK_SIZE) == 0) {
+      Completed++;
+    } else {
+      UT_ASSERT_MEM_EQUAL (mFlash, Original, TEST_BLOCK_SIZE);
+      Undone++;
+    }
+
+    //
+    // FTW keeps working after the recovery.
+    //
+    Status = WriteRanges (2, TEST_WRITE_COUNT, Expected);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    UT_ASSERT_MEM_EQUAL (mFlash + 2 * TEST_BLOCK_SIZE, Expected, TEST_BLOCK_SIZE);
+  }
+
+  UT_LOG_INFO ("%d power losses: %d completed, %d undone\n", Operations, Completed, Undone);
+  UT_ASSERT_TRUE (Completed != 0);
+  UT_ASSERT_TRUE (Undone != 0);
+
+  FreePool (Original);
+  FreePool (Expected);
+  FreePool (Baseline);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Main entry point to this unit test application.
+
+  Sets up and runs the test suites.
+**/
+VOID
+EFIAPI
+UnitTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      JournalTests;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  //
+  // Start setting up the test framework for running the tests.
+  //
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  //
+  // Add all test suites and tests.
+  //
+  Status = CreateUnitTestSuite (
+             &JournalTests,
+             Framework,
+             "Fault Tolerant Write Journal Tests",
+             "Ftw.Journal",
+             NULL,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for JournalTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (
+    JournalTests,
+    "Journaled writes to the same block should erase less flash",
+    "EraseBenchmark",
+    JournaledWritesEraseLess,
+    FlashSetup,
+    FlashCleanup,
+    NULL
+    );
+  AddTestCase (
+    JournalTests,
+    "A write to other blocks should flush the journaled writes",
+    "OtherBlocks",
+    WriteToOtherBlocksFlushesTheJournal,
+    FlashSetup,
+    FlashCleanup,
+    NULL
+    );
+  AddTestCase (
+    JournalTests,
+    "Journaled writes should be all or nothing after a power loss",
+    "PowerLoss",
+    PowerLossKeepsJournaledWritesAtomic,
+    FlashSetup,
+    FlashCleanup,
+    NULL
+    );
+
+  //
+  // Execute the tests.
+  //
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return;
+}
+
+///
+/// Avoid ECC error for function name that starts with lower case letter
+///
+#define Main  main
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+
+  @param[in] Argc  Number of arguments
+  @param[in] Argv  Array of pointers to arguments
+
+  @retval 0      Success
+  @retval other  Error
+**/
+INT32
+Main (
+  IN INT32  Argc,
+  IN CHAR8  *Argv[]
+  )
+{
+  UnitTestMain ();
+  return 0;
+}
@@ -24,6 +24,12 @@ EFI_PEI_PPI_DESCRIPTOR  mPpiListVariable = {
   &mVariablePpi
 };
 
+EFI_PEI_NOTIFY_DESCRIPTOR  mMemoryDiscoveredNotifyList = {
+  (EFI_PEI_PPI_DESCRIPTOR_NOTIFY_CALLBACK | EFI_PEI_PPI_DESCRIPTOR_TERMINATE_LIST),
+  &gEfiPeiMemoryDiscoveredPpiGuid,
+  PeiVariableIndexMemoryDiscovered
+};
+
 /**
   Provide the functionality of the variable services.
 
@@ -41,6 +47,13 @@ PeimInitializeVariableServices (
   IN CONST EFI_PEI_SERVICES     **PeiServices
   )
 {
+  EFI_STATUS  Status;
+
+  if (PcdGet32 (PcdPeiVariableIndexCapacity) != 0) {
+    Status = PeiServicesNotifyPpi (&mMemoryDiscoveredNotifyList);
+    ASSERT_EFI_ERROR (Status);
+  }
+
   return PeiServicesInstallPpi (&mPpiListVariable);
 }
 
@@ -500,6 +513,248 @@ CompareWithValidVariable (
   return EFI_NOT_FOUND;
 }
 
+/**
+  Add the variables of the store that are not in the PEI variable index yet
+  to the index, until the index is full.
+
+  @param  StoreInfo      Pointer to the info of the indexed variable store.
+  @param  VariableIndex  The PEI variable index of the store.
+
+**/
+VOID
+PeiVariableIndexCatchUp (
+  IN     VARIABLE_STORE_INFO       *StoreInfo,
+  IN OUT EDKII_PEI_VARIABLE_INDEX  *VariableIndex
+  )
+{
+  VARIABLE_HEADER           *StartPtr;
+  VARIABLE_HEADER           *EndPtr;
+  VARIABLE_HEADER           *Variable;
+  VARIABLE_HEADER           *NextVariable;
+  PEI_VARIABLE_INDEX_ENTRY  *Entry;
+  UINTN                     Length;
+  UINT32                    Bucket;
+  UINT32                    EntryNumber;
+
+  if (VariableIndex->Unusable) {
+    return;
+  }
+
+  StartPtr = GetStartPointer (StoreInfo->VariableStoreHeader);
+  EndPtr   = GetEndPointer (StoreInfo->VariableStoreHeader);
+
+  for ( Variable = (VARIABLE_HEADER *)((UINTN)StartPtr + VariableIndex->IndexedEnd)
+        ; (Variable < EndPtr) && IsValidVariableHeader (Variable)
+        ; Variable = NextVariable
+        )
+  {
+    NextVariable = GetNextVariablePtr (StoreInfo, Variable, Variable);
+    if (((UINTN)NextVariable <= (UINTN)Variable) || ((UINTN)NextVariable > (UINTN)EndPtr)) {
+      VariableIndex->Unusable = TRUE;
+      return;
+    }
+
+    if (VariableIndexGetNameLength (
+          GetVariableNamePtr (Variable, StoreInfo->AuthFlag),
+          NameSizeOfVariable (Variable, StoreInfo->AuthFlag),
+          EndPtr,
+          &Length
+          ))
+    {
+      if (VariableIndex->EntryCount == VariableIndex->EntryCapacity) {
+        //
+        // The index is full, the variables from here on are walked.
+        //
+        return;
+      }
+
+      EntryNumber   = ++VariableIndex->EntryCount;
+      Entry         = &VariableIndex->Entry[EntryNumber - 1];
+      Entry->Offset = (UINT32)((UINTN)Variable - (UINTN)StartPtr);
+      Entry->Hash   = VariableIndexHash (
+                        GetVendorGuidPtr (Variable, StoreInfo->AuthFlag),
+                        GetVariableNamePtr (Variable, StoreInfo->AuthFlag),
+                        Length
+                        );
+      Entry->Next = 0;
+
+      Bucket = Entry->Hash & (PEI_VARIABLE_INDEX_BUCKET_COUNT - 1);
+      if (VariableIndex->Tail[Bucket] == 0) {
+        VariableIndex->Head[Bucket] = EntryNumber;
+      } else {
+        VariableIndex->Entry[VariableIndex->Tail[Bucket] - 1].Next = EntryNumber;
+      }
+
+      VariableIndex->Tail[Bucket] = EntryNumber;
+    } else if ((Variable->State == VAR_ADDED) || (Variable->State == (VAR_IN_DELETED_TRANSITION & VAR_ADDED))) {
+      //
+      // The walk of the store may select this variable for a name of another hash.
+      //
+      VariableIndex->Unusable = TRUE;
+      return;
+    } else if ((Variable->State & (VAR_IN_DELETED_TRANSITION & VAR_ADDED)) == (VAR_IN_DELETED_TRANSITION & VAR_ADDED)) {
+      //
+      // The variable is still being written, so its name may not be complete yet.
+      //
+      return;
+    }
+
+    VariableIndex->IndexedEnd = (UINT32)((UINTN)NextVariable - (UINTN)StartPtr);
+  }
+}
+
+/**
+  Get the PEI variable index of the non-volatile variable store, and build it
+  in a GUIDed HOB the first time.
+
+  The index is built once per boot, and only holds offsets in the store, so it
+  stays valid when the HOB list is moved to permanent memory.
+
+  @param  StoreInfo     Pointer to the info of the non-volatile variable store.
+
+  @return The PEI variable index of the store, or NULL if the index is disabled
+          or cannot be used for the store.
+
+**/
+EDKII_PEI_VARIABLE_INDEX *
+GetPeiVariableIndex (
+  IN VARIABLE_STORE_INFO  *StoreInfo
+  )
+{
+  EFI_HOB_GUID_TYPE         *GuidHob;
+  EDKII_PEI_VARIABLE_INDEX  *VariableIndex;
+  VARIABLE_STORE_HEADER     *VariableStoreHeader;
+  UINTN                     Capacity;
+
+  Capacity            = PcdGet32 (PcdPeiVariableIndexCapacity);
+  VariableStoreHeader = StoreInfo->VariableStoreHeader;
+  if ((Capacity == 0) || (StoreInfo->FtwLastWriteData != NULL) ||
+      (GetVariableStoreStatus (VariableStoreHeader) != EfiValid) || (~VariableStoreHeader->Size == 0))
+  {
+    return NULL;
+  }
+
+  GuidHob = GetFirstGuidHob (&gEdkiiPeiVariableIndexGuid);
+  if (GuidHob != NULL) {
+    VariableIndex = (EDKII_PEI_VARIABLE_INDEX *)GET_GUID_HOB_DATA (GuidHob);
+  } else {
+    //
+    // The length of a HOB is 16 bits.
+    //
+    Capacity = MIN (
+                 Capacity,
+                 (0xFFF8 - sizeof (EFI_HOB_GUID_TYPE) - OFFSET_OF (EDKII_PEI_VARIABLE_INDEX, Entry)) / sizeof (PEI_VARIABLE_INDEX_ENTRY)
+                 );
+    VariableIndex = (EDKII_PEI_VARIABLE_INDEX *)BuildGuidHob (
+                                                  &gEdkiiPeiVariableIndexGuid,
+                                                  OFFSET_OF (EDKII_PEI_VARIABLE_INDEX, Entry) + Capacity * sizeof (PEI_VARIABLE_INDEX_ENTRY)
+                                                  );
+    if (VariableIndex == NULL) {
+      return NULL;
+    }
+
+    VariableIndex->StoreBase     = 0;
+    VariableIndex->EntryCapacity = (UINT32)Capacity;
+  }
+
+  if ((VariableIndex->StoreBase != (EFI_PHYSICAL_ADDRESS)(UINTN)VariableStoreHeader) ||
+      (VariableIndex->StoreSize != VariableStoreHeader->Size) ||
+      (VariableIndex->AuthFormat != StoreInfo->AuthFlag))
+  {
+    VariableIndex->StoreBase  = (EFI_PHYSICAL_ADDRESS)(UINTN)VariableStoreHeader;
+    VariableIndex->StoreSize  = VariableStoreHeader->Size;
+    VariableIndex->AuthFormat = StoreInfo->AuthFlag;
+    VariableIndex->Unusable   = FALSE;
+    VariableIndex->IndexedEnd = 0;
+    VariableIndex->EntryCount = 0;
+    ZeroMem (VariableIndex->Head, sizeof (VariableIndex->Head));
+    ZeroMem (VariableIndex->Tail, sizeof (VariableIndex->Tail));
+  }
+
+  PeiVariableIndexCatchUp (StoreInfo, VariableIndex);
+
+  return VariableIndex->Unusable ? NULL : VariableIndex;
+}
+
+/**
+  Find a variable through the PEI variable index of the store.
+
+  The index selects the same variables as the walk of the store in
+  FindVariableEx (), but only reads the variables whose GUID and name have the
+  hash of the variable searched.
+
+  @param  StoreInfo     Pointer to the store info structure.
+  @param  VariableName  Name of the variable to be found. Must not be empty.
+  @param  VendorGuid    Vendor GUID to be found.
+  @param  PtrTrack      Variable Track Pointer structure that contains Variable Information.
+  @param  NextVariable  Return the first variable of the store that is not indexed.
+
+  @retval EFI_SUCCESS    The variable was found in the index, in PtrTrack->CurrPtr.
+  @retval EFI_NOT_FOUND  No added variable matches in the index. PtrTrack->CurrPtr is
+                         the last match in delete transition, or NULL. The variables
+                         from NextVariable on must still be walked.
+
+**/
+EFI_STATUS
+PeiVariableIndexFind (
+  IN  VARIABLE_STORE_INFO     *StoreInfo,
+  IN  CONST CHAR16            *VariableName,
+  IN  CONST EFI_GUID          *VendorGuid,
+  OUT VARIABLE_POINTER_TRACK  *PtrTrack,
+  OUT VARIABLE_HEADER         **NextVariable
+  )
+{
+  EDKII_PEI_VARIABLE_INDEX  *VariableIndex;
+  PEI_VARIABLE_INDEX_ENTRY  *Entry;
+  VARIABLE_HEADER           *StartPtr;
+  VARIABLE_HEADER           *Variable;
+  UINTN                     Length;
+  UINT32                    Hash;
+  UINT32                    EntryNumber;
+
+  ASSERT (VariableName[0] != 0);
+
+  VariableIndex = StoreInfo->VariableIndex;
+  StartPtr      = GetStartPointer (StoreInfo->VariableStoreHeader);
+
+  for (Length = 0; VariableName[Length] != L'\0'; Length++) {
+  }
+
+  Hash              = VariableIndexHash (VendorGuid, VariableName, Length);
+  PtrTrack->CurrPtr = NULL;
+
+  for ( EntryNumber = VariableIndex->Head[Hash & (PEI_VARIABLE_INDEX_BUCKET_COUNT - 1)]
+        ; EntryNumber != 0
+        ; EntryNumber = Entry->Next
+        )
+  {
+    Entry = &VariableIndex->Entry[EntryNumber - 1];
+    if (Entry->Hash != Hash) {
+      continue;
+    }
+
+    Variable = (VARIABLE_HEADER *)((UINTN)StartPtr + Entry->Offset);
+    if ((Variable->State != VAR_ADDED) && (Variable->State != (VAR_IN_DELETED_TRANSITION & VAR_ADDED))) {
+      continue;
+    }
+
+    if ((NameSizeOfVariable (Variable, StoreInfo->AuthFlag) != (Length + 1) * sizeof (CHAR16)) ||
+        !CompareGuid (VendorGuid, GetVendorGuidPtr (Variable, StoreInfo->AuthFlag)) ||
+        (CompareMem (VariableName, GetVariableNamePtr (Variable, StoreInfo->AuthFlag), (Length + 1) * sizeof (CHAR16)) != 0))
+    {
+      continue;
+    }
+
+    PtrTrack->CurrPtr = Variable;
+    if (Variable->State == VAR_ADDED) {
+      return EFI_SUCCESS;
+    }
+  }
+
+  *NextVariable = (VARIABLE_HEADER *)((UINTN)StartPtr + VariableIndex->IndexedEnd);
+  return EFI_NOT_FOUND;
+}
+
 /**
   Get HOB variable store.
 
@@ -578,6 +833,7 @@ GetVariableStore (
   UINT32                                BackUpOffset;
 
   StoreInfo->IndexTable       = NULL;
+  StoreInfo->VariableIndex    = NULL;
   StoreInfo->FtwLastWriteData = NULL;
   StoreInfo->AuthFlag         = FALSE;
   VariableStoreHeader         = NULL;
@@ -645,6 +901,12 @@ GetVariableStore (
 
         StoreInfo->AuthFlag = (BOOLEAN)(CompareGuid (&VariableStoreHeader->Signature, &gEfiAuthenticatedVariableGuid));
 
+        StoreInfo->VariableStoreHeader = VariableStoreHeader;
+        StoreInfo->VariableIndex       = GetPeiVariableIndex (StoreInfo);
+        if (StoreInfo->VariableIndex != NULL) {
+          break;
+        }
+
         GuidHob = GetFirstGuidHob (&gEfiVariableIndexTableGuid);
         if (GuidHob != NULL) {
           StoreInfo->IndexTable = GET_GUID_HOB_DATA (GuidHob);
@@ -829,6 +1091,7 @@ FindVariableEx (
   VARIABLE_STORE_HEADER  *VariableStoreHeader;
   VARIABLE_INDEX_TABLE   *IndexTable;
   VARIABLE_HEADER        *VariableHeader;
+  VARIABLE_HEADER        *IndexedEnd;
 
   VariableStoreHeader = StoreInfo->VariableStoreHeader;
 
@@ -855,6 +1118,19 @@ FindVariableEx (
   //
   MaxIndex       = NULL;
   VariableHeader = NULL;
+  IndexedEnd     = NULL;
+
+  if ((StoreInfo->VariableIndex != NULL) && (VariableName[0] != 0)) {
+    //
+    // Look the variable up through the hashed index, and only walk the
+    // variables the index does not hold.
+    //
+    if (PeiVariableIndexFind (StoreInfo, VariableName, VendorGuid, PtrTrack, &IndexedEnd) == EFI_SUCCESS) {
+      return EFI_SUCCESS;
+    }
+
+    InDeletedVariable = PtrTrack->CurrPtr;
+  }
 
   if (IndexTable != NULL) {
     //
@@ -884,7 +1160,10 @@ FindVariableEx (
     }
   }
 
-  if (MaxIndex != NULL) {
+  if (IndexedEnd != NULL) {
+    Variable     = IndexedEnd;
+    LastVariable = IndexedEnd;
+  } else if (MaxIndex != NULL) {
     //
     // HOB exists but the variable cannot be found in HOB
     // If not found in HOB, then let's start from the MaxIndex we've found.
@@ -947,6 +1226,42 @@ FindVariableEx (
   return (PtrTrack->CurrPtr == NULL) ? EFI_NOT_FOUND : EFI_SUCCESS;
 }
 
+/**
+  Build the PEI variable index of the non-volatile variable store, or rebuild
+  it from scratch, once permanent memory is installed.
+
+  The index later PEIMs and the DXE variable driver reuse then describes the
+  store at the address it is read from after memory initialization, and exists
+  even if no PEIM read a variable before.
+
+  @param  PeiServices       An indirect pointer to the EFI_PEI_SERVICES table published by the PEI Foundation.
+  @param  NotifyDescriptor  Address of the notification descriptor data structure.
+  @param  Ppi               Address of the PPI that was installed.
+
+  @retval EFI_SUCCESS       The PEI variable index was rebuilt, or is disabled.
+
+**/
+EFI_STATUS
+EFIAPI
+PeiVariableIndexMemoryDiscovered (
+  IN EFI_PEI_SERVICES           **PeiServices,
+  IN EFI_PEI_NOTIFY_DESCRIPTOR  *NotifyDescriptor,
+  IN VOID                       *Ppi
+  )
+{
+  EFI_HOB_GUID_TYPE    *GuidHob;
+  VARIABLE_STORE_INFO  StoreInfo;
+
+  GuidHob = GetFirstGuidHob (&gEdkiiPeiVariableIndexGuid);
+  if (GuidHob != NULL) {
+    ((EDKII_PEI_VARIABLE_INDEX *)GET_GUID_HOB_DATA (GuidHob))->StoreBase = 0;
+  }
+
+  GetVariableStore (VariableStoreTypeNv, &StoreInfo);
+
+  return EFI_SUCCESS;
+}
+
 /**
   Find the variable in HOB and Non-Volatile variable storages.
 
@@ -12,6 +12,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 #include <PiPei.h>
 #include <Ppi/ReadOnlyVariable2.h>
+#include <Ppi/MemoryDiscovered.h>
 
 #include <Library/DebugLib.h>
 #include <Library/PeimEntryPoint.h>
@@ -25,9 +26,12 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 #include <Guid/VariableFormat.h>
 #include <Guid/VariableIndexTable.h>
+#include <Guid/PeiVariableIndex.h>
 #include <Guid/SystemNvDataGuid.h>
 #include <Guid/FaultTolerantWrite.h>
 
+#include "../VariableIndexHash.h"
+
 typedef enum {
   VariableStoreTypeHob,
   VariableStoreTypeNv,
@@ -38,6 +42,11 @@ typedef struct {
   VARIABLE_STORE_HEADER                   *VariableStoreHeader;
   VARIABLE_INDEX_TABLE                    *IndexTable;
   //
+  // If it is not NULL, the variables are looked up through this hashed index
+  // instead of IndexTable.
+  //
+  EDKII_PEI_VARIABLE_INDEX                *VariableIndex;
+  //
   // If it is not NULL, it means there may be an inconsecutive variable whose
   // partial content is still in NV storage, but another partial content is backed up
   // in spare block.
@@ -68,6 +77,25 @@ PeimInitializeVariableServices (
   IN CONST EFI_PEI_SERVICES     **PeiServices
   );
 
+/**
+  Build the PEI variable index of the non-volatile variable store, or rebuild
+  it from scratch, once permanent memory is installed.
+
+  @param  PeiServices       An indirect pointer to the EFI_PEI_SERVICES table published by the PEI Foundation.
+  @param  NotifyDescriptor  Address of the notification descriptor data structure.
+  @param  Ppi               Address of the PPI that was installed.
+
+  @retval EFI_SUCCESS       The PEI variable index was rebuilt, or is disabled.
+
+**/
+EFI_STATUS
+EFIAPI
+PeiVariableIndexMemoryDiscovered (
+  IN EFI_PEI_SERVICES           **PeiServices,
+  IN EFI_PEI_NOTIFY_DESCRIPTOR  *NotifyDescriptor,
+  IN VOID                       *Ppi
+  );
+
 /**
   This service retrieves a variable's value using its name and GUID.
 
@@ -0,0 +1,428 @@
+/** @file
+  Reclaims the non-volatile variable store incrementally, a few erase blocks at a
+  time, after SetVariable ().
+
+  The store is compacted in place with Fault Tolerant Writes, and is valid after
+  each of them, so a reset during the reclaim only leaves dropped variables
+  behind for the next reclaim to compact.
+
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "Variable.h"
+#include "VariableParsing.h"
+#include "VariableIndex.h"
+#include "VariableRuntimeCache.h"
+
+/**
+  Check whether a variable of the non-volatile variable store is kept when the
+  store is compacted. Like Reclaim (), the added variables are kept, and a
+  variable in delete transition is kept unless the store holds an added
+  variable of the same name and GUID.
+
+  @param[in] Variable           The variable in mNvVariableCache.
+
+  @retval TRUE                  The variable is kept.
+  @retval FALSE                 The variable is dropped.
+
+**/
+STATIC
+BOOLEAN
+ReclaimStepKeepVariable (
+  IN VARIABLE_HEADER  *Variable
+  )
+{
+  VARIABLE_HEADER  *AddedVariable;
+  VARIABLE_HEADER  *StoreEnd;
+  UINTN            NameSize;
+  BOOLEAN          AuthFormat;
+
+  if (Variable->State == VAR_ADDED) {
+    return TRUE;
+  }
+
+  if (Variable->State != (VAR_IN_DELETED_TRANSITION & VAR_ADDED)) {
+    return FALSE;
+  }
+
+  AuthFormat    = mVariableModuleGlobal->VariableGlobal.AuthFormat;
+  NameSize      = NameSizeOfVariable (Variable, AuthFormat);
+  StoreEnd      = (VARIABLE_HEADER *)((UINTN)mNvVariableCache + mVariableModuleGlobal->NonVolatileLastVariableOffset);
+  AddedVariable = GetStartPointer (mNvVariableCache);
+  while (IsValidVariableHeader (AddedVariable, StoreEnd)) {
+    if ((AddedVariable->State == VAR_ADDED) &&
+        (NameSizeOfVariable (AddedVariable, AuthFormat) == NameSize) &&
+        CompareGuid (GetVendorGuidPtr (AddedVariable, AuthFormat), GetVendorGuidPtr (Variable, AuthFormat)) &&
+        (CompareMem (GetVariableNamePtr (AddedVariable, AuthFormat), GetVariableNamePtr (Variable, AuthFormat), NameSize) == 0))
+    {
+      return FALSE;
+    }
+
+    AddedVariable = GetNextVariablePtr (AddedVariable, AuthFormat);
+  }
+
+  return TRUE;
+}
+
+/**
+  Get the end of the erase block of the non-volatile variable store that holds
+  a byte of the store.
+
+  @param[in] Offset             Offset of the byte from the start of the store.
+
+  @return The offset from the start of the store of the end of the erase block.
+
+**/
+STATIC
+UINTN
+ReclaimStepBlockEnd (
+  IN UINTN  Offset
+  )
+{
+  UINTN  BlockSize;
+
+  //
+  // The variable store follows the header of its firmware volume. Assume the
+  // firmware volume has one type of block, like GetLbaAndOffsetByAddress ().
+  //
+  BlockSize = mNvFvHeaderCache->BlockMap[0].Length;
+  return ((mNvFvHeaderCache->HeaderLength + Offset) / BlockSize + 1) * BlockSize - mNvFvHeaderCache->HeaderLength;
+}
+
+/**
+  Write a range of the non-volatile variable store during an incremental
+  reclaim, and update mNvVariableCache and the runtime cache with it.
+
+  @param[in]      Offset        Offset of the range from the start of the store.
+  @param[in]      Length        Length of the range.
+  @param[in]      Buffer        New content of the range.
+  @param[in, out] Budget        Number of erase blocks the reclaim may still
+                                write in this call. It is decreased by the
+                                number of erase blocks the range spans.
+
+  @retval EFI_SUCCESS           The range was written.
+  @retval Others                The range could not be written.
+
+**/
+STATIC
+EFI_STATUS
+ReclaimStepWrite (
+  IN     UINTN  Offset,
+  IN     UINTN  Length,
+  IN     VOID   *Buffer,
+  IN OUT UINTN  *Budget
+  )
+{
+  EFI_STATUS            Status;
+  EFI_STATUS            DoneStatus;
+  EFI_PHYSICAL_ADDRESS  VariableBase;
+  UINTN                 Blocks;
+
+  VariableBase = mVariableModuleGlobal->VariableGlobal.NonVolatileVariableBase;
+  Status       = FtwVariableRange (VariableBase + Offset, Length, Buffer);
+
+  //
+  // Like Reclaim (), refresh the memory copy of the range from the flash even
+  // if the write failed.
+  //
+  CopyMem ((UINT8 *)mNvVariableCache + Offset, (UINT8 *)(UINTN)VariableBase + Offset, Length);
+  VariableIndexInvalidate (mNvVariableCache);
+  RecordRuntimeVariableCacheRewrite (&mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.VariableRuntimeNvCache);
+  DoneStatus = SynchronizeRuntimeVariableCache (
+                 &mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.VariableRuntimeNvCache,
+                 Offset,
+                 Length
+                 );
+  ASSERT_EFI_ERROR (DoneStatus);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Blocks  = (ReclaimStepBlockEnd (Offset + Length - 1) - ReclaimStepBlockEnd (Offset)) / mNvFvHeaderCache->BlockMap[0].Length + 1;
+  *Budget = (*Budget > Blocks) ? (*Budget - Blocks) : 0;
+  return DoneStatus;
+}
+
+/**
+  Complete an incremental reclaim, and recalculate the variable quotas from the
+  compacted non-volatile variable store.
+
+**/
+STATIC
+VOID
+ReclaimStepComplete (
+  VOID
+  )
+{
+  RecalculateNvVariableTotalSize ();
+
+  mVariableModuleGlobal->ReclaimDestinationOffset = 0;
+  mVariableModuleGlobal->ReclaimSourceOffset      = 0;
+}
+
+/**
+  Check whether an incremental reclaim of the non-volatile variable store
+  should be started: the space left for the variables is below a quarter of
+  the variable space, and the dropped variables span at least one erase block.
+
+  @retval TRUE                  An incremental reclaim should be started.
+  @retval FALSE                 The variable space does not need to be reclaimed.
+
+**/
+STATIC
+BOOLEAN
+ReclaimStepNeeded (
+  VOID
+  )
+{
+  VARIABLE_HEADER  *Variable;
+  VARIABLE_HEADER  *NextVariable;
+  VARIABLE_HEADER  *StoreEnd;
+  UINTN            DroppedSize;
+
+  if ((mVariableModuleGlobal->CommonVariableTotalSize < mVariableModuleGlobal->CommonRuntimeVariableSpace / 4 * 3) &&
+      ((PcdGet32 (PcdHwErrStorageSize) == 0) ||
+       (mVariableModuleGlobal->HwErrVariableTotalSize < PcdGet32 (PcdHwErrStorageSize) / 4 * 3)))
+  {
+    return FALSE;
+  }
+
+  DroppedSize = 0;
+  StoreEnd    = (VARIABLE_HEADER *)((UINTN)mNvVariableCache + mVariableModuleGlobal->NonVolatileLastVariableOffset);
+  Variable    = GetStartPointer (mNvVariableCache);
+  while (IsValidVariableHeader (Variable, StoreEnd)) {
+    NextVariable = GetNextVariablePtr (Variable, mVariableModuleGlobal->VariableGlobal.AuthFormat);
+    if ((Variable->State != VAR_ADDED) && (Variable->State != (VAR_IN_DELETED_TRANSITION & VAR_ADDED))) {
+      DroppedSize += (UINTN)NextVariable - (UINTN)Variable;
+    }
+
+    Variable = NextVariable;
+  }
+
+  return (BOOLEAN)(DroppedSize >= mNvFvHeaderCache->BlockMap[0].Length);
+}
+
+/**
+  Perform one write of an incremental reclaim of the non-volatile variable store.
+
+  The variables before ReclaimDestinationOffset are compacted, and the variables
+  from ReclaimSourceOffset on are not processed yet. The dropped variables in
+  between are covered by a deleted filler variable, so that the store is valid
+  after every write. Each write is done through FTW, so a reset during the
+  reclaim leaves a valid store, which the next reclaim compacts further.
+
+  @param[in, out] Budget        Number of erase blocks the reclaim may still
+                                write in this call.
+
+  @retval EFI_SUCCESS           The write was done, or the reclaim is complete.
+  @retval EFI_VOLUME_CORRUPTED  The variable store is corrupted.
+  @retval EFI_OUT_OF_RESOURCES  No enough memory resources.
+  @retval Others                The store could not be written.
+
+**/
+STATIC
+EFI_STATUS
+ReclaimStepOnce (
+  IN OUT UINTN  *Budget
+  )
+{
+  EFI_STATUS       Status;
+  VARIABLE_HEADER  *Variable;
+  VARIABLE_HEADER  *StoreEnd;
+  VARIABLE_HEADER  *Filler;
+  UINT8            *Buffer;
+  UINTN            HeaderSize;
+  UINTN            VariableSize;
+  UINTN            LastOffset;
+  UINTN            Destination;
+  UINTN            Source;
+  UINTN            NewDestination;
+  UINTN            Limit;
+  UINTN            Start;
+  UINTN            End;
+  BOOLEAN          AuthFormat;
+
+  AuthFormat  = mVariableModuleGlobal->VariableGlobal.AuthFormat;
+  HeaderSize  = GetVariableHeaderSize (AuthFormat);
+  LastOffset  = mVariableModuleGlobal->NonVolatileLastVariableOffset;
+  StoreEnd    = (VARIABLE_HEADER *)((UINTN)mNvVariableCache + LastOffset);
+  Destination = mVariableModuleGlobal->ReclaimDestinationOffset;
+  Source      = mVariableModuleGlobal->ReclaimSourceOffset;
+
+  //
+  // The kept variables before the first dropped one stay where they are.
+  //
+  while ((Destination == Source) && (Source < LastOffset)) {
+    Variable = (VARIABLE_HEADER *)((UINTN)mNvVariableCache + Source);
+    if (!IsValidVariableHeader (Variable, StoreEnd)) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    VariableSize = (UINTN)GetNextVariablePtr (Variable, AuthFormat) - (UINTN)Variable;
+    if (VariableSize > LastOffset - Source) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    if (!ReclaimStepKeepVariable (Variable)) {
+      break;
+    }
+
+    Destination += VariableSize;
+    Source      += VariableSize;
+  }
+
+  mVariableModuleGlobal->ReclaimDestinationOffset = Destination;
+  mVariableModuleGlobal->ReclaimSourceOffset      = Source;
+
+  if (Destination == LastOffset) {
+    ReclaimStepComplete ();
+    return EFI_SUCCESS;
+  }
+
+  if (Source == LastOffset) {
+    //
+    // All kept variables are compacted. Erase the filler variable from its end,
+    // one erase block at a time, until the rest of it is in the erase blocks of
+    // its header. Then erase the rest along with the header.
+    //
+    End = LastOffset;
+    while ((End > Destination + HeaderSize) && (((UINT8 *)mNvVariableCache)[End - 1] == 0xff)) {
+      End--;
+    }
+
+    if (End <= ReclaimStepBlockEnd (Destination + HeaderSize - 1)) {
+      Start = Destination;
+    } else {
+      Start = ReclaimStepBlockEnd (End - 1) - mNvFvHeaderCache->BlockMap[0].Length;
+      Start = MAX (Start, Destination + HeaderSize);
+    }
+
+    Buffer = AllocatePool (End - Start);
+    if (Buffer == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    SetMem (Buffer, End - Start, 0xff);
+    Status = ReclaimStepWrite (Start, End - Start, Buffer, Budget);
+    FreePool (Buffer);
+    if (!EFI_ERROR (Status) && (Start == Destination)) {
+      mVariableModuleGlobal->NonVolatileLastVariableOffset = Destination;
+      ReclaimStepComplete ();
+    }
+
+    return Status;
+  }
+
+  //
+  // Move the next kept variables down to the destination, up to the end of
+  // its erase block. The last one may cross the end of the erase block.
+  //
+  Limit  = ReclaimStepBlockEnd (Destination);
+  Buffer = AllocatePool (Limit - Destination + mVariableModuleGlobal->ScratchBufferSize + HeaderSize);
+  if (Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  NewDestination = Destination;
+  while ((Source < LastOffset) && (NewDestination < Limit)) {
+    Variable = (VARIABLE_HEADER *)((UINTN)mNvVariableCache + Source);
+    if (!IsValidVariableHeader (Variable, StoreEnd)) {
+      Status = EFI_VOLUME_CORRUPTED;
+      goto Done;
+    }
+
+    VariableSize = (UINTN)GetNextVariablePtr (Variable, AuthFormat) - (UINTN)Variable;
+    if (VariableSize > LastOffset - Source) {
+      Status = EFI_VOLUME_CORRUPTED;
+      goto Done;
+    }
+
+    if (ReclaimStepKeepVariable (Variable)) {
+      if (VariableSize > mVariableModuleGlobal->ScratchBufferSize) {
+        Status = EFI_VOLUME_CORRUPTED;
+        goto Done;
+      }
+
+      CopyMem (Buffer + NewDestination - Destination, Variable, VariableSize);
+      ((VARIABLE_HEADER *)(Buffer + NewDestination - Destination))->State = VAR_ADDED;
+      NewDestination += VariableSize;
+    }
+
+    Source += VariableSize;
+  }
+
+  //
+  // Each dropped variable is at least a variable header, so the filler
+  // variable covering them always fits in the space they leave.
+  //
+  ASSERT (Source - NewDestination >= HeaderSize);
+  Filler = (VARIABLE_HEADER *)(Buffer + NewDestination - Destination);
+  ZeroMem (Filler, HeaderSize);
+  Filler->StartId = VARIABLE_DATA;
+  Filler->State   = VAR_ADDED & VAR_DELETED;
+  SetDataSizeOfVariable (Filler, Source - NewDestination - HeaderSize, AuthFormat);
+
+  Status = ReclaimStepWrite (Destination, NewDestination + HeaderSize - Destination, Buffer, Budget);
+  if (!EFI_ERROR (Status)) {
+    mVariableModuleGlobal->ReclaimDestinationOffset = NewDestination;
+    mVariableModuleGlobal->ReclaimSourceOffset      = Source;
+  }
+
+Done:
+  FreePool (Buffer);
+  return Status;
+}
+
+/**
+  Reclaim the non-volatile variable store incrementally.
+
+  When PcdVariableIncrementalReclaim is TRUE, this function is called after every
+  SetVariable (). When the space left for the variables runs low, it compacts the
+  non-volatile variable store in place, and stops once it has written
+  PcdVariableIncrementalReclaimBlocks erase blocks in the call. A single write
+  spans at most the erase blocks of one variable plus two. This bounds the time
+  a SetVariable () call spends reclaiming, and lets the variable space be
+  reclaimed at runtime without erasing the whole store at once.
+
+**/
+VOID
+ReclaimStep (
+  VOID
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Budget;
+
+  if (!FeaturePcdGet (PcdVariableIncrementalReclaim) ||
+      mVariableModuleGlobal->VariableGlobal.EmuNvMode ||
+      mVariableModuleGlobal->BatchActive ||
+      (mVariableModuleGlobal->FvbInstance == NULL) ||
+      (AtRuntime () && !FtwAvailableAtRuntime ()))
+  {
+    return;
+  }
+
+  if (mVariableModuleGlobal->ReclaimSourceOffset == 0) {
+    if (!ReclaimStepNeeded ()) {
+      return;
+    }
+
+    mVariableModuleGlobal->ReclaimDestinationOffset = (UINTN)GetStartPointer (mNvVariableCache) - (UINTN)mNvVariableCache;
+    mVariableModuleGlobal->ReclaimSourceOffset      = mVariableModuleGlobal->ReclaimDestinationOffset;
+  }
+
+  Budget = PcdGet32 (PcdVariableIncrementalReclaimBlocks);
+  do {
+    Status = ReclaimStepOnce (&Budget);
+    if (EFI_ERROR (Status)) {
+      //
+      // Leave the store to Reclaim (), which compacts it from any valid state.
+      //
+      DEBUG ((DEBUG_ERROR, "Variable: incremental reclaim stopped - %r\n", Status));
+      mVariableModuleGlobal->ReclaimDestinationOffset = 0;
+      mVariableModuleGlobal->ReclaimSourceOffset      = 0;
+      return;
+    }
+  } while ((Budget > 0) && (mVariableModuleGlobal->ReclaimSourceOffset != 0));
+}
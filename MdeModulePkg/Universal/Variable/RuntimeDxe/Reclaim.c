@@ -155,3 +155,58 @@ FtwVariableSpace (
 
   return Status;
 }
+
+/**
+  Writes a buffer to a range of the variable storage space.
+
+  This function writes a buffer to a range of the variable storage space
+  through the Fault Tolerant Write protocol, so that the blocks the range
+  spans are either fully updated or left unchanged.
+
+  @param  Address        Address of the range to write.
+  @param  Length         Length of the range to write.
+  @param  Buffer         Point to the new content of the range.
+
+  @retval EFI_SUCCESS    The function completed successfully.
+  @retval EFI_NOT_FOUND  Fail to locate Fault Tolerant Write protocol.
+  @retval EFI_ABORTED    The function could not complete successfully.
+
+**/
+EFI_STATUS
+FtwVariableRange (
+  IN EFI_PHYSICAL_ADDRESS  Address,
+  IN UINTN                 Length,
+  IN VOID                  *Buffer
+  )
+{
+  EFI_STATUS                         Status;
+  EFI_HANDLE                         FvbHandle;
+  EFI_LBA                            Lba;
+  UINTN                              Offset;
+  EFI_FAULT_TOLERANT_WRITE_PROTOCOL  *FtwProtocol;
+
+  Status = GetFtwProtocol ((VOID **)&FtwProtocol);
+  if (EFI_ERROR (Status)) {
+    return EFI_NOT_FOUND;
+  }
+
+  Status = GetFvbInfoByAddress (Address, &FvbHandle, NULL);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = GetLbaAndOffsetByAddress (Address, &Lba, &Offset);
+  if (EFI_ERROR (Status)) {
+    return EFI_ABORTED;
+  }
+
+  return FtwProtocol->Write (
+                        FtwProtocol,
+                        Lba,
+                        Offset,
+                        Length,
+                        NULL,
+                        FvbHandle,
+                        Buffer
+                        );
+}
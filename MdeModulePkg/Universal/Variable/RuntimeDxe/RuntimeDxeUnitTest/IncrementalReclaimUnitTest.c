@@ -0,0 +1,821 @@
+/** @file
+  This is a host-based unit test for the incremental reclaim of the non-volatile
+  variable store.
+
+  The store is kept in erase blocks of TEST_BLOCK_SIZE bytes, so that a reclaim
+  takes many writes. The reclaim is interrupted by a simulated reset at each of
+  its writes, and the store left in the flash must then hold the same variables
+  as before the reclaim, and be compacted by the next reclaim.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <Uefi.h>
+#include <Library/DebugLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UnitTestLib.h>
+
+#include "../Variable.h"
+#include "../VariableParsing.h"
+
+#define UNIT_TEST_NAME     "Variable Incremental Reclaim Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+#define TEST_BLOCK_SIZE     512
+#define TEST_STORE_SIZE     SIZE_8KB
+#define TEST_SCRATCH_SIZE   SIZE_1KB
+#define TEST_MAX_DATA_SIZE  300
+
+//
+// Number of distinct names the randomly generated stores pick from.
+//
+#define TEST_NAME_COUNT  16
+
+//
+// Number of ReclaimStep () calls after which a reclaim is expected to be complete.
+//
+#define TEST_MAX_STEPS  1000
+
+/// === TEST DATA ==================================================================================
+
+//
+// Test GUID {3D7B2E94-6C1A-4F85-B3D0-8A5E1F9C2B47}
+//
+EFI_GUID  mTestGuid = {
+  0x3d7b2e94, 0x6c1a, 0x4f85, { 0xb3, 0xd0, 0x8a, 0x5e, 0x1f, 0x9c, 0x2b, 0x47 }
+};
+
+//
+// mVariableModuleGlobal - The module global of the variable driver
+// mNvVariableCache      - The non-volatile variable cache
+// mNvFvHeaderCache      - The header of the firmware volume of the store
+// mFlash                - The simulated non-volatile variable store in the flash
+// mExpected             - Copy of the store before the reclaim
+// mFtwWrites            - Number of the Fault Tolerant Writes to the flash
+// mResetAt              - Number of the write the simulated reset happens at
+// mReset                - TRUE once the simulated reset happened
+// mRandomSeed           - State of the generator of the random stores
+//
+VARIABLE_MODULE_GLOBAL      *mVariableModuleGlobal = NULL;
+VARIABLE_STORE_HEADER       *mNvVariableCache      = NULL;
+EFI_FIRMWARE_VOLUME_HEADER  *mNvFvHeaderCache      = NULL;
+VARIABLE_STORE_HEADER       *mFlash                = NULL;
+VARIABLE_STORE_HEADER       *mExpected             = NULL;
+UINTN                       mFtwWrites;
+UINTN                       mResetAt;
+BOOLEAN                     mReset;
+UINT32                      mRandomSeed;
+
+/// === STUBS ======================================================================================
+
+/**
+  Stub of the AtRuntime () of the variable driver.
+
+  @retval FALSE  The test runs before ExitBootServices ().
+**/
+BOOLEAN
+AtRuntime (
+  VOID
+  )
+{
+  return FALSE;
+}
+
+/**
+  Stub of FtwAvailableAtRuntime ().
+
+  @retval TRUE  The Fault Tolerant Write is always available.
+**/
+BOOLEAN
+FtwAvailableAtRuntime (
+  VOID
+  )
+{
+  return TRUE;
+}
+
+/**
+  Stub of the index lookup, the test stores are not indexed.
+
+  @retval EFI_UNSUPPORTED  The store is walked instead.
+**/
+EFI_STATUS
+VariableIndexFind (
+  IN     CHAR16                  *VariableName,
+  IN     EFI_GUID                *VendorGuid,
+  IN     BOOLEAN                 IgnoreRtCheck,
+  IN OUT VARIABLE_POINTER_TRACK  *PtrTrack,
+  IN     BOOLEAN                 AuthFormat
+  )
+{
+  return EFI_UNSUPPORTED;
+}
+
+/**
+  Stub of the index invalidation, the test stores are not indexed.
+**/
+VOID
+VariableIndexInvalidate (
+  IN VARIABLE_STORE_HEADER  *Store OPTIONAL
+  )
+{
+}
+
+/**
+  Stub of the quota recalculation, the test keeps the quotas high so that the
+  reclaim is always needed.
+**/
+VOID
+RecalculateNvVariableTotalSize (
+  VOID
+  )
+{
+}
+
+/**
+  Stub of the record of the runtime cache rewrites, the test has no runtime cache.
+**/
+VOID
+RecordRuntimeVariableCacheRewrite (
+  IN  VARIABLE_RUNTIME_CACHE  *VariableRuntimeCache
+  )
+{
+}
+
+/**
+  Stub of the runtime cache synchronization, the test has no runtime cache.
+**/
+EFI_STATUS
+SynchronizeRuntimeVariableCache (
+  IN  VARIABLE_RUNTIME_CACHE  *VariableRuntimeCache,
+  IN  UINTN                   Offset,
+  IN  UINTN                   Length
+  )
+{
+  return EFI_SUCCESS;
+}
+
+/**
+  Fake Fault Tolerant Write of the non-volatile variable store. The write number
+  mResetAt is interrupted by a reset, which leaves the flash unchanged, and the
+  flash cannot be written after the reset.
+
+  @param[in] Address  The address in the flash to write.
+  @param[in] Length   The length in bytes to write.
+  @param[in] Buffer   The data to write.
+
+  @retval EFI_SUCCESS       The data was written.
+  @retval EFI_DEVICE_ERROR  The reset happened.
+**/
+EFI_STATUS
+FtwVariableRange (
+  IN EFI_PHYSICAL_ADDRESS  Address,
+  IN UINTN                 Length,
+  IN VOID                  *Buffer
+  )
+{
+  if (mReset || (mFtwWrites == mResetAt)) {
+    mReset = TRUE;
+    return EFI_DEVICE_ERROR;
+  }
+
+  mFtwWrites++;
+  CopyMem ((VOID *)(UINTN)Address, Buffer, Length);
+  return EFI_SUCCESS;
+}
+
+/// === HELPERS ====================================================================================
+
+/**
+  Get the next number of the generator of the random stores.
+
+  @return A pseudo random number.
+**/
+STATIC
+UINT32
+NextRandom (
+  VOID
+  )
+{
+  mRandomSeed = mRandomSeed * 1103515245 + 12345;
+  return mRandomSeed >> 16;
+}
+
+/**
+  Make the test variable name of a number, "Var" followed by 2 hexadecimal digits.
+
+  @param[out] Name    Buffer of 6 characters for the name.
+  @param[in]  Number  The number of the name.
+**/
+STATIC
+VOID
+MakeName (
+  OUT CHAR16  *Name,
+  IN  UINTN   Number
+  )
+{
+  Name[0] = L'V';
+  Name[1] = L'a';
+  Name[2] = L'r';
+  Name[3] = L"0123456789ABCDEF"[(Number >> 4) & 0xF];
+  Name[4] = L"0123456789ABCDEF"[Number & 0xF];
+  Name[5] = L'\0';
+}
+
+/**
+  Find the added variable of a name in the non-volatile variable cache.
+
+  @param[in] Name  The name of the variable.
+
+  @return The header of the variable, or NULL if the store has no added variable
+          of the name.
+**/
+STATIC
+VARIABLE_HEADER *
+FindAddedVariable (
+  IN CONST CHAR16  *Name
+  )
+{
+  VARIABLE_HEADER  *Variable;
+
+  Variable = GetStartPointer (mNvVariableCache);
+  while (IsValidVariableHeader (Variable, GetEndPointer (mNvVariableCache))) {
+    if ((Variable->State == VAR_ADDED) && (CompareMem (GetVariableNamePtr (Variable, FALSE), Name, StrSize (Name)) == 0)) {
+      return Variable;
+    }
+
+    Variable = GetNextVariablePtr (Variable, FALSE);
+  }
+
+  return NULL;
+}
+
+/**
+  Append a variable of random data to the non-volatile variable cache.
+
+  @param[in] Name   The name of the variable.
+  @param[in] State  The state of the variable.
+
+  @retval TRUE   The variable was appended.
+  @retval FALSE  The store is full.
+**/
+STATIC
+BOOLEAN
+AppendVariable (
+  IN CONST CHAR16  *Name,
+  IN UINT8         State
+  )
+{
+  VARIABLE_HEADER  *Variable;
+  UINTN            NameSize;
+  UINTN            DataSize;
+  UINTN            VariableSize;
+
+  NameSize     = StrSize (Name);
+  DataSize     = NextRandom () % TEST_MAX_DATA_SIZE + 1;
+  VariableSize = HEADER_ALIGN (sizeof (VARIABLE_HEADER) + NameSize + GET_PAD_SIZE (NameSize) + DataSize);
+  if (mVariableModuleGlobal->NonVolatileLastVariableOffset + VariableSize > TEST_STORE_SIZE) {
+    return FALSE;
+  }
+
+  Variable             = (VARIABLE_HEADER *)((UINT8 *)mNvVariableCache + mVariableModuleGlobal->NonVolatileLastVariableOffset);
+  Variable->StartId    = VARIABLE_DATA;
+  Variable->State      = State;
+  Variable->Reserved   = 0;
+  Variable->Attributes = EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS;
+  Variable->NameSize   = (UINT32)NameSize;
+  Variable->DataSize   = (UINT32)DataSize;
+  CopyGuid (&Variable->VendorGuid, &mTestGuid);
+  CopyMem (GetVariableNamePtr (Variable, FALSE), Name, NameSize);
+  SetMem (GetVariableDataPtr (Variable, FALSE), DataSize, (UINT8)NextRandom ());
+
+  mVariableModuleGlobal->NonVolatileLastVariableOffset += VariableSize;
+  return TRUE;
+}
+
+/**
+  Fill the non-volatile variable cache with random updates and deletions of
+  variables, including updates interrupted in delete transition, and copy it
+  to the flash.
+**/
+STATIC
+VOID
+FillRandomStore (
+  VOID
+  )
+{
+  CHAR16           Name[6];
+  VARIABLE_HEADER  *Previous;
+  UINT8            State;
+
+  do {
+    MakeName (Name, NextRandom () % TEST_NAME_COUNT);
+    Previous = FindAddedVariable (Name);
+    State    = VAR_ADDED;
+    switch (NextRandom () % 4) {
+      case 0:
+        //
+        // An update, or the deletion of a variable that does not exist.
+        //
+        if (Previous != NULL) {
+          Previous->State &= VAR_DELETED;
+        } else {
+          State = VAR_ADDED & VAR_DELETED;
+        }
+
+        break;
+      case 1:
+        //
+        // An update interrupted once the new copy was added.
+        //
+        if (Previous != NULL) {
+          Previous->State &= VAR_IN_DELETED_TRANSITION;
+        }
+
+        break;
+      case 2:
+        //
+        // A deletion.
+        //
+        if (Previous != NULL) {
+          Previous->State &= VAR_DELETED;
+          continue;
+        }
+
+        State = VAR_ADDED & VAR_DELETED;
+        break;
+      default:
+        //
+        // An update interrupted before the new copy was added.
+        //
+        if (Previous != NULL) {
+          Previous->State &= VAR_IN_DELETED_TRANSITION;
+          continue;
+        }
+
+        break;
+    }
+  } while (AppendVariable (Name, State));
+
+  CopyMem (mFlash, mNvVariableCache, TEST_STORE_SIZE);
+}
+
+/**
+  Check whether a variable of a store is visible to GetVariable ().
+
+  @param[in] Store     The variable store.
+  @param[in] Variable  The variable.
+
+  @retval TRUE   The variable is visible.
+  @retval FALSE  The variable is deleted.
+**/
+STATIC
+BOOLEAN
+IsVisibleVariable (
+  IN VARIABLE_STORE_HEADER  *Store,
+  IN VARIABLE_HEADER        *Variable
+  )
+{
+  VARIABLE_HEADER  *Added;
+
+  if (Variable->State == VAR_ADDED) {
+    return TRUE;
+  }
+
+  if (Variable->State != (VAR_IN_DELETED_TRANSITION & VAR_ADDED)) {
+    return FALSE;
+  }
+
+  Added = GetStartPointer (Store);
+  while (IsValidVariableHeader (Added, GetEndPointer (Store))) {
+    if ((Added->State == VAR_ADDED) &&
+        (Added->NameSize == Variable->NameSize) &&
+        (CompareMem (GetVariableNamePtr (Added, FALSE), GetVariableNamePtr (Variable, FALSE), Variable->NameSize) == 0))
+    {
+      return FALSE;
+    }
+
+    Added = GetNextVariablePtr (Added, FALSE);
+  }
+
+  return TRUE;
+}
+
+/**
+  Get the next variable of a store visible to GetVariable ().
+
+  @param[in] Store     The variable store.
+  @param[in] Variable  The variable to start the search from.
+
+  @return The next visible variable, or NULL if there is none.
+**/
+STATIC
+VARIABLE_HEADER *
+NextVisibleVariable (
+  IN VARIABLE_STORE_HEADER  *Store,
+  IN VARIABLE_HEADER        *Variable
+  )
+{
+  while (IsValidVariableHeader (Variable, GetEndPointer (Store))) {
+    if (IsVisibleVariable (Store, Variable)) {
+      return Variable;
+    }
+
+    Variable = GetNextVariablePtr (Variable, FALSE);
+  }
+
+  return NULL;
+}
+
+/**
+  Check that the flash holds a valid variable store, with the variables of the
+  store before the reclaim.
+
+  @param[out] Total  Number of the variables of the flash.
+  @param[out] Kept   Number of the visible variables of the flash.
+
+  @retval TRUE   The flash holds the variables of the store before the reclaim.
+  @retval FALSE  The store of the flash is corrupted, or lost variables.
+**/
+STATIC
+BOOLEAN
+CheckFlash (
+  OUT UINTN  *Total,
+  OUT UINTN  *Kept
+  )
+{
+  VARIABLE_HEADER  *Variable;
+  VARIABLE_HEADER  *Next;
+  VARIABLE_HEADER  *Expected;
+  UINT8            *Byte;
+
+  *Total = 0;
+  *Kept  = 0;
+
+  Variable = GetStartPointer (mFlash);
+  while (IsValidVariableHeader (Variable, GetEndPointer (mFlash))) {
+    Next = GetNextVariablePtr (Variable, FALSE);
+    if ((UINTN)Next > (UINTN)GetEndPointer (mFlash)) {
+      return FALSE;
+    }
+
+    (*Total)++;
+    Variable = Next;
+  }
+
+  //
+  // The store must be erased after its last variable for the next variables.
+  //
+  for (Byte = (UINT8 *)Variable; Byte < (UINT8 *)GetEndPointer (mFlash); Byte++) {
+    if (*Byte != 0xff) {
+      return FALSE;
+    }
+  }
+
+  Variable = NextVisibleVariable (mFlash, GetStartPointer (mFlash));
+  Expected = NextVisibleVariable (mExpected, GetStartPointer (mExpected));
+  while ((Variable != NULL) && (Expected != NULL)) {
+    if ((Variable->NameSize != Expected->NameSize) ||
+        (Variable->DataSize != Expected->DataSize) ||
+        (Variable->Attributes != Expected->Attributes) ||
+        !CompareGuid (&Variable->VendorGuid, &Expected->VendorGuid) ||
+        (CompareMem (GetVariableNamePtr (Variable, FALSE), GetVariableNamePtr (Expected, FALSE), Variable->NameSize) != 0) ||
+        (CompareMem (GetVariableDataPtr (Variable, FALSE), GetVariableDataPtr (Expected, FALSE), Variable->DataSize) != 0))
+    {
+      return FALSE;
+    }
+
+    (*Kept)++;
+    Variable = NextVisibleVariable (mFlash, GetNextVariablePtr (Variable, FALSE));
+    Expected = NextVisibleVariable (mExpected, GetNextVariablePtr (Expected, FALSE));
+  }
+
+  return (BOOLEAN)((Variable == NULL) && (Expected == NULL));
+}
+
+/**
+  Simulate a reset: reload the non-volatile variable cache from the flash, and
+  forget the state of the reclaim.
+**/
+STATIC
+VOID
+Reset (
+  VOID
+  )
+{
+  VARIABLE_HEADER  *Variable;
+
+  mReset = FALSE;
+  CopyMem (mNvVariableCache, mFlash, TEST_STORE_SIZE);
+
+  Variable = GetStartPointer (mNvVariableCache);
+  while (IsValidVariableHeader (Variable, GetEndPointer (mNvVariableCache))) {
+    Variable = GetNextVariablePtr (Variable, FALSE);
+  }
+
+  mVariableModuleGlobal->NonVolatileLastVariableOffset = (UINTN)Variable - (UINTN)mNvVariableCache;
+  mVariableModuleGlobal->ReclaimDestinationOffset      = 0;
+  mVariableModuleGlobal->ReclaimSourceOffset           = 0;
+}
+
+/**
+  Call ReclaimStep () as SetVariable () does, until the reclaim is complete or
+  the simulated reset happens.
+
+  @retval TRUE   The reclaim is complete, or the reset happened.
+  @retval FALSE  The reclaim did not complete in TEST_MAX_STEPS calls.
+**/
+STATIC
+BOOLEAN
+RunReclaim (
+  VOID
+  )
+{
+  UINTN  Steps;
+
+  for (Steps = 0; Steps < TEST_MAX_STEPS; Steps++) {
+    ReclaimStep ();
+    if (mReset || (mVariableModuleGlobal->ReclaimSourceOffset == 0)) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/// === TEST CASES =================================================================================
+
+/**
+  Set up a full non-volatile variable store of random variables, in erase
+  blocks of TEST_BLOCK_SIZE bytes.
+
+  @param[in]  Context  Unit test case context
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+ReclaimSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  mVariableModuleGlobal = AllocateZeroPool (sizeof (VARIABLE_MODULE_GLOBAL));
+  mNvFvHeaderCache      = AllocateZeroPool (sizeof (EFI_FIRMWARE_VOLUME_HEADER) + sizeof (EFI_FV_BLOCK_MAP_ENTRY));
+  mNvVariableCache      = AllocatePool (TEST_STORE_SIZE);
+  mFlash                = AllocatePool (TEST_STORE_SIZE);
+  UT_ASSERT_NOT_NULL (mVariableModuleGlobal);
+  UT_ASSERT_NOT_NULL (mNvFvHeaderCache);
+  UT_ASSERT_NOT_NULL (mNvVariableCache);
+  UT_ASSERT_NOT_NULL (mFlash);
+
+  mNvFvHeaderCache->HeaderLength       = sizeof (EFI_FIRMWARE_VOLUME_HEADER) + sizeof (EFI_FV_BLOCK_MAP_ENTRY);
+  mNvFvHeaderCache->FvLength           = mNvFvHeaderCache->HeaderLength + TEST_STORE_SIZE;
+  mNvFvHeaderCache->BlockMap[0].Length = TEST_BLOCK_SIZE;
+
+  SetMem (mNvVariableCache, TEST_STORE_SIZE, 0xFF);
+  CopyGuid (&mNvVariableCache->Signature, &gEfiVariableGuid);
+  mNvVariableCache->Size      = TEST_STORE_SIZE;
+  mNvVariableCache->Format    = VARIABLE_STORE_FORMATTED;
+  mNvVariableCache->State     = VARIABLE_STORE_HEALTHY;
+  mNvVariableCache->Reserved  = 0;
+  mNvVariableCache->Reserved1 = 0;
+
+  mVariableModuleGlobal->VariableGlobal.NonVolatileVariableBase = (EFI_PHYSICAL_ADDRESS)(UINTN)mFlash;
+  mVariableModuleGlobal->NonVolatileLastVariableOffset          = (UINTN)GetStartPointer (mNvVariableCache) - (UINTN)mNvVariableCache;
+  mVariableModuleGlobal->ScratchBufferSize                      = TEST_SCRATCH_SIZE;
+  mVariableModuleGlobal->FvbInstance                            = (EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL *)mFlash;
+  mVariableModuleGlobal->CommonRuntimeVariableSpace             = TEST_STORE_SIZE;
+  mVariableModuleGlobal->CommonVariableTotalSize                = TEST_STORE_SIZE;
+
+  mRandomSeed = 0x5EED;
+  FillRandomStore ();
+
+  mExpected = AllocateCopyPool (TEST_STORE_SIZE, mFlash);
+  UT_ASSERT_NOT_NULL (mExpected);
+
+  mFtwWrites = 0;
+  mResetAt   = MAX_UINTN;
+  mReset     = FALSE;
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Free the stores of a test.
+
+  @param[in]  Context  Unit test case context
+**/
+STATIC
+VOID
+EFIAPI
+ReclaimCleanup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  if (mExpected != NULL) {
+    FreePool (mExpected);
+    mExpected = NULL;
+  }
+
+  if (mFlash != NULL) {
+    FreePool (mFlash);
+    mFlash = NULL;
+  }
+
+  if (mNvVariableCache != NULL) {
+    FreePool (mNvVariableCache);
+    mNvVariableCache = NULL;
+  }
+
+  if (mNvFvHeaderCache != NULL) {
+    FreePool (mNvFvHeaderCache);
+    mNvFvHeaderCache = NULL;
+  }
+
+  if (mVariableModuleGlobal != NULL) {
+    FreePool (mVariableModuleGlobal);
+    mVariableModuleGlobal = NULL;
+  }
+}
+
+/**
+  Reclaim the store without interruption, and check that only its visible
+  variables are left.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+ReclaimCompactsTheStore (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN  Total;
+  UINTN  Kept;
+
+  UT_ASSERT_TRUE (CheckFlash (&Total, &Kept));
+  UT_ASSERT_TRUE (Kept < Total);
+
+  UT_ASSERT_TRUE (RunReclaim ());
+  UT_ASSERT_TRUE (mFtwWrites > 1);
+
+  UT_ASSERT_TRUE (CheckFlash (&Total, &Kept));
+  UT_ASSERT_EQUAL (Total, Kept);
+  UT_ASSERT_EQUAL (CompareMem (mNvVariableCache, mFlash, TEST_STORE_SIZE), 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Interrupt the reclaim of the store by a reset at each of its writes, and check
+  that the store is valid and holds the same variables after the reset, and
+  that the next reclaim compacts it.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+ReclaimSurvivesResetAtEachWrite (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN  Writes;
+  UINTN  ResetAt;
+  UINTN  Total;
+  UINTN  Kept;
+
+  UT_ASSERT_TRUE (RunReclaim ());
+  Writes = mFtwWrites;
+  UT_ASSERT_TRUE (Writes > 1);
+
+  for (ResetAt = 0; ResetAt < Writes; ResetAt++) {
+    CopyMem (mFlash, mExpected, TEST_STORE_SIZE);
+    Reset ();
+    mFtwWrites = 0;
+    mResetAt   = ResetAt;
+
+    UT_ASSERT_TRUE (RunReclaim ());
+    UT_ASSERT_TRUE (mReset);
+    Reset ();
+    UT_ASSERT_TRUE (CheckFlash (&Total, &Kept));
+
+    //
+    // The next reclaim starts over from the store left in the flash.
+    //
+    mFtwWrites = 0;
+    mResetAt   = MAX_UINTN;
+    UT_ASSERT_TRUE (RunReclaim ());
+    UT_ASSERT_TRUE (CheckFlash (&Total, &Kept));
+    UT_ASSERT_EQUAL (Total, Kept);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Main entry point to this unit test application.
+
+  Sets up and runs the test suites.
+**/
+VOID
+EFIAPI
+UnitTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      ReclaimTests;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  //
+  // Start setting up the test framework for running the tests.
+  //
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  //
+  // Add all test suites and tests.
+  //
+  Status = CreateUnitTestSuite (
+             &ReclaimTests,
+             Framework,
+             "Variable Incremental Reclaim Tests",
+             "Variable.IncrementalReclaim",
+             NULL,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for ReclaimTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (
+    ReclaimTests,
+    "The reclaim should leave only the visible variables",
+    "Compact",
+    ReclaimCompactsTheStore,
+    ReclaimSetup,
+    ReclaimCleanup,
+    NULL
+    );
+  AddTestCase (
+    ReclaimTests,
+    "A reset at any write of the reclaim should leave a valid store with the same variables",
+    "ResetAtEachWrite",
+    ReclaimSurvivesResetAtEachWrite,
+    ReclaimSetup,
+    ReclaimCleanup,
+    NULL
+    );
+
+  //
+  // Execute the tests.
+  //
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return;
+}
+
+///
+/// Avoid ECC error for function name that starts with lower case letter
+///
+#define Main  main
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+
+  @param[in] Argc  Number of arguments
+  @param[in] Argv  Array of pointers to arguments
+
+  @retval 0      Success
+  @retval other  Error
+**/
+INT32
+Main (
+  IN INT32  Argc,
+  IN CHAR8  *Argv[]
+  )
+{
+  UnitTestMain ();
+  return 0;
+}
@@ -0,0 +1,771 @@
+/** @file
+  This is a host-based unit test for the batches of SetVariable () calls.
+
+  The Fault Tolerant Write is simulated with a spare area of TEST_SPARE_SIZE
+  bytes, and SetVariable () with a simple append to the non-volatile variable
+  cache that goes through the batch like UpdateVariableStore () does.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <Uefi.h>
+#include <Library/DebugLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UnitTestLib.h>
+
+#include "../VariableBatch.h"
+#include "../VariableParsing.h"
+
+#define UNIT_TEST_NAME     "Variable Batch Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+#define TEST_STORE_SIZE  SIZE_64KB
+#define TEST_SPARE_SIZE  SIZE_4KB
+#define TEST_BATCH_SIZE  SIZE_64KB
+
+//
+// Name of the variable the fake SetVariable () refuses to set.
+//
+#define TEST_READ_ONLY_NAME  L"ReadOnly"
+
+//
+// Name of the variable whose fake SetVariable () reclaims the store first.
+//
+#define TEST_RECLAIM_NAME  L"Reclaim"
+
+/// === TEST DATA ==================================================================================
+
+//
+// Test GUID {6A1F3C2D-8E4B-4B7A-9D05-3E2C1B7F8A64}
+//
+EFI_GUID  mTestGuid = {
+  0x6a1f3c2d, 0x8e4b, 0x4b7a, { 0x9d, 0x05, 0x3e, 0x2c, 0x1b, 0x7f, 0x8a, 0x64 }
+};
+
+//
+// mVariableModuleGlobal - The module global of the variable driver
+// mNvVariableCache      - The non-volatile variable cache
+// mFlash                - The simulated non-volatile variable store in the flash
+// mFtwWrites            - Number of the Fault Tolerant Writes to the flash
+// mAtRuntime            - The value AtRuntime () returns
+//
+VARIABLE_MODULE_GLOBAL  *mVariableModuleGlobal = NULL;
+VARIABLE_STORE_HEADER   *mNvVariableCache      = NULL;
+VARIABLE_STORE_HEADER   *mFlash                = NULL;
+UINTN                   mFtwWrites;
+BOOLEAN                 mAtRuntime = FALSE;
+
+/// === STUBS ======================================================================================
+
+/**
+  Stub of the AtRuntime () of the variable driver.
+
+  @retval FALSE  The test runs before ExitBootServices ().
+**/
+BOOLEAN
+AtRuntime (
+  VOID
+  )
+{
+  return mAtRuntime;
+}
+
+/**
+  Stub of the index lookup, the test stores are not indexed.
+
+  @retval EFI_UNSUPPORTED  The store is walked instead.
+**/
+EFI_STATUS
+VariableIndexFind (
+  IN     CHAR16                  *VariableName,
+  IN     EFI_GUID                *VendorGuid,
+  IN     BOOLEAN                 IgnoreRtCheck,
+  IN OUT VARIABLE_POINTER_TRACK  *PtrTrack,
+  IN     BOOLEAN                 AuthFormat
+  )
+{
+  return EFI_UNSUPPORTED;
+}
+
+/**
+  Stub of the index invalidation, the test stores are not indexed.
+**/
+VOID
+VariableIndexInvalidate (
+  IN VARIABLE_STORE_HEADER  *Store OPTIONAL
+  )
+{
+}
+
+/**
+  Stub of the quota recalculation, the test has no quotas.
+**/
+VOID
+RecalculateNvVariableTotalSize (
+  VOID
+  )
+{
+}
+
+/**
+  Stub of the incremental reclaim, the test stores never run low on space.
+**/
+VOID
+ReclaimStep (
+  VOID
+  )
+{
+}
+
+/**
+  Stub of the record of the runtime cache updates, the test has no runtime cache.
+**/
+VOID
+RecordRuntimeVariableCacheUpdate (
+  IN  VARIABLE_RUNTIME_CACHE  *VariableRuntimeCache,
+  IN  UINTN                   Offset,
+  IN  UINTN                   Length
+  )
+{
+}
+
+/**
+  Stub of the record of the runtime cache rewrites, the test has no runtime cache.
+**/
+VOID
+RecordRuntimeVariableCacheRewrite (
+  IN  VARIABLE_RUNTIME_CACHE  *VariableRuntimeCache
+  )
+{
+}
+
+/**
+  Stub of the runtime cache synchronization, the test has no runtime cache.
+**/
+EFI_STATUS
+SynchronizeRuntimeVariableCache (
+  IN  VARIABLE_RUNTIME_CACHE  *VariableRuntimeCache,
+  IN  UINTN                   Offset,
+  IN  UINTN                   Length
+  )
+{
+  return EFI_SUCCESS;
+}
+
+/**
+  Fake Fault Tolerant Write of the non-volatile variable store, which cannot
+  write more than its spare area.
+
+  @param[in] Address  The address in the flash to write.
+  @param[in] Length   The length in bytes to write.
+  @param[in] Buffer   The data to write.
+
+  @retval EFI_SUCCESS          The data was written.
+  @retval EFI_BAD_BUFFER_SIZE  The write does not fit in the spare area.
+**/
+EFI_STATUS
+FtwVariableRange (
+  IN EFI_PHYSICAL_ADDRESS  Address,
+  IN UINTN                 Length,
+  IN VOID                  *Buffer
+  )
+{
+  if (Length > TEST_SPARE_SIZE) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  mFtwWrites++;
+  CopyMem ((VOID *)(UINTN)Address, Buffer, Length);
+  return EFI_SUCCESS;
+}
+
+/**
+  Write a range of the non-volatile variable cache to the flash, like
+  UpdateVariableStore () does.
+
+  @param[in] Offset  Offset of the range from the start of the store.
+  @param[in] Length  Length in bytes of the range.
+
+  @return The status of the write.
+**/
+STATIC
+EFI_STATUS
+WriteNvRange (
+  IN UINTN  Offset,
+  IN UINTN  Length
+  )
+{
+  if (mVariableModuleGlobal->BatchActive) {
+    VariableBatchRecordNvUpdate (Offset, Length);
+    return EFI_SUCCESS;
+  }
+
+  return FtwVariableRange (
+           mVariableModuleGlobal->VariableGlobal.NonVolatileVariableBase + Offset,
+           Length,
+           (UINT8 *)mNvVariableCache + Offset
+           );
+}
+
+/**
+  Fake SetVariable () that appends the variable to the non-volatile variable
+  cache, and deletes its previous copy.
+
+  @param[in] VariableName  Name of the variable.
+  @param[in] VendorGuid    GUID of the variable.
+  @param[in] Attributes    Attributes of the variable.
+  @param[in] DataSize      Size of the data.
+  @param[in] Data          The data.
+
+  @retval EFI_SUCCESS           The variable was set.
+  @retval EFI_WRITE_PROTECTED   The variable is TEST_READ_ONLY_NAME.
+  @retval EFI_OUT_OF_RESOURCES  The store is full.
+  @retval Others                The variable could not be written to the flash.
+**/
+EFI_STATUS
+EFIAPI
+VariableServiceSetVariable (
+  IN CHAR16    *VariableName,
+  IN EFI_GUID  *VendorGuid,
+  IN UINT32    Attributes,
+  IN UINTN     DataSize,
+  IN VOID      *Data
+  )
+{
+  EFI_STATUS              Status;
+  VARIABLE_POINTER_TRACK  Previous;
+  VARIABLE_HEADER         *Variable;
+  UINTN                   Offset;
+  UINTN                   NameSize;
+  UINTN                   VariableSize;
+
+  if (StrCmp (VariableName, TEST_READ_ONLY_NAME) == 0) {
+    return EFI_WRITE_PROTECTED;
+  }
+
+  if (StrCmp (VariableName, TEST_RECLAIM_NAME) == 0) {
+    //
+    // Reclaim () writes the updates of the batch to the flash first.
+    //
+    Status = FlushBatchNvWrites ();
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  Previous.StartPtr = GetStartPointer (mNvVariableCache);
+  Previous.EndPtr   = GetEndPointer (mNvVariableCache);
+  Status            = FindVariableEx (VariableName, VendorGuid, TRUE, &Previous, FALSE);
+  if (EFI_ERROR (Status)) {
+    Previous.CurrPtr = NULL;
+  }
+
+  Offset       = mVariableModuleGlobal->NonVolatileLastVariableOffset;
+  NameSize     = StrSize (VariableName);
+  VariableSize = HEADER_ALIGN (sizeof (VARIABLE_HEADER) + NameSize + GET_PAD_SIZE (NameSize) + DataSize);
+  if (Offset + VariableSize > mNvVariableCache->Size) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Variable             = (VARIABLE_HEADER *)((UINT8 *)mNvVariableCache + Offset);
+  Variable->StartId    = VARIABLE_DATA;
+  Variable->State      = VAR_ADDED;
+  Variable->Reserved   = 0;
+  Variable->Attributes = Attributes;
+  Variable->NameSize   = (UINT32)NameSize;
+  Variable->DataSize   = (UINT32)DataSize;
+  CopyGuid (&Variable->VendorGuid, VendorGuid);
+  CopyMem (GetVariableNamePtr (Variable, FALSE), VariableName, NameSize);
+  CopyMem (GetVariableDataPtr (Variable, FALSE), Data, DataSize);
+
+  Status = WriteNvRange (Offset, VariableSize);
+  if (EFI_ERROR (Status)) {
+    SetMem (Variable, VariableSize, 0xFF);
+    return Status;
+  }
+
+  mVariableModuleGlobal->NonVolatileLastVariableOffset = Offset + VariableSize;
+
+  if (Previous.CurrPtr != NULL) {
+    Previous.CurrPtr->State &= VAR_DELETED;
+    Status                   = WriteNvRange ((UINTN)&Previous.CurrPtr->State - (UINTN)mNvVariableCache, sizeof (UINT8));
+  }
+
+  return Status;
+}
+
+/// === HELPERS ====================================================================================
+
+/**
+  Make a variable store in a buffer.
+
+  @return The empty variable store, or NULL if there is not enough memory.
+**/
+STATIC
+VARIABLE_STORE_HEADER *
+CreateStore (
+  VOID
+  )
+{
+  VARIABLE_STORE_HEADER  *Store;
+
+  Store = AllocatePool (TEST_STORE_SIZE);
+  if (Store == NULL) {
+    return NULL;
+  }
+
+  SetMem (Store, TEST_STORE_SIZE, 0xFF);
+  CopyGuid (&Store->Signature, &gEfiVariableGuid);
+  Store->Size      = TEST_STORE_SIZE;
+  Store->Format    = VARIABLE_STORE_FORMATTED;
+  Store->State     = VARIABLE_STORE_HEALTHY;
+  Store->Reserved  = 0;
+  Store->Reserved1 = 0;
+  return Store;
+}
+
+/**
+  Append an entry to a SetVariable batch request.
+
+  @param[in, out] Batch     The SetVariable batch request.
+  @param[in, out] Offset    Offset of the entry in the request, updated to the
+                            offset of the next entry.
+  @param[in]      Name      The name of the variable.
+  @param[in]      DataSize  The size of the data of the variable.
+
+  @return The entry.
+**/
+STATIC
+SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY *
+AddBatchEntry (
+  IN OUT SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH  *Batch,
+  IN OUT UINTN                                        *Offset,
+  IN     CONST CHAR16                                 *Name,
+  IN     UINTN                                        DataSize
+  )
+{
+  SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY  *Entry;
+
+  Entry                      = (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY *)((UINT8 *)Batch + *Offset);
+  Entry->Status              = EFI_NOT_STARTED;
+  Entry->Variable.NameSize   = StrSize (Name);
+  Entry->Variable.DataSize   = DataSize;
+  Entry->Variable.Attributes = EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS;
+  CopyGuid (&Entry->Variable.Guid, &mTestGuid);
+  CopyMem (Entry->Variable.Name, Name, Entry->Variable.NameSize);
+  SetMem ((UINT8 *)Entry->Variable.Name + Entry->Variable.NameSize, DataSize, (UINT8)Batch->Count);
+
+  Batch->Count++;
+  *Offset = ALIGN_VALUE (
+              *Offset + OFFSET_OF (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY, Variable.Name)
+              + Entry->Variable.NameSize + DataSize,
+              sizeof (UINTN)
+              );
+  return Entry;
+}
+
+/**
+  Make the name of the test variable of a number, "Var" followed by 2
+  hexadecimal digits.
+
+  @param[out] Name    Buffer of 6 characters for the name.
+  @param[in]  Number  The number of the name.
+**/
+STATIC
+VOID
+MakeName (
+  OUT CHAR16  *Name,
+  IN  UINTN   Number
+  )
+{
+  Name[0] = L'V';
+  Name[1] = L'a';
+  Name[2] = L'r';
+  Name[3] = L"0123456789ABCDEF"[(Number >> 4) & 0xF];
+  Name[4] = L"0123456789ABCDEF"[Number & 0xF];
+  Name[5] = L'\0';
+}
+
+/**
+  Check that the flash holds what the non-volatile variable cache holds, and
+  count the variables of the flash.
+
+  @param[out] Added  Number of the variables of the flash in the VAR_ADDED state.
+  @param[out] Total  Number of the variables of the flash.
+
+  @retval TRUE   The flash holds what the cache holds.
+  @retval FALSE  The flash and the cache differ.
+**/
+STATIC
+BOOLEAN
+CheckFlash (
+  OUT UINTN  *Added,
+  OUT UINTN  *Total
+  )
+{
+  VARIABLE_HEADER  *Variable;
+
+  *Added = 0;
+  *Total = 0;
+
+  Variable = GetStartPointer (mFlash);
+  while (IsValidVariableHeader (Variable, GetEndPointer (mFlash))) {
+    if (Variable->State == VAR_ADDED) {
+      (*Added)++;
+    }
+
+    (*Total)++;
+    Variable = GetNextVariablePtr (Variable, FALSE);
+  }
+
+  if ((UINTN)Variable - (UINTN)mFlash != mVariableModuleGlobal->NonVolatileLastVariableOffset) {
+    return FALSE;
+  }
+
+  return (BOOLEAN)(CompareMem (mFlash, mNvVariableCache, TEST_STORE_SIZE) == 0);
+}
+
+/// === TEST CASES =================================================================================
+
+/**
+  Set up an empty non-volatile variable store, its cache and the module global.
+
+  @param[in]  Context  Unit test case context
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+BatchSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  mVariableModuleGlobal = AllocateZeroPool (sizeof (VARIABLE_MODULE_GLOBAL));
+  mFlash                = CreateStore ();
+  UT_ASSERT_NOT_NULL (mVariableModuleGlobal);
+  UT_ASSERT_NOT_NULL (mFlash);
+  mNvVariableCache = AllocateCopyPool (TEST_STORE_SIZE, mFlash);
+  UT_ASSERT_NOT_NULL (mNvVariableCache);
+
+  mVariableModuleGlobal->VariableGlobal.NonVolatileVariableBase = (EFI_PHYSICAL_ADDRESS)(UINTN)mFlash;
+  mVariableModuleGlobal->NonVolatileLastVariableOffset          = (UINTN)GetStartPointer (mNvVariableCache) - (UINTN)mNvVariableCache;
+
+  mFtwWrites = 0;
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Free the stores of a test.
+
+  @param[in]  Context  Unit test case context
+**/
+STATIC
+VOID
+EFIAPI
+BatchCleanup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  if (mNvVariableCache != NULL) {
+    FreePool (mNvVariableCache);
+    mNvVariableCache = NULL;
+  }
+
+  if (mFlash != NULL) {
+    FreePool (mFlash);
+    mFlash = NULL;
+  }
+
+  if (mVariableModuleGlobal != NULL) {
+    FreePool (mVariableModuleGlobal);
+    mVariableModuleGlobal = NULL;
+  }
+}
+
+/**
+  Set a batch that fits in the spare area, and check it is written to the flash
+  with a single Fault Tolerant Write.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+SmallBatchIsWrittenAtOnce (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH        *Batch;
+  SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY  *Entry[4];
+  CHAR16                                             Name[6];
+  UINTN                                              Offset;
+  UINTN                                              Index;
+  UINTN                                              Added;
+  UINTN                                              Total;
+  EFI_STATUS                                         Status;
+
+  Batch = AllocateZeroPool (TEST_BATCH_SIZE);
+  UT_ASSERT_NOT_NULL (Batch);
+
+  Offset = sizeof (*Batch);
+  for (Index = 0; Index < ARRAY_SIZE (Entry); Index++) {
+    MakeName (Name, Index);
+    Entry[Index] = AddBatchEntry (Batch, &Offset, Name, 64);
+  }
+
+  //
+  // Setting the first variable again deletes its first copy.
+  //
+  MakeName (Name, 0);
+  AddBatchEntry (Batch, &Offset, Name, 64);
+
+  Status = VariableSetVariableBatch (Batch);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  for (Index = 0; Index < ARRAY_SIZE (Entry); Index++) {
+    UT_ASSERT_NOT_EFI_ERROR (Entry[Index]->Status);
+  }
+
+  UT_ASSERT_EQUAL (mFtwWrites, 1);
+  UT_ASSERT_EQUAL (mVariableModuleGlobal->BatchNvFlushes, 1);
+  UT_ASSERT_FALSE (mVariableModuleGlobal->BatchActive);
+  UT_ASSERT_TRUE (CheckFlash (&Added, &Total));
+  UT_ASSERT_EQUAL (Added, ARRAY_SIZE (Entry));
+  UT_ASSERT_EQUAL (Total, ARRAY_SIZE (Entry) + 1);
+
+  FreePool (Batch);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Set a batch larger than the spare area, and check that its variables are
+  written to the flash one by one, with the real status of each.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+BatchLargerThanSpareAreaIsSetOneByOne (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH        *Batch;
+  SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY  *Entry[16];
+  SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY  *ReadOnly;
+  CHAR16                                             Name[6];
+  UINTN                                              Offset;
+  UINTN                                              Index;
+  UINTN                                              Added;
+  UINTN                                              Total;
+  EFI_STATUS                                         Status;
+
+  Batch = AllocateZeroPool (TEST_BATCH_SIZE);
+  UT_ASSERT_NOT_NULL (Batch);
+
+  Offset   = sizeof (*Batch);
+  ReadOnly = NULL;
+  for (Index = 0; Index < ARRAY_SIZE (Entry); Index++) {
+    if (Index == ARRAY_SIZE (Entry) / 2) {
+      ReadOnly = AddBatchEntry (Batch, &Offset, TEST_READ_ONLY_NAME, 16);
+    }
+
+    MakeName (Name, Index);
+    Entry[Index] = AddBatchEntry (Batch, &Offset, Name, 512);
+  }
+
+  Status = VariableSetVariableBatch (Batch);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  UT_ASSERT_STATUS_EQUAL (ReadOnly->Status, EFI_WRITE_PROTECTED);
+  for (Index = 0; Index < ARRAY_SIZE (Entry); Index++) {
+    UT_ASSERT_NOT_EFI_ERROR (Entry[Index]->Status);
+  }
+
+  UT_ASSERT_EQUAL (mFtwWrites, ARRAY_SIZE (Entry));
+  UT_ASSERT_FALSE (mVariableModuleGlobal->BatchActive);
+  UT_ASSERT_TRUE (CheckFlash (&Added, &Total));
+  UT_ASSERT_EQUAL (Added, ARRAY_SIZE (Entry));
+  UT_ASSERT_EQUAL (Total, ARRAY_SIZE (Entry));
+
+  FreePool (Batch);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Set a batch whose first variables are written to the flash by a reclaim, and
+  whose other variables do not fit in the spare area. Check that only the
+  variables that were not written to the flash are set again.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+VariablesWrittenByReclaimAreNotSetAgain (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH        *Batch;
+  SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY  *Entry;
+  CHAR16                                             Name[6];
+  UINTN                                              Offset;
+  UINTN                                              Index;
+  UINTN                                              Added;
+  UINTN                                              Total;
+  EFI_STATUS                                         Status;
+
+  Batch = AllocateZeroPool (TEST_BATCH_SIZE);
+  UT_ASSERT_NOT_NULL (Batch);
+
+  Offset = sizeof (*Batch);
+  for (Index = 0; Index < 4; Index++) {
+    MakeName (Name, Index);
+    AddBatchEntry (Batch, &Offset, Name, 64);
+  }
+
+  AddBatchEntry (Batch, &Offset, TEST_RECLAIM_NAME, 64);
+  for (Index = 4; Index < 16; Index++) {
+    MakeName (Name, Index);
+    AddBatchEntry (Batch, &Offset, Name, 512);
+  }
+
+  Status = VariableSetVariableBatch (Batch);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Entry = (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY *)(Batch + 1);
+  for (Index = 0; Index < Batch->Count; Index++) {
+    UT_ASSERT_NOT_EFI_ERROR (Entry->Status);
+    Entry = (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY *)ALIGN_VALUE (
+                                                                   (UINTN)Entry->Variable.Name + Entry->Variable.NameSize + Entry->Variable.DataSize,
+                                                                   sizeof (UINTN)
+                                                                   );
+  }
+
+  //
+  // One write for the variables before the reclaim, then one per variable from
+  // the one that reclaimed.
+  //
+  UT_ASSERT_EQUAL (mFtwWrites, 1 + Batch->Count - 4);
+  UT_ASSERT_TRUE (CheckFlash (&Added, &Total));
+  UT_ASSERT_EQUAL (Added, Batch->Count);
+  UT_ASSERT_EQUAL (Total, Batch->Count);
+
+  FreePool (Batch);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Main entry point to this unit test application.
+
+  Sets up and runs the test suites.
+**/
+VOID
+EFIAPI
+UnitTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      BatchTests;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  //
+  // Start setting up the test framework for running the tests.
+  //
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  //
+  // Add all test suites and tests.
+  //
+  Status = CreateUnitTestSuite (
+             &BatchTests,
+             Framework,
+             "Variable Batch Tests",
+             "Variable.Batch",
+             NULL,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for BatchTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (
+    BatchTests,
+    "A batch that fits in the spare area should be written at once",
+    "SmallBatch",
+    SmallBatchIsWrittenAtOnce,
+    BatchSetup,
+    BatchCleanup,
+    NULL
+    );
+  AddTestCase (
+    BatchTests,
+    "A batch larger than the spare area should be set one variable at a time",
+    "LargeBatch",
+    BatchLargerThanSpareAreaIsSetOneByOne,
+    BatchSetup,
+    BatchCleanup,
+    NULL
+    );
+  AddTestCase (
+    BatchTests,
+    "The variables a reclaim wrote to the flash should not be set again",
+    "ReclaimedBatch",
+    VariablesWrittenByReclaimAreNotSetAgain,
+    BatchSetup,
+    BatchCleanup,
+    NULL
+    );
+
+  //
+  // Execute the tests.
+  //
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return;
+}
+
+///
+/// Avoid ECC error for function name that starts with lower case letter
+///
+#define Main  main
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+
+  @param[in] Argc  Number of arguments
+  @param[in] Argv  Array of pointers to arguments
+
+  @retval 0      Success
+  @retval other  Error
+**/
+INT32
+Main (
+  IN INT32  Argc,
+  IN CHAR8  *Argv[]
+  )
+{
+  UnitTestMain ();
+  return 0;
+}
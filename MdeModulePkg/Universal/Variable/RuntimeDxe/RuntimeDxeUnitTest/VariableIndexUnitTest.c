@@ -0,0 +1,849 @@
+/** @file
+  This is a host-based unit test for the hashed variable store index.
+
+  Every lookup through the index is checked against the walk of an identical
+  copy of the variable store that is not indexed.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <Uefi.h>
+#include <Library/DebugLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UnitTestLib.h>
+
+#include "../VariableParsing.h"
+#include "../VariableIndex.h"
+
+#define UNIT_TEST_NAME     "Variable Store Index Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+#define TEST_STORE_SIZE  SIZE_64KB
+
+//
+// Number of distinct names the randomly generated stores pick from.
+//
+#define TEST_NAME_COUNT  64
+
+/// === TEST DATA ==================================================================================
+
+//
+// Test GUID 1 {8C0D3A1E-5B4F-4F43-9C52-0B1C6F3A9E21}
+//
+EFI_GUID  mTestGuid1 = {
+  0x8c0d3a1e, 0x5b4f, 0x4f43, { 0x9c, 0x52, 0x0b, 0x1c, 0x6f, 0x3a, 0x9e, 0x21 }
+};
+
+//
+// Test GUID 2 {2F6E7D90-3C1A-4E8B-A5D4-6B0E9F17C3A8}
+//
+EFI_GUID  mTestGuid2 = {
+  0x2f6e7d90, 0x3c1a, 0x4e8b, { 0xa5, 0xd4, 0x6b, 0x0e, 0x9f, 0x17, 0xc3, 0xa8 }
+};
+
+//
+// mIndexedStore - The variable store looked up through the index
+// mLinearStore  - The copy of mIndexedStore looked up by the walk of the store
+// mAtRuntime    - The value AtRuntime () returns
+// mRandomSeed   - State of the generator of the random stores
+//
+VARIABLE_STORE_HEADER  *mIndexedStore = NULL;
+VARIABLE_STORE_HEADER  *mLinearStore  = NULL;
+BOOLEAN                mAtRuntime     = FALSE;
+UINT32                 mRandomSeed;
+
+/// === STUBS ======================================================================================
+
+/**
+  Stub of the AtRuntime () of the variable driver.
+
+  @retval TRUE  The test simulates a lookup after ExitBootServices ().
+**/
+BOOLEAN
+AtRuntime (
+  VOID
+  )
+{
+  return mAtRuntime;
+}
+
+/// === HELPERS ====================================================================================
+
+/**
+  Get the next number of the generator of the random stores.
+
+  @return A pseudo random number.
+**/
+STATIC
+UINT32
+NextRandom (
+  VOID
+  )
+{
+  mRandomSeed = mRandomSeed * 1103515245 + 12345;
+  return mRandomSeed >> 16;
+}
+
+/**
+  Make the test variable name of a number, "Var" followed by 4 hexadecimal digits.
+
+  @param[out] Name    Buffer of 8 characters for the name.
+  @param[in]  Number  The number of the name.
+**/
+STATIC
+VOID
+MakeName (
+  OUT CHAR16  *Name,
+  IN  UINTN   Number
+  )
+{
+  UINTN  Index;
+
+  Name[0] = L'V';
+  Name[1] = L'a';
+  Name[2] = L'r';
+  for (Index = 0; Index < 4; Index++) {
+    Name[3 + Index] = L"0123456789ABCDEF"[(Number >> (12 - 4 * Index)) & 0xF];
+  }
+
+  Name[7] = L'\0';
+}
+
+/**
+  Append a variable to the indexed store.
+
+  @param[in] Name        The name of the variable.
+  @param[in] NameSize    The size in bytes of the name to store.
+  @param[in] Guid        The GUID of the variable.
+  @param[in] Attributes  The attributes of the variable.
+  @param[in] State       The state of the variable.
+
+  @return The header of the variable, or NULL if the store is full.
+**/
+STATIC
+VARIABLE_HEADER *
+AppendVariable (
+  IN CONST CHAR16    *Name,
+  IN UINTN           NameSize,
+  IN CONST EFI_GUID  *Guid,
+  IN UINT32          Attributes,
+  IN UINT8           State
+  )
+{
+  VARIABLE_HEADER  *Variable;
+  UINT32           DataSize;
+
+  Variable = GetStartPointer (mIndexedStore);
+  while (IsValidVariableHeader (Variable, GetEndPointer (mIndexedStore))) {
+    Variable = GetNextVariablePtr (Variable, FALSE);
+  }
+
+  DataSize = NextRandom () % 32 + 1;
+  if ((UINTN)GetEndPointer (mIndexedStore) - (UINTN)Variable < sizeof (VARIABLE_HEADER) + NameSize + DataSize + 2 * HEADER_ALIGNMENT) {
+    return NULL;
+  }
+
+  Variable->StartId    = VARIABLE_DATA;
+  Variable->State      = State;
+  Variable->Reserved   = 0;
+  Variable->Attributes = Attributes;
+  Variable->NameSize   = (UINT32)NameSize;
+  Variable->DataSize   = DataSize;
+  CopyGuid (&Variable->VendorGuid, Guid);
+  CopyMem (GetVariableNamePtr (Variable, FALSE), Name, NameSize);
+  SetMem (GetVariableDataPtr (Variable, FALSE), DataSize, 0x5A);
+
+  return Variable;
+}
+
+/**
+  Append a randomly chosen variable in a random state to the indexed store.
+
+  @return The header of the variable, or NULL if the store is full.
+**/
+STATIC
+VARIABLE_HEADER *
+AppendRandomVariable (
+  VOID
+  )
+{
+  CHAR16  Name[8];
+  UINT8   State;
+  UINT32  Attributes;
+
+  MakeName (Name, NextRandom () % TEST_NAME_COUNT);
+
+  switch (NextRandom () % 4) {
+    case 0:
+      State = VAR_ADDED;
+      break;
+    case 1:
+      State = VAR_ADDED & VAR_IN_DELETED_TRANSITION;
+      break;
+    case 2:
+      State = VAR_ADDED & VAR_DELETED;
+      break;
+    default:
+      State = VAR_HEADER_VALID_ONLY;
+      break;
+  }
+
+  Attributes = EFI_VARIABLE_BOOTSERVICE_ACCESS;
+  if ((NextRandom () % 2) == 0) {
+    Attributes |= EFI_VARIABLE_RUNTIME_ACCESS;
+  }
+
+  return AppendVariable (
+           Name,
+           sizeof (Name),
+           ((NextRandom () % 2) == 0) ? &mTestGuid1 : &mTestGuid2,
+           Attributes,
+           State
+           );
+}
+
+/**
+  Get the offset of a variable in a store.
+
+  @return The offset of Variable from Store, or MAX_UINTN if Variable is NULL.
+**/
+STATIC
+UINTN
+VariableOffset (
+  IN VARIABLE_STORE_HEADER  *Store,
+  IN VARIABLE_HEADER        *Variable
+  )
+{
+  return (Variable == NULL) ? MAX_UINTN : (UINTN)Variable - (UINTN)Store;
+}
+
+/**
+  Look a variable up through the index and by the walk of the store, and check
+  that both find the same variables.
+
+  @param[in] Name           The name of the variable.
+  @param[in] Guid           The GUID of the variable.
+  @param[in] IgnoreRtCheck  Ignore the EFI_VARIABLE_RUNTIME_ACCESS check at runtime.
+
+  @retval UNIT_TEST_PASSED  Both lookups found the same variables.
+**/
+STATIC
+UNIT_TEST_STATUS
+CheckLookup (
+  IN CHAR16    *Name,
+  IN EFI_GUID  *Guid,
+  IN BOOLEAN   IgnoreRtCheck
+  )
+{
+  VARIABLE_POINTER_TRACK  Indexed;
+  VARIABLE_POINTER_TRACK  Linear;
+  EFI_STATUS              IndexedStatus;
+  EFI_STATUS              LinearStatus;
+
+  CopyMem (mLinearStore, mIndexedStore, TEST_STORE_SIZE);
+
+  ZeroMem (&Linear, sizeof (Linear));
+  Linear.StartPtr = GetStartPointer (mLinearStore);
+  Linear.EndPtr   = GetEndPointer (mLinearStore);
+  LinearStatus    = FindVariableEx (Name, Guid, IgnoreRtCheck, &Linear, FALSE);
+
+  ZeroMem (&Indexed, sizeof (Indexed));
+  Indexed.StartPtr = GetStartPointer (mIndexedStore);
+  Indexed.EndPtr   = GetEndPointer (mIndexedStore);
+  IndexedStatus    = VariableIndexFind (Name, Guid, IgnoreRtCheck, &Indexed, FALSE);
+
+  UT_ASSERT_NOT_EQUAL (IndexedStatus, EFI_UNSUPPORTED);
+  UT_ASSERT_STATUS_EQUAL (IndexedStatus, LinearStatus);
+  UT_ASSERT_EQUAL (VariableOffset (mIndexedStore, Indexed.CurrPtr), VariableOffset (mLinearStore, Linear.CurrPtr));
+  UT_ASSERT_EQUAL (
+    VariableOffset (mIndexedStore, Indexed.InDeletedTransitionPtr),
+    VariableOffset (mLinearStore, Linear.InDeletedTransitionPtr)
+    );
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Look every test variable name up, and a few names that are not in the store,
+  with both GUIDs, before and after ExitBootServices ().
+
+  @retval UNIT_TEST_PASSED  All lookups through the index matched the walk of the store.
+**/
+STATIC
+UNIT_TEST_STATUS
+CheckAllLookups (
+  VOID
+  )
+{
+  CHAR16            Name[8];
+  UINTN             Number;
+  UINTN             Pass;
+  UNIT_TEST_STATUS  Status;
+
+  for (Pass = 0; Pass < 3; Pass++) {
+    mAtRuntime = (BOOLEAN)(Pass != 0);
+    for (Number = 0; Number < TEST_NAME_COUNT + 4; Number++) {
+      MakeName (Name, Number);
+      Status = CheckLookup (Name, &mTestGuid1, (BOOLEAN)(Pass == 2));
+      if (Status == UNIT_TEST_PASSED) {
+        Status = CheckLookup (Name, &mTestGuid2, (BOOLEAN)(Pass == 2));
+      }
+
+      if (Status != UNIT_TEST_PASSED) {
+        mAtRuntime = FALSE;
+        return Status;
+      }
+    }
+  }
+
+  mAtRuntime = FALSE;
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Build the index the PEI variable driver builds of the indexed store.
+
+  @param[in]  Capacity  The number of variables the index can hold.
+  @param[out] Size      The size in bytes of the index.
+
+  @return The PEI variable index, or NULL if it cannot be allocated.
+**/
+STATIC
+EDKII_PEI_VARIABLE_INDEX *
+BuildPeiIndex (
+  IN  UINTN  Capacity,
+  OUT UINTN  *Size
+  )
+{
+  EDKII_PEI_VARIABLE_INDEX  *PeiIndex;
+  VARIABLE_HEADER           *Variable;
+  CONST UINT8               *Byte;
+  UINTN                     Index;
+  UINT32                    Hash;
+
+  *Size    = OFFSET_OF (EDKII_PEI_VARIABLE_INDEX, Entry) + Capacity * sizeof (PEI_VARIABLE_INDEX_ENTRY);
+  PeiIndex = AllocateZeroPool (*Size);
+  if (PeiIndex == NULL) {
+    return NULL;
+  }
+
+  PeiIndex->StoreBase     = (EFI_PHYSICAL_ADDRESS)(UINTN)mIndexedStore;
+  PeiIndex->StoreSize     = mIndexedStore->Size;
+  PeiIndex->EntryCapacity = (UINT32)Capacity;
+
+  for ( Variable = GetStartPointer (mIndexedStore)
+        ; IsValidVariableHeader (Variable, GetEndPointer (mIndexedStore)) && (PeiIndex->EntryCount < Capacity)
+        ; Variable = GetNextVariablePtr (Variable, FALSE)
+        )
+  {
+    Hash = 0x811C9DC5;
+    Byte = (CONST UINT8 *)&Variable->VendorGuid;
+    for (Index = 0; Index < sizeof (EFI_GUID); Index++) {
+      Hash = (Hash ^ Byte[Index]) * 0x01000193;
+    }
+
+    Byte = (CONST UINT8 *)GetVariableNamePtr (Variable, FALSE);
+    for (Index = 0; Index < Variable->NameSize - sizeof (CHAR16); Index++) {
+      Hash = (Hash ^ Byte[Index]) * 0x01000193;
+    }
+
+    PeiIndex->Entry[PeiIndex->EntryCount].Offset = (UINT32)((UINTN)Variable - (UINTN)GetStartPointer (mIndexedStore));
+    PeiIndex->Entry[PeiIndex->EntryCount].Hash   = Hash;
+    PeiIndex->EntryCount++;
+    PeiIndex->IndexedEnd = (UINT32)((UINTN)GetNextVariablePtr (Variable, FALSE) - (UINTN)GetStartPointer (mIndexedStore));
+  }
+
+  return PeiIndex;
+}
+
+/**
+  Create an empty indexed store and the store it is checked against.
+
+  @param[in]  Context  Unit test case context
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+StoreSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  mIndexedStore = AllocatePool (TEST_STORE_SIZE);
+  mLinearStore  = AllocatePool (TEST_STORE_SIZE);
+  UT_ASSERT_NOT_NULL (mIndexedStore);
+  UT_ASSERT_NOT_NULL (mLinearStore);
+
+  SetMem (mIndexedStore, TEST_STORE_SIZE, 0xFF);
+  CopyGuid (&mIndexedStore->Signature, &gEfiVariableGuid);
+  mIndexedStore->Size      = TEST_STORE_SIZE;
+  mIndexedStore->Format    = VARIABLE_STORE_FORMATTED;
+  mIndexedStore->State     = VARIABLE_STORE_HEALTHY;
+  mIndexedStore->Reserved  = 0;
+  mIndexedStore->Reserved1 = 0;
+
+  UT_ASSERT_NOT_EFI_ERROR (VariableIndexRegister (mIndexedStore, FALSE));
+
+  mRandomSeed = 0x5EED;
+  mAtRuntime  = FALSE;
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Free the stores of a test.
+
+  @param[in]  Context  Unit test case context
+**/
+STATIC
+VOID
+EFIAPI
+StoreCleanup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  mAtRuntime = FALSE;
+  if (mIndexedStore != NULL) {
+    VariableIndexUnregister (mIndexedStore);
+    FreePool (mIndexedStore);
+    mIndexedStore = NULL;
+  }
+
+  if (mLinearStore != NULL) {
+    FreePool (mLinearStore);
+    mLinearStore = NULL;
+  }
+}
+
+/// ===== INDEX SUITE ==========================================================
+
+/**
+  Test Case that looks variables up in a store holding many versions of each
+  variable in all states.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+LookupsMatchTheWalkOfTheStore (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN  Count;
+
+  for (Count = 0; Count < 600; Count++) {
+    UT_ASSERT_NOT_NULL (AppendRandomVariable ());
+  }
+
+  return CheckAllLookups ();
+}
+
+/**
+  Test Case that appends variables and changes their states between lookups,
+  like SetVariable () does.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+IndexFollowsAppendsAndStateChanges (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  VARIABLE_HEADER   *Variable[8];
+  UINTN             Round;
+  UINTN             Index;
+  UNIT_TEST_STATUS  Status;
+
+  Status = CheckAllLookups ();
+  UT_ASSERT_EQUAL (Status, UNIT_TEST_PASSED);
+
+  for (Round = 0; Round < 40; Round++) {
+    for (Index = 0; Index < ARRAY_SIZE (Variable); Index++) {
+      Variable[Index] = AppendRandomVariable ();
+      UT_ASSERT_NOT_NULL (Variable[Index]);
+    }
+
+    Status = CheckAllLookups ();
+    UT_ASSERT_EQUAL (Status, UNIT_TEST_PASSED);
+
+    //
+    // Move the new variables through their states the way UpdateVariable () does.
+    //
+    for (Index = 0; Index < ARRAY_SIZE (Variable); Index++) {
+      if (Variable[Index]->State == VAR_HEADER_VALID_ONLY) {
+        Variable[Index]->State &= VAR_ADDED;
+      } else if (Variable[Index]->State == VAR_ADDED) {
+        Variable[Index]->State &= VAR_IN_DELETED_TRANSITION;
+      } else {
+        Variable[Index]->State &= VAR_DELETED;
+      }
+    }
+
+    Status = CheckAllLookups ();
+    UT_ASSERT_EQUAL (Status, UNIT_TEST_PASSED);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Test Case that rewrites the store with only its visible variables, like
+  Reclaim () does, and invalidates the index.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+IndexIsRebuiltAfterReclaim (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  VARIABLE_HEADER   *Variable;
+  VARIABLE_HEADER   *NextVariable;
+  UINT8             *Buffer;
+  UINT8             *Current;
+  UINTN             Count;
+  UNIT_TEST_STATUS  Status;
+
+  for (Count = 0; Count < 400; Count++) {
+    UT_ASSERT_NOT_NULL (AppendRandomVariable ());
+  }
+
+  Status = CheckAllLookups ();
+  UT_ASSERT_EQUAL (Status, UNIT_TEST_PASSED);
+
+  Buffer = AllocatePool (TEST_STORE_SIZE);
+  UT_ASSERT_NOT_NULL (Buffer);
+  SetMem (Buffer, TEST_STORE_SIZE, 0xFF);
+  CopyMem (Buffer, mIndexedStore, sizeof (VARIABLE_STORE_HEADER));
+
+  Current = (UINT8 *)GetStartPointer ((VARIABLE_STORE_HEADER *)Buffer);
+  for ( Variable = GetStartPointer (mIndexedStore)
+        ; IsValidVariableHeader (Variable, GetEndPointer (mIndexedStore))
+        ; Variable = NextVariable
+        )
+  {
+    NextVariable = GetNextVariablePtr (Variable, FALSE);
+    if ((Variable->State == VAR_ADDED) || (Variable->State == (VAR_ADDED & VAR_IN_DELETED_TRANSITION))) {
+      CopyMem (Current, Variable, (UINTN)NextVariable - (UINTN)Variable);
+      ((VARIABLE_HEADER *)Current)->State = VAR_ADDED;
+      Current                            += (UINTN)NextVariable - (UINTN)Variable;
+    }
+  }
+
+  CopyMem (mIndexedStore, Buffer, TEST_STORE_SIZE);
+  FreePool (Buffer);
+  VariableIndexInvalidate (mIndexedStore);
+
+  Status = CheckAllLookups ();
+  UT_ASSERT_EQUAL (Status, UNIT_TEST_PASSED);
+
+  for (Count = 0; Count < 100; Count++) {
+    UT_ASSERT_NOT_NULL (AppendRandomVariable ());
+  }
+
+  return CheckAllLookups ();
+}
+
+/**
+  Test Case that stores a visible variable whose name holds a null character
+  before its end. The walk of the store may select it for a name of another
+  hash, so the lookups must fall back to the walk of the store.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+UnhashableNameFallsBackToTheWalk (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  CHAR16                  Name[8] = { L'A', L'\0', L'B', L'\0' };
+  VARIABLE_POINTER_TRACK  Indexed;
+  VARIABLE_POINTER_TRACK  Linear;
+  EFI_STATUS              Status;
+  UINTN                   Count;
+
+  for (Count = 0; Count < 50; Count++) {
+    UT_ASSERT_NOT_NULL (AppendRandomVariable ());
+  }
+
+  UT_ASSERT_NOT_NULL (AppendVariable (Name, 4 * sizeof (CHAR16), &mTestGuid1, EFI_VARIABLE_BOOTSERVICE_ACCESS, VAR_ADDED));
+  CopyMem (mLinearStore, mIndexedStore, TEST_STORE_SIZE);
+
+  ZeroMem (&Indexed, sizeof (Indexed));
+  Indexed.StartPtr = GetStartPointer (mIndexedStore);
+  Indexed.EndPtr   = GetEndPointer (mIndexedStore);
+  Status           = VariableIndexFind (Name, &mTestGuid1, FALSE, &Indexed, FALSE);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_UNSUPPORTED);
+
+  //
+  // FindVariableEx () walks the indexed store and finds what the walk of the copy finds.
+  //
+  Status = FindVariableEx (Name, &mTestGuid1, FALSE, &Indexed, FALSE);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  ZeroMem (&Linear, sizeof (Linear));
+  Linear.StartPtr = GetStartPointer (mLinearStore);
+  Linear.EndPtr   = GetEndPointer (mLinearStore);
+  Status          = FindVariableEx (Name, &mTestGuid1, FALSE, &Linear, FALSE);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (VariableOffset (mIndexedStore, Indexed.CurrPtr), VariableOffset (mLinearStore, Linear.CurrPtr));
+
+  //
+  // The index is usable again once the store has been rewritten without the variable.
+  //
+  Indexed.CurrPtr->StartId = 0xFFFF;
+  Indexed.CurrPtr->State   = 0xFF;
+  VariableIndexInvalidate (mIndexedStore);
+
+  return CheckAllLookups ();
+}
+
+/**
+  Test Case that looks variables up while the name of the last variable has
+  not been written yet. The index must not hash the incomplete name, and must
+  pick the variable up once it is complete.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+IncompleteVariableIsIndexedOnceWritten (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  CHAR16                  Name[8];
+  VARIABLE_HEADER         *Variable;
+  VARIABLE_POINTER_TRACK  Indexed;
+  UINTN                   Count;
+  UNIT_TEST_STATUS        Status;
+
+  for (Count = 0; Count < 50; Count++) {
+    UT_ASSERT_NOT_NULL (AppendRandomVariable ());
+  }
+
+  MakeName (Name, 3);
+  Variable = AppendVariable (Name, sizeof (Name), &mTestGuid1, EFI_VARIABLE_BOOTSERVICE_ACCESS, VAR_HEADER_VALID_ONLY);
+  UT_ASSERT_NOT_NULL (Variable);
+  SetMem (GetVariableNamePtr (Variable, FALSE), sizeof (Name), 0xFF);
+
+  ZeroMem (&Indexed, sizeof (Indexed));
+  Indexed.StartPtr = GetStartPointer (mIndexedStore);
+  Indexed.EndPtr   = GetEndPointer (mIndexedStore);
+  UT_ASSERT_STATUS_EQUAL (VariableIndexFind (Name, &mTestGuid1, FALSE, &Indexed, FALSE), EFI_UNSUPPORTED);
+
+  CopyMem (GetVariableNamePtr (Variable, FALSE), Name, sizeof (Name));
+  Variable->State &= VAR_ADDED;
+
+  Status = CheckAllLookups ();
+  UT_ASSERT_EQUAL (Status, UNIT_TEST_PASSED);
+
+  ZeroMem (&Indexed, sizeof (Indexed));
+  Indexed.StartPtr = GetStartPointer (mIndexedStore);
+  Indexed.EndPtr   = GetEndPointer (mIndexedStore);
+  UT_ASSERT_NOT_EFI_ERROR (VariableIndexFind (Name, &mTestGuid1, FALSE, &Indexed, FALSE));
+  UT_ASSERT_EQUAL ((UINTN)Indexed.CurrPtr, (UINTN)Variable);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Test Case that fills the index from the index the PEI variable driver built
+  of the store, and checks that an index of another store is rejected.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+PeiIndexIsImported (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EDKII_PEI_VARIABLE_INDEX  *PeiIndex;
+  UINTN                     PeiIndexSize;
+  UINTN                     Count;
+  EFI_STATUS                Status;
+  UNIT_TEST_STATUS          TestStatus;
+
+  for (Count = 0; Count < 300; Count++) {
+    UT_ASSERT_NOT_NULL (AppendRandomVariable ());
+  }
+
+  //
+  // The PEI variable index only holds the first variables of the store, the
+  // others are picked up by the next lookup.
+  //
+  PeiIndex = BuildPeiIndex (100, &PeiIndexSize);
+  UT_ASSERT_NOT_NULL (PeiIndex);
+
+  PeiIndex->StoreBase++;
+  Status = VariableIndexImportPeiIndex (mIndexedStore, (EFI_PHYSICAL_ADDRESS)(UINTN)mIndexedStore, PeiIndex, PeiIndexSize);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+  PeiIndex->StoreBase--;
+
+  PeiIndex->Entry[50].Offset += HEADER_ALIGNMENT;
+  Status                      = VariableIndexImportPeiIndex (mIndexedStore, (EFI_PHYSICAL_ADDRESS)(UINTN)mIndexedStore, PeiIndex, PeiIndexSize);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+  PeiIndex->Entry[50].Offset -= HEADER_ALIGNMENT;
+
+  Status = VariableIndexImportPeiIndex (mIndexedStore, (EFI_PHYSICAL_ADDRESS)(UINTN)mIndexedStore, PeiIndex, PeiIndexSize);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  TestStatus = CheckAllLookups ();
+  UT_ASSERT_EQUAL (TestStatus, UNIT_TEST_PASSED);
+
+  //
+  // Only an empty index is filled from the PEI variable index.
+  //
+  Status = VariableIndexImportPeiIndex (mIndexedStore, (EFI_PHYSICAL_ADDRESS)(UINTN)mIndexedStore, PeiIndex, PeiIndexSize);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_UNSUPPORTED);
+
+  FreePool (PeiIndex);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Main entry point to this unit test application.
+
+  Sets up and runs the test suites.
+**/
+VOID
+EFIAPI
+UnitTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      IndexTests;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  //
+  // Start setting up the test framework for running the tests.
+  //
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  //
+  // Add all test suites and tests.
+  //
+  Status = CreateUnitTestSuite (
+             &IndexTests,
+             Framework,
+             "Variable Store Index Tests",
+             "Variable.Index",
+             NULL,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for IndexTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (
+    IndexTests,
+    "Lookups through the index should find what the walk of the store finds",
+    "MatchesWalk",
+    LookupsMatchTheWalkOfTheStore,
+    StoreSetup,
+    StoreCleanup,
+    NULL
+    );
+  AddTestCase (
+    IndexTests,
+    "The index should follow appended variables and state changes",
+    "AppendsAndStates",
+    IndexFollowsAppendsAndStateChanges,
+    StoreSetup,
+    StoreCleanup,
+    NULL
+    );
+  AddTestCase (
+    IndexTests,
+    "The index should be rebuilt after the store is reclaimed",
+    "Reclaim",
+    IndexIsRebuiltAfterReclaim,
+    StoreSetup,
+    StoreCleanup,
+    NULL
+    );
+  AddTestCase (
+    IndexTests,
+    "A visible variable with an unhashable name should make lookups walk the store",
+    "UnhashableName",
+    UnhashableNameFallsBackToTheWalk,
+    StoreSetup,
+    StoreCleanup,
+    NULL
+    );
+  AddTestCase (
+    IndexTests,
+    "A variable whose name is being written should be indexed once it is complete",
+    "IncompleteVariable",
+    IncompleteVariableIsIndexedOnceWritten,
+    StoreSetup,
+    StoreCleanup,
+    NULL
+    );
+  AddTestCase (
+    IndexTests,
+    "The index should be filled from the index the PEI variable driver built",
+    "PeiIndex",
+    PeiIndexIsImported,
+    StoreSetup,
+    StoreCleanup,
+    NULL
+    );
+
+  //
+  // Execute the tests.
+  //
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return;
+}
+
+///
+/// Avoid ECC error for function name that starts with lower case letter
+///
+#define Main  main
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+
+  @param[in] Argc  Number of arguments
+  @param[in] Argv  Array of pointers to arguments
+
+  @retval 0      Success
+  @retval other  Error
+**/
+INT32
+Main (
+  IN INT32  Argc,
+  IN CHAR8  *Argv[]
+  )
+{
+  UnitTestMain ();
+  return 0;
+}
@@ -0,0 +1,605 @@
+/** @file
+  This is a host-based unit test for the pending ranges of the runtime variable
+  caches.
+
+  The updates of a variable store are recorded with
+  RecordRuntimeVariableCacheUpdate (), and the ranges pending to be copied to
+  the runtime cache are checked after each of them. The flush is checked to
+  copy the pending ranges, and nothing else, to the runtime cache.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <Uefi.h>
+#include <Library/DebugLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UnitTestLib.h>
+
+#include "../VariableParsing.h"
+#include "../VariableRuntimeCache.h"
+
+#define UNIT_TEST_NAME     "Variable Runtime Cache Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+#define TEST_STORE_SIZE  SIZE_4KB
+
+//
+// The number of updates of the random test, and the largest of them.
+//
+#define TEST_RANDOM_UPDATES     20000
+#define TEST_RANDOM_MAX_LENGTH  64
+
+/// === TEST DATA ==================================================================================
+
+//
+// mVariableModuleGlobal - The module global of the variable driver
+// mNvVariableCache      - The non-volatile variable store the runtime cache is a copy of
+// mVolatileStore        - The volatile variable store
+// mNvCache              - The runtime cache of the non-volatile variable store
+// mVolatileCache        - The runtime cache of the volatile variable store
+// mReadLock             - The runtime cache read lock
+// mPendingUpdate        - The flag of the pending updates
+// mHobFlushComplete     - The flag of the flush of the HOB variables
+// mRewriteCount         - The number of flushes of a rewritten store
+// mSeed                 - The seed of TestRandom ()
+//
+VARIABLE_MODULE_GLOBAL  *mVariableModuleGlobal = NULL;
+VARIABLE_STORE_HEADER   *mNvVariableCache      = NULL;
+UINT8                   *mVolatileStore        = NULL;
+UINT8                   *mNvCache              = NULL;
+UINT8                   *mVolatileCache        = NULL;
+BOOLEAN                 mReadLock;
+BOOLEAN                 mPendingUpdate;
+BOOLEAN                 mHobFlushComplete;
+UINT32                  mRewriteCount;
+UINT32                  mSeed;
+
+/// === HELPERS ====================================================================================
+
+/**
+  Return a pseudo-random number.
+
+  @return A number from 0 to 0x7FFF.
+**/
+STATIC
+UINTN
+TestRandom (
+  VOID
+  )
+{
+  mSeed = mSeed * 1103515245 + 12345;
+  return (mSeed >> 16) & 0x7FFF;
+}
+
+/**
+  Change a range of the non-volatile variable store, as UpdateVariableStore ()
+  does, and record the update.
+
+  @param[in]  Offset  Offset in bytes of the range.
+  @param[in]  Length  Length in bytes of the range.
+**/
+STATIC
+VOID
+UpdateStore (
+  IN UINTN  Offset,
+  IN UINTN  Length
+  )
+{
+  UINTN  Index;
+
+  for (Index = Offset; Index < Offset + Length; Index++) {
+    ((UINT8 *)mNvVariableCache)[Index] = (UINT8)(TestRandom () | 1);
+  }
+
+  RecordRuntimeVariableCacheUpdate (
+    &mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.VariableRuntimeNvCache,
+    Offset,
+    Length
+    );
+}
+
+/**
+  Check that the pending ranges of the runtime cache of the non-volatile
+  variable store are the expected ones.
+
+  @param[in]  Expected  The expected ranges.
+  @param[in]  Count     The number of expected ranges.
+
+  @retval TRUE   The pending ranges are the expected ones.
+  @retval FALSE  They are not.
+**/
+STATIC
+BOOLEAN
+PendingRangesAre (
+  IN CONST VARIABLE_RUNTIME_CACHE_RANGE  *Expected,
+  IN UINTN                               Count
+  )
+{
+  VARIABLE_RUNTIME_CACHE  *Cache;
+
+  Cache = &mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.VariableRuntimeNvCache;
+  return (BOOLEAN)((Cache->PendingRangeCount == Count) &&
+                   (CompareMem (Cache->PendingRange, Expected, Count * sizeof (*Expected)) == 0));
+}
+
+/// === TEST CASES =================================================================================
+
+/**
+  Set up the variable stores, their runtime caches and the module global.
+
+  @param[in]  Context  Unit test case context
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+RuntimeCacheSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  VARIABLE_RUNTIME_CACHE_CONTEXT  *CacheContext;
+
+  mVariableModuleGlobal = AllocateZeroPool (sizeof (VARIABLE_MODULE_GLOBAL));
+  mNvVariableCache      = AllocateZeroPool (TEST_STORE_SIZE);
+  mVolatileStore        = AllocateZeroPool (TEST_STORE_SIZE);
+  mNvCache              = AllocateZeroPool (TEST_STORE_SIZE);
+  mVolatileCache        = AllocateZeroPool (TEST_STORE_SIZE);
+  UT_ASSERT_NOT_NULL (mVariableModuleGlobal);
+  UT_ASSERT_NOT_NULL (mNvVariableCache);
+  UT_ASSERT_NOT_NULL (mVolatileStore);
+  UT_ASSERT_NOT_NULL (mNvCache);
+  UT_ASSERT_NOT_NULL (mVolatileCache);
+
+  mVariableModuleGlobal->VariableGlobal.VolatileVariableBase = (EFI_PHYSICAL_ADDRESS)(UINTN)mVolatileStore;
+
+  mReadLock         = FALSE;
+  mPendingUpdate    = FALSE;
+  mHobFlushComplete = TRUE;
+  mRewriteCount     = 0;
+  mSeed             = 0x5EED1234;
+
+  CacheContext                                     = &mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext;
+  CacheContext->ReadLock                           = &mReadLock;
+  CacheContext->PendingUpdate                      = &mPendingUpdate;
+  CacheContext->HobFlushComplete                   = &mHobFlushComplete;
+  CacheContext->RewriteCount                       = &mRewriteCount;
+  CacheContext->VariableRuntimeNvCache.Store       = (VARIABLE_STORE_HEADER *)mNvCache;
+  CacheContext->VariableRuntimeVolatileCache.Store = (VARIABLE_STORE_HEADER *)mVolatileCache;
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Free the stores of a test.
+
+  @param[in]  Context  Unit test case context
+**/
+STATIC
+VOID
+EFIAPI
+RuntimeCacheCleanup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  if (mVolatileCache != NULL) {
+    FreePool (mVolatileCache);
+    mVolatileCache = NULL;
+  }
+
+  if (mNvCache != NULL) {
+    FreePool (mNvCache);
+    mNvCache = NULL;
+  }
+
+  if (mVolatileStore != NULL) {
+    FreePool (mVolatileStore);
+    mVolatileStore = NULL;
+  }
+
+  if (mNvVariableCache != NULL) {
+    FreePool (mNvVariableCache);
+    mNvVariableCache = NULL;
+  }
+
+  if (mVariableModuleGlobal != NULL) {
+    FreePool (mVariableModuleGlobal);
+    mVariableModuleGlobal = NULL;
+  }
+}
+
+/**
+  Record updates out of order, overlapping and touching each other, and check
+  that the pending ranges are sorted and coalesced.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+RangesAreSortedAndCoalesced (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC CONST VARIABLE_RUNTIME_CACHE_RANGE  Sorted[]    = {
+    { 100, 10 }, { 200, 10 }, { 300, 10 }
+  };
+  STATIC CONST VARIABLE_RUNTIME_CACHE_RANGE  Coalesced[] = {
+    { 0, 1 }, { 100, 30 }, { 190, 20 }, { 300, 10 }
+  };
+  STATIC CONST VARIABLE_RUNTIME_CACHE_RANGE  Spanning[]  = {
+    { 0, 1 }, { 100, 30 }, { 150, 200 }
+  };
+
+  UpdateStore (300, 10);
+  UpdateStore (100, 10);
+  UpdateStore (200, 10);
+  UT_ASSERT_TRUE (PendingRangesAre (Sorted, ARRAY_SIZE (Sorted)));
+
+  //
+  // (105, 20) overlaps (100, 10), (125, 5) touches the result, (190, 10)
+  // touches (200, 10), and an empty update is not recorded.
+  //
+  UpdateStore (105, 20);
+  UpdateStore (125, 5);
+  UpdateStore (190, 10);
+  UpdateStore (310, 0);
+  UpdateStore (0, 1);
+  UT_ASSERT_TRUE (PendingRangesAre (Coalesced, ARRAY_SIZE (Coalesced)));
+
+  //
+  // An update that covers several ranges replaces them.
+  //
+  UpdateStore (150, 200);
+  UT_ASSERT_TRUE (PendingRangesAre (Spanning, ARRAY_SIZE (Spanning)));
+  UT_ASSERT_TRUE (mPendingUpdate);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Fill the pending ranges, and check that each further disjoint update merges
+  the two ranges with the smallest gap in between.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FullRangesMergeTheClosestPair (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC CONST VARIABLE_RUNTIME_CACHE_RANGE  Full[]       = {
+    { 0, 16 }, { 64, 16 }, { 128, 16 }, { 192, 16 }, { 256, 16 }, { 320, 16 }, { 384, 16 }, { 448, 16 }
+  };
+  STATIC CONST VARIABLE_RUNTIME_CACHE_RANGE  MergedNew[]  = {
+    { 0, 16 }, { 64, 16 }, { 128, 16 }, { 192, 16 }, { 256, 16 }, { 320, 16 }, { 384, 16 }, { 448, 32 }
+  };
+  STATIC CONST VARIABLE_RUNTIME_CACHE_RANGE  MergedOld[]  = {
+    { 0, 16 }, { 40, 40 }, { 128, 16 }, { 192, 16 }, { 256, 16 }, { 320, 16 }, { 384, 16 }, { 448, 32 }
+  };
+  STATIC CONST VARIABLE_RUNTIME_CACHE_RANGE  MergedPair[] = {
+    { 0, 80 }, { 128, 16 }, { 192, 16 }, { 256, 16 }, { 320, 16 }, { 384, 16 }, { 448, 32 }, { 600, 1 }
+  };
+  UINTN                                      Index;
+
+  for (Index = 0; Index < ARRAY_SIZE (Full); Index++) {
+    UpdateStore (Full[Index].Offset, Full[Index].Length);
+  }
+
+  UT_ASSERT_EQUAL (ARRAY_SIZE (Full), VARIABLE_RUNTIME_CACHE_PENDING_RANGES);
+  UT_ASSERT_TRUE (PendingRangesAre (Full, ARRAY_SIZE (Full)));
+
+  //
+  // The new range is 8 bytes after the last one, the others are 48 bytes apart.
+  //
+  UpdateStore (472, 8);
+  UT_ASSERT_TRUE (PendingRangesAre (MergedNew, ARRAY_SIZE (MergedNew)));
+
+  //
+  // The new range is 24 bytes after the first one, and 16 bytes before the
+  // second one, which it is merged with.
+  //
+  UpdateStore (40, 8);
+  UT_ASSERT_TRUE (PendingRangesAre (MergedOld, ARRAY_SIZE (MergedOld)));
+
+  //
+  // The new range is far from all the others, so the two ranges with the
+  // smallest gap, 24 bytes from (0, 16) to (40, 40), are merged.
+  //
+  UpdateStore (600, 1);
+  UT_ASSERT_TRUE (PendingRangesAre (MergedPair, ARRAY_SIZE (MergedPair)));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Flush the pending ranges, and check that only they are copied to the runtime
+  cache, and that the rewrite count only changes after a rewrite.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FlushCopiesOnlyThePendingRanges (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  VARIABLE_RUNTIME_CACHE_CONTEXT  *CacheContext;
+  UINTN                           Index;
+  EFI_STATUS                      Status;
+
+  CacheContext = &mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext;
+
+  //
+  // The bytes of the store outside the updates are changed too, but must not
+  // be copied.
+  //
+  SetMem (mNvVariableCache, TEST_STORE_SIZE, 0xAA);
+  UpdateStore (16, 16);
+  UpdateStore (1024, 100);
+  UpdateStore (TEST_STORE_SIZE - 8, 8);
+
+  Status = FlushPendingRuntimeVariableCacheUpdates ();
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_FALSE (mPendingUpdate);
+  UT_ASSERT_EQUAL (CacheContext->VariableRuntimeNvCache.PendingRangeCount, 0);
+  UT_ASSERT_EQUAL (CacheContext->BytesChanged, 124);
+  UT_ASSERT_EQUAL (CacheContext->BytesSynced, 124);
+  UT_ASSERT_EQUAL (mRewriteCount, 0);
+
+  for (Index = 0; Index < TEST_STORE_SIZE; Index++) {
+    if (((Index >= 16) && (Index < 32)) ||
+        ((Index >= 1024) && (Index < 1124)) ||
+        (Index >= TEST_STORE_SIZE - 8))
+    {
+      UT_ASSERT_EQUAL (mNvCache[Index], ((UINT8 *)mNvVariableCache)[Index]);
+    } else {
+      UT_ASSERT_EQUAL (mNvCache[Index], 0);
+    }
+  }
+
+  //
+  // Nothing is copied again by a flush without pending updates.
+  //
+  Status = FlushPendingRuntimeVariableCacheUpdates ();
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (CacheContext->BytesSynced, 124);
+
+  //
+  // A rewritten store is counted once, by the flush that copies it.
+  //
+  RecordRuntimeVariableCacheRewrite (&CacheContext->VariableRuntimeNvCache);
+  UpdateStore (0, TEST_STORE_SIZE);
+  Status = FlushPendingRuntimeVariableCacheUpdates ();
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (mRewriteCount, 1);
+  UT_ASSERT_MEM_EQUAL (mNvCache, mNvVariableCache, TEST_STORE_SIZE);
+
+  UpdateStore (8, 8);
+  Status = FlushPendingRuntimeVariableCacheUpdates ();
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (mRewriteCount, 1);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Record random updates and flush them from time to time. Check that the
+  pending ranges stay sorted and disjoint and cover all the updated bytes, and
+  only them until two ranges had to be merged. Check that each flush leaves
+  the runtime cache equal to the store.
+
+  @param[in]  Context  Unit test case context
+**/
+UNIT_TEST_STATUS
+EFIAPI
+RandomUpdatesAreAllCopied (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  VARIABLE_RUNTIME_CACHE  *Cache;
+  BOOLEAN                 *Dirty;
+  BOOLEAN                 *Covered;
+  BOOLEAN                 Merged;
+  UINTN                   Update;
+  UINTN                   Offset;
+  UINTN                   Length;
+  UINTN                   Index;
+  UINTN                   Runs;
+  UINTN                   Flushes;
+  EFI_STATUS              Status;
+
+  Cache   = &mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.VariableRuntimeNvCache;
+  Dirty   = AllocateZeroPool (TEST_STORE_SIZE);
+  Covered = AllocateZeroPool (TEST_STORE_SIZE);
+  UT_ASSERT_NOT_NULL (Dirty);
+  UT_ASSERT_NOT_NULL (Covered);
+
+  Merged  = FALSE;
+  Flushes = 0;
+  for (Update = 0; Update < TEST_RANDOM_UPDATES; Update++) {
+    Offset = TestRandom () % TEST_STORE_SIZE;
+    Length = TestRandom () % TEST_RANDOM_MAX_LENGTH + 1;
+    Length = MIN (Length, TEST_STORE_SIZE - Offset);
+    UpdateStore (Offset, Length);
+    SetMem (&Dirty[Offset], Length, TRUE);
+
+    //
+    // The updated bytes make as many ranges as there are runs of them. More
+    // than fit in the pending ranges means two of them were merged.
+    //
+    Runs = 0;
+    for (Index = 0; Index < TEST_STORE_SIZE; Index++) {
+      if (Dirty[Index] && ((Index == 0) || !Dirty[Index - 1])) {
+        Runs++;
+      }
+    }
+
+    if (Runs > VARIABLE_RUNTIME_CACHE_PENDING_RANGES) {
+      Merged = TRUE;
+    }
+
+    UT_ASSERT_TRUE (Cache->PendingRangeCount <= VARIABLE_RUNTIME_CACHE_PENDING_RANGES);
+    ZeroMem (Covered, TEST_STORE_SIZE);
+    for (Index = 0; Index < Cache->PendingRangeCount; Index++) {
+      UT_ASSERT_TRUE (Cache->PendingRange[Index].Length > 0);
+      UT_ASSERT_TRUE (Cache->PendingRange[Index].Offset + Cache->PendingRange[Index].Length <= TEST_STORE_SIZE);
+      if (Index > 0) {
+        UT_ASSERT_TRUE (Cache->PendingRange[Index - 1].Offset + Cache->PendingRange[Index - 1].Length < Cache->PendingRange[Index].Offset);
+      }
+
+      SetMem (&Covered[Cache->PendingRange[Index].Offset], Cache->PendingRange[Index].Length, TRUE);
+    }
+
+    for (Index = 0; Index < TEST_STORE_SIZE; Index++) {
+      UT_ASSERT_TRUE (Covered[Index] || !Dirty[Index]);
+      UT_ASSERT_TRUE (Merged || (Covered[Index] == Dirty[Index]));
+    }
+
+    if (TestRandom () % 16 == 0) {
+      Status = FlushPendingRuntimeVariableCacheUpdates ();
+      UT_ASSERT_NOT_EFI_ERROR (Status);
+      UT_ASSERT_MEM_EQUAL (mNvCache, mNvVariableCache, TEST_STORE_SIZE);
+      ZeroMem (Dirty, TEST_STORE_SIZE);
+      Merged = FALSE;
+      Flushes++;
+    }
+  }
+
+  UT_LOG_INFO (
+    "%Lu updates of %Lu bytes were copied by %Lu flushes of %Lu bytes\n",
+    (UINT64)TEST_RANDOM_UPDATES,
+    mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.BytesChanged,
+    (UINT64)Flushes,
+    mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.BytesSynced
+    );
+
+  FreePool (Covered);
+  FreePool (Dirty);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Main entry point to this unit test application.
+
+  Sets up and runs the test suites.
+**/
+VOID
+EFIAPI
+UnitTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      RuntimeCacheTests;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  //
+  // Start setting up the test framework for running the tests.
+  //
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  //
+  // Add all test suites and tests.
+  //
+  Status = CreateUnitTestSuite (
+             &RuntimeCacheTests,
+             Framework,
+             "Variable Runtime Cache Tests",
+             "Variable.RuntimeCache",
+             NULL,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for RuntimeCacheTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (
+    RuntimeCacheTests,
+    "The pending ranges should be sorted and coalesced",
+    "Coalesce",
+    RangesAreSortedAndCoalesced,
+    RuntimeCacheSetup,
+    RuntimeCacheCleanup,
+    NULL
+    );
+  AddTestCase (
+    RuntimeCacheTests,
+    "Full pending ranges should merge the two closest ranges",
+    "MergeClosest",
+    FullRangesMergeTheClosestPair,
+    RuntimeCacheSetup,
+    RuntimeCacheCleanup,
+    NULL
+    );
+  AddTestCase (
+    RuntimeCacheTests,
+    "A flush should copy only the pending ranges",
+    "Flush",
+    FlushCopiesOnlyThePendingRanges,
+    RuntimeCacheSetup,
+    RuntimeCacheCleanup,
+    NULL
+    );
+  AddTestCase (
+    RuntimeCacheTests,
+    "All the random updates should be copied by the flushes",
+    "Random",
+    RandomUpdatesAreAllCopied,
+    RuntimeCacheSetup,
+    RuntimeCacheCleanup,
+    NULL
+    );
+
+  //
+  // Execute the tests.
+  //
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return;
+}
+
+///
+/// Avoid ECC error for function name that starts with lower case letter
+///
+#define Main  main
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+
+  @param[in] Argc  Number of arguments
+  @param[in] Argv  Array of pointers to arguments
+
+  @retval 0      Success
+  @retval other  Error
+**/
+INT32
+Main (
+  IN INT32  Argc,
+  IN CHAR8  *Argv[]
+  )
+{
+  UnitTestMain ();
+  return 0;
+}
@@ -28,7 +28,9 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include "Variable.h"
 #include "VariableNonVolatile.h"
 #include "VariableParsing.h"
+#include "VariableIndex.h"
 #include "VariableRuntimeCache.h"
+#include "VariableBatch.h"
 
 VARIABLE_MODULE_GLOBAL  *mVariableModuleGlobal;
 
@@ -142,6 +144,7 @@ UpdateVariableStore (
   EFI_PHYSICAL_ADDRESS    FvVolHdr;
   EFI_PHYSICAL_ADDRESS    DataPtr;
   EFI_STATUS              Status;
+  UINTN                   Offset;
 
   FvVolHdr = 0;
   DataPtr  = DataPtrIndex;
@@ -168,6 +171,24 @@ UpdateVariableStore (
     if ((DataPtr + DataSize) > (FvVolHdr + mNvFvHeaderCache->FvLength)) {
       return EFI_OUT_OF_RESOURCES;
     }
+
+    //
+    // The caller updates the non-volatile variable cache the same way.
+    //
+    Offset = (UINTN)(DataPtr - mVariableModuleGlobal->VariableGlobal.NonVolatileVariableBase);
+    RecordRuntimeVariableCacheUpdate (
+      &mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.VariableRuntimeNvCache,
+      Offset,
+      DataSize
+      );
+
+    if (mVariableModuleGlobal->BatchActive) {
+      //
+      // Just record the range for FlushBatchNvWrites () to write.
+      //
+      VariableBatchRecordNvUpdate (Offset, DataSize);
+      return EFI_SUCCESS;
+    }
   } else {
     //
     // Data Pointer should point to the actual Address where data is to be
@@ -182,6 +203,12 @@ UpdateVariableStore (
       if ((DataPtr + DataSize) > ((UINTN)VolatileBase + VolatileBase->Size)) {
         return EFI_OUT_OF_RESOURCES;
       }
+
+      RecordRuntimeVariableCacheUpdate (
+        &mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.VariableRuntimeVolatileCache,
+        (UINTN)(DataPtr - (UINTN)VolatileBase),
+        DataSize
+        );
     } else {
       //
       // Emulated non-volatile variable mode.
@@ -193,6 +220,12 @@ UpdateVariableStore (
       if ((DataPtr + DataSize) > ((UINTN)mNvVariableCache + mNvVariableCache->Size)) {
         return EFI_OUT_OF_RESOURCES;
       }
+
+      RecordRuntimeVariableCacheUpdate (
+        &mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.VariableRuntimeNvCache,
+        (UINTN)(DataPtr - (UINTN)mNvVariableCache),
+        DataSize
+        );
     }
 
     //
@@ -341,8 +374,8 @@ RecordVarErrorFlag (
       *VarErrFlag = TempFlag;
       Status      =  SynchronizeRuntimeVariableCache (
                        &mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.VariableRuntimeNvCache,
-                       0,
-                       mNvVariableCache->Size
+                       (UINTN)VarErrFlag - (UINTN)mNvVariableCache,
+                       sizeof (TempFlag)
                        );
       ASSERT_EFI_ERROR (Status);
     }
@@ -497,6 +530,44 @@ InitializeVariableQuota (
   CalculateCommonUserVariableTotalSize ();
 }
 
+/**
+  Recalculate the variable quotas from the non-volatile variable cache. Like the
+  error path of Reclaim (), all variables are counted, as the deleted variables
+  still take space in the store.
+
+**/
+VOID
+RecalculateNvVariableTotalSize (
+  VOID
+  )
+{
+  VARIABLE_HEADER  *Variable;
+  VARIABLE_HEADER  *NextVariable;
+  VARIABLE_HEADER  *StoreEnd;
+  UINTN            VariableSize;
+
+  mVariableModuleGlobal->HwErrVariableTotalSize      = 0;
+  mVariableModuleGlobal->CommonVariableTotalSize     = 0;
+  mVariableModuleGlobal->CommonUserVariableTotalSize = 0;
+
+  StoreEnd = (VARIABLE_HEADER *)((UINTN)mNvVariableCache + mVariableModuleGlobal->NonVolatileLastVariableOffset);
+  Variable = GetStartPointer (mNvVariableCache);
+  while (IsValidVariableHeader (Variable, StoreEnd)) {
+    NextVariable = GetNextVariablePtr (Variable, mVariableModuleGlobal->VariableGlobal.AuthFormat);
+    VariableSize = (UINTN)NextVariable - (UINTN)Variable;
+    if ((Variable->Attributes & EFI_VARIABLE_HARDWARE_ERROR_RECORD) == EFI_VARIABLE_HARDWARE_ERROR_RECORD) {
+      mVariableModuleGlobal->HwErrVariableTotalSize += VariableSize;
+    } else {
+      mVariableModuleGlobal->CommonVariableTotalSize += VariableSize;
+      if (IsUserVariable (Variable)) {
+        mVariableModuleGlobal->CommonUserVariableTotalSize += VariableSize;
+      }
+    }
+
+    Variable = NextVariable;
+  }
+}
+
 /**
 
   Variable store garbage collection and reclaim operation.
@@ -546,6 +617,17 @@ Reclaim (
   VARIABLE_HEADER        *UpdatingInDeletedTransition;
   BOOLEAN                AuthFormat;
 
+  if (!IsVolatile) {
+    //
+    // The store is rebuilt from the flash, which must hold the updates of the
+    // current batch of SetVariable () calls first.
+    //
+    Status = FlushBatchNvWrites ();
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
   AuthFormat                  = mVariableModuleGlobal->VariableGlobal.AuthFormat;
   UpdatingVariable            = NULL;
   UpdatingInDeletedTransition = NULL;
@@ -794,6 +876,8 @@ Reclaim (
 Done:
   DoneStatus = EFI_SUCCESS;
   if (IsVolatile || mVariableModuleGlobal->VariableGlobal.EmuNvMode) {
+    VariableIndexInvalidate ((VARIABLE_STORE_HEADER *)(UINTN)VariableBase);
+    RecordRuntimeVariableCacheRewrite (&mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.VariableRuntimeVolatileCache);
     DoneStatus = SynchronizeRuntimeVariableCache (
                    &mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.VariableRuntimeVolatileCache,
                    0,
@@ -806,6 +890,10 @@ Done:
     // For NV variable reclaim, we use mNvVariableCache as the buffer, so copy the data back.
     //
     CopyMem (mNvVariableCache, (UINT8 *)(UINTN)VariableBase, VariableStoreHeader->Size);
+    VariableIndexInvalidate (mNvVariableCache);
+    RecordRuntimeVariableCacheRewrite (&mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.VariableRuntimeNvCache);
+    mVariableModuleGlobal->ReclaimDestinationOffset = 0;
+    mVariableModuleGlobal->ReclaimSourceOffset      = 0;
     DoneStatus = SynchronizeRuntimeVariableCache (
                    &mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.VariableRuntimeNvCache,
                    0,
@@ -2393,11 +2481,15 @@ Done:
       VolatileCacheInstance = &(mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.VariableRuntimeVolatileCache);
     }
 
-    if (VolatileCacheInstance->Store != NULL) {
+    //
+    // UpdateVariableStore () recorded the ranges of the variable stores this update
+    // changed. In a batch, they are copied to the runtime caches at the end of it.
+    //
+    if ((VolatileCacheInstance->Store != NULL) && !mVariableModuleGlobal->BatchActive) {
       Status =  SynchronizeRuntimeVariableCache (
                   VolatileCacheInstance,
                   0,
-                  VolatileCacheInstance->Store->Size
+                  0
                   );
       ASSERT_EFI_ERROR (Status);
     }
@@ -2909,6 +3001,8 @@ VariableServiceSetVariable (
     Status = UpdateVariable (VariableName, VendorGuid, Data, DataSize, Attributes, 0, 0, &Variable, NULL);
   }
 
+  ReclaimStep ();
+
 Done:
   InterlockedDecrement (&mVariableModuleGlobal->VariableGlobal.ReentrantState);
   ReleaseLockOnlyAtBootTime (&mVariableModuleGlobal->VariableGlobal.VariableServicesLock);
@@ -3406,6 +3500,7 @@ FlushHobVariableToFlash (
         *(mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.HobFlushComplete) = TRUE;
       }
 
+      VariableIndexUnregister (VariableStoreHeader);
       if (!AtRuntime ()) {
         FreePool ((VOID *)VariableStoreHeader);
       }
@@ -3717,6 +3812,7 @@ VariableCommonInitialize (
   VARIABLE_STORE_HEADER  *VolatileVariableStore;
   UINTN                  ScratchSize;
   EFI_GUID               *VariableGuid;
+  EFI_HOB_GUID_TYPE      *GuidHob;
 
   //
   // Allocate runtime memory for variable driver global structure.
@@ -3805,6 +3901,34 @@ VariableCommonInitialize (
   VolatileVariableStore->Reserved  = 0;
   VolatileVariableStore->Reserved1 = 0;
 
+  //
+  // Index the variable stores FindVariable () searches. A store that is not
+  // indexed is walked.
+  //
+  if (mVariableModuleGlobal->VariableGlobal.HobVariableBase != 0) {
+    VariableIndexRegister (
+      (VARIABLE_STORE_HEADER *)(UINTN)mVariableModuleGlobal->VariableGlobal.HobVariableBase,
+      mVariableModuleGlobal->VariableGlobal.AuthFormat
+      );
+  }
+
+  VariableIndexRegister (VolatileVariableStore, mVariableModuleGlobal->VariableGlobal.AuthFormat);
+  VariableIndexRegister (mNvVariableCache, mVariableModuleGlobal->VariableGlobal.AuthFormat);
+
+  //
+  // The non-volatile variable store has not been written since PEI, so the
+  // index the PEI variable driver built for it can be reused.
+  //
+  GuidHob = GetFirstGuidHob (&gEdkiiPeiVariableIndexGuid);
+  if (GuidHob != NULL) {
+    VariableIndexImportPeiIndex (
+      mNvVariableCache,
+      mVariableModuleGlobal->VariableGlobal.NonVolatileVariableBase,
+      GET_GUID_HOB_DATA (GuidHob),
+      GET_GUID_HOB_DATA_SIZE (GuidHob)
+      );
+  }
+
   return EFI_SUCCESS;
 }
 
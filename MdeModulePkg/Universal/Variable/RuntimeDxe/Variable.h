@@ -61,19 +61,34 @@ typedef enum {
   VariableStoreTypeMax
 } VARIABLE_STORE_TYPE;
 
+///
+/// The number of disjoint ranges of a variable store pending to be copied to its
+/// runtime cache. When an update does not fit, the two closest ranges are merged.
+///
+#define VARIABLE_RUNTIME_CACHE_PENDING_RANGES  8
+
+typedef struct {
+  UINT32    Offset;
+  UINT32    Length;
+} VARIABLE_RUNTIME_CACHE_RANGE;
+
 typedef struct {
-  UINT32                   PendingUpdateOffset;
-  UINT32                   PendingUpdateLength;
-  VARIABLE_STORE_HEADER    *Store;
+  UINTN                           PendingRangeCount;
+  VARIABLE_RUNTIME_CACHE_RANGE    PendingRange[VARIABLE_RUNTIME_CACHE_PENDING_RANGES];
+  BOOLEAN                         PendingRewrite;     // The store was rewritten in place since the last flush
+  VARIABLE_STORE_HEADER           *Store;
 } VARIABLE_RUNTIME_CACHE;
 
 typedef struct {
   BOOLEAN                   *ReadLock;
   BOOLEAN                   *PendingUpdate;
   BOOLEAN                   *HobFlushComplete;
+  UINT32                    *RewriteCount;
   VARIABLE_RUNTIME_CACHE    VariableRuntimeHobCache;
   VARIABLE_RUNTIME_CACHE    VariableRuntimeNvCache;
   VARIABLE_RUNTIME_CACHE    VariableRuntimeVolatileCache;
+  UINT64                    BytesChanged;
+  UINT64                    BytesSynced;
 } VARIABLE_RUNTIME_CACHE_CONTEXT;
 
 typedef struct {
@@ -106,6 +121,14 @@ typedef struct {
   VARIABLE_GLOBAL                       VariableGlobal;
   UINTN                                 VolatileLastVariableOffset;
   UINTN                                 NonVolatileLastVariableOffset;
+  UINTN                                 ReclaimDestinationOffset;
+  UINTN                                 ReclaimSourceOffset;
+  BOOLEAN                               BatchActive;
+  EFI_STATUS                            BatchStatus;
+  UINTN                                 BatchNvDirtyStart;
+  UINTN                                 BatchNvDirtyEnd;
+  UINTN                                 BatchNvUpdates;
+  UINTN                                 BatchNvFlushes;
   UINTN                                 CommonVariableSpace;
   UINTN                                 CommonMaxUserVariableSpace;
   UINTN                                 CommonRuntimeVariableSpace;
@@ -157,6 +180,29 @@ FtwVariableSpace (
   IN VARIABLE_STORE_HEADER  *VariableBuffer
   );
 
+/**
+  Writes a buffer to a range of the variable storage space.
+
+  This function writes a buffer to a range of the variable storage space
+  through the Fault Tolerant Write protocol, so that the blocks the range
+  spans are either fully updated or left unchanged.
+
+  @param  Address        Address of the range to write.
+  @param  Length         Length of the range to write.
+  @param  Buffer         Point to the new content of the range.
+
+  @retval EFI_SUCCESS    The function completed successfully.
+  @retval EFI_NOT_FOUND  Fail to locate Fault Tolerant Write protocol.
+  @retval EFI_ABORTED    The function could not complete successfully.
+
+**/
+EFI_STATUS
+FtwVariableRange (
+  IN EFI_PHYSICAL_ADDRESS  Address,
+  IN UINTN                 Length,
+  IN VOID                  *Buffer
+  );
+
 /**
   Finds variable in storage blocks of volatile and non-volatile storage areas.
 
@@ -415,6 +461,19 @@ GetFtwProtocol (
   OUT VOID  **FtwProtocol
   );
 
+/**
+  Check whether the Fault Tolerant Write protocol can still be used after
+  ExitBootServices ().
+
+  @retval TRUE                  The Fault Tolerant Write protocol is available at runtime.
+  @retval FALSE                 The Fault Tolerant Write protocol is a boot service.
+
+**/
+BOOLEAN
+FtwAvailableAtRuntime (
+  VOID
+  );
+
 /**
   Get the proper fvb handle and/or fvb protocol by the given Flash address.
 
@@ -530,6 +589,27 @@ VariableServiceSetVariable (
   IN VOID      *Data
   );
 
+/**
+  Recalculate the variable quotas from the non-volatile variable cache. Like the
+  error path of Reclaim (), all variables are counted, as the deleted variables
+  still take space in the store.
+
+**/
+VOID
+RecalculateNvVariableTotalSize (
+  VOID
+  );
+
+/**
+  Reclaim the non-volatile variable store incrementally, writing at most
+  PcdVariableIncrementalReclaimBlocks erase blocks in the call.
+
+**/
+VOID
+ReclaimStep (
+  VOID
+  );
+
 /**
 
   This code returns information about the EFI variables.
@@ -0,0 +1,313 @@
+/** @file
+  Batches of SetVariable () calls whose non-volatile variable updates are written
+  to the flash at once.
+
+  While a batch is active, UpdateVariableStore () only applies the updates of the
+  non-volatile variables to the non-volatile variable cache, and records the range
+  of the store they cover. At the end of the batch, the range is written with a
+  single Fault Tolerant Write, and the runtime variable caches are synchronized
+  once.
+
+  The write fails if the range spans more blocks than the spare area of the Fault
+  Tolerant Write. The deferred updates are then dropped from the non-volatile
+  variable cache, and the variables of the batch that had deferred updates are set
+  again one by one, like SMM_VARIABLE_FUNCTION_SET_VARIABLE does, so that the
+  status of each entry is the real outcome of its variable.
+
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "VariableBatch.h"
+#include "VariableParsing.h"
+#include "VariableIndex.h"
+#include "VariableRuntimeCache.h"
+
+/**
+  Record an update of the non-volatile variable cache made by UpdateVariableStore ()
+  during a batch, for FlushBatchNvWrites () to write to the flash.
+
+  @param[in] Offset  Offset of the update from the start of the non-volatile variable store.
+  @param[in] Length  Length in bytes of the update.
+
+**/
+VOID
+VariableBatchRecordNvUpdate (
+  IN UINTN  Offset,
+  IN UINTN  Length
+  )
+{
+  ASSERT (mVariableModuleGlobal->BatchActive);
+
+  if (mVariableModuleGlobal->BatchNvDirtyEnd == 0) {
+    mVariableModuleGlobal->BatchNvDirtyStart = Offset;
+    mVariableModuleGlobal->BatchNvDirtyEnd   = Offset + Length;
+  } else {
+    mVariableModuleGlobal->BatchNvDirtyStart = MIN (mVariableModuleGlobal->BatchNvDirtyStart, Offset);
+    mVariableModuleGlobal->BatchNvDirtyEnd   = MAX (mVariableModuleGlobal->BatchNvDirtyEnd, Offset + Length);
+  }
+
+  mVariableModuleGlobal->BatchNvUpdates++;
+}
+
+/**
+  Write the non-volatile variable updates deferred by the current batch of
+  SetVariable () calls to the flash.
+
+  The range of the non-volatile variable cache the batch updated is written with
+  a single Fault Tolerant Write, so that either all or none of the updates are
+  found in the flash after a reset. If the write fails, the updates are dropped
+  from the non-volatile variable cache as well, and the batch is ended, so that
+  the next updates are written to the flash at once.
+
+  @retval EFI_SUCCESS           The deferred updates were written to the flash.
+  @retval Others                The deferred updates could not be written, and were
+                                dropped. The batch is ended.
+
+**/
+EFI_STATUS
+FlushBatchNvWrites (
+  VOID
+  )
+{
+  EFI_STATUS            Status;
+  EFI_PHYSICAL_ADDRESS  Address;
+  UINTN                 Offset;
+  UINTN                 Length;
+  VARIABLE_HEADER       *Variable;
+
+  if (mVariableModuleGlobal->BatchNvDirtyEnd == 0) {
+    return EFI_SUCCESS;
+  }
+
+  Offset  = mVariableModuleGlobal->BatchNvDirtyStart;
+  Length  = mVariableModuleGlobal->BatchNvDirtyEnd - Offset;
+  Address = mVariableModuleGlobal->VariableGlobal.NonVolatileVariableBase + Offset;
+
+  mVariableModuleGlobal->BatchNvDirtyStart = 0;
+  mVariableModuleGlobal->BatchNvDirtyEnd   = 0;
+  mVariableModuleGlobal->BatchNvUpdates    = 0;
+
+  Status = FtwVariableRange (Address, Length, (UINT8 *)mNvVariableCache + Offset);
+  if (!EFI_ERROR (Status)) {
+    mVariableModuleGlobal->BatchNvFlushes++;
+    return EFI_SUCCESS;
+  }
+
+  DEBUG ((DEBUG_ERROR, "Variable: batch write of 0x%x bytes failed - %r\n", Length, Status));
+
+  //
+  // Roll the non-volatile variable cache back to the flash.
+  //
+  CopyMem ((UINT8 *)mNvVariableCache + Offset, (VOID *)(UINTN)Address, Length);
+  VariableIndexInvalidate (mNvVariableCache);
+  RecordRuntimeVariableCacheRewrite (&mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.VariableRuntimeNvCache);
+
+  Variable = GetStartPointer (mNvVariableCache);
+  while (IsValidVariableHeader (Variable, GetEndPointer (mNvVariableCache))) {
+    Variable = GetNextVariablePtr (Variable, mVariableModuleGlobal->VariableGlobal.AuthFormat);
+  }
+
+  mVariableModuleGlobal->NonVolatileLastVariableOffset = (UINTN)Variable - (UINTN)mNvVariableCache;
+  RecalculateNvVariableTotalSize ();
+  RecordRuntimeVariableCacheUpdate (
+    &mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.VariableRuntimeNvCache,
+    Offset,
+    Length
+    );
+  mVariableModuleGlobal->ReclaimDestinationOffset = 0;
+  mVariableModuleGlobal->ReclaimSourceOffset      = 0;
+
+  mVariableModuleGlobal->BatchActive = FALSE;
+  mVariableModuleGlobal->BatchStatus = Status;
+
+  return Status;
+}
+
+/**
+  Start a batch of SetVariable () calls.
+
+  Until VariableEndBatch () is called, the updates of the non-volatile variables
+  are only made in the non-volatile variable cache, and the runtime variable
+  caches are not synchronized. The caller must keep the other variable services
+  from running during the batch, which the SMI handler does by design.
+
+**/
+VOID
+VariableBeginBatch (
+  VOID
+  )
+{
+  ASSERT (!mVariableModuleGlobal->BatchActive);
+
+  mVariableModuleGlobal->BatchActive       = TRUE;
+  mVariableModuleGlobal->BatchStatus       = EFI_SUCCESS;
+  mVariableModuleGlobal->BatchNvDirtyStart = 0;
+  mVariableModuleGlobal->BatchNvDirtyEnd   = 0;
+  mVariableModuleGlobal->BatchNvUpdates    = 0;
+  mVariableModuleGlobal->BatchNvFlushes    = 0;
+}
+
+/**
+  End a batch of SetVariable () calls.
+
+  The non-volatile variable updates of the batch are written to the flash with a
+  single Fault Tolerant Write, and the runtime variable caches are synchronized
+  once for the whole batch.
+
+  @retval EFI_SUCCESS           The updates of the batch were written to the flash.
+  @retval Others                Some non-volatile variable updates of the batch could
+                                not be written to the flash, and were dropped.
+
+**/
+EFI_STATUS
+VariableEndBatch (
+  VOID
+  )
+{
+  if (mVariableModuleGlobal->BatchActive) {
+    FlushBatchNvWrites ();
+    mVariableModuleGlobal->BatchActive = FALSE;
+  }
+
+  //
+  // Copy the ranges of the variable stores the batch changed to the runtime caches.
+  //
+  SynchronizeRuntimeVariableCache (
+    &mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.VariableRuntimeNvCache,
+    0,
+    0
+    );
+
+  if (!EFI_ERROR (mVariableModuleGlobal->BatchStatus)) {
+    ReclaimStep ();
+  }
+
+  return mVariableModuleGlobal->BatchStatus;
+}
+
+/**
+  Get the next entry of a SetVariable batch request.
+
+  @param[in] Entry  An entry of the batch.
+
+  @return The entry that follows Entry.
+
+**/
+STATIC
+SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY *
+GetNextBatchEntry (
+  IN SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY  *Entry
+  )
+{
+  return (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY *)ALIGN_VALUE (
+                                                                (UINTN)Entry->Variable.Name + Entry->Variable.NameSize + Entry->Variable.DataSize,
+                                                                sizeof (UINTN)
+                                                                );
+}
+
+/**
+  Set the variable of an entry of a SetVariable batch request.
+
+  @param[in, out] Entry  The entry. On return, its Status is the result of
+                         setting its variable.
+
+**/
+STATIC
+VOID
+SetBatchEntryVariable (
+  IN OUT SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY  *Entry
+  )
+{
+  Entry->Status = VariableServiceSetVariable (
+                    Entry->Variable.Name,
+                    &Entry->Variable.Guid,
+                    Entry->Variable.Attributes,
+                    Entry->Variable.DataSize,
+                    (UINT8 *)Entry->Variable.Name + Entry->Variable.NameSize
+                    );
+}
+
+/**
+  Set the variables of a SetVariable batch request that was already validated.
+
+  The variables are first set in a batch. If the non-volatile variable updates
+  of the batch cannot be written to the flash, they are dropped, and the variables
+  whose updates were dropped, as well as the variables the batch did not get to,
+  are set again one by one in the order of the request.
+
+  @param[in, out] Batch         The SetVariable batch request. On return, the Status
+                                of each entry is the result of setting its variable.
+
+  @retval EFI_SUCCESS           The batch was processed.
+  @retval EFI_OUT_OF_RESOURCES  There is not enough memory to process the batch. No
+                                variable was set.
+
+**/
+EFI_STATUS
+VariableSetVariableBatch (
+  IN OUT SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH  *Batch
+  )
+{
+  SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY  *Entry;
+  BOOLEAN                                            *Deferred;
+  UINTN                                              Index;
+  UINTN                                              Committed;
+  UINTN                                              Stop;
+  UINTN                                              NvUpdates;
+  UINTN                                              NvFlushes;
+
+  if (Batch->Count == 0) {
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Deferred[Index] - TRUE if entry Index has non-volatile updates that are not
+  //                   in the flash yet.
+  //
+  Deferred = AllocateZeroPool (Batch->Count * sizeof (BOOLEAN));
+  if (Deferred == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  VariableBeginBatch ();
+
+  Committed = 0;
+  Entry     = (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY *)(Batch + 1);
+  for (Index = 0; (Index < Batch->Count) && mVariableModuleGlobal->BatchActive; Index++) {
+    NvUpdates = mVariableModuleGlobal->BatchNvUpdates;
+    NvFlushes = mVariableModuleGlobal->BatchNvFlushes;
+    SetBatchEntryVariable (Entry);
+    if (mVariableModuleGlobal->BatchNvFlushes != NvFlushes) {
+      //
+      // Reclaim () wrote the updates deferred so far to the flash.
+      //
+      Committed = Index;
+      NvUpdates = 0;
+    }
+
+    //
+    // An entry whose Reclaim () failed to write the deferred updates is set again too.
+    //
+    Deferred[Index] = (BOOLEAN)(!mVariableModuleGlobal->BatchActive ||
+                                (mVariableModuleGlobal->BatchNvUpdates != NvUpdates));
+    Entry           = GetNextBatchEntry (Entry);
+  }
+
+  Stop = Index;
+  if (EFI_ERROR (VariableEndBatch ())) {
+    DEBUG ((DEBUG_INFO, "Variable: setting the variables of the batch one by one\n"));
+
+    Entry = (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY *)(Batch + 1);
+    for (Index = 0; Index < Batch->Count; Index++) {
+      if ((Index >= Stop) || ((Index >= Committed) && Deferred[Index])) {
+        SetBatchEntryVariable (Entry);
+      }
+
+      Entry = GetNextBatchEntry (Entry);
+    }
+  }
+
+  FreePool (Deferred);
+  return EFI_SUCCESS;
+}
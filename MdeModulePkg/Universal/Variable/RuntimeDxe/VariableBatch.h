@@ -0,0 +1,87 @@
+/** @file
+  Batches of SetVariable () calls whose non-volatile variable updates are written
+  to the flash at once.
+
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _VARIABLE_BATCH_H_
+#define _VARIABLE_BATCH_H_
+
+#include "Variable.h"
+
+#include <Guid/SmmVariableCommon.h>
+
+/**
+  Record an update of the non-volatile variable cache made by UpdateVariableStore ()
+  during a batch, for FlushBatchNvWrites () to write to the flash.
+
+  @param[in] Offset  Offset of the update from the start of the non-volatile variable store.
+  @param[in] Length  Length in bytes of the update.
+
+**/
+VOID
+VariableBatchRecordNvUpdate (
+  IN UINTN  Offset,
+  IN UINTN  Length
+  );
+
+/**
+  Write the non-volatile variable updates deferred by the current batch of
+  SetVariable () calls to the flash.
+
+  @retval EFI_SUCCESS           The deferred updates were written to the flash.
+  @retval Others                The deferred updates could not be written, and were
+                                dropped. The batch is ended.
+
+**/
+EFI_STATUS
+FlushBatchNvWrites (
+  VOID
+  );
+
+/**
+  Start a batch of SetVariable () calls.
+
+  Until VariableEndBatch () is called, the updates of the non-volatile variables
+  are only made in the non-volatile variable cache, and the runtime variable
+  caches are not synchronized.
+
+**/
+VOID
+VariableBeginBatch (
+  VOID
+  );
+
+/**
+  End a batch of SetVariable () calls, writing the non-volatile variable updates
+  of the batch to the flash at once.
+
+  @retval EFI_SUCCESS           The updates of the batch were written to the flash.
+  @retval Others                Some non-volatile variable updates of the batch could
+                                not be written to the flash, and were dropped.
+
+**/
+EFI_STATUS
+VariableEndBatch (
+  VOID
+  );
+
+/**
+  Set the variables of a SetVariable batch request that was already validated.
+
+  @param[in, out] Batch         The SetVariable batch request. On return, the Status
+                                of each entry is the result of setting its variable.
+
+  @retval EFI_SUCCESS           The batch was processed.
+  @retval EFI_OUT_OF_RESOURCES  There is not enough memory to process the batch. No
+                                variable was set.
+
+**/
+EFI_STATUS
+VariableSetVariableBatch (
+  IN OUT SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH  *Batch
+  );
+
+#endif
@@ -11,6 +11,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 **/
 
 #include "Variable.h"
+#include "VariableIndex.h"
 
 #include <Protocol/VariablePolicy.h>
 #include <Library/VariablePolicyLib.h>
@@ -162,6 +163,21 @@ GetFtwProtocol (
   return Status;
 }
 
+/**
+  Check whether the Fault Tolerant Write protocol can still be used after
+  ExitBootServices ().
+
+  @retval FALSE                 The Fault Tolerant Write protocol is a boot service.
+
+**/
+BOOLEAN
+FtwAvailableAtRuntime (
+  VOID
+  )
+{
+  return FALSE;
+}
+
 /**
   Retrieve the FVB protocol interface by HANDLE.
 
@@ -266,6 +282,13 @@ VariableClassAddressChangeEvent (
   EfiConvertPointer (0x0, (VOID **)&mNvVariableCache);
   EfiConvertPointer (0x0, (VOID **)&mNvFvHeaderCache);
 
+  for (Index = 0; Index < VARIABLE_INDEX_MAX_STORES; Index++) {
+    if (mVariableStoreIndex[Index] != NULL) {
+      EfiConvertPointer (0x0, (VOID **)&mVariableStoreIndex[Index]->Store);
+      EfiConvertPointer (0x0, (VOID **)&mVariableStoreIndex[Index]);
+    }
+  }
+
   if (mAuthContextOut.AddressPointer != NULL) {
     for (Index = 0; Index < mAuthContextOut.AddressPointerCount; Index++) {
       EfiConvertPointer (0x0, (VOID **)mAuthContextOut.AddressPointer[Index]);
@@ -0,0 +1,441 @@
+/** @file
+  Hashed name and GUID index of the variable stores.
+
+  FindVariableEx () walks a variable store header by header and compares the
+  GUID and name of every variable. When PcdEnableVariableIndex is TRUE, the
+  variable stores the driver searches are indexed by a hash of the GUID and
+  name of their variables, so that a lookup only compares the variables that
+  share the hash of the variable searched.
+
+  The variables of a store are only ever appended to it, or change state in
+  place, until the store is rewritten by Reclaim (). An index therefore covers
+  the variables of its store up to IndexedEnd, picks up the variables appended
+  since its last lookup on its next one, and filters the variables of a hash
+  chain by their current state exactly like the walk of the store does. A
+  store rewritten in place must be invalidated through VariableIndexInvalidate ().
+
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "VariableParsing.h"
+#include "VariableIndex.h"
+
+VARIABLE_STORE_INDEX  *mVariableStoreIndex[VARIABLE_INDEX_MAX_STORES];
+
+/**
+  Get the index of the variable store a lookup walks.
+
+  @param[in] StartPtr  The start pointer of the variable store.
+
+  @return The index of the store, or NULL if the store is not indexed.
+
+**/
+STATIC
+VARIABLE_STORE_INDEX *
+VariableIndexGet (
+  IN VARIABLE_HEADER  *StartPtr
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < VARIABLE_INDEX_MAX_STORES; Index++) {
+    if ((mVariableStoreIndex[Index] != NULL) && (GetStartPointer (mVariableStoreIndex[Index]->Store) == StartPtr)) {
+      return mVariableStoreIndex[Index];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Append a variable to the hash chain of its bucket in the index of a store.
+  The variables must be added in the order of the store.
+
+  @param[in, out] Index   The index of the variable store.
+  @param[in]      Offset  The offset of the variable header from the start
+                          pointer of the store.
+  @param[in]      Hash    The hash of the GUID and name of the variable.
+
+**/
+STATIC
+VOID
+VariableIndexAddEntry (
+  IN OUT VARIABLE_STORE_INDEX  *Index,
+  IN     UINT32                Offset,
+  IN     UINT32                Hash
+  )
+{
+  UINT32  Bucket;
+  UINT32  EntryNumber;
+
+  ASSERT (Index->EntryCount < Index->EntryCapacity);
+
+  Bucket                               = Hash & (VARIABLE_INDEX_BUCKET_COUNT - 1);
+  EntryNumber                          = ++Index->EntryCount;
+  Index->Entry[EntryNumber - 1].Offset = Offset;
+  Index->Entry[EntryNumber - 1].Next   = 0;
+  if (Index->Tail[Bucket] == 0) {
+    Index->Head[Bucket] = EntryNumber;
+  } else {
+    Index->Entry[Index->Tail[Bucket] - 1].Next = EntryNumber;
+  }
+
+  Index->Tail[Bucket] = EntryNumber;
+}
+
+/**
+  Add the variables appended to a store since the last lookup to its index.
+
+  @param[in, out] Index  The index of the variable store.
+
+  @retval TRUE   The index covers all variables of the store.
+  @retval FALSE  A variable of the store cannot be indexed. The store must be
+                 walked.
+
+**/
+STATIC
+BOOLEAN
+VariableIndexCatchUp (
+  IN OUT VARIABLE_STORE_INDEX  *Index
+  )
+{
+  VARIABLE_HEADER  *StartPtr;
+  VARIABLE_HEADER  *EndPtr;
+  VARIABLE_HEADER  *Variable;
+  VARIABLE_HEADER  *NextVariable;
+  UINTN            Length;
+
+  StartPtr = GetStartPointer (Index->Store);
+  EndPtr   = GetEndPointer (Index->Store);
+
+  for ( Variable = (VARIABLE_HEADER *)((UINTN)StartPtr + Index->IndexedEnd)
+        ; IsValidVariableHeader (Variable, EndPtr)
+        ; Variable = NextVariable
+        )
+  {
+    NextVariable = GetNextVariablePtr (Variable, Index->AuthFormat);
+    if (((UINTN)NextVariable <= (UINTN)Variable) || ((UINTN)NextVariable > (UINTN)EndPtr)) {
+      Index->Unusable = TRUE;
+      return FALSE;
+    }
+
+    if (VariableIndexGetNameLength (
+          GetVariableNamePtr (Variable, Index->AuthFormat),
+          NameSizeOfVariable (Variable, Index->AuthFormat),
+          EndPtr,
+          &Length
+          ))
+    {
+      if (Index->EntryCount == Index->EntryCapacity) {
+        Index->Unusable = TRUE;
+        return FALSE;
+      }
+
+      VariableIndexAddEntry (
+        Index,
+        (UINT32)((UINTN)Variable - (UINTN)StartPtr),
+        VariableIndexHash (
+          GetVendorGuidPtr (Variable, Index->AuthFormat),
+          GetVariableNamePtr (Variable, Index->AuthFormat),
+          Length
+          )
+        );
+    } else if ((Variable->State == VAR_ADDED) || (Variable->State == (VAR_IN_DELETED_TRANSITION & VAR_ADDED))) {
+      //
+      // The walk of the store may select this variable for a name of another hash.
+      //
+      Index->Unusable = TRUE;
+      return FALSE;
+    } else if ((Variable->State & (VAR_IN_DELETED_TRANSITION & VAR_ADDED)) == (VAR_IN_DELETED_TRANSITION & VAR_ADDED)) {
+      //
+      // The variable is still being written, so its name may not be complete yet.
+      //
+      return FALSE;
+    }
+
+    //
+    // The variable is indexed, or is in a state a lookup never selects. The state
+    // of a variable only ever clears bits, so it never becomes visible again.
+    //
+    Index->IndexedEnd = (UINT32)((UINTN)NextVariable - (UINTN)StartPtr);
+  }
+
+  return TRUE;
+}
+
+/**
+  Create the index of a variable store. The index is built from the variables
+  of the store on its first lookup, and then picks up the variables appended
+  to the store incrementally.
+
+  @param[in] Store       The variable store to index.
+  @param[in] AuthFormat  TRUE indicates authenticated variables are used.
+                         FALSE indicates authenticated variables are not used.
+
+  @retval EFI_SUCCESS           The index of the store was created.
+  @retval EFI_UNSUPPORTED       The variable index is disabled.
+  @retval EFI_OUT_OF_RESOURCES  No more variable store can be indexed, or there
+                                is not enough memory for the index.
+
+**/
+EFI_STATUS
+VariableIndexRegister (
+  IN VARIABLE_STORE_HEADER  *Store,
+  IN BOOLEAN                AuthFormat
+  )
+{
+  VARIABLE_STORE_INDEX  *StoreIndex;
+  UINTN                 Index;
+  UINTN                 Capacity;
+
+  if (!FeaturePcdGet (PcdEnableVariableIndex)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  ASSERT (Store->Size >= sizeof (VARIABLE_STORE_HEADER));
+
+  for (Index = 0; Index < VARIABLE_INDEX_MAX_STORES; Index++) {
+    if (mVariableStoreIndex[Index] == NULL) {
+      break;
+    }
+  }
+
+  if (Index == VARIABLE_INDEX_MAX_STORES) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // The smallest variable that can be indexed has a name of one character.
+  //
+  Capacity = (Store->Size - sizeof (VARIABLE_STORE_HEADER)) /
+             HEADER_ALIGN (GetVariableHeaderSize (AuthFormat) + sizeof (CHAR16) + GET_PAD_SIZE (sizeof (CHAR16))) + 1;
+
+  StoreIndex = AllocateRuntimeZeroPool (OFFSET_OF (VARIABLE_STORE_INDEX, Entry) + Capacity * sizeof (VARIABLE_INDEX_ENTRY));
+  if (StoreIndex == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  StoreIndex->Store          = Store;
+  StoreIndex->AuthFormat     = AuthFormat;
+  StoreIndex->EntryCapacity  = (UINT32)Capacity;
+  mVariableStoreIndex[Index] = StoreIndex;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Remove the index of a variable store before the store is freed.
+
+  @param[in] Store  The indexed variable store.
+
+**/
+VOID
+VariableIndexUnregister (
+  IN VARIABLE_STORE_HEADER  *Store
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < VARIABLE_INDEX_MAX_STORES; Index++) {
+    if ((mVariableStoreIndex[Index] != NULL) && (mVariableStoreIndex[Index]->Store == Store)) {
+      if (!AtRuntime ()) {
+        FreePool (mVariableStoreIndex[Index]);
+      }
+
+      mVariableStoreIndex[Index] = NULL;
+    }
+  }
+}
+
+/**
+  Discard the index of a variable store after the variables of the store have
+  been rewritten in place, e.g. by Reclaim (). The index is built again on its
+  next lookup.
+
+  @param[in] Store  The variable store, or NULL to discard all indexes.
+
+**/
+VOID
+VariableIndexInvalidate (
+  IN VARIABLE_STORE_HEADER  *Store OPTIONAL
+  )
+{
+  VARIABLE_STORE_INDEX  *StoreIndex;
+  UINTN                 Index;
+
+  for (Index = 0; Index < VARIABLE_INDEX_MAX_STORES; Index++) {
+    StoreIndex = mVariableStoreIndex[Index];
+    if ((StoreIndex != NULL) && ((Store == NULL) || (StoreIndex->Store == Store))) {
+      StoreIndex->Unusable   = FALSE;
+      StoreIndex->IndexedEnd = 0;
+      StoreIndex->EntryCount = 0;
+      ZeroMem (StoreIndex->Head, sizeof (StoreIndex->Head));
+      ZeroMem (StoreIndex->Tail, sizeof (StoreIndex->Tail));
+    }
+  }
+}
+
+/**
+  Fill the empty index of a variable store from the index of the same store
+  the PEI variable driver built in the EDKII_PEI_VARIABLE_INDEX HOB, so that
+  the variables PEI indexed are not hashed again.
+
+  The PEI variable index hashes the variables of the store the same way and
+  follows the same rules as this index, so the entries it holds are exactly
+  the ones VariableIndexCatchUp () would add up to its IndexedEnd. The
+  variables after IndexedEnd are added by the next lookup.
+
+  @param[in] Store          The variable store, whose variables must not have
+                            been written since the PEI variable index was built.
+  @param[in] StoreBase      The address of the variable store the PEI variable
+                            index must have been built for.
+  @param[in] PeiIndex       The PEI variable index.
+  @param[in] PeiIndexSize   The size in bytes of the PEI variable index.
+
+  @retval EFI_SUCCESS       The index of the store was filled from the PEI variable index.
+  @retval EFI_UNSUPPORTED   The store is not indexed, or its index is not empty.
+  @retval EFI_NOT_FOUND     The PEI variable index does not describe the store.
+
+**/
+EFI_STATUS
+VariableIndexImportPeiIndex (
+  IN VARIABLE_STORE_HEADER           *Store,
+  IN EFI_PHYSICAL_ADDRESS            StoreBase,
+  IN CONST EDKII_PEI_VARIABLE_INDEX  *PeiIndex,
+  IN UINTN                           PeiIndexSize
+  )
+{
+  VARIABLE_STORE_INDEX  *StoreIndex;
+  VARIABLE_HEADER       *StartPtr;
+  VARIABLE_HEADER       *EndPtr;
+  UINT32                Offset;
+  UINTN                 Index;
+
+  StartPtr   = GetStartPointer (Store);
+  EndPtr     = GetEndPointer (Store);
+  StoreIndex = VariableIndexGet (StartPtr);
+  if ((StoreIndex == NULL) || (StoreIndex->IndexedEnd != 0) || (StoreIndex->EntryCount != 0) || StoreIndex->Unusable) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if ((PeiIndexSize < OFFSET_OF (EDKII_PEI_VARIABLE_INDEX, Entry)) ||
+      (PeiIndex->StoreBase != StoreBase) ||
+      (PeiIndex->StoreSize != Store->Size) ||
+      (PeiIndex->AuthFormat != StoreIndex->AuthFormat) ||
+      PeiIndex->Unusable ||
+      (PeiIndex->EntryCount > StoreIndex->EntryCapacity) ||
+      (PeiIndex->EntryCount > (PeiIndexSize - OFFSET_OF (EDKII_PEI_VARIABLE_INDEX, Entry)) / sizeof (PEI_VARIABLE_INDEX_ENTRY)) ||
+      (PeiIndex->IndexedEnd > (UINTN)EndPtr - (UINTN)StartPtr))
+  {
+    return EFI_NOT_FOUND;
+  }
+
+  for (Index = 0; Index < PeiIndex->EntryCount; Index++) {
+    //
+    // The entries must be in the order of the store, below IndexedEnd, and
+    // point at variable headers of this copy of the store.
+    //
+    Offset = PeiIndex->Entry[Index].Offset;
+    if (((Index > 0) && (Offset <= PeiIndex->Entry[Index - 1].Offset)) ||
+        (Offset >= PeiIndex->IndexedEnd) ||
+        !IsValidVariableHeader ((VARIABLE_HEADER *)((UINTN)StartPtr + Offset), EndPtr))
+    {
+      VariableIndexInvalidate (Store);
+      return EFI_NOT_FOUND;
+    }
+
+    VariableIndexAddEntry (StoreIndex, Offset, PeiIndex->Entry[Index].Hash);
+  }
+
+  StoreIndex->IndexedEnd = PeiIndex->IndexedEnd;
+  return EFI_SUCCESS;
+}
+
+/**
+  Find a variable through the index of the variable store it is searched in.
+
+  The variable found, and the InDeletedTransitionPtr returned with it, are the
+  ones the walk of the store in FindVariableEx () finds.
+
+  @param[in]       VariableName        Name of the variable to be found. Must not be empty.
+  @param[in]       VendorGuid          Vendor GUID to be found.
+  @param[in]       IgnoreRtCheck       Ignore EFI_VARIABLE_RUNTIME_ACCESS attribute
+                                       check at runtime when searching variable.
+  @param[in, out]  PtrTrack            Variable Track Pointer structure that contains Variable Information.
+  @param[in]       AuthFormat          TRUE indicates authenticated variables are used.
+                                       FALSE indicates authenticated variables are not used.
+
+  @retval EFI_SUCCESS                  Variable found successfully.
+  @retval EFI_NOT_FOUND                Variable not found.
+  @retval EFI_UNSUPPORTED              The store is not indexed, or the index cannot be
+                                       used for it. The caller must walk the store.
+
+**/
+EFI_STATUS
+VariableIndexFind (
+  IN     CHAR16                  *VariableName,
+  IN     EFI_GUID                *VendorGuid,
+  IN     BOOLEAN                 IgnoreRtCheck,
+  IN OUT VARIABLE_POINTER_TRACK  *PtrTrack,
+  IN     BOOLEAN                 AuthFormat
+  )
+{
+  VARIABLE_STORE_INDEX  *StoreIndex;
+  VARIABLE_HEADER       *Variable;
+  VARIABLE_HEADER       *InDeletedVariable;
+  UINTN                 Length;
+  UINT32                EntryNumber;
+
+  ASSERT (VariableName[0] != 0);
+
+  StoreIndex = VariableIndexGet (PtrTrack->StartPtr);
+  if ((StoreIndex == NULL) || (StoreIndex->AuthFormat != AuthFormat) || StoreIndex->Unusable ||
+      (PtrTrack->EndPtr != GetEndPointer (StoreIndex->Store)))
+  {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (!VariableIndexCatchUp (StoreIndex)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  for (Length = 0; VariableName[Length] != L'\0'; Length++) {
+  }
+
+  PtrTrack->InDeletedTransitionPtr = NULL;
+  InDeletedVariable                = NULL;
+
+  for ( EntryNumber = StoreIndex->Head[VariableIndexHash (VendorGuid, VariableName, Length) & (VARIABLE_INDEX_BUCKET_COUNT - 1)]
+        ; EntryNumber != 0
+        ; EntryNumber = StoreIndex->Entry[EntryNumber - 1].Next
+        )
+  {
+    Variable = (VARIABLE_HEADER *)((UINTN)PtrTrack->StartPtr + StoreIndex->Entry[EntryNumber - 1].Offset);
+    if ((Variable->State != VAR_ADDED) && (Variable->State != (VAR_IN_DELETED_TRANSITION & VAR_ADDED))) {
+      continue;
+    }
+
+    if (!IgnoreRtCheck && AtRuntime () && ((Variable->Attributes & EFI_VARIABLE_RUNTIME_ACCESS) == 0)) {
+      continue;
+    }
+
+    if ((NameSizeOfVariable (Variable, AuthFormat) != (Length + 1) * sizeof (CHAR16)) ||
+        !CompareGuid (VendorGuid, GetVendorGuidPtr (Variable, AuthFormat)) ||
+        (CompareMem (VariableName, GetVariableNamePtr (Variable, AuthFormat), (Length + 1) * sizeof (CHAR16)) != 0))
+    {
+      continue;
+    }
+
+    if (Variable->State == (VAR_IN_DELETED_TRANSITION & VAR_ADDED)) {
+      InDeletedVariable = Variable;
+    } else {
+      PtrTrack->CurrPtr                = Variable;
+      PtrTrack->InDeletedTransitionPtr = InDeletedVariable;
+      return EFI_SUCCESS;
+    }
+  }
+
+  PtrTrack->CurrPtr = InDeletedVariable;
+  return (PtrTrack->CurrPtr == NULL) ? EFI_NOT_FOUND : EFI_SUCCESS;
+}
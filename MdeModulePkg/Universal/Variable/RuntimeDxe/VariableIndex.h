@@ -0,0 +1,170 @@
+/** @file
+  Hashed name and GUID index of the variable stores.
+
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _VARIABLE_INDEX_H_
+#define _VARIABLE_INDEX_H_
+
+#include "Variable.h"
+
+#include <Guid/PeiVariableIndex.h>
+
+#include "../VariableIndexHash.h"
+
+//
+// Number of hash buckets of a variable store index. Must be a power of 2.
+//
+#define VARIABLE_INDEX_BUCKET_COUNT  512
+
+//
+// Number of variable stores that can be indexed at the same time.
+//
+#define VARIABLE_INDEX_MAX_STORES  VariableStoreTypeMax
+
+typedef struct {
+  ///
+  /// Offset of the variable header from the start pointer of the store.
+  ///
+  UINT32    Offset;
+  ///
+  /// Number of the next entry of the same bucket plus 1, or 0 at the end of the chain.
+  ///
+  UINT32    Next;
+} VARIABLE_INDEX_ENTRY;
+
+typedef struct {
+  ///
+  /// The indexed variable store.
+  ///
+  VARIABLE_STORE_HEADER    *Store;
+  BOOLEAN                  AuthFormat;
+  ///
+  /// TRUE if the store holds a visible variable whose name the index cannot
+  /// hash. Lookups then walk the store until the index is rebuilt.
+  ///
+  BOOLEAN                  Unusable;
+  ///
+  /// Offset from the start pointer of the store of the first variable header
+  /// that is not in the index yet.
+  ///
+  UINT32                   IndexedEnd;
+  UINT32                   EntryCount;
+  UINT32                   EntryCapacity;
+  ///
+  /// First and last entry of each bucket plus 1, or 0 if the bucket is empty.
+  /// The entries of a bucket are chained in the order of the store.
+  ///
+  UINT32                   Head[VARIABLE_INDEX_BUCKET_COUNT];
+  UINT32                   Tail[VARIABLE_INDEX_BUCKET_COUNT];
+  VARIABLE_INDEX_ENTRY     Entry[1];
+} VARIABLE_STORE_INDEX;
+
+///
+/// The registered variable store indexes. The pointers in it and the Store
+/// pointers of the indexes must be converted at virtual address change.
+///
+extern VARIABLE_STORE_INDEX  *mVariableStoreIndex[VARIABLE_INDEX_MAX_STORES];
+
+/**
+  Create the index of a variable store. The index is built from the variables
+  of the store on its first lookup, and then picks up the variables appended
+  to the store incrementally.
+
+  @param[in] Store       The variable store to index.
+  @param[in] AuthFormat  TRUE indicates authenticated variables are used.
+                         FALSE indicates authenticated variables are not used.
+
+  @retval EFI_SUCCESS           The index of the store was created.
+  @retval EFI_UNSUPPORTED       The variable index is disabled.
+  @retval EFI_OUT_OF_RESOURCES  No more variable store can be indexed, or there
+                                is not enough memory for the index.
+
+**/
+EFI_STATUS
+VariableIndexRegister (
+  IN VARIABLE_STORE_HEADER  *Store,
+  IN BOOLEAN                AuthFormat
+  );
+
+/**
+  Remove the index of a variable store before the store is freed.
+
+  @param[in] Store  The indexed variable store.
+
+**/
+VOID
+VariableIndexUnregister (
+  IN VARIABLE_STORE_HEADER  *Store
+  );
+
+/**
+  Discard the index of a variable store after the variables of the store have
+  been rewritten in place, e.g. by Reclaim (). The index is built again on its
+  next lookup.
+
+  @param[in] Store  The variable store, or NULL to discard all indexes.
+
+**/
+VOID
+VariableIndexInvalidate (
+  IN VARIABLE_STORE_HEADER  *Store OPTIONAL
+  );
+
+/**
+  Fill the empty index of a variable store from the index of the same store
+  the PEI variable driver built in the EDKII_PEI_VARIABLE_INDEX HOB, so that
+  the variables PEI indexed are not hashed again.
+
+  @param[in] Store          The variable store, whose variables must not have
+                            been written since the PEI variable index was built.
+  @param[in] StoreBase      The address of the variable store the PEI variable
+                            index must have been built for.
+  @param[in] PeiIndex       The PEI variable index.
+  @param[in] PeiIndexSize   The size in bytes of the PEI variable index.
+
+  @retval EFI_SUCCESS       The index of the store was filled from the PEI variable index.
+  @retval EFI_UNSUPPORTED   The store is not indexed, or its index is not empty.
+  @retval EFI_NOT_FOUND     The PEI variable index does not describe the store.
+
+**/
+EFI_STATUS
+VariableIndexImportPeiIndex (
+  IN VARIABLE_STORE_HEADER           *Store,
+  IN EFI_PHYSICAL_ADDRESS            StoreBase,
+  IN CONST EDKII_PEI_VARIABLE_INDEX  *PeiIndex,
+  IN UINTN                           PeiIndexSize
+  );
+
+/**
+  Find a variable through the index of the variable store it is searched in.
+
+  The variable found, and the InDeletedTransitionPtr returned with it, are the
+  ones the walk of the store in FindVariableEx () finds.
+
+  @param[in]       VariableName        Name of the variable to be found. Must not be empty.
+  @param[in]       VendorGuid          Vendor GUID to be found.
+  @param[in]       IgnoreRtCheck       Ignore EFI_VARIABLE_RUNTIME_ACCESS attribute
+                                       check at runtime when searching variable.
+  @param[in, out]  PtrTrack            Variable Track Pointer structure that contains Variable Information.
+  @param[in]       AuthFormat          TRUE indicates authenticated variables are used.
+                                       FALSE indicates authenticated variables are not used.
+
+  @retval EFI_SUCCESS                  Variable found successfully.
+  @retval EFI_NOT_FOUND                Variable not found.
+  @retval EFI_UNSUPPORTED              The store is not indexed, or the index cannot be
+                                       used for it. The caller must walk the store.
+
+**/
+EFI_STATUS
+VariableIndexFind (
+  IN     CHAR16                  *VariableName,
+  IN     EFI_GUID                *VendorGuid,
+  IN     BOOLEAN                 IgnoreRtCheck,
+  IN OUT VARIABLE_POINTER_TRACK  *PtrTrack,
+  IN     BOOLEAN                 AuthFormat
+  );
+
+#endif
@@ -8,6 +8,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 **/
 
 #include "VariableParsing.h"
+#include "VariableIndex.h"
 
 /**
 
@@ -468,9 +469,17 @@ FindVariableEx (
   IN     BOOLEAN                 AuthFormat
   )
 {
+  EFI_STATUS       Status;
   VARIABLE_HEADER  *InDeletedVariable;
   VOID             *Point;
 
+  if (FeaturePcdGet (PcdEnableVariableIndex) && (VariableName[0] != 0)) {
+    Status = VariableIndexFind (VariableName, VendorGuid, IgnoreRtCheck, PtrTrack, AuthFormat);
+    if (Status != EFI_UNSUPPORTED) {
+      return Status;
+    }
+  }
+
   PtrTrack->InDeletedTransitionPtr = NULL;
 
   //
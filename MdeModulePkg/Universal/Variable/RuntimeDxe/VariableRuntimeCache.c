@@ -18,6 +18,123 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 extern VARIABLE_MODULE_GLOBAL  *mVariableModuleGlobal;
 extern VARIABLE_STORE_HEADER   *mNvVariableCache;
 
+/**
+  Adds a range of a variable store to the ranges pending to be copied to its
+  runtime cache.
+
+  Overlapping and adjacent ranges are coalesced, so that each changed byte is
+  copied once. When the range does not fit in the pending ranges, the two ranges
+  with the smallest gap in between are merged.
+
+  @param[in, out] VariableRuntimeCache  Variable runtime cache structure for the runtime cache being updated.
+  @param[in]      Offset                Offset in bytes of the range.
+  @param[in]      Length                Length in bytes of the range.
+
+**/
+STATIC
+VOID
+AddPendingRuntimeCacheRange (
+  IN OUT VARIABLE_RUNTIME_CACHE  *VariableRuntimeCache,
+  IN     UINTN                   Offset,
+  IN     UINTN                   Length
+  )
+{
+  VARIABLE_RUNTIME_CACHE_RANGE  *Range;
+  VARIABLE_RUNTIME_CACHE_RANGE  Ranges[VARIABLE_RUNTIME_CACHE_PENDING_RANGES + 1];
+  UINTN                         Count;
+  UINTN                         End;
+  UINTN                         First;
+  UINTN                         Last;
+  UINTN                         Index;
+  UINTN                         Closest;
+
+  Range = VariableRuntimeCache->PendingRange;
+  Count = VariableRuntimeCache->PendingRangeCount;
+  End   = Offset + Length;
+
+  //
+  // The pending ranges are sorted and disjoint. Find the ones from First to Last
+  // that overlap or touch the new range.
+  //
+  for (First = 0; (First < Count) && (Range[First].Offset + Range[First].Length < Offset); First++) {
+  }
+
+  for (Last = First; (Last < Count) && (Range[Last].Offset <= End); Last++) {
+    Offset = MIN (Offset, Range[Last].Offset);
+    End    = MAX (End, Range[Last].Offset + Range[Last].Length);
+  }
+
+  if (Last > First) {
+    Range[First].Offset = (UINT32)Offset;
+    Range[First].Length = (UINT32)(End - Offset);
+    CopyMem (&Range[First + 1], &Range[Last], (Count - Last) * sizeof (*Range));
+    VariableRuntimeCache->PendingRangeCount = Count - (Last - First - 1);
+    return;
+  }
+
+  CopyMem (Ranges, Range, First * sizeof (*Range));
+  Ranges[First].Offset = (UINT32)Offset;
+  Ranges[First].Length = (UINT32)Length;
+  CopyMem (&Ranges[First + 1], &Range[First], (Count - First) * sizeof (*Range));
+  Count++;
+
+  if (Count > VARIABLE_RUNTIME_CACHE_PENDING_RANGES) {
+    Closest = 0;
+    for (Index = 1; Index < Count - 1; Index++) {
+      if (Ranges[Index + 1].Offset - (Ranges[Index].Offset + Ranges[Index].Length) <
+          Ranges[Closest + 1].Offset - (Ranges[Closest].Offset + Ranges[Closest].Length))
+      {
+        Closest = Index;
+      }
+    }
+
+    Ranges[Closest].Length = Ranges[Closest + 1].Offset + Ranges[Closest + 1].Length - Ranges[Closest].Offset;
+    CopyMem (&Ranges[Closest + 1], &Ranges[Closest + 2], (Count - Closest - 2) * sizeof (*Range));
+    Count--;
+  }
+
+  CopyMem (Range, Ranges, Count * sizeof (*Range));
+  VariableRuntimeCache->PendingRangeCount = Count;
+}
+
+/**
+  Copies the pending ranges of a variable store to its runtime cache, and lets the
+  runtime cache reader know if the store was rewritten in place.
+
+  @param[in, out] VariableRuntimeCache  Variable runtime cache structure for the runtime cache being updated.
+  @param[in]      VariableStore         The variable store the runtime cache is a copy of.
+
+**/
+STATIC
+VOID
+FlushPendingRuntimeCacheRanges (
+  IN OUT VARIABLE_RUNTIME_CACHE  *VariableRuntimeCache,
+  IN     VARIABLE_STORE_HEADER   *VariableStore
+  )
+{
+  VARIABLE_RUNTIME_CACHE_RANGE  *Range;
+  UINTN                         Index;
+
+  if (VariableRuntimeCache->PendingRewrite) {
+    VariableRuntimeCache->PendingRewrite = FALSE;
+    if (mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.RewriteCount != NULL) {
+      (*(mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.RewriteCount))++;
+    }
+  }
+
+  for (Index = 0; Index < VariableRuntimeCache->PendingRangeCount; Index++) {
+    Range = &VariableRuntimeCache->PendingRange[Index];
+    CopyMem (
+      (UINT8 *)VariableRuntimeCache->Store + Range->Offset,
+      (UINT8 *)VariableStore + Range->Offset,
+      Range->Length
+      );
+    mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.BytesSynced += Range->Length;
+  }
+
+  VariableRuntimeCache->PendingRangeCount = 0;
+}
+
 /**
   Copies any pending updates to runtime variable caches.
 
@@ -45,65 +162,88 @@ FlushPendingRuntimeVariableCacheUpdates (
     if ((VariableRuntimeCacheContext->VariableRuntimeHobCache.Store != NULL) &&
         (mVariableModuleGlobal->VariableGlobal.HobVariableBase > 0))
     {
-      CopyMem (
-        (VOID *)(
-                 ((UINT8 *)(UINTN)VariableRuntimeCacheContext->VariableRuntimeHobCache.Store) +
-                 VariableRuntimeCacheContext->VariableRuntimeHobCache.PendingUpdateOffset
-                 ),
-        (VOID *)(
-                 ((UINT8 *)(UINTN)mVariableModuleGlobal->VariableGlobal.HobVariableBase) +
-                 VariableRuntimeCacheContext->VariableRuntimeHobCache.PendingUpdateOffset
-                 ),
-        VariableRuntimeCacheContext->VariableRuntimeHobCache.PendingUpdateLength
+      FlushPendingRuntimeCacheRanges (
+        &VariableRuntimeCacheContext->VariableRuntimeHobCache,
+        (VARIABLE_STORE_HEADER *)(UINTN)mVariableModuleGlobal->VariableGlobal.HobVariableBase
         );
-      VariableRuntimeCacheContext->VariableRuntimeHobCache.PendingUpdateLength = 0;
-      VariableRuntimeCacheContext->VariableRuntimeHobCache.PendingUpdateOffset = 0;
     }
 
-    CopyMem (
-      (VOID *)(
-               ((UINT8 *)(UINTN)VariableRuntimeCacheContext->VariableRuntimeNvCache.Store) +
-               VariableRuntimeCacheContext->VariableRuntimeNvCache.PendingUpdateOffset
-               ),
-      (VOID *)(
-               ((UINT8 *)(UINTN)mNvVariableCache) +
-               VariableRuntimeCacheContext->VariableRuntimeNvCache.PendingUpdateOffset
-               ),
-      VariableRuntimeCacheContext->VariableRuntimeNvCache.PendingUpdateLength
-      );
-    VariableRuntimeCacheContext->VariableRuntimeNvCache.PendingUpdateLength = 0;
-    VariableRuntimeCacheContext->VariableRuntimeNvCache.PendingUpdateOffset = 0;
+    VariableRuntimeCacheContext->VariableRuntimeHobCache.PendingRangeCount = 0;
+    VariableRuntimeCacheContext->VariableRuntimeHobCache.PendingRewrite    = FALSE;
 
-    CopyMem (
-      (VOID *)(
-               ((UINT8 *)(UINTN)VariableRuntimeCacheContext->VariableRuntimeVolatileCache.Store) +
-               VariableRuntimeCacheContext->VariableRuntimeVolatileCache.PendingUpdateOffset
-               ),
-      (VOID *)(
-               ((UINT8 *)(UINTN)mVariableModuleGlobal->VariableGlobal.VolatileVariableBase) +
-               VariableRuntimeCacheContext->VariableRuntimeVolatileCache.PendingUpdateOffset
-               ),
-      VariableRuntimeCacheContext->VariableRuntimeVolatileCache.PendingUpdateLength
+    FlushPendingRuntimeCacheRanges (
+      &VariableRuntimeCacheContext->VariableRuntimeNvCache,
+      mNvVariableCache
       );
-    VariableRuntimeCacheContext->VariableRuntimeVolatileCache.PendingUpdateLength = 0;
-    VariableRuntimeCacheContext->VariableRuntimeVolatileCache.PendingUpdateOffset = 0;
-    *(VariableRuntimeCacheContext->PendingUpdate)                                 = FALSE;
+    FlushPendingRuntimeCacheRanges (
+      &VariableRuntimeCacheContext->VariableRuntimeVolatileCache,
+      (VARIABLE_STORE_HEADER *)(UINTN)mVariableModuleGlobal->VariableGlobal.VolatileVariableBase
+      );
+    *(VariableRuntimeCacheContext->PendingUpdate) = FALSE;
   }
 
   return EFI_SUCCESS;
 }
 
+/**
+  Records an update of a variable store, to be copied to its runtime cache by the
+  next flush of the pending updates.
+
+  @param[in] VariableRuntimeCache Variable runtime cache structure for the runtime cache to update.
+  @param[in] Offset               Offset in bytes of the update.
+  @param[in] Length               Length of data in bytes of the update.
+
+**/
+VOID
+RecordRuntimeVariableCacheUpdate (
+  IN  VARIABLE_RUNTIME_CACHE  *VariableRuntimeCache,
+  IN  UINTN                   Offset,
+  IN  UINTN                   Length
+  )
+{
+  VARIABLE_RUNTIME_CACHE_CONTEXT  *VariableRuntimeCacheContext;
+
+  VariableRuntimeCacheContext = &mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext;
+  if ((VariableRuntimeCache->Store == NULL) || (VariableRuntimeCacheContext->PendingUpdate == NULL) || (Length == 0)) {
+    return;
+  }
+
+  AddPendingRuntimeCacheRange (VariableRuntimeCache, Offset, Length);
+  VariableRuntimeCacheContext->BytesChanged    += Length;
+  *(VariableRuntimeCacheContext->PendingUpdate) = TRUE;
+}
+
+/**
+  Records that a variable store was rewritten in place, e.g. by Reclaim (), rather
+  than only appended to. The next flush of the pending updates lets the runtime
+  cache reader know, so that it builds the index of the runtime cache again.
+
+  @param[in] VariableRuntimeCache Variable runtime cache structure for the runtime cache of the store.
+
+**/
+VOID
+RecordRuntimeVariableCacheRewrite (
+  IN  VARIABLE_RUNTIME_CACHE  *VariableRuntimeCache
+  )
+{
+  if (VariableRuntimeCache->Store != NULL) {
+    VariableRuntimeCache->PendingRewrite = TRUE;
+  }
+}
+
 /**
   Synchronizes the runtime variable caches with all pending updates outside runtime.
 
   Ensures all conditions are met to maintain coherency for runtime cache updates. This function will attempt
   to write the given update (and any other pending updates) if the ReadLock is available. Otherwise, the
   update is added as a pending update for the given variable store and it will be flushed to the runtime cache
-  at the next opportunity the ReadLock is available.
+  at the next opportunity the ReadLock is available. Only the ranges of the variable stores recorded as
+  updated are copied.
 
   @param[in] VariableRuntimeCache Variable runtime cache structure for the runtime cache being synchronized.
   @param[in] Offset               Offset in bytes to apply the update.
-  @param[in] Length               Length of data in bytes of the update.
+  @param[in] Length               Length of data in bytes of the update. It may be 0 to only
+                                  flush the updates recorded with RecordRuntimeVariableCacheUpdate ().
 
   @retval EFI_SUCCESS             The update was added as a pending update successfully. If the variable runtime
                                   cache ReadLock was available, the runtime cache was updated successfully.
@@ -131,24 +271,7 @@ SynchronizeRuntimeVariableCache (
     return EFI_UNSUPPORTED;
   }
 
-  if (*(mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.PendingUpdate) &&
-      (VariableRuntimeCache->PendingUpdateLength > 0))
-  {
-    VariableRuntimeCache->PendingUpdateLength =
-      (UINT32)(
-               MAX (
-                 (UINTN)(VariableRuntimeCache->PendingUpdateOffset + VariableRuntimeCache->PendingUpdateLength),
-                 Offset + Length
-                 ) - MIN ((UINTN)VariableRuntimeCache->PendingUpdateOffset, Offset)
-               );
-    VariableRuntimeCache->PendingUpdateOffset =
-      (UINT32)MIN ((UINTN)VariableRuntimeCache->PendingUpdateOffset, Offset);
-  } else {
-    VariableRuntimeCache->PendingUpdateLength = (UINT32)Length;
-    VariableRuntimeCache->PendingUpdateOffset = (UINT32)Offset;
-  }
-
-  *(mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.PendingUpdate) = TRUE;
+  RecordRuntimeVariableCacheUpdate (VariableRuntimeCache, Offset, Length);
 
   if (*(mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.ReadLock) == FALSE) {
     return FlushPendingRuntimeVariableCacheUpdates ();
@@ -24,17 +24,48 @@ FlushPendingRuntimeVariableCacheUpdates (
   VOID
   );
 
+/**
+  Records an update of a variable store, to be copied to its runtime cache by the
+  next flush of the pending updates.
+
+  @param[in] VariableRuntimeCache Variable runtime cache structure for the runtime cache to update.
+  @param[in] Offset               Offset in bytes of the update.
+  @param[in] Length               Length of data in bytes of the update.
+
+**/
+VOID
+RecordRuntimeVariableCacheUpdate (
+  IN  VARIABLE_RUNTIME_CACHE  *VariableRuntimeCache,
+  IN  UINTN                   Offset,
+  IN  UINTN                   Length
+  );
+
+/**
+  Records that a variable store was rewritten in place, e.g. by Reclaim (), rather
+  than only appended to. The next flush of the pending updates lets the runtime
+  cache reader know, so that it builds the index of the runtime cache again.
+
+  @param[in] VariableRuntimeCache Variable runtime cache structure for the runtime cache of the store.
+
+**/
+VOID
+RecordRuntimeVariableCacheRewrite (
+  IN  VARIABLE_RUNTIME_CACHE  *VariableRuntimeCache
+  );
+
 /**
   Synchronizes the runtime variable caches with all pending updates outside runtime.
 
   Ensures all conditions are met to maintain coherency for runtime cache updates. This function will attempt
   to write the given update (and any other pending updates) if the ReadLock is available. Otherwise, the
   update is added as a pending update for the given variable store and it will be flushed to the runtime cache
-  at the next opportunity the ReadLock is available.
+  at the next opportunity the ReadLock is available. Only the ranges of the variable stores recorded as
+  updated are copied.
 
   @param[in] VariableRuntimeCache Variable runtime cache structure for the runtime cache being synchronized.
   @param[in] Offset               Offset in bytes to apply the update.
-  @param[in] Length               Length of data in bytes of the update.
+  @param[in] Length               Length of data in bytes of the update. It may be 0 to only
+                                  flush the updates recorded with RecordRuntimeVariableCacheUpdate ().
 
   @retval EFI_SUCCESS             The update was added as a pending update successfully. If the variable runtime
                                   cache ReadLock was available, the runtime cache was updated successfully.
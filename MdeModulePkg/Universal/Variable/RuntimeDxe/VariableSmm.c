@@ -11,7 +11,7 @@
   SmmVariableHandler() will receive untrusted input and do basic validation.
 
   Each sub function VariableServiceGetVariable(), VariableServiceGetNextVariableName(),
-  VariableServiceSetVariable(), VariableServiceQueryVariableInfo(), ReclaimForOS(),
+  VariableServiceSetVariable(), SmmSetVariableBatch(), VariableServiceQueryVariableInfo(), ReclaimForOS(),
   SmmVariableGetStatistics() should also do validation based on its own knowledge.
 
 Copyright (c) 2010 - 2019, Intel Corporation. All rights reserved.<BR>
@@ -33,6 +33,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include "Variable.h"
 #include "VariableParsing.h"
 #include "VariableRuntimeCache.h"
+#include "VariableBatch.h"
 
 extern VARIABLE_STORE_HEADER  *mNvVariableCache;
 
@@ -219,6 +220,21 @@ GetFtwProtocol (
   return Status;
 }
 
+/**
+  Check whether the Fault Tolerant Write protocol can still be used after
+  ExitBootServices ().
+
+  @retval TRUE                  The SMM Fault Tolerant Write protocol is available at runtime.
+
+**/
+BOOLEAN
+FtwAvailableAtRuntime (
+  VOID
+  )
+{
+  return TRUE;
+}
+
 /**
   Retrieve the SMM FVB protocol interface by HANDLE.
 
@@ -424,6 +440,78 @@ SmmVariableGetStatistics (
   return EFI_SUCCESS;
 }
 
+/**
+  Set the batch of variables of a SetVariable batch request.
+
+  Caution: This function may receive untrusted input.
+  The whole batch is validated before any of its variables is set.
+
+  @param[in, out] Batch         The SetVariable batch request, copied in SMRAM. On
+                                return, the Status of each entry is updated.
+  @param[in]      BatchSize     The size of the SetVariable batch request.
+
+  @retval EFI_SUCCESS           The batch was processed, with the result of each
+                                variable returned in its entry.
+  @retval EFI_ACCESS_DENIED     The batch request is malformed. No variable was set.
+  @retval EFI_OUT_OF_RESOURCES  There is not enough memory to process the batch. No
+                                variable was set.
+
+**/
+STATIC
+EFI_STATUS
+SmmSetVariableBatch (
+  IN OUT SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH  *Batch,
+  IN     UINTN                                        BatchSize
+  )
+{
+  SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY  *Entry;
+  UINTN                                              Index;
+  UINTN                                              Offset;
+  UINTN                                              EntrySize;
+
+  Offset = sizeof (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH);
+  for (Index = 0; Index < Batch->Count; Index++) {
+    if ((Offset > BatchSize) ||
+        (BatchSize - Offset < OFFSET_OF (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY, Variable.Name)))
+    {
+      DEBUG ((DEBUG_ERROR, "SetVariableBatch: Entry exceeds communication buffer size limit!\n"));
+      return EFI_ACCESS_DENIED;
+    }
+
+    Entry = (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY *)((UINT8 *)Batch + Offset);
+    if ((Entry->Variable.NameSize > BatchSize) || (Entry->Variable.DataSize > BatchSize)) {
+      //
+      // Prevent EntrySize overflow happen
+      //
+      return EFI_ACCESS_DENIED;
+    }
+
+    EntrySize = OFFSET_OF (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY, Variable.Name)
+                + Entry->Variable.NameSize + Entry->Variable.DataSize;
+    if (EntrySize > BatchSize - Offset) {
+      DEBUG ((DEBUG_ERROR, "SetVariableBatch: Data size exceed communication buffer size limit!\n"));
+      return EFI_ACCESS_DENIED;
+    }
+
+    //
+    // The VariableSpeculationBarrier() call here is to ensure the previous
+    // range/content checks for the CommBuffer have been completed before the
+    // subsequent consumption of the CommBuffer content.
+    //
+    VariableSpeculationBarrier ();
+    if ((Entry->Variable.NameSize < sizeof (CHAR16)) || (Entry->Variable.Name[Entry->Variable.NameSize/sizeof (CHAR16) - 1] != L'\0')) {
+      //
+      // Make sure VariableName is A Null-terminated string.
+      //
+      return EFI_ACCESS_DENIED;
+    }
+
+    Offset = ALIGN_VALUE (Offset + EntrySize, sizeof (UINTN));
+  }
+
+  return VariableSetVariableBatch (Batch);
+}
+
 /**
   Communication service SMI Handler entry.
 
@@ -467,6 +555,7 @@ SmmVariableHandler (
   SMM_VARIABLE_COMMUNICATE_GET_PAYLOAD_SIZE                *GetPayloadSize;
   SMM_VARIABLE_COMMUNICATE_RUNTIME_VARIABLE_CACHE_CONTEXT  *RuntimeVariableCacheContext;
   SMM_VARIABLE_COMMUNICATE_GET_RUNTIME_CACHE_INFO          *GetRuntimeCacheInfo;
+  SMM_VARIABLE_COMMUNICATE_GET_RUNTIME_CACHE_STATISTICS    *GetRuntimeCacheStatistics;
   SMM_VARIABLE_COMMUNICATE_LOCK_VARIABLE                   *VariableToLock;
   SMM_VARIABLE_COMMUNICATE_VAR_CHECK_VARIABLE_PROPERTY     *CommVariableProperty;
   VARIABLE_INFO_ENTRY                                      *VariableInfo;
@@ -665,6 +754,27 @@ SmmVariableHandler (
                  );
       break;
 
+    case SMM_VARIABLE_FUNCTION_SET_VARIABLE_BATCH:
+      if (CommBufferPayloadSize < sizeof (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH)) {
+        DEBUG ((DEBUG_ERROR, "SetVariableBatch: SMM communication buffer size invalid!\n"));
+        return EFI_SUCCESS;
+      }
+
+      //
+      // Copy the input communicate buffer payload to pre-allocated SMM variable buffer payload.
+      //
+      CopyMem (mVariableBufferPayload, SmmVariableFunctionHeader->Data, CommBufferPayloadSize);
+      Status = SmmSetVariableBatch (
+                 (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH *)mVariableBufferPayload,
+                 CommBufferPayloadSize
+                 );
+
+      //
+      // Return the status of each variable.
+      //
+      CopyMem (SmmVariableFunctionHeader->Data, mVariableBufferPayload, CommBufferPayloadSize);
+      break;
+
     case SMM_VARIABLE_FUNCTION_QUERY_VARIABLE_INFO:
       if (CommBufferPayloadSize < sizeof (SMM_VARIABLE_COMMUNICATE_QUERY_VARIABLE_INFO)) {
         DEBUG ((DEBUG_ERROR, "QueryVariableInfo: SMM communication buffer size invalid!\n"));
@@ -924,6 +1034,17 @@ SmmVariableHandler (
         goto EXIT;
       }
 
+      if ((RuntimeVariableCacheContext->RewriteCount != NULL) &&
+          !VariableSmmIsBufferOutsideSmmValid (
+             (UINTN)RuntimeVariableCacheContext->RewriteCount,
+             sizeof (*(RuntimeVariableCacheContext->RewriteCount))
+             ))
+      {
+        DEBUG ((DEBUG_ERROR, "InitRuntimeVariableCacheContext: Runtime cache rewrite count buffer in SMRAM or overflow!\n"));
+        Status = EFI_ACCESS_DENIED;
+        goto EXIT;
+      }
+
       VariableCacheContext                                     = &mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext;
       VariableCacheContext->VariableRuntimeHobCache.Store      = RuntimeVariableCacheContext->RuntimeHobCache;
       VariableCacheContext->VariableRuntimeVolatileCache.Store = RuntimeVariableCacheContext->RuntimeVolatileCache;
@@ -931,26 +1052,40 @@ SmmVariableHandler (
       VariableCacheContext->PendingUpdate                      = RuntimeVariableCacheContext->PendingUpdate;
       VariableCacheContext->ReadLock                           = RuntimeVariableCacheContext->ReadLock;
       VariableCacheContext->HobFlushComplete                   = RuntimeVariableCacheContext->HobFlushComplete;
+      VariableCacheContext->RewriteCount                       = RuntimeVariableCacheContext->RewriteCount;
 
       // Set up the intial pending request since the RT cache needs to be in sync with SMM cache
-      VariableCacheContext->VariableRuntimeHobCache.PendingUpdateOffset = 0;
-      VariableCacheContext->VariableRuntimeHobCache.PendingUpdateLength = 0;
+      VariableCacheContext->VariableRuntimeHobCache.PendingRangeCount      = 0;
+      VariableCacheContext->VariableRuntimeVolatileCache.PendingRangeCount = 0;
+      VariableCacheContext->VariableRuntimeNvCache.PendingRangeCount       = 0;
+      RecordRuntimeVariableCacheRewrite (&VariableCacheContext->VariableRuntimeVolatileCache);
+      RecordRuntimeVariableCacheRewrite (&VariableCacheContext->VariableRuntimeNvCache);
       if ((mVariableModuleGlobal->VariableGlobal.HobVariableBase > 0) &&
           (VariableCacheContext->VariableRuntimeHobCache.Store != NULL))
       {
-        VariableCache                                                     = (VARIABLE_STORE_HEADER *)(UINTN)mVariableModuleGlobal->VariableGlobal.HobVariableBase;
-        VariableCacheContext->VariableRuntimeHobCache.PendingUpdateLength = (UINT32)((UINTN)GetEndPointer (VariableCache) - (UINTN)VariableCache);
+        VariableCache = (VARIABLE_STORE_HEADER *)(UINTN)mVariableModuleGlobal->VariableGlobal.HobVariableBase;
+        RecordRuntimeVariableCacheUpdate (
+          &VariableCacheContext->VariableRuntimeHobCache,
+          0,
+          (UINTN)GetEndPointer (VariableCache) - (UINTN)VariableCache
+          );
         CopyGuid (&(VariableCacheContext->VariableRuntimeHobCache.Store->Signature), &(VariableCache->Signature));
       }
 
-      VariableCache                                                          = (VARIABLE_STORE_HEADER  *)(UINTN)mVariableModuleGlobal->VariableGlobal.VolatileVariableBase;
-      VariableCacheContext->VariableRuntimeVolatileCache.PendingUpdateOffset = 0;
-      VariableCacheContext->VariableRuntimeVolatileCache.PendingUpdateLength = (UINT32)((UINTN)GetEndPointer (VariableCache) - (UINTN)VariableCache);
+      VariableCache = (VARIABLE_STORE_HEADER  *)(UINTN)mVariableModuleGlobal->VariableGlobal.VolatileVariableBase;
+      RecordRuntimeVariableCacheUpdate (
+        &VariableCacheContext->VariableRuntimeVolatileCache,
+        0,
+        (UINTN)GetEndPointer (VariableCache) - (UINTN)VariableCache
+        );
       CopyGuid (&(VariableCacheContext->VariableRuntimeVolatileCache.Store->Signature), &(VariableCache->Signature));
 
-      VariableCache                                                    = (VARIABLE_STORE_HEADER  *)(UINTN)mNvVariableCache;
-      VariableCacheContext->VariableRuntimeNvCache.PendingUpdateOffset = 0;
-      VariableCacheContext->VariableRuntimeNvCache.PendingUpdateLength = (UINT32)((UINTN)GetEndPointer (VariableCache) - (UINTN)VariableCache);
+      VariableCache = (VARIABLE_STORE_HEADER  *)(UINTN)mNvVariableCache;
+      RecordRuntimeVariableCacheUpdate (
+        &VariableCacheContext->VariableRuntimeNvCache,
+        0,
+        (UINTN)GetEndPointer (VariableCache) - (UINTN)VariableCache
+        );
       CopyGuid (&(VariableCacheContext->VariableRuntimeNvCache.Store->Signature), &(VariableCache->Signature));
 
       *(VariableCacheContext->PendingUpdate)    = TRUE;
@@ -986,6 +1121,19 @@ SmmVariableHandler (
       Status = EFI_SUCCESS;
       break;
 
+    case SMM_VARIABLE_FUNCTION_GET_RUNTIME_CACHE_STATISTICS:
+      if (CommBufferPayloadSize < sizeof (SMM_VARIABLE_COMMUNICATE_GET_RUNTIME_CACHE_STATISTICS)) {
+        DEBUG ((DEBUG_ERROR, "GetRuntimeCacheStatistics: SMM communication buffer size invalid!\n"));
+        return EFI_SUCCESS;
+      }
+
+      GetRuntimeCacheStatistics               = (SMM_VARIABLE_COMMUNICATE_GET_RUNTIME_CACHE_STATISTICS *)SmmVariableFunctionHeader->Data;
+      GetRuntimeCacheStatistics->BytesChanged = mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.BytesChanged;
+      GetRuntimeCacheStatistics->BytesSynced  = mVariableModuleGlobal->VariableGlobal.VariableRuntimeCacheContext.BytesSynced;
+
+      Status = EFI_SUCCESS;
+      break;
+
     default:
       Status = EFI_UNSUPPORTED;
   }
@@ -25,6 +25,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Protocol/SmmVariable.h>
 #include <Protocol/VariableLock.h>
 #include <Protocol/VarCheck.h>
+#include <Protocol/VariableBatch.h>
 
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiRuntimeServicesTableLib.h>
@@ -42,6 +43,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 #include "PrivilegePolymorphic.h"
 #include "VariableParsing.h"
+#include "VariableIndex.h"
 
 EFI_HANDLE                      mHandle                              = NULL;
 EFI_SMM_VARIABLE_PROTOCOL       *mSmmVariable                        = NULL;
@@ -62,9 +64,12 @@ BOOLEAN                         mVariableRuntimeCachePendingUpdate;
 BOOLEAN                         mVariableRuntimeCacheReadLock;
 BOOLEAN                         mVariableAuthFormat;
 BOOLEAN                         mHobFlushComplete;
+UINT32                          mVariableRuntimeCacheRewriteCount;
+UINT32                          mVariableIndexRewriteCount;
 EFI_LOCK                        mVariableServicesLock;
 EDKII_VARIABLE_LOCK_PROTOCOL    mVariableLock;
 EDKII_VAR_CHECK_PROTOCOL        mVarCheck;
+EDKII_VARIABLE_BATCH_PROTOCOL   mVariableBatch;
 
 /**
   The logic to initialize the VariablePolicy engine is in its own file.
@@ -576,10 +581,21 @@ CheckForRuntimeCacheSync (
 
   ASSERT (!mVariableRuntimeCachePendingUpdate);
 
+  //
+  // The indexes pick up the variables SMM appended to the runtime caches on their
+  // next lookup. SMM counts the flushes that rewrote a cache in place, e.g. after
+  // a reclaim, and the indexes must then be built again.
+  //
+  if (mVariableIndexRewriteCount != mVariableRuntimeCacheRewriteCount) {
+    mVariableIndexRewriteCount = mVariableRuntimeCacheRewriteCount;
+    VariableIndexInvalidate (NULL);
+  }
+
   //
   // The HOB variable data may have finished being flushed in the runtime cache sync update
   //
   if (mHobFlushComplete && (mVariableRuntimeHobCacheBuffer != NULL)) {
+    VariableIndexUnregister (mVariableRuntimeHobCacheBuffer);
     if (!EfiAtRuntime ()) {
       FreePages (mVariableRuntimeHobCacheBuffer, EFI_SIZE_TO_PAGES (mVariableRuntimeHobCacheBufferSize));
     }
@@ -1198,6 +1214,157 @@ Done:
   return Status;
 }
 
+/**
+  Set a number of variables at once.
+
+  The variables are sent to SMM in as few SetVariable batch requests as the
+  communicate buffer allows, and each request writes its non-volatile variables
+  to the flash in one update, or one by one if they do not fit in one update.
+
+  @param[in]      This          The EDKII_VARIABLE_BATCH_PROTOCOL instance.
+  @param[in]      Count         The number of entries in Entries.
+  @param[in, out] Entries       The variables to set. On return, the Status of each
+                                entry is updated.
+
+  @retval EFI_SUCCESS           The batch was processed. The result of each entry is
+                                returned in its Status.
+  @retval EFI_INVALID_PARAMETER Entries is NULL and Count is not 0.
+  @retval Others                A request could not be sent to SMM. The Status of
+                                its entries is the error.
+
+**/
+EFI_STATUS
+EFIAPI
+VariableBatchSetVariables (
+  IN     EDKII_VARIABLE_BATCH_PROTOCOL  *This,
+  IN     UINTN                          Count,
+  IN OUT EDKII_VARIABLE_BATCH_ENTRY     *Entries
+  )
+{
+  EFI_STATUS                                         Status;
+  EFI_STATUS                                         BatchStatus;
+  SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH        *Batch;
+  SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY  *SmmEntry;
+  UINTN                                              Index;
+  UINTN                                              First;
+  UINTN                                              PayloadSize;
+  UINTN                                              EntrySize;
+  UINTN                                              MaxEntrySize;
+
+  if ((Entries == NULL) && (Count != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Check input parameters, the same way as RuntimeServiceSetVariable () does.
+  //
+  MaxEntrySize = mVariableBufferPayloadSize - sizeof (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH);
+  for (Index = 0; Index < Count; Index++) {
+    Entries[Index].Status = EFI_SUCCESS;
+    if ((Entries[Index].VariableName == NULL) || (Entries[Index].VariableName[0] == 0) || (Entries[Index].VendorGuid == NULL) ||
+        ((Entries[Index].DataSize != 0) && (Entries[Index].Data == NULL)))
+    {
+      Entries[Index].Status = EFI_INVALID_PARAMETER;
+      continue;
+    }
+
+    //
+    // If VariableName or DataSize exceeds SMM payload limit. Return failure
+    //
+    EntrySize = OFFSET_OF (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY, Variable.Name) + StrSize (Entries[Index].VariableName);
+    if ((EntrySize > MaxEntrySize) || (Entries[Index].DataSize > MaxEntrySize - EntrySize)) {
+      Entries[Index].Status = EFI_INVALID_PARAMETER;
+    }
+  }
+
+  AcquireLockOnlyAtBootTime (&mVariableServicesLock);
+
+  BatchStatus = EFI_SUCCESS;
+  Index       = 0;
+  while (Index < Count) {
+    //
+    // Pack as many of the remaining variables as the communicate buffer holds.
+    //
+    Status = InitCommunicateBuffer ((VOID **)&Batch, mVariableBufferPayloadSize, SMM_VARIABLE_FUNCTION_SET_VARIABLE_BATCH);
+    ASSERT_EFI_ERROR (Status);
+
+    Batch->Count = 0;
+    PayloadSize  = sizeof (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH);
+    for (First = Index; Index < Count; Index++) {
+      if (EFI_ERROR (Entries[Index].Status)) {
+        continue;
+      }
+
+      EntrySize = OFFSET_OF (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY, Variable.Name)
+                  + StrSize (Entries[Index].VariableName) + Entries[Index].DataSize;
+      if (ALIGN_VALUE (PayloadSize, sizeof (UINTN)) + EntrySize > mVariableBufferPayloadSize) {
+        break;
+      }
+
+      PayloadSize = ALIGN_VALUE (PayloadSize, sizeof (UINTN));
+      SmmEntry    = (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY *)((UINT8 *)Batch + PayloadSize);
+
+      SmmEntry->Status = EFI_NOT_STARTED;
+      CopyGuid (&SmmEntry->Variable.Guid, Entries[Index].VendorGuid);
+      SmmEntry->Variable.DataSize   = Entries[Index].DataSize;
+      SmmEntry->Variable.NameSize   = StrSize (Entries[Index].VariableName);
+      SmmEntry->Variable.Attributes = Entries[Index].Attributes;
+      CopyMem (SmmEntry->Variable.Name, Entries[Index].VariableName, SmmEntry->Variable.NameSize);
+      CopyMem ((UINT8 *)SmmEntry->Variable.Name + SmmEntry->Variable.NameSize, Entries[Index].Data, Entries[Index].DataSize);
+
+      PayloadSize += EntrySize;
+      Batch->Count++;
+    }
+
+    if (Batch->Count == 0) {
+      continue;
+    }
+
+    //
+    // Send data to SMM.
+    //
+    InitCommunicateBuffer (NULL, PayloadSize, SMM_VARIABLE_FUNCTION_SET_VARIABLE_BATCH);
+    Status = SendCommunicateBuffer (PayloadSize);
+    if (EFI_ERROR (Status) && !EFI_ERROR (BatchStatus)) {
+      BatchStatus = Status;
+    }
+
+    //
+    // Return the status of each variable sent, or the error of the request if
+    // it was not processed.
+    //
+    PayloadSize = sizeof (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH);
+    for ( ; First < Index; First++) {
+      if (EFI_ERROR (Entries[First].Status)) {
+        continue;
+      }
+
+      SmmEntry              = (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY *)((UINT8 *)Batch + PayloadSize);
+      Entries[First].Status = EFI_ERROR (Status) ? Status : SmmEntry->Status;
+      PayloadSize           = ALIGN_VALUE (
+                                PayloadSize + OFFSET_OF (SMM_VARIABLE_COMMUNICATE_SET_VARIABLE_BATCH_ENTRY, Variable.Name)
+                                + StrSize (Entries[First].VariableName) + Entries[First].DataSize,
+                                sizeof (UINTN)
+                                );
+    }
+  }
+
+  ReleaseLockOnlyAtBootTime (&mVariableServicesLock);
+
+  if (!EfiAtRuntime ()) {
+    for (Index = 0; Index < Count; Index++) {
+      if (!EFI_ERROR (Entries[Index].Status)) {
+        SecureBootHook (
+          Entries[Index].VariableName,
+          Entries[Index].VendorGuid
+          );
+      }
+    }
+  }
+
+  return BatchStatus;
+}
+
 /**
   This code returns information about the EFI variables.
 
@@ -1356,11 +1523,20 @@ VariableAddressChangeEvent (
   IN VOID       *Context
   )
 {
+  UINTN  Index;
+
   EfiConvertPointer (0x0, (VOID **)&mVariableBuffer);
   EfiConvertPointer (0x0, (VOID **)&mMmCommunication2);
   EfiConvertPointer (EFI_OPTIONAL_PTR, (VOID **)&mVariableRuntimeHobCacheBuffer);
   EfiConvertPointer (EFI_OPTIONAL_PTR, (VOID **)&mVariableRuntimeNvCacheBuffer);
   EfiConvertPointer (EFI_OPTIONAL_PTR, (VOID **)&mVariableRuntimeVolatileCacheBuffer);
+
+  for (Index = 0; Index < VARIABLE_INDEX_MAX_STORES; Index++) {
+    if (mVariableStoreIndex[Index] != NULL) {
+      EfiConvertPointer (0x0, (VOID **)&mVariableStoreIndex[Index]->Store);
+      EfiConvertPointer (0x0, (VOID **)&mVariableStoreIndex[Index]);
+    }
+  }
 }
 
 /**
@@ -1570,6 +1746,7 @@ SendRuntimeVariableCacheContextToSmm (
   SmmRuntimeVarCacheContext->PendingUpdate        = &mVariableRuntimeCachePendingUpdate;
   SmmRuntimeVarCacheContext->ReadLock             = &mVariableRuntimeCacheReadLock;
   SmmRuntimeVarCacheContext->HobFlushComplete     = &mHobFlushComplete;
+  SmmRuntimeVarCacheContext->RewriteCount         = &mVariableRuntimeCacheRewriteCount;
 
   //
   // Request to unblock this region to be accessible from inside MM environment
@@ -1599,6 +1776,14 @@ SendRuntimeVariableCacheContextToSmm (
     goto Done;
   }
 
+  Status = MmUnblockMemoryRequest (
+             (EFI_PHYSICAL_ADDRESS)ALIGN_VALUE ((UINTN)SmmRuntimeVarCacheContext->RewriteCount - EFI_PAGE_SIZE + 1, EFI_PAGE_SIZE),
+             EFI_SIZE_TO_PAGES (sizeof (mVariableRuntimeCacheRewriteCount))
+             );
+  if ((Status != EFI_UNSUPPORTED) && EFI_ERROR (Status)) {
+    goto Done;
+  }
+
   //
   // Send data to SMM.
   //
@@ -1678,6 +1863,16 @@ SmmVariableReady (
             Status = SendRuntimeVariableCacheContextToSmm ();
             if (!EFI_ERROR (Status)) {
               SyncRuntimeCache ();
+
+              //
+              // Index the runtime caches FindVariableInRuntimeCache () searches.
+              //
+              if (mVariableRuntimeHobCacheBuffer != NULL) {
+                VariableIndexRegister (mVariableRuntimeHobCacheBuffer, mVariableAuthFormat);
+              }
+
+              VariableIndexRegister (mVariableRuntimeNvCacheBuffer, mVariableAuthFormat);
+              VariableIndexRegister (mVariableRuntimeVolatileCacheBuffer, mVariableAuthFormat);
             }
           }
         }
@@ -1773,6 +1968,16 @@ SmmVariableWriteReady (
                   );
   ASSERT_EFI_ERROR (Status);
 
+  mVariableBatch.Revision     = EDKII_VARIABLE_BATCH_PROTOCOL_REVISION;
+  mVariableBatch.SetVariables = VariableBatchSetVariables;
+  Status                      = gBS->InstallMultipleProtocolInterfaces (
+                                       &mHandle,
+                                       &gEdkiiVariableBatchProtocolGuid,
+                                       &mVariableBatch,
+                                       NULL
+                                       );
+  ASSERT_EFI_ERROR (Status);
+
   gBS->CloseEvent (Event);
 }
 
@@ -0,0 +1,93 @@
+/** @file
+  Hash of the GUID and name of a variable, shared by the PEI and DXE variable
+  drivers so that the DXE driver can reuse the PEI variable index.
+
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "VariableIndexHash.h"
+
+/**
+  Hash the GUID and name of a variable.
+
+  @param[in] VendorGuid  The GUID of the variable.
+  @param[in] Name        The name of the variable.
+  @param[in] Length      The number of characters of Name, without the null terminator.
+
+  @return The hash of VendorGuid and Name.
+
+**/
+UINT32
+VariableIndexHash (
+  IN CONST EFI_GUID  *VendorGuid,
+  IN CONST CHAR16    *Name,
+  IN UINTN           Length
+  )
+{
+  CONST UINT8  *Byte;
+  UINTN        Index;
+  UINT32       Hash;
+
+  //
+  // FNV-1a over the bytes of the GUID and of the name, as EDKII_PEI_VARIABLE_INDEX
+  // documents it.
+  //
+  Hash = 0x811C9DC5;
+  Byte = (CONST UINT8 *)VendorGuid;
+  for (Index = 0; Index < sizeof (EFI_GUID); Index++) {
+    Hash = (Hash ^ Byte[Index]) * 0x01000193;
+  }
+
+  Byte = (CONST UINT8 *)Name;
+  for (Index = 0; Index < Length * sizeof (CHAR16); Index++) {
+    Hash = (Hash ^ Byte[Index]) * 0x01000193;
+  }
+
+  return Hash;
+}
+
+/**
+  Get the number of characters of the name of a variable in a store.
+
+  The walk of a store compares the NameSize bytes of the name of a variable
+  with the name searched, so the hash of the name searched can only be used to
+  select a variable if the name of the variable ends with its first null
+  character.
+
+  @param[in]  Name      The name of the variable in the store.
+  @param[in]  NameSize  The size in bytes of the name in the variable header.
+  @param[in]  EndPtr    The end of the variable store.
+  @param[out] Length    The number of characters of the name, without the
+                        null terminator.
+
+  @retval TRUE   The name of the variable can be hashed.
+  @retval FALSE  The name of the variable is not a null terminated string of
+                 NameSize bytes within the store.
+
+**/
+BOOLEAN
+VariableIndexGetNameLength (
+  IN  CONST CHAR16  *Name,
+  IN  UINTN         NameSize,
+  IN  CONST VOID    *EndPtr,
+  OUT UINTN         *Length
+  )
+{
+  UINTN  Index;
+
+  if ((NameSize < sizeof (CHAR16)) || ((NameSize % sizeof (CHAR16)) != 0) ||
+      ((UINTN)Name > (UINTN)EndPtr) || (NameSize > (UINTN)EndPtr - (UINTN)Name))
+  {
+    return FALSE;
+  }
+
+  for (Index = 0; Name[Index] != L'\0'; Index++) {
+    if (Index == NameSize / sizeof (CHAR16) - 1) {
+      return FALSE;
+    }
+  }
+
+  *Length = Index;
+  return (BOOLEAN)(Index == NameSize / sizeof (CHAR16) - 1);
+}
@@ -0,0 +1,58 @@
+/** @file
+  Hash of the GUID and name of a variable, shared by the PEI and DXE variable
+  drivers so that the DXE driver can reuse the PEI variable index.
+
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _VARIABLE_INDEX_HASH_H_
+#define _VARIABLE_INDEX_HASH_H_
+
+#include <Uefi/UefiBaseType.h>
+
+/**
+  Hash the GUID and name of a variable.
+
+  @param[in] VendorGuid  The GUID of the variable.
+  @param[in] Name        The name of the variable.
+  @param[in] Length      The number of characters of Name, without the null terminator.
+
+  @return The hash of VendorGuid and Name.
+
+**/
+UINT32
+VariableIndexHash (
+  IN CONST EFI_GUID  *VendorGuid,
+  IN CONST CHAR16    *Name,
+  IN UINTN           Length
+  );
+
+/**
+  Get the number of characters of the name of a variable in a store.
+
+  The walk of a store compares the NameSize bytes of the name of a variable
+  with the name searched, so the hash of the name searched can only be used to
+  select a variable if the name of the variable ends with its first null
+  character.
+
+  @param[in]  Name      The name of the variable in the store.
+  @param[in]  NameSize  The size in bytes of the name in the variable header.
+  @param[in]  EndPtr    The end of the variable store.
+  @param[out] Length    The number of characters of the name, without the
+                        null terminator.
+
+  @retval TRUE   The name of the variable can be hashed.
+  @retval FALSE  The name of the variable is not a null terminated string of
+                 NameSize bytes within the store.
+
+**/
+BOOLEAN
+VariableIndexGetNameLength (
+  IN  CONST CHAR16  *Name,
+  IN  UINTN         NameSize,
+  IN  CONST VOID    *EndPtr,
+  OUT UINTN         *Length
+  );
+
+#endif
@@ -0,0 +1,68 @@
+/** @file
+  HOB directory GUID and data structure.
+
+  The HOB directory maps the GUID of the GUID HOBs of the HOB list to their offsets
+  in the HOB list, so that they can be found without walking the HOB list. It is
+  built as a GUID HOB at the end of PEI, and describes the part of the HOB list
+  before it, or only the first part of it when its GUID HOBs do not all fit in
+  the directory. In DXE, it is also published as a configuration table.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef __HOB_DIRECTORY_GUID_H__
+#define __HOB_DIRECTORY_GUID_H__
+
+#define EDKII_HOB_DIRECTORY_GUID \
+  { \
+    0x908e3c78, 0x3783, 0x43cc, { 0xab, 0x3f, 0xb1, 0xb4, 0x04, 0x61, 0x39, 0xe5 } \
+  }
+
+///
+/// The GUID HOBs of the HOB list with the same GUID.
+///
+typedef struct {
+  ///
+  /// The GUID of the GUID HOBs.
+  ///
+  EFI_GUID    Name;
+  ///
+  /// The index in the offset array of the directory of the offset of the first
+  /// GUID HOB with Name.
+  ///
+  UINT32      OffsetIndex;
+  ///
+  /// The number of GUID HOBs with Name.
+  ///
+  UINT32      OffsetCount;
+} EDKII_HOB_DIRECTORY_ENTRY;
+
+typedef struct {
+  ///
+  /// The length in bytes of the part of the HOB list described by the directory,
+  /// from the start of the HOB list. The GUID HOBs after it must be searched by
+  /// walking the HOB list.
+  ///
+  UINT32    Length;
+  ///
+  /// The number of EDKII_HOB_DIRECTORY_ENTRY entries.
+  ///
+  UINT32    EntryCount;
+  ///
+  /// The number of offsets.
+  ///
+  UINT32    OffsetCount;
+  UINT32    Reserved;
+  //
+  // EDKII_HOB_DIRECTORY_ENTRY  Entry[EntryCount];
+  //   Sorted by the byte order of their Name.
+  // UINT32                     Offset[OffsetCount];
+  //   The offsets of the GUID HOBs from the start of the HOB list, in the order
+  //   of the entries, and in the order of the HOB list for each entry.
+  //
+} EDKII_HOB_DIRECTORY;
+
+extern EFI_GUID  gEdkiiHobDirectoryGuid;
+
+#endif
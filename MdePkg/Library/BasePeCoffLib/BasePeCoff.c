@@ -916,6 +916,51 @@ EFIAPI
 PeCoffLoaderRelocateImage (
   IN OUT PE_COFF_LOADER_IMAGE_CONTEXT  *ImageContext
   )
+{
+  RETURN_STATUS  Status;
+
+  Status = PeCoffLoaderApplyRelocations (ImageContext);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  // Applies additional environment specific actions to relocate fixups
+  // to a PE/COFF image if needed
+  PeCoffLoaderRelocateImageExtraAction (ImageContext);
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Applies relocation fixups to a PE/COFF image that was loaded with PeCoffLoaderLoadImage(),
+  without the environment specific actions of PeCoffLoaderRelocateImage().
+
+  This function only reads and writes the image and ImageContext: it uses no service of the
+  environment and does not call PeCoffLoaderRelocateImageExtraAction(), so it can run on an AP.
+  Calling PeCoffLoaderRelocateImage() afterwards with the same ImageContext applies no fixup
+  again, because the image base in the header of the image then matches the relocation base
+  address, and only performs the environment specific actions.
+
+  The ImageContext fields that must be valid are the same as for PeCoffLoaderRelocateImage().
+
+  If ImageContext is NULL, then ASSERT().
+
+  @param  ImageContext        The pointer to the image context structure that describes the PE/COFF
+                              image that is being relocated.
+
+  @retval RETURN_SUCCESS      The PE/COFF image was relocated.
+                              Extended status information is in the ImageError field of ImageContext.
+  @retval RETURN_LOAD_ERROR   The image in not a valid PE/COFF image.
+                              Extended status information is in the ImageError field of ImageContext.
+  @retval RETURN_UNSUPPORTED  A relocation record type is not supported.
+                              Extended status information is in the ImageError field of ImageContext.
+
+**/
+RETURN_STATUS
+EFIAPI
+PeCoffLoaderApplyRelocations (
+  IN OUT PE_COFF_LOADER_IMAGE_CONTEXT  *ImageContext
+  )
 {
   RETURN_STATUS                        Status;
   EFI_IMAGE_OPTIONAL_HEADER_PTR_UNION  Hdr;
@@ -947,9 +992,6 @@ PeCoffLoaderRelocateImage (
   // If there are no relocation entries, then we are done
   //
   if (ImageContext->RelocationsStripped) {
-    // Applies additional environment specific actions to relocate fixups
-    // to a PE/COFF image if needed
-    PeCoffLoaderRelocateImageExtraAction (ImageContext);
     return RETURN_SUCCESS;
   }
 
@@ -1161,10 +1203,6 @@ PeCoffLoaderRelocateImage (
     }
   }
 
-  // Applies additional environment specific actions to relocate fixups
-  // to a PE/COFF image if needed
-  PeCoffLoaderRelocateImageExtraAction (ImageContext);
-
   return RETURN_SUCCESS;
 }
 
@@ -9,13 +9,15 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <PiDxe.h>
 
 #include <Guid/HobList.h>
+#include <Guid/HobDirectory.h>
 
 #include <Library/HobLib.h>
 #include <Library/UefiLib.h>
 #include <Library/DebugLib.h>
 #include <Library/BaseMemoryLib.h>
 
-VOID  *mHobList = NULL;
+VOID                 *mHobList      = NULL;
+EDKII_HOB_DIRECTORY  *mHobDirectory = NULL;
 
 /**
   Returns the pointer to the HOB list.
@@ -54,7 +56,8 @@ GetHobList (
 
 /**
   The constructor function caches the pointer to HOB list by calling GetHobList()
-  and will always return EFI_SUCCESS.
+  and the pointer to the HOB directory if it is present, and will always return
+  EFI_SUCCESS.
 
   @param  ImageHandle   The firmware allocated handle for the EFI image.
   @param  SystemTable   A pointer to the EFI System Table.
@@ -71,6 +74,10 @@ HobLibConstructor (
 {
   GetHobList ();
 
+  if (EFI_ERROR (EfiGetSystemConfigurationTable (&gEdkiiHobDirectoryGuid, (VOID **)&mHobDirectory))) {
+    mHobDirectory = NULL;
+  }
+
   return EFI_SUCCESS;
 }
 
@@ -142,6 +149,100 @@ GetFirstHob (
   return GetNextHob (Type, HobList);
 }
 
+/**
+  Returns the next instance of the matched GUID HOB from the starting HOB among
+  the GUID HOBs of the HOB directory.
+
+  The directory only records where its GUID HOBs start and end. HobStart must be
+  the start of the HOB list, or the start or the end of one of the GUID HOBs with
+  Guid: the directory cannot tell where the other HOBs are, and the caller must
+  then walk the HOB list from HobStart.
+
+  @param  Guid          The GUID to match with in the HOB list.
+  @param  HobStart      The starting HOB pointer to search from, in the part of
+                        the HOB list described by the HOB directory.
+  @param  GuidHob       Returns the next instance of the matched GUID HOB from
+                        the starting HOB, or NULL if there is no such HOB in the
+                        part of the HOB list described by the HOB directory.
+
+  @retval TRUE          The HOB directory was searched and GuidHob is returned.
+  @retval FALSE         HobStart is not a HOB boundary recorded by the HOB
+                        directory.
+
+**/
+STATIC
+BOOLEAN
+GetNextGuidHobFromDirectory (
+  IN  CONST EFI_GUID  *Guid,
+  IN  CONST VOID      *HobStart,
+  OUT VOID            **GuidHob
+  )
+{
+  EDKII_HOB_DIRECTORY_ENTRY  *Entry;
+  UINT32                     *Offset;
+  UINTN                      StartOffset;
+  UINTN                      Low;
+  UINTN                      High;
+  UINTN                      Middle;
+  UINTN                      Index;
+  INTN                       Result;
+  BOOLEAN                    Boundary;
+  EFI_PEI_HOB_POINTERS       Hob;
+
+  *GuidHob    = NULL;
+  StartOffset = (UINTN)HobStart - (UINTN)mHobList;
+  Boundary    = (BOOLEAN)(StartOffset == 0);
+  Entry       = (EDKII_HOB_DIRECTORY_ENTRY *)(mHobDirectory + 1);
+  Offset      = (UINT32 *)(Entry + mHobDirectory->EntryCount);
+
+  Low  = 0;
+  High = mHobDirectory->EntryCount;
+  while (Low < High) {
+    Middle = (Low + High) / 2;
+    Result = CompareMem (Guid, &Entry[Middle].Name, sizeof (EFI_GUID));
+    if (Result < 0) {
+      High = Middle;
+    } else if (Result > 0) {
+      Low = Middle + 1;
+    } else {
+      for (Index = Entry[Middle].OffsetIndex; Index < Entry[Middle].OffsetIndex + Entry[Middle].OffsetCount; Index++) {
+        //
+        // The HOBs marked unused since the directory was built keep their length.
+        //
+        Hob.Raw = (UINT8 *)mHobList + Offset[Index];
+        if (Offset[Index] + Hob.Header->HobLength == StartOffset) {
+          Boundary = TRUE;
+          continue;
+        }
+
+        if (Offset[Index] < StartOffset) {
+          continue;
+        }
+
+        if (Offset[Index] == StartOffset) {
+          Boundary = TRUE;
+        }
+
+        if (!Boundary) {
+          return FALSE;
+        }
+
+        //
+        // Skip the HOBs that were marked unused since the directory was built.
+        //
+        if ((Hob.Header->HobType == EFI_HOB_TYPE_GUID_EXTENSION) && CompareGuid (Guid, &Hob.Guid->Name)) {
+          *GuidHob = Hob.Raw;
+          return TRUE;
+        }
+      }
+
+      break;
+    }
+  }
+
+  return Boundary;
+}
+
 /**
   Returns the next instance of the matched GUID HOB from the starting HOB.
 
@@ -173,6 +274,24 @@ GetNextGuidHob (
 {
   EFI_PEI_HOB_POINTERS  GuidHob;
 
+  //
+  // Look up the part of the HOB list described by the HOB directory in the
+  // directory, and only walk the HOBs after it. Walk the whole HOB list from
+  // HobStart when HobStart is not a HOB boundary the directory records.
+  //
+  if ((mHobDirectory != NULL) &&
+      ((UINTN)HobStart >= (UINTN)mHobList) &&
+      ((UINTN)HobStart - (UINTN)mHobList < mHobDirectory->Length))
+  {
+    if (GetNextGuidHobFromDirectory (Guid, HobStart, (VOID **)&GuidHob.Raw)) {
+      if (GuidHob.Raw != NULL) {
+        return GuidHob.Raw;
+      }
+
+      HobStart = (UINT8 *)mHobList + mHobDirectory->Length;
+    }
+  }
+
   GuidHob.Raw = (UINT8 *)HobStart;
   while ((GuidHob.Raw = GetNextHob (EFI_HOB_TYPE_GUID_EXTENSION, GuidHob.Raw)) != NULL) {
     if (CompareGuid (Guid, &GuidHob.Guid->Name)) {
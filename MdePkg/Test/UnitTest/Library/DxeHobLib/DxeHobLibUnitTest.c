@@ -0,0 +1,455 @@
+/** @file
+  This is a host-based unit test for the GUID HOB lookup of DxeHobLib with the
+  HOB directory.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <PiDxe.h>
+#include <Guid/HobList.h>
+#include <Guid/HobDirectory.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/HobLib.h>
+#include <Library/UefiLib.h>
+#include <Library/UnitTestLib.h>
+
+#define UNIT_TEST_NAME     "DxeHobLib HOB Directory Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// The GUIDs of the test GUID HOBs. The last one has no GUID HOB.
+//
+#define TEST_GUID_COUNT  4
+
+EFI_GUID  mTestGuid[TEST_GUID_COUNT] = {
+  { 0x5c1a7d44, 0x0b3e, 0x4f12, { 0x9a, 0x61, 0x27, 0xd8, 0x3e, 0x10, 0x4b, 0x96 } },
+  { 0x0e9f2b61, 0x7c45, 0x4d8a, { 0xb3, 0x17, 0x6a, 0x02, 0xe5, 0x9c, 0x81, 0x3d } },
+  { 0xa4d80c13, 0x5f29, 0x47b6, { 0x8e, 0x3a, 0x19, 0xc7, 0x54, 0x2f, 0x6b, 0xe0 } },
+  { 0x31b6e9f2, 0x2d08, 0x4c7e, { 0x95, 0x4b, 0x8f, 0x61, 0x0a, 0xd3, 0x27, 0x5c } }
+};
+
+//
+// A HOB of the test HOB list. GuidIndex and DataSize are only used by the
+// GUID HOBs.
+//
+typedef struct {
+  UINT16    HobType;
+  UINT8     GuidIndex;
+  UINT8     DataSize;
+} TEST_HOB;
+
+#define TEST_OTHER_HOB_LENGTH  0x30
+
+TEST_HOB  mTestHobs[] = {
+  { EFI_HOB_TYPE_HANDOFF,             0, 0  },
+  { EFI_HOB_TYPE_GUID_EXTENSION,      0, 8  },
+  { EFI_HOB_TYPE_GUID_EXTENSION,      1, 16 },
+  { EFI_HOB_TYPE_RESOURCE_DESCRIPTOR, 0, 0  },
+  { EFI_HOB_TYPE_GUID_EXTENSION,      0, 0  },
+  { EFI_HOB_TYPE_GUID_EXTENSION,      2, 8  },
+  { EFI_HOB_TYPE_GUID_EXTENSION,      1, 8  },
+  { EFI_HOB_TYPE_GUID_EXTENSION,      0, 24 },
+  { EFI_HOB_TYPE_MEMORY_ALLOCATION,   0, 0  },
+  { EFI_HOB_TYPE_GUID_EXTENSION,      2, 8  },
+  { EFI_HOB_TYPE_GUID_EXTENSION,      0, 8  },
+  { EFI_HOB_TYPE_GUID_EXTENSION,      1, 8  },
+  { EFI_HOB_TYPE_GUID_EXTENSION,      0, 8  },
+  { EFI_HOB_TYPE_GUID_EXTENSION,      2, 8  },
+  { EFI_HOB_TYPE_END_OF_HOB_LIST,     0, 0  }
+};
+
+#define TEST_HOB_COUNT  (sizeof (mTestHobs) / sizeof (mTestHobs[0]))
+
+//
+// The HOB directories the tests use, given as the index of the first test HOB
+// they do not describe. The truncated directory is the one DxeIpl builds when
+// the GUID HOBs do not all fit in it: it ends at a GUID HOB. The full one
+// ends at the GUID HOBs built after the directory.
+//
+#define TEST_NO_DIRECTORY         0
+#define TEST_TRUNCATED_DIRECTORY  9
+#define TEST_FULL_DIRECTORY       12
+
+//
+// The test HOB list, the offsets of its HOBs, and its HOB directory.
+//
+UINT64  mHobBuffer[0x400 / sizeof (UINT64)];
+UINT32  mHobOffset[TEST_HOB_COUNT];
+UINT64  mDirectoryBuffer[0x400 / sizeof (UINT64)];
+
+//
+// The HOB list and HOB directory cached by DxeHobLib.
+//
+extern VOID                 *mHobList;
+extern EDKII_HOB_DIRECTORY  *mHobDirectory;
+
+/**
+  Return the test HOB list in place of the system configuration table.
+
+  @param[in]  TableGuid  The GUID of the configuration table.
+  @param[out] Table      Returns the configuration table.
+
+  @retval EFI_SUCCESS    The table is the test HOB list.
+  @retval EFI_NOT_FOUND  There is no such table.
+
+**/
+EFI_STATUS
+EFIAPI
+EfiGetSystemConfigurationTable (
+  IN  EFI_GUID  *TableGuid,
+  OUT VOID      **Table
+  )
+{
+  if (CompareGuid (TableGuid, &gEfiHobListGuid)) {
+    *Table = mHobBuffer;
+    return EFI_SUCCESS;
+  }
+
+  *Table = NULL;
+  return EFI_NOT_FOUND;
+}
+
+/**
+  Find the next GUID HOB by walking the HOB list, as DxeHobLib does without a
+  HOB directory.
+
+  @param[in] Guid      The GUID to match with.
+  @param[in] HobStart  The starting HOB.
+
+  @return The next matched GUID HOB, or NULL.
+
+**/
+VOID *
+WalkNextGuidHob (
+  IN CONST EFI_GUID  *Guid,
+  IN CONST VOID      *HobStart
+  )
+{
+  EFI_PEI_HOB_POINTERS  Hob;
+
+  for (Hob.Raw = (UINT8 *)HobStart; !END_OF_HOB_LIST (Hob); Hob.Raw = GET_NEXT_HOB (Hob)) {
+    if ((Hob.Header->HobType == EFI_HOB_TYPE_GUID_EXTENSION) && CompareGuid (Guid, &Hob.Guid->Name)) {
+      return Hob.Raw;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Build the test HOB list, and the HOB directory of its first HOBs the way
+  DxeIpl does.
+
+  @param[in] Context  The index of the first test HOB the directory does not
+                      describe, or TEST_NO_DIRECTORY.
+
+  @retval UNIT_TEST_PASSED  The HOB list and its directory are built.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+HobListSetup (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_PEI_HOB_POINTERS       Hob;
+  UINTN                      DirectoryEnd;
+  UINTN                      Index;
+  UINTN                      Sorted[TEST_HOB_COUNT];
+  UINTN                      Count;
+  UINTN                      Position;
+  EDKII_HOB_DIRECTORY        *Directory;
+  EDKII_HOB_DIRECTORY_ENTRY  *Entry;
+  UINT32                     *Offset;
+
+  ZeroMem (mHobBuffer, sizeof (mHobBuffer));
+  ZeroMem (mDirectoryBuffer, sizeof (mDirectoryBuffer));
+
+  Hob.Raw = (UINT8 *)mHobBuffer;
+  for (Index = 0; Index < TEST_HOB_COUNT; Index++) {
+    mHobOffset[Index]     = (UINT32)(Hob.Raw - (UINT8 *)mHobBuffer);
+    Hob.Header->HobType   = mTestHobs[Index].HobType;
+    Hob.Header->HobLength = TEST_OTHER_HOB_LENGTH;
+    if (mTestHobs[Index].HobType == EFI_HOB_TYPE_GUID_EXTENSION) {
+      Hob.Header->HobLength = (UINT16)(sizeof (EFI_HOB_GUID_TYPE) + mTestHobs[Index].DataSize);
+      CopyGuid (&Hob.Guid->Name, &mTestGuid[mTestHobs[Index].GuidIndex]);
+    } else if (mTestHobs[Index].HobType == EFI_HOB_TYPE_END_OF_HOB_LIST) {
+      Hob.Header->HobLength = sizeof (EFI_HOB_GENERIC_HEADER);
+    }
+
+    Hob.Raw = GET_NEXT_HOB (Hob);
+  }
+
+  mHobList      = mHobBuffer;
+  mHobDirectory = NULL;
+
+  DirectoryEnd = (UINTN)Context;
+  if (DirectoryEnd == TEST_NO_DIRECTORY) {
+    return UNIT_TEST_PASSED;
+  }
+
+  //
+  // Sort the GUID HOBs before the end of the directory by GUID, then by offset.
+  //
+  Count = 0;
+  for (Index = 0; Index < DirectoryEnd; Index++) {
+    if (mTestHobs[Index].HobType != EFI_HOB_TYPE_GUID_EXTENSION) {
+      continue;
+    }
+
+    for (Position = Count; Position > 0; Position--) {
+      if (CompareMem (
+            &mTestGuid[mTestHobs[Sorted[Position - 1]].GuidIndex],
+            &mTestGuid[mTestHobs[Index].GuidIndex],
+            sizeof (EFI_GUID)
+            ) <= 0)
+      {
+        break;
+      }
+
+      Sorted[Position] = Sorted[Position - 1];
+    }
+
+    Sorted[Position] = Index;
+    Count++;
+  }
+
+  //
+  // Count the entries first: the offsets follow them.
+  //
+  Directory = (EDKII_HOB_DIRECTORY *)mDirectoryBuffer;
+  for (Index = 0; Index < Count; Index++) {
+    if ((Index == 0) || (mTestHobs[Sorted[Index]].GuidIndex != mTestHobs[Sorted[Index - 1]].GuidIndex)) {
+      Directory->EntryCount++;
+    }
+  }
+
+  Directory->Length      = mHobOffset[DirectoryEnd];
+  Directory->OffsetCount = (UINT32)Count;
+  Entry                  = (EDKII_HOB_DIRECTORY_ENTRY *)(Directory + 1);
+  Offset                 = (UINT32 *)(Entry + Directory->EntryCount);
+  for (Index = 0; Index < Count; Index++) {
+    if ((Index != 0) && (mTestHobs[Sorted[Index]].GuidIndex != mTestHobs[Sorted[Index - 1]].GuidIndex)) {
+      Entry++;
+    }
+
+    if (Entry->OffsetCount == 0) {
+      CopyGuid (&Entry->Name, &mTestGuid[mTestHobs[Sorted[Index]].GuidIndex]);
+      Entry->OffsetIndex = (UINT32)Index;
+    }
+
+    Entry->OffsetCount++;
+    Offset[Index] = mHobOffset[Sorted[Index]];
+  }
+
+  mHobDirectory = Directory;
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Check GetNextGuidHob () against a walk of the HOB list, from every HOB of the
+  test HOB list and for every test GUID.
+
+  @retval UNIT_TEST_PASSED  GetNextGuidHob () finds the same GUID HOBs.
+
+**/
+UNIT_TEST_STATUS
+CheckGuidHobsMatchWalk (
+  VOID
+  )
+{
+  UINTN                 GuidIndex;
+  UINTN                 Index;
+  VOID                  *HobStart;
+  EFI_PEI_HOB_POINTERS  Hob;
+
+  for (GuidIndex = 0; GuidIndex < TEST_GUID_COUNT; GuidIndex++) {
+    //
+    // Starting from any HOB, boundaries recorded by the directory or not.
+    //
+    for (Index = 0; Index < TEST_HOB_COUNT; Index++) {
+      HobStart = (UINT8 *)mHobBuffer + mHobOffset[Index];
+      UT_ASSERT_EQUAL (
+        (UINTN)GetNextGuidHob (&mTestGuid[GuidIndex], HobStart),
+        (UINTN)WalkNextGuidHob (&mTestGuid[GuidIndex], HobStart)
+        );
+    }
+
+    //
+    // Iterating over the GUID HOBs of a GUID the usual way.
+    //
+    Hob.Raw = GetFirstGuidHob (&mTestGuid[GuidIndex]);
+    UT_ASSERT_EQUAL ((UINTN)Hob.Raw, (UINTN)WalkNextGuidHob (&mTestGuid[GuidIndex], mHobBuffer));
+    while (Hob.Raw != NULL) {
+      HobStart = GET_NEXT_HOB (Hob);
+      Hob.Raw  = GetNextGuidHob (&mTestGuid[GuidIndex], HobStart);
+      UT_ASSERT_EQUAL ((UINTN)Hob.Raw, (UINTN)WalkNextGuidHob (&mTestGuid[GuidIndex], HobStart));
+    }
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  GetNextGuidHob () should find the same GUID HOBs as a walk of the HOB list.
+
+  @param[in] Context  Unused.
+
+  @retval UNIT_TEST_PASSED  The test passed.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+GuidHobsMatchWalk (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  return CheckGuidHobsMatchWalk ();
+}
+
+/**
+  GetNextGuidHob () should skip the GUID HOBs marked unused after the HOB
+  directory was built.
+
+  @param[in] Context  Unused.
+
+  @retval UNIT_TEST_PASSED  The test passed.
+
+**/
+UNIT_TEST_STATUS
+EFIAPI
+UnusedGuidHobsAreSkipped (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_PEI_HOB_POINTERS  Hob;
+
+  Hob.Raw             = (UINT8 *)mHobBuffer + mHobOffset[4];
+  Hob.Header->HobType = EFI_HOB_TYPE_UNUSED;
+  Hob.Raw             = (UINT8 *)mHobBuffer + mHobOffset[6];
+  Hob.Header->HobType = EFI_HOB_TYPE_UNUSED;
+
+  return CheckGuidHobsMatchWalk ();
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for the GUID HOB
+  lookup of DxeHobLib, and run them.
+
+**/
+VOID
+UnitTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      HobDirectoryTests;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (
+             &HobDirectoryTests,
+             Framework,
+             "DxeHobLib HOB Directory Tests",
+             "DxeHobLib.HobDirectory",
+             NULL,
+             NULL
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for HobDirectoryTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (
+    HobDirectoryTests,
+    "Without a HOB directory, the GUID HOBs should be found by walking the HOB list",
+    "NoDirectory",
+    GuidHobsMatchWalk,
+    HobListSetup,
+    NULL,
+    (UNIT_TEST_CONTEXT)(UINTN)TEST_NO_DIRECTORY
+    );
+  AddTestCase (
+    HobDirectoryTests,
+    "With a HOB directory, the same GUID HOBs should be found from any HOB",
+    "FullDirectory",
+    GuidHobsMatchWalk,
+    HobListSetup,
+    NULL,
+    (UNIT_TEST_CONTEXT)(UINTN)TEST_FULL_DIRECTORY
+    );
+  AddTestCase (
+    HobDirectoryTests,
+    "With a HOB directory of the first GUID HOBs only, the same GUID HOBs should be found from any HOB",
+    "TruncatedDirectory",
+    GuidHobsMatchWalk,
+    HobListSetup,
+    NULL,
+    (UNIT_TEST_CONTEXT)(UINTN)TEST_TRUNCATED_DIRECTORY
+    );
+  AddTestCase (
+    HobDirectoryTests,
+    "The GUID HOBs marked unused after the HOB directory was built should be skipped",
+    "UnusedHob",
+    UnusedGuidHobsAreSkipped,
+    HobListSetup,
+    NULL,
+    (UNIT_TEST_CONTEXT)(UINTN)TEST_FULL_DIRECTORY
+    );
+
+  //
+  // Execute the tests.
+  //
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return;
+}
+
+///
+/// Avoid ECC error for function name that starts with lower case letter
+///
+#define Main  main
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+
+  @param[in] Argc  Number of arguments
+  @param[in] Argv  Array of pointers to arguments
+
+  @retval 0      Success
+  @retval other  Error
+**/
+INT32
+Main (
+  IN INT32  Argc,
+  IN CHAR8  *Argv[]
+  )
+{
+  UnitTestMain ();
+  return 0;
+}